@@ -1,6 +1,10 @@
 // ignore_for_file: library_private_types_in_public_api, avoid_print
 
+import 'dart:async';
+import 'dart:convert';
 import 'dart:ffi';
+import 'dart:io';
+import 'dart:typed_data';
 import 'package:ffi/ffi.dart';
 import 'package:meta/meta.dart';
 
@@ -15,19 +19,315 @@ final class _FileMetadataStruct extends Struct {
   external int fileSizeBytes;
 }
 
-// C function signatures
+final class _FsChangeRecordStruct extends Struct {
+  @Uint32()
+  external int pathId;
+  @Uint8()
+  external int kind;
+  @Uint8()
+  external int isDirectory;
+  @Uint16()
+  external int reserved;
+}
+
+final class _ShortcutTargetStruct extends Struct {
+  @Uint32()
+  external int targetId;
+  @Uint8()
+  external int source;
+  @Uint8()
+  external int targetExists;
+  @Uint16()
+  external int reserved;
+}
+
+final class _MemoryStatsStruct extends Struct {
+  @Uint64()
+  external int readBufferAcquires;
+  @Uint64()
+  external int readBufferAllocations;
+  @Uint64()
+  external int pixelBufferAcquires;
+  @Uint64()
+  external int pixelBufferAllocations;
+  @Uint64()
+  external int retainedBytes;
+  @Uint64()
+  external int thumbnailBudgetBytes;
+  @Uint64()
+  external int thumbnailBytesInFlight;
+  @Uint64()
+  external int thumbnailHighWaterBytes;
+  @Uint64()
+  external int thumbnailBudgetWaits;
+}
+
+final class _SimilarityMatchStruct extends Struct {
+  @Uint32()
+  external int pathId;
+  @Uint32()
+  external int distance;
+}
+
+/// What a file's leading bytes identify it as. Order matches the native `ContainerKind`.
+enum ContainerKind { unknown, isoBmff, quickTime, matroska, webm, avi, mpegTs, m2ts, mpegPs, asf, flv, ogg, shellLink, image, archive, document }
+
+extension ContainerKindRouting on ContainerKind {
+  /// True for containers worth sending to the duration/thumbnail probes.
+  bool get isMedia => index >= ContainerKind.isoBmff.index && index <= ContainerKind.ogg.index;
+}
+
+/// Net change reported for one path by [VideoDataUtils.watchLibrary].
+enum FileChangeKind { added, modified, removed, rescan }
+
+class FileChange {
+  final int pathId;
+  final String path;
+  final FileChangeKind kind;
+  final bool isDirectory;
+
+  const FileChange({required this.pathId, required this.path, required this.kind, required this.isDirectory});
+
+  @override
+  String toString() => 'FileChange(${kind.name}, $path${isDirectory ? ', directory' : ''})';
+}
+
+/// Keyframes of a video's first video track: [timesMs] and the byte [offsets] to seek to, in order.
+class KeyframeIndex {
+  final Int64List timesMs;
+  final Uint64List offsets;
+
+  const KeyframeIndex({required this.timesMs, required this.offsets});
+
+  int get length => timesMs.length;
+
+  /// Index of the last keyframe at or before [timeMs] (0 if [timeMs] precedes them all), or -1 if empty.
+  int keyframeBefore(int timeMs) {
+    var low = 0, high = timesMs.length - 1, found = timesMs.isEmpty ? -1 : 0;
+    while (low <= high) {
+      final mid = (low + high) >> 1;
+      if (timesMs[mid] <= timeMs) {
+        found = mid;
+        low = mid + 1;
+      } else {
+        high = mid - 1;
+      }
+    }
+    return found;
+  }
+}
+
+/// Which part of a .lnk file a target was read from. Order matches the native `ShortcutSource`.
+enum ShortcutSource { none, linkInfo, relativePath, idList, shell }
+
+/// A resolved shortcut. [exists] is checked on every call; the parsed link itself is cached natively.
+class ShortcutTarget {
+  final int targetId;
+  final String path;
+  final ShortcutSource source;
+  final bool exists;
+
+  const ShortcutTarget({required this.targetId, required this.path, required this.source, required this.exists});
+}
+
+/// 64-bit perceptual hashes of a video thumbnail. Near-duplicates differ in a few bits.
+class ThumbnailHashes {
+  final int dHash;
+  final int pHash;
+
+  const ThumbnailHashes({required this.dHash, required this.pHash});
+}
+
+/// A hit of a similarity query: [distance] is the number of differing hash bits.
+class SimilarMatch {
+  final int pathId;
+  final int distance;
+
+  const SimilarMatch({required this.pathId, required this.distance});
+}
+
+/// Native buffer reuse and thumbnail memory. Acquires that are not allocations reused a pooled buffer.
+class MemoryStats {
+  final int readBufferAcquires;
+  final int readBufferAllocations;
+  final int pixelBufferAcquires;
+  final int pixelBufferAllocations;
+  final int retainedBytes;
+  final int thumbnailBudgetBytes;
+  final int thumbnailBytesInFlight;
+  final int thumbnailHighWaterBytes;
+
+  /// Thumbnail requests that had to wait for the budget.
+  final int thumbnailBudgetWaits;
+
+  const MemoryStats({
+    required this.readBufferAcquires,
+    required this.readBufferAllocations,
+    required this.pixelBufferAcquires,
+    required this.pixelBufferAllocations,
+    required this.retainedBytes,
+    required this.thumbnailBudgetBytes,
+    required this.thumbnailBytesInFlight,
+    required this.thumbnailHighWaterBytes,
+    required this.thumbnailBudgetWaits,
+  });
+}
+
+/// A library snapshot mapped from disk. Every column is a view into the mapping, so
+/// opening one costs no parsing or copying regardless of the number of rows.
+///
+/// Columns are indexed by row. Rows for files that could not be read have flag 0;
+/// [durationsMs] and [thumbnailHashes] are 0 where the flags say the value is unknown.
+/// The views must not be used after [close].
+class LibrarySnapshot {
+  static const int hasMetadata = 1, hasDuration = 2, hasThumbnailHash = 4;
+
+  final int rowCount;
+  final Int64List sizes;
+  final Int64List createdMs;
+  final Int64List accessedMs;
+  final Int64List modifiedMs;
+  final Float64List durationsMs;
+  final Uint64List thumbnailHashes;
+  final Uint8List flags;
+
+  /// Row numbers ordered by size (rows with metadata) and by duration (rows with a duration).
+  final Uint32List bySize;
+  final Uint32List byDuration;
+
+  /// Stream columns; null unless the snapshot was written with them.
+  final Uint8List? containers;
+  final Uint32List? keyframeCounts;
+
+  final Uint64List _pathOffsets;
+  final Uint8List _pathBytes;
+  final void Function() _close;
+  bool _closed = false;
+
+  LibrarySnapshot._({
+    required this.rowCount,
+    required this.sizes,
+    required this.createdMs,
+    required this.accessedMs,
+    required this.modifiedMs,
+    required this.durationsMs,
+    required this.thumbnailHashes,
+    required this.flags,
+    required this.bySize,
+    required this.byDuration,
+    required this.containers,
+    required this.keyframeCounts,
+    required Uint64List pathOffsets,
+    required Uint8List pathBytes,
+    required void Function() close,
+  })  : _pathOffsets = pathOffsets,
+        _pathBytes = pathBytes,
+        _close = close;
+
+  /// Decodes the path of [row]; paths are only turned into strings when asked for.
+  String path(int row) => utf8.decode(Uint8List.sublistView(_pathBytes, _pathOffsets[row], _pathOffsets[row + 1]));
+
+  /// Rows whose size lies in [[minBytes], [maxBytes]], smallest first.
+  Uint32List rowsBySize(int minBytes, int maxBytes) => _range(bySize, (row) => sizes[row], minBytes, maxBytes);
+
+  /// Rows whose duration lies in [[minMs], [maxMs]], shortest first.
+  Uint32List rowsByDuration(double minMs, double maxMs) => _range(byDuration, (row) => durationsMs[row], minMs, maxMs);
+
+  /// Unmaps the file. Safe to call more than once.
+  void close() {
+    if (_closed) return;
+    _closed = true;
+    _close();
+  }
+
+  static Uint32List _range(Uint32List index, num Function(int row) value, num min, num max) {
+    int lowerBound(bool Function(num v) before) {
+      var low = 0, high = index.length;
+      while (low < high) {
+        final mid = (low + high) >> 1;
+        if (before(value(index[mid]))) {
+          low = mid + 1;
+        } else {
+          high = mid;
+        }
+      }
+      return low;
+    }
+
+    final first = lowerBound((v) => v < min);
+    final end = lowerBound((v) => v <= max);
+    return Uint32List.sublistView(index, first, end < first ? first : end);
+  }
+}
+
+// Column IDs of the native snapshot format (SnapshotColumn in library_snapshot.h)
+const int _snapshotPathOffsets = 1, _snapshotPathBytes = 2, _snapshotSizeBytes = 3, _snapshotCreatedMs = 4;
+const int _snapshotAccessedMs = 5, _snapshotModifiedMs = 6, _snapshotDurationMs = 7, _snapshotThumbnailHash = 8;
+const int _snapshotFlags = 9, _snapshotBySize = 10, _snapshotByDuration = 11, _snapshotContainer = 32, _snapshotKeyframeCount = 33;
+
+// C function signatures. Paths are PathChar strings: UTF-16 on Windows, UTF-8 elsewhere (see _toNativePath)
 typedef _InitializeExporterNative = Void Function();
-typedef _GetThumbnailNative = Bool Function(Pointer<Utf16> videoPath, Pointer<Utf16> outputPath, Uint32 size);
-typedef _GetVideoDurationNative = Double Function(Pointer<Utf16> videoPath);
-typedef _GetFileMetadataNative = Bool Function(Pointer<Utf16> filePath, Pointer<_FileMetadataStruct> metadata);
-typedef _ResolveShortcutNative = Bool Function(Pointer<Utf16> shortcutPath, Pointer<Utf16> targetPath, Int32 bufferSize);
+typedef _GetThumbnailNative = Bool Function(Pointer<Void> videoPath, Pointer<Void> outputPath, Uint32 size);
+typedef _GetVideoDurationNative = Double Function(Pointer<Void> videoPath);
+typedef _GetFileMetadataNative = Bool Function(Pointer<Void> filePath, Pointer<_FileMetadataStruct> metadata);
+typedef _ResolveShortcutNative = Bool Function(Pointer<Void> shortcutPath, Pointer<Void> targetPath, Int32 bufferSize);
+typedef _PathArenaInternBatchNative = Uint32 Function(Pointer<Uint8> utf8Paths, Pointer<Uint32> offsets, Uint32 count, Pointer<Uint32> outIds);
+typedef _PathArenaGetNative = Pointer<Void> Function(Uint32 pathId, Pointer<Uint32> length);
+typedef _ResolveShortcutByIdNative = Bool Function(Uint32 shortcutId, Pointer<Uint32> targetId);
+typedef _ResolveShortcutsBatchNative = Uint32 Function(Pointer<Uint32> shortcutIds, Uint32 count, Pointer<_ShortcutTargetStruct> outTargets);
+typedef _GetFileMetadataBatchNative = Uint32 Function(Pointer<Uint32> pathIds, Uint32 count, Pointer<_FileMetadataStruct> outMetadata, Pointer<Bool> outOk);
+typedef _GetVideoDurationBatchNative = Uint32 Function(Pointer<Uint32> pathIds, Uint32 count, Pointer<Double> outDurations);
+typedef _SniffFilesBatchNative = Uint32 Function(Pointer<Uint32> pathIds, Uint32 count, Pointer<Uint8> outKinds);
+typedef _WatchStartNative = Int32 Function(Pointer<Uint32> rootIds, Uint32 count, Uint32 debounceMs, Bool reprobe);
+typedef _WatchPollNative = Uint32 Function(Int32 handle, Pointer<_FsChangeRecordStruct> outChanges, Uint32 capacity, Uint32 timeoutMs);
+typedef _WatchStopNative = Bool Function(Int32 handle);
+typedef _GetKeyframeIndexByIdNative = Uint32 Function(Uint32 pathId, Pointer<Int64> outTimesMs, Pointer<Uint64> outOffsets, Uint32 capacity);
+typedef _GetThumbnailHashesByIdNative = Bool Function(Uint32 videoId, Pointer<Uint64> outDHash, Pointer<Uint64> outPHash);
+typedef _SimilarityFindWithinNative = Uint32 Function(Uint64 hash, Uint32 radius, Pointer<_SimilarityMatchStruct> outMatches, Uint32 capacity);
+typedef _SimilarityFindNearestNative = Uint32 Function(Uint64 hash, Uint32 k, Pointer<_SimilarityMatchStruct> outMatches);
+typedef _GetMemoryStatsNative = Void Function(Pointer<_MemoryStatsStruct> stats);
+typedef _SetThumbnailMemoryBudgetNative = Void Function(Uint64 bytes);
+typedef _SnapshotWriteNative = Bool Function(Pointer<Uint32> pathIds, Uint32 count, Pointer<Void> outputPath, Bool streamColumns);
+typedef _SnapshotOpenNative = Int32 Function(Pointer<Void> path);
+typedef _SnapshotRowCountNative = Uint64 Function(Int32 handle);
+typedef _SnapshotColumnNative = Pointer<Void> Function(Int32 handle, Uint32 columnId, Pointer<Uint64> outCount);
+typedef _SnapshotCloseNative = Bool Function(Int32 handle);
 
 // Dart function signatures
 typedef _InitializeExporterDart = void Function();
-typedef _GetThumbnailDart = bool Function(Pointer<Utf16> videoPath, Pointer<Utf16> outputPath, int size);
-typedef _GetVideoDurationDart = double Function(Pointer<Utf16> videoPath);
-typedef _GetFileMetadataDart = bool Function(Pointer<Utf16> filePath, Pointer<_FileMetadataStruct> metadata);
-typedef _ResolveShortcutDart = bool Function(Pointer<Utf16> shortcutPath, Pointer<Utf16> targetPath, int bufferSize);
+typedef _GetThumbnailDart = bool Function(Pointer<Void> videoPath, Pointer<Void> outputPath, int size);
+typedef _GetVideoDurationDart = double Function(Pointer<Void> videoPath);
+typedef _GetFileMetadataDart = bool Function(Pointer<Void> filePath, Pointer<_FileMetadataStruct> metadata);
+typedef _ResolveShortcutDart = bool Function(Pointer<Void> shortcutPath, Pointer<Void> targetPath, int bufferSize);
+typedef _PathArenaInternBatchDart = int Function(Pointer<Uint8> utf8Paths, Pointer<Uint32> offsets, int count, Pointer<Uint32> outIds);
+typedef _PathArenaGetDart = Pointer<Void> Function(int pathId, Pointer<Uint32> length);
+typedef _ResolveShortcutByIdDart = bool Function(int shortcutId, Pointer<Uint32> targetId);
+typedef _ResolveShortcutsBatchDart = int Function(Pointer<Uint32> shortcutIds, int count, Pointer<_ShortcutTargetStruct> outTargets);
+typedef _GetFileMetadataBatchDart = int Function(Pointer<Uint32> pathIds, int count, Pointer<_FileMetadataStruct> outMetadata, Pointer<Bool> outOk);
+typedef _GetVideoDurationBatchDart = int Function(Pointer<Uint32> pathIds, int count, Pointer<Double> outDurations);
+typedef _SniffFilesBatchDart = int Function(Pointer<Uint32> pathIds, int count, Pointer<Uint8> outKinds);
+typedef _WatchStartDart = int Function(Pointer<Uint32> rootIds, int count, int debounceMs, bool reprobe);
+typedef _WatchPollDart = int Function(int handle, Pointer<_FsChangeRecordStruct> outChanges, int capacity, int timeoutMs);
+typedef _WatchStopDart = bool Function(int handle);
+typedef _GetKeyframeIndexByIdDart = int Function(int pathId, Pointer<Int64> outTimesMs, Pointer<Uint64> outOffsets, int capacity);
+typedef _GetThumbnailHashesByIdDart = bool Function(int videoId, Pointer<Uint64> outDHash, Pointer<Uint64> outPHash);
+typedef _SimilarityFindWithinDart = int Function(int hash, int radius, Pointer<_SimilarityMatchStruct> outMatches, int capacity);
+typedef _SimilarityFindNearestDart = int Function(int hash, int k, Pointer<_SimilarityMatchStruct> outMatches);
+typedef _GetMemoryStatsDart = void Function(Pointer<_MemoryStatsStruct> stats);
+typedef _SetThumbnailMemoryBudgetDart = void Function(int bytes);
+typedef _SnapshotWriteDart = bool Function(Pointer<Uint32> pathIds, int count, Pointer<Void> outputPath, bool streamColumns);
+typedef _SnapshotOpenDart = int Function(Pointer<Void> path);
+typedef _SnapshotRowCountDart = int Function(int handle);
+typedef _SnapshotColumnDart = Pointer<Void> Function(int handle, int columnId, Pointer<Uint64> outCount);
+typedef _SnapshotCloseDart = bool Function(int handle);
+
+/// Returned by the native path arena for empty or rejected paths.
+const int invalidPathId = 0xFFFFFFFF;
+
+/// Encodes [path] as a NUL-terminated native PathChar string: UTF-16 on Windows, UTF-8 elsewhere.
+///
+/// Allocated with [malloc]; the caller frees it.
+Pointer<Void> _toNativePath(String path) => Platform.isWindows ? path.toNativeUtf16().cast<Void>() : path.toNativeUtf8().cast<Void>();
 
 class VideoDataUtils {
   static final VideoDataUtils _instance = VideoDataUtils._internal();
@@ -49,6 +349,7 @@ class VideoDataUtils {
     'fileSize': 1024,
   };
   static String _mockResolvedShortcutPath = 'C:\\dummy\\target.txt';
+  static final List<String> _mockArena = [];
 
   /// Sets the expected return values for native operations when [testingMode] is true.
   ///
@@ -74,29 +375,447 @@ class VideoDataUtils {
   late final _GetVideoDurationDart getVideoDuration;
   late final _GetFileMetadataDart getFileMetadata;
   late final _ResolveShortcutDart resolveShortcut;
+  late final _PathArenaInternBatchDart _pathArenaInternBatch;
+  late final _PathArenaGetDart _pathArenaGet;
+  late final _ResolveShortcutByIdDart _resolveShortcutById;
+  late final _ResolveShortcutsBatchDart _resolveShortcutsBatch;
+  late final _GetFileMetadataBatchDart _getFileMetadataBatch;
+  late final _GetVideoDurationBatchDart _getVideoDurationBatch;
+  late final _SniffFilesBatchDart _sniffFilesBatch;
+  late final _WatchStartDart _watchStart;
+  late final _WatchPollDart _watchPoll;
+  late final _WatchStopDart _watchStop;
+  late final _GetKeyframeIndexByIdDart _getKeyframeIndexById;
+  late final _GetThumbnailHashesByIdDart _getThumbnailHashesById;
+  late final _SimilarityFindWithinDart _similarityFindWithin;
+  late final _SimilarityFindNearestDart _similarityFindNearest;
+  late final _GetMemoryStatsDart _getMemoryStats;
+  late final _SetThumbnailMemoryBudgetDart _setThumbnailMemoryBudget;
+  late final _SnapshotWriteDart _snapshotWrite;
+  late final _SnapshotOpenDart _snapshotOpen;
+  late final _SnapshotRowCountDart _snapshotRowCount;
+  late final _SnapshotColumnDart _snapshotColumn;
+  late final _SnapshotCloseDart _snapshotClose;
 
   VideoDataUtils._internal() {
     if (testingMode) return;
 
-    _dylib = DynamicLibrary.open('video_data_utils.dll');
+    _dylib = DynamicLibrary.open(Platform.isWindows ? 'video_data_utils.dll' : 'libvideo_data_utils.so');
 
     initializeExporter = _dylib.lookup<NativeFunction<_InitializeExporterNative>>('initialize_exporter').asFunction();
     getThumbnail = _dylib.lookup<NativeFunction<_GetThumbnailNative>>('get_thumbnail').asFunction();
     getVideoDuration = _dylib.lookup<NativeFunction<_GetVideoDurationNative>>('get_video_duration').asFunction();
     getFileMetadata = _dylib.lookup<NativeFunction<_GetFileMetadataNative>>('get_file_metadata').asFunction();
     resolveShortcut = _dylib.lookup<NativeFunction<_ResolveShortcutNative>>('resolve_shortcut').asFunction();
+    _pathArenaInternBatch = _dylib.lookup<NativeFunction<_PathArenaInternBatchNative>>('path_arena_intern_batch').asFunction();
+    _pathArenaGet = _dylib.lookup<NativeFunction<_PathArenaGetNative>>('path_arena_get').asFunction();
+    _resolveShortcutById = _dylib.lookup<NativeFunction<_ResolveShortcutByIdNative>>('resolve_shortcut_by_id').asFunction();
+    _resolveShortcutsBatch = _dylib.lookup<NativeFunction<_ResolveShortcutsBatchNative>>('resolve_shortcuts_batch').asFunction();
+    _getFileMetadataBatch = _dylib.lookup<NativeFunction<_GetFileMetadataBatchNative>>('get_file_metadata_batch').asFunction();
+    _getVideoDurationBatch = _dylib.lookup<NativeFunction<_GetVideoDurationBatchNative>>('get_video_duration_batch').asFunction();
+    _sniffFilesBatch = _dylib.lookup<NativeFunction<_SniffFilesBatchNative>>('sniff_files_batch').asFunction();
+    _watchStart = _dylib.lookup<NativeFunction<_WatchStartNative>>('watch_start').asFunction();
+    _watchPoll = _dylib.lookup<NativeFunction<_WatchPollNative>>('watch_poll').asFunction();
+    _watchStop = _dylib.lookup<NativeFunction<_WatchStopNative>>('watch_stop').asFunction();
+    _getKeyframeIndexById = _dylib.lookup<NativeFunction<_GetKeyframeIndexByIdNative>>('get_keyframe_index_by_id').asFunction();
+    _getThumbnailHashesById = _dylib.lookup<NativeFunction<_GetThumbnailHashesByIdNative>>('get_thumbnail_hashes_by_id').asFunction();
+    _similarityFindWithin = _dylib.lookup<NativeFunction<_SimilarityFindWithinNative>>('similarity_find_within').asFunction();
+    _similarityFindNearest = _dylib.lookup<NativeFunction<_SimilarityFindNearestNative>>('similarity_find_nearest').asFunction();
+    _getMemoryStats = _dylib.lookup<NativeFunction<_GetMemoryStatsNative>>('get_memory_stats').asFunction();
+    _setThumbnailMemoryBudget = _dylib.lookup<NativeFunction<_SetThumbnailMemoryBudgetNative>>('set_thumbnail_memory_budget').asFunction();
+    _snapshotWrite = _dylib.lookup<NativeFunction<_SnapshotWriteNative>>('snapshot_write').asFunction();
+    _snapshotOpen = _dylib.lookup<NativeFunction<_SnapshotOpenNative>>('snapshot_open').asFunction();
+    _snapshotRowCount = _dylib.lookup<NativeFunction<_SnapshotRowCountNative>>('snapshot_row_count').asFunction();
+    _snapshotColumn = _dylib.lookup<NativeFunction<_SnapshotColumnNative>>('snapshot_column').asFunction();
+    _snapshotClose = _dylib.lookup<NativeFunction<_SnapshotCloseNative>>('snapshot_close').asFunction();
 
     initializeExporter();
   }
 
+  /// Interns [paths] in the native path arena and returns their IDs, in order.
+  ///
+  /// All paths are encoded into a single UTF-8 buffer and cross FFI in one call.
+  /// Native code normalizes them, so equal paths always map to the same ID, and
+  /// an ID stays valid for the lifetime of the process. Empty paths map to [invalidPathId].
+  List<int> internPaths(List<String> paths) {
+    if (testingMode) {
+      return paths.map((path) {
+        if (path.isEmpty) return invalidPathId;
+        final index = _mockArena.indexOf(path);
+        if (index >= 0) return index;
+        _mockArena.add(path);
+        return _mockArena.length - 1;
+      }).toList();
+    }
+    if (paths.isEmpty) return const [];
+
+    final encoded = paths.map(utf8.encode).toList();
+    final totalBytes = encoded.fold<int>(0, (sum, bytes) => sum + bytes.length);
+
+    final blobC = malloc<Uint8>(totalBytes == 0 ? 1 : totalBytes);
+    final offsetsC = malloc<Uint32>(paths.length + 1);
+    final idsC = malloc<Uint32>(paths.length);
+    try {
+      final blob = blobC.asTypedList(totalBytes);
+      var offset = 0;
+      for (var i = 0; i < encoded.length; i++) {
+        offsetsC[i] = offset;
+        blob.setRange(offset, offset + encoded[i].length, encoded[i]);
+        offset += encoded[i].length;
+      }
+      offsetsC[paths.length] = offset;
+
+      _pathArenaInternBatch(blobC, offsetsC, paths.length, idsC);
+      return List<int>.of(idsC.asTypedList(paths.length));
+    } finally {
+      malloc.free(blobC);
+      malloc.free(offsetsC);
+      malloc.free(idsC);
+    }
+  }
+
+  /// Returns the normalized path stored in the arena for [pathId], or null if the ID is unknown.
+  String? pathForId(int pathId) {
+    if (testingMode) return pathId >= 0 && pathId < _mockArena.length ? _mockArena[pathId] : null;
+
+    final lengthC = calloc<Uint32>();
+    try {
+      final pathC = _pathArenaGet(pathId, lengthC);
+      if (pathC == nullptr) return null;
+      // The arena stores paths in the platform encoding: UTF-16 on Windows, UTF-8 elsewhere
+      return Platform.isWindows //
+          ? pathC.cast<Utf16>().toDartString(length: lengthC.value)
+          : pathC.cast<Utf8>().toDartString(length: lengthC.value);
+    } finally {
+      calloc.free(lengthC);
+    }
+  }
+
+  /// Retrieves metadata for every interned path in [pathIds] with a single native call.
+  ///
+  /// Entries that could not be read are null. Map keys match [getFileMetadataMap].
+  Future<List<Map<String, int>?>> getFileMetadataBatch(List<int> pathIds) async {
+    if (testingMode) return List.filled(pathIds.length, _mockFileMetadataMap);
+
+    return await Future(() {
+      final idsC = malloc<Uint32>(pathIds.length);
+      final metadataC = calloc<_FileMetadataStruct>(pathIds.length);
+      final okC = calloc<Bool>(pathIds.length);
+      try {
+        idsC.asTypedList(pathIds.length).setAll(0, pathIds);
+        _getFileMetadataBatch(idsC, pathIds.length, metadataC, okC);
+
+        return List<Map<String, int>?>.generate(pathIds.length, (i) {
+          if (!okC[i]) return null;
+          final metadata = metadataC[i];
+          return {'creationTime': metadata.creationTimeMs, 'modifiedTime': metadata.modifiedTimeMs, 'accessTime': metadata.accessTimeMs, 'fileSize': metadata.fileSizeBytes};
+        });
+      } finally {
+        malloc.free(idsC);
+        calloc.free(metadataC);
+        calloc.free(okC);
+      }
+    });
+  }
+
+  /// Retrieves the duration in milliseconds of every interned path in [pathIds].
+  /// Files whose duration cannot be read report 0.
+  Future<Float64List> getFileDurationBatch(List<int> pathIds) async {
+    if (testingMode) return Float64List(pathIds.length)..fillRange(0, pathIds.length, _mockVideoDuration);
+
+    return await Future(() {
+      final idsC = malloc<Uint32>(pathIds.length);
+      final durationsC = calloc<Double>(pathIds.length);
+      try {
+        idsC.asTypedList(pathIds.length).setAll(0, pathIds);
+        _getVideoDurationBatch(idsC, pathIds.length, durationsC);
+        return Float64List.fromList(durationsC.asTypedList(pathIds.length));
+      } finally {
+        malloc.free(idsC);
+        calloc.free(durationsC);
+      }
+    });
+  }
+
+  /// Classifies each interned path in [pathIds] from its first bytes.
+  ///
+  /// This reads at most a few hundred bytes per file, so it is a cheap filter
+  /// to run before asking for durations or thumbnails.
+  Future<List<ContainerKind>> sniffFiles(List<int> pathIds) async {
+    if (testingMode) return List.filled(pathIds.length, ContainerKind.isoBmff);
+
+    return await Future(() {
+      final idsC = malloc<Uint32>(pathIds.length);
+      final kindsC = calloc<Uint8>(pathIds.length);
+      try {
+        idsC.asTypedList(pathIds.length).setAll(0, pathIds);
+        _sniffFilesBatch(idsC, pathIds.length, kindsC);
+        return kindsC.asTypedList(pathIds.length).map((kind) => kind < ContainerKind.values.length ? ContainerKind.values[kind] : ContainerKind.unknown).toList();
+      } finally {
+        malloc.free(idsC);
+        calloc.free(kindsC);
+      }
+    });
+  }
+
+  /// Returns the keyframe index of the interned video [pathId], or null if it has none.
+  ///
+  /// Built natively from MP4 sample tables or Matroska Cues (falling back to a bounded
+  /// walk over cluster headers) without opening a decoder, and cached per file state,
+  /// so scrub previews and "thumbnail at 10%" can seek straight to a keyframe.
+  Future<KeyframeIndex?> getKeyframeIndex(int pathId) async {
+    if (testingMode) return KeyframeIndex(timesMs: Int64List.fromList([0]), offsets: Uint64List.fromList([0]));
+
+    return await Future(() {
+      final count = _getKeyframeIndexById(pathId, nullptr, nullptr, 0);
+      if (count == 0) return null;
+
+      final timesC = malloc<Int64>(count);
+      final offsetsC = malloc<Uint64>(count);
+      try {
+        final copied = _getKeyframeIndexById(pathId, timesC, offsetsC, count);
+        final length = copied < count ? copied : count;
+        return KeyframeIndex(
+          timesMs: Int64List.fromList(timesC.asTypedList(length)),
+          offsets: Uint64List.fromList(offsetsC.asTypedList(length)),
+        );
+      } finally {
+        malloc.free(timesC);
+        malloc.free(offsetsC);
+      }
+    });
+  }
+
+  /// Returns the perceptual hashes of the shell thumbnail of the interned video [videoId].
+  ///
+  /// Hashes are cached per file state, and the pHash is added to the native similarity
+  /// index so [findSimilar] and [findNearest] can match re-encodes of this video.
+  Future<ThumbnailHashes?> getThumbnailHashes(int videoId) async {
+    if (testingMode) return const ThumbnailHashes(dHash: 0, pHash: 0);
+
+    return await Future(() {
+      final hashesC = calloc<Uint64>(2);
+      try {
+        if (!_getThumbnailHashesById(videoId, hashesC, hashesC + 1)) return null;
+        return ThumbnailHashes(dHash: hashesC[0], pHash: hashesC[1]);
+      } finally {
+        calloc.free(hashesC);
+      }
+    });
+  }
+
+  /// Indexed videos whose pHash is within [radius] bits of [pHash], nearest first.
+  ///
+  /// Re-encodes of the same video usually land within 6-10 bits; unrelated videos about 32 apart.
+  Future<List<SimilarMatch>> findSimilar(int pHash, {int radius = 10}) async {
+    if (testingMode) return const [];
+
+    return await Future(() {
+      final count = _similarityFindWithin(pHash, radius, nullptr, 0);
+      if (count == 0) return const <SimilarMatch>[];
+      final matchesC = calloc<_SimilarityMatchStruct>(count);
+      try {
+        final copied = _similarityFindWithin(pHash, radius, matchesC, count);
+        return [for (var i = 0; i < (copied < count ? copied : count); i++) SimilarMatch(pathId: matchesC[i].pathId, distance: matchesC[i].distance)];
+      } finally {
+        calloc.free(matchesC);
+      }
+    });
+  }
+
+  /// The [k] indexed videos whose pHash is nearest to [pHash], nearest first.
+  Future<List<SimilarMatch>> findNearest(int pHash, int k) async {
+    if (testingMode || k <= 0) return const [];
+
+    return await Future(() {
+      final matchesC = calloc<_SimilarityMatchStruct>(k);
+      try {
+        final count = _similarityFindNearest(pHash, k, matchesC);
+        return [for (var i = 0; i < count; i++) SimilarMatch(pathId: matchesC[i].pathId, distance: matchesC[i].distance)];
+      } finally {
+        calloc.free(matchesC);
+      }
+    });
+  }
+
+  /// Caps the pixel memory of thumbnails being produced at once; further requests wait for room.
+  void setThumbnailMemoryBudget(int bytes) {
+    if (testingMode) return;
+    _setThumbnailMemoryBudget(bytes);
+  }
+
+  /// Counters of the native buffer pools and the thumbnail memory budget.
+  MemoryStats getMemoryStats() {
+    if (testingMode) {
+      return const MemoryStats(
+        readBufferAcquires: 0,
+        readBufferAllocations: 0,
+        pixelBufferAcquires: 0,
+        pixelBufferAllocations: 0,
+        retainedBytes: 0,
+        thumbnailBudgetBytes: 0,
+        thumbnailBytesInFlight: 0,
+        thumbnailHighWaterBytes: 0,
+        thumbnailBudgetWaits: 0,
+      );
+    }
+
+    final statsC = calloc<_MemoryStatsStruct>();
+    try {
+      _getMemoryStats(statsC);
+      final stats = statsC.ref;
+      return MemoryStats(
+        readBufferAcquires: stats.readBufferAcquires,
+        readBufferAllocations: stats.readBufferAllocations,
+        pixelBufferAcquires: stats.pixelBufferAcquires,
+        pixelBufferAllocations: stats.pixelBufferAllocations,
+        retainedBytes: stats.retainedBytes,
+        thumbnailBudgetBytes: stats.thumbnailBudgetBytes,
+        thumbnailBytesInFlight: stats.thumbnailBytesInFlight,
+        thumbnailHighWaterBytes: stats.thumbnailHighWaterBytes,
+        thumbnailBudgetWaits: stats.thumbnailBudgetWaits,
+      );
+    } finally {
+      calloc.free(statsC);
+    }
+  }
+
+  /// Probes the interned files [pathIds] and writes them as a columnar snapshot to [outputPath].
+  ///
+  /// Cached probe results are reused while a file's size and mtime are unchanged. The file
+  /// is replaced atomically, so an open [LibrarySnapshot] of the previous one stays valid.
+  /// [streamColumns] adds the container kind and keyframe count of each file.
+  Future<bool> writeLibrarySnapshot(List<int> pathIds, String outputPath, {bool streamColumns = false}) async {
+    if (testingMode) return true;
+
+    return await Future(() {
+      final idsC = malloc<Uint32>(pathIds.isEmpty ? 1 : pathIds.length);
+      final outputPathC = _toNativePath(outputPath);
+      try {
+        idsC.asTypedList(pathIds.length).setAll(0, pathIds);
+        return _snapshotWrite(idsC, pathIds.length, outputPathC, streamColumns);
+      } finally {
+        malloc.free(idsC);
+        malloc.free(outputPathC);
+      }
+    });
+  }
+
+  /// Maps the snapshot at [path]; null if it is missing or damaged.
+  ///
+  /// Columns are read in place through the mapping, so no row is decoded until it is used.
+  /// A column the file does not have reads as zeros, and a missing index as empty.
+  LibrarySnapshot? openLibrarySnapshot(String path) {
+    if (testingMode) return null;
+
+    final pathC = _toNativePath(path);
+    final countC = calloc<Uint64>();
+    try {
+      final handle = _snapshotOpen(pathC);
+      if (handle < 0) return null;
+
+      Pointer<T>? column<T extends NativeType>(int id) {
+        final data = _snapshotColumn(handle, id, countC);
+        return data == nullptr ? null : data.cast<T>();
+      }
+
+      final rows = _snapshotRowCount(handle);
+      Int64List int64s(int id) => column<Int64>(id)?.asTypedList(countC.value) ?? Int64List(rows);
+      return LibrarySnapshot._(
+        rowCount: rows,
+        sizes: int64s(_snapshotSizeBytes),
+        createdMs: int64s(_snapshotCreatedMs),
+        accessedMs: int64s(_snapshotAccessedMs),
+        modifiedMs: int64s(_snapshotModifiedMs),
+        durationsMs: column<Double>(_snapshotDurationMs)?.asTypedList(countC.value) ?? Float64List(rows),
+        thumbnailHashes: column<Uint64>(_snapshotThumbnailHash)?.asTypedList(countC.value) ?? Uint64List(rows),
+        flags: column<Uint8>(_snapshotFlags)?.asTypedList(countC.value) ?? Uint8List(rows),
+        bySize: column<Uint32>(_snapshotBySize)?.asTypedList(countC.value) ?? Uint32List(0),
+        byDuration: column<Uint32>(_snapshotByDuration)?.asTypedList(countC.value) ?? Uint32List(0),
+        containers: column<Uint8>(_snapshotContainer)?.asTypedList(countC.value),
+        keyframeCounts: column<Uint32>(_snapshotKeyframeCount)?.asTypedList(countC.value),
+        // Without paths every row has an empty one
+        pathOffsets: column<Uint64>(_snapshotPathOffsets)?.asTypedList(countC.value) ?? Uint64List(rows + 1),
+        pathBytes: column<Uint8>(_snapshotPathBytes)?.asTypedList(countC.value) ?? Uint8List(0),
+        close: () => _snapshotClose(handle),
+      );
+    } finally {
+      malloc.free(pathC);
+      calloc.free(countC);
+    }
+  }
+
+  /// Watches [roots] recursively and emits batches of coalesced changes.
+  ///
+  /// Event storms (e.g. a torrent client rewriting a file) are folded into one change
+  /// per path once the path has been quiet for [debounce]. Changed files are dropped
+  /// from the native probe and thumbnail caches and, when [reprobe] is true, probed
+  /// again in the background so the next duration request is served from cache.
+  /// Cancelling the subscription stops the native watch.
+  Stream<List<FileChange>> watchLibrary(List<String> roots, {Duration debounce = const Duration(milliseconds: 250), bool reprobe = true, Duration pollInterval = const Duration(milliseconds: 250)}) {
+    if (testingMode) return const Stream.empty();
+
+    late final StreamController<List<FileChange>> controller;
+    Timer? timer;
+    var handle = -1;
+    const capacity = 1024;
+    Pointer<_FsChangeRecordStruct> recordsC = nullptr;
+
+    void poll(Timer _) {
+      final changes = <FileChange>[];
+      int count;
+      // Drain everything queued since the last tick without blocking the isolate
+      do {
+        count = _watchPoll(handle, recordsC, capacity, 0);
+        for (var i = 0; i < count; i++) {
+          final record = recordsC[i];
+          changes.add(FileChange(
+            pathId: record.pathId,
+            path: pathForId(record.pathId) ?? '',
+            kind: FileChangeKind.values[record.kind - 1],
+            isDirectory: record.isDirectory != 0,
+          ));
+        }
+      } while (count == capacity);
+      if (changes.isNotEmpty) controller.add(changes);
+    }
+
+    controller = StreamController<List<FileChange>>(
+      onListen: () {
+        final ids = internPaths(roots);
+        final idsC = malloc<Uint32>(ids.length);
+        try {
+          idsC.asTypedList(ids.length).setAll(0, ids);
+          handle = _watchStart(idsC, ids.length, debounce.inMilliseconds, reprobe);
+        } finally {
+          malloc.free(idsC);
+        }
+        if (handle < 0) {
+          controller.addError(Exception('Failed to watch library roots: $roots'));
+          controller.close();
+          return;
+        }
+        recordsC = calloc<_FsChangeRecordStruct>(capacity);
+        timer = Timer.periodic(pollInterval, poll);
+      },
+      onCancel: () {
+        timer?.cancel();
+        if (handle >= 0) _watchStop(handle);
+        if (recordsC != nullptr) calloc.free(recordsC);
+        recordsC = nullptr;
+      },
+    );
+    return controller.stream;
+  }
+
   /// Extracts a thumbnail from the video at [videoPath] and saves it to [outputPath].
   /// The [size] parameter specifies the size of the thumbnail in pixels.
   Future<bool> extractCachedThumbnail({required String videoPath, required String outputPath, required int size}) async {
     if (testingMode) return _mockExtractThumbnailResult;
 
     return await Future(() {
-      final videoPathC = videoPath.toNativeUtf16();
-      final outputPathC = outputPath.toNativeUtf16();
+      final videoPathC = _toNativePath(videoPath);
+      final outputPathC = _toNativePath(outputPath);
       try {
         final success = getThumbnail(videoPathC, outputPathC, size);
         if (!success) throw Exception('Native call to get_thumbnail failed.');
@@ -118,7 +837,7 @@ class VideoDataUtils {
     if (testingMode) return _mockVideoDuration;
 
     return await Future(() {
-      final videoPathC = videoPath.toNativeUtf16();
+      final videoPathC = _toNativePath(videoPath);
       try {
         final duration = getVideoDuration(videoPathC);
         return duration;
@@ -144,7 +863,7 @@ class VideoDataUtils {
       // This returns a Pointer<_FileMetadataStruct> that points to valid memory.
       final metadataStructPtr = calloc<_FileMetadataStruct>();
 
-      final filePathC = filePath.toNativeUtf16();
+      final filePathC = _toNativePath(filePath);
       try {
         // Pass the valid pointer directly to the C++ function.
         final success = getFileMetadata(filePathC, metadataStructPtr);
@@ -186,17 +905,17 @@ class VideoDataUtils {
     if (testingMode) return _mockResolvedShortcutPath;
 
     return await Future(() {
-      final shortcutPathC = shortcutPath.replaceAll(r'"', "").toNativeUtf16();
-      // Allocate buffer for the target path (MAX_PATH = 260 characters, wide chars are 2 bytes)
-      final targetPathC = calloc<Uint16>(260);
+      // Quotes and separators are normalized natively when the path is interned
+      final shortcutId = internPaths([shortcutPath]).first;
+      final targetIdC = calloc<Uint32>();
 
       try {
-        final success = resolveShortcut(shortcutPathC, targetPathC.cast<Utf16>(), 260 * 2); // 260 chars * 2 bytes per char
+        final success = _resolveShortcutById(shortcutId, targetIdC);
 
         if (!success) throw Exception('Failed to resolve shortcut (native call returned false).');
 
-        // Convert the result back to Dart string
-        final targetPath = targetPathC.cast<Utf16>().toDartString();
+        // The target lives in the native arena, so it is never truncated
+        final targetPath = pathForId(targetIdC.value) ?? '';
 
         if (targetPath.isEmpty) throw Exception('Resolved path is empty.');
 
@@ -205,8 +924,42 @@ class VideoDataUtils {
         print('video_data_utils | Error while resolving shortcut: $e');
         throw Exception('Error while resolving shortcut: $e');
       } finally {
-        malloc.free(shortcutPathC);
-        calloc.free(targetPathC);
+        calloc.free(targetIdC);
+      }
+    });
+  }
+
+  /// Resolves many .lnk files at once; the result for a shortcut that cannot be read is null.
+  ///
+  /// Links are parsed natively in parallel and cached until the .lnk file changes.
+  /// Targets come back through the path arena, so they are never truncated.
+  Future<List<ShortcutTarget?>> resolveShortcuts(List<String> shortcutPaths) async {
+    if (testingMode) {
+      return [for (var i = 0; i < shortcutPaths.length; i++) ShortcutTarget(targetId: i, path: _mockResolvedShortcutPath, source: ShortcutSource.linkInfo, exists: true)];
+    }
+
+    return await Future(() {
+      final ids = internPaths(shortcutPaths);
+      final idsC = malloc<Uint32>(ids.length);
+      final targetsC = calloc<_ShortcutTargetStruct>(ids.length);
+      try {
+        idsC.asTypedList(ids.length).setAll(0, ids);
+        _resolveShortcutsBatch(idsC, ids.length, targetsC);
+        return [
+          for (var i = 0; i < ids.length; i++)
+            if (targetsC[i].targetId == invalidPathId)
+              null
+            else
+              ShortcutTarget(
+                targetId: targetsC[i].targetId,
+                path: pathForId(targetsC[i].targetId) ?? '',
+                source: targetsC[i].source < ShortcutSource.values.length ? ShortcutSource.values[targetsC[i].source] : ShortcutSource.none,
+                exists: targetsC[i].targetExists != 0,
+              ),
+        ];
+      } finally {
+        malloc.free(idsC);
+        calloc.free(targetsC);
       }
     });
   }
@@ -0,0 +1,237 @@
+#include "adaptive_concurrency.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+    constexpr uint32_t kMinWindow = 16;
+    // Windows between baseline probes at half the limit
+    constexpr uint32_t kProbeInterval = 32;
+    // Weight of each window's proposal; one noisy window moves the limit by a fraction only
+    constexpr double kSmoothing = 0.2;
+
+    double Milliseconds(std::chrono::steady_clock::duration d)
+    {
+        return std::chrono::duration<double, std::milli>(d).count();
+    }
+
+    ConcurrencyOptions Normalized(ConcurrencyOptions options)
+    {
+        options.min_limit = std::max<uint32_t>(options.min_limit, 1);
+        options.max_limit = std::max(options.max_limit, options.min_limit);
+        return options;
+    }
+
+    NativePath ParentDirectory(const PathChar *path)
+    {
+        NativePathView view(path);
+        size_t slash = view.find_last_of(kPathSeparator);
+#ifdef _WIN32
+        const size_t forward = view.find_last_of(L'/');
+        if (forward != NativePathView::npos && (slash == NativePathView::npos || forward > slash)) slash = forward;
+#endif
+        if (slash == NativePathView::npos) return NativePath(1, PathChar('.'));
+        return NativePath(view.substr(0, slash == 0 ? 1 : slash));
+    }
+
+    // Device (volume serial on Windows) holding @p directory, 0 if it cannot be told
+    uint64_t StorageId(const NativePath &directory)
+    {
+#ifdef _WIN32
+        wchar_t volume[MAX_PATH];
+        DWORD serial = 0;
+        if (!GetVolumePathNameW(directory.c_str(), volume, MAX_PATH) ||
+            !GetVolumeInformationW(volume, nullptr, 0, &serial, nullptr, nullptr, nullptr, 0))
+            return 0;
+        return serial;
+#else
+        struct stat st;
+        if (stat(directory.c_str(), &st) != 0) return 0;
+        return static_cast<uint64_t>(st.st_dev);
+#endif
+    }
+}
+
+// === ConcurrencyLimiter ===
+
+ConcurrencyLimiter::Permit &ConcurrencyLimiter::Permit::operator=(Permit &&other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        limiter_ = other.limiter_;
+        started_ = other.started_;
+        other.limiter_ = nullptr;
+    }
+    return *this;
+}
+
+void ConcurrencyLimiter::Permit::Release()
+{
+    if (limiter_ == nullptr) return;
+    limiter_->Complete(std::chrono::steady_clock::now() - started_);
+    limiter_ = nullptr;
+}
+
+ConcurrencyLimiter::ConcurrencyLimiter(const ConcurrencyOptions &options)
+    : options_(Normalized(options)), limit_(std::clamp(options.initial_limit, options_.min_limit, options_.max_limit)),
+      windowStart_(std::chrono::steady_clock::now())
+{
+    estimate_ = limit_;
+}
+
+ConcurrencyLimiter::Permit ConcurrencyLimiter::Acquire()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    released_.wait(lock, [this] { return inFlight_ < limit_; });
+    inFlight_++;
+    windowPeak_ = std::max(windowPeak_, inFlight_);
+    stats_.peak_in_flight = std::max(stats_.peak_in_flight, inFlight_);
+
+    Permit permit;
+    permit.limiter_ = this;
+    permit.started_ = std::chrono::steady_clock::now();
+    return permit;
+}
+
+void ConcurrencyLimiter::Complete(std::chrono::steady_clock::duration latency)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        inFlight_--;
+        stats_.completions++;
+        windowCount_++;
+        windowLatencyMs_ += Milliseconds(latency);
+        if (windowCount_ >= std::max(2 * limit_, kMinWindow)) Decide(std::chrono::steady_clock::now());
+    }
+    released_.notify_all();
+}
+
+void ConcurrencyLimiter::Decide(std::chrono::steady_clock::time_point now)
+{
+    const double mean = windowLatencyMs_ / windowCount_;
+    const double seconds = std::chrono::duration<double>(now - windowStart_).count();
+    const double throughput = seconds > 0.0 ? windowCount_ / seconds : 0.0;
+    stats_.mean_latency_ms = mean;
+    stats_.throughput = throughput;
+
+    const uint32_t before = static_cast<uint32_t>(estimate_);
+    if (probing_)
+    {
+        // The window just run at half the limit measured the device with little queueing
+        stats_.baseline_latency_ms = mean;
+        probing_ = false;
+    }
+    else
+    {
+        if (stats_.baseline_latency_ms == 0.0 || mean < stats_.baseline_latency_ms) stats_.baseline_latency_ms = mean;
+
+        // Latency at the baseline means the device absorbed every request: grow by the queue allowance.
+        // Latency above it means requests queued: shrink in proportion, by at most half per window.
+        const double gradient = std::clamp(stats_.baseline_latency_ms / mean, 0.5, 1.0);
+        double proposed = estimate_ * gradient + std::sqrt(estimate_);
+        if (windowPeak_ < limit_) proposed = std::min(proposed, estimate_); // idle windows never raise it
+        estimate_ += (proposed - estimate_) * kSmoothing;
+        if (mean > options_.latency_target_ms) estimate_ = std::min(estimate_ * 3 / 4, estimate_ - 1);
+        estimate_ = std::clamp<double>(estimate_, options_.min_limit, options_.max_limit);
+    }
+    limit_ = static_cast<uint32_t>(estimate_);
+    if (limit_ > before) stats_.increases++;
+    if (limit_ < before) stats_.decreases++;
+
+    // Every so often run one window at half the limit, so a baseline taken while the device
+    // was already queueing cannot justify the queue forever
+    if (++windows_ % kProbeInterval == 0 && limit_ > options_.min_limit)
+    {
+        probing_ = true;
+        limit_ = std::max(options_.min_limit, limit_ / 2);
+    }
+
+    windowStart_ = now;
+    windowCount_ = 0;
+    windowLatencyMs_ = 0.0;
+    windowPeak_ = inFlight_;
+}
+
+void ConcurrencyLimiter::SetOptions(const ConcurrencyOptions &options)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        options_ = Normalized(options);
+        limit_ = std::clamp(limit_, options_.min_limit, options_.max_limit);
+        estimate_ = limit_;
+    }
+    released_.notify_all();
+}
+
+uint32_t ConcurrencyLimiter::Limit() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return limit_;
+}
+
+ConcurrencyStats ConcurrencyLimiter::Stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ConcurrencyStats stats = stats_;
+    stats.limit = limit_;
+    stats.in_flight = inFlight_;
+    return stats;
+}
+
+// === StorageConcurrency ===
+
+StorageConcurrency &StorageConcurrency::Instance()
+{
+    static StorageConcurrency storage;
+    return storage;
+}
+
+ConcurrencyLimiter &StorageConcurrency::For(const PathChar *path)
+{
+    NativePath directory = ParentDirectory(path);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = directories_.find(directory);
+        if (it != directories_.end()) return *it->second;
+    }
+
+    // The stat runs unlocked; a racing lookup of the same directory lands on the same limiter
+    const uint64_t id = StorageId(directory);
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto root = std::find_if(limiters_.begin(), limiters_.end(), [id](const auto &entry) { return entry.first == id; });
+    if (root == limiters_.end())
+    {
+        limiters_.emplace_back(id, std::make_unique<ConcurrencyLimiter>(options_));
+        root = limiters_.end() - 1;
+    }
+    if (directories_.size() >= kMaxCachedDirectories) directories_.clear();
+    directories_.emplace(std::move(directory), root->second.get());
+    return *root->second;
+}
+
+void StorageConcurrency::SetOptions(const ConcurrencyOptions &options)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+    for (auto &entry : limiters_) entry.second->SetOptions(options);
+}
+
+ConcurrencyOptions StorageConcurrency::Options() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return options_;
+}
+
+void StorageConcurrency::Snapshot(std::vector<std::pair<uint64_t, ConcurrencyStats>> *roots) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    roots->clear();
+    for (const auto &entry : limiters_) roots->emplace_back(entry.first, entry.second->Stats());
+}
@@ -0,0 +1,133 @@
+#ifndef ADAPTIVE_CONCURRENCY_H
+#define ADAPTIVE_CONCURRENCY_H
+
+#include "native_path.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+struct ConcurrencyOptions
+{
+    uint32_t min_limit = 1;
+    uint32_t max_limit = 32;
+    uint32_t initial_limit = 4;
+    // Mean operation latency above which the limit is cut
+    uint32_t latency_target_ms = 250;
+};
+
+struct ConcurrencyStats
+{
+    uint32_t limit = 0;
+    uint32_t in_flight = 0;
+    uint32_t peak_in_flight = 0;
+    uint64_t completions = 0;
+    uint64_t increases = 0;
+    uint64_t decreases = 0;
+    double mean_latency_ms = 0.0;     // over the last window
+    double baseline_latency_ms = 0.0; // lowest window mean since the last probe at half the limit
+    double throughput = 0.0;          // completions per second over the last window
+};
+
+/**
+ * @brief Gradient-style limit on operations in flight, tuned by their latency.
+ *
+ * Each window of completions (twice the limit, at least 16) ends in one
+ * decision. The ratio of the baseline latency to the window's mean says how
+ * much of the concurrency the device actually served: where it stays near 1
+ * (an SSD with deep queues) the limit grows by roughly its square root per
+ * window; where latency climbs with the limit (a spinning disk or a saturated
+ * share) it settles just above the concurrency the device can absorb. A mean
+ * over the latency target cuts the limit by a quarter. Windows that never
+ * filled the limit cannot raise it.
+ */
+class ConcurrencyLimiter
+{
+public:
+    explicit ConcurrencyLimiter(const ConcurrencyOptions &options = {});
+
+    ConcurrencyLimiter(const ConcurrencyLimiter &) = delete;
+    ConcurrencyLimiter &operator=(const ConcurrencyLimiter &) = delete;
+
+    // Held for the duration of one operation; its latency is recorded on release. Move-only.
+    class Permit
+    {
+    public:
+        Permit() = default;
+        Permit(Permit &&other) noexcept : limiter_(other.limiter_), started_(other.started_) { other.limiter_ = nullptr; }
+        Permit &operator=(Permit &&other) noexcept;
+        ~Permit() { Release(); }
+
+        void Release();
+
+    private:
+        friend class ConcurrencyLimiter;
+        ConcurrencyLimiter *limiter_ = nullptr;
+        std::chrono::steady_clock::time_point started_;
+    };
+
+    // Blocks while the limit is reached.
+    Permit Acquire();
+
+    void SetOptions(const ConcurrencyOptions &options);
+    uint32_t Limit() const;
+    ConcurrencyStats Stats() const;
+
+private:
+    void Complete(std::chrono::steady_clock::duration latency);
+    void Decide(std::chrono::steady_clock::time_point now);
+
+    mutable std::mutex mutex_;
+    std::condition_variable released_;
+    ConcurrencyOptions options_;
+    uint32_t limit_;
+    uint32_t inFlight_ = 0;
+    ConcurrencyStats stats_;
+
+    // Current window
+    std::chrono::steady_clock::time_point windowStart_;
+    uint32_t windowCount_ = 0;
+    double windowLatencyMs_ = 0.0;
+    uint32_t windowPeak_ = 0;
+
+    double estimate_;       // limit_ before rounding down
+    bool probing_ = false;  // this window runs at half the limit to re-measure the baseline
+    uint32_t windows_ = 0;
+};
+
+/**
+ * @brief One ConcurrencyLimiter per storage device or volume.
+ *
+ * Files are keyed by the device of their parent directory (the volume serial
+ * number on Windows), cached per directory so a batch over one folder costs a
+ * single extra stat.
+ */
+class StorageConcurrency
+{
+public:
+    static StorageConcurrency &Instance();
+
+    ConcurrencyLimiter &For(const PathChar *path);
+
+    // Applies to every storage root, current and future.
+    void SetOptions(const ConcurrencyOptions &options);
+    ConcurrencyOptions Options() const;
+
+    // (storage ID, stats) of every root seen so far, in first-seen order
+    void Snapshot(std::vector<std::pair<uint64_t, ConcurrencyStats>> *roots) const;
+
+private:
+    StorageConcurrency() = default;
+
+    static constexpr size_t kMaxCachedDirectories = 4096;
+
+    mutable std::mutex mutex_;
+    ConcurrencyOptions options_;
+    std::vector<std::pair<uint64_t, std::unique_ptr<ConcurrencyLimiter>>> limiters_;
+    std::unordered_map<NativePath, ConcurrencyLimiter *> directories_;
+};
+
+#endif // ADAPTIVE_CONCURRENCY_H
@@ -0,0 +1,500 @@
+#include "batch_probe.h"
+#include "adaptive_concurrency.h"
+#include "byte_source.h"
+#include "file_metadata.h"
+#include "io_schedule.h"
+#include "media_probe.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <thread>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// statx support in the C library is the proxy for headers new enough to describe io_uring
+#if defined(__linux__) && defined(STATX_BTIME)
+#define VDU_HAVE_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+namespace
+{
+    void Finish(const DurationProbe &probe, ProbeStep step, BatchProbeResult *result)
+    {
+        result->container = probe.Container();
+        result->reads = probe.Reads();
+        result->bytes_read = probe.BytesRead();
+        result->has_duration = step.kind == ProbeStep::Done && probe.DurationMs() > 0.0;
+        result->duration_ms = result->has_duration ? probe.DurationMs() : 0.0;
+        result->duration_method = probe.Method();
+    }
+
+    void RunThreadPool(const std::vector<const PathChar *> &paths, const std::vector<DeviceQueue> &queues,
+                       std::vector<BatchProbeResult> *results, uint32_t maxInFlight)
+    {
+        // Blocking reads only overlap across the shared pool's threads and the caller, at most
+        // maxInFlight of them. Within that, each storage root's limiter decides how many may be
+        // probing it at once.
+        const size_t lanes = std::min<size_t>(paths.size(), std::max<uint32_t>(maxInFlight, 1));
+        std::unique_ptr<std::atomic<size_t>[]> next(new std::atomic<size_t>[queues.size()]);
+        for (size_t q = 0; q < queues.size(); q++) next[q] = 0;
+
+        WorkerPool::Instance().ParallelFor(lanes, [&](size_t t) {
+            // A device stalled on seeks keeps its own lanes busy without holding up the others
+            for (size_t k = 0; k < queues.size(); k++)
+            {
+                const DeviceQueue &queue = queues[(t + k) % queues.size()];
+                std::atomic<size_t> &cursor = next[(t + k) % queues.size()];
+                for (size_t j = cursor++; j < queue.order.size(); j = cursor++)
+                {
+                    const size_t i = queue.order[j];
+                    ConcurrencyLimiter::Permit permit = StorageConcurrency::Instance().For(paths[i]).Acquire();
+                    ProbeFileDuration(paths[i], &(*results)[i]);
+                }
+            }
+        });
+    }
+
+#ifdef VDU_HAVE_IO_URING
+    int IoUringSetup(unsigned entries, io_uring_params *params)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+    }
+
+    int IoUringEnter(int fd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_enter, fd, toSubmit, minComplete, flags, nullptr, 0));
+    }
+
+    int IoUringRegister(int fd, unsigned opcode, void *arg, unsigned count)
+    {
+        return static_cast<int>(syscall(__NR_io_uring_register, fd, opcode, arg, count));
+    }
+
+    // Minimal io_uring: the two rings mapped by hand, no SQPOLL, no registered files
+    class IoUring
+    {
+    public:
+        ~IoUring()
+        {
+            if (sqes_ != nullptr) munmap(sqes_, sqesSize_);
+            if (cqRing_ != nullptr && cqRing_ != sqRing_) munmap(cqRing_, cqRingSize_);
+            if (sqRing_ != nullptr) munmap(sqRing_, sqRingSize_);
+            if (fd_ >= 0) close(fd_);
+        }
+
+        bool Init(unsigned entries)
+        {
+            io_uring_params params = {};
+            fd_ = IoUringSetup(entries, &params);
+            if (fd_ < 0) return false;
+
+            sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+            cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+            const bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+            if (singleMmap) sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+            sqRing_ = Map(sqRingSize_, IORING_OFF_SQ_RING);
+            if (sqRing_ == nullptr) return false;
+            cqRing_ = singleMmap ? sqRing_ : Map(cqRingSize_, IORING_OFF_CQ_RING);
+            if (cqRing_ == nullptr) return false;
+            sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+            sqes_ = static_cast<io_uring_sqe *>(Map(sqesSize_, IORING_OFF_SQES));
+            if (sqes_ == nullptr) return false;
+
+            uint8_t *sq = static_cast<uint8_t *>(sqRing_);
+            sqHead_ = reinterpret_cast<unsigned *>(sq + params.sq_off.head);
+            sqTail_ = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+            sqMask_ = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+            sqEntries_ = params.sq_entries;
+            sqArray_ = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+            sqLocalTail_ = *sqTail_;
+            sqFirst_ = sqLocalTail_;
+
+            uint8_t *cq = static_cast<uint8_t *>(cqRing_);
+            cqHead_ = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+            cqTail_ = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+            cqMask_ = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+            cqes_ = reinterpret_cast<io_uring_cqe *>(cq + params.cq_off.cqes);
+            return true;
+        }
+
+        int Fd() const { return fd_; }
+
+        // Next free submission slot, zeroed, or nullptr when the queue is full
+        io_uring_sqe *NextSqe()
+        {
+            const unsigned head = __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+            if (sqLocalTail_ - head >= sqEntries_) return nullptr;
+            const unsigned index = sqLocalTail_ & sqMask_;
+            sqArray_[index] = index;
+            sqLocalTail_++;
+            io_uring_sqe *sqe = &sqes_[index];
+            std::memset(sqe, 0, sizeof(*sqe));
+            return sqe;
+        }
+
+        // Publishes queued entries and waits for at least minComplete completions. Entries the
+        // kernel has not consumed yet, from this call or an earlier refused one, are submitted again.
+        bool SubmitAndWait(unsigned minComplete)
+        {
+            __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+            for (;;)
+            {
+                const unsigned toSubmit = sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE);
+                const int ret = IoUringEnter(fd_, toSubmit, minComplete, minComplete > 0 ? IORING_ENTER_GETEVENTS : 0);
+                if (ret >= 0) return true;
+                if (errno == EINTR) continue;
+                if (errno != EBUSY && errno != EAGAIN) return false;
+                // Nothing was taken: completions must be reaped first, and the caller's next call resubmits
+                if (CompletionsReady()) return true;
+                std::this_thread::yield();
+            }
+        }
+
+        bool CompletionsReady() const { return *cqHead_ != __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE); }
+
+        // Entries the kernel has taken whose completions have not been drained; each yields exactly one
+        unsigned InFlight() const { return __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) - sqFirst_ - reaped_; }
+
+        // Waits out every entry the kernel has taken, so none still targets the caller's memory; entries
+        // it never took die with the ring. False when the kernel cannot be waited on.
+        template <typename Handler>
+        bool Quiesce(Handler &&handler)
+        {
+            for (;;)
+            {
+                DrainCompletions(handler);
+                if (InFlight() == 0) return true;
+                if (IoUringEnter(fd_, 0, 1, IORING_ENTER_GETEVENTS) >= 0) continue;
+                if (errno != EINTR && errno != EBUSY && errno != EAGAIN) return false;
+                std::this_thread::yield();
+            }
+        }
+
+        template <typename Handler>
+        unsigned DrainCompletions(Handler &&handler)
+        {
+            unsigned head = *cqHead_;
+            const unsigned tail = __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE);
+            unsigned handled = 0;
+            for (; head != tail; head++, handled++)
+            {
+                const io_uring_cqe cqe = cqes_[head & cqMask_];
+                __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE); // frees the slot before the handler queues more
+                reaped_++;
+                handler(cqe);
+            }
+            return handled;
+        }
+
+    private:
+        void *Map(size_t size, off_t offset)
+        {
+            void *ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, offset);
+            return ptr == MAP_FAILED ? nullptr : ptr;
+        }
+
+        int fd_ = -1;
+        void *sqRing_ = nullptr;
+        void *cqRing_ = nullptr;
+        io_uring_sqe *sqes_ = nullptr;
+        size_t sqRingSize_ = 0;
+        size_t cqRingSize_ = 0;
+        size_t sqesSize_ = 0;
+
+        unsigned *sqHead_ = nullptr;
+        unsigned *sqTail_ = nullptr;
+        unsigned *sqArray_ = nullptr;
+        unsigned sqMask_ = 0;
+        unsigned sqEntries_ = 0;
+        unsigned sqLocalTail_ = 0;
+        unsigned sqFirst_ = 0;
+        unsigned reaped_ = 0;
+
+        unsigned *cqHead_ = nullptr;
+        unsigned *cqTail_ = nullptr;
+        unsigned cqMask_ = 0;
+        io_uring_cqe *cqes_ = nullptr;
+    };
+
+    enum IoOp : uint8_t
+    {
+        kOpOpen,
+        kOpStat,
+        kOpRead,
+        kOpClose,
+    };
+
+    // One file in the window. Open and statx run concurrently; reads follow one another.
+    struct UringSlot
+    {
+        size_t index = 0;
+        int fd = -1;
+        int outstanding = 0;
+        bool statOk = false;
+        bool failed = false;
+        struct statx stx;
+        DurationProbe probe;
+        ProbeStep step;
+        std::vector<uint8_t> buffer;
+    };
+
+    inline uint64_t UserData(size_t slot, IoOp op) { return (static_cast<uint64_t>(slot) << 8) | op; }
+
+    // Leaves the ring with nothing in flight and every file it opened closed, before the caller
+    // falls back. If the kernel cannot be waited on, the slots are leaked: a read still running
+    // would otherwise land in freed buffers.
+    void Abandon(IoUring &ring, std::vector<UringSlot> *slots)
+    {
+        const bool quiet = ring.Quiesce([&](const io_uring_cqe &cqe) {
+            UringSlot &slot = (*slots)[static_cast<size_t>(cqe.user_data >> 8)];
+            const IoOp op = static_cast<IoOp>(cqe.user_data & 0xFF);
+            if (op == kOpOpen && cqe.res >= 0) slot.fd = cqe.res;
+            else if (op == kOpClose) slot.fd = -1;
+        });
+        if (!quiet)
+        {
+            new std::vector<UringSlot>(std::move(*slots));
+            return;
+        }
+        for (UringSlot &slot : *slots)
+        {
+            if (slot.fd >= 0) close(slot.fd);
+            slot.fd = -1;
+        }
+    }
+
+    bool RunIoUring(const std::vector<const PathChar *> &paths, std::vector<BatchProbeResult> *results, uint32_t maxInFlight)
+    {
+        const size_t window = std::min<size_t>(std::max<uint32_t>(maxInFlight, 1), paths.size());
+        IoUring ring;
+        // At most two operations per slot are ever queued at once
+        if (!ring.Init(static_cast<unsigned>(window * 2))) return false;
+
+        std::vector<UringSlot> slots(window);
+        std::vector<size_t> freeSlots;
+        for (size_t s = window; s-- > 0;) freeSlots.push_back(s);
+        size_t next = 0;
+        size_t active = 0;
+
+        auto queueRead = [&](size_t s) {
+            UringSlot &slot = slots[s];
+            if (slot.buffer.size() < slot.step.range.length)
+                slot.buffer.resize(std::max<size_t>(slot.step.range.length, DurationProbe::kHeadBytes));
+            io_uring_sqe *sqe = ring.NextSqe();
+            sqe->opcode = IORING_OP_READ;
+            sqe->fd = slot.fd;
+            sqe->addr = reinterpret_cast<uint64_t>(slot.buffer.data());
+            sqe->len = slot.step.range.length;
+            sqe->off = slot.step.range.offset;
+            sqe->user_data = UserData(s, kOpRead);
+            slot.outstanding++;
+        };
+
+        auto queueCloseOrRetire = [&](size_t s) {
+            UringSlot &slot = slots[s];
+            BatchProbeResult &result = (*results)[slot.index];
+            Finish(slot.probe, slot.step, &result);
+            if (slot.fd >= 0)
+            {
+                io_uring_sqe *sqe = ring.NextSqe();
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = slot.fd;
+                sqe->user_data = UserData(s, kOpClose);
+                slot.outstanding++; // the fd stays recorded until the close completes
+                return;
+            }
+            freeSlots.push_back(s);
+            active--;
+        };
+
+        auto startFile = [&](size_t s, size_t index) {
+            UringSlot &slot = slots[s];
+            slot.index = index;
+            slot.fd = -1;
+            slot.statOk = slot.failed = false;
+            slot.probe = DurationProbe();
+            slot.step = ProbeStep::Fail();
+
+            io_uring_sqe *open = ring.NextSqe();
+            open->opcode = IORING_OP_OPENAT;
+            open->fd = AT_FDCWD;
+            open->addr = reinterpret_cast<uint64_t>(paths[index]);
+            open->open_flags = O_RDONLY | O_CLOEXEC;
+            open->user_data = UserData(s, kOpOpen);
+
+            io_uring_sqe *stat = ring.NextSqe();
+            stat->opcode = IORING_OP_STATX;
+            stat->fd = AT_FDCWD;
+            stat->addr = reinterpret_cast<uint64_t>(paths[index]);
+            stat->len = STATX_BASIC_STATS | STATX_BTIME;
+            stat->off = reinterpret_cast<uint64_t>(&slot.stx);
+            stat->user_data = UserData(s, kOpStat);
+            slot.outstanding = 2;
+        };
+
+        auto onCompletion = [&](const io_uring_cqe &cqe) {
+            const size_t s = static_cast<size_t>(cqe.user_data >> 8);
+            const IoOp op = static_cast<IoOp>(cqe.user_data & 0xFF);
+            UringSlot &slot = slots[s];
+            BatchProbeResult &result = (*results)[slot.index];
+            slot.outstanding--;
+
+            switch (op)
+            {
+            case kOpOpen:
+                if (cqe.res >= 0)
+                {
+                    slot.fd = cqe.res;
+                    result.opened = true;
+                }
+                else
+                    slot.failed = true;
+                break;
+            case kOpStat:
+                slot.statOk = cqe.res >= 0;
+                if (slot.statOk) FileMetadataFromStatx(slot.stx, &result.metadata);
+                else slot.failed = true;
+                break;
+            case kOpRead:
+            {
+                const size_t length = cqe.res > 0 ? static_cast<size_t>(cqe.res) : 0;
+                slot.step = slot.probe.OnData(slot.step.range.offset, slot.buffer.data(), length);
+                if (slot.step.kind == ProbeStep::Read) queueRead(s); // the parser's continuation
+                else queueCloseOrRetire(s);
+                return;
+            }
+            case kOpClose:
+                slot.fd = -1;
+                freeSlots.push_back(s);
+                active--;
+                return;
+            }
+
+            // Both the open and the statx are back: start the probe or give up
+            if (slot.outstanding > 0) return;
+            if (!slot.failed) slot.step = slot.probe.Start(slot.stx.stx_size);
+            if (!slot.failed && slot.step.kind == ProbeStep::Read) queueRead(s);
+            else queueCloseOrRetire(s);
+        };
+
+        while (next < paths.size() || active > 0)
+        {
+            while (next < paths.size() && !freeSlots.empty())
+            {
+                const size_t s = freeSlots.back();
+                freeSlots.pop_back();
+                startFile(s, next++);
+                active++;
+            }
+            if (!ring.SubmitAndWait(1))
+            {
+                Abandon(ring, &slots);
+                return false;
+            }
+            ring.DrainCompletions(onCompletion);
+        }
+        return true;
+    }
+#endif
+}
+
+void ProbeFileDuration(const PathChar *path, BatchProbeResult *result)
+{
+    *result = BatchProbeResult();
+    if (path == nullptr || !ReadFileMetadata(path, &result->metadata)) return;
+
+    std::unique_ptr<ByteSource> source = OpenFileSource(path, AccessPattern::Random);
+    if (!source) return;
+    result->opened = true;
+
+    DurationProbe probe;
+    Finish(probe, RunProbe(probe, *source), result);
+    result->bytes_read = source->BytesRead();
+}
+
+bool IoUringSupported()
+{
+#ifdef VDU_HAVE_IO_URING
+    static const bool supported = []() {
+        IoUring ring;
+        if (!ring.Init(4)) return false;
+
+        const size_t probeSize = sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op);
+        std::vector<uint8_t> storage(probeSize, 0);
+        io_uring_probe *probe = reinterpret_cast<io_uring_probe *>(storage.data());
+        if (IoUringRegister(ring.Fd(), IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+
+        for (uint8_t op : {IORING_OP_OPENAT, IORING_OP_STATX, IORING_OP_READ, IORING_OP_CLOSE})
+        {
+            if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+        }
+        return true;
+    }();
+    return supported;
+#else
+    return false;
+#endif
+}
+
+BatchBackend ProbeDurationsBatch(const std::vector<const PathChar *> &paths, std::vector<BatchProbeResult> *results,
+                                 const BatchProbeOptions &options)
+{
+    results->assign(paths.size(), BatchProbeResult());
+    if (paths.empty()) return options.backend;
+
+    BatchBackend backend = options.backend;
+    if (backend == BatchBackend::Auto) backend = IoUringSupported() ? BatchBackend::IoUring : BatchBackend::ThreadPool;
+
+    std::vector<DeviceQueue> queues;
+    if (options.order == ProbeOrder::Physical) queues = PlanDeviceQueues(paths);
+    else
+    {
+        queues.emplace_back();
+        queues.back().order.resize(paths.size());
+        for (size_t i = 0; i < paths.size(); i++) queues.back().order[i] = i;
+    }
+
+#ifdef VDU_HAVE_IO_URING
+    if (backend == BatchBackend::IoUring)
+    {
+        // Submissions follow the queues one device after another; completions are put back in place
+        std::vector<const PathChar *> ordered;
+        std::vector<size_t> position;
+        for (const DeviceQueue &queue : queues)
+        {
+            for (size_t i : queue.order)
+            {
+                ordered.push_back(paths[i]);
+                position.push_back(i);
+            }
+        }
+        std::vector<BatchProbeResult> completed(paths.size());
+        if (IoUringSupported() && RunIoUring(ordered, &completed, options.max_in_flight))
+        {
+            for (size_t j = 0; j < position.size(); j++) (*results)[position[j]] = completed[j];
+            return backend;
+        }
+        // Seccomp filters and container runtimes can refuse io_uring at any point
+        std::cerr << "batch_probe | io_uring unavailable, falling back to the thread pool" << std::endl;
+    }
+#endif
+    if (backend == BatchBackend::Sequential)
+    {
+        for (const DeviceQueue &queue : queues)
+            for (size_t i : queue.order) ProbeFileDuration(paths[i], &(*results)[i]);
+        return backend;
+    }
+    RunThreadPool(paths, queues, results, options.max_in_flight);
+    return BatchBackend::ThreadPool;
+}
@@ -0,0 +1,71 @@
+#ifndef BATCH_PROBE_H
+#define BATCH_PROBE_H
+
+#include "content_sniffer.h"
+#include "media_probe.h"
+#include "native_path.h"
+#include "video_data_exporter_api.h"
+#include <cstdint>
+#include <vector>
+
+enum class BatchBackend : uint8_t
+{
+    Auto,       // io_uring where the kernel supports it, the thread pool otherwise
+    Sequential, // one file after another on the calling thread
+    ThreadPool, // blocking positional reads on the shared WorkerPool and the calling thread
+    IoUring,    // Linux only
+};
+
+enum class ProbeOrder : uint8_t
+{
+    AsGiven,  // the order of the paths, e.g. directory order
+    Physical, // one queue per device, each an elevator sweep over the files' disk positions (see io_schedule.h)
+};
+
+struct BatchProbeOptions
+{
+    BatchBackend backend = BatchBackend::Auto;
+    // Files open at once; bounds descriptors, buffers and queue depth
+    uint32_t max_in_flight = 64;
+    ProbeOrder order = ProbeOrder::AsGiven;
+};
+
+struct BatchProbeResult
+{
+    FileMetadata metadata = {};
+    ContainerKind container = ContainerKind::Unknown;
+    double duration_ms = 0.0;
+    DurationMethod duration_method = DurationMethod::None;
+    uint32_t reads = 0;
+    uint64_t bytes_read = 0;
+    bool opened = false;
+    bool has_duration = false;
+};
+
+/**
+ * @brief Stats and reads the duration of many files using header-level reads only.
+ *
+ * Every file goes through a DurationProbe, so each one costs a sniff of the
+ * head plus the handful of follow-up reads the container needs. With io_uring
+ * the open, statx and every read of all files in the window are submitted
+ * together and each follow-up read is queued from the previous completion.
+ * The thread pool also holds every storage root to the limit its
+ * StorageConcurrency limiter has learned, so a slow share or spinning disk
+ * gets fewer of the threads than an SSD beside it. With ProbeOrder::Physical
+ * the threads start on one device queue each and help the others once theirs
+ * is drained; the other backends walk the queues one device after another.
+ *
+ * @param paths Paths that stay valid until the call returns (arena paths do)
+ * @param results Resized to paths.size(); results[i] belongs to paths[i]
+ * @return The backend that actually ran
+ */
+BatchBackend ProbeDurationsBatch(const std::vector<const PathChar *> &paths, std::vector<BatchProbeResult> *results,
+                                 const BatchProbeOptions &options = {});
+
+// Single-file form of the sequential backend
+void ProbeFileDuration(const PathChar *path, BatchProbeResult *result);
+
+// True if the running kernel supports every io_uring operation the batch needs.
+bool IoUringSupported();
+
+#endif // BATCH_PROBE_H
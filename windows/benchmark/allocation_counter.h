@@ -0,0 +1,16 @@
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+
+// Heap allocations made through operator new by any thread since the benchmark binary started.
+uint64_t AllocationCount();
+
+// Reports allocations per iteration of @p state, counted from @p before.
+inline void ReportAllocations(benchmark::State &state, uint64_t before)
+{
+    state.counters["allocs/op"] = benchmark::Counter(static_cast<double>(AllocationCount() - before), benchmark::Counter::kAvgIterations);
+}
+
+#endif // ALLOCATION_COUNTER_H
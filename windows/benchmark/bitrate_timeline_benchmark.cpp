@@ -0,0 +1,110 @@
+// Bitrate timelines of generated files on disk, through the same small
+// read-ahead source the export opens. kb_read is what the build pulled from the
+// file; read_pct the share of the file that is.
+//
+// BM_BitrateMp4 reads the sample tables of a two-hour film (24 fps video and
+// 48 kHz AAC-sized audio, moov after a sparse mdat). BM_BitrateMkv reads two
+// minutes of Matroska with one-second clusters and Cues: one-second buckets
+// come from the Cues alone, finer ones walk every block header.
+
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../bitrate_timeline.h"
+#include "../test/media_fixtures.h"
+
+namespace fs = std::filesystem;
+using namespace video_data_utils::fixtures;
+
+namespace
+{
+    constexpr uint32_t kFilmSeconds = 2 * 60 * 60;
+    constexpr uint32_t kClipSeconds = 120;
+
+    std::string FilmMp4()
+    {
+        const uint32_t videoSamples = kFilmSeconds * 24;
+        const uint32_t audioSamples = kFilmSeconds * 48000 / 1024;
+        std::string video = Be32(0) + Be32(videoSamples), audio = Be32(0) + Be32(audioSamples);
+        for (uint32_t i = 0; i < videoSamples; i++) video += Be32(i % 48 == 0 ? 60000 : 4000 + i % 1000);
+        for (uint32_t i = 0; i < audioSamples; i++) audio += Be32(300 + i % 64);
+        const std::string stsc = FullBox("stsc", Be32(1) + Be32(1) + Be32(1) + Be32(1));
+        return Box("moov", Mvhd(1000, uint64_t(kFilmSeconds) * 1000) +
+                               Trak("vide", 24000, FullBox("stts", Be32(1) + Be32(videoSamples) + Be32(1000)) + stsc + FullBox("stsz", video)) +
+                               Trak("soun", 48000, FullBox("stts", Be32(1) + Be32(audioSamples) + Be32(1024)) + stsc + FullBox("stsz", audio)));
+    }
+
+    std::string ClipMkv()
+    {
+        std::vector<std::pair<uint64_t, std::string>> clusters;
+        for (uint64_t second = 0; second < kClipSeconds; second++)
+        {
+            std::string blocks;
+            for (int frame = 0; frame < 25; frame++)
+            {
+                blocks += SimpleBlock(2, static_cast<int16_t>(frame * 40), frame == 0, frame == 0 ? 80000 : 12000);
+                blocks += SimpleBlock(1, static_cast<int16_t>(frame * 40), true, 400);
+            }
+            clusters.push_back({second * 1000, blocks});
+        }
+        return MkvWithClusters(clusters, true, nullptr, kClipSeconds * 1000.0);
+    }
+
+    class GeneratedFiles
+    {
+    public:
+        GeneratedFiles()
+        {
+            root_ = fs::temp_directory_path() / "bench_vdu_bitrate";
+            fs::remove_all(root_);
+            fs::create_directories(root_);
+            mp4_ = root_ / "film.mp4";
+            const uint64_t mdatBytes = 1ull << 30;
+            WriteFile(mp4_, Mp4MoovAtEndHead(mdatBytes), mdatBytes, FilmMp4());
+            mkv_ = root_ / "clip.mkv";
+            WriteFile(mkv_, ClipMkv());
+        }
+
+        ~GeneratedFiles() { fs::remove_all(root_); }
+
+        const fs::path &Mp4() const { return mp4_; }
+        const fs::path &Mkv() const { return mkv_; }
+
+    private:
+        fs::path root_, mp4_, mkv_;
+    };
+
+    const GeneratedFiles &Files()
+    {
+        static GeneratedFiles files;
+        return files;
+    }
+
+    void Run(benchmark::State &state, const fs::path &path, uint32_t bucketMs)
+    {
+        uint64_t bytes = 0, size = 0;
+        BitrateTimeline timeline;
+        for (auto _ : state)
+        {
+            std::unique_ptr<ByteSource> source = OpenFileSource(path.c_str(), AccessPattern::Random, 512);
+            if (!BuildBitrateTimeline(*source, bucketMs, &timeline))
+            {
+                state.SkipWithError("no timeline");
+                return;
+            }
+            bytes += source->BytesRead();
+            size = source->Size();
+        }
+        state.counters["buckets"] = static_cast<double>(timeline.kbps.size());
+        state.counters["kb_read"] = bytes / 1024.0 / state.iterations();
+        state.counters["read_pct"] = 100.0 * bytes / state.iterations() / size;
+    }
+
+    void BM_BitrateMp4(benchmark::State &state) { Run(state, Files().Mp4(), static_cast<uint32_t>(state.range(0))); }
+    BENCHMARK(BM_BitrateMp4)->ArgName("bucket_ms")->Arg(1000)->Unit(benchmark::kMillisecond);
+
+    void BM_BitrateMkv(benchmark::State &state) { Run(state, Files().Mkv(), static_cast<uint32_t>(state.range(0))); }
+    BENCHMARK(BM_BitrateMkv)->ArgName("bucket_ms")->Arg(1000)->Arg(100)->Unit(benchmark::kMillisecond);
+}
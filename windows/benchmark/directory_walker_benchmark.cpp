@@ -0,0 +1,100 @@
+// The parallel directory walker against std::filesystem's recursive iterator.
+//
+// The tree is generated once: 40 top-level folders of 10 subfolders with 20
+// files each, plus one 200-level deep chain, so that a thread that went deep
+// leaves the wide part for others to steal. Listings come from the dentry
+// cache here, so the numbers are the walker's own overhead and its scaling
+// with threads; on a network share, where each listing is a round trip, the
+// thread count is what decides the time.
+
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../directory_walker.h"
+#include "../test/media_fixtures.h"
+
+namespace fs = std::filesystem;
+using namespace video_data_utils::fixtures;
+
+namespace
+{
+    class GeneratedTree
+    {
+    public:
+        GeneratedTree()
+        {
+            root_ = fs::temp_directory_path() / "bench_vdu_directory_walker";
+            fs::remove_all(root_);
+            for (int a = 0; a < 40; a++)
+            {
+                for (int b = 0; b < 10; b++)
+                {
+                    const fs::path dir = root_ / ("show" + std::to_string(a)) / ("season" + std::to_string(b));
+                    fs::create_directories(dir);
+                    for (int i = 0; i < 20; i++) WriteFile(dir / ("episode" + std::to_string(i) + ".mkv"), "v");
+                }
+            }
+            fs::path deep = root_ / "archive";
+            for (int i = 0; i < 200; i++) deep /= "d" + std::to_string(i);
+            fs::create_directories(deep);
+        }
+
+        ~GeneratedTree() { fs::remove_all(root_); }
+
+        const fs::path &Root() const { return root_; }
+
+    private:
+        fs::path root_;
+    };
+
+    const GeneratedTree &Tree()
+    {
+        static GeneratedTree tree;
+        return tree;
+    }
+
+    void BM_RecursiveDirectoryIterator(benchmark::State &state)
+    {
+        const fs::path &root = Tree().Root();
+        size_t entries = 0;
+        for (auto _ : state)
+        {
+            entries = 0;
+            for (const auto &entry : fs::recursive_directory_iterator(root))
+            {
+                benchmark::DoNotOptimize(entry.is_directory());
+                entries++;
+            }
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * entries));
+    }
+
+    void Walk(benchmark::State &state, bool ordered)
+    {
+        WalkOptions options;
+        options.threads = static_cast<uint32_t>(state.range(0));
+        options.ordered = ordered;
+        const NativePath root = Tree().Root().native();
+        size_t entries = 0;
+        WalkStats stats;
+        for (auto _ : state)
+        {
+            entries = 0;
+            WalkDirectory(root, options, [&](std::vector<WalkEntry> &&batch) {
+                entries += batch.size();
+                return true;
+            }, &stats);
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * entries));
+        state.counters["steals"] = static_cast<double>(stats.steals);
+    }
+
+    void BM_WalkDirectory(benchmark::State &state) { Walk(state, false); }
+    void BM_WalkDirectoryOrdered(benchmark::State &state) { Walk(state, true); }
+}
+
+BENCHMARK(BM_RecursiveDirectoryIterator)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_WalkDirectory)->Arg(1)->Arg(4)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_WalkDirectoryOrdered)->Arg(1)->Arg(8)->Unit(benchmark::kMillisecond)->UseRealTime();
@@ -0,0 +1,204 @@
+// Cost per box or element of the compile-time dispatch tables against a
+// generic runtime parser: the same walk, with the rules in a hash map and
+// the handlers behind std::function.
+//
+// The inputs are a moov with many tracks and a Matroska Tracks element with
+// many entries, walked with the streams rules. The time counter is the cost of
+// one element header, its lookup and, for the few that match, the handler.
+
+#include <benchmark/benchmark.h>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+#include "../element_dispatch.h"
+#include "../test/media_fixtures.h"
+
+using namespace video_data_utils::fixtures;
+
+namespace
+{
+    constexpr int kTracks = 64;
+
+    std::string StreamsMoov()
+    {
+        std::string traks;
+        for (int i = 0; i < kTracks; i++)
+        {
+            const std::string entry = Box("avc1", std::string(24, '\0') + Be16(1920) + Be16(1080) + std::string(50, '\0'));
+            const std::string stbl = FullBox("stsd", Be32(1) + entry) + FullBox("stts", Be32(0)) + FullBox("stss", Be32(0)) +
+                                     FullBox("stsc", Be32(0)) + FullBox("stsz", Be32(0) + Be32(0)) + FullBox("stco", Be32(0));
+            const std::string trak = Trak(i % 2 ? "soun" : "vide", 1000, stbl);
+            traks += Box("trak", FullBox("tkhd", std::string(80, '\0')) + Box("edts", std::string(24, '\0')) + trak.substr(8));
+        }
+        return Box("moov", Mvhd(1000, 5000) + traks + Box("udta", std::string(64, '\0')));
+    }
+
+    std::string StreamsTracks()
+    {
+        std::string entries;
+        for (int i = 0; i < kTracks; i++)
+        {
+            entries += Ebml(0xAE, EbmlUInt(0xD7, i + 1) + EbmlUInt(0x73C5, i + 1) + EbmlUInt(0x83, 1) + Ebml(0x536E, "Track") +
+                                      Ebml(0x22B59C, "und") + Ebml(0x86, "V_MPEG4/ISO/AVC") + Ebml(0x63A2, std::string(40, '\0')) +
+                                      Ebml(0xE0, EbmlUInt(0xB0, 1920) + EbmlUInt(0xBA, 1080) + EbmlUInt(0x54B0, 1920)));
+        }
+        return Ebml(0x1654AE6B, entries);
+    }
+
+    struct SumVisitor : ElementVisitor
+    {
+        uint64_t sum = 0;
+
+        bool OnField(const ElementRule &rule, const ElementValue &value)
+        {
+            switch (rule.field)
+            {
+            case ElementField::TrackHeader:
+            case ElementField::Handler:
+            case ElementField::SampleDescription:
+            case ElementField::CodecId:
+                sum += value.length;
+                break;
+            case ElementField::TrackType:
+            case ElementField::PixelWidth:
+            case ElementField::PixelHeight:
+                sum += value.uint;
+                break;
+            default:
+                break;
+            }
+            return true;
+        }
+    };
+
+    // The baseline: rules found in an unordered_map, handlers called through std::function
+    class RuntimeParser
+    {
+    public:
+        using Handler = std::function<void(const ElementValue &)>;
+
+        RuntimeParser(ElementFormat format, const ElementRule *rules, size_t count, uint64_t *sum) : format_(format)
+        {
+            for (size_t i = 0; i < count; i++)
+            {
+                Handler handler;
+                if (rules[i].policy == ElementPolicy::Read)
+                {
+                    handler = rules[i].type == FieldType::UInt ? Handler([sum](const ElementValue &value) { *sum += value.uint; })
+                                                               : Handler([sum](const ElementValue &value) { *sum += value.length; });
+                }
+                rules_[rules[i].id] = {rules[i], std::move(handler)};
+            }
+        }
+
+        // Returns the number of elements whose header was parsed
+        uint64_t Walk(const uint8_t *data, uint64_t begin, uint64_t end)
+        {
+            uint64_t elements = 0;
+            for (uint64_t pos = begin; pos < end;)
+            {
+                const size_t available = static_cast<size_t>(std::min<uint64_t>(16, end - pos));
+                uint64_t id, size;
+                uint32_t header;
+                const bool ok = format_ == ElementFormat::IsoBmff
+                                    ? ReadElementAt<ElementFormat::IsoBmff>(data + pos, available, end - pos, &id, &size, &header)
+                                    : ReadElementAt<ElementFormat::Ebml>(data + pos, available, end - pos, &id, &size, &header);
+                if (!ok) break;
+                elements++;
+                const uint64_t payload = pos + header;
+                pos = payload + size;
+
+                const auto it = rules_.find(id);
+                if (it == rules_.end() || it->second.rule.policy == ElementPolicy::Skip) continue;
+                if (it->second.rule.policy == ElementPolicy::Stop) break;
+                if (it->second.rule.policy == ElementPolicy::Descend)
+                {
+                    elements += Walk(data, payload, payload + size);
+                    continue;
+                }
+                ElementValue value;
+                value.offset = payload;
+                value.size = size;
+                value.data = data + payload;
+                value.length = static_cast<size_t>(size);
+                if (it->second.rule.type == FieldType::UInt) value.uint = ReadBeUInt(value.data, value.length);
+                it->second.handler(value);
+            }
+            return elements;
+        }
+
+    private:
+        struct Entry
+        {
+            ElementRule rule;
+            Handler handler;
+        };
+        ElementFormat format_;
+        std::unordered_map<uint64_t, Entry> rules_;
+    };
+
+    template <typename Rules>
+    void RunTable(benchmark::State &state, const std::string &bytes)
+    {
+        const uint8_t *data = reinterpret_cast<const uint8_t *>(bytes.data());
+        uint64_t sink = 0;
+        RuntimeParser counter(Rules::kFormat, Rules::kRules, std::size(Rules::kRules), &sink);
+        const uint64_t elements = counter.Walk(data, 0, bytes.size());
+
+        for (auto _ : state)
+        {
+            BufferReader reader{data, 0, bytes.size()};
+            SumVisitor visitor;
+            WalkElements<Rules>(reader, 0, bytes.size(), visitor);
+            benchmark::DoNotOptimize(visitor.sum);
+        }
+        state.counters["per_element"] = benchmark::Counter(static_cast<double>(elements), benchmark::Counter::kIsIterationInvariantRate |
+                                                                                             benchmark::Counter::kInvert);
+    }
+
+    template <typename Rules>
+    void RunRuntime(benchmark::State &state, const std::string &bytes)
+    {
+        const uint8_t *data = reinterpret_cast<const uint8_t *>(bytes.data());
+        uint64_t sum = 0;
+        RuntimeParser parser(Rules::kFormat, Rules::kRules, std::size(Rules::kRules), &sum);
+        uint64_t elements = 0;
+        for (auto _ : state)
+        {
+            elements = parser.Walk(data, 0, bytes.size());
+            benchmark::DoNotOptimize(sum);
+        }
+        state.counters["per_element"] = benchmark::Counter(static_cast<double>(elements), benchmark::Counter::kIsIterationInvariantRate |
+                                                                                             benchmark::Counter::kInvert);
+    }
+
+    void BM_Mp4Streams_DispatchTable(benchmark::State &state) { RunTable<IsoBmffRules<ProbeKind::Streams>>(state, StreamsMoov()); }
+    BENCHMARK(BM_Mp4Streams_DispatchTable);
+
+    void BM_Mp4Streams_RuntimeMap(benchmark::State &state) { RunRuntime<IsoBmffRules<ProbeKind::Streams>>(state, StreamsMoov()); }
+    BENCHMARK(BM_Mp4Streams_RuntimeMap);
+
+    void BM_MkvStreams_DispatchTable(benchmark::State &state) { RunTable<EbmlRules<ProbeKind::Streams>>(state, StreamsTracks()); }
+    BENCHMARK(BM_MkvStreams_DispatchTable);
+
+    void BM_MkvStreams_RuntimeMap(benchmark::State &state) { RunRuntime<EbmlRules<ProbeKind::Streams>>(state, StreamsTracks()); }
+    BENCHMARK(BM_MkvStreams_RuntimeMap);
+
+    // The duration kind over the same moov: mvhd, then the walk ends
+    void BM_Mp4Duration_DispatchTable(benchmark::State &state)
+    {
+        const std::string moov = StreamsMoov();
+        const uint8_t *data = reinterpret_cast<const uint8_t *>(moov.data());
+        for (auto _ : state)
+        {
+            BufferReader reader{data, 0, moov.size()};
+            struct : ElementVisitor
+            {
+                bool OnField(const ElementRule &, const ElementValue &) { return false; }
+            } visitor;
+            benchmark::DoNotOptimize(WalkElements<IsoBmffRules<ProbeKind::Duration>>(reader, 0, moov.size(), visitor));
+        }
+    }
+    BENCHMARK(BM_Mp4Duration_DispatchTable);
+}
@@ -0,0 +1,94 @@
+// Contention on the hot cache: threads reading the items of a view, with an
+// occasional write as new results arrive, against one shard and against the
+// default sixteen.
+//
+// Each thread walks its own window of path IDs, the way several isolates or
+// indexers would serve different parts of a library. With one shard every
+// lookup queues on the same lock; with sixteen, threads mostly take different
+// ones. The hit rate counter shows the working set fits the budget either way,
+// so the difference is the locking alone. On a single core the variants run
+// close together, since threads there never hold a lock at the same time.
+
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "../hot_cache.h"
+
+namespace
+{
+    constexpr uint32_t kItems = 1 << 14;
+
+    HotCache &Cache(size_t shards)
+    {
+        static std::unique_ptr<HotCache> caches[2];
+        std::unique_ptr<HotCache> &cache = caches[shards == 1 ? 0 : 1];
+        if (!cache)
+        {
+            cache = std::make_unique<HotCache>(kHotCacheDefaultBudget, 0, shards);
+            HotResult result;
+            result.has_metadata = true;
+            result.has_duration = true;
+            for (uint32_t id = 1; id <= kItems; id++)
+            {
+                result.metadata.file_size_bytes = id;
+                result.duration_ms = id * 10.0;
+                cache->Put(id, result);
+            }
+        }
+        return *cache;
+    }
+
+    void BM_HotCacheLookup(benchmark::State &state)
+    {
+        // Built by the first thread before the others start (google benchmark's setup barrier)
+        static HotCache *cache = nullptr;
+        if (state.thread_index() == 0) cache = &Cache(static_cast<size_t>(state.range(0)));
+
+        uint32_t id = 1 + static_cast<uint32_t>(state.thread_index()) * (kItems / 8);
+        uint64_t hits = 0, lookups = 0;
+        HotResult result;
+        for (auto _ : state)
+        {
+            id = id % kItems + 1;
+            if ((lookups & 31) == 31)
+            {
+                result.metadata.file_size_bytes = id;
+                cache->Put(id, result);
+            }
+            else
+            {
+                hits += cache->Find(id, true, &result);
+            }
+            lookups++;
+        }
+        state.SetItemsProcessed(state.iterations());
+        state.counters["hit_rate"] = benchmark::Counter(static_cast<double>(hits) / (lookups - lookups / 32), benchmark::Counter::kAvgThreads);
+    }
+    BENCHMARK(BM_HotCacheLookup)->ArgName("shards")->Arg(1)->Arg(16)->Threads(1)->Threads(4)->Threads(8)->UseRealTime();
+
+    // A thumbnail per item over a budget a quarter of the working set: LRU churn under contention
+    void BM_HotCacheThumbnailChurn(benchmark::State &state)
+    {
+        static std::unique_ptr<HotCache> cache;
+        constexpr uint32_t kThumbnailBytes = 8 * 1024;
+        if (state.thread_index() == 0) cache = std::make_unique<HotCache>(uint64_t(kItems) * kThumbnailBytes / 4, 0, 16);
+        const EncodedThumbnail thumbnail = std::make_shared<const std::vector<uint8_t>>(kThumbnailBytes);
+
+        uint32_t id = 1 + static_cast<uint32_t>(state.thread_index()) * (kItems / 8);
+        for (auto _ : state)
+        {
+            id = id % kItems + 1;
+            if (!cache->FindThumbnail(id, 256)) cache->PutThumbnail(id, 256, thumbnail);
+        }
+        state.SetItemsProcessed(state.iterations());
+        if (state.thread_index() == 0)
+        {
+            const HotCacheStats stats = cache->Stats();
+            state.counters["evictions"] = static_cast<double>(stats.evictions);
+            state.counters["resident_mb"] = stats.bytes / 1048576.0;
+        }
+    }
+    BENCHMARK(BM_HotCacheThumbnailChurn)->Threads(1)->Threads(8)->UseRealTime();
+}
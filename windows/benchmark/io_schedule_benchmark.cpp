@@ -0,0 +1,185 @@
+// Directory order against the per-device elevator sweep, on a throttled device.
+//
+// The library is real files: MP4s with the moov after 512 KB of mdat, written
+// under shuffled names so that name order is not allocation order. The device
+// is simulated: every read first moves a shared head to the file's first
+// extent (as PlanDeviceQueues located it) plus the read offset, and pays for
+// the distance the way a disk arm does: nothing within a track, otherwise a
+// settle time plus a share of the full stroke. The files themselves stay in
+// the page cache, so the time measured is the seek cost of the order alone.
+//
+// BM_PlanDeviceQueues is the real cost of locating the files (open, fstat and
+// FIEMAP each) that buys the sweep.
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../byte_source.h"
+#include "../io_schedule.h"
+#include "../media_probe.h"
+#include "../test/media_fixtures.h"
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+namespace fs = std::filesystem;
+using namespace video_data_utils::fixtures;
+
+namespace
+{
+    constexpr size_t kFiles = 150;
+    constexpr uint64_t kMdatBytes = 512 * 1024;
+
+    class GeneratedLibrary
+    {
+    public:
+        GeneratedLibrary()
+        {
+            root_ = fs::temp_directory_path() / "bench_vdu_io_schedule";
+            fs::remove_all(root_);
+            fs::create_directories(root_);
+            std::vector<size_t> names(kFiles);
+            for (size_t i = 0; i < kFiles; i++) names[i] = i;
+            std::shuffle(names.begin(), names.end(), std::mt19937(7));
+            for (size_t i = 0; i < kFiles; i++)
+            {
+                const fs::path path = root_ / ("clip" + std::to_string(1000 + names[i]) + ".mp4");
+                WriteMp4(path, 1000.0 * (i + 1), kMdatBytes);
+                natives_.push_back(path.native());
+            }
+#ifndef _WIN32
+            sync(); // delayed allocation would leave the extents without an address
+#endif
+            std::sort(natives_.begin(), natives_.end()); // what a directory listing hands over
+            for (const NativePath &native : natives_) paths_.push_back(native.c_str());
+        }
+
+        ~GeneratedLibrary() { fs::remove_all(root_); }
+
+        const std::vector<const PathChar *> &Paths() const { return paths_; }
+
+    private:
+        fs::path root_;
+        std::vector<NativePath> natives_;
+        std::vector<const PathChar *> paths_;
+    };
+
+    const GeneratedLibrary &Library()
+    {
+        static GeneratedLibrary library;
+        return library;
+    }
+
+    // One arm over a device whose positions are the files' first extents
+    class ThrottledDevice
+    {
+    public:
+        void Seek(uint64_t position)
+        {
+            std::chrono::microseconds cost{0};
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                const uint64_t distance = position > head_ ? position - head_ : head_ - position;
+                if (distance > kTrackBytes)
+                    cost = kSettle + std::chrono::microseconds(std::min<uint64_t>(distance / kBytesPerMicrosecond, kFullStroke.count()));
+                head_ = position;
+                seeks_ += cost.count() > 0;
+            }
+            if (cost.count() > 0) std::this_thread::sleep_for(cost);
+        }
+
+        uint64_t Seeks() const { return seeks_; }
+
+    private:
+        static constexpr uint64_t kTrackBytes = 1024 * 1024;
+        static constexpr uint64_t kBytesPerMicrosecond = 64 * 1024;
+        static constexpr std::chrono::microseconds kSettle{1000};
+        static constexpr std::chrono::microseconds kFullStroke{8000};
+
+        std::mutex mutex_;
+        uint64_t head_ = 0;
+        uint64_t seeks_ = 0;
+    };
+
+    class ThrottledSource : public ByteSource
+    {
+    public:
+        ThrottledSource(std::unique_ptr<ByteSource> inner, uint64_t base, ThrottledDevice *device)
+            : inner_(std::move(inner)), base_(base), device_(device)
+        {
+        }
+
+        uint64_t Size() const override { return inner_->Size(); }
+
+        size_t ReadAt(uint64_t offset, uint8_t *buffer, size_t length) override
+        {
+            device_->Seek(base_ + offset);
+            const size_t read = inner_->ReadAt(offset, buffer, length);
+            Account(read);
+            return read;
+        }
+
+    private:
+        std::unique_ptr<ByteSource> inner_;
+        uint64_t base_;
+        ThrottledDevice *device_;
+    };
+
+    void Probe(benchmark::State &state, bool sweep)
+    {
+        const auto &paths = Library().Paths();
+        std::vector<FileLocation> locations(paths.size());
+        for (size_t i = 0; i < paths.size(); i++) LocateFile(paths[i], &locations[i]);
+        const bool physical = std::all_of(locations.begin(), locations.end(), [](const FileLocation &l) { return l.has_physical; });
+        if (!physical) state.SetLabel("no FIEMAP here; positions from inode numbers");
+
+        uint64_t seeks = 0;
+        for (auto _ : state)
+        {
+            std::vector<size_t> order;
+            if (sweep)
+            {
+                for (const DeviceQueue &queue : PlanDeviceQueues(paths)) order.insert(order.end(), queue.order.begin(), queue.order.end());
+            }
+            else
+            {
+                for (size_t i = 0; i < paths.size(); i++) order.push_back(i);
+            }
+
+            ThrottledDevice device;
+            for (size_t i : order)
+            {
+                // Inode numbers stand in for positions where the file system has no extent map
+                const uint64_t base = physical ? locations[i].physical : locations[i].inode * (kMdatBytes * 2);
+                ThrottledSource source(OpenFileSource(paths[i], AccessPattern::Random), base, &device);
+                DurationProbe probe;
+                benchmark::DoNotOptimize(RunProbe(probe, source));
+            }
+            seeks += device.Seeks();
+        }
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+        state.counters["seeks/file"] = static_cast<double>(seeks) / (state.iterations() * paths.size());
+    }
+
+    void BM_ProbeDirectoryOrder(benchmark::State &state) { Probe(state, false); }
+    void BM_ProbeElevatorOrder(benchmark::State &state) { Probe(state, true); }
+
+    void BM_PlanDeviceQueues(benchmark::State &state)
+    {
+        const auto &paths = Library().Paths();
+        for (auto _ : state) benchmark::DoNotOptimize(PlanDeviceQueues(paths));
+        state.SetItemsProcessed(static_cast<int64_t>(state.iterations() * paths.size()));
+    }
+}
+
+BENCHMARK(BM_ProbeDirectoryOrder)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_ProbeElevatorOrder)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_PlanDeviceQueues)->Unit(benchmark::kMicrosecond);
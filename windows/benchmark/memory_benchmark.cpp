@@ -0,0 +1,110 @@
+// Heap allocations per operation on the probe and thumbnail paths, and the cost
+// of a pooled pixel buffer against a fresh std::vector.
+//
+// Every benchmark reports allocs/op from the counting operator new in
+// allocation_counter.cpp. Once the pools and the thread's scratch arena are
+// warm, parsing should leave only the allocations its results need (the source
+// object, the keyframe index's own storage).
+
+#include <benchmark/benchmark.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../buffer_pool.h"
+#include "../byte_source.h"
+#include "../keyframe_index.h"
+#include "../media_probe.h"
+#include "../perceptual_hash.h"
+#include "../test/media_fixtures.h"
+#include "allocation_counter.h"
+
+namespace fs = std::filesystem;
+using namespace video_data_utils::fixtures;
+
+namespace
+{
+    const fs::path &SampleFile()
+    {
+        static const fs::path path = [] {
+            fs::path file = fs::temp_directory_path() / "bench_vdu_memory.mkv";
+            WriteFile(file, Mkv(60000.0, 200 * 1024));
+            return file;
+        }();
+        return path;
+    }
+
+    void BM_ProbeFile(benchmark::State &state)
+    {
+        const fs::path &path = SampleFile();
+        const uint64_t before = AllocationCount();
+        for (auto _ : state)
+        {
+            auto source = OpenFileSource(path.c_str(), AccessPattern::Random);
+            DurationProbe probe;
+            benchmark::DoNotOptimize(RunProbe(probe, *source).kind);
+        }
+        ReportAllocations(state, before);
+    }
+    BENCHMARK(BM_ProbeFile);
+
+    void BM_KeyframeIndex(benchmark::State &state)
+    {
+        std::vector<std::pair<uint64_t, std::string>> clusters;
+        for (uint64_t i = 0; i < 200; i++) clusters.emplace_back(i * 2000, SimpleBlock(1, 0, true) + SimpleBlock(1, 40, false));
+        const std::string file = MkvWithClusters(clusters, true);
+        auto source = MakeMemorySource(reinterpret_cast<const uint8_t *>(file.data()), file.size());
+        const uint64_t before = AllocationCount();
+        for (auto _ : state)
+        {
+            KeyframeIndex index;
+            BuildKeyframeIndex(*source, &index);
+            benchmark::DoNotOptimize(index.Count());
+        }
+        ReportAllocations(state, before);
+    }
+    BENCHMARK(BM_KeyframeIndex);
+
+    void BM_HashThumbnailAllocations(benchmark::State &state)
+    {
+        const std::vector<uint8_t> frame = SyntheticFrame(256, 144, 1);
+        uint64_t dhash, phash;
+        const uint64_t before = AllocationCount();
+        for (auto _ : state)
+        {
+            ComputeImageHashes(frame.data(), 256, 144, 256 * 4, &dhash, &phash);
+            benchmark::DoNotOptimize(phash);
+        }
+        ReportAllocations(state, before);
+    }
+    BENCHMARK(BM_HashThumbnailAllocations);
+
+    // A 256 px thumbnail's pixels, written once so the pages are really touched
+    constexpr size_t kThumbnailBytes = 256 * 256 * 4;
+
+    void BM_PixelBuffer_Pooled(benchmark::State &state)
+    {
+        const uint64_t before = AllocationCount();
+        for (auto _ : state)
+        {
+            PooledBuffer pixels = BufferPool::Pixels().Acquire(kThumbnailBytes);
+            pixels.data()[kThumbnailBytes / 2] = 1;
+            benchmark::DoNotOptimize(pixels.data());
+        }
+        if (state.thread_index() == 0) ReportAllocations(state, before);
+    }
+    BENCHMARK(BM_PixelBuffer_Pooled)->Threads(1)->Threads(8);
+
+    void BM_PixelBuffer_Heap(benchmark::State &state)
+    {
+        const uint64_t before = AllocationCount();
+        for (auto _ : state)
+        {
+            std::vector<uint8_t> pixels(kThumbnailBytes);
+            pixels[kThumbnailBytes / 2] = 1;
+            benchmark::DoNotOptimize(pixels.data());
+        }
+        if (state.thread_index() == 0) ReportAllocations(state, before);
+    }
+    BENCHMARK(BM_PixelBuffer_Heap)->Threads(1)->Threads(8);
+}
@@ -0,0 +1,136 @@
+// Perceptual hashing of synthetic thumbnails, and insert/query throughput of the
+// similarity index at library scale (up to a few million hashes).
+//
+// Hashes are drawn as groups of near-duplicates (up to 11 bits flipped) among
+// unrelated values, which is how re-encodes of the same videos spread. Queries
+// are stored hashes with a few bits flipped; BM_LinearScan is the baseline the
+// multi-index tables are measured against.
+
+#include <benchmark/benchmark.h>
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "../perceptual_hash.h"
+#include "../similarity_index.h"
+#include "../test/media_fixtures.h"
+
+using namespace video_data_utils::fixtures;
+
+namespace
+{
+    std::vector<uint64_t> ClusteredHashes(size_t count)
+    {
+        std::mt19937_64 random(42);
+        std::vector<uint64_t> hashes;
+        hashes.reserve(count);
+        while (hashes.size() < count)
+        {
+            const uint64_t base = random();
+            hashes.push_back(base);
+            for (int copy = 0; copy < 3 && hashes.size() < count; copy++)
+            {
+                uint64_t variant = base;
+                for (uint64_t flips = random() % 12; flips > 0; flips--) variant ^= 1ull << (random() % 64);
+                hashes.push_back(variant);
+            }
+        }
+        return hashes;
+    }
+
+    std::vector<uint64_t> Queries(const std::vector<uint64_t> &hashes, size_t count)
+    {
+        std::mt19937_64 random(7);
+        std::vector<uint64_t> queries;
+        for (size_t i = 0; i < count; i++) queries.push_back(hashes[random() % hashes.size()] ^ (1ull << (random() % 64)) ^ (1ull << (random() % 64)));
+        return queries;
+    }
+
+    // Built once per size and shared by the query benchmarks
+    const SimilarityIndex &FilledIndex(size_t count)
+    {
+        static std::vector<std::pair<size_t, std::unique_ptr<SimilarityIndex>>> indexes;
+        for (const auto &entry : indexes)
+            if (entry.first == count) return *entry.second;
+        auto index = std::make_unique<SimilarityIndex>();
+        const std::vector<uint64_t> hashes = ClusteredHashes(count);
+        for (uint32_t id = 0; id < hashes.size(); id++) index->Insert(id, hashes[id]);
+        indexes.emplace_back(count, std::move(index));
+        return *indexes.back().second;
+    }
+
+    void BM_HashThumbnail(benchmark::State &state)
+    {
+        const uint32_t width = static_cast<uint32_t>(state.range(0)), height = width * 9 / 16;
+        const std::vector<uint8_t> frame = SyntheticFrame(width, height, 1);
+        uint64_t dhash, phash;
+        for (auto _ : state)
+        {
+            ComputeImageHashes(frame.data(), width, height, width * 4, &dhash, &phash);
+            benchmark::DoNotOptimize(phash);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_HashThumbnail)->Arg(96)->Arg(256)->Arg(1024);
+
+    void BM_Insert(benchmark::State &state)
+    {
+        const std::vector<uint64_t> hashes = ClusteredHashes(static_cast<size_t>(state.range(0)));
+        for (auto _ : state)
+        {
+            SimilarityIndex index;
+            for (uint32_t id = 0; id < hashes.size(); id++) index.Insert(id, hashes[id]);
+            benchmark::DoNotOptimize(index.Size());
+        }
+        state.SetItemsProcessed(state.iterations() * state.range(0));
+    }
+    BENCHMARK(BM_Insert)->Arg(100000)->Arg(1000000)->Unit(benchmark::kMillisecond);
+
+    void BM_Within(benchmark::State &state)
+    {
+        const size_t count = static_cast<size_t>(state.range(0));
+        const SimilarityIndex &index = FilledIndex(count);
+        const std::vector<uint64_t> queries = Queries(ClusteredHashes(count), 1024);
+        std::vector<SimilarityMatch> matches;
+        size_t q = 0, found = 0;
+        for (auto _ : state)
+        {
+            index.Within(queries[q++ % queries.size()], static_cast<uint32_t>(state.range(1)), &matches);
+            found += matches.size();
+        }
+        state.SetItemsProcessed(state.iterations());
+        state.counters["matches/query"] = static_cast<double>(found) / state.iterations();
+    }
+    BENCHMARK(BM_Within)->Args({1000000, 4})->Args({1000000, 10})->Args({1000000, 15})->Args({4000000, 10});
+
+    void BM_Nearest(benchmark::State &state)
+    {
+        const SimilarityIndex &index = FilledIndex(1000000);
+        const std::vector<uint64_t> queries = Queries(ClusteredHashes(1000000), 1024);
+        std::vector<SimilarityMatch> matches;
+        size_t q = 0;
+        for (auto _ : state)
+        {
+            index.Nearest(queries[q++ % queries.size()], static_cast<uint32_t>(state.range(0)), &matches);
+            benchmark::DoNotOptimize(matches.data());
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_Nearest)->Arg(1)->Arg(4)->Arg(16);
+
+    void BM_LinearScan(benchmark::State &state)
+    {
+        const std::vector<uint64_t> hashes = ClusteredHashes(1000000);
+        const std::vector<uint64_t> queries = Queries(hashes, 1024);
+        size_t q = 0;
+        for (auto _ : state)
+        {
+            const uint64_t query = queries[q++ % queries.size()];
+            size_t found = 0;
+            for (uint64_t hash : hashes) found += HammingDistance(hash, query) <= 10;
+            benchmark::DoNotOptimize(found);
+        }
+        state.SetItemsProcessed(state.iterations());
+    }
+    BENCHMARK(BM_LinearScan);
+}
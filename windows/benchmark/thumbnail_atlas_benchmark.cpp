@@ -0,0 +1,116 @@
+// Atlas builds with a renderer that only fills pixels, so what is measured is
+// the atlas itself: placing (and where needed averaging down) the cells, the
+// copies from cached pages, and the memory that holds them.
+//
+// BM_AtlasBuild draws every cell of a page from scratch, with thumbnails at the
+// cell size and at twice it (the box filter path). BM_AtlasScroll builds the
+// page one row further down each time, so all but one row is copied from the
+// previous page. BM_AtlasRefresh redraws one changed cell of an open page.
+// atlas_mb is the page's pixels; pool_mb what the pixel pool holds meanwhile,
+// atlases and render buffers included.
+
+#include <benchmark/benchmark.h>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "../path_arena.h"
+#include "../thumbnail_atlas.h"
+#include "allocation_counter.h"
+
+namespace
+{
+    ThumbnailRenderer FillRenderer(uint32_t scale)
+    {
+        return [scale](const PathChar *, uint32_t size, PooledBuffer *bgra, uint32_t *width, uint32_t *height) {
+            *width = size * scale;
+            *height = size * scale * 9 / 16;
+            bgra->resize(size_t(*width) * *height * 4);
+            std::fill(bgra->data(), bgra->data() + bgra->size(), uint8_t(0x80));
+            return true;
+        };
+    }
+
+    std::vector<uint32_t> Videos(size_t count)
+    {
+        std::vector<uint32_t> ids;
+        for (size_t i = 0; i < count; i++)
+        {
+            const std::string path = "/bench/atlas/" + std::to_string(i) + ".mkv";
+            ids.push_back(PathArena::Instance().InternUtf8(path.data(), static_cast<uint32_t>(path.size())));
+        }
+        return ids;
+    }
+
+    void ReportMemory(benchmark::State &state, const ThumbnailAtlasStore &store)
+    {
+        state.counters["atlas_mb"] = store.Stats().bytes / 1048576.0;
+        state.counters["pool_mb"] = BufferPool::Pixels().Stats().outstanding_bytes / 1048576.0;
+    }
+
+    // Args: cell size, cells, thumbnail scale (1: fits the cell, 2: twice as large)
+    void BM_AtlasBuild(benchmark::State &state)
+    {
+        const uint32_t cellSize = static_cast<uint32_t>(state.range(0));
+        const std::vector<uint32_t> videos = Videos(static_cast<size_t>(state.range(1)));
+        // No budget: every build draws a new atlas
+        ThumbnailAtlasStore store(WorkerPool::Instance(), FillRenderer(static_cast<uint32_t>(state.range(2))), 0);
+        const uint64_t before = AllocationCount();
+        for (auto _ : state)
+        {
+            const int32_t handle = store.Build(videos.data(), static_cast<uint32_t>(videos.size()), cellSize, 16);
+            state.PauseTiming();
+            ReportMemory(state, store);
+            store.Close(handle);
+            state.ResumeTiming();
+        }
+        state.SetItemsProcessed(state.iterations() * videos.size());
+        ReportAllocations(state, before);
+    }
+    BENCHMARK(BM_AtlasBuild)
+        ->ArgNames({"cell", "cells", "scale"})
+        ->Args({128, 64, 1})
+        ->Args({128, 256, 1})
+        ->Args({256, 64, 1})
+        ->Args({256, 64, 2})
+        ->Unit(benchmark::kMillisecond);
+
+    void BM_AtlasScroll(benchmark::State &state)
+    {
+        const uint32_t cellSize = static_cast<uint32_t>(state.range(0));
+        constexpr uint32_t kColumns = 8, kCells = 64;
+        const std::vector<uint32_t> videos = Videos(kCells + 4096 * kColumns);
+        ThumbnailAtlasStore store(WorkerPool::Instance(), FillRenderer(1), 2 * uint64_t(kCells) * cellSize * cellSize * 4);
+        size_t first = 0;
+        int32_t previous = store.Build(videos.data(), kCells, cellSize, kColumns);
+        for (auto _ : state)
+        {
+            first = (first + kColumns) % (videos.size() - kCells);
+            const int32_t handle = store.Build(videos.data() + first, kCells, cellSize, kColumns);
+            store.Close(previous);
+            previous = handle;
+        }
+        state.SetItemsProcessed(state.iterations() * kCells);
+        const ThumbnailAtlasStats stats = store.Stats();
+        state.counters["copied"] = static_cast<double>(stats.cells_copied) / (stats.cells_copied + stats.cells_rendered);
+        ReportMemory(state, store);
+        store.Close(previous);
+    }
+    BENCHMARK(BM_AtlasScroll)->ArgName("cell")->Arg(128)->Arg(256)->Unit(benchmark::kMillisecond);
+
+    void BM_AtlasRefresh(benchmark::State &state)
+    {
+        const std::vector<uint32_t> videos = Videos(256);
+        ThumbnailAtlasStore store(WorkerPool::Instance(), FillRenderer(1), 0);
+        const int32_t handle = store.Build(videos.data(), 256, 256, 16);
+        size_t next = 0;
+        for (auto _ : state)
+        {
+            store.Invalidate(videos[next++ % videos.size()]);
+            benchmark::DoNotOptimize(store.Refresh(handle));
+        }
+        ReportMemory(state, store);
+        store.Close(handle);
+    }
+    BENCHMARK(BM_AtlasRefresh)->Unit(benchmark::kMicrosecond);
+}
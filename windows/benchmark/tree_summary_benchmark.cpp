@@ -0,0 +1,117 @@
+// Full scan against an incremental rescan of a generated library four levels
+// deep (6^4 leaf directories of 20 files). Between the summary and the rescan,
+// files are added to or removed from one leaf in a hundred, so the rescan lists
+// those leaves and their parents and only stats the rest of the directories.
+//
+// The tree stays in the dentry and inode caches; on a cold cache or a network
+// share every avoided listing and stat is a round trip saved.
+
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <filesystem>
+#include <string>
+
+#include "../test/media_fixtures.h"
+#include "../tree_summary.h"
+
+namespace fs = std::filesystem;
+using namespace video_data_utils::fixtures;
+
+namespace
+{
+    constexpr int kDepth = 4;
+    constexpr int kFanout = 6;
+    constexpr int kFilesPerLeaf = 20;
+
+    class GeneratedTree
+    {
+    public:
+        GeneratedTree()
+        {
+            root_ = fs::temp_directory_path() / "bench_vdu_tree_summary";
+            fs::remove_all(root_);
+            int leaf = 0;
+            Populate(root_, 0, &leaf);
+
+            const auto past = fs::file_time_type::clock::now() - std::chrono::hours(1);
+            fs::last_write_time(root_, past);
+            for (const auto &entry : fs::recursive_directory_iterator(root_))
+                if (entry.is_directory()) fs::last_write_time(entry.path(), past);
+
+            TreeScanStats stats;
+            ScanTree(root_.native(), nullptr, true, &baseline_, &stats);
+
+            // Sparse changes after the baseline summary was taken
+            leaf = 0;
+            for (const auto &entry : fs::recursive_directory_iterator(root_))
+            {
+                if (!entry.is_directory() || fs::path(entry.path()).filename().native().size() != 2) continue;
+                if (leaf++ % 100 != 0) continue;
+                if (leaf % 2) WriteFile(entry.path() / "added.mkv", "new");
+                else fs::remove(entry.path() / "clip0.mkv");
+            }
+        }
+
+        ~GeneratedTree() { fs::remove_all(root_); }
+
+        const NativePath &Root() const { return root_.native(); }
+        const TreeSummary &Baseline() const { return baseline_; }
+
+    private:
+        void Populate(const fs::path &dir, int depth, int *leaf)
+        {
+            fs::create_directories(dir);
+            if (depth == kDepth)
+            {
+                for (int i = 0; i < kFilesPerLeaf; i++) WriteFile(dir / ("clip" + std::to_string(i) + ".mkv"), std::string(64, 'v'));
+                ++*leaf;
+                return;
+            }
+            for (int i = 0; i < kFanout; i++) Populate(dir / (std::string(1, static_cast<char>('a' + i)) + std::to_string(i)), depth + 1, leaf);
+        }
+
+        fs::path root_;
+        TreeSummary baseline_;
+    };
+
+    const GeneratedTree &Tree()
+    {
+        static GeneratedTree tree;
+        return tree;
+    }
+
+    void Run(benchmark::State &state, const TreeSummary *previous)
+    {
+        TreeScanStats stats;
+        for (auto _ : state)
+        {
+            TreeSummary summary;
+            ScanTree(Tree().Root(), previous, true, &summary, &stats);
+            benchmark::DoNotOptimize(summary.tree.hash);
+        }
+        state.counters["dirs"] = static_cast<double>(stats.directories);
+        state.counters["dirs_listed"] = static_cast<double>(stats.directories_listed);
+        state.counters["file_stats"] = static_cast<double>(stats.file_stats);
+    }
+
+    void BM_TreeScan_Full(benchmark::State &state) { Run(state, nullptr); }
+    void BM_TreeScan_Incremental(benchmark::State &state) { Run(state, &Tree().Baseline()); }
+
+    void BM_TreeScan_Diff(benchmark::State &state)
+    {
+        TreeSummary current;
+        TreeScanStats stats;
+        ScanTree(Tree().Root(), &Tree().Baseline(), true, &current, &stats);
+        size_t changes = 0;
+        for (auto _ : state)
+        {
+            changes = 0;
+            DiffTrees(Tree().Baseline(), current, [&](FsChange &&) { changes++; });
+        }
+        state.counters["changes"] = static_cast<double>(changes);
+    }
+}
+
+BENCHMARK(BM_TreeScan_Full)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_TreeScan_Incremental)->Unit(benchmark::kMillisecond)->UseRealTime();
+BENCHMARK(BM_TreeScan_Diff)->Unit(benchmark::kMicrosecond);
@@ -0,0 +1,292 @@
+#include "bitrate_timeline.h"
+#include "container_layout.h"
+#include "container_parse.h"
+#include "content_sniffer.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cmath>
+#include <utility>
+
+namespace
+{
+    // Blocks visited before the walk gives up; a two-hour film with audio has about half a million
+    constexpr uint32_t kMaxScannedBlocks = 1u << 21;
+    // Element IDs of four bytes are level 1 (Cluster, Cues, Tags...); they end a cluster of unknown size
+    constexpr uint64_t kMaxClusterChildId = 0xFFFFFF;
+
+    // Bytes per bucket while the timeline is being built
+    class Buckets
+    {
+    public:
+        explicit Buckets(uint32_t bucketMs) : bucketMs_(bucketMs) {}
+
+        void Add(double timeMs, uint64_t bytes)
+        {
+            const double index = std::floor(std::max(timeMs, 0.0) / bucketMs_);
+            if (!Reserve(index + 1)) return;
+            bytes_[static_cast<size_t>(index)] += static_cast<double>(bytes);
+            total_ += bytes;
+        }
+
+        // Spreads @p bytes evenly over [startMs, endMs).
+        void Spread(double startMs, double endMs, uint64_t bytes)
+        {
+            startMs = std::max(startMs, 0.0);
+            if (!(endMs > startMs))
+            {
+                Add(startMs, bytes);
+                return;
+            }
+            if (!Reserve(std::ceil(endMs / bucketMs_))) return;
+            const double perMs = static_cast<double>(bytes) / (endMs - startMs);
+            for (size_t i = static_cast<size_t>(startMs / bucketMs_); i < bytes_.size() && double(i) * bucketMs_ < endMs; i++)
+            {
+                const double from = std::max(startMs, double(i) * bucketMs_);
+                const double to = std::min(endMs, double(i + 1) * bucketMs_);
+                bytes_[i] += perMs * (to - from);
+            }
+            total_ += bytes;
+        }
+
+        uint64_t Total() const { return total_; }
+
+        // Converts to kbit/s over at least @p durationMs. False if the timeline is too long.
+        bool Finish(double durationMs, BitrateTimeline *timeline)
+        {
+            if (!Reserve(std::ceil(std::max(durationMs, 0.0) / bucketMs_)) || overflow_ || bytes_.empty()) return false;
+            timeline->kbps.resize(bytes_.size());
+            // bytes * 8 / ms = kbit/s
+            for (size_t i = 0; i < bytes_.size(); i++) timeline->kbps[i] = static_cast<float>(bytes_[i] * 8.0 / bucketMs_);
+            timeline->durationMs = std::max(durationMs, 0.0);
+            timeline->mediaBytes = total_;
+            return true;
+        }
+
+    private:
+        bool Reserve(double count)
+        {
+            if (!(count <= kMaxBitrateBuckets))
+            {
+                overflow_ = true;
+                return false;
+            }
+            if (count > bytes_.size()) bytes_.resize(static_cast<size_t>(count));
+            return true;
+        }
+
+        const uint32_t bucketMs_;
+        std::vector<double> bytes_;
+        uint64_t total_ = 0;
+        bool overflow_ = false;
+    };
+
+    // === ISO-BMFF ===
+
+    // Credits each sample of the table to its decode time; returns false if the table is damaged
+    bool CountSampleTable(const MediaTrack &track, Buckets *buckets, double *endMs)
+    {
+        const uint8_t *stts = nullptr, *stsz = nullptr;
+        size_t sttsLength = 0, stszLength = 0;
+        FindBox(track.stbl, track.stblLength, "stts", &stts, &sttsLength);
+        FindBox(track.stbl, track.stblLength, "stsz", &stsz, &stszLength);
+
+        uint32_t sttsCount;
+        if (!EntryTable(stts, sttsLength, 8, 8, &sttsCount) || stszLength < 12) return false;
+        const uint32_t fixedSize = ReadBe32(stsz + 4);
+        const uint32_t sampleCount = ReadBe32(stsz + 8);
+        if (fixedSize == 0 && (stszLength - 12) / 4 < sampleCount) return false;
+
+        const double msPerTick = 1000.0 / track.timescale;
+        uint32_t sttsIndex = 0;
+        uint32_t sttsLeft = sttsCount > 0 ? ReadBe32(stts + 8) : 0;
+        uint64_t decodeTime = 0;
+        for (uint32_t sample = 0; sample < sampleCount; sample++)
+        {
+            buckets->Add(static_cast<double>(decodeTime) * msPerTick, fixedSize != 0 ? fixedSize : ReadBe32(stsz + 12 + 4 * sample));
+            while (sttsLeft == 0 && sttsIndex + 1 < sttsCount) sttsLeft = ReadBe32(stts + 8 + 8 * ++sttsIndex);
+            if (sttsLeft > 0)
+            {
+                decodeTime += ReadBe32(stts + 8 + 8 * sttsIndex + 4);
+                sttsLeft--;
+            }
+        }
+        *endMs = std::max(*endMs, static_cast<double>(decodeTime) * msPerTick);
+        return true;
+    }
+
+    bool BuildIsoBmff(ByteSource &source, Buckets *buckets, BitrateTimeline *timeline)
+    {
+        ScratchBytes moov;
+        if (!ReadMoovBox(source, &moov)) return false;
+        double endMs = 0.0;
+        // A damaged track fails the whole timeline rather than leaving a hole in it. Hint
+        // tracks describe packets of the media already counted.
+        const bool damaged = ForEachMediaTrack(moov.data(), moov.size(), [&](const MediaTrack &track) {
+            return std::memcmp(track.handler, "hint", 4) != 0 && !CountSampleTable(track, buckets, &endMs);
+        });
+        timeline->source = BitrateSource::SampleTables;
+        // Fragmented files keep their samples in moof boxes, leaving the tables here empty
+        return !damaged && buckets->Total() > 0 && buckets->Finish(endMs, timeline);
+    }
+
+    // === Matroska ===
+
+    /**
+     * Spreads the bytes between consecutive cued clusters over the time between
+     * their cue points. Declines, without counting anything, unless the cue
+     * points are in time order and none is more than a bucket from the next.
+     */
+    bool SpreadCues(const ScratchBytes &cues, const MatroskaLayout &layout, double durationMs, uint32_t bucketMs, Buckets *buckets)
+    {
+        const double msPerTick = 1000.0 / layout.ticksPerSecond;
+        std::vector<std::pair<uint64_t, double>> points; // absolute cluster offset, time in ms
+        ForEachChild(cues.data(), cues.size(), [&](uint64_t id, const uint8_t *point, size_t length) {
+            if (id != kMkvCuePoint) return;
+            double timeMs = 0.0;
+            uint64_t cluster = 0;
+            ForEachChild(point, length, [&](uint64_t child, const uint8_t *value, size_t size) {
+                if (child == kMkvCueTime) timeMs = static_cast<double>(ReadBeUInt(value, size)) * msPerTick;
+                if (child != kMkvCueTrackPositions || cluster != 0) return;
+                ForEachChild(value, size, [&](uint64_t field, const uint8_t *v, size_t n) {
+                    if (field == kMkvCueClusterPosition) cluster = layout.segmentStart + ReadBeUInt(v, n);
+                });
+            });
+            if (cluster != 0) points.push_back({cluster, timeMs});
+        });
+        if (points.empty()) return false;
+
+        // Cue points of several tracks can share a cluster: keep its earliest time
+        std::sort(points.begin(), points.end());
+        size_t kept = 0;
+        for (size_t i = 1; i < points.size(); i++)
+            if (points[i].first != points[kept].first) points[++kept] = points[i];
+        points.resize(kept + 1);
+
+        const uint64_t firstCluster = layout.firstCluster != 0 ? std::min(layout.firstCluster, points[0].first) : points[0].first;
+        const uint64_t clustersEnd = layout.cuesAt > points.back().first ? layout.cuesAt : layout.segmentEnd;
+        if (points.back().first >= clustersEnd || durationMs - points.back().second > bucketMs) return false;
+        if (firstCluster < points[0].first && points[0].second > bucketMs) return false;
+        for (size_t i = 1; i < points.size(); i++)
+        {
+            const double gap = points[i].second - points[i - 1].second;
+            if (gap < 0.0 || gap > bucketMs) return false;
+        }
+
+        if (firstCluster < points[0].first) buckets->Spread(0.0, points[0].second, points[0].first - firstCluster);
+        for (size_t i = 0; i < points.size(); i++)
+        {
+            const uint64_t end = i + 1 < points.size() ? points[i + 1].first : clustersEnd;
+            const double endMs = i + 1 < points.size() ? points[i + 1].second : durationMs;
+            buckets->Spread(points[i].second, endMs, end - points[i].first);
+        }
+        return true;
+    }
+
+    // Credits every block to its timestamp, reading its header and skipping its payload
+    void ScanBlocks(ByteSource &source, const MatroskaLayout &layout, Buckets *buckets, double *lastMs, bool *complete)
+    {
+        const double msPerTick = 1000.0 / layout.ticksPerSecond;
+        uint32_t blocks = 0;
+        auto credit = [&](int64_t timestamp, int16_t relative, uint64_t bytes) {
+            const double timeMs = static_cast<double>(timestamp + relative) * msPerTick;
+            buckets->Add(timeMs, bytes);
+            *lastMs = std::max(*lastMs, timeMs);
+            blocks++;
+        };
+
+        uint64_t pos = layout.firstCluster;
+        while (pos < layout.segmentEnd)
+        {
+            EbmlElement cluster;
+            if (!ReadElementAt(source, pos, &cluster)) return;
+            if (cluster.id != kMkvCluster)
+            {
+                if (cluster.unknownSize) return;
+                pos = cluster.payload + cluster.size; // Cues, Tags, Void between clusters
+                continue;
+            }
+            const uint64_t clusterEnd = cluster.unknownSize ? layout.segmentEnd : std::min(cluster.payload + cluster.size, layout.segmentEnd);
+
+            int64_t timestamp = 0;
+            uint64_t child = cluster.payload;
+            EbmlElement element;
+            while (child < clusterEnd && ReadElementAt(source, child, &element) && !element.unknownSize && element.id <= kMaxClusterChildId)
+            {
+                if (blocks >= kMaxScannedBlocks)
+                {
+                    *complete = false;
+                    return;
+                }
+                uint64_t track;
+                int16_t relative;
+                uint8_t flags;
+                if (element.id == kMkvClusterTimestamp && element.size <= 8)
+                {
+                    uint8_t value[8];
+                    timestamp = static_cast<int64_t>(ReadBeUInt(value, source.ReadAt(element.payload, value, static_cast<size_t>(element.size))));
+                }
+                else if (element.id == kMkvSimpleBlock && ReadBlockHeader(source, element.payload, &track, &relative, &flags))
+                    credit(timestamp, relative, element.size);
+                else if (element.id == kMkvBlockGroup)
+                {
+                    const uint64_t groupEnd = element.payload + element.size;
+                    EbmlElement part;
+                    for (uint64_t at = element.payload; at < groupEnd && ReadElementAt(source, at, &part) && !part.unknownSize;
+                         at = part.payload + part.size)
+                    {
+                        if (part.id == kMkvBlock && ReadBlockHeader(source, part.payload, &track, &relative, &flags))
+                            credit(timestamp, relative, part.size);
+                    }
+                }
+                child = element.payload + element.size;
+            }
+            // A cluster of unknown size ends where the next level-1 element starts
+            const uint64_t next = cluster.unknownSize ? child : clusterEnd;
+            if (next <= pos) return;
+            pos = next;
+        }
+    }
+
+    bool BuildMatroska(ByteSource &source, uint32_t bucketMs, Buckets *buckets, BitrateTimeline *timeline)
+    {
+        MatroskaLayout layout;
+        if (!ReadMatroskaLayout(source, &layout)) return false;
+        const double durationMs = layout.durationTicks > 0.0 ? layout.durationTicks * 1000.0 / layout.ticksPerSecond : 0.0;
+
+        EbmlElement element;
+        ScratchBytes cues;
+        if (durationMs > 0.0 && layout.cuesAt != 0 && ReadElementAt(source, layout.cuesAt, &element) && element.id == kMkvCues &&
+            ReadElementPayload(source, element, kMaxMkvCuesBytes, &cues) && SpreadCues(cues, layout, durationMs, bucketMs, buckets))
+        {
+            timeline->source = BitrateSource::Cues;
+            return buckets->Finish(durationMs, timeline);
+        }
+        if (layout.firstCluster == 0) return false;
+
+        double lastMs = 0.0;
+        ScanBlocks(source, layout, buckets, &lastMs, &timeline->complete);
+        timeline->source = BitrateSource::Blocks;
+        // A walk cut short covers only what it reached
+        return buckets->Total() > 0 && buckets->Finish(timeline->complete ? std::max(durationMs, lastMs) : lastMs, timeline);
+    }
+}
+
+bool BuildBitrateTimeline(ByteSource &source, uint32_t bucketMs, BitrateTimeline *timeline)
+{
+    if (bucketMs == 0) return false;
+    ScratchArena::Scope scratch; // moov, Cues and header element payloads
+    timeline->bucketMs = bucketMs;
+    Buckets buckets(bucketMs);
+    uint8_t head[kSniffHeadBytes];
+    switch (SniffBuffer(head, source.ReadAt(0, head, sizeof(head)), nullptr, 0))
+    {
+    case ContainerKind::IsoBmff:
+    case ContainerKind::QuickTime:
+        return BuildIsoBmff(source, &buckets, timeline);
+    case ContainerKind::Matroska:
+    case ContainerKind::WebM:
+        return BuildMatroska(source, bucketMs, &buckets, timeline);
+    default:
+        return false;
+    }
+}
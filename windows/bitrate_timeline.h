@@ -0,0 +1,50 @@
+#ifndef BITRATE_TIMELINE_H
+#define BITRATE_TIMELINE_H
+
+#include "byte_source.h"
+#include <cstdint>
+#include <vector>
+
+// Timelines longer than this many buckets are refused rather than allocated
+constexpr uint32_t kMaxBitrateBuckets = 1u << 22;
+
+enum class BitrateSource : uint8_t
+{
+    None = 0,
+    SampleTables = 1, // MP4/MOV stsz and stts
+    Cues = 2,         // Matroska: bytes between the clusters the Cues point at
+    Blocks = 3,       // Matroska: block headers of every cluster
+};
+
+/**
+ * @brief Container bitrate in fixed-width time buckets, from index data only.
+ *
+ * Every track counts, so audio adds a floor under the video. A sample or
+ * block is credited to the bucket its decode time falls in; a Cues span is
+ * spread evenly over the buckets it covers.
+ */
+struct BitrateTimeline
+{
+    uint32_t bucketMs = 0;
+    std::vector<float> kbps; // one per bucket; the last is averaged over the full bucket width
+    double durationMs = 0.0; // covered by the buckets
+    uint64_t mediaBytes = 0; // sample or block bytes counted
+    BitrateSource source = BitrateSource::None;
+    bool complete = true; // false when the block scan stopped at its bound before the end
+};
+
+/**
+ * @brief Builds the bitrate timeline of a file at @p bucketMs.
+ *
+ * MP4/MOV: sizes from stsz and decode times from stts of every track but hint
+ * tracks, read with the moov box. Matroska/WebM: the Cues alone when no two
+ * cue points are further apart than a bucket; otherwise a bounded walk over
+ * cluster and block headers that reads a few bytes of each block and skips
+ * its payload. Fragmented MP4 and edit lists are not handled.
+ *
+ * @return false if the container is not supported, has no index data, or the
+ *         timeline would exceed kMaxBitrateBuckets
+ */
+bool BuildBitrateTimeline(ByteSource &source, uint32_t bucketMs, BitrateTimeline *timeline);
+
+#endif // BITRATE_TIMELINE_H
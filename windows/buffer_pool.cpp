@@ -0,0 +1,235 @@
+#include "buffer_pool.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    size_t ClassOf(size_t bytes)
+    {
+        size_t index = 0;
+        for (size_t capacity = BufferPool::kMinClassBytes; capacity < bytes; capacity <<= 1) index++;
+        return index;
+    }
+
+    size_t ClassBytes(size_t index) { return BufferPool::kMinClassBytes << index; }
+}
+
+PooledBuffer::PooledBuffer(PooledBuffer &&other) noexcept
+    : pool_(other.pool_), data_(other.data_), size_(other.size_), capacity_(other.capacity_)
+{
+    other.pool_ = nullptr;
+    other.data_ = nullptr;
+    other.size_ = other.capacity_ = 0;
+}
+
+PooledBuffer &PooledBuffer::operator=(PooledBuffer &&other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        pool_ = other.pool_;
+        data_ = other.data_;
+        size_ = other.size_;
+        capacity_ = other.capacity_;
+        other.pool_ = nullptr;
+        other.data_ = nullptr;
+        other.size_ = other.capacity_ = 0;
+    }
+    return *this;
+}
+
+void PooledBuffer::resize(size_t n)
+{
+    if (n <= capacity_)
+    {
+        size_ = n;
+        return;
+    }
+    PooledBuffer larger = (pool_ != nullptr ? *pool_ : BufferPool::Reads()).Acquire(n);
+    if (size_ > 0) std::memcpy(larger.data_, data_, size_);
+    *this = std::move(larger);
+}
+
+void PooledBuffer::Release()
+{
+    if (data_ != nullptr) pool_->Return(data_, capacity_);
+    data_ = nullptr;
+    size_ = capacity_ = 0;
+}
+
+BufferPool &BufferPool::Reads()
+{
+    static BufferPool pool(32 * 1024 * 1024);
+    return pool;
+}
+
+BufferPool &BufferPool::Pixels()
+{
+    static BufferPool pool(64 * 1024 * 1024);
+    return pool;
+}
+
+BufferPool::BufferPool(size_t maxRetainedBytes) : maxRetainedBytes_(maxRetainedBytes) {}
+
+BufferPool::~BufferPool()
+{
+    Trim();
+}
+
+PooledBuffer BufferPool::Acquire(size_t bytes)
+{
+    PooledBuffer buffer;
+    buffer.pool_ = this;
+    buffer.size_ = bytes;
+    const size_t index = ClassOf(std::max<size_t>(bytes, 1));
+    buffer.capacity_ = index < kClasses ? ClassBytes(index) : bytes;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        acquires_++;
+        outstandingBytes_ += buffer.capacity_;
+        if (index < kClasses && !free_[index].empty())
+        {
+            buffer.data_ = free_[index].back();
+            free_[index].pop_back();
+            retainedBytes_ -= buffer.capacity_;
+            return buffer;
+        }
+        allocations_++;
+    }
+    buffer.data_ = new uint8_t[buffer.capacity_];
+    return buffer;
+}
+
+void BufferPool::Return(uint8_t *data, size_t capacity)
+{
+    const size_t index = ClassOf(capacity);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        outstandingBytes_ -= capacity;
+        if (index < kClasses && ClassBytes(index) == capacity && retainedBytes_ + capacity <= maxRetainedBytes_)
+        {
+            free_[index].push_back(data);
+            retainedBytes_ += capacity;
+            return;
+        }
+    }
+    delete[] data;
+}
+
+BufferPoolStats BufferPool::Stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return {acquires_, allocations_, retainedBytes_, outstandingBytes_};
+}
+
+void BufferPool::Trim()
+{
+    std::vector<uint8_t *> released;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (std::vector<uint8_t *> &list : free_)
+        {
+            released.insert(released.end(), list.begin(), list.end());
+            list.clear();
+        }
+        retainedBytes_ = 0;
+    }
+    for (uint8_t *data : released) delete[] data;
+}
+
+MemoryBudget &MemoryBudget::Thumbnails()
+{
+    static MemoryBudget budget(128 * 1024 * 1024);
+    return budget;
+}
+
+MemoryBudget::MemoryBudget(uint64_t limitBytes) : limit_(limitBytes) {}
+
+MemoryBudget::Lease &MemoryBudget::Lease::operator=(Lease &&other) noexcept
+{
+    if (this != &other)
+    {
+        Release();
+        budget_ = other.budget_;
+        bytes_ = other.bytes_;
+        other.budget_ = nullptr;
+    }
+    return *this;
+}
+
+void MemoryBudget::Lease::Release()
+{
+    if (budget_ != nullptr) budget_->Return(bytes_);
+    budget_ = nullptr;
+}
+
+MemoryBudget::Lease MemoryBudget::Acquire(uint64_t bytes)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (inFlight_ > 0 && inFlight_ + bytes > limit_)
+    {
+        waits_++;
+        released_.wait(lock, [&] { return inFlight_ == 0 || inFlight_ + bytes <= limit_; });
+    }
+    inFlight_ += bytes;
+    highWater_ = std::max(highWater_, inFlight_);
+
+    Lease lease;
+    lease.budget_ = this;
+    lease.bytes_ = bytes;
+    return lease;
+}
+
+bool MemoryBudget::TryAcquire(uint64_t bytes, Lease *lease)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (inFlight_ > 0 && inFlight_ + bytes > limit_) return false;
+    inFlight_ += bytes;
+    highWater_ = std::max(highWater_, inFlight_);
+    lease->Release();
+    lease->budget_ = this;
+    lease->bytes_ = bytes;
+    return true;
+}
+
+void MemoryBudget::Return(uint64_t bytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        inFlight_ -= bytes;
+    }
+    released_.notify_all();
+}
+
+void MemoryBudget::SetLimit(uint64_t limitBytes)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        limit_ = limitBytes;
+    }
+    released_.notify_all();
+}
+
+uint64_t MemoryBudget::Limit() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return limit_;
+}
+
+uint64_t MemoryBudget::InFlight() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return inFlight_;
+}
+
+uint64_t MemoryBudget::HighWater() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return highWater_;
+}
+
+uint64_t MemoryBudget::Waits() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return waits_;
+}
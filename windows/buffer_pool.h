@@ -0,0 +1,151 @@
+#ifndef BUFFER_POOL_H
+#define BUFFER_POOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+class BufferPool;
+
+// A buffer borrowed from a BufferPool; returned to it on destruction. Move-only.
+class PooledBuffer
+{
+public:
+    PooledBuffer() = default;
+    PooledBuffer(PooledBuffer &&other) noexcept;
+    PooledBuffer &operator=(PooledBuffer &&other) noexcept;
+    ~PooledBuffer() { Release(); }
+
+    uint8_t *data() { return data_; }
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return size_ == 0; }
+
+    // Keeps the first min(size, n) bytes; moves to a larger size class when needed.
+    // An empty default-constructed buffer grows from BufferPool::Reads().
+    void resize(size_t n);
+
+private:
+    friend class BufferPool;
+    void Release();
+
+    BufferPool *pool_ = nullptr;
+    uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+};
+
+struct BufferPoolStats
+{
+    uint64_t acquires;
+    uint64_t allocations; // acquires that had to go to the heap
+    uint64_t retained_bytes;
+    uint64_t outstanding_bytes;
+};
+
+/**
+ * @brief Power-of-two size classes of reusable byte buffers.
+ *
+ * Read-ahead segments, probe buffers and decoded thumbnails are requested at a
+ * handful of sizes over and over; recycling them keeps the allocator out of
+ * the hot path and the heap from fragmenting under scroll load. Released
+ * buffers are kept up to a byte limit, beyond which they are freed. Requests
+ * larger than the biggest class are served straight from the heap.
+ */
+class BufferPool
+{
+public:
+    // Read-ahead segments and probe buffers
+    static BufferPool &Reads();
+    // Decoded thumbnail pixels
+    static BufferPool &Pixels();
+
+    explicit BufferPool(size_t maxRetainedBytes);
+    ~BufferPool();
+
+    BufferPool(const BufferPool &) = delete;
+    BufferPool &operator=(const BufferPool &) = delete;
+
+    PooledBuffer Acquire(size_t bytes);
+
+    BufferPoolStats Stats() const;
+
+    // Frees every retained buffer.
+    void Trim();
+
+    static constexpr size_t kMinClassBytes = 4 * 1024;
+    static constexpr size_t kMaxClassBytes = 64 * 1024 * 1024;
+
+private:
+    friend class PooledBuffer;
+    void Return(uint8_t *data, size_t capacity);
+
+    static constexpr size_t kClasses = 15; // 4 KB .. 64 MB
+
+    const size_t maxRetainedBytes_;
+    mutable std::mutex mutex_;
+    std::vector<uint8_t *> free_[kClasses];
+    uint64_t acquires_ = 0;
+    uint64_t allocations_ = 0;
+    uint64_t retainedBytes_ = 0;
+    uint64_t outstandingBytes_ = 0;
+};
+
+/**
+ * @brief A byte budget shared by work items that are in flight at once.
+ *
+ * Acquire blocks while granting the request would take the total over the
+ * limit, so whoever schedules the work slows down instead of the process
+ * growing. A request is always granted when nothing else holds the budget,
+ * so an item larger than the limit still runs, alone.
+ */
+class MemoryBudget
+{
+public:
+    // Decoded thumbnails being produced or hashed
+    static MemoryBudget &Thumbnails();
+
+    explicit MemoryBudget(uint64_t limitBytes);
+
+    class Lease
+    {
+    public:
+        Lease() = default;
+        Lease(Lease &&other) noexcept : budget_(other.budget_), bytes_(other.bytes_) { other.budget_ = nullptr; }
+        Lease &operator=(Lease &&other) noexcept;
+        ~Lease() { Release(); }
+
+        void Release();
+
+    private:
+        friend class MemoryBudget;
+        MemoryBudget *budget_ = nullptr;
+        uint64_t bytes_ = 0;
+    };
+
+    Lease Acquire(uint64_t bytes);
+    bool TryAcquire(uint64_t bytes, Lease *lease);
+
+    void SetLimit(uint64_t limitBytes);
+    uint64_t Limit() const;
+    uint64_t InFlight() const;
+    uint64_t HighWater() const;
+    // Acquires that had to wait
+    uint64_t Waits() const;
+
+private:
+    void Return(uint64_t bytes);
+
+    mutable std::mutex mutex_;
+    std::condition_variable released_;
+    uint64_t limit_;
+    uint64_t inFlight_ = 0;
+    uint64_t highWater_ = 0;
+    uint64_t waits_ = 0;
+};
+
+#endif // BUFFER_POOL_H
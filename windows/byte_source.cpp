@@ -0,0 +1,326 @@
+#include "byte_source.h"
+#include "buffer_pool.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    constexpr uint64_t kPageSize = 4096;
+    constexpr size_t kSegments = 4;
+    // A segment keeps growing while a parser walks forward, up to this many read-aheads
+    constexpr size_t kMaxSegmentReadAheads = 8;
+
+#ifdef _WIN32
+    HANDLE OpenForRead(const PathChar *path, AccessPattern pattern)
+    {
+        const DWORD flags = pattern == AccessPattern::Sequential ? FILE_FLAG_SEQUENTIAL_SCAN : FILE_FLAG_RANDOM_ACCESS;
+        return CreateFileW(path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING, flags,
+                           nullptr);
+    }
+#else
+    void Advise(int fd, AccessPattern pattern)
+    {
+#ifdef POSIX_FADV_RANDOM
+        posix_fadvise(fd, 0, 0, pattern == AccessPattern::Sequential ? POSIX_FADV_SEQUENTIAL : POSIX_FADV_RANDOM);
+#else
+        (void)fd;
+        (void)pattern;
+#endif
+    }
+#endif
+
+    class FileSource : public ByteSource
+    {
+    public:
+        explicit FileSource(size_t readAhead) : readAhead_(std::max<size_t>(readAhead, 512)) {}
+
+#ifdef _WIN32
+        ~FileSource() override
+        {
+            if (handle_ != INVALID_HANDLE_VALUE) CloseHandle(handle_);
+        }
+
+        bool Open(const PathChar *path, AccessPattern pattern)
+        {
+            handle_ = OpenForRead(path, pattern);
+            LARGE_INTEGER size;
+            if (handle_ == INVALID_HANDLE_VALUE || !GetFileSizeEx(handle_, &size)) return false;
+            size_ = static_cast<uint64_t>(size.QuadPart);
+            return true;
+        }
+
+        // The flags chosen at open cannot be changed on Windows
+        void Hint(AccessPattern) override {}
+#else
+        ~FileSource() override
+        {
+            if (fd_ >= 0) close(fd_);
+        }
+
+        bool Open(const PathChar *path, AccessPattern pattern)
+        {
+            fd_ = open(path, O_RDONLY | O_CLOEXEC);
+            struct stat st;
+            if (fd_ < 0 || fstat(fd_, &st) != 0) return false;
+            size_ = static_cast<uint64_t>(st.st_size);
+            Advise(fd_, pattern);
+            return true;
+        }
+
+        void Hint(AccessPattern pattern) override { Advise(fd_, pattern); }
+#endif
+
+        uint64_t Size() const override { return size_; }
+
+        size_t ReadAt(uint64_t offset, uint8_t *buffer, size_t length) override
+        {
+            size_t done = 0;
+            while (done < length && offset + done < size_)
+            {
+                const uint64_t position = offset + done;
+                Segment *segment = Find(position);
+                if (segment == nullptr && length - done >= readAhead_)
+                {
+                    // Large reads gain nothing from the cache
+                    const size_t read = Read(position, buffer + done, length - done);
+                    done += read;
+                    break;
+                }
+                if (segment == nullptr) segment = Fill(position);
+                if (segment == nullptr) break;
+
+                const size_t skip = static_cast<size_t>(position - segment->offset);
+                const size_t n = std::min(length - done, segment->data.size() - skip);
+                std::memcpy(buffer + done, segment->data.data() + skip, n);
+                segment->lastUse = ++useClock_;
+                done += n;
+            }
+            return done;
+        }
+
+    private:
+        struct Segment
+        {
+            uint64_t offset = 0;
+            PooledBuffer data; // recycled across sources through BufferPool::Reads()
+            uint64_t lastUse = 0;
+        };
+
+        Segment *Find(uint64_t position)
+        {
+            for (Segment &segment : segments_)
+                if (position >= segment.offset && position < segment.offset + segment.data.size()) return &segment;
+            return nullptr;
+        }
+
+        Segment *Fill(uint64_t position)
+        {
+            // Walking forward: extend the segment that ends here rather than starting another
+            for (Segment &segment : segments_)
+            {
+                if (segment.data.empty() || segment.offset + segment.data.size() != position) continue;
+                if (segment.data.size() + readAhead_ > readAhead_ * kMaxSegmentReadAheads) break;
+
+                const size_t before = segment.data.size();
+                const size_t want = static_cast<size_t>(std::min<uint64_t>(readAhead_, size_ - position));
+                segment.data.resize(before + want);
+                const size_t read = Read(position, segment.data.data() + before, want);
+                segment.data.resize(before + read);
+                return read > 0 ? &segment : nullptr;
+            }
+
+            Segment *victim = &segments_[0];
+            for (Segment &segment : segments_)
+                if (segment.lastUse < victim->lastUse) victim = &segment;
+
+            // Page-aligned unless that would waste most of a small read-ahead
+            uint64_t start = position & ~(kPageSize - 1);
+            if (position - start >= readAhead_ / 2) start = position;
+            const size_t want = static_cast<size_t>(std::min<uint64_t>(readAhead_, size_ - start));
+            victim->offset = start;
+            if (victim->data.capacity() < want) victim->data = BufferPool::Reads().Acquire(want);
+            victim->data.resize(want);
+            victim->data.resize(Read(start, victim->data.data(), want));
+            return position < start + victim->data.size() ? victim : nullptr;
+        }
+
+        size_t Read(uint64_t offset, uint8_t *buffer, size_t length)
+        {
+            size_t total = 0;
+#ifdef _WIN32
+            while (total < length)
+            {
+                OVERLAPPED overlapped = {};
+                overlapped.Offset = static_cast<DWORD>(offset + total);
+                overlapped.OffsetHigh = static_cast<DWORD>((offset + total) >> 32);
+                DWORD read = 0;
+                const DWORD chunk = static_cast<DWORD>(std::min<size_t>(length - total, 1u << 30));
+                if (!ReadFile(handle_, buffer + total, chunk, &read, &overlapped) || read == 0) break;
+                total += read;
+            }
+#else
+            while (total < length)
+            {
+                ssize_t n = pread(fd_, buffer + total, length - total, static_cast<off_t>(offset + total));
+                if (n < 0 && errno == EINTR) continue;
+                if (n <= 0) break;
+                total += static_cast<size_t>(n);
+            }
+#endif
+            Account(total);
+            return total;
+        }
+
+#ifdef _WIN32
+        HANDLE handle_ = INVALID_HANDLE_VALUE;
+#else
+        int fd_ = -1;
+#endif
+        uint64_t size_ = 0;
+        const size_t readAhead_;
+        Segment segments_[kSegments];
+        uint64_t useClock_ = 0;
+    };
+
+    class MappedSource : public ByteSource
+    {
+    public:
+#ifdef _WIN32
+        ~MappedSource() override
+        {
+            if (base_ != nullptr) UnmapViewOfFile(base_);
+        }
+
+        bool Open(const PathChar *path, AccessPattern pattern)
+        {
+            HANDLE file = OpenForRead(path, pattern);
+            if (file == INVALID_HANDLE_VALUE) return false;
+            LARGE_INTEGER size;
+            bool ok = GetFileSizeEx(file, &size) != 0;
+            size_ = ok ? static_cast<uint64_t>(size.QuadPart) : 0;
+            if (ok && size_ > 0)
+            {
+                HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                if (mapping != nullptr)
+                {
+                    base_ = static_cast<const uint8_t *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+                    CloseHandle(mapping); // the view keeps the mapping alive
+                }
+                ok = base_ != nullptr;
+            }
+            CloseHandle(file);
+            return ok;
+        }
+#else
+        ~MappedSource() override
+        {
+            if (base_ != nullptr) munmap(const_cast<uint8_t *>(base_), static_cast<size_t>(size_));
+        }
+
+        bool Open(const PathChar *path, AccessPattern pattern)
+        {
+            const int fd = open(path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0) return false;
+            struct stat st;
+            bool ok = fstat(fd, &st) == 0;
+            size_ = ok ? static_cast<uint64_t>(st.st_size) : 0;
+            if (ok && size_ > 0)
+            {
+                void *base = mmap(nullptr, static_cast<size_t>(size_), PROT_READ, MAP_SHARED, fd, 0);
+                base_ = base == MAP_FAILED ? nullptr : static_cast<const uint8_t *>(base);
+                ok = base_ != nullptr;
+                if (ok) Hint(pattern);
+            }
+            close(fd); // the mapping keeps the file open
+            return ok;
+        }
+
+        void Hint(AccessPattern pattern) override
+        {
+            if (base_ != nullptr)
+                madvise(const_cast<uint8_t *>(base_), static_cast<size_t>(size_), pattern == AccessPattern::Sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+        }
+#endif
+
+        uint64_t Size() const override { return size_; }
+
+        size_t ReadAt(uint64_t offset, uint8_t *buffer, size_t length) override
+        {
+            if (offset >= size_) return 0;
+            const size_t n = static_cast<size_t>(std::min<uint64_t>(length, size_ - offset));
+            std::memcpy(buffer, base_ + offset, n);
+            Account(n);
+            return n;
+        }
+
+        const uint8_t *View(uint64_t offset, size_t length) override
+        {
+            if (offset > size_ || length > size_ - offset) return nullptr;
+            Account(length);
+            return base_ + offset;
+        }
+
+    private:
+        const uint8_t *base_ = nullptr;
+        uint64_t size_ = 0;
+    };
+
+    class MemorySource : public ByteSource
+    {
+    public:
+        MemorySource(const uint8_t *data, size_t length) : data_(data, data + length) {}
+
+        uint64_t Size() const override { return data_.size(); }
+
+        size_t ReadAt(uint64_t offset, uint8_t *buffer, size_t length) override
+        {
+            if (offset >= data_.size()) return 0;
+            const size_t n = static_cast<size_t>(std::min<uint64_t>(length, data_.size() - offset));
+            std::memcpy(buffer, data_.data() + offset, n);
+            Account(n);
+            return n;
+        }
+
+        const uint8_t *View(uint64_t offset, size_t length) override
+        {
+            if (offset > data_.size() || length > data_.size() - offset) return nullptr;
+            Account(length);
+            return data_.data() + offset;
+        }
+
+    private:
+        std::vector<uint8_t> data_;
+    };
+}
+
+std::unique_ptr<ByteSource> OpenFileSource(const PathChar *path, AccessPattern pattern, size_t readAhead)
+{
+    if (path == nullptr || path[0] == 0) return nullptr;
+    auto source = std::make_unique<FileSource>(readAhead);
+    if (!source->Open(path, pattern)) return nullptr;
+    return source;
+}
+
+std::unique_ptr<ByteSource> OpenMappedSource(const PathChar *path, AccessPattern pattern)
+{
+    if (path == nullptr || path[0] == 0) return nullptr;
+    auto source = std::make_unique<MappedSource>();
+    if (!source->Open(path, pattern)) return nullptr;
+    return source;
+}
+
+std::unique_ptr<ByteSource> MakeMemorySource(const uint8_t *data, size_t length)
+{
+    return std::make_unique<MemorySource>(data, length);
+}
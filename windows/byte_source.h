@@ -0,0 +1,84 @@
+#ifndef BYTE_SOURCE_H
+#define BYTE_SOURCE_H
+
+#include "native_path.h"
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+// How a parser is about to walk a file; mapped to posix_fadvise/madvise or to CreateFileW flags.
+enum class AccessPattern : uint8_t
+{
+    Random,     // header probes: a few scattered ranges
+    Sequential, // hashing, cluster scans
+};
+
+/**
+ * @brief Random-access bytes of one file, independent of how they are fetched.
+ *
+ * Every container parser reads through this interface so the backend (memory
+ * map, positional reads with read-ahead, or a buffer in tests) can be swapped
+ * freely. A source belongs to one probe at a time and is not thread-safe.
+ */
+class ByteSource
+{
+public:
+    virtual ~ByteSource() = default;
+
+    virtual uint64_t Size() const = 0;
+
+    // Copies up to length bytes at offset; short at end of file or on error.
+    virtual size_t ReadAt(uint64_t offset, uint8_t *buffer, size_t length) = 0;
+
+    // Zero-copy access where the backend already holds the bytes, nullptr otherwise.
+    virtual const uint8_t *View(uint64_t offset, size_t length)
+    {
+        (void)offset;
+        (void)length;
+        return nullptr;
+    }
+
+    // Changes the access pattern of an open source, where the platform allows it.
+    virtual void Hint(AccessPattern pattern) { (void)pattern; }
+
+    // Bytes pulled from storage, including read-ahead, and the calls that pulled them.
+    uint64_t BytesRead() const { return bytesRead_; }
+    uint32_t ReadCalls() const { return readCalls_; }
+
+protected:
+    void Account(size_t bytes)
+    {
+        bytesRead_ += bytes;
+        readCalls_++;
+    }
+
+private:
+    uint64_t bytesRead_ = 0;
+    uint32_t readCalls_ = 0;
+};
+
+// Default read-ahead of the positional-read backend: one request usually covers the next box or element too.
+constexpr size_t kDefaultReadAhead = 16 * 1024;
+
+/**
+ * @brief Positional reads (pread/ReadFile) behind a small read-ahead cache.
+ *
+ * Requests smaller than readAhead are served from a few cached segments; a miss
+ * right after a segment extends it instead of starting a new one, so a parser
+ * walking adjacent ranges costs one read per readAhead bytes. Larger requests
+ * bypass the cache.
+ */
+std::unique_ptr<ByteSource> OpenFileSource(const PathChar *path, AccessPattern pattern, size_t readAhead = kDefaultReadAhead);
+
+/**
+ * @brief Maps the whole file read-only.
+ *
+ * Cheapest for local files that are not being written. A file truncated while
+ * mapped faults on access, so probes of growing downloads use OpenFileSource.
+ */
+std::unique_ptr<ByteSource> OpenMappedSource(const PathChar *path, AccessPattern pattern);
+
+// Copies data into a source owned by the returned object; for tests and already-buffered data.
+std::unique_ptr<ByteSource> MakeMemorySource(const uint8_t *data, size_t length);
+
+#endif // BYTE_SOURCE_H
@@ -0,0 +1,153 @@
+#include "container_layout.h"
+#include "container_parse.h"
+#include <algorithm>
+
+namespace
+{
+    constexpr size_t kHeadBytes = 16 * 1024;
+    constexpr uint32_t kMaxTopLevelElements = 256;
+
+    constexpr uint64_t kEbmlHeader = 0x1A45DFA3;
+    constexpr uint64_t kSegment = 0x18538067;
+    constexpr uint64_t kSeekHead = 0x114D9B74;
+    constexpr uint64_t kSeek = 0x4DBB;
+    constexpr uint64_t kSeekId = 0x53AB;
+    constexpr uint64_t kSeekPosition = 0x53AC;
+    constexpr uint64_t kInfo = 0x1549A966;
+    constexpr uint64_t kTimestampScale = 0x2AD7B1;
+    constexpr uint64_t kDuration = 0x4489;
+    constexpr uint64_t kTracks = 0x1654AE6B;
+    constexpr uint64_t kTrackEntry = 0xAE;
+    constexpr uint64_t kTrackNumber = 0xD7;
+    constexpr uint64_t kTrackType = 0x83;
+
+    uint64_t FirstVideoTrack(const ScratchBytes &tracks)
+    {
+        uint64_t video = 0;
+        ForEachChild(tracks.data(), tracks.size(), [&](uint64_t id, const uint8_t *entry, size_t length) {
+            if (id != kTrackEntry || video != 0) return;
+            uint64_t number = 0, type = 0;
+            ForEachChild(entry, length, [&](uint64_t child, const uint8_t *value, size_t size) {
+                if (child == kTrackNumber) number = ReadBeUInt(value, size);
+                if (child == kTrackType) type = ReadBeUInt(value, size);
+            });
+            if (type == 1) video = number;
+        });
+        return video;
+    }
+}
+
+bool ReadMoovBox(ByteSource &source, ScratchBytes *moov)
+{
+    const uint64_t fileSize = source.Size();
+    uint64_t pos = 0;
+    for (uint32_t i = 0; i < kMaxTopLevelElements && pos + 8 <= fileSize; i++)
+    {
+        uint8_t header[16];
+        const size_t n = source.ReadAt(pos, header, sizeof(header));
+        uint64_t size;
+        uint32_t headerLength;
+        if (!ReadBoxHeader(header, n, 0, fileSize - pos, &size, &headerLength)) return false;
+        if (BoxTypeIs(header, "moov"))
+        {
+            const uint64_t payload = std::min(size, fileSize - pos) - headerLength;
+            if (payload > kMaxMoovBytes) return false;
+            moov->resize(static_cast<size_t>(payload));
+            return source.ReadAt(pos + headerLength, moov->data(), moov->size()) == moov->size();
+        }
+        pos += size;
+    }
+    return false;
+}
+
+bool ReadElementAt(ByteSource &source, uint64_t offset, EbmlElement *element)
+{
+    uint8_t buffer[12];
+    const size_t n = source.ReadAt(offset, buffer, sizeof(buffer));
+    size_t pos = 0;
+    if (!ReadElementHeader(buffer, n, &pos, &element->id, &element->size, &element->unknownSize)) return false;
+    element->payload = offset + pos;
+    return true;
+}
+
+bool ReadElementPayload(ByteSource &source, const EbmlElement &element, uint64_t limit, ScratchBytes *out)
+{
+    if (element.unknownSize || element.size > limit) return false;
+    out->resize(static_cast<size_t>(element.size));
+    return source.ReadAt(element.payload, out->data(), out->size()) == out->size();
+}
+
+bool ReadBlockHeader(ByteSource &source, uint64_t offset, uint64_t *track, int16_t *relative, uint8_t *flags)
+{
+    uint8_t buffer[11];
+    const size_t n = source.ReadAt(offset, buffer, sizeof(buffer));
+    size_t pos = 0;
+    if (!ReadVint(buffer, n, &pos, false, track) || pos + 3 > n) return false;
+    *relative = static_cast<int16_t>(ReadBe16(buffer + pos));
+    *flags = buffer[pos + 2];
+    return true;
+}
+
+bool ReadMatroskaLayout(ByteSource &source, MatroskaLayout *layout)
+{
+    uint8_t head[kHeadBytes];
+    const size_t headLength = source.ReadAt(0, head, sizeof(head));
+    size_t pos = 0;
+    uint64_t id, size;
+    bool unknown = false;
+    if (!ReadElementHeader(head, headLength, &pos, &id, &size) || id != kEbmlHeader || size > headLength - pos) return false;
+    pos += static_cast<size_t>(size);
+    if (!ReadElementHeader(head, headLength, &pos, &id, &size, &unknown) || id != kSegment) return false;
+
+    const uint64_t segmentStart = pos;
+    layout->segmentStart = segmentStart;
+    layout->segmentEnd = unknown ? source.Size() : std::min(source.Size(), segmentStart + size);
+
+    // Top-level elements before the first cluster, plus whatever the SeekHead points at
+    uint64_t infoAt = 0, tracksAt = 0;
+    uint64_t at = segmentStart;
+    EbmlElement element;
+    for (uint32_t i = 0; i < kMaxTopLevelElements && at < layout->segmentEnd && ReadElementAt(source, at, &element); i++)
+    {
+        if (element.id == kInfo && infoAt == 0) infoAt = at;
+        if (element.id == kTracks && tracksAt == 0) tracksAt = at;
+        if (element.id == kMkvCues && layout->cuesAt == 0) layout->cuesAt = at;
+        if (element.id == kMkvCluster)
+        {
+            layout->firstCluster = at;
+            break;
+        }
+        ScratchBytes seekHead;
+        if (element.id == kSeekHead && ReadElementPayload(source, element, kMaxMkvHeaderElementBytes, &seekHead))
+        {
+            ForEachChild(seekHead.data(), seekHead.size(), [&](uint64_t child, const uint8_t *seek, size_t length) {
+                if (child != kSeek) return;
+                uint64_t target = 0, position = 0;
+                ForEachChild(seek, length, [&](uint64_t field, const uint8_t *value, size_t n) {
+                    if (field == kSeekId) target = ReadBeUInt(value, n);
+                    if (field == kSeekPosition) position = ReadBeUInt(value, n);
+                });
+                uint64_t *slot = target == kInfo ? &infoAt : target == kTracks ? &tracksAt : target == kMkvCues ? &layout->cuesAt : nullptr;
+                if (slot != nullptr && *slot == 0) *slot = segmentStart + position;
+            });
+        }
+        if (element.unknownSize) break;
+        at = element.payload + element.size;
+    }
+
+    ScratchBytes payload;
+    if (infoAt != 0 && ReadElementAt(source, infoAt, &element) && element.id == kInfo &&
+        ReadElementPayload(source, element, kMaxMkvHeaderElementBytes, &payload))
+    {
+        ForEachChild(payload.data(), payload.size(), [&](uint64_t child, const uint8_t *value, size_t n) {
+            const uint64_t scale = child == kTimestampScale ? ReadBeUInt(value, n) : 0;
+            if (scale != 0) layout->ticksPerSecond = 1e9 / static_cast<double>(scale);
+            if (child == kDuration) layout->durationTicks = ReadBeFloat(value, n);
+        });
+    }
+
+    if (tracksAt != 0 && ReadElementAt(source, tracksAt, &element) && element.id == kTracks &&
+        ReadElementPayload(source, element, kMaxMkvHeaderElementBytes, &payload))
+        layout->videoTrack = FirstVideoTrack(payload);
+    return true;
+}
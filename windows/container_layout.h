@@ -0,0 +1,115 @@
+#ifndef CONTAINER_LAYOUT_H
+#define CONTAINER_LAYOUT_H
+
+#include "byte_source.h"
+#include "container_parse.h"
+#include "scratch_arena.h"
+#include <cstdint>
+
+// Where the index data of MP4 and Matroska files lives: the sample tables of the
+// moov box, and the Cues and clusters of a Matroska segment. Shared by the
+// builders that work from index data only.
+
+// === ISO-BMFF ===
+
+constexpr uint64_t kMaxMoovBytes = 64ull << 20;
+
+// Reads the payload of the top-level moov box. Call inside a ScratchArena::Scope.
+bool ReadMoovBox(ByteSource &source, ScratchBytes *moov);
+
+struct MediaTrack
+{
+    const uint8_t *handler; // 4 bytes: "vide", "soun", ...
+    uint32_t timescale;     // media ticks per second
+    const uint8_t *stbl;
+    size_t stblLength;
+};
+
+// Calls visit(const MediaTrack &) for each trak of @p moov that has a timescale
+// and a sample table, until it returns true. Returns whether one did.
+template <typename Visitor>
+bool ForEachMediaTrack(const uint8_t *moov, size_t length, Visitor &&visit)
+{
+    size_t pos = 0;
+    uint64_t size;
+    uint32_t header;
+    while (ReadBoxHeader(moov, length, pos, length - pos, &size, &header))
+    {
+        if (size > length - pos) size = length - pos;
+        const uint8_t *box = moov + pos;
+        pos += static_cast<size_t>(size);
+        if (!BoxTypeIs(box, "trak")) continue;
+
+        const uint8_t *trak = box + header;
+        const size_t trakLength = static_cast<size_t>(size) - header;
+
+        const uint8_t *mdia, *hdlr, *mdhd, *minf;
+        size_t mdiaLength, hdlrLength, mdhdLength, minfLength;
+        MediaTrack track;
+        if (!FindBox(trak, trakLength, "mdia", &mdia, &mdiaLength)) continue;
+        if (!FindBox(mdia, mdiaLength, "hdlr", &hdlr, &hdlrLength) || hdlrLength < 12) continue;
+        if (!FindBox(mdia, mdiaLength, "mdhd", &mdhd, &mdhdLength) || mdhdLength < 24) continue;
+        track.handler = hdlr + 8;
+        track.timescale = mdhd[0] == 1 ? (mdhdLength >= 32 ? ReadBe32(mdhd + 20) : 0) : ReadBe32(mdhd + 12);
+        if (track.timescale == 0) continue;
+        if (!FindBox(mdia, mdiaLength, "minf", &minf, &minfLength) || !FindBox(minf, minfLength, "stbl", &track.stbl, &track.stblLength))
+            continue;
+        if (visit(track)) return true;
+    }
+    return false;
+}
+
+// === Matroska ===
+
+// Matroska element IDs the index builders look for (with length marker)
+constexpr uint64_t kMkvCues = 0x1C53BB6B;
+constexpr uint64_t kMkvCuePoint = 0xBB;
+constexpr uint64_t kMkvCueTime = 0xB3;
+constexpr uint64_t kMkvCueTrackPositions = 0xB7;
+constexpr uint64_t kMkvCueTrack = 0xF7;
+constexpr uint64_t kMkvCueClusterPosition = 0xF1;
+constexpr uint64_t kMkvCluster = 0x1F43B675;
+constexpr uint64_t kMkvClusterTimestamp = 0xE7;
+constexpr uint64_t kMkvSimpleBlock = 0xA3;
+constexpr uint64_t kMkvBlockGroup = 0xA0;
+constexpr uint64_t kMkvBlock = 0xA1;
+constexpr uint64_t kMkvReferenceBlock = 0xFB;
+
+constexpr uint64_t kMaxMkvHeaderElementBytes = 1ull << 20; // Info, Tracks, SeekHead
+constexpr uint64_t kMaxMkvCuesBytes = 32ull << 20;
+
+struct EbmlElement
+{
+    uint64_t id = 0;
+    uint64_t size = 0;
+    uint64_t payload = 0; // absolute offset of the payload
+    bool unknownSize = false;
+};
+
+bool ReadElementAt(ByteSource &source, uint64_t offset, EbmlElement *element);
+// Reads the payload of an element of known size up to @p limit bytes.
+bool ReadElementPayload(ByteSource &source, const EbmlElement &element, uint64_t limit, ScratchBytes *out);
+// Track number, relative timestamp and flags at the start of a (Simple)Block payload.
+bool ReadBlockHeader(ByteSource &source, uint64_t offset, uint64_t *track, int16_t *relative, uint8_t *flags);
+
+/**
+ * @brief Where the top-level elements of a Matroska segment are, and what Info and Tracks say.
+ *
+ * Offsets are absolute; 0 means the element was not found among the elements
+ * before the first cluster or through the SeekHead.
+ */
+struct MatroskaLayout
+{
+    uint64_t segmentStart = 0; // Matroska positions are relative to this
+    uint64_t segmentEnd = 0;
+    uint64_t cuesAt = 0;
+    uint64_t firstCluster = 0;
+    double ticksPerSecond = 1000.0; // default TimestampScale: 1 ms
+    double durationTicks = 0.0;     // 0 if Info has no Duration
+    uint64_t videoTrack = 0;        // first video track number; 0 if there is none
+};
+
+// Reads the EBML header, the segment head, Info and Tracks. Call inside a ScratchArena::Scope.
+bool ReadMatroskaLayout(ByteSource &source, MatroskaLayout *layout);
+
+#endif // CONTAINER_LAYOUT_H
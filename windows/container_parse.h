@@ -0,0 +1,147 @@
+#ifndef CONTAINER_PARSE_H
+#define CONTAINER_PARSE_H
+
+// Big-endian, little-endian and EBML readers shared by the container parsers.
+// All of them check bounds against the buffer they are given and never read past it.
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+inline uint16_t ReadBe16(const uint8_t *p) { return static_cast<uint16_t>((p[0] << 8) | p[1]); }
+
+inline uint32_t ReadBe32(const uint8_t *p)
+{
+    return (uint32_t(p[0]) << 24) | (uint32_t(p[1]) << 16) | (uint32_t(p[2]) << 8) | uint32_t(p[3]);
+}
+
+inline uint64_t ReadBe64(const uint8_t *p) { return (uint64_t(ReadBe32(p)) << 32) | ReadBe32(p + 4); }
+
+inline uint16_t ReadLe16(const uint8_t *p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+
+inline uint32_t ReadLe32(const uint8_t *p)
+{
+    return uint32_t(p[0]) | (uint32_t(p[1]) << 8) | (uint32_t(p[2]) << 16) | (uint32_t(p[3]) << 24);
+}
+
+inline uint64_t ReadLe64(const uint8_t *p) { return uint64_t(ReadLe32(p)) | (uint64_t(ReadLe32(p + 4)) << 32); }
+
+// Unsigned integer of 0-8 bytes, as EBML stores them
+inline uint64_t ReadBeUInt(const uint8_t *p, size_t length)
+{
+    uint64_t value = 0;
+    for (size_t i = 0; i < length && i < 8; i++) value = (value << 8) | p[i];
+    return value;
+}
+
+// EBML float element: 4 or 8 bytes, 0 for anything else
+inline double ReadBeFloat(const uint8_t *p, size_t length)
+{
+    if (length == 4)
+    {
+        const uint32_t bits = ReadBe32(p);
+        float value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    if (length == 8)
+    {
+        const uint64_t bits = ReadBe64(p);
+        double value;
+        std::memcpy(&value, &bits, sizeof(value));
+        return value;
+    }
+    return 0.0;
+}
+
+// EBML variable-length integer. IDs keep their length marker, sizes do not;
+// an all-ones size means "unknown" (live streams) and is reported as such.
+inline bool ReadVint(const uint8_t *data, size_t length, size_t *pos, bool keepMarker, uint64_t *value, bool *unknown = nullptr)
+{
+    if (*pos >= length || data[*pos] == 0) return false;
+    const uint8_t first = data[*pos];
+    size_t width = 1;
+    while (!(first & (0x80 >> (width - 1)))) width++;
+    if (*pos + width > length) return false;
+
+    uint64_t result = keepMarker ? first : (first & (0xFF >> width));
+    for (size_t i = 1; i < width; i++) result = (result << 8) | data[*pos + i];
+    *pos += width;
+    *value = result;
+    if (unknown != nullptr) *unknown = !keepMarker && result == (uint64_t(1) << (7 * width)) - 1;
+    return true;
+}
+
+// Element ID then size; the size is not checked against the buffer
+inline bool ReadElementHeader(const uint8_t *data, size_t length, size_t *pos, uint64_t *id, uint64_t *size, bool *unknown = nullptr)
+{
+    return ReadVint(data, length, pos, true, id) && ReadVint(data, length, pos, false, size, unknown);
+}
+
+/**
+ * @brief Reads an ISO-BMFF box header at @p pos.
+ *
+ * @param remaining Bytes from @p pos to the end of the enclosing box or file;
+ *                  a size-0 box extends to it.
+ * @return false if the header does not fit or the size is impossible
+ */
+inline bool ReadBoxHeader(const uint8_t *data, size_t length, size_t pos, uint64_t remaining, uint64_t *size, uint32_t *header)
+{
+    if (pos + 8 > length) return false;
+    *size = ReadBe32(data + pos);
+    *header = 8;
+    if (*size == 1)
+    {
+        if (pos + 16 > length) return false;
+        *size = ReadBe64(data + pos + 8);
+        *header = 16;
+    }
+    else if (*size == 0)
+        *size = remaining;
+    return *size >= *header;
+}
+
+inline bool BoxTypeIs(const uint8_t *box, const char *type) { return std::memcmp(box + 4, type, 4) == 0; }
+
+// Finds a direct child box and returns its payload
+inline bool FindBox(const uint8_t *p, size_t length, const char *type, const uint8_t **payload, size_t *payloadLength)
+{
+    size_t pos = 0;
+    uint64_t size;
+    uint32_t header;
+    while (ReadBoxHeader(p, length, pos, length - pos, &size, &header))
+    {
+        if (size > length - pos) size = length - pos;
+        if (BoxTypeIs(p + pos, type))
+        {
+            *payload = p + pos + header;
+            *payloadLength = static_cast<size_t>(size) - header;
+            return true;
+        }
+        pos += static_cast<size_t>(size);
+    }
+    return false;
+}
+
+// Full box with a 32-bit entry count after version/flags; checks the table fits
+inline bool EntryTable(const uint8_t *box, size_t length, size_t prefix, size_t entrySize, uint32_t *count)
+{
+    if (box == nullptr || length < prefix) return false;
+    *count = ReadBe32(box + prefix - 4);
+    return (length - prefix) / entrySize >= *count;
+}
+
+// Calls visit(id, payload, size) for each EBML child element that fits in the buffer
+template <typename Visitor>
+void ForEachChild(const uint8_t *p, size_t length, Visitor &&visit)
+{
+    size_t pos = 0;
+    uint64_t id, size;
+    while (ReadElementHeader(p, length, &pos, &id, &size) && size <= length - pos)
+    {
+        visit(id, p + pos, static_cast<size_t>(size));
+        pos += static_cast<size_t>(size);
+    }
+}
+
+#endif // CONTAINER_PARSE_H
@@ -0,0 +1,324 @@
+#include "container_probe.h"
+#include "container_parse.h"
+#include "content_sniffer.h"
+#include "element_dispatch.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // Matroska element IDs (with length marker) looked up outside the rule tables
+    constexpr uint64_t kEbmlHeader = 0x1A45DFA3;
+    constexpr uint64_t kSegment = 0x18538067;
+    constexpr uint64_t kTracks = 0x1654AE6B;
+    constexpr uint64_t kAttachments = 0x1941A469;
+
+    // EBML header plus the Segment header; real files need well under this
+    constexpr size_t kSegmentHeadBytes = 1024;
+
+    template <size_t N>
+    void CopyText(const uint8_t *p, size_t length, char (&out)[N])
+    {
+        const size_t n = std::min(length, N - 1);
+        std::memcpy(out, p, n);
+        out[n] = '\0';
+    }
+
+    bool IsIsoBmff(ContainerKind kind) { return kind == ContainerKind::IsoBmff || kind == ContainerKind::QuickTime; }
+    bool IsMatroska(ContainerKind kind) { return kind == ContainerKind::Matroska || kind == ContainerKind::WebM; }
+
+    // Payload range of the Matroska Segment
+    bool FindSegment(ByteSource &source, uint64_t *begin, uint64_t *end)
+    {
+        uint8_t head[kSegmentHeadBytes];
+        const size_t length = source.ReadAt(0, head, sizeof(head));
+        size_t pos = 0;
+        uint64_t id, size;
+        bool unknown = false;
+        if (!ReadElementHeader(head, length, &pos, &id, &size) || id != kEbmlHeader || size > length - pos) return false;
+        pos += static_cast<size_t>(size);
+        if (!ReadElementHeader(head, length, &pos, &id, &size, &unknown) || id != kSegment) return false;
+        *begin = pos;
+        *end = unknown ? source.Size() : std::min(source.Size(), pos + size);
+        return true;
+    }
+
+    // Where the SeekHead says one top-level element is, for files that write it after the clusters
+    struct SeekTarget
+    {
+        uint64_t id;
+        uint64_t segmentStart = 0;
+        uint64_t position = 0; // absolute, 0 if not listed
+        uint64_t seekId = 0;
+        uint64_t seekPosition = 0;
+        bool hasPosition = false;
+
+        void OnEnter(const ElementRule &rule)
+        {
+            if (rule.field != ElementField::SeekEntry) return;
+            seekId = 0;
+            hasPosition = false;
+        }
+
+        void OnLeave(const ElementRule &rule)
+        {
+            if (rule.field == ElementField::SeekEntry && seekId == id && hasPosition && position == 0)
+                position = segmentStart + seekPosition;
+        }
+
+        void OnField(const ElementRule &rule, const ElementValue &value)
+        {
+            if (rule.field == ElementField::SeekId) seekId = value.uint;
+            if (rule.field == ElementField::SeekPosition)
+            {
+                seekPosition = value.uint;
+                hasPosition = true;
+            }
+        }
+    };
+
+    // Walks a kind's tables over the file: moov for MP4; for Matroska the
+    // Segment up to the first cluster, then the target element if the
+    // SeekHead placed it further on.
+    template <ProbeKind Kind, typename Visitor>
+    bool WalkContainer(ByteSource &source, Visitor &visitor)
+    {
+        SourceReader reader{source};
+        const ContainerKind kind = SniffSource(source);
+        if (IsIsoBmff(kind))
+        {
+            WalkElements<IsoBmffRules<Kind>>(reader, 0, source.Size(), visitor);
+            return true;
+        }
+        uint64_t begin, end;
+        if (!IsMatroska(kind) || !FindSegment(source, &begin, &end)) return false;
+        visitor.seek.segmentStart = begin;
+        if (!WalkElements<EbmlRules<Kind>>(reader, begin, end, visitor)) return true;
+        if (visitor.seek.position > begin && visitor.seek.position < end)
+            WalkElements<EbmlRules<Kind>>(reader, visitor.seek.position, end, visitor);
+        return true;
+    }
+
+    StreamType HandlerStreamType(const uint8_t *handler)
+    {
+        if (std::memcmp(handler, "vide", 4) == 0) return StreamType::Video;
+        if (std::memcmp(handler, "soun", 4) == 0) return StreamType::Audio;
+        if (std::memcmp(handler, "sbtl", 4) == 0 || std::memcmp(handler, "subt", 4) == 0 || std::memcmp(handler, "text", 4) == 0)
+            return StreamType::Subtitle;
+        return StreamType::Other;
+    }
+
+    StreamType MatroskaStreamType(uint64_t trackType)
+    {
+        switch (trackType)
+        {
+        case 1:
+            return StreamType::Video;
+        case 2:
+            return StreamType::Audio;
+        case 0x11:
+            return StreamType::Subtitle;
+        default:
+            return StreamType::Other;
+        }
+    }
+
+    // First sample entry of stsd: its format, and the coded size or audio format
+    void ParseSampleDescription(const ElementValue &value, StreamInfo *stream)
+    {
+        const uint8_t *p = value.data;
+        if (value.length < 16 || ReadBe32(p + 4) == 0) return;
+        CopyText(p + 12, 4, stream->codec);
+        if (value.length < 44) return;
+        if (stream->type == StreamType::Video && stream->width == 0)
+        {
+            stream->width = ReadBe16(p + 40);
+            stream->height = ReadBe16(p + 42);
+        }
+        if (stream->type == StreamType::Audio)
+        {
+            stream->channels = ReadBe16(p + 32);
+            stream->sample_rate = ReadBe32(p + 40) >> 16;
+        }
+    }
+
+    struct StreamFields : ElementVisitor
+    {
+        std::vector<StreamInfo> *streams;
+        SeekTarget seek{kTracks};
+        StreamInfo current;
+
+        bool OnEnter(const ElementRule &rule, uint64_t, uint64_t)
+        {
+            seek.OnEnter(rule);
+            if (rule.field == ElementField::Track || rule.field == ElementField::TrackEntry) current = StreamInfo();
+            return true;
+        }
+
+        bool OnLeave(const ElementRule &rule)
+        {
+            seek.OnLeave(rule);
+            switch (rule.field)
+            {
+            case ElementField::Track:
+            case ElementField::TrackEntry:
+                streams->push_back(current);
+                return true;
+            case ElementField::Movie:
+            case ElementField::Tracks:
+                return false; // every track has been seen
+            default:
+                return true;
+            }
+        }
+
+        bool OnField(const ElementRule &rule, const ElementValue &value)
+        {
+            seek.OnField(rule, value);
+            switch (rule.field)
+            {
+            case ElementField::TrackHeader:
+                // Width and height close the box, as 16.16 fixed point
+                if (value.length == value.size && value.length >= 84)
+                {
+                    current.width = ReadBe32(value.data + value.length - 8) >> 16;
+                    current.height = ReadBe32(value.data + value.length - 4) >> 16;
+                }
+                break;
+            case ElementField::Handler:
+                if (value.length >= 12) current.type = HandlerStreamType(value.data + 8);
+                break;
+            case ElementField::SampleDescription:
+                ParseSampleDescription(value, &current);
+                break;
+            case ElementField::TrackType:
+                current.type = MatroskaStreamType(value.uint);
+                break;
+            case ElementField::CodecId:
+                CopyText(value.data, value.length, current.codec);
+                break;
+            case ElementField::PixelWidth:
+                current.width = static_cast<uint32_t>(value.uint);
+                break;
+            case ElementField::PixelHeight:
+                current.height = static_cast<uint32_t>(value.uint);
+                break;
+            case ElementField::SamplingFrequency:
+                current.sample_rate = static_cast<uint32_t>(value.real);
+                break;
+            case ElementField::Channels:
+                current.channels = static_cast<uint32_t>(value.uint);
+                break;
+            default:
+                break;
+            }
+            return true;
+        }
+    };
+
+    // iTunes data atom type indicators for images
+    const char *CoverMediaType(uint32_t indicator)
+    {
+        switch (indicator)
+        {
+        case 13:
+            return "image/jpeg";
+        case 14:
+            return "image/png";
+        case 27:
+            return "image/bmp";
+        default:
+            return nullptr;
+        }
+    }
+
+    struct CoverFields : ElementVisitor
+    {
+        CoverArt *cover;
+        SeekTarget seek{kAttachments};
+        bool found = false;
+        // Attachment being read
+        char name[64] = {};
+        char mediaType[32] = {};
+        uint64_t dataOffset = 0;
+        uint64_t dataSize = 0;
+
+        bool OnEnter(const ElementRule &rule, uint64_t, uint64_t)
+        {
+            seek.OnEnter(rule);
+            if (rule.field == ElementField::AttachedFile)
+            {
+                name[0] = mediaType[0] = '\0';
+                dataSize = 0;
+            }
+            return true;
+        }
+
+        bool OnLeave(const ElementRule &rule)
+        {
+            seek.OnLeave(rule);
+            if (rule.field == ElementField::Movie || rule.field == ElementField::Attachments) return false;
+            if (rule.field != ElementField::AttachedFile || dataSize == 0 || std::strncmp(mediaType, "image/", 6) != 0) return true;
+
+            const bool named = std::strncmp(name, "cover", 5) == 0;
+            if (!found || named)
+            {
+                cover->offset = dataOffset;
+                cover->size = dataSize;
+                std::memcpy(cover->media_type, mediaType, sizeof(mediaType));
+                found = true;
+            }
+            return !named;
+        }
+
+        bool OnField(const ElementRule &rule, const ElementValue &value)
+        {
+            seek.OnField(rule, value);
+            switch (rule.field)
+            {
+            case ElementField::CoverData:
+            {
+                // Type indicator and locale, then the image
+                const char *type = value.length >= 8 ? CoverMediaType(ReadBe32(value.data) & 0xFFFFFF) : nullptr;
+                if (type == nullptr || value.size <= 8) return true;
+                cover->offset = value.offset + 8;
+                cover->size = value.size - 8;
+                std::strcpy(cover->media_type, type);
+                found = true;
+                return false;
+            }
+            case ElementField::FileName:
+                CopyText(value.data, value.length, name);
+                break;
+            case ElementField::FileMediaType:
+                CopyText(value.data, value.length, mediaType);
+                break;
+            case ElementField::FileData:
+                dataOffset = value.offset;
+                dataSize = value.size;
+                break;
+            default:
+                break;
+            }
+            return true;
+        }
+    };
+}
+
+bool ProbeStreams(ByteSource &source, std::vector<StreamInfo> *streams)
+{
+    ScratchArena::Scope scope;
+    streams->clear();
+    StreamFields fields;
+    fields.streams = streams;
+    return WalkContainer<ProbeKind::Streams>(source, fields) && !streams->empty();
+}
+
+bool FindCoverArt(ByteSource &source, CoverArt *cover)
+{
+    ScratchArena::Scope scope;
+    CoverFields fields;
+    fields.cover = cover;
+    return WalkContainer<ProbeKind::CoverArt>(source, fields) && fields.found;
+}
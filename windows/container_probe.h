@@ -0,0 +1,56 @@
+#ifndef CONTAINER_PROBE_H
+#define CONTAINER_PROBE_H
+
+#include "byte_source.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+enum class StreamType : uint8_t
+{
+    Other,
+    Video,
+    Audio,
+    Subtitle,
+};
+
+struct StreamInfo
+{
+    StreamType type = StreamType::Other;
+    char codec[24] = {}; // MP4 sample entry ("avc1", "mp4a") or Matroska CodecID ("V_MPEG4/ISO/AVC"), truncated
+    uint32_t width = 0;  // video: display size from tkhd, else the sample entry's coded size
+    uint32_t height = 0;
+    uint32_t sample_rate = 0; // audio
+    uint32_t channels = 0;
+};
+
+/**
+ * @brief Lists the tracks of an MP4/MOV or Matroska/WebM file from its headers.
+ *
+ * Walks moov (MP4) or Tracks (Matroska, directly or through the SeekHead)
+ * with the streams rule table; sample tables, media data and clusters are
+ * stepped over by size.
+ *
+ * @return false if the container is not supported or declares no track
+ */
+bool ProbeStreams(ByteSource &source, std::vector<StreamInfo> *streams);
+
+struct CoverArt
+{
+    uint64_t offset = 0; // image bytes in the file
+    uint64_t size = 0;
+    char media_type[32] = {}; // "image/jpeg", "image/png"
+};
+
+/**
+ * @brief Locates embedded cover art without reading the image.
+ *
+ * MP4/MOV: the iTunes covr item (moov/udta/meta/ilst). Matroska: an image
+ * attachment, preferring one whose name starts with "cover" as the Matroska
+ * spec suggests.
+ *
+ * @return false if the file has none
+ */
+bool FindCoverArt(ByteSource &source, CoverArt *cover);
+
+#endif // CONTAINER_PROBE_H
@@ -0,0 +1,172 @@
+#include "content_hash.h"
+#include "buffer_pool.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ull;
+    constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4Full;
+    constexpr uint64_t kPrime3 = 0x165667B19E3779F9ull;
+    constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ull;
+    constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ull;
+
+    // Large enough that the per-read cost vanishes, small enough to stay a pooled class
+    constexpr size_t kHashChunkBytes = 1024 * 1024;
+
+    uint64_t Rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+    uint64_t ReadLe64(const uint8_t *p)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, 8); // XXH64 is defined on little-endian words; every target here is little-endian
+        return v;
+    }
+
+    uint32_t ReadLe32(const uint8_t *p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return v;
+    }
+
+    uint64_t Round(uint64_t lane, uint64_t input) { return Rotl(lane + input * kPrime2, 31) * kPrime1; }
+
+    uint64_t MergeRound(uint64_t hash, uint64_t lane) { return (hash ^ Round(0, lane)) * kPrime1 + kPrime4; }
+
+    // Head, middle and tail, or the whole file when the samples would overlap
+    size_t SampleRanges(uint64_t size, uint64_t (&offsets)[3], uint64_t (&lengths)[3])
+    {
+        if (size <= 3 * kHashSampleBytes)
+        {
+            offsets[0] = 0;
+            lengths[0] = size;
+            return 1;
+        }
+        offsets[0] = 0;
+        offsets[1] = (size - kHashSampleBytes) / 2;
+        offsets[2] = size - kHashSampleBytes;
+        lengths[0] = lengths[1] = lengths[2] = kHashSampleBytes;
+        return 3;
+    }
+}
+
+ContentHasher::ContentHasher(uint64_t seed)
+    : seed_(seed), lanes_{seed + kPrime1 + kPrime2, seed + kPrime2, seed, seed - kPrime1}
+{
+}
+
+void ContentHasher::Update(const uint8_t *data, size_t length)
+{
+    total_ += length;
+    if (pendingBytes_ + length < 32)
+    {
+        std::memcpy(pending_ + pendingBytes_, data, length);
+        pendingBytes_ += length;
+        return;
+    }
+    if (pendingBytes_ != 0)
+    {
+        const size_t fill = 32 - pendingBytes_;
+        std::memcpy(pending_ + pendingBytes_, data, fill);
+        for (int i = 0; i < 4; i++) lanes_[i] = Round(lanes_[i], ReadLe64(pending_ + i * 8));
+        data += fill;
+        length -= fill;
+        pendingBytes_ = 0;
+    }
+    for (; length >= 32; data += 32, length -= 32)
+        for (int i = 0; i < 4; i++) lanes_[i] = Round(lanes_[i], ReadLe64(data + i * 8));
+    std::memcpy(pending_, data, length);
+    pendingBytes_ = length;
+}
+
+uint64_t ContentHasher::Digest() const
+{
+    uint64_t hash;
+    if (total_ >= 32)
+    {
+        hash = Rotl(lanes_[0], 1) + Rotl(lanes_[1], 7) + Rotl(lanes_[2], 12) + Rotl(lanes_[3], 18);
+        for (int i = 0; i < 4; i++) hash = MergeRound(hash, lanes_[i]);
+    }
+    else
+        hash = seed_ + kPrime5;
+    hash += total_;
+
+    const uint8_t *p = pending_;
+    size_t left = pendingBytes_;
+    for (; left >= 8; p += 8, left -= 8) hash = Rotl(hash ^ Round(0, ReadLe64(p)), 27) * kPrime1 + kPrime4;
+    if (left >= 4)
+    {
+        hash = Rotl(hash ^ (uint64_t(ReadLe32(p)) * kPrime1), 23) * kPrime2 + kPrime3;
+        p += 4;
+        left -= 4;
+    }
+    for (; left > 0; p++, left--) hash = Rotl(hash ^ (*p * kPrime5), 11) * kPrime1;
+
+    hash ^= hash >> 33;
+    hash *= kPrime2;
+    hash ^= hash >> 29;
+    hash *= kPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+bool SampledContentHash(ByteSource &source, uint64_t *hash)
+{
+    const uint64_t size = source.Size();
+    uint64_t offsets[3], lengths[3];
+    const size_t count = SampleRanges(size, offsets, lengths);
+
+    ContentHasher hasher(size);
+    uint8_t sample[kHashSampleBytes];
+    for (size_t i = 0; i < count; i++)
+    {
+        for (uint64_t done = 0; done < lengths[i];)
+        {
+            const size_t want = static_cast<size_t>(std::min<uint64_t>(sizeof(sample), lengths[i] - done));
+            const size_t got = source.ReadAt(offsets[i] + done, sample, want);
+            if (got == 0) return false;
+            hasher.Update(sample, got);
+            done += got;
+        }
+    }
+    *hash = hasher.Digest();
+    return true;
+}
+
+bool FullContentHash(ByteSource &source, uint64_t *hash, uint64_t *sampled)
+{
+    const uint64_t size = source.Size();
+    uint64_t offsets[3], lengths[3];
+    const size_t count = SampleRanges(size, offsets, lengths);
+
+    ContentHasher full;
+    ContentHasher samples(size);
+    PooledBuffer chunk;
+    for (uint64_t offset = 0; offset < size;)
+    {
+        const size_t want = static_cast<size_t>(std::min<uint64_t>(kHashChunkBytes, size - offset));
+        const uint8_t *data = source.View(offset, want);
+        size_t got = want;
+        if (data == nullptr)
+        {
+            if (chunk.empty()) chunk = BufferPool::Reads().Acquire(kHashChunkBytes);
+            got = source.ReadAt(offset, chunk.data(), want);
+            data = chunk.data();
+        }
+        if (got == 0) return false;
+        full.Update(data, got);
+
+        // The sample ranges are ordered, so their pieces arrive in hash order
+        for (size_t i = 0; sampled != nullptr && i < count; i++)
+        {
+            const uint64_t begin = std::max(offset, offsets[i]);
+            const uint64_t end = std::min(offset + got, offsets[i] + lengths[i]);
+            if (begin < end) samples.Update(data + (begin - offset), static_cast<size_t>(end - begin));
+        }
+        offset += got;
+    }
+    *hash = full.Digest();
+    if (sampled != nullptr) *sampled = samples.Digest();
+    return true;
+}
@@ -0,0 +1,47 @@
+#ifndef CONTENT_HASH_H
+#define CONTENT_HASH_H
+
+#include "byte_source.h"
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Streaming XXH64: the same digest however the input is split.
+ */
+class ContentHasher
+{
+public:
+    explicit ContentHasher(uint64_t seed = 0);
+
+    void Update(const uint8_t *data, size_t length);
+    uint64_t Digest() const;
+
+private:
+    uint64_t seed_;
+    uint64_t lanes_[4];
+    uint8_t pending_[32];
+    size_t pendingBytes_ = 0;
+    uint64_t total_ = 0;
+};
+
+// Bytes taken from the head, middle and tail of a file by the sampled hash
+constexpr size_t kHashSampleBytes = 16 * 1024;
+
+/**
+ * @brief XXH64 of the file size and three kHashSampleBytes samples.
+ *
+ * Files of up to three samples are hashed whole. Cheap enough to run over a
+ * library, and good at telling apart files of equal size; an edit between the
+ * samples goes unnoticed, which only the full hash catches.
+ */
+bool SampledContentHash(ByteSource &source, uint64_t *hash);
+
+/**
+ * @brief XXH64 of every byte, read sequentially in large chunks.
+ *
+ * @p sampled, if not null, receives the sampled hash of the same file, taken
+ * from the stream rather than from separate reads.
+ */
+bool FullContentHash(ByteSource &source, uint64_t *hash, uint64_t *sampled = nullptr);
+
+#endif // CONTENT_HASH_H
@@ -0,0 +1,241 @@
+#include "content_sniffer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    struct MagicSignature
+    {
+        uint8_t offset;
+        uint8_t length;
+        uint8_t bytes[20];
+        ContainerKind kind;
+    };
+
+    // Builds a signature from a string literal at compile time. The literal's
+    // array size is used, so embedded NULs are part of the pattern.
+    template <size_t N>
+    constexpr MagicSignature Magic(uint8_t offset, const char (&text)[N], ContainerKind kind)
+    {
+        static_assert(N - 1 <= sizeof(MagicSignature::bytes), "signature too long");
+        MagicSignature signature{offset, static_cast<uint8_t>(N - 1), {}, kind};
+        for (size_t i = 0; i + 1 < N; i++) signature.bytes[i] = static_cast<uint8_t>(text[i]);
+        return signature;
+    }
+
+    // Ordered: the first match wins, so refinable entries come before generic ones.
+    constexpr MagicSignature kSignatures[] = {
+        Magic(0, "\x1A\x45\xDF\xA3", ContainerKind::Matroska), // EBML; DocType refines to WebM
+        Magic(4, "ftyp", ContainerKind::IsoBmff),              // major brand refines
+        Magic(4, "moov", ContainerKind::QuickTime),
+        Magic(4, "mdat", ContainerKind::QuickTime),
+        Magic(4, "wide", ContainerKind::QuickTime),
+        Magic(4, "free", ContainerKind::QuickTime),
+        Magic(4, "skip", ContainerKind::QuickTime),
+        Magic(4, "pnot", ContainerKind::QuickTime),
+        Magic(0, "RIFF", ContainerKind::Unknown), // form type refines
+        Magic(0, "\x30\x26\xB2\x75\x8E\x66\xCF\x11\xA6\xD9\x00\xAA\x00\x62\xCE\x6C", ContainerKind::Asf),
+        Magic(0, "FLV\x01", ContainerKind::Flv),
+        Magic(0, "OggS\x00", ContainerKind::Ogg),
+        Magic(0, "\x00\x00\x01\xBA", ContainerKind::MpegPs),
+        // Header size 0x4C followed by CLSID {00021401-0000-0000-C000-000000000046}
+        Magic(0, "\x4C\x00\x00\x00\x01\x14\x02\x00\x00\x00\x00\x00\xC0\x00\x00\x00\x00\x00\x00\x46", ContainerKind::ShellLink),
+        Magic(0, "\x89PNG\r\n\x1A\n", ContainerKind::Image),
+        Magic(0, "\xFF\xD8\xFF", ContainerKind::Image),
+        Magic(0, "GIF8", ContainerKind::Image),
+        Magic(0, "PK\x03\x04", ContainerKind::Archive),
+        Magic(0, "Rar!\x1A\x07", ContainerKind::Archive),
+        Magic(0, "7z\xBC\xAF\x27\x1C", ContainerKind::Archive),
+        Magic(0, "%PDF-", ContainerKind::Document),
+    };
+
+    constexpr bool SignaturesFitHead()
+    {
+        for (const MagicSignature &signature : kSignatures)
+            if (signature.offset + signature.length > kSniffHeadBytes) return false;
+        return true;
+    }
+    static_assert(SignaturesFitHead(), "every signature must be decidable from the head read");
+
+    struct FourCCKind
+    {
+        char fourcc[5];
+        ContainerKind kind;
+    };
+
+    // ISO-BMFF major brands that are not plain MP4 video
+    constexpr FourCCKind kBrandKinds[] = {
+        {"qt  ", ContainerKind::QuickTime},
+        {"heic", ContainerKind::Image},
+        {"heix", ContainerKind::Image},
+        {"heim", ContainerKind::Image},
+        {"heis", ContainerKind::Image},
+        {"hevc", ContainerKind::Image},
+        {"mif1", ContainerKind::Image},
+        {"msf1", ContainerKind::Image},
+        {"avif", ContainerKind::Image},
+        {"avis", ContainerKind::Image},
+    };
+
+    constexpr FourCCKind kRiffKinds[] = {
+        {"AVI ", ContainerKind::Avi},
+        {"AVIX", ContainerKind::Avi},
+        {"WEBP", ContainerKind::Image},
+    };
+
+    template <size_t N>
+    ContainerKind LookupFourCC(const FourCCKind (&table)[N], const uint8_t *fourcc, ContainerKind fallback)
+    {
+        for (const FourCCKind &entry : table)
+            if (std::memcmp(entry.fourcc, fourcc, 4) == 0) return entry.kind;
+        return fallback;
+    }
+
+    // Reads an EBML variable-length integer. IDs keep their length marker, sizes do not.
+    bool ReadVint(const uint8_t *data, size_t length, size_t *pos, bool keepMarker, uint64_t *value)
+    {
+        if (*pos >= length || data[*pos] == 0) return false;
+        const uint8_t first = data[*pos];
+        size_t width = 1;
+        while (!(first & (0x80 >> (width - 1)))) width++;
+        if (*pos + width > length) return false;
+
+        uint64_t result = keepMarker ? first : (first & (0xFF >> width));
+        for (size_t i = 1; i < width; i++) result = (result << 8) | data[*pos + i];
+        *pos += width;
+        *value = result;
+        return true;
+    }
+
+    // Walks the EBML header for DocType (0x4282): "webm" or "matroska"
+    ContainerKind RefineEbml(const uint8_t *head, size_t length)
+    {
+        size_t pos = 4;
+        uint64_t headerSize;
+        if (!ReadVint(head, length, &pos, false, &headerSize)) return ContainerKind::Matroska;
+        const size_t end = static_cast<size_t>(std::min<uint64_t>(length, pos + headerSize));
+
+        while (pos < end)
+        {
+            uint64_t id, size;
+            if (!ReadVint(head, end, &pos, true, &id) || !ReadVint(head, end, &pos, false, &size)) break;
+            if (id == 0x4282)
+            {
+                const size_t n = static_cast<size_t>(std::min<uint64_t>(size, end - pos));
+                if (n >= 4 && std::memcmp(head + pos, "webm", 4) == 0) return ContainerKind::WebM;
+                return ContainerKind::Matroska;
+            }
+            pos += static_cast<size_t>(std::min<uint64_t>(size, end - pos));
+        }
+        return ContainerKind::Matroska;
+    }
+
+    // Three sync bytes one packet apart, starting anywhere in the first packet
+    ContainerKind FindTransportSync(const uint8_t *head, size_t length)
+    {
+        for (size_t start = 0; start < 192; start++)
+        {
+            if (start + 2 * 192 >= length) break;
+            if (head[start] != 0x47) continue;
+            if (start + 2 * 188 < length && head[start + 188] == 0x47 && head[start + 2 * 188] == 0x47)
+                return ContainerKind::MpegTs;
+            if (head[start + 192] == 0x47 && head[start + 2 * 192] == 0x47)
+                return ContainerKind::M2ts;
+        }
+        return ContainerKind::Unknown;
+    }
+
+    // Recordings cut mid-packet still end on a packet boundary
+    ContainerKind TailTransportSync(const uint8_t *tail, size_t length)
+    {
+        if (length < 3 * 192) return ContainerKind::Unknown;
+        const size_t last = length - 188; // sync byte of the final packet for both strides
+        if (tail[last] != 0x47) return ContainerKind::Unknown;
+        if (tail[last - 188] == 0x47 && tail[last - 2 * 188] == 0x47) return ContainerKind::MpegTs;
+        if (tail[last - 192] == 0x47 && tail[last - 2 * 192] == 0x47) return ContainerKind::M2ts;
+        return ContainerKind::Unknown;
+    }
+
+    ContainerKind MatchSignatures(const uint8_t *head, size_t length)
+    {
+        for (const MagicSignature &signature : kSignatures)
+        {
+            if (signature.offset + signature.length > length) continue;
+            if (std::memcmp(head + signature.offset, signature.bytes, signature.length) != 0) continue;
+
+            if (signature.kind == ContainerKind::Matroska) return RefineEbml(head, length);
+            if (signature.kind == ContainerKind::IsoBmff)
+                return length >= 12 ? LookupFourCC(kBrandKinds, head + 8, ContainerKind::IsoBmff) : ContainerKind::IsoBmff;
+            if (std::memcmp(signature.bytes, "RIFF", 4) == 0)
+                return length >= 12 ? LookupFourCC(kRiffKinds, head + 8, ContainerKind::Unknown) : ContainerKind::Unknown;
+            return signature.kind;
+        }
+        return ContainerKind::Unknown;
+    }
+}
+
+ContainerKind SniffBuffer(const uint8_t *head, size_t headLength, const uint8_t *tail, size_t tailLength)
+{
+    if (head == nullptr || headLength == 0) return ContainerKind::Unknown;
+
+    ContainerKind kind = MatchSignatures(head, headLength);
+    if (kind != ContainerKind::Unknown) return kind;
+
+    kind = FindTransportSync(head, headLength);
+    if (kind != ContainerKind::Unknown) return kind;
+
+    if (tail != nullptr) return TailTransportSync(tail, tailLength);
+    return ContainerKind::Unknown;
+}
+
+ContainerKind SniffSource(ByteSource &source)
+{
+    uint8_t head[kSniffTransportBytes];
+    size_t headLength = source.ReadAt(0, head, kSniffHeadBytes);
+
+    ContainerKind kind = MatchSignatures(head, headLength);
+    if (kind != ContainerKind::Unknown || headLength < kSniffHeadBytes) return kind;
+
+    // Nothing in the table matched: look for transport stream packets, which
+    // need a longer head, and only then at the tail.
+    headLength += source.ReadAt(headLength, head + headLength, kSniffTransportBytes - headLength);
+    kind = FindTransportSync(head, headLength);
+    if (kind != ContainerKind::Unknown || headLength < kSniffTransportBytes) return kind;
+
+    const uint64_t size = source.Size();
+    if (size < 2 * kSniffTransportBytes) return ContainerKind::Unknown;
+
+    uint8_t tail[kSniffTransportBytes];
+    return TailTransportSync(tail, source.ReadAt(size - sizeof(tail), tail, sizeof(tail)));
+}
+
+ContainerKind SniffFile(const PathChar *path)
+{
+    // One read covers both the signature head and the transport stream head
+    std::unique_ptr<ByteSource> source = OpenFileSource(path, AccessPattern::Random, 1024);
+    if (!source) return ContainerKind::Unknown;
+    return SniffSource(*source);
+}
+
+SniffRoute RouteFor(ContainerKind kind)
+{
+    switch (kind)
+    {
+    case ContainerKind::IsoBmff:
+    case ContainerKind::QuickTime:
+    case ContainerKind::Matroska:
+    case ContainerKind::WebM:
+    case ContainerKind::Avi:
+    case ContainerKind::MpegTs:
+    case ContainerKind::M2ts:
+    case ContainerKind::MpegPs:
+    case ContainerKind::Asf:
+    case ContainerKind::Flv:
+    case ContainerKind::Ogg:
+        return SniffRoute::MediaProbe;
+    case ContainerKind::ShellLink:
+        return SniffRoute::Shortcut;
+    default:
+        return SniffRoute::Reject;
+    }
+}
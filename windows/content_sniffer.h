@@ -0,0 +1,66 @@
+#ifndef CONTENT_SNIFFER_H
+#define CONTENT_SNIFFER_H
+
+#include "byte_source.h"
+#include "native_path.h"
+#include <cstddef>
+#include <cstdint>
+
+// What a file's leading bytes say it is. Values are shared with the C API (sniff_file).
+enum class ContainerKind : uint8_t
+{
+    Unknown = 0,
+    IsoBmff = 1,   // MP4, M4V, 3GP, CMAF
+    QuickTime = 2, // MOV ('qt  ' brand or a bare moov/mdat atom)
+    Matroska = 3,
+    WebM = 4,
+    Avi = 5,
+    MpegTs = 6,
+    M2ts = 7, // 192-byte packets with a 4-byte timestamp prefix
+    MpegPs = 8,
+    Asf = 9, // WMV, WMA
+    Flv = 10,
+    Ogg = 11,
+    ShellLink = 12,
+    Image = 13,   // PNG, JPEG, GIF, WebP, HEIF/AVIF
+    Archive = 14, // ZIP, RAR, 7z
+    Document = 15, // PDF
+};
+
+// Where a sniffed file should go next.
+enum class SniffRoute : uint8_t
+{
+    Reject,
+    MediaProbe,
+    Shortcut,
+};
+
+// Bytes of the file head every sniff reads.
+constexpr size_t kSniffHeadBytes = 64;
+// MPEG-TS needs three packets to be told apart from noise.
+constexpr size_t kSniffTransportBytes = 3 * 192 + 4;
+
+/**
+ * @brief Classifies a buffer holding the start of a file.
+ *
+ * @param head First bytes of the file, ideally kSniffHeadBytes or more
+ * @param tail Last bytes of the file, or nullptr. Only consulted for transport
+ *             streams whose head is not packet-aligned.
+ */
+ContainerKind SniffBuffer(const uint8_t *head, size_t headLength, const uint8_t *tail, size_t tailLength);
+
+/**
+ * @brief Reads the head (and the tail when needed) of a file and classifies it.
+ *
+ * @return ContainerKind::Unknown for unreadable, empty or unrecognized files
+ */
+ContainerKind SniffFile(const PathChar *path);
+
+// Same as SniffFile for an already open source
+ContainerKind SniffSource(ByteSource &source);
+
+SniffRoute RouteFor(ContainerKind kind);
+
+inline bool IsMediaContainer(ContainerKind kind) { return RouteFor(kind) == SniffRoute::MediaProbe; }
+
+#endif // CONTENT_SNIFFER_H
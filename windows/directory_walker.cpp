@@ -0,0 +1,711 @@
+#include "directory_walker.h"
+#include "path_arena.h"
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // (device, inode) of a directory and of everything above it, shared by siblings
+    struct Ancestry
+    {
+        uint64_t device;
+        uint64_t inode;
+        std::shared_ptr<const Ancestry> parent;
+    };
+
+    enum NodeState : uint8_t
+    {
+        Pending,
+        Claimed,
+        Listed,
+    };
+
+    struct Node
+    {
+        WalkEntry self;
+        uint32_t depth = 0;
+        std::shared_ptr<const Ancestry> ancestry; // the parent's chain
+        std::atomic<uint8_t> state{Pending};
+
+        // Filled by List
+        std::vector<WalkEntry> files;
+        std::vector<std::shared_ptr<Node>> children; // kept for the ordered traversal only
+        size_t buffered = 0;                         // entries this listing holds against the budget
+    };
+
+    NativePath Join(const NativePath &directory, const PathChar *name)
+    {
+        NativePath path = directory;
+        if (!path.empty() && path.back() != kPathSeparator) path.push_back(kPathSeparator);
+        return path + name;
+    }
+
+    template <typename T>
+    bool ByPath(const T &a, const T &b)
+    {
+        return a.path < b.path;
+    }
+
+#ifdef _WIN32
+    int64_t FileTimeNs(int64_t ticks)
+    {
+        return (ticks - 116444736000000000LL) * 100; // 100 ns ticks since 1601
+    }
+
+    FileIdentity ToIdentity(uint64_t volume, const FILE_ID_128 &id)
+    {
+        FileIdentity identity;
+        identity.volume = volume;
+        std::memcpy(&identity.id_low, id.Identifier, sizeof(uint64_t));
+        std::memcpy(&identity.id_high, id.Identifier + sizeof(uint64_t), sizeof(uint64_t));
+        return identity;
+    }
+#else
+    int64_t MtimeNs(const struct stat &st)
+    {
+        return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    }
+#endif
+
+    class Walker
+    {
+    public:
+        Walker(const WalkOptions &options, const std::function<bool(std::vector<WalkEntry> &&)> &sink)
+            : options_(options), sink_(sink), deques_(std::max<uint32_t>(options.threads, 1) + 1)
+        {
+        }
+
+        bool Run(const NativePath &root, WalkStats *stats)
+        {
+            auto rootNode = std::make_shared<Node>();
+            rootNode->self.path = root;
+            rootNode->self.is_directory = true;
+
+            // The root is listed here, so a missing root fails before any thread starts
+            rootNode->state = Claimed;
+            if (!List(*rootNode))
+            {
+                *stats = Stats();
+                return false;
+            }
+            const size_t helpers = deques_.size() - 1;
+            Publish(rootNode, helpers);
+
+            std::vector<std::thread> threads;
+            threads.reserve(helpers);
+            for (size_t t = 0; t < helpers; t++) threads.emplace_back(&Walker::Work, this, t);
+
+            if (options_.ordered) DeliverOrdered(rootNode);
+            else DeliverAsListed();
+            rootNode.reset();
+
+            Stop();
+            for (std::thread &thread : threads) thread.join();
+            *stats = Stats();
+            return true;
+        }
+
+    private:
+        struct WorkDeque
+        {
+            std::mutex mutex;
+            std::deque<std::shared_ptr<Node>> nodes;
+        };
+
+        WalkStats Stats() const
+        {
+            WalkStats stats;
+            stats.directories = directories_;
+            stats.files = files_;
+            stats.loops = loops_;
+            stats.errors = errors_;
+            stats.steals = steals_;
+            return stats;
+        }
+
+        void Stop()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                stopping_ = true;
+            }
+            wake_.notify_all();
+            space_.notify_all();
+            listed_.notify_all();
+        }
+
+        // === Listing ===
+
+        // False if the directory could not be opened; the node then holds no entries
+        bool List(Node &node)
+        {
+            if (node.depth > options_.max_depth) return true;
+#ifdef _WIN32
+            HANDLE directory = CreateFileW(node.self.path.c_str(), FILE_LIST_DIRECTORY | FILE_READ_ATTRIBUTES,
+                                           FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                           FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+            if (directory == INVALID_HANDLE_VALUE)
+            {
+                errors_++;
+                return false;
+            }
+            uint64_t device = 0, inode = 0;
+            if (Identify(directory, &device, &inode) && options_.follow_symlinks && IsLoop(node, device, inode))
+            {
+                CloseHandle(directory);
+                return true;
+            }
+            auto ancestry = options_.follow_symlinks ? std::make_shared<const Ancestry>(Ancestry{device, inode, node.ancestry}) : nullptr;
+            const bool listed = ListWithIds(directory, device, node, ancestry);
+            CloseHandle(directory);
+            if (!listed && !ListWithFind(node, ancestry))
+            {
+                errors_++;
+                return false;
+            }
+            directories_++;
+#else
+            // A symlinked root is walked either way; below it, a link swapped in after the listing is not
+            const int flags = O_RDONLY | O_DIRECTORY | O_CLOEXEC | (options_.follow_symlinks || node.depth == 0 ? 0 : O_NOFOLLOW);
+            const int fd = open(node.self.path.c_str(), flags);
+            struct stat st;
+            if (fd < 0 || fstat(fd, &st) != 0)
+            {
+                if (fd >= 0) close(fd);
+                errors_++;
+                return false;
+            }
+            if (options_.stat_files) node.self.mtime_ns = MtimeNs(st);
+            if (IsLoop(node, st.st_dev, st.st_ino))
+            {
+                close(fd);
+                return true;
+            }
+            DIR *dir = fdopendir(fd);
+            if (dir == nullptr)
+            {
+                close(fd);
+                errors_++;
+                return false;
+            }
+            directories_++;
+            auto ancestry = std::make_shared<const Ancestry>(Ancestry{static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino), node.ancestry});
+            while (const dirent *item = readdir(dir))
+            {
+                if (std::strcmp(item->d_name, ".") == 0 || std::strcmp(item->d_name, "..") == 0) continue;
+                WalkEntry entry;
+                entry.path = Join(node.self.path, item->d_name);
+                bool directory = item->d_type == DT_DIR;
+                const bool known = item->d_type == DT_DIR || item->d_type == DT_REG;
+                if (!known || options_.stat_files)
+                {
+                    // Symlinks resolve to what they point at; a directory behind one is walked only when following
+                    struct stat target;
+                    bool link = item->d_type == DT_LNK;
+                    if (item->d_type == DT_UNKNOWN)
+                    {
+                        if (fstatat(dirfd(dir), item->d_name, &target, AT_SYMLINK_NOFOLLOW) != 0) continue;
+                        link = S_ISLNK(target.st_mode);
+                    }
+                    if (fstatat(dirfd(dir), item->d_name, &target, 0) != 0) continue;
+                    if (S_ISDIR(target.st_mode) && link && !options_.follow_symlinks) continue;
+                    directory = S_ISDIR(target.st_mode);
+                    if (!directory && !S_ISREG(target.st_mode)) continue;
+                    entry.size = directory ? 0 : static_cast<uint64_t>(target.st_size);
+                    entry.mtime_ns = options_.stat_files ? MtimeNs(target) : 0;
+                    entry.identity = FileIdentity{static_cast<uint64_t>(target.st_dev), static_cast<uint64_t>(target.st_ino), 0};
+                }
+                else
+                {
+                    // A regular file lives on the directory's device, and readdir already carries its inode
+                    entry.identity = FileIdentity{static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(item->d_ino), 0};
+                }
+                entry.is_directory = directory;
+                if (directory) AddChild(node, std::move(entry), ancestry);
+                else node.files.push_back(std::move(entry));
+            }
+            closedir(dir);
+#endif
+            files_ += node.files.size();
+            if (options_.ordered)
+            {
+                std::sort(node.files.begin(), node.files.end(), ByPath<WalkEntry>);
+                std::sort(node.children.begin(), node.children.end(),
+                          [](const std::shared_ptr<Node> &a, const std::shared_ptr<Node> &b) { return a->self.path < b->self.path; });
+            }
+            return true;
+        }
+
+        void AddChild(Node &node, WalkEntry &&entry, const std::shared_ptr<const Ancestry> &ancestry)
+        {
+            auto child = std::make_shared<Node>();
+            child->self = std::move(entry);
+            child->depth = node.depth + 1;
+            child->ancestry = ancestry;
+            node.children.push_back(std::move(child));
+        }
+
+        bool IsLoop(const Node &node, uint64_t device, uint64_t inode)
+        {
+            for (const Ancestry *a = node.ancestry.get(); a != nullptr; a = a->parent.get())
+            {
+                if (a->device == device && a->inode == inode)
+                {
+                    loops_++;
+                    return true;
+                }
+            }
+            return false;
+        }
+
+#ifdef _WIN32
+        static bool Identify(HANDLE directory, uint64_t *device, uint64_t *inode)
+        {
+            FILE_ID_INFO id;
+            BY_HANDLE_FILE_INFORMATION info;
+            if (GetFileInformationByHandleEx(directory, FileIdInfo, &id, sizeof(id)))
+            {
+                const FileIdentity identity = ToIdentity(id.VolumeSerialNumber, id.FileId);
+                *device = identity.volume;
+                *inode = identity.id_low ^ identity.id_high;
+                return true;
+            }
+            if (!GetFileInformationByHandle(directory, &info)) return false;
+            *device = info.dwVolumeSerialNumber;
+            *inode = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+            return true;
+        }
+
+        void AddListed(Node &node, const std::shared_ptr<const Ancestry> &ancestry, std::wstring_view name, DWORD attributes,
+                       uint64_t size, int64_t lastWriteTicks, const FileIdentity &identity)
+        {
+            if (name == L"." || name == L"..") return;
+            WalkEntry entry;
+            entry.path = Join(node.self.path, std::wstring(name).c_str());
+            entry.mtime_ns = FileTimeNs(lastWriteTicks);
+            if (attributes & FILE_ATTRIBUTE_DIRECTORY)
+            {
+                // Junctions and directory symlinks are reparse points
+                if ((attributes & FILE_ATTRIBUTE_REPARSE_POINT) && !options_.follow_symlinks) return;
+                entry.is_directory = true;
+                AddChild(node, std::move(entry), ancestry);
+                return;
+            }
+            entry.size = size;
+            entry.identity = identity;
+            node.files.push_back(std::move(entry));
+        }
+
+        // Lists through the directory handle, which returns each entry's 128-bit file ID with its
+        // name and times. False, with nothing added, where the file system cannot (FAT, some shares).
+        bool ListWithIds(HANDLE directory, uint64_t volume, Node &node, const std::shared_ptr<const Ancestry> &ancestry)
+        {
+            std::vector<uint64_t> buffer(8192); // 64 KiB, 8-byte aligned for the records
+            FILE_INFO_BY_HANDLE_CLASS query = FileIdExtdDirectoryRestartInfo;
+            while (GetFileInformationByHandleEx(directory, query, buffer.data(), static_cast<DWORD>(buffer.size() * sizeof(uint64_t))))
+            {
+                query = FileIdExtdDirectoryInfo;
+                const uint8_t *at = reinterpret_cast<const uint8_t *>(buffer.data());
+                for (;;)
+                {
+                    const auto *item = reinterpret_cast<const FILE_ID_EXTD_DIR_INFO *>(at);
+                    AddListed(node, ancestry, std::wstring_view(item->FileName, item->FileNameLength / sizeof(wchar_t)), item->FileAttributes,
+                              static_cast<uint64_t>(item->EndOfFile.QuadPart), item->LastWriteTime.QuadPart, ToIdentity(volume, item->FileId));
+                    if (item->NextEntryOffset == 0) break;
+                    at += item->NextEntryOffset;
+                }
+            }
+            // An empty volume root has no . and .. and ends before the first record
+            return query == FileIdExtdDirectoryInfo || GetLastError() == ERROR_NO_MORE_FILES;
+        }
+
+        bool ListWithFind(Node &node, const std::shared_ptr<const Ancestry> &ancestry)
+        {
+            WIN32_FIND_DATAW data;
+            HANDLE find = FindFirstFileExW(Join(node.self.path, L"*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr,
+                                           FIND_FIRST_EX_LARGE_FETCH);
+            if (find == INVALID_HANDLE_VALUE) return false;
+            do
+            {
+                const int64_t lastWrite = (static_cast<int64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+                AddListed(node, ancestry, data.cFileName, data.dwFileAttributes,
+                          (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow, lastWrite, FileIdentity());
+            } while (FindNextFileW(find, &data));
+            FindClose(find);
+            return true;
+        }
+#endif
+
+        // Queues the children of a listed node for listing and hands the listing to the delivering thread
+        void Publish(const std::shared_ptr<Node> &node, size_t deque)
+        {
+            node->buffered = node->files.size() + node->children.size() + 1;
+            {
+                // Counted before anyone can take them, so pending_ never reads zero while work remains
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending_ += node->children.size();
+                queued_ += node->children.size();
+                buffered_ += node->buffered;
+                {
+                    std::lock_guard<std::mutex> dequeLock(deques_[deque].mutex);
+                    for (const auto &child : node->children) deques_[deque].nodes.push_back(child);
+                }
+                if (!options_.ordered)
+                {
+                    node->children.clear(); // the deques own them now
+                    ready_.push_back(node);
+                }
+                node->state = Listed;
+            }
+            wake_.notify_all();
+            listed_.notify_all();
+            ready_cv_.notify_all();
+        }
+
+        // === Work stealing ===
+
+        std::shared_ptr<Node> Take(size_t self)
+        {
+            {
+                std::lock_guard<std::mutex> lock(deques_[self].mutex);
+                if (!deques_[self].nodes.empty())
+                {
+                    auto node = std::move(deques_[self].nodes.back()); // newest: depth-first, warm caches
+                    deques_[self].nodes.pop_back();
+                    return node;
+                }
+            }
+            for (size_t k = 1; k < deques_.size(); k++)
+            {
+                WorkDeque &victim = deques_[(self + k) % deques_.size()];
+                std::lock_guard<std::mutex> lock(victim.mutex);
+                if (victim.nodes.empty()) continue;
+                auto node = std::move(victim.nodes.front()); // oldest: nearest the root, the most work
+                victim.nodes.pop_front();
+                steals_++;
+                return node;
+            }
+            return nullptr;
+        }
+
+        void Work(size_t self)
+        {
+            for (;;)
+            {
+                std::shared_ptr<Node> node = Take(self);
+                if (!node)
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    wake_.wait(lock, [this] { return stopping_ || queued_ > 0 || pending_ == 0; });
+                    if (stopping_ || pending_ == 0) return;
+                    continue;
+                }
+                {
+                    // Listings wait while the budget is spent; the delivering thread never does. The wait comes
+                    // before the claim, so a directory the ordered delivery waits for is never held back by it.
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    queued_--;
+                    space_.wait(lock, [this] { return stopping_ || buffered_ < options_.max_buffered_entries; });
+                    if (stopping_) return;
+                }
+
+                // The ordered delivery may have listed it already
+                uint8_t expected = Pending;
+                if (!node->state.compare_exchange_strong(expected, Claimed)) continue;
+                List(*node);
+                Publish(node, self);
+                Finish();
+            }
+        }
+
+        void Finish()
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                pending_--;
+            }
+            wake_.notify_all();
+            ready_cv_.notify_all();
+        }
+
+        // === Delivery ===
+
+        bool Deliver(Node &node, bool isRoot)
+        {
+            std::vector<WalkEntry> entries;
+            entries.reserve(node.files.size() + 1);
+            if (!isRoot) entries.push_back(std::move(node.self));
+            for (WalkEntry &file : node.files) entries.push_back(std::move(file));
+            node.files = std::vector<WalkEntry>();
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                buffered_ -= node.buffered;
+            }
+            space_.notify_all();
+            if (entries.empty()) return true;
+            return sink_(std::move(entries));
+        }
+
+        void DeliverAsListed()
+        {
+            for (;;)
+            {
+                std::shared_ptr<Node> node;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    ready_cv_.wait(lock, [this] { return !ready_.empty() || pending_ == 0; });
+                    if (ready_.empty()) return;
+                    node = std::move(ready_.front());
+                    ready_.pop_front();
+                }
+                if (!Deliver(*node, node->depth == 0)) return;
+            }
+        }
+
+        void DeliverOrdered(const std::shared_ptr<Node> &root)
+        {
+            std::vector<std::shared_ptr<Node>> stack{root};
+            const size_t own = deques_.size() - 1;
+            while (!stack.empty())
+            {
+                std::shared_ptr<Node> node = std::move(stack.back());
+                stack.pop_back();
+
+                uint8_t expected = Pending;
+                if (node->state.compare_exchange_strong(expected, Claimed))
+                {
+                    // Next in order and no helper got to it: list it here rather than wait
+                    // It stays in some deque; whoever pops it finds it claimed
+                    List(*node);
+                    Publish(node, own);
+                    Finish();
+                }
+                else
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    listed_.wait(lock, [&] { return node->state == Listed; });
+                }
+
+                for (auto it = node->children.rbegin(); it != node->children.rend(); ++it) stack.push_back(*it);
+                node->children.clear();
+                if (!Deliver(*node, node.get() == root.get())) return;
+            }
+        }
+
+        const WalkOptions options_;
+        const std::function<bool(std::vector<WalkEntry> &&)> &sink_;
+        std::vector<WorkDeque> deques_; // one per helper thread, plus one for the delivering thread
+
+        std::mutex mutex_;
+        std::condition_variable wake_;     // work was queued, or the walk ended
+        std::condition_variable space_;    // the delivered listings freed budget
+        std::condition_variable listed_;   // a listing completed (ordered delivery waits for one)
+        std::condition_variable ready_cv_; // a listing is ready, or the walk ended
+        std::deque<std::shared_ptr<Node>> ready_;
+        size_t pending_ = 0; // directories found but not yet listed
+        size_t queued_ = 0;  // of those, the ones sitting in a deque
+        size_t buffered_ = 0;
+        bool stopping_ = false;
+
+        std::atomic<uint64_t> directories_{0};
+        std::atomic<uint64_t> files_{0};
+        std::atomic<uint64_t> loops_{0};
+        std::atomic<uint64_t> errors_{0};
+        std::atomic<uint64_t> steals_{0};
+    };
+}
+
+bool WalkDirectory(const NativePath &root, const WalkOptions &options, const std::function<bool(std::vector<WalkEntry> &&)> &sink,
+                   WalkStats *stats)
+{
+    WalkStats ignored;
+    Walker walker(options, sink);
+    return walker.Run(root, stats != nullptr ? stats : &ignored);
+}
+
+// === Sessions ===
+
+namespace
+{
+    // Records a walk may queue ahead of its poller before it waits
+    constexpr size_t kMaxQueuedRecords = 16384;
+
+    struct WalkSession
+    {
+        std::mutex mutex;
+        std::condition_variable ready; // records queued, or the walk finished
+        std::condition_variable space; // records polled, or the session is closing
+        std::deque<WalkRecord> queue;
+        WalkProgress progress = {};
+        bool closing = false;
+        std::thread worker;
+    };
+
+    void StopWalk(WalkSession &session)
+    {
+        {
+            std::lock_guard<std::mutex> lock(session.mutex);
+            session.closing = true;
+        }
+        session.space.notify_all();
+        session.worker.join();
+    }
+
+    // Stops the walks still open when the process exits or the library unloads, since
+    // destroying a joinable worker would terminate the process
+    struct WalkRegistry
+    {
+        std::mutex mutex;
+        std::map<int32_t, std::shared_ptr<WalkSession>> walks;
+        int32_t nextHandle = 1;
+
+        WalkRegistry()
+        {
+            // Constructed first, so destroyed after the workers that intern into them are joined
+            PathArena::Instance();
+            FileIdentityIndex::Instance();
+        }
+
+        ~WalkRegistry()
+        {
+            for (auto &entry : walks) StopWalk(*entry.second);
+        }
+    };
+
+    WalkRegistry &Walks()
+    {
+        static WalkRegistry registry;
+        return registry;
+    }
+
+    std::shared_ptr<WalkSession> FindWalk(int32_t handle)
+    {
+        WalkRegistry &registry = Walks();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.walks.find(handle);
+        return it == registry.walks.end() ? nullptr : it->second;
+    }
+
+    void RunWalk(WalkSession *session, const NativePath &root, const WalkOptions &options)
+    {
+        std::vector<WalkRecord> records;
+        auto sink = [&](std::vector<WalkEntry> &&entries) {
+            records.clear();
+            uint64_t directories = 0;
+            for (const WalkEntry &entry : entries)
+            {
+                const uint32_t pathId = PathArena::Instance().Intern(entry.path);
+                if (pathId == kInvalidPathId) continue;
+                if (!entry.is_directory) FileIdentityIndex::Instance().Record(pathId, entry.identity);
+                WalkRecord record = {};
+                record.path_id = pathId;
+                record.is_directory = entry.is_directory;
+                record.size_bytes = entry.size;
+                record.modified_time_ms = entry.mtime_ns / 1000000;
+                records.push_back(record);
+                directories += entry.is_directory;
+            }
+            {
+                std::unique_lock<std::mutex> lock(session->mutex);
+                session->space.wait(lock, [&] { return session->closing || session->queue.size() < kMaxQueuedRecords; });
+                if (session->closing) return false;
+                session->queue.insert(session->queue.end(), records.begin(), records.end());
+                session->progress.directories += directories;
+                session->progress.files += entries.size() - directories;
+            }
+            session->ready.notify_all();
+            return true;
+        };
+
+        WalkStats stats;
+        WalkDirectory(root, options, sink, &stats);
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            session->progress.directories = stats.directories;
+            session->progress.files = stats.files;
+            session->progress.loops = stats.loops;
+            session->progress.errors = stats.errors;
+            session->progress.steals = stats.steals;
+            session->progress.finished = 1;
+        }
+        session->ready.notify_all();
+    }
+}
+
+int32_t WalkSessions::Start(const NativePath &root, const WalkOptions &options)
+{
+    std::error_code error;
+    if (!std::filesystem::is_directory(root, error)) return -1;
+
+    auto session = std::make_shared<WalkSession>();
+    session->worker = std::thread(RunWalk, session.get(), root, options);
+
+    WalkRegistry &registry = Walks();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    const int32_t handle = registry.nextHandle++;
+    registry.walks[handle] = std::move(session);
+    return handle;
+}
+
+uint32_t WalkSessions::Poll(int32_t handle, WalkRecord *out, uint32_t capacity, uint32_t timeoutMs)
+{
+    std::shared_ptr<WalkSession> session = FindWalk(handle);
+    if (!session || out == nullptr || capacity == 0) return 0;
+
+    uint32_t count = 0;
+    {
+        std::unique_lock<std::mutex> lock(session->mutex);
+        session->ready.wait_for(lock, std::chrono::milliseconds(timeoutMs),
+                                [&] { return !session->queue.empty() || session->progress.finished; });
+        while (count < capacity && !session->queue.empty())
+        {
+            out[count++] = session->queue.front();
+            session->queue.pop_front();
+        }
+    }
+    session->space.notify_all();
+    return count;
+}
+
+bool WalkSessions::Progress(int32_t handle, WalkProgress *progress)
+{
+    std::shared_ptr<WalkSession> session = FindWalk(handle);
+    if (!session || progress == nullptr) return false;
+    std::lock_guard<std::mutex> lock(session->mutex);
+    *progress = session->progress;
+    return true;
+}
+
+bool WalkSessions::Close(int32_t handle)
+{
+    std::shared_ptr<WalkSession> session;
+    {
+        WalkRegistry &registry = Walks();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.walks.find(handle);
+        if (it == registry.walks.end()) return false;
+        session = std::move(it->second);
+        registry.walks.erase(it);
+    }
+    StopWalk(*session);
+    return true;
+}
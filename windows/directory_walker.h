@@ -0,0 +1,80 @@
+#ifndef DIRECTORY_WALKER_H
+#define DIRECTORY_WALKER_H
+
+#include "file_identity.h"
+#include "native_path.h"
+#include "video_data_exporter_api.h"
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct WalkEntry
+{
+    NativePath path;
+    uint64_t size = 0;     // with stat_files only
+    int64_t mtime_ns = 0;  // since the Unix epoch; with stat_files only
+    FileIdentity identity; // files only, from the listing; unknown where the file system does not report it
+    bool is_directory = false;
+};
+
+struct WalkOptions
+{
+    uint32_t threads = 8;          // listings in flight; latency-bound shares want more than cores
+    bool follow_symlinks = false;  // symlinked directories and junctions; loops are cut either way
+    bool stat_files = false;       // fill size and mtime; d_type alone tells files from directories
+    bool ordered = false;          // pre-order by sorted name, identical on every run
+    uint32_t max_depth = 1024;
+    // Entries listed but not yet delivered; listing threads wait beyond it
+    size_t max_buffered_entries = 16384;
+};
+
+struct WalkStats
+{
+    uint64_t directories = 0; // listed
+    uint64_t files = 0;
+    uint64_t loops = 0;  // directories skipped because they are their own ancestor
+    uint64_t errors = 0; // directories that could not be opened or read
+    uint64_t steals = 0; // directories a thread took from another thread's deque
+};
+
+/**
+ * @brief Lists the tree under @p root with several threads and streams it to @p sink.
+ *
+ * Every thread keeps a deque of directories still to list: it pushes the
+ * subdirectories it finds and pops the newest, walking depth-first; an idle
+ * thread steals the oldest entry of another deque, which is the one nearest
+ * the root and so the largest piece of remaining work. A directory whose
+ * (device, inode) matches one of its ancestors is a symlink or junction loop
+ * and is skipped.
+ *
+ * @p sink runs on the calling thread and receives one directory at a time:
+ * its own entry (except for the root's) followed by its files. Unordered,
+ * directories arrive as their listings complete. Ordered, they arrive in
+ * pre-order with names sorted at every level, and the calling thread lists
+ * the next one itself when no helper has claimed it yet. Helpers hold back
+ * while max_buffered_entries listed entries wait for the sink. Returning
+ * false from @p sink stops the walk.
+ *
+ * @return false if @p root could not be listed
+ */
+bool WalkDirectory(const NativePath &root, const WalkOptions &options, const std::function<bool(std::vector<WalkEntry> &&)> &sink,
+                   WalkStats *stats);
+
+/**
+ * @brief Owns the walks behind the walk_* exports.
+ *
+ * Each walk runs on its own thread; its entries are interned into the path
+ * arena, their identities recorded in FileIdentityIndex, and queued as
+ * WalkRecords until polled. A full queue holds the walk
+ * back, so an unpolled walk costs bounded memory.
+ */
+namespace WalkSessions
+{
+    int32_t Start(const NativePath &root, const WalkOptions &options);
+    uint32_t Poll(int32_t handle, WalkRecord *out, uint32_t capacity, uint32_t timeoutMs);
+    bool Progress(int32_t handle, WalkProgress *progress);
+    // Stops the walk if it is still running and releases the handle.
+    bool Close(int32_t handle);
+}
+
+#endif // DIRECTORY_WALKER_H
@@ -0,0 +1,467 @@
+#ifndef ELEMENT_DISPATCH_H
+#define ELEMENT_DISPATCH_H
+
+// Compile-time dispatch tables for the ISO-BMFF box and EBML element walkers.
+//
+// Each probe kind declares, per container format, the boxes or elements it
+// cares about: whether to descend into them, skip them, stop at them or read
+// them, and how the payload is typed. Lookups go through a perfect hash built
+// by the compiler from the table (one multiply, one byte load, one compare),
+// so there is no runtime map, and anything missing from a kind's table is
+// skipped on its size alone without its payload ever being read.
+
+#include "byte_source.h"
+#include "container_parse.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+enum class ElementFormat : uint8_t
+{
+    IsoBmff,
+    Ebml,
+};
+
+enum class ElementPolicy : uint8_t
+{
+    Skip,    // step over the payload
+    Descend, // walk the children; the visitor sees OnEnter/OnLeave
+    Read,    // hand the typed payload to the visitor
+    Stop,    // end the walk at this level (Matroska Clusters)
+};
+
+enum class FieldType : uint8_t
+{
+    Master,   // children only
+    FullBox,  // children after a version/flags word (ISO-BMFF meta)
+    UInt,     // big-endian unsigned, up to 8 bytes
+    Float,    // EBML float, 4 or 8 bytes
+    String,   // bytes, up to kMaxValueBytes
+    Bytes,    // bytes, up to kMaxValueBytes
+    Position, // file offset and size, plus the first kPositionPrefixBytes bytes
+};
+
+// What a Read or Descend element means to the probe; visitors switch on it.
+enum class ElementField : uint8_t
+{
+    None,
+    // ISO-BMFF
+    Movie,
+    MovieHeader,
+    Track,
+    TrackHeader,
+    Handler,
+    SampleDescription,
+    CoverData,
+    MovieExtendsHeader,
+    TrackExtends,
+    MediaHeader,
+    SegmentIndex,
+    MovieFragment,
+    TrackFragment,
+    TrackFragmentHeader,
+    TrackFragmentDecodeTime,
+    TrackRun,
+    RandomAccess,
+    // Matroska
+    SeekEntry,
+    SeekId,
+    SeekPosition,
+    SegmentInfo,
+    TimestampScale,
+    Duration,
+    Tracks,
+    TrackEntry,
+    TrackType,
+    CodecId,
+    PixelWidth,
+    PixelHeight,
+    SamplingFrequency,
+    Channels,
+    Attachments,
+    AttachedFile,
+    FileName,
+    FileMediaType,
+    FileData,
+};
+
+struct ElementRule
+{
+    uint64_t id; // FourCC for boxes, ID with length marker for EBML
+    ElementPolicy policy;
+    FieldType type;
+    ElementField field;
+};
+
+constexpr uint64_t FourCC(const char (&type)[5])
+{
+    return (uint64_t(uint8_t(type[0])) << 24) | (uint64_t(uint8_t(type[1])) << 16) | (uint64_t(uint8_t(type[2])) << 8) |
+           uint64_t(uint8_t(type[3]));
+}
+
+// === Perfect hash ===
+
+struct PerfectHash
+{
+    uint64_t multiplier;
+    uint32_t bits; // 0 if no multiplier separates the IDs
+};
+
+constexpr uint32_t HashSlot(uint64_t id, PerfectHash hash) { return static_cast<uint32_t>((id * hash.multiplier) >> (64 - hash.bits)); }
+
+// Smallest table (at least twice the rule count) for which some odd multiplier
+// sends every ID to its own slot. Runs in the compiler only.
+constexpr PerfectHash BuildPerfectHash(const ElementRule *rules, size_t count)
+{
+    constexpr uint32_t kMaxBits = 10;
+    uint32_t bits = 2;
+    while ((size_t(1) << bits) < count * 2) bits++;
+    for (; bits <= kMaxBits; bits++)
+    {
+        uint64_t multiplier = 0x9E3779B97F4A7C15ull;
+        for (uint32_t attempt = 0; attempt < 2048; attempt++)
+        {
+            multiplier = (multiplier * 6364136223846793005ull + 1442695040888963407ull) | 1;
+            const PerfectHash hash{multiplier, bits};
+            bool used[size_t(1) << kMaxBits] = {};
+            bool collides = false;
+            for (size_t i = 0; i < count && !collides; i++)
+            {
+                const uint32_t slot = HashSlot(rules[i].id, hash);
+                collides = used[slot];
+                used[slot] = true;
+            }
+            if (!collides) return hash;
+        }
+    }
+    return {0, 0};
+}
+
+/**
+ * @brief Compile-time lookup over a rule table.
+ *
+ * @tparam Rules A type with `static constexpr ElementFormat kFormat` and
+ *               `static constexpr ElementRule kRules[]`; IDs must be distinct.
+ */
+template <typename Rules>
+struct Dispatch
+{
+    static constexpr size_t kCount = sizeof(Rules::kRules) / sizeof(ElementRule);
+    static_assert(kCount < 255, "rule tables index slots with a byte");
+
+    static constexpr PerfectHash kHash = BuildPerfectHash(Rules::kRules, kCount);
+    static_assert(kHash.bits != 0, "element IDs are duplicated or could not be hashed apart");
+
+    static constexpr std::array<uint8_t, (size_t(1) << kHash.bits)> BuildSlots()
+    {
+        std::array<uint8_t, (size_t(1) << kHash.bits)> slots{};
+        for (size_t i = 0; i < kCount; i++) slots[HashSlot(Rules::kRules[i].id, kHash)] = static_cast<uint8_t>(i + 1);
+        return slots;
+    }
+    static constexpr std::array<uint8_t, (size_t(1) << kHash.bits)> kSlots = BuildSlots();
+
+    // The rule for id, or nullptr if this kind skips it
+    static constexpr const ElementRule *Find(uint64_t id)
+    {
+        const uint8_t slot = kSlots[HashSlot(id, kHash)];
+        return slot != 0 && Rules::kRules[slot - 1].id == id ? &Rules::kRules[slot - 1] : nullptr;
+    }
+};
+
+// === Probe kinds ===
+
+enum class ProbeKind : uint8_t
+{
+    Duration,  // mvhd; Matroska Info, found through the SeekHead
+    Streams,   // per-track type, codec and dimensions or audio format
+    CoverArt,  // iTunes covr item; Matroska image attachment
+    Fragments, // fragmented MP4 timing: mehd, sidx, moof/traf, mfra
+};
+
+template <ProbeKind Kind>
+struct IsoBmffRules;
+template <ProbeKind Kind>
+struct EbmlRules;
+
+template <>
+struct IsoBmffRules<ProbeKind::Duration>
+{
+    static constexpr ElementFormat kFormat = ElementFormat::IsoBmff;
+    static constexpr ElementRule kRules[] = {
+        {FourCC("moov"), ElementPolicy::Descend, FieldType::Master, ElementField::Movie},
+        {FourCC("mvhd"), ElementPolicy::Read, FieldType::Bytes, ElementField::MovieHeader},
+    };
+};
+
+template <>
+struct IsoBmffRules<ProbeKind::Streams>
+{
+    static constexpr ElementFormat kFormat = ElementFormat::IsoBmff;
+    static constexpr ElementRule kRules[] = {
+        {FourCC("moov"), ElementPolicy::Descend, FieldType::Master, ElementField::Movie},
+        {FourCC("trak"), ElementPolicy::Descend, FieldType::Master, ElementField::Track},
+        {FourCC("tkhd"), ElementPolicy::Read, FieldType::Bytes, ElementField::TrackHeader},
+        {FourCC("mdia"), ElementPolicy::Descend, FieldType::Master, ElementField::None},
+        {FourCC("hdlr"), ElementPolicy::Read, FieldType::Bytes, ElementField::Handler},
+        {FourCC("minf"), ElementPolicy::Descend, FieldType::Master, ElementField::None},
+        {FourCC("stbl"), ElementPolicy::Descend, FieldType::Master, ElementField::None},
+        {FourCC("stsd"), ElementPolicy::Read, FieldType::Bytes, ElementField::SampleDescription},
+        {FourCC("mdat"), ElementPolicy::Skip, FieldType::Master, ElementField::None},
+    };
+};
+
+template <>
+struct IsoBmffRules<ProbeKind::CoverArt>
+{
+    static constexpr ElementFormat kFormat = ElementFormat::IsoBmff;
+    static constexpr ElementRule kRules[] = {
+        {FourCC("moov"), ElementPolicy::Descend, FieldType::Master, ElementField::Movie},
+        {FourCC("udta"), ElementPolicy::Descend, FieldType::Master, ElementField::None},
+        {FourCC("meta"), ElementPolicy::Descend, FieldType::FullBox, ElementField::None},
+        {FourCC("ilst"), ElementPolicy::Descend, FieldType::Master, ElementField::None},
+        {FourCC("covr"), ElementPolicy::Descend, FieldType::Master, ElementField::None},
+        {FourCC("data"), ElementPolicy::Read, FieldType::Position, ElementField::CoverData},
+        {FourCC("mdat"), ElementPolicy::Skip, FieldType::Master, ElementField::None},
+    };
+};
+
+// Only walked once mvhd has reported no duration
+template <>
+struct IsoBmffRules<ProbeKind::Fragments>
+{
+    static constexpr ElementFormat kFormat = ElementFormat::IsoBmff;
+    static constexpr ElementRule kRules[] = {
+        {FourCC("moov"), ElementPolicy::Descend, FieldType::Master, ElementField::Movie},
+        {FourCC("mvhd"), ElementPolicy::Read, FieldType::Bytes, ElementField::MovieHeader},
+        {FourCC("mvex"), ElementPolicy::Descend, FieldType::Master, ElementField::None},
+        {FourCC("mehd"), ElementPolicy::Read, FieldType::Bytes, ElementField::MovieExtendsHeader},
+        {FourCC("trex"), ElementPolicy::Read, FieldType::Bytes, ElementField::TrackExtends},
+        {FourCC("trak"), ElementPolicy::Descend, FieldType::Master, ElementField::Track},
+        {FourCC("tkhd"), ElementPolicy::Read, FieldType::Bytes, ElementField::TrackHeader},
+        {FourCC("mdia"), ElementPolicy::Descend, FieldType::Master, ElementField::None},
+        {FourCC("mdhd"), ElementPolicy::Read, FieldType::Bytes, ElementField::MediaHeader},
+        {FourCC("sidx"), ElementPolicy::Read, FieldType::Bytes, ElementField::SegmentIndex},
+        {FourCC("moof"), ElementPolicy::Descend, FieldType::Master, ElementField::MovieFragment},
+        {FourCC("traf"), ElementPolicy::Descend, FieldType::Master, ElementField::TrackFragment},
+        {FourCC("tfhd"), ElementPolicy::Read, FieldType::Bytes, ElementField::TrackFragmentHeader},
+        {FourCC("tfdt"), ElementPolicy::Read, FieldType::Bytes, ElementField::TrackFragmentDecodeTime},
+        {FourCC("trun"), ElementPolicy::Read, FieldType::Bytes, ElementField::TrackRun},
+        {FourCC("mfra"), ElementPolicy::Descend, FieldType::Master, ElementField::None},
+        {FourCC("tfra"), ElementPolicy::Read, FieldType::Bytes, ElementField::RandomAccess},
+        {FourCC("mdat"), ElementPolicy::Skip, FieldType::Master, ElementField::None},
+    };
+};
+
+// Matroska IDs are unique across levels, so one flat table serves the Segment and everything under it.
+template <>
+struct EbmlRules<ProbeKind::Duration>
+{
+    static constexpr ElementFormat kFormat = ElementFormat::Ebml;
+    static constexpr ElementRule kRules[] = {
+        {0x114D9B74, ElementPolicy::Descend, FieldType::Master, ElementField::None}, // SeekHead
+        {0x4DBB, ElementPolicy::Descend, FieldType::Master, ElementField::SeekEntry},
+        {0x53AB, ElementPolicy::Read, FieldType::UInt, ElementField::SeekId},
+        {0x53AC, ElementPolicy::Read, FieldType::UInt, ElementField::SeekPosition},
+        {0x1549A966, ElementPolicy::Descend, FieldType::Master, ElementField::SegmentInfo},
+        {0x2AD7B1, ElementPolicy::Read, FieldType::UInt, ElementField::TimestampScale},
+        {0x4489, ElementPolicy::Read, FieldType::Float, ElementField::Duration},
+        {0x1F43B675, ElementPolicy::Stop, FieldType::Master, ElementField::None}, // Cluster
+    };
+};
+
+template <>
+struct EbmlRules<ProbeKind::Streams>
+{
+    static constexpr ElementFormat kFormat = ElementFormat::Ebml;
+    static constexpr ElementRule kRules[] = {
+        {0x114D9B74, ElementPolicy::Descend, FieldType::Master, ElementField::None}, // SeekHead
+        {0x4DBB, ElementPolicy::Descend, FieldType::Master, ElementField::SeekEntry},
+        {0x53AB, ElementPolicy::Read, FieldType::UInt, ElementField::SeekId},
+        {0x53AC, ElementPolicy::Read, FieldType::UInt, ElementField::SeekPosition},
+        {0x1654AE6B, ElementPolicy::Descend, FieldType::Master, ElementField::Tracks},
+        {0xAE, ElementPolicy::Descend, FieldType::Master, ElementField::TrackEntry},
+        {0x83, ElementPolicy::Read, FieldType::UInt, ElementField::TrackType},
+        {0x86, ElementPolicy::Read, FieldType::String, ElementField::CodecId},
+        {0xE0, ElementPolicy::Descend, FieldType::Master, ElementField::None}, // Video
+        {0xB0, ElementPolicy::Read, FieldType::UInt, ElementField::PixelWidth},
+        {0xBA, ElementPolicy::Read, FieldType::UInt, ElementField::PixelHeight},
+        {0xE1, ElementPolicy::Descend, FieldType::Master, ElementField::None}, // Audio
+        {0xB5, ElementPolicy::Read, FieldType::Float, ElementField::SamplingFrequency},
+        {0x9F, ElementPolicy::Read, FieldType::UInt, ElementField::Channels},
+        {0x1F43B675, ElementPolicy::Stop, FieldType::Master, ElementField::None}, // Cluster
+    };
+};
+
+template <>
+struct EbmlRules<ProbeKind::CoverArt>
+{
+    static constexpr ElementFormat kFormat = ElementFormat::Ebml;
+    static constexpr ElementRule kRules[] = {
+        {0x114D9B74, ElementPolicy::Descend, FieldType::Master, ElementField::None}, // SeekHead
+        {0x4DBB, ElementPolicy::Descend, FieldType::Master, ElementField::SeekEntry},
+        {0x53AB, ElementPolicy::Read, FieldType::UInt, ElementField::SeekId},
+        {0x53AC, ElementPolicy::Read, FieldType::UInt, ElementField::SeekPosition},
+        {0x1941A469, ElementPolicy::Descend, FieldType::Master, ElementField::Attachments},
+        {0x61A7, ElementPolicy::Descend, FieldType::Master, ElementField::AttachedFile},
+        {0x466E, ElementPolicy::Read, FieldType::String, ElementField::FileName},
+        {0x4660, ElementPolicy::Read, FieldType::String, ElementField::FileMediaType},
+        {0x465C, ElementPolicy::Read, FieldType::Position, ElementField::FileData},
+        {0x1F43B675, ElementPolicy::Stop, FieldType::Master, ElementField::None}, // Cluster
+    };
+};
+
+// === Walker ===
+
+// Payload handed to a visitor. data holds the first `length` bytes (all of
+// them for scalars); size is the full payload size from the header.
+struct ElementValue
+{
+    uint64_t offset = 0;
+    uint64_t size = 0;
+    const uint8_t *data = nullptr;
+    size_t length = 0;
+    uint64_t uint = 0;
+    double real = 0.0;
+};
+
+// Visitors derive from this and hide the callbacks they need. Returning false ends the walk.
+struct ElementVisitor
+{
+    bool OnEnter(const ElementRule &, uint64_t /*payload*/, uint64_t /*size*/) { return true; }
+    bool OnLeave(const ElementRule &) { return true; }
+    bool OnField(const ElementRule &, const ElementValue &) { return true; }
+};
+
+// Element bytes from a buffer that is already in memory; offsets are file offsets.
+struct BufferReader
+{
+    const uint8_t *data;
+    uint64_t base;
+    size_t length;
+
+    const uint8_t *Bytes(uint64_t offset, size_t count, ScratchBytes *)
+    {
+        if (offset < base || offset - base > length || count > length - (offset - base)) return nullptr;
+        return data + (offset - base);
+    }
+};
+
+// Element bytes read on demand; the caller opens a ScratchArena::Scope.
+struct SourceReader
+{
+    ByteSource &source;
+
+    const uint8_t *Bytes(uint64_t offset, size_t count, ScratchBytes *scratch)
+    {
+        if (const uint8_t *view = source.View(offset, count)) return view;
+        scratch->resize(count);
+        return source.ReadAt(offset, scratch->data(), count) == count ? scratch->data() : nullptr;
+    }
+};
+
+constexpr uint32_t kMaxElementDepth = 12;
+constexpr size_t kMaxValueBytes = 64 * 1024;
+constexpr size_t kPositionPrefixBytes = 16;
+
+// Box or element header at the start of p; size is clamped to the enclosing range.
+template <ElementFormat Format>
+bool ReadElementAt(const uint8_t *p, size_t length, uint64_t remaining, uint64_t *id, uint64_t *size, uint32_t *header)
+{
+    if (Format == ElementFormat::IsoBmff)
+    {
+        if (!ReadBoxHeader(p, length, 0, remaining, size, header)) return false;
+        *id = ReadBe32(p + 4);
+        *size = std::min(*size, remaining) - *header; // box sizes include the header
+        return true;
+    }
+    size_t pos = 0;
+    bool unknown = false;
+    if (!ReadElementHeader(p, length, &pos, id, size, &unknown)) return false;
+    *header = static_cast<uint32_t>(pos);
+    // An unknown size (live recordings) extends to the parent's end
+    *size = unknown ? remaining - pos : std::min<uint64_t>(*size, remaining - pos);
+    return true;
+}
+
+template <typename Reader>
+bool ReadElementValue(Reader &reader, FieldType type, ElementValue *value, ScratchBytes *scratch)
+{
+    switch (type)
+    {
+    case FieldType::UInt:
+    case FieldType::Float:
+        if (value->size > 8 || (type == FieldType::Float && value->size != 4 && value->size != 8)) return false;
+        value->length = static_cast<size_t>(value->size);
+        if ((value->data = reader.Bytes(value->offset, value->length, scratch)) == nullptr) return false;
+        if (type == FieldType::UInt)
+            value->uint = ReadBeUInt(value->data, value->length);
+        else
+            value->real = ReadBeFloat(value->data, value->length);
+        return true;
+    case FieldType::String:
+    case FieldType::Bytes:
+        value->length = static_cast<size_t>(std::min<uint64_t>(value->size, kMaxValueBytes));
+        return (value->data = reader.Bytes(value->offset, value->length, scratch)) != nullptr;
+    case FieldType::Position:
+        value->length = static_cast<size_t>(std::min<uint64_t>(value->size, kPositionPrefixBytes));
+        return (value->data = reader.Bytes(value->offset, value->length, scratch)) != nullptr;
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Walks the boxes or elements in [begin, end) through a kind's rule table.
+ *
+ * Elements without a rule are stepped over by size. Damaged headers end the
+ * walk at their level, and sizes are clamped to the enclosing element, so a
+ * truncated buffer yields whatever is complete in it.
+ *
+ * @return false if the visitor ended the walk
+ */
+template <typename Rules, typename Reader, typename Visitor>
+bool WalkElements(Reader &reader, uint64_t begin, uint64_t end, Visitor &visitor, uint32_t depth = 0)
+{
+    ScratchBytes scratch;
+    uint64_t pos = begin;
+    while (pos < end)
+    {
+        const size_t available = static_cast<size_t>(std::min<uint64_t>(16, end - pos));
+        const uint8_t *header = reader.Bytes(pos, available, &scratch);
+        uint64_t id, size;
+        uint32_t headerLength;
+        if (header == nullptr || !ReadElementAt<Rules::kFormat>(header, available, end - pos, &id, &size, &headerLength)) break;
+        const uint64_t payload = pos + headerLength;
+        pos = payload + size;
+
+        const ElementRule *rule = Dispatch<Rules>::Find(id);
+        if (rule == nullptr || rule->policy == ElementPolicy::Skip) continue;
+        if (rule->policy == ElementPolicy::Stop) break;
+        if (rule->policy == ElementPolicy::Descend)
+        {
+            if (depth + 1 >= kMaxElementDepth) continue;
+            uint64_t children = payload;
+            if (rule->type == FieldType::FullBox && size >= 4)
+            {
+                // QuickTime writes meta without the version/flags word; its first child follows directly
+                const uint8_t *peek = size >= 12 ? reader.Bytes(payload, 12, &scratch) : nullptr;
+                if (peek == nullptr || !BoxTypeIs(peek, "hdlr")) children += 4;
+            }
+            if (!visitor.OnEnter(*rule, payload, size)) return false;
+            if (!WalkElements<Rules>(reader, children, payload + size, visitor, depth + 1)) return false;
+            if (!visitor.OnLeave(*rule)) return false;
+            continue;
+        }
+
+        ElementValue value;
+        value.offset = payload;
+        value.size = size;
+        if (!ReadElementValue(reader, rule->type, &value, &scratch)) continue;
+        if (!visitor.OnField(*rule, value)) return false;
+    }
+    return true;
+}
+
+#endif // ELEMENT_DISPATCH_H
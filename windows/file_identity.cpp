@@ -0,0 +1,120 @@
+#include "file_identity.h"
+#include "path_arena.h"
+#include "probe_cache.h"
+#include <algorithm>
+
+FileIdentityIndex &FileIdentityIndex::Instance()
+{
+    static FileIdentityIndex index;
+    return index;
+}
+
+void FileIdentityIndex::Record(uint32_t pathId, const FileIdentity &identity)
+{
+    if (!identity.Known()) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = identities_.find(pathId);
+    if (it != identities_.end())
+    {
+        if (it->second == identity) return;
+        // The path names another file now, e.g. it was replaced by a copy
+        ForgetLocked(pathId, it->second);
+        it->second = identity;
+    }
+    else
+    {
+        identities_.emplace(pathId, identity);
+    }
+    paths_[identity].push_back(pathId);
+}
+
+bool FileIdentityIndex::Find(uint32_t pathId, FileIdentity *identity) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = identities_.find(pathId);
+    if (it == identities_.end()) return false;
+    *identity = it->second;
+    return true;
+}
+
+void FileIdentityIndex::Forget(uint32_t pathId)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = identities_.find(pathId);
+    if (it == identities_.end()) return;
+    ForgetLocked(pathId, it->second);
+    identities_.erase(it);
+}
+
+size_t FileIdentityIndex::ForgetUnder(NativePathView directory)
+{
+    PathArena &arena = PathArena::Instance();
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t removed = 0;
+    for (auto it = identities_.begin(); it != identities_.end();)
+    {
+        NativePathView path;
+        if (arena.Get(it->first, &path) && PathIsUnder(path, directory))
+        {
+            ForgetLocked(it->first, it->second);
+            it = identities_.erase(it);
+            removed++;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+void FileIdentityIndex::ForgetLocked(uint32_t pathId, const FileIdentity &identity)
+{
+    auto group = paths_.find(identity);
+    if (group == paths_.end()) return;
+    std::vector<uint32_t> &ids = group->second;
+    ids.erase(std::remove(ids.begin(), ids.end(), pathId), ids.end());
+    if (ids.empty()) paths_.erase(group);
+}
+
+std::vector<uint32_t> FileIdentityIndex::Siblings(uint32_t pathId) const
+{
+    std::vector<uint32_t> siblings;
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = identities_.find(pathId);
+    if (it == identities_.end()) return siblings;
+    auto group = paths_.find(it->second);
+    if (group == paths_.end() || group->second.size() < 2) return siblings;
+    for (const uint32_t id : group->second)
+        if (id != pathId) siblings.push_back(id);
+    return siblings;
+}
+
+void FileIdentityIndex::NoteShared(SharedWork work, uint64_t fileBytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    switch (work)
+    {
+    case SharedWork::Entry: shared_.shared_entries++; break;
+    case SharedWork::Probe: shared_.shared_probes++; break;
+    case SharedWork::Thumbnail: shared_.shared_thumbnails++; break;
+    }
+    shared_.shared_file_bytes += fileBytes;
+}
+
+FileIdentityStats FileIdentityIndex::Stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    FileIdentityStats stats = shared_;
+    stats.paths = identities_.size();
+    stats.files = paths_.size();
+    return stats;
+}
+
+void FileIdentityIndex::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    identities_.clear();
+    paths_.clear();
+    shared_ = {};
+}
@@ -0,0 +1,84 @@
+#ifndef FILE_IDENTITY_H
+#define FILE_IDENTITY_H
+
+#include "native_path.h"
+#include "video_data_exporter_api.h"
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// Which file a path names; hardlinks of one file share it. (st_dev, st_ino) on POSIX,
+// the volume serial number and 128-bit file ID on Windows (ReFS uses all 128 bits).
+struct FileIdentity
+{
+    uint64_t volume = 0;
+    uint64_t id_low = 0;
+    uint64_t id_high = 0;
+
+    bool Known() const { return id_low != 0 || id_high != 0; }
+    bool operator==(const FileIdentity &other) const
+    {
+        return volume == other.volume && id_low == other.id_low && id_high == other.id_high;
+    }
+};
+
+struct FileIdentityHash
+{
+    size_t operator()(const FileIdentity &identity) const
+    {
+        uint64_t h = identity.id_low * 0x9E3779B97F4A7C15ULL;
+        h ^= (identity.volume + (h << 6) + (h >> 2)) * 0xC2B2AE3D27D4EB4FULL;
+        return static_cast<size_t>(h ^ identity.id_high);
+    }
+};
+
+// Work one path reused from another path of the same file; see FileIdentityStats.
+enum class SharedWork
+{
+    Entry,
+    Probe,
+    Thumbnail,
+};
+
+/**
+ * @brief Path IDs grouped by the file they name.
+ *
+ * Identities are recorded where they come for free: from the listing during a
+ * walk, and from the statx behind every by-ID call on Linux (Windows has no
+ * equally cheap per-path query, so there only walked paths are known). The
+ * caches keyed by path ID look up the other paths of a file here, so that a
+ * hardlink reuses what was computed for an earlier one.
+ */
+class FileIdentityIndex
+{
+public:
+    static FileIdentityIndex &Instance();
+
+    // Records, or moves, @p pathId to the file @p identity names. Unknown identities are ignored.
+    void Record(uint32_t pathId, const FileIdentity &identity);
+    bool Find(uint32_t pathId, FileIdentity *identity) const;
+    void Forget(uint32_t pathId);
+    // Forgets every path at or below @p directory. Returns the number forgotten.
+    size_t ForgetUnder(NativePathView directory);
+
+    // The other paths recorded for the file @p pathId names, oldest first.
+    std::vector<uint32_t> Siblings(uint32_t pathId) const;
+
+    // Counts work that was reused for a file of @p fileBytes instead of being repeated.
+    void NoteShared(SharedWork work, uint64_t fileBytes);
+    FileIdentityStats Stats() const;
+    void Clear();
+
+private:
+    FileIdentityIndex() = default;
+
+    void ForgetLocked(uint32_t pathId, const FileIdentity &identity);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint32_t, FileIdentity> identities_;
+    std::unordered_map<FileIdentity, std::vector<uint32_t>, FileIdentityHash> paths_;
+    FileIdentityStats shared_ = {}; // the shared_* counters; paths and files are derived
+};
+
+#endif // FILE_IDENTITY_H
@@ -0,0 +1,85 @@
+#include "file_metadata.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/sysmacros.h>
+#endif
+
+#ifdef _WIN32
+namespace
+{
+    int64_t FileTimeToUnixMs(const FILETIME &fileTime)
+    {
+        // FILETIME counts 100ns ticks since 1601-01-01
+        const int64_t WINDOWS_TICK = 10000000;
+        const int64_t SEC_TO_UNIX_EPOCH = 11644473600LL;
+
+        ULARGE_INTEGER ticks;
+        ticks.LowPart = fileTime.dwLowDateTime;
+        ticks.HighPart = fileTime.dwHighDateTime;
+        return (ticks.QuadPart / (WINDOWS_TICK / 1000)) - (SEC_TO_UNIX_EPOCH * 1000);
+    }
+}
+
+bool ReadFileMetadata(const PathChar *path, FileMetadata *metadata, FileIdentity *identity)
+{
+    if (identity != nullptr) *identity = FileIdentity();
+    WIN32_FILE_ATTRIBUTE_DATA fileAttrData;
+    if (!GetFileAttributesExW(path, GetFileExInfoStandard, &fileAttrData)) return false;
+
+    ULARGE_INTEGER fileSize;
+    fileSize.HighPart = fileAttrData.nFileSizeHigh;
+    fileSize.LowPart = fileAttrData.nFileSizeLow;
+
+    metadata->creation_time_ms = FileTimeToUnixMs(fileAttrData.ftCreationTime);
+    metadata->access_time_ms = FileTimeToUnixMs(fileAttrData.ftLastAccessTime);
+    metadata->modified_time_ms = FileTimeToUnixMs(fileAttrData.ftLastWriteTime);
+    metadata->file_size_bytes = static_cast<int64_t>(fileSize.QuadPart);
+    return true;
+}
+#else
+namespace
+{
+    inline int64_t ToUnixMs(int64_t sec, int64_t nsec) { return sec * 1000 + nsec / 1000000; }
+}
+
+#ifdef STATX_BTIME
+void FileMetadataFromStatx(const struct statx &stx, FileMetadata *metadata)
+{
+    const statx_timestamp &birth = (stx.stx_mask & STATX_BTIME) ? stx.stx_btime : stx.stx_ctime;
+    metadata->creation_time_ms = ToUnixMs(birth.tv_sec, birth.tv_nsec);
+    metadata->access_time_ms = ToUnixMs(stx.stx_atime.tv_sec, stx.stx_atime.tv_nsec);
+    metadata->modified_time_ms = ToUnixMs(stx.stx_mtime.tv_sec, stx.stx_mtime.tv_nsec);
+    metadata->file_size_bytes = static_cast<int64_t>(stx.stx_size);
+}
+#endif
+
+bool ReadFileMetadata(const PathChar *path, FileMetadata *metadata, FileIdentity *identity)
+{
+#ifdef STATX_BTIME
+    struct statx stx;
+    if (statx(AT_FDCWD, path, 0, STATX_BASIC_STATS | STATX_BTIME, &stx) == 0)
+    {
+        FileMetadataFromStatx(stx, metadata);
+        if (identity != nullptr) *identity = FileIdentity{makedev(stx.stx_dev_major, stx.stx_dev_minor), stx.stx_ino, 0};
+        return true;
+    }
+#endif
+    struct stat st;
+    if (stat(path, &st) != 0) return false;
+    if (identity != nullptr) *identity = FileIdentity{static_cast<uint64_t>(st.st_dev), static_cast<uint64_t>(st.st_ino), 0};
+    metadata->creation_time_ms = ToUnixMs(st.st_ctim.tv_sec, st.st_ctim.tv_nsec);
+    metadata->access_time_ms = ToUnixMs(st.st_atim.tv_sec, st.st_atim.tv_nsec);
+    metadata->modified_time_ms = ToUnixMs(st.st_mtim.tv_sec, st.st_mtim.tv_nsec);
+    metadata->file_size_bytes = static_cast<int64_t>(st.st_size);
+    return true;
+}
+#endif
+
+bool ReadFileMetadata(const PathChar *path, FileMetadata *metadata)
+{
+    return ReadFileMetadata(path, metadata, nullptr);
+}
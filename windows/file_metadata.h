@@ -0,0 +1,32 @@
+#ifndef FILE_METADATA_H
+#define FILE_METADATA_H
+
+#include "file_identity.h"
+#include "native_path.h"
+#include "video_data_exporter_api.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+/**
+ * @brief Fills @p metadata with the timestamps (ms since Unix epoch) and size of a file.
+ *
+ * Windows reads GetFileAttributesExW; POSIX uses statx so the birth time is
+ * available where the filesystem records it, falling back to ctime otherwise.
+ *
+ * @return false if the file cannot be queried
+ */
+bool ReadFileMetadata(const PathChar *path, FileMetadata *metadata);
+
+// Same, and fills @p identity where the query returns it anyway: statx does, so it is known on
+// POSIX; GetFileAttributesExW does not, so on Windows it is left unknown.
+bool ReadFileMetadata(const PathChar *path, FileMetadata *metadata, FileIdentity *identity);
+
+#ifdef STATX_BTIME
+// Same conversion for a statx result obtained elsewhere (e.g. from io_uring)
+void FileMetadataFromStatx(const struct statx &stx, FileMetadata *metadata);
+#endif
+
+#endif // FILE_METADATA_H
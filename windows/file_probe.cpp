@@ -0,0 +1,121 @@
+#include "file_probe.h"
+#include "byte_source.h"
+#include "container_probe.h"
+#include "content_hash.h"
+#include "content_sniffer.h"
+#include "file_metadata.h"
+#include "media_probe.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace
+{
+    constexpr uint32_t kParsedFields = static_cast<uint32_t>(ProbeField::Duration) | static_cast<uint32_t>(ProbeField::Streams) |
+                                       static_cast<uint32_t>(ProbeField::CoverArt) | static_cast<uint32_t>(ProbeField::Keyframes);
+
+    template <size_t N>
+    void CopyText(const char *text, char (&out)[N])
+    {
+        std::strncpy(out, text, N - 1);
+        out[N - 1] = '\0';
+    }
+
+    void FillStreams(const std::vector<StreamInfo> &streams, FileProbeResult *result)
+    {
+        for (const StreamInfo &stream : streams)
+        {
+            if (stream.type == StreamType::Video && result->video_streams++ == 0)
+            {
+                CopyText(stream.codec, result->video_codec);
+                result->width = stream.width;
+                result->height = stream.height;
+            }
+            if (stream.type == StreamType::Audio && result->audio_streams++ == 0)
+            {
+                CopyText(stream.codec, result->audio_codec);
+                result->sample_rate = stream.sample_rate;
+                result->channels = stream.channels;
+            }
+        }
+    }
+}
+
+bool ProbeFile(const PathChar *path, uint32_t fields, FileProbeResult *result, std::shared_ptr<const KeyframeIndex> *keyframes)
+{
+    *result = FileProbeResult();
+    if (path == nullptr) return false;
+    if (HasField(fields, ProbeField::Metadata))
+    {
+        if (!ReadFileMetadata(path, &result->metadata)) return false;
+        result->fields |= static_cast<uint32_t>(ProbeField::Metadata);
+    }
+    if ((fields & kProbeAllFields & ~static_cast<uint32_t>(ProbeField::Metadata)) == 0) return true;
+
+    // Hashing alone reads front to back; parsers hop around the head and tail first
+    const bool parses = (fields & kParsedFields) != 0;
+    std::unique_ptr<ByteSource> source = OpenFileSource(path, parses ? AccessPattern::Random : AccessPattern::Sequential);
+    if (!source) return false;
+    result->opens = 1;
+
+    ScratchArena::Scope scope;
+    if (parses)
+    {
+        if (HasField(fields, ProbeField::Duration))
+        {
+            DurationProbe probe;
+            const ProbeStep step = RunProbe(probe, *source);
+            result->container = static_cast<uint8_t>(probe.Container());
+            if (step.kind == ProbeStep::Done && probe.DurationMs() > 0.0)
+            {
+                result->duration_ms = probe.DurationMs();
+                result->duration_method = static_cast<uint8_t>(probe.Method());
+                result->fields |= static_cast<uint32_t>(ProbeField::Duration);
+            }
+        }
+        else
+            result->container = static_cast<uint8_t>(SniffSource(*source));
+
+        // The rest only exist in the containers with native parsers
+        const ContainerKind kind = static_cast<ContainerKind>(result->container);
+        const bool structured = kind == ContainerKind::IsoBmff || kind == ContainerKind::QuickTime || kind == ContainerKind::Matroska ||
+                                kind == ContainerKind::WebM;
+        std::vector<StreamInfo> streams;
+        if (structured && HasField(fields, ProbeField::Streams) && ProbeStreams(*source, &streams))
+        {
+            FillStreams(streams, result);
+            result->fields |= static_cast<uint32_t>(ProbeField::Streams);
+        }
+        CoverArt cover;
+        if (structured && HasField(fields, ProbeField::CoverArt) && FindCoverArt(*source, &cover))
+        {
+            result->cover_offset = cover.offset;
+            result->cover_size = cover.size;
+            CopyText(cover.media_type, result->cover_media_type);
+            result->fields |= static_cast<uint32_t>(ProbeField::CoverArt);
+        }
+        if (HasField(fields, ProbeField::Keyframes))
+        {
+            auto index = std::make_shared<KeyframeIndex>();
+            if (structured) BuildKeyframeIndex(*source, index.get());
+            result->keyframe_count = static_cast<uint32_t>(index->Count());
+            result->fields |= static_cast<uint32_t>(ProbeField::Keyframes); // a count of 0 is an answer too
+            if (keyframes != nullptr) *keyframes = std::move(index);
+        }
+    }
+
+    if (HasField(fields, ProbeField::FullHash))
+    {
+        source->Hint(AccessPattern::Sequential);
+        const bool sampled = HasField(fields, ProbeField::SampledHash);
+        if (FullContentHash(*source, &result->full_hash, sampled ? &result->sampled_hash : nullptr))
+            result->fields |= static_cast<uint32_t>(ProbeField::FullHash) | (sampled ? static_cast<uint32_t>(ProbeField::SampledHash) : 0);
+    }
+    else if (HasField(fields, ProbeField::SampledHash) && SampledContentHash(*source, &result->sampled_hash))
+        result->fields |= static_cast<uint32_t>(ProbeField::SampledHash);
+
+    result->bytes_read = source->BytesRead();
+    result->read_calls = source->ReadCalls();
+    return true;
+}
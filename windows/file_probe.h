@@ -0,0 +1,42 @@
+#ifndef FILE_PROBE_H
+#define FILE_PROBE_H
+
+#include "keyframe_index.h"
+#include "native_path.h"
+#include "video_data_exporter_api.h"
+#include <cstdint>
+#include <memory>
+
+// Bits of probe_file's fields_mask and of FileProbeResult::fields
+enum class ProbeField : uint32_t
+{
+    Metadata = 1 << 0,
+    Duration = 1 << 1,
+    Streams = 1 << 2,
+    CoverArt = 1 << 3,
+    Keyframes = 1 << 4,
+    SampledHash = 1 << 5,
+    FullHash = 1 << 6,
+};
+
+constexpr uint32_t kProbeAllFields = 0x7F;
+
+constexpr bool HasField(uint32_t fields, ProbeField field) { return (fields & static_cast<uint32_t>(field)) != 0; }
+
+/**
+ * @brief Fills the groups of @p result that @p fields asks for, opening the file at most once.
+ *
+ * Metadata is a stat. Any other field opens one ByteSource shared by every
+ * parser: the duration, stream, cover-art and keyframe walks revisit the same
+ * header ranges, which its read-ahead cache serves after the first read. A full
+ * hash streams the file last and computes the sampled hash on the way. A
+ * request for metadata alone never opens the file, let alone a parser.
+ *
+ * @param keyframes if not null and keyframes were asked for, receives the index
+ * @return false if the file cannot be stat'ed or opened; groups a parser could
+ *         not answer are left out of result->fields
+ */
+bool ProbeFile(const PathChar *path, uint32_t fields, FileProbeResult *result,
+               std::shared_ptr<const KeyframeIndex> *keyframes = nullptr);
+
+#endif // FILE_PROBE_H
@@ -0,0 +1,502 @@
+#include "fs_watcher.h"
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <system_error>
+#include <unordered_map>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+// === Coalescer ===
+
+FsChangeCoalescer::FsChangeCoalescer(Clock::duration quietPeriod, Clock::duration maxDelay)
+    : quietPeriod_(quietPeriod), maxDelay_(std::max(maxDelay, quietPeriod))
+{
+}
+
+void FsChangeCoalescer::Add(const FsEvent &event, Clock::time_point now)
+{
+    eventCount_++;
+    auto it = pending_.find(event.path);
+    if (it == pending_.end())
+    {
+        Pending pending;
+        // What the path looked like before this window started
+        pending.existedBefore = event.kind != FsEventKind::Created;
+        pending.existsNow = true;
+        pending.isDirectory = event.is_directory;
+        pending.rescan = false;
+        pending.first = now;
+        it = pending_.emplace(event.path, pending).first;
+    }
+
+    Pending &pending = it->second;
+    pending.last = now;
+    switch (event.kind)
+    {
+    case FsEventKind::Created:
+    case FsEventKind::Modified:
+        pending.existsNow = true;
+        pending.isDirectory = pending.isDirectory || event.is_directory;
+        break;
+    case FsEventKind::Removed:
+        pending.existsNow = false;
+        break;
+    case FsEventKind::Overflow:
+        pending.rescan = true;
+        pending.isDirectory = true;
+        break;
+    }
+}
+
+void FsChangeCoalescer::Flush(Clock::time_point now, std::vector<FsChange> *out)
+{
+    for (auto it = pending_.begin(); it != pending_.end();)
+    {
+        const Pending &pending = it->second;
+        const bool quiet = now - pending.last >= quietPeriod_;
+        const bool overdue = now - pending.first >= maxDelay_;
+        if (!quiet && !overdue)
+        {
+            ++it;
+            continue;
+        }
+
+        if (pending.rescan)
+            out->push_back({it->first, FsChangeKind::Rescan, true});
+        else if (!pending.existedBefore && pending.existsNow)
+            out->push_back({it->first, FsChangeKind::Added, pending.isDirectory});
+        else if (pending.existedBefore && pending.existsNow)
+            out->push_back({it->first, FsChangeKind::Modified, pending.isDirectory});
+        else if (pending.existedBefore && !pending.existsNow)
+            out->push_back({it->first, FsChangeKind::Removed, pending.isDirectory});
+        // Created and removed inside one window: nothing to report
+
+        it = pending_.erase(it);
+    }
+}
+
+FsChangeCoalescer::Clock::time_point FsChangeCoalescer::NextDeadline() const
+{
+    Clock::time_point deadline = Clock::time_point::max();
+    for (const auto &entry : pending_)
+    {
+        const Pending &pending = entry.second;
+        deadline = std::min(deadline, std::min(pending.last + quietPeriod_, pending.first + maxDelay_));
+    }
+    return deadline;
+}
+
+// === Backends ===
+
+class FsWatchBackend
+{
+public:
+    virtual ~FsWatchBackend() = default;
+    virtual bool AddRoot(const NativePath &root) = 0;
+    // Waits up to timeoutMs (-1: forever) and appends raw events. False on a fatal error.
+    virtual bool Wait(int timeoutMs, std::vector<FsEvent> *events) = 0;
+    virtual void Wake() = 0;
+};
+
+#ifdef _WIN32
+
+namespace
+{
+    // Reports everything below a directory that appeared in one piece (mkdir -p, a
+    // directory moved in) since the OS only tells us about the top directory.
+    void AppendTreeEvents(const NativePath &directory, std::vector<FsEvent> *events)
+    {
+        std::error_code ec;
+        for (std::filesystem::recursive_directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+        {
+            const bool isDirectory = it->is_directory(ec) && !it->is_symlink(ec);
+            events->push_back({it->path().native(), FsEventKind::Created, isDirectory});
+        }
+    }
+}
+
+class ReadDirectoryChangesBackend : public FsWatchBackend
+{
+public:
+    ReadDirectoryChangesBackend()
+    {
+        wakeEvent_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+    }
+
+    ~ReadDirectoryChangesBackend() override
+    {
+        for (auto &root : roots_)
+        {
+            CancelIoEx(root->directory, &root->overlapped);
+            DWORD ignored;
+            GetOverlappedResult(root->directory, &root->overlapped, &ignored, TRUE);
+            CloseHandle(root->overlapped.hEvent);
+            CloseHandle(root->directory);
+        }
+        if (wakeEvent_ != nullptr) CloseHandle(wakeEvent_);
+    }
+
+    bool AddRoot(const NativePath &path) override
+    {
+        // One wait slot is taken by the wake event
+        if (wakeEvent_ == nullptr || roots_.size() + 1 >= MAXIMUM_WAIT_OBJECTS) return false;
+
+        HANDLE directory = CreateFileW(path.c_str(), FILE_LIST_DIRECTORY,
+                                       FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                       OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+        if (directory == INVALID_HANDLE_VALUE) return false;
+
+        auto root = std::make_unique<Root>();
+        root->path = path;
+        root->directory = directory;
+        root->buffer.resize(kBufferBytes / sizeof(DWORD));
+        ZeroMemory(&root->overlapped, sizeof(root->overlapped));
+        root->overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        if (root->overlapped.hEvent == nullptr || !Arm(*root))
+        {
+            if (root->overlapped.hEvent != nullptr) CloseHandle(root->overlapped.hEvent);
+            CloseHandle(directory);
+            return false;
+        }
+        roots_.push_back(std::move(root));
+        return true;
+    }
+
+    bool Wait(int timeoutMs, std::vector<FsEvent> *events) override
+    {
+        std::vector<HANDLE> handles;
+        handles.push_back(wakeEvent_);
+        for (auto &root : roots_) handles.push_back(root->overlapped.hEvent);
+
+        DWORD result = WaitForMultipleObjects(static_cast<DWORD>(handles.size()), handles.data(), FALSE,
+                                              timeoutMs < 0 ? INFINITE : static_cast<DWORD>(timeoutMs));
+        if (result == WAIT_FAILED) return false;
+        if (result == WAIT_TIMEOUT || result == WAIT_OBJECT_0) return true;
+
+        // Drain every root that completed, not just the first signaled one
+        for (auto &root : roots_)
+        {
+            if (WaitForSingleObject(root->overlapped.hEvent, 0) != WAIT_OBJECT_0) continue;
+
+            DWORD bytes = 0;
+            if (!GetOverlappedResult(root->directory, &root->overlapped, &bytes, FALSE))
+            {
+                // The directory itself went away
+                events->push_back({root->path, FsEventKind::Removed, true});
+                continue;
+            }
+            if (bytes == 0)
+                events->push_back({root->path, FsEventKind::Overflow, true});
+            else
+                Parse(*root, bytes, events);
+            Arm(*root);
+        }
+        return true;
+    }
+
+    void Wake() override { SetEvent(wakeEvent_); }
+
+private:
+    static constexpr DWORD kBufferBytes = 64 * 1024;
+
+    struct Root
+    {
+        NativePath path;
+        HANDLE directory;
+        OVERLAPPED overlapped;
+        std::vector<DWORD> buffer; // FILE_NOTIFY_INFORMATION must be DWORD-aligned
+    };
+
+    static bool Arm(Root &root)
+    {
+        ResetEvent(root.overlapped.hEvent);
+        const DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_DIR_NAME |
+                             FILE_NOTIFY_CHANGE_SIZE | FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_CREATION;
+        return ReadDirectoryChangesW(root.directory, root.buffer.data(), kBufferBytes, TRUE, filter,
+                                     nullptr, &root.overlapped, nullptr) != FALSE;
+    }
+
+    static void Parse(const Root &root, DWORD bytes, std::vector<FsEvent> *events)
+    {
+        const BYTE *cursor = reinterpret_cast<const BYTE *>(root.buffer.data());
+        const BYTE *end = cursor + bytes;
+        while (cursor < end)
+        {
+            const FILE_NOTIFY_INFORMATION *info = reinterpret_cast<const FILE_NOTIFY_INFORMATION *>(cursor);
+            NativePath path = root.path;
+            path += kPathSeparator;
+            path.append(info->FileName, info->FileNameLength / sizeof(WCHAR));
+
+            const DWORD attributes = GetFileAttributesW(path.c_str());
+            const bool isDirectory = attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY);
+
+            switch (info->Action)
+            {
+            case FILE_ACTION_ADDED:
+            case FILE_ACTION_RENAMED_NEW_NAME:
+                events->push_back({path, FsEventKind::Created, isDirectory});
+                if (isDirectory && info->Action == FILE_ACTION_RENAMED_NEW_NAME) AppendTreeEvents(path, events);
+                break;
+            case FILE_ACTION_MODIFIED:
+                // Directory "modifications" are just their children changing
+                if (!isDirectory) events->push_back({path, FsEventKind::Modified, false});
+                break;
+            case FILE_ACTION_REMOVED:
+            case FILE_ACTION_RENAMED_OLD_NAME:
+                events->push_back({path, FsEventKind::Removed, false});
+                break;
+            }
+
+            if (info->NextEntryOffset == 0) break;
+            cursor += info->NextEntryOffset;
+        }
+    }
+
+    HANDLE wakeEvent_ = nullptr;
+    std::vector<std::unique_ptr<Root>> roots_;
+};
+
+#else
+
+class InotifyBackend : public FsWatchBackend
+{
+public:
+    InotifyBackend()
+    {
+        fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    }
+
+    ~InotifyBackend() override
+    {
+        if (fd_ >= 0) close(fd_);
+        if (wakeFd_ >= 0) close(wakeFd_);
+    }
+
+    bool AddRoot(const NativePath &root) override
+    {
+        if (fd_ < 0 || wakeFd_ < 0) return false;
+        const int wd = WatchTree(root, nullptr);
+        if (wd < 0) return false;
+        roots_[wd] = root;
+        return true;
+    }
+
+    bool Wait(int timeoutMs, std::vector<FsEvent> *events) override
+    {
+        pollfd fds[2] = {{fd_, POLLIN, 0}, {wakeFd_, POLLIN, 0}};
+        const int ready = poll(fds, 2, timeoutMs);
+        if (ready < 0) return errno == EINTR;
+        if (fds[1].revents & POLLIN)
+        {
+            uint64_t counter;
+            (void)!read(wakeFd_, &counter, sizeof(counter));
+        }
+        if (fds[0].revents & POLLIN) Drain(events);
+        return true;
+    }
+
+    void Wake() override
+    {
+        const uint64_t one = 1;
+        (void)!write(wakeFd_, &one, sizeof(one));
+    }
+
+private:
+    static constexpr uint32_t kMask = IN_CREATE | IN_DELETE | IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB |
+                                      IN_MOVED_FROM | IN_MOVED_TO | IN_DELETE_SELF | IN_MOVE_SELF |
+                                      IN_ONLYDIR | IN_DONT_FOLLOW | IN_EXCL_UNLINK;
+
+    // Watches @p directory and every directory below it. When @p events is set, the
+    // contents found are reported as created (the directory just appeared).
+    int WatchTree(const NativePath &directory, std::vector<FsEvent> *events)
+    {
+        const int wd = inotify_add_watch(fd_, directory.c_str(), kMask);
+        if (wd < 0) return -1;
+        dirs_[wd] = directory;
+
+        std::error_code ec;
+        for (std::filesystem::directory_iterator it(directory, ec), end; !ec && it != end; it.increment(ec))
+        {
+            const bool isDirectory = it->is_directory(ec) && !it->is_symlink(ec);
+            if (events != nullptr) events->push_back({it->path().native(), FsEventKind::Created, isDirectory});
+            if (isDirectory) WatchTree(it->path().native(), events);
+        }
+        return wd;
+    }
+
+    // A directory moved out of the tree keeps its watches; drop them so events for
+    // its old path do not resurface.
+    void UnwatchTree(const NativePath &directory)
+    {
+        for (auto it = dirs_.begin(); it != dirs_.end();)
+        {
+            const NativePath &path = it->second;
+            const bool under = path.compare(0, directory.size(), directory) == 0 &&
+                               (path.size() == directory.size() || path[directory.size()] == '/');
+            if (under && roots_.count(it->first) == 0)
+            {
+                inotify_rm_watch(fd_, it->first);
+                it = dirs_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+
+    void Drain(std::vector<FsEvent> *events)
+    {
+        alignas(inotify_event) char buffer[64 * 1024];
+        for (;;)
+        {
+            const ssize_t length = read(fd_, buffer, sizeof(buffer));
+            if (length <= 0) break;
+
+            for (char *cursor = buffer; cursor < buffer + length;)
+            {
+                const inotify_event *event = reinterpret_cast<const inotify_event *>(cursor);
+                cursor += sizeof(inotify_event) + event->len;
+                Handle(*event, events);
+            }
+        }
+    }
+
+    void Handle(const inotify_event &event, std::vector<FsEvent> *events)
+    {
+        if (event.mask & IN_Q_OVERFLOW)
+        {
+            for (const auto &root : roots_) events->push_back({root.second, FsEventKind::Overflow, true});
+            return;
+        }
+
+        auto dir = dirs_.find(event.wd);
+        if (dir == dirs_.end()) return;
+        if (event.mask & IN_IGNORED)
+        {
+            roots_.erase(event.wd);
+            dirs_.erase(dir);
+            return;
+        }
+
+        const bool isDirectory = (event.mask & IN_ISDIR) != 0;
+        if (event.len == 0)
+        {
+            // Events about the watched directory itself only matter for roots; for the
+            // rest the parent already reported the deletion or move.
+            if ((event.mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT)) && roots_.count(event.wd))
+                events->push_back({dir->second, FsEventKind::Removed, true});
+            return;
+        }
+
+        NativePath path = dir->second + "/" + event.name;
+        if (event.mask & (IN_CREATE | IN_MOVED_TO))
+        {
+            events->push_back({path, FsEventKind::Created, isDirectory});
+            if (isDirectory) WatchTree(path, events);
+        }
+        else if (event.mask & (IN_DELETE | IN_MOVED_FROM))
+        {
+            events->push_back({path, FsEventKind::Removed, isDirectory});
+            if (isDirectory && (event.mask & IN_MOVED_FROM)) UnwatchTree(path);
+        }
+        else if (!isDirectory && (event.mask & (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB)))
+        {
+            events->push_back({path, FsEventKind::Modified, false});
+        }
+    }
+
+    int fd_ = -1;
+    int wakeFd_ = -1;
+    std::unordered_map<int, NativePath> dirs_;
+    std::unordered_map<int, NativePath> roots_;
+};
+
+#endif
+
+// === Watcher ===
+
+FsWatcher::FsWatcher(BatchCallback callback, std::chrono::milliseconds debounce)
+    : coalescer_(debounce, debounce * 20), callback_(std::move(callback))
+{
+#ifdef _WIN32
+    backend_ = std::make_unique<ReadDirectoryChangesBackend>();
+#else
+    backend_ = std::make_unique<InotifyBackend>();
+#endif
+}
+
+FsWatcher::~FsWatcher()
+{
+    Stop();
+}
+
+bool FsWatcher::AddRoot(const NativePath &root)
+{
+    if (thread_.joinable()) return false;
+    if (!backend_->AddRoot(root))
+    {
+        std::cerr << "fs_watcher | Failed to watch root" << std::endl;
+        return false;
+    }
+    rootCount_++;
+    return true;
+}
+
+bool FsWatcher::Start()
+{
+    if (rootCount_ == 0 || thread_.joinable()) return false;
+    stopping_ = false;
+    thread_ = std::thread(&FsWatcher::Run, this);
+    return true;
+}
+
+void FsWatcher::Stop()
+{
+    if (!thread_.joinable()) return;
+    stopping_ = true;
+    backend_->Wake();
+    thread_.join();
+}
+
+void FsWatcher::Run()
+{
+    typedef FsChangeCoalescer::Clock Clock;
+    std::vector<FsEvent> events;
+    std::vector<FsChange> batch;
+
+    while (!stopping_)
+    {
+        // Sleep until new events arrive or the next pending path is due
+        int timeoutMs = -1;
+        const Clock::time_point deadline = coalescer_.NextDeadline();
+        if (deadline != Clock::time_point::max())
+        {
+            const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+            timeoutMs = static_cast<int>(std::clamp<long long>(wait + 1, 0, 60 * 1000));
+        }
+
+        events.clear();
+        if (!backend_->Wait(timeoutMs, &events))
+        {
+            std::cerr << "fs_watcher | Watch backend failed, stopping" << std::endl;
+            break;
+        }
+
+        const Clock::time_point now = Clock::now();
+        for (const FsEvent &event : events) coalescer_.Add(event, now);
+
+        batch.clear();
+        coalescer_.Flush(now, &batch);
+        if (!batch.empty()) callback_(std::move(batch));
+    }
+}
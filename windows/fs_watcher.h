@@ -0,0 +1,128 @@
+#ifndef FS_WATCHER_H
+#define FS_WATCHER_H
+
+#include "native_path.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <thread>
+#include <vector>
+
+// Raw notification as reported by the OS backend
+enum class FsEventKind : uint8_t
+{
+    Created,
+    Modified,
+    Removed,
+    Overflow, // the OS dropped events; path is the affected root
+};
+
+struct FsEvent
+{
+    NativePath path;
+    FsEventKind kind;
+    bool is_directory;
+};
+
+// Net effect of all events seen for one path during a debounce window.
+// Values are shared with the C API (FsChangeRecord::kind).
+enum class FsChangeKind : uint8_t
+{
+    Added = 1,
+    Modified = 2,
+    Removed = 3,
+    Rescan = 4, // events were lost below path; rescan it
+};
+
+struct FsChange
+{
+    NativePath path;
+    FsChangeKind kind;
+    bool is_directory;
+};
+
+/**
+ * @brief Folds raw events into one net change per path.
+ *
+ * A path is released once it has been quiet for the quiet period, or once it
+ * has been pending for the max delay so a file that is written continuously
+ * (e.g. by a torrent client) still reports periodically. Only existence before
+ * the first and after the last event matters: create+modify*N becomes Added,
+ * create+delete disappears, delete+create becomes Modified.
+ */
+class FsChangeCoalescer
+{
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    FsChangeCoalescer(Clock::duration quietPeriod, Clock::duration maxDelay);
+
+    void Add(const FsEvent &event, Clock::time_point now);
+
+    // Appends released changes to @p out in path order.
+    void Flush(Clock::time_point now, std::vector<FsChange> *out);
+
+    // Earliest time Flush() can release something; Clock::time_point::max() when idle.
+    Clock::time_point NextDeadline() const;
+
+    size_t PendingCount() const { return pending_.size(); }
+    uint64_t EventCount() const { return eventCount_; }
+
+private:
+    struct Pending
+    {
+        bool existedBefore;
+        bool existsNow;
+        bool isDirectory;
+        bool rescan;
+        Clock::time_point first;
+        Clock::time_point last;
+    };
+
+    Clock::duration quietPeriod_;
+    Clock::duration maxDelay_;
+    std::map<NativePath, Pending> pending_;
+    uint64_t eventCount_ = 0;
+};
+
+class FsWatchBackend;
+
+/**
+ * @brief Watches directory trees and delivers coalesced change batches.
+ *
+ * Backed by inotify on Linux and ReadDirectoryChangesW on Windows. The
+ * callback runs on the watcher's own thread.
+ */
+class FsWatcher
+{
+public:
+    typedef std::function<void(std::vector<FsChange> &&)> BatchCallback;
+
+    FsWatcher(BatchCallback callback, std::chrono::milliseconds debounce);
+    ~FsWatcher();
+
+    FsWatcher(const FsWatcher &) = delete;
+    FsWatcher &operator=(const FsWatcher &) = delete;
+
+    // Must be called before Start(). Returns false if the root cannot be watched.
+    bool AddRoot(const NativePath &root);
+
+    // Starts the watcher thread. Returns false if no root is being watched.
+    bool Start();
+    void Stop();
+
+private:
+    void Run();
+
+    std::unique_ptr<FsWatchBackend> backend_;
+    FsChangeCoalescer coalescer_;
+    BatchCallback callback_;
+    size_t rootCount_ = 0;
+    std::thread thread_;
+    std::atomic<bool> stopping_{false};
+};
+
+#endif // FS_WATCHER_H
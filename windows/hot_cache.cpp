@@ -0,0 +1,231 @@
+#include "hot_cache.h"
+#include "path_arena.h"
+#include "probe_cache.h"
+#include <algorithm>
+
+namespace
+{
+    // Per entry: the list node, its index slot and the thumbnail vector, roughly
+    constexpr uint64_t kEntryOverhead = 160;
+}
+
+HotCache &HotCache::Instance()
+{
+    static HotCache cache(kHotCacheDefaultBudget, kHotCacheDefaultMaxAgeMs);
+    return cache;
+}
+
+HotCache::HotCache(uint64_t budgetBytes, uint32_t maxAgeMs, size_t shards)
+    : shards_(new Shard[std::max<size_t>(shards, 1)]), shardCount_(std::max<size_t>(shards, 1)),
+      shardBudget_(budgetBytes / std::max<size_t>(shards, 1)), maxAgeMs_(maxAgeMs)
+{
+}
+
+HotCache::Entry *HotCache::Touch(Shard &shard, uint32_t pathId, bool create)
+{
+    auto it = shard.index.find(pathId);
+    if (it != shard.index.end())
+    {
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return &*it->second;
+    }
+    if (!create || shardBudget_.load(std::memory_order_relaxed) == 0) return nullptr;
+    shard.lru.push_front(Entry{pathId, HotResult(), Clock::time_point(), {}, kEntryOverhead});
+    shard.index.emplace(pathId, shard.lru.begin());
+    shard.bytes += kEntryOverhead;
+    shard.insertions++;
+    return &shard.lru.front();
+}
+
+void HotCache::Charge(Shard &shard, Entry &entry, uint64_t charge)
+{
+    shard.bytes += charge;
+    shard.bytes -= entry.charge;
+    entry.charge = charge;
+}
+
+void HotCache::Evict(Shard &shard)
+{
+    // The front entry was just used; it stays even when it alone is over the budget
+    const uint64_t budget = shardBudget_.load(std::memory_order_relaxed);
+    while (shard.bytes > budget && shard.lru.size() > 1)
+    {
+        const Entry &victim = shard.lru.back();
+        shard.bytes -= victim.charge;
+        shard.index.erase(victim.pathId);
+        shard.lru.pop_back();
+        shard.evictions++;
+    }
+}
+
+bool HotCache::Find(uint32_t pathId, bool needDuration, HotResult *result)
+{
+    Shard &shard = ShardOf(pathId);
+    const uint32_t maxAgeMs = maxAgeMs_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(pathId);
+    const bool fresh = it != shard.index.end() && it->second->result.has_metadata && (!needDuration || it->second->result.has_duration) &&
+                       (maxAgeMs == 0 || Clock::now() - it->second->stored <= std::chrono::milliseconds(maxAgeMs));
+    if (!fresh)
+    {
+        shard.misses++;
+        return false;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+    *result = it->second->result;
+    shard.hits++;
+    return true;
+}
+
+void HotCache::Put(uint32_t pathId, const HotResult &result)
+{
+    if (!result.has_metadata) return;
+    Shard &shard = ShardOf(pathId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry *entry = Touch(shard, pathId, true);
+    if (entry == nullptr) return;
+    HotResult &cached = entry->result;
+    if (cached.has_metadata && !(cached.metadata.file_size_bytes == result.metadata.file_size_bytes &&
+                                 cached.metadata.modified_time_ms == result.metadata.modified_time_ms))
+    {
+        // The file changed; its thumbnails went stale with it
+        cached = HotResult();
+        entry->thumbnails.clear();
+        Charge(shard, *entry, kEntryOverhead);
+    }
+    cached.metadata = result.metadata;
+    cached.has_metadata = true;
+    if (result.has_duration)
+    {
+        cached.duration_ms = result.duration_ms;
+        cached.has_duration = true;
+    }
+    entry->stored = Clock::now();
+    Evict(shard);
+}
+
+EncodedThumbnail HotCache::FindThumbnail(uint32_t pathId, uint32_t size)
+{
+    Shard &shard = ShardOf(pathId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    Entry *entry = Touch(shard, pathId, false);
+    if (entry != nullptr)
+    {
+        for (const auto &thumbnail : entry->thumbnails)
+        {
+            if (thumbnail.first != size) continue;
+            shard.thumbnailHits++;
+            return thumbnail.second;
+        }
+    }
+    shard.thumbnailMisses++;
+    return nullptr;
+}
+
+void HotCache::PutThumbnail(uint32_t pathId, uint32_t size, EncodedThumbnail bytes)
+{
+    if (!bytes) return;
+    Shard &shard = ShardOf(pathId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // One that would not fit even alone is not worth evicting everything else for
+    if (kEntryOverhead + bytes->size() > shardBudget_.load(std::memory_order_relaxed)) return;
+    Entry *entry = Touch(shard, pathId, true);
+    if (entry == nullptr) return;
+    auto it = std::find_if(entry->thumbnails.begin(), entry->thumbnails.end(), [size](const auto &t) { return t.first == size; });
+    if (it != entry->thumbnails.end()) it->second = std::move(bytes);
+    else entry->thumbnails.emplace_back(size, std::move(bytes));
+
+    uint64_t charge = kEntryOverhead;
+    for (const auto &thumbnail : entry->thumbnails) charge += thumbnail.second->size();
+    Charge(shard, *entry, charge);
+    Evict(shard);
+}
+
+bool HotCache::Invalidate(uint32_t pathId)
+{
+    Shard &shard = ShardOf(pathId);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.index.find(pathId);
+    if (it == shard.index.end()) return false;
+    shard.bytes -= it->second->charge;
+    shard.lru.erase(it->second);
+    shard.index.erase(it);
+    return true;
+}
+
+size_t HotCache::InvalidateUnder(NativePathView directory)
+{
+    PathArena &arena = PathArena::Instance();
+    size_t removed = 0;
+    for (size_t s = 0; s < shardCount_; s++)
+    {
+        Shard &shard = shards_[s];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (auto it = shard.lru.begin(); it != shard.lru.end();)
+        {
+            NativePathView path;
+            if (arena.Get(it->pathId, &path) && PathIsUnder(path, directory))
+            {
+                shard.bytes -= it->charge;
+                shard.index.erase(it->pathId);
+                it = shard.lru.erase(it);
+                removed++;
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    return removed;
+}
+
+void HotCache::Clear()
+{
+    for (size_t s = 0; s < shardCount_; s++)
+    {
+        Shard &shard = shards_[s];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.lru.clear();
+        shard.index.clear();
+        shard.bytes = 0;
+    }
+}
+
+void HotCache::SetLimits(uint64_t budgetBytes, uint32_t maxAgeMs)
+{
+    shardBudget_ = budgetBytes / shardCount_;
+    maxAgeMs_ = maxAgeMs;
+    for (size_t s = 0; s < shardCount_; s++)
+    {
+        Shard &shard = shards_[s];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        if (budgetBytes == 0)
+        {
+            shard.lru.clear();
+            shard.index.clear();
+            shard.bytes = 0;
+        }
+        Evict(shard);
+    }
+}
+
+HotCacheStats HotCache::Stats() const
+{
+    HotCacheStats stats = {};
+    for (size_t s = 0; s < shardCount_; s++)
+    {
+        Shard &shard = shards_[s];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.thumbnail_hits += shard.thumbnailHits;
+        stats.thumbnail_misses += shard.thumbnailMisses;
+        stats.insertions += shard.insertions;
+        stats.evictions += shard.evictions;
+        stats.entries += shard.lru.size();
+        stats.bytes += shard.bytes;
+    }
+    stats.budget_bytes = shardBudget_.load() * shardCount_;
+    return stats;
+}
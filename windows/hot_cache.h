@@ -0,0 +1,109 @@
+#ifndef HOT_CACHE_H
+#define HOT_CACHE_H
+
+#include "native_path.h"
+#include "video_data_exporter_api.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// What a view asks for on every rebuild: the stat and the duration of an item.
+struct HotResult
+{
+    FileMetadata metadata = {};
+    double duration_ms = 0.0;
+    bool has_metadata = false;
+    bool has_duration = false;
+};
+
+typedef std::shared_ptr<const std::vector<uint8_t>> EncodedThumbnail;
+
+constexpr uint64_t kHotCacheDefaultBudget = 32ull << 20;
+constexpr uint32_t kHotCacheDefaultMaxAgeMs = 2000;
+
+/**
+ * @brief Recent results by path ID, answered without touching the filesystem.
+ *
+ * Sits in front of the probe cache, which revalidates every lookup with a
+ * stat: a hot result is served as is for up to max age (0: until
+ * invalidated), and the watcher invalidates changed paths sooner. Encoded
+ * thumbnails are kept with their video's entry, keyed by size, and do not
+ * age.
+ *
+ * Paths are spread over shards by ID; each shard has its own lock, LRU list
+ * and share of the byte budget, so threads asking for different items rarely
+ * meet. An entry is charged its bookkeeping plus its thumbnail bytes.
+ */
+class HotCache
+{
+public:
+    static HotCache &Instance();
+
+    HotCache(uint64_t budgetBytes, uint32_t maxAgeMs, size_t shards = 16);
+
+    HotCache(const HotCache &) = delete;
+    HotCache &operator=(const HotCache &) = delete;
+
+    // A fresh result with metadata and, if @p needDuration, the duration.
+    bool Find(uint32_t pathId, bool needDuration, HotResult *result);
+    // Merges @p result, which carries metadata, into the entry; metadata that differs in
+    // size or mtime drops the duration, which belonged to the old file state.
+    void Put(uint32_t pathId, const HotResult &result);
+
+    EncodedThumbnail FindThumbnail(uint32_t pathId, uint32_t size);
+    void PutThumbnail(uint32_t pathId, uint32_t size, EncodedThumbnail bytes);
+
+    bool Invalidate(uint32_t pathId);
+    // Drops every entry at or below @p directory. Returns the number removed.
+    size_t InvalidateUnder(NativePathView directory);
+    void Clear();
+
+    // A budget of 0 disables the cache and empties it.
+    void SetLimits(uint64_t budgetBytes, uint32_t maxAgeMs);
+    HotCacheStats Stats() const;
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    struct Entry
+    {
+        uint32_t pathId;
+        HotResult result;
+        Clock::time_point stored; // of result
+        std::vector<std::pair<uint32_t, EncodedThumbnail>> thumbnails;
+        uint64_t charge;
+    };
+
+    struct alignas(64) Shard
+    {
+        std::mutex mutex;
+        std::list<Entry> lru; // most recently used first
+        std::unordered_map<uint32_t, std::list<Entry>::iterator> index;
+        uint64_t bytes = 0;
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t thumbnailHits = 0;
+        uint64_t thumbnailMisses = 0;
+        uint64_t insertions = 0;
+        uint64_t evictions = 0;
+    };
+
+    // Scrambled, then scaled into [0, shardCount_), so neighbouring IDs land on different shards
+    Shard &ShardOf(uint32_t pathId) { return shards_[(uint64_t(pathId * 0x9E3779B1u) * shardCount_) >> 32]; }
+    // The entry for @p pathId, moved to the front; created if @p create. Null otherwise.
+    Entry *Touch(Shard &shard, uint32_t pathId, bool create);
+    void Charge(Shard &shard, Entry &entry, uint64_t charge);
+    void Evict(Shard &shard);
+
+    std::unique_ptr<Shard[]> shards_;
+    size_t shardCount_;
+    std::atomic<uint64_t> shardBudget_;
+    std::atomic<uint32_t> maxAgeMs_;
+};
+
+#endif // HOT_CACHE_H
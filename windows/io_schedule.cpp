@@ -0,0 +1,150 @@
+#include "io_schedule.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <map>
+#include <mutex>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <winioctl.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#endif
+#endif
+
+namespace
+{
+    struct Head
+    {
+        uint64_t key = 0;
+        bool physical = false;
+    };
+
+    // Where each device's last planned sweep ended, so the next one continues from there
+    std::mutex headsMutex;
+    std::map<uint64_t, Head> heads;
+
+#ifdef __linux__
+    bool FirstExtent(int fd, uint64_t *physical)
+    {
+        // No FIEMAP_FLAG_SYNC: flushing dirty pages to learn an offset would cost more than the seek it saves
+        alignas(fiemap) uint8_t storage[sizeof(fiemap) + sizeof(fiemap_extent)] = {};
+        fiemap *map = reinterpret_cast<fiemap *>(storage);
+        map->fm_start = 0;
+        map->fm_length = FIEMAP_MAX_OFFSET;
+        map->fm_extent_count = 1;
+        if (ioctl(fd, FS_IOC_FIEMAP, map) != 0 || map->fm_mapped_extents == 0) return false;
+        // Delayed allocation has no address yet; inline and encoded data has none that means anything
+        const uint32_t unplaced = FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_ENCODED;
+        if (map->fm_extents[0].fe_flags & unplaced) return false;
+        *physical = map->fm_extents[0].fe_physical;
+        return true;
+    }
+#endif
+}
+
+bool LocateFile(const PathChar *path, FileLocation *location)
+{
+    *location = FileLocation();
+    if (path == nullptr) return false;
+#ifdef _WIN32
+    // Attribute access only: no sharing conflicts with writers, and no read access needed
+    HANDLE file = CreateFileW(path, FILE_READ_ATTRIBUTES, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                              FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+
+    BY_HANDLE_FILE_INFORMATION info;
+    if (!GetFileInformationByHandle(file, &info))
+    {
+        CloseHandle(file);
+        return false;
+    }
+    location->device = info.dwVolumeSerialNumber;
+    location->inode = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+
+    STARTING_VCN_INPUT_BUFFER start = {};
+    RETRIEVAL_POINTERS_BUFFER pointers = {};
+    DWORD returned = 0;
+    // One extent is all the ordering needs; ERROR_MORE_DATA still fills it
+    if ((DeviceIoControl(file, FSCTL_GET_RETRIEVAL_POINTERS, &start, sizeof(start), &pointers, sizeof(pointers), &returned, nullptr) ||
+         GetLastError() == ERROR_MORE_DATA) &&
+        pointers.ExtentCount > 0 && pointers.Extents[0].Lcn.QuadPart >= 0) // -1 marks a sparse or compressed run
+    {
+        location->physical = static_cast<uint64_t>(pointers.Extents[0].Lcn.QuadPart);
+        location->has_physical = true;
+    }
+    CloseHandle(file);
+    return true;
+#else
+    const int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+    {
+        close(fd);
+        return false;
+    }
+    location->device = static_cast<uint64_t>(st.st_dev);
+    location->inode = static_cast<uint64_t>(st.st_ino);
+#ifdef __linux__
+    location->has_physical = FirstExtent(fd, &location->physical);
+#endif
+    close(fd);
+    return true;
+#endif
+}
+
+std::vector<DeviceQueue> PlanDeviceQueues(const std::vector<const PathChar *> &paths)
+{
+    std::vector<FileLocation> locations(paths.size());
+    std::vector<uint8_t> located(paths.size(), 0);
+    WorkerPool::Instance().ParallelFor(paths.size(), [&](size_t i) { located[i] = LocateFile(paths[i], &locations[i]); });
+
+    std::vector<DeviceQueue> queues;
+    DeviceQueue unlocated;
+    std::map<uint64_t, size_t> byDevice; // device -> index in queues
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        if (!located[i])
+        {
+            unlocated.order.push_back(i);
+            continue;
+        }
+        auto inserted = byDevice.emplace(locations[i].device, queues.size());
+        if (inserted.second)
+        {
+            queues.emplace_back();
+            queues.back().device = locations[i].device;
+            queues.back().physical = true;
+        }
+        DeviceQueue &queue = queues[inserted.first->second];
+        queue.order.push_back(i);
+        queue.physical = queue.physical && locations[i].has_physical;
+    }
+
+    std::lock_guard<std::mutex> lock(headsMutex);
+    for (DeviceQueue &queue : queues)
+    {
+        auto key = [&](size_t i) { return queue.physical ? locations[i].physical : locations[i].inode; };
+        std::sort(queue.order.begin(), queue.order.end(), [&](size_t a, size_t b) { return key(a) != key(b) ? key(a) < key(b) : a < b; });
+
+        // SCAN: up from the head, then back down over what lies below it
+        Head &head = heads[queue.device];
+        if (head.physical == queue.physical)
+        {
+            auto split = std::partition_point(queue.order.begin(), queue.order.end(), [&](size_t i) { return key(i) < head.key; });
+            std::reverse(queue.order.begin(), split);
+            std::rotate(queue.order.begin(), split, queue.order.end());
+        }
+        head.key = key(queue.order.back());
+        head.physical = queue.physical;
+    }
+    if (!unlocated.order.empty()) queues.push_back(std::move(unlocated));
+    return queues;
+}
@@ -0,0 +1,40 @@
+#ifndef IO_SCHEDULE_H
+#define IO_SCHEDULE_H
+
+#include "native_path.h"
+#include <cstdint>
+#include <vector>
+
+// Where a file sits: its device (volume serial number on Windows) and a sort key within it.
+struct FileLocation
+{
+    uint64_t device = 0;
+    uint64_t inode = 0;    // file index on Windows
+    uint64_t physical = 0; // byte offset (cluster number on Windows) of the first extent
+    bool has_physical = false;
+};
+
+// FIEMAP on Linux, FSCTL_GET_RETRIEVAL_POINTERS on Windows; inode only elsewhere, for
+// files without allocated extents, and on file systems that keep extents to themselves.
+bool LocateFile(const PathChar *path, FileLocation *location);
+
+struct DeviceQueue
+{
+    uint64_t device = 0;
+    bool physical = false;     // ordered by first extent; by inode number otherwise
+    std::vector<size_t> order; // indices into the planned paths, in service order
+};
+
+/**
+ * @brief Groups @p paths by device and orders each group as one elevator sweep.
+ *
+ * A queue is ordered by physical offset when every file in it reported one,
+ * and by inode number otherwise; on most file systems inodes allocated
+ * together have their data allocated together too. The sweep starts where the
+ * previous plan for that device left the head, runs upwards, then takes the
+ * files below it on the way back down. Files that cannot be located go last,
+ * into a queue of their own for device 0.
+ */
+std::vector<DeviceQueue> PlanDeviceQueues(const std::vector<const PathChar *> &paths);
+
+#endif // IO_SCHEDULE_H
@@ -0,0 +1,270 @@
+#include "keyframe_index.h"
+#include "container_layout.h"
+#include "container_parse.h"
+#include "content_sniffer.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+    // Without Cues: clusters visited before giving up on the rest of the file
+    constexpr uint32_t kMaxScannedClusters = 20000;
+    constexpr uint32_t kMaxClusterChildren = 16;
+
+    void PutVarint(std::vector<uint8_t> &out, int64_t value)
+    {
+        uint64_t zigzag = (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+        while (zigzag >= 0x80)
+        {
+            out.push_back(static_cast<uint8_t>(zigzag) | 0x80);
+            zigzag >>= 7;
+        }
+        out.push_back(static_cast<uint8_t>(zigzag));
+    }
+
+    int64_t GetVarint(const uint8_t *&p)
+    {
+        uint64_t zigzag = 0;
+        for (int shift = 0;; shift += 7)
+        {
+            const uint8_t byte = *p++;
+            zigzag |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) break;
+        }
+        return static_cast<int64_t>(zigzag >> 1) ^ -static_cast<int64_t>(zigzag & 1);
+    }
+
+    inline int64_t ToMs(double ticks, double ticksPerSecond) { return std::llround(ticks * 1000.0 / ticksPerSecond); }
+
+    // === ISO-BMFF ===
+
+    bool IndexSampleTable(const uint8_t *stbl, size_t length, uint32_t timescale, KeyframeIndex *index)
+    {
+        const uint8_t *stts = nullptr, *stss = nullptr, *stsc = nullptr, *stsz = nullptr, *stco = nullptr;
+        size_t sttsLength = 0, stssLength = 0, stscLength = 0, stszLength = 0, stcoLength = 0;
+        FindBox(stbl, length, "stts", &stts, &sttsLength);
+        const bool hasStss = FindBox(stbl, length, "stss", &stss, &stssLength);
+        FindBox(stbl, length, "stsc", &stsc, &stscLength);
+        FindBox(stbl, length, "stsz", &stsz, &stszLength);
+        const bool co64 = !FindBox(stbl, length, "stco", &stco, &stcoLength) && FindBox(stbl, length, "co64", &stco, &stcoLength);
+
+        uint32_t sttsCount, stssCount = 0, stscCount, chunkCount;
+        if (!EntryTable(stts, sttsLength, 8, 8, &sttsCount) || !EntryTable(stsc, stscLength, 8, 12, &stscCount) ||
+            !EntryTable(stco, stcoLength, 8, co64 ? 8 : 4, &chunkCount) || stszLength < 12)
+            return false;
+        if (hasStss && !EntryTable(stss, stssLength, 8, 4, &stssCount)) return false;
+
+        const uint32_t fixedSize = ReadBe32(stsz + 4);
+        const uint32_t sampleCount = ReadBe32(stsz + 8);
+        if (fixedSize == 0 && (stszLength - 12) / 4 < sampleCount) return false;
+
+        uint32_t sample = 0, sttsIndex = 0, stssIndex = 0, stscIndex = 0;
+        uint32_t sttsLeft = sttsCount > 0 ? ReadBe32(stts + 8) : 0;
+        uint64_t decodeTime = 0;
+        for (uint32_t chunk = 1; chunk <= chunkCount && sample < sampleCount; chunk++)
+        {
+            while (stscIndex + 1 < stscCount && ReadBe32(stsc + 8 + 12 * (stscIndex + 1)) <= chunk) stscIndex++;
+            const uint32_t samplesPerChunk = stscCount > 0 ? ReadBe32(stsc + 8 + 12 * stscIndex + 4) : 0;
+            uint64_t offset = co64 ? ReadBe64(stco + 8 + 8 * (chunk - 1)) : ReadBe32(stco + 8 + 4 * (chunk - 1));
+
+            for (uint32_t k = 0; k < samplesPerChunk && sample < sampleCount; k++, sample++)
+            {
+                // stss lists 1-based sample numbers in ascending order; no stss means every sample is a sync sample
+                while (hasStss && stssIndex < stssCount && ReadBe32(stss + 8 + 4 * stssIndex) < sample + 1) stssIndex++;
+                const bool sync = !hasStss || (stssIndex < stssCount && ReadBe32(stss + 8 + 4 * stssIndex) == sample + 1);
+                if (sync) index->Append(ToMs(static_cast<double>(decodeTime), timescale), offset);
+
+                offset += fixedSize != 0 ? fixedSize : ReadBe32(stsz + 12 + 4 * sample);
+                while (sttsLeft == 0 && sttsIndex + 1 < sttsCount) sttsLeft = ReadBe32(stts + 8 + 8 * ++sttsIndex);
+                if (sttsLeft > 0)
+                {
+                    decodeTime += ReadBe32(stts + 8 + 8 * sttsIndex + 4);
+                    sttsLeft--;
+                }
+            }
+        }
+        return index->Count() > 0;
+    }
+
+    bool BuildIsoBmff(ByteSource &source, KeyframeIndex *index)
+    {
+        ScratchBytes moov;
+        if (!ReadMoovBox(source, &moov)) return false;
+        return ForEachMediaTrack(moov.data(), moov.size(), [index](const MediaTrack &track) {
+            return std::memcmp(track.handler, "vide", 4) == 0 && IndexSampleTable(track.stbl, track.stblLength, track.timescale, index);
+        });
+    }
+
+    // === Matroska ===
+
+    void IndexCues(const ScratchBytes &cues, uint64_t segmentStart, double ticksPerSecond, uint64_t videoTrack,
+                   KeyframeIndex *index)
+    {
+        ForEachChild(cues.data(), cues.size(), [&](uint64_t id, const uint8_t *point, size_t length) {
+            if (id != kMkvCuePoint) return;
+            uint64_t time = 0, position = 0;
+            bool found = false;
+            ForEachChild(point, length, [&](uint64_t child, const uint8_t *value, size_t size) {
+                if (child == kMkvCueTime) time = ReadBeUInt(value, size);
+                if (child != kMkvCueTrackPositions || found) return;
+                uint64_t track = 0, cluster = 0;
+                bool hasCluster = false;
+                ForEachChild(value, size, [&](uint64_t field, const uint8_t *v, size_t n) {
+                    if (field == kMkvCueTrack) track = ReadBeUInt(v, n);
+                    if (field == kMkvCueClusterPosition)
+                    {
+                        cluster = ReadBeUInt(v, n);
+                        hasCluster = true;
+                    }
+                });
+                if (hasCluster && (videoTrack == 0 || track == videoTrack))
+                {
+                    position = cluster;
+                    found = true;
+                }
+            });
+            if (found) index->Append(ToMs(static_cast<double>(time), ticksPerSecond), segmentStart + position);
+        });
+    }
+
+    // Walks cluster headers only: the cluster timestamp and the first video block decide
+    void ScanClusters(ByteSource &source, uint64_t pos, uint64_t end, double ticksPerSecond, uint64_t videoTrack, KeyframeIndex *index)
+    {
+        for (uint32_t clusters = 0; clusters < kMaxScannedClusters && pos < end;)
+        {
+            EbmlElement cluster;
+            if (!ReadElementAt(source, pos, &cluster) || cluster.unknownSize) return;
+            const uint64_t clusterEnd = cluster.payload + cluster.size;
+            if (cluster.id != kMkvCluster)
+            {
+                pos = clusterEnd; // Cues, Tags, Void between clusters
+                continue;
+            }
+            clusters++;
+
+            uint64_t timestamp = 0;
+            bool decided = false, keyframe = false;
+            int16_t relative = 0;
+            uint64_t child = cluster.payload;
+            for (uint32_t i = 0; i < kMaxClusterChildren && !decided && child < clusterEnd; i++)
+            {
+                EbmlElement element;
+                if (!ReadElementAt(source, child, &element) || element.unknownSize) break;
+                uint64_t track;
+                uint8_t flags;
+                if (element.id == kMkvClusterTimestamp && element.size <= 8)
+                {
+                    uint8_t value[8];
+                    timestamp = ReadBeUInt(value, source.ReadAt(element.payload, value, static_cast<size_t>(element.size)));
+                }
+                else if (element.id == kMkvSimpleBlock && ReadBlockHeader(source, element.payload, &track, &relative, &flags))
+                {
+                    decided = videoTrack == 0 || track == videoTrack;
+                    keyframe = (flags & 0x80) != 0;
+                }
+                else if (element.id == kMkvBlockGroup)
+                {
+                    // A Block is a keyframe unless its group references another block
+                    bool isVideo = false, referenced = false;
+                    const uint64_t groupEnd = element.payload + element.size;
+                    EbmlElement part;
+                    for (uint64_t at = element.payload; at < groupEnd && ReadElementAt(source, at, &part) && !part.unknownSize;
+                         at = part.payload + part.size)
+                    {
+                        if (part.id == kMkvBlock && ReadBlockHeader(source, part.payload, &track, &relative, &flags))
+                            isVideo = videoTrack == 0 || track == videoTrack;
+                        if (part.id == kMkvReferenceBlock) referenced = true;
+                    }
+                    decided = isVideo;
+                    keyframe = !referenced;
+                }
+                child = element.payload + element.size;
+            }
+            if (decided && keyframe)
+                index->Append(ToMs(static_cast<double>(static_cast<int64_t>(timestamp) + relative), ticksPerSecond), pos);
+            pos = clusterEnd;
+        }
+    }
+
+    bool BuildMatroska(ByteSource &source, KeyframeIndex *index)
+    {
+        MatroskaLayout layout;
+        if (!ReadMatroskaLayout(source, &layout)) return false;
+
+        EbmlElement element;
+        ScratchBytes cues;
+        if (layout.cuesAt != 0 && ReadElementAt(source, layout.cuesAt, &element) && element.id == kMkvCues &&
+            ReadElementPayload(source, element, kMaxMkvCuesBytes, &cues))
+        {
+            IndexCues(cues, layout.segmentStart, layout.ticksPerSecond, layout.videoTrack, index);
+            if (index->Count() > 0) return true;
+        }
+
+        if (layout.firstCluster != 0)
+            ScanClusters(source, layout.firstCluster, layout.segmentEnd, layout.ticksPerSecond, layout.videoTrack, index);
+        return index->Count() > 0;
+    }
+}
+
+void KeyframeIndex::Append(int64_t timeMs, uint64_t offset)
+{
+    PutVarint(times_, timeMs - lastTime_);
+    PutVarint(offsets_, static_cast<int64_t>(offset) - lastOffset_);
+    lastTime_ = timeMs;
+    lastOffset_ = static_cast<int64_t>(offset);
+    count_++;
+}
+
+void KeyframeIndex::Decode(std::vector<int64_t> *timesMs, std::vector<uint64_t> *offsets) const
+{
+    timesMs->resize(count_);
+    offsets->resize(count_);
+    const uint8_t *t = times_.data();
+    const uint8_t *o = offsets_.data();
+    int64_t time = 0, offset = 0;
+    for (uint32_t i = 0; i < count_; i++)
+    {
+        time += GetVarint(t);
+        offset += GetVarint(o);
+        (*timesMs)[i] = time;
+        (*offsets)[i] = static_cast<uint64_t>(offset);
+    }
+}
+
+// Linear: the deltas have to be summed anyway, and an index is a few thousand entries
+bool KeyframeIndex::Find(int64_t timeMs, int64_t *keyTimeMs, uint64_t *offset) const
+{
+    if (count_ == 0) return false;
+    const uint8_t *t = times_.data();
+    const uint8_t *o = offsets_.data();
+    int64_t time = GetVarint(t), position = GetVarint(o);
+    *keyTimeMs = time;
+    *offset = static_cast<uint64_t>(position);
+    for (uint32_t i = 1; i < count_; i++)
+    {
+        time += GetVarint(t);
+        position += GetVarint(o);
+        if (time > timeMs) break;
+        *keyTimeMs = time;
+        *offset = static_cast<uint64_t>(position);
+    }
+    return true;
+}
+
+bool BuildKeyframeIndex(ByteSource &source, KeyframeIndex *index)
+{
+    ScratchArena::Scope scratch; // moov, Cues and header element payloads
+    uint8_t head[kSniffHeadBytes];
+    switch (SniffBuffer(head, source.ReadAt(0, head, sizeof(head)), nullptr, 0))
+    {
+    case ContainerKind::IsoBmff:
+    case ContainerKind::QuickTime:
+        return BuildIsoBmff(source, index);
+    case ContainerKind::Matroska:
+    case ContainerKind::WebM:
+        return BuildMatroska(source, index);
+    default:
+        return false;
+    }
+}
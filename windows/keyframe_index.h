@@ -0,0 +1,48 @@
+#ifndef KEYFRAME_INDEX_H
+#define KEYFRAME_INDEX_H
+
+#include "byte_source.h"
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Keyframe timestamps and the byte offsets to seek to for them.
+ *
+ * Entries are stored as zigzag LEB128 deltas, so a two-hour film with a
+ * keyframe every two seconds takes a few tens of kilobytes.
+ */
+class KeyframeIndex
+{
+public:
+    // Entries should arrive in presentation order; small reorderings are tolerated.
+    void Append(int64_t timeMs, uint64_t offset);
+
+    size_t Count() const { return count_; }
+    size_t EncodedBytes() const { return times_.size() + offsets_.size(); }
+
+    void Decode(std::vector<int64_t> *timesMs, std::vector<uint64_t> *offsets) const;
+
+    // Last keyframe at or before timeMs (or the first one); false if the index is empty.
+    bool Find(int64_t timeMs, int64_t *keyTimeMs, uint64_t *offset) const;
+
+private:
+    std::vector<uint8_t> times_;
+    std::vector<uint8_t> offsets_;
+    int64_t lastTime_ = 0;
+    int64_t lastOffset_ = 0;
+    uint32_t count_ = 0;
+};
+
+/**
+ * @brief Builds the keyframe index of the first video track.
+ *
+ * MP4/MOV: sample tables (stss, stts, stsc, stsz, stco/co64) of the moov box.
+ * Matroska/WebM: the Cues element, or a bounded walk over cluster headers when
+ * a file has no Cues. Edit lists are not applied.
+ *
+ * @return false if the container is not supported or holds no video keyframes
+ */
+bool BuildKeyframeIndex(ByteSource &source, KeyframeIndex *index);
+
+#endif // KEYFRAME_INDEX_H
@@ -0,0 +1,350 @@
+#include "library_snapshot.h"
+#include "utf_transcode.h"
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace
+{
+    constexpr char kMagic[8] = {'V', 'D', 'U', 'S', 'N', 'A', 'P', '\0'};
+    constexpr uint32_t kVersion = 1;
+    constexpr uint32_t kByteOrderMark = 0x01020304; // reads differently on a host of the other endianness
+    constexpr uint64_t kColumnAlignment = 64;
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t byte_order;
+        uint64_t row_count;
+        uint32_t column_count;
+        uint32_t reserved;
+        uint64_t reserved2[4];
+    };
+    static_assert(sizeof(FileHeader) == 64, "snapshot header layout");
+
+    struct ColumnEntry
+    {
+        uint32_t id;
+        uint32_t element_size;
+        uint64_t offset; // from the start of the file
+        uint64_t count;  // elements
+        uint64_t reserved;
+    };
+    static_assert(sizeof(ColumnEntry) == 32, "snapshot column layout");
+
+    uint32_t ElementSize(SnapshotColumn id)
+    {
+        switch (id)
+        {
+        case SnapshotColumn::PathBytes:
+        case SnapshotColumn::Flags:
+        case SnapshotColumn::Container:
+            return 1;
+        case SnapshotColumn::BySize:
+        case SnapshotColumn::ByDuration:
+        case SnapshotColumn::KeyframeCount:
+            return 4;
+        default:
+            return 8;
+        }
+    }
+
+    uint64_t AlignUp(uint64_t value)
+    {
+        return (value + kColumnAlignment - 1) & ~(kColumnAlignment - 1);
+    }
+
+    struct PendingColumn
+    {
+        SnapshotColumn id;
+        const void *data;
+        uint64_t count;
+    };
+
+    template <typename T>
+    void AddColumn(std::vector<PendingColumn> &columns, SnapshotColumn id, const std::vector<T> &values)
+    {
+        columns.push_back({id, values.data(), values.size()});
+    }
+
+    // Row numbers of the rows that have @p flag, ordered by key (ties keep row order).
+    template <typename Key>
+    std::vector<uint32_t> SortedRows(const std::vector<SnapshotRow> &rows, uint8_t flag, Key key)
+    {
+        std::vector<uint32_t> order;
+        for (uint32_t row = 0; row < rows.size(); row++)
+            if (rows[row].flags & flag) order.push_back(row);
+        std::stable_sort(order.begin(), order.end(), [&](uint32_t a, uint32_t b) { return key(rows[a]) < key(rows[b]); });
+        return order;
+    }
+
+    double IndexedValue(SnapshotColumn index, const uint8_t *values, uint32_t row)
+    {
+        if (index == SnapshotColumn::BySize)
+        {
+            int64_t size;
+            std::memcpy(&size, values + size_t(row) * 8, 8);
+            return static_cast<double>(size);
+        }
+        double duration;
+        std::memcpy(&duration, values + size_t(row) * 8, 8);
+        return duration;
+    }
+
+    // Wide stderr on Windows only: a wide write elsewhere would orient stderr and silence every later narrow one
+    void LogPathError(const char *message, const std::filesystem::path &path, const std::string &detail = std::string())
+    {
+#ifdef _WIN32
+        std::wcerr << L"library_snapshot | " << message << L" " << path.native();
+        if (!detail.empty()) std::wcerr << L": " << detail.c_str();
+        std::wcerr << std::endl;
+#else
+        std::cerr << "library_snapshot | " << message << " " << NativePathToUtf8(path.native());
+        if (!detail.empty()) std::cerr << ": " << detail;
+        std::cerr << std::endl;
+#endif
+    }
+}
+
+bool WriteLibrarySnapshot(const PathChar *output, const std::vector<SnapshotRow> &rows, bool streamColumns)
+{
+    if (output == nullptr || output[0] == 0 || rows.size() >= UINT32_MAX) return false;
+
+    const size_t count = rows.size();
+    std::vector<uint64_t> pathOffsets(count + 1, 0);
+    std::string pathBytes;
+    std::vector<int64_t> sizes(count), created(count), accessed(count), modified(count);
+    std::vector<double> durations(count);
+    std::vector<uint64_t> hashes(count);
+    std::vector<uint8_t> flags(count), containers;
+    std::vector<uint32_t> keyframes;
+    for (size_t row = 0; row < count; row++)
+    {
+        const SnapshotRow &r = rows[row];
+        pathBytes += r.utf8_path;
+        pathOffsets[row + 1] = pathBytes.size();
+        sizes[row] = r.metadata.file_size_bytes;
+        created[row] = r.metadata.creation_time_ms;
+        accessed[row] = r.metadata.access_time_ms;
+        modified[row] = r.metadata.modified_time_ms;
+        durations[row] = (r.flags & kSnapshotHasDuration) ? r.duration_ms : 0.0;
+        hashes[row] = (r.flags & kSnapshotHasHash) ? r.thumbnail_hash : 0;
+        flags[row] = r.flags;
+    }
+    const std::vector<uint32_t> bySize = SortedRows(rows, kSnapshotHasMetadata, [](const SnapshotRow &r) { return r.metadata.file_size_bytes; });
+    const std::vector<uint32_t> byDuration = SortedRows(rows, kSnapshotHasDuration, [](const SnapshotRow &r) { return r.duration_ms; });
+
+    std::vector<PendingColumn> columns;
+    AddColumn(columns, SnapshotColumn::PathOffsets, pathOffsets);
+    columns.push_back({SnapshotColumn::PathBytes, pathBytes.data(), pathBytes.size()});
+    AddColumn(columns, SnapshotColumn::SizeBytes, sizes);
+    AddColumn(columns, SnapshotColumn::CreatedMs, created);
+    AddColumn(columns, SnapshotColumn::AccessedMs, accessed);
+    AddColumn(columns, SnapshotColumn::ModifiedMs, modified);
+    AddColumn(columns, SnapshotColumn::DurationMs, durations);
+    AddColumn(columns, SnapshotColumn::ThumbnailHash, hashes);
+    AddColumn(columns, SnapshotColumn::Flags, flags);
+    AddColumn(columns, SnapshotColumn::BySize, bySize);
+    AddColumn(columns, SnapshotColumn::ByDuration, byDuration);
+    if (streamColumns)
+    {
+        containers.resize(count);
+        keyframes.resize(count);
+        for (size_t row = 0; row < count; row++)
+        {
+            containers[row] = static_cast<uint8_t>(rows[row].container);
+            keyframes[row] = rows[row].keyframe_count;
+        }
+        AddColumn(columns, SnapshotColumn::Container, containers);
+        AddColumn(columns, SnapshotColumn::KeyframeCount, keyframes);
+    }
+
+    FileHeader header = {};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kVersion;
+    header.byte_order = kByteOrderMark;
+    header.row_count = count;
+    header.column_count = static_cast<uint32_t>(columns.size());
+
+    std::vector<ColumnEntry> directory;
+    uint64_t offset = AlignUp(sizeof(FileHeader) + columns.size() * sizeof(ColumnEntry));
+    for (const PendingColumn &column : columns)
+    {
+        const uint32_t elementSize = ElementSize(column.id);
+        directory.push_back({static_cast<uint32_t>(column.id), elementSize, offset, column.count, 0});
+        offset = AlignUp(offset + column.count * elementSize);
+    }
+
+    const std::filesystem::path target(output);
+    std::filesystem::path temporary = target;
+    temporary += PATH_LITERAL(".tmp");
+    {
+        std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+        if (!file)
+        {
+            LogPathError("Cannot create", temporary);
+            return false;
+        }
+        static const char padding[kColumnAlignment] = {};
+        uint64_t written = 0;
+        auto write = [&](const void *data, uint64_t length) {
+            file.write(static_cast<const char *>(data), static_cast<std::streamsize>(length));
+            written += length;
+        };
+        write(&header, sizeof(header));
+        write(directory.data(), directory.size() * sizeof(ColumnEntry));
+        for (size_t i = 0; i < columns.size(); i++)
+        {
+            write(padding, directory[i].offset - written);
+            write(columns[i].data, columns[i].count * directory[i].element_size);
+        }
+        write(padding, offset - written);
+        file.flush();
+        if (!file)
+        {
+            LogPathError("Failed writing", temporary);
+            file.close();
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            return false;
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temporary, target, error);
+    if (error)
+    {
+        LogPathError("Cannot replace", target, error.message());
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+std::unique_ptr<LibrarySnapshot> LibrarySnapshot::Open(const PathChar *path)
+{
+    std::unique_ptr<LibrarySnapshot> snapshot(new LibrarySnapshot());
+    snapshot->source_ = OpenMappedSource(path, AccessPattern::Random);
+    if (snapshot->source_ == nullptr) return nullptr;
+    snapshot->size_ = snapshot->source_->Size();
+    snapshot->base_ = snapshot->source_->View(0, static_cast<size_t>(snapshot->size_));
+    if (!snapshot->Validate()) return nullptr;
+    return snapshot;
+}
+
+bool LibrarySnapshot::Validate()
+{
+    if (base_ == nullptr || size_ < sizeof(FileHeader)) return false;
+    FileHeader header;
+    std::memcpy(&header, base_, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kVersion || header.byte_order != kByteOrderMark)
+        return false;
+    if (header.row_count >= UINT32_MAX || header.column_count > (size_ - sizeof(FileHeader)) / sizeof(ColumnEntry)) return false;
+    rowCount_ = header.row_count;
+
+    for (uint32_t i = 0; i < header.column_count; i++)
+    {
+        ColumnEntry entry;
+        std::memcpy(&entry, base_ + sizeof(FileHeader) + size_t(i) * sizeof(ColumnEntry), sizeof(entry));
+        const SnapshotColumn id = static_cast<SnapshotColumn>(entry.id);
+        if (entry.element_size != ElementSize(id) || entry.offset % entry.element_size != 0 || entry.offset > size_ ||
+            entry.count > (size_ - entry.offset) / entry.element_size)
+            return false;
+        columns_.push_back({id, {base_ + entry.offset, entry.count}});
+    }
+
+    // Fixed-width columns hold one value per row; absent optional columns are fine
+    const ColumnView *offsets = Find(SnapshotColumn::PathOffsets);
+    const ColumnView *bytes = Find(SnapshotColumn::PathBytes);
+    if (offsets == nullptr || bytes == nullptr || offsets->count != rowCount_ + 1) return false;
+    for (const auto &column : columns_)
+    {
+        switch (column.first)
+        {
+        case SnapshotColumn::SizeBytes:
+        case SnapshotColumn::CreatedMs:
+        case SnapshotColumn::AccessedMs:
+        case SnapshotColumn::ModifiedMs:
+        case SnapshotColumn::DurationMs:
+        case SnapshotColumn::ThumbnailHash:
+        case SnapshotColumn::Flags:
+        case SnapshotColumn::Container:
+        case SnapshotColumn::KeyframeCount:
+            if (column.second.count != rowCount_) return false;
+            break;
+        default:
+            break;
+        }
+    }
+    for (SnapshotColumn required : {SnapshotColumn::SizeBytes, SnapshotColumn::DurationMs, SnapshotColumn::Flags})
+        if (Find(required) == nullptr) return false;
+
+    uint64_t previous = 0;
+    for (uint64_t row = 0; row <= rowCount_; row++)
+    {
+        uint64_t offset;
+        std::memcpy(&offset, offsets->data + row * 8, 8);
+        if (offset < previous || offset > bytes->count) return false;
+        previous = offset;
+    }
+
+    // Indices must be in range and sorted, since IndexRange binary-searches them
+    for (SnapshotColumn index : {SnapshotColumn::BySize, SnapshotColumn::ByDuration})
+    {
+        const ColumnView *rows = Find(index);
+        if (rows == nullptr) return false;
+        const uint8_t *values = Find(index == SnapshotColumn::BySize ? SnapshotColumn::SizeBytes : SnapshotColumn::DurationMs)->data;
+        double last = 0.0;
+        for (uint64_t i = 0; i < rows->count; i++)
+        {
+            uint32_t row;
+            std::memcpy(&row, rows->data + i * 4, 4);
+            if (row >= rowCount_) return false;
+            const double value = IndexedValue(index, values, row);
+            if (i > 0 && !(value >= last)) return false;
+            last = value;
+        }
+    }
+    return true;
+}
+
+const LibrarySnapshot::ColumnView *LibrarySnapshot::Find(SnapshotColumn id) const
+{
+    for (const auto &column : columns_)
+        if (column.first == id) return &column.second;
+    return nullptr;
+}
+
+const void *LibrarySnapshot::Column(SnapshotColumn id, uint64_t *count) const
+{
+    const ColumnView *column = Find(id);
+    if (count != nullptr) *count = column != nullptr ? column->count : 0;
+    return column != nullptr ? column->data : nullptr;
+}
+
+std::string_view LibrarySnapshot::Path(uint64_t row) const
+{
+    if (row >= rowCount_) return {};
+    const uint64_t *offsets = static_cast<const uint64_t *>(Column(SnapshotColumn::PathOffsets, nullptr));
+    const char *bytes = static_cast<const char *>(Column(SnapshotColumn::PathBytes, nullptr));
+    return std::string_view(bytes + offsets[row], static_cast<size_t>(offsets[row + 1] - offsets[row]));
+}
+
+uint64_t LibrarySnapshot::IndexRange(SnapshotColumn index, double minValue, double maxValue, uint64_t *first) const
+{
+    if (first != nullptr) *first = 0;
+    if (index != SnapshotColumn::BySize && index != SnapshotColumn::ByDuration) return 0;
+    const ColumnView *rows = Find(index);
+    const uint8_t *values = Find(index == SnapshotColumn::BySize ? SnapshotColumn::SizeBytes : SnapshotColumn::DurationMs)->data;
+    const uint32_t *begin = reinterpret_cast<const uint32_t *>(rows->data);
+    const uint32_t *end = begin + rows->count;
+
+    const uint32_t *low = std::partition_point(begin, end, [&](uint32_t row) { return IndexedValue(index, values, row) < minValue; });
+    const uint32_t *high = std::partition_point(low, end, [&](uint32_t row) { return IndexedValue(index, values, row) <= maxValue; });
+    if (first != nullptr) *first = static_cast<uint64_t>(low - begin);
+    return static_cast<uint64_t>(high - low);
+}
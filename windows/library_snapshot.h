@@ -0,0 +1,109 @@
+#ifndef LIBRARY_SNAPSHOT_H
+#define LIBRARY_SNAPSHOT_H
+
+#include "byte_source.h"
+#include "content_sniffer.h"
+#include "native_path.h"
+#include "video_data_exporter_api.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Column IDs of the snapshot format; shared with the C API (snapshot_column).
+enum class SnapshotColumn : uint32_t
+{
+    PathOffsets = 1,   // uint64 x (rows + 1): path i is PathBytes[offsets[i], offsets[i + 1])
+    PathBytes = 2,     // uint8: UTF-8, not NUL-terminated
+    SizeBytes = 3,     // int64
+    CreatedMs = 4,     // int64, ms since Unix epoch
+    AccessedMs = 5,    // int64
+    ModifiedMs = 6,    // int64
+    DurationMs = 7,    // float64, 0 where unknown
+    ThumbnailHash = 8, // uint64 pHash, 0 where unknown
+    Flags = 9,         // uint8, SnapshotRowFlags
+    BySize = 10,       // uint32 row numbers of rows with metadata, ascending size
+    ByDuration = 11,   // uint32 row numbers of rows with a duration, ascending duration
+
+    // Stream columns, written on request
+    Container = 32,     // uint8 ContainerKind
+    KeyframeCount = 33, // uint32, 0 where no index was built
+};
+
+enum SnapshotRowFlags : uint8_t
+{
+    kSnapshotHasMetadata = 1 << 0,
+    kSnapshotHasDuration = 1 << 1,
+    kSnapshotHasHash = 1 << 2,
+};
+
+// One scanned file as the writer receives it.
+struct SnapshotRow
+{
+    std::string utf8_path;
+    FileMetadata metadata = {};
+    double duration_ms = 0.0;
+    uint64_t thumbnail_hash = 0;
+    uint8_t flags = 0;
+    ContainerKind container = ContainerKind::Unknown;
+    uint32_t keyframe_count = 0;
+};
+
+/**
+ * @brief Writes a scan result as a columnar snapshot file.
+ *
+ * The file is a fixed header, a directory of columns and the columns
+ * themselves, each 64-byte aligned, in host byte order (little-endian on every
+ * supported platform) so a memory map of it can be read as typed arrays. The
+ * BySize and ByDuration columns are sorted row numbers for range queries.
+ *
+ * The file is written next to @p output and renamed over it, so readers that
+ * have the previous snapshot mapped keep a consistent view.
+ *
+ * @param streamColumns Also writes the Container and KeyframeCount columns
+ */
+bool WriteLibrarySnapshot(const PathChar *output, const std::vector<SnapshotRow> &rows, bool streamColumns);
+
+/**
+ * @brief A snapshot file mapped read-only.
+ *
+ * Every column is bounds-checked when the file is opened, including the path
+ * offsets and the row numbers in the sorted indices, so pointers handed out
+ * afterwards can be read without further checks. They stay valid until the
+ * snapshot is destroyed.
+ */
+class LibrarySnapshot
+{
+public:
+    static std::unique_ptr<LibrarySnapshot> Open(const PathChar *path);
+
+    uint64_t RowCount() const { return rowCount_; }
+
+    // Start of a column and its element count, or nullptr if the file has no such column.
+    const void *Column(SnapshotColumn id, uint64_t *count) const;
+
+    std::string_view Path(uint64_t row) const;
+
+    // Positions [first, first + count) of @p index (BySize or ByDuration) whose value lies in [minValue, maxValue].
+    uint64_t IndexRange(SnapshotColumn index, double minValue, double maxValue, uint64_t *first) const;
+
+private:
+    struct ColumnView
+    {
+        const uint8_t *data = nullptr;
+        uint64_t count = 0;
+    };
+
+    LibrarySnapshot() = default;
+    bool Validate();
+    const ColumnView *Find(SnapshotColumn id) const;
+
+    std::unique_ptr<ByteSource> source_;
+    const uint8_t *base_ = nullptr;
+    uint64_t size_ = 0;
+    uint64_t rowCount_ = 0;
+    std::vector<std::pair<SnapshotColumn, ColumnView>> columns_;
+};
+
+#endif // LIBRARY_SNAPSHOT_H
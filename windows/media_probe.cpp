@@ -0,0 +1,1032 @@
+#include "media_probe.h"
+#include "buffer_pool.h"
+#include "container_parse.h"
+#include "element_dispatch.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+    // A damaged file must not turn into an endless chain of hops
+    constexpr uint32_t kMaxReads = 16;
+
+    // Matroska element IDs (with length marker) the probe checks before its rule table applies
+    constexpr uint64_t kEbmlHeader = 0x1A45DFA3;
+    constexpr uint64_t kSegment = 0x18538067;
+    constexpr uint64_t kInfo = 0x1549A966;
+
+    // Fragmented MP4 walks one moof per read; the cap only stops a runaway chain
+    constexpr uint32_t kMaxFragmentReads = 4096;
+    constexpr size_t kMfroBytes = 16;
+
+    using Mp4Rules = IsoBmffRules<ProbeKind::Duration>;
+    using FragmentRules = IsoBmffRules<ProbeKind::Fragments>;
+    using MkvRules = EbmlRules<ProbeKind::Duration>;
+
+    // mvhd: duration in movie timescale units
+    bool ParseMvhd(const uint8_t *p, size_t length, double *durationMs)
+    {
+        if (length < 20) return false;
+        uint32_t timescale;
+        uint64_t duration;
+        if (p[0] == 1)
+        {
+            if (length < 32) return false;
+            timescale = ReadBe32(p + 20);
+            duration = ReadBe64(p + 24);
+            if (duration == UINT64_MAX) duration = 0;
+        }
+        else
+        {
+            timescale = ReadBe32(p + 12);
+            duration = ReadBe32(p + 16);
+            if (duration == UINT32_MAX) duration = 0;
+        }
+        if (timescale == 0) return false;
+        *durationMs = static_cast<double>(duration) * 1000.0 / timescale;
+        return true;
+    }
+
+    // Fields of mvhd or Matroska Info, and the Info position a SeekHead announces
+    struct DurationFields : ElementVisitor
+    {
+        uint64_t segmentStart = 0;
+        bool movieHeader = false;
+        double mvhdMs = 0.0;
+        uint64_t timestampScale = 1000000; // default: milliseconds
+        double duration = -1.0;
+        uint64_t seekId = 0;
+        uint64_t seekPosition = 0;
+        bool hasSeekPosition = false;
+        uint64_t infoPosition = 0; // first SeekHead entry for Info, 0 if none
+
+        bool OnEnter(const ElementRule &rule, uint64_t, uint64_t)
+        {
+            if (rule.field == ElementField::SeekEntry)
+            {
+                seekId = 0;
+                hasSeekPosition = false;
+            }
+            return true;
+        }
+
+        bool OnLeave(const ElementRule &rule)
+        {
+            if (rule.field == ElementField::SeekEntry && seekId == kInfo && hasSeekPosition && infoPosition == 0)
+                infoPosition = segmentStart + seekPosition;
+            return true;
+        }
+
+        bool OnField(const ElementRule &rule, const ElementValue &value)
+        {
+            switch (rule.field)
+            {
+            case ElementField::MovieHeader:
+                movieHeader = ParseMvhd(value.data, value.length, &mvhdMs);
+                return false; // the rest of moov is of no use here
+            case ElementField::SeekId:
+                seekId = value.uint;
+                break;
+            case ElementField::SeekPosition:
+                seekPosition = value.uint;
+                hasSeekPosition = true;
+                break;
+            case ElementField::TimestampScale:
+                timestampScale = value.uint;
+                break;
+            case ElementField::Duration:
+                duration = value.real;
+                break;
+            default:
+                break;
+            }
+            return true;
+        }
+
+        bool InfoDurationMs(double *durationMs) const
+        {
+            if (duration < 0.0 || timestampScale == 0) return false;
+            *durationMs = duration * static_cast<double>(timestampScale) / 1e6;
+            return true;
+        }
+    };
+
+    // === Fragmented MP4 ===
+
+    // sidx: subsegment durations in ms, and where the indexed bytes end relative
+    // to the end of the box (first_offset plus every referenced size)
+    bool ParseSidx(const uint8_t *p, size_t length, double *durationMs, uint64_t *indexedEnd)
+    {
+        const bool wide = p[0] == 1;
+        const size_t entries = wide ? 32 : 24;
+        if (length < entries) return false;
+        const uint32_t timescale = ReadBe32(p + 8);
+        const uint16_t count = ReadBe16(p + entries - 2);
+        if (timescale == 0 || length < entries + size_t(count) * 12) return false;
+        uint64_t ticks = 0;
+        uint64_t bytes = wide ? ReadBe64(p + 20) : ReadBe32(p + 16);
+        for (size_t i = 0; i < count; i++)
+        {
+            bytes += ReadBe32(p + entries + i * 12) & 0x7FFFFFFF;
+            ticks += ReadBe32(p + entries + i * 12 + 4);
+        }
+        *durationMs = static_cast<double>(ticks) * 1000.0 / timescale;
+        *indexedEnd = bytes;
+        return ticks > 0;
+    }
+
+    // tfra: moof offset of the last random access point listed
+    bool ParseTfra(const uint8_t *p, size_t length, uint64_t *moofOffset)
+    {
+        if (length < 16) return false;
+        const bool wide = p[0] == 1;
+        const uint32_t sizes = ReadBe32(p + 8);
+        const size_t entryBytes = (wide ? 16 : 8) + ((sizes >> 4) & 3) + ((sizes >> 2) & 3) + (sizes & 3) + 3;
+        const uint32_t count = ReadBe32(p + 12);
+        if (count == 0 || (length - 16) / entryBytes < count) return false;
+        const uint8_t *last = p + 16 + size_t(count - 1) * entryBytes;
+        *moofOffset = wide ? ReadBe64(last + 8) : ReadBe32(last + 4);
+        return true;
+    }
+
+    // Timescales and trex defaults from moov, then the decode time each traf
+    // reaches: tfdt (or where the track's previous fragment ended) plus its trun durations.
+    struct FragmentFields : ElementVisitor
+    {
+        FragmentClock &clock;
+        FragmentClock::Track *building = nullptr; // trak in moov
+        // Track fragment being read
+        FragmentClock::Track *track = nullptr;
+        uint32_t defaultDuration = 0;
+        uint64_t decodeTime = 0;
+        bool hasDecodeTime = false;
+        uint64_t runTicks = 0;
+
+        explicit FragmentFields(FragmentClock &c) : clock(c) {}
+
+        FragmentClock::Track *FindTrack(uint32_t id)
+        {
+            for (int i = 0; i < clock.trackCount; i++)
+                if (clock.tracks[i].id == id) return &clock.tracks[i];
+            return nullptr;
+        }
+
+        bool OnEnter(const ElementRule &rule, uint64_t, uint64_t)
+        {
+            if (rule.field == ElementField::Track)
+                building = clock.trackCount < FragmentClock::kMaxTracks ? &(clock.tracks[clock.trackCount++] = {}) : nullptr;
+            if (rule.field == ElementField::TrackFragment)
+            {
+                track = nullptr;
+                defaultDuration = 0;
+                hasDecodeTime = false;
+                runTicks = 0;
+            }
+            return true;
+        }
+
+        bool OnLeave(const ElementRule &rule)
+        {
+            if (rule.field == ElementField::Track) building = nullptr;
+            if (rule.field != ElementField::TrackFragment || track == nullptr) return true;
+            if (!hasDecodeTime) clock.missingDecodeTime = true;
+            const uint64_t start = hasDecodeTime ? decodeTime : track->end;
+            track->end = std::max(track->end, start + runTicks);
+            return true;
+        }
+
+        bool OnField(const ElementRule &rule, const ElementValue &value)
+        {
+            const uint8_t *p = value.data;
+            const size_t length = value.length;
+            const bool wide = length > 0 && p[0] == 1;
+            switch (rule.field)
+            {
+            case ElementField::MovieHeader:
+                if (length >= (wide ? 24u : 16u)) clock.movieTimescale = ReadBe32(p + (wide ? 20 : 12));
+                break;
+            case ElementField::MovieExtendsHeader:
+                if (length >= (wide ? 12u : 8u)) clock.fragmentDuration = wide ? ReadBe64(p + 4) : ReadBe32(p + 4);
+                break;
+            case ElementField::TrackExtends:
+                if (length >= 16)
+                {
+                    if (FragmentClock::Track *t = FindTrack(ReadBe32(p + 4))) t->defaultDuration = ReadBe32(p + 12);
+                }
+                break;
+            case ElementField::TrackHeader:
+                if (building != nullptr && length >= (wide ? 24u : 16u)) building->id = ReadBe32(p + (wide ? 20 : 12));
+                break;
+            case ElementField::MediaHeader:
+                if (building != nullptr && length >= (wide ? 24u : 16u)) building->timescale = ReadBe32(p + (wide ? 20 : 12));
+                break;
+            case ElementField::TrackFragmentHeader:
+            {
+                if (length < 8) break;
+                const uint32_t flags = ReadBe32(p) & 0xFFFFFF;
+                track = FindTrack(ReadBe32(p + 4));
+                defaultDuration = track != nullptr ? track->defaultDuration : 0;
+                // base-data-offset and sample-description-index come first when present
+                const size_t at = 8 + ((flags & 0x01) ? 8 : 0) + ((flags & 0x02) ? 4 : 0);
+                if ((flags & 0x08) && length >= at + 4) defaultDuration = ReadBe32(p + at);
+                break;
+            }
+            case ElementField::TrackFragmentDecodeTime:
+                if (length >= (wide ? 12u : 8u))
+                {
+                    decodeTime = wide ? ReadBe64(p + 4) : ReadBe32(p + 4);
+                    hasDecodeTime = true;
+                }
+                break;
+            case ElementField::TrackRun:
+            {
+                if (length < 8) break;
+                const uint32_t flags = ReadBe32(p) & 0xFFFFFF;
+                const uint32_t count = ReadBe32(p + 4);
+                if (!(flags & 0x100))
+                {
+                    runTicks += uint64_t(count) * defaultDuration;
+                    break;
+                }
+                // data-offset and first-sample-flags, then per sample: duration, size, flags, composition offset
+                const size_t first = 8 + ((flags & 0x01) ? 4 : 0) + ((flags & 0x04) ? 4 : 0);
+                const size_t stride = 4 + ((flags & 0x200) ? 4 : 0) + ((flags & 0x400) ? 4 : 0) + ((flags & 0x800) ? 4 : 0);
+                const size_t listed = length > first ? std::min<size_t>(count, (length - first) / stride) : 0;
+                for (size_t i = 0; i < listed; i++) runTicks += ReadBe32(p + first + i * stride);
+                break;
+            }
+            case ElementField::RandomAccess:
+            {
+                uint64_t moof;
+                if (ParseTfra(p, length, &moof)) clock.lastRandomAccess = std::max(clock.lastRandomAccess, moof);
+                break;
+            }
+            default:
+                break;
+            }
+            return true;
+        }
+    };
+
+    // === AVI ===
+
+    // avih frame count x frame period. hdrl and odml lists are walked through;
+    // OpenDML's dmlh counts the frames of every RIFF, avih only those of the first.
+    bool ParseAviHeaders(const uint8_t *p, size_t length, double *durationMs)
+    {
+        uint64_t microsPerFrame = 0, frames = 0, odmlFrames = 0;
+        size_t pos = 12; // RIFF size 'AVI '
+        while (pos + 8 <= length)
+        {
+            const uint8_t *chunk = p + pos;
+            const uint32_t size = ReadLe32(chunk + 4);
+            if (std::memcmp(chunk, "LIST", 4) == 0 && size >= 4 && pos + 12 <= length &&
+                (std::memcmp(chunk + 8, "hdrl", 4) == 0 || std::memcmp(chunk + 8, "odml", 4) == 0))
+            {
+                pos += 12;
+                continue;
+            }
+            if (std::memcmp(chunk, "LIST", 4) == 0 && pos + 12 <= length && std::memcmp(chunk + 8, "movi", 4) == 0) break;
+            if (std::memcmp(chunk, "avih", 4) == 0 && size >= 20 && pos + 28 <= length)
+            {
+                microsPerFrame = ReadLe32(chunk + 8);
+                frames = ReadLe32(chunk + 24);
+            }
+            if (std::memcmp(chunk, "dmlh", 4) == 0 && size >= 4 && pos + 12 <= length) odmlFrames = ReadLe32(chunk + 8);
+            pos += 8 + static_cast<size_t>(size) + (size & 1);
+        }
+        if (odmlFrames > frames) frames = odmlFrames;
+        if (microsPerFrame == 0 || frames == 0) return false;
+        *durationMs = static_cast<double>(frames) * static_cast<double>(microsPerFrame) / 1000.0;
+        return true;
+    }
+
+    // === ASF ===
+
+    constexpr size_t kAsfHeaderObjectBytes = 30; // GUID, size, object count, two reserved bytes
+    constexpr size_t kAsfObjectHeaderBytes = 24;
+    constexpr size_t kAsfFilePropertiesBytes = 104;
+    constexpr uint8_t kAsfFileProperties[16] = {0xA1, 0xDC, 0xAB, 0x8C, 0x47, 0xA9, 0xCF, 0x11,
+                                                0x8E, 0xE4, 0x00, 0xC0, 0x0C, 0x20, 0x53, 0x65};
+
+    // Play duration (100 ns units) less the preroll (ms); broadcast files leave the duration unset
+    bool ParseAsfFileProperties(const uint8_t *p, double *durationMs)
+    {
+        const uint64_t playDuration = ReadLe64(p + 64);
+        const uint64_t prerollMs = ReadLe64(p + 80);
+        const uint32_t flags = ReadLe32(p + 88);
+        if (flags & 1) return false;
+        const double duration = static_cast<double>(playDuration) / 10000.0 - static_cast<double>(prerollMs);
+        if (duration <= 0.0) return false;
+        *durationMs = duration;
+        return true;
+    }
+
+    // === FLV ===
+
+    constexpr size_t kFlvTagHeaderBytes = 11;
+    constexpr uint8_t kFlvScriptTag = 18;
+    constexpr int kMaxAmfDepth = 8;
+
+    inline uint32_t ReadBe24(const uint8_t *p) { return (uint32_t(p[0]) << 16) | (uint32_t(p[1]) << 8) | p[2]; }
+
+    // Tag timestamp: 24 bits plus an extension byte holding the top bits
+    inline uint32_t FlvTagTimestamp(const uint8_t *tag) { return ReadBe24(tag + 4) | (uint32_t(tag[7]) << 24); }
+
+    bool SkipAmfValue(const uint8_t *p, size_t length, size_t *pos, int depth);
+
+    // Object and ECMA array bodies: key/value pairs up to the 00 00 09 end marker
+    bool SkipAmfProperties(const uint8_t *p, size_t length, size_t *pos, int depth)
+    {
+        while (*pos + 2 <= length)
+        {
+            const size_t keyLength = ReadBe16(p + *pos);
+            *pos += 2 + keyLength;
+            if (keyLength == 0 && *pos < length && p[*pos] == 9)
+            {
+                (*pos)++;
+                return true;
+            }
+            if (!SkipAmfValue(p, length, pos, depth)) return false;
+        }
+        return false;
+    }
+
+    bool SkipAmfValue(const uint8_t *p, size_t length, size_t *pos, int depth)
+    {
+        if (*pos >= length || depth > kMaxAmfDepth) return false;
+        const uint8_t type = p[(*pos)++];
+        switch (type)
+        {
+        case 0: // number
+            *pos += 8;
+            break;
+        case 1: // boolean
+            *pos += 1;
+            break;
+        case 2: // string
+            if (*pos + 2 > length) return false;
+            *pos += 2 + ReadBe16(p + *pos);
+            break;
+        case 3: // object
+            return SkipAmfProperties(p, length, pos, depth + 1);
+        case 8: // ECMA array: a count, then properties as in an object
+            *pos += 4;
+            return SkipAmfProperties(p, length, pos, depth + 1);
+        case 10: // strict array
+        {
+            if (*pos + 4 > length) return false;
+            const uint32_t count = ReadBe32(p + *pos);
+            *pos += 4;
+            for (uint32_t i = 0; i < count; i++)
+                if (!SkipAmfValue(p, length, pos, depth + 1)) return false;
+            break;
+        }
+        case 5: // null
+        case 6: // undefined
+            break;
+        case 11: // date: ms as a number, then a time zone
+            *pos += 10;
+            break;
+        case 12: // long string
+            if (*pos + 4 > length) return false;
+            *pos += 4 + ReadBe32(p + *pos);
+            break;
+        default:
+            return false;
+        }
+        return *pos <= length;
+    }
+
+    // "duration" (seconds) in an onMetaData script tag body
+    bool FindAmfDuration(const uint8_t *p, size_t length, double *seconds)
+    {
+        static constexpr char kName[] = "onMetaData";
+        constexpr size_t kNameLength = sizeof(kName) - 1;
+        if (length < 3 + kNameLength || p[0] != 2 || ReadBe16(p + 1) != kNameLength || std::memcmp(p + 3, kName, kNameLength) != 0)
+            return false;
+        size_t pos = 3 + kNameLength;
+        if (pos >= length || (p[pos] != 8 && p[pos] != 3)) return false;
+        pos += p[pos] == 8 ? 5 : 1;
+        while (pos + 2 <= length)
+        {
+            const size_t keyLength = ReadBe16(p + pos);
+            pos += 2;
+            if (keyLength == 0 || pos + keyLength > length) return false;
+            const bool isDuration = keyLength == 8 && std::memcmp(p + pos, "duration", 8) == 0;
+            pos += keyLength;
+            if (isDuration && pos + 9 <= length && p[pos] == 0)
+            {
+                const uint64_t bits = ReadBe64(p + pos + 1);
+                std::memcpy(seconds, &bits, sizeof(*seconds));
+                return true;
+            }
+            if (!SkipAmfValue(p, length, &pos, 0)) return false;
+        }
+        return false;
+    }
+
+    // === Ogg ===
+
+    constexpr size_t kOggPageHeaderBytes = 27;
+
+    // Page header at p, or false if it is not one; pageLength covers the segment table and the body
+    bool ReadOggPage(const uint8_t *p, size_t length, uint64_t *granule, uint32_t *serial, size_t *headerLength, size_t *pageLength)
+    {
+        if (length < kOggPageHeaderBytes || std::memcmp(p, "OggS", 4) != 0 || p[4] != 0 || p[5] > 7) return false;
+        const size_t segments = p[26];
+        if (kOggPageHeaderBytes + segments > length) return false;
+        size_t body = 0;
+        for (size_t i = 0; i < segments; i++) body += p[kOggPageHeaderBytes + i];
+        *granule = ReadLe64(p + 6);
+        *serial = ReadLe32(p + 14);
+        *headerLength = kOggPageHeaderBytes + segments;
+        *pageLength = *headerLength + body;
+        return true;
+    }
+
+    // === MPEG-TS ===
+
+    constexpr size_t kTsPacketBytes = 188;
+    constexpr uint64_t kTimestampMask = (uint64_t(1) << 33) - 1; // PCR base and PTS wrap every 26.5 hours
+
+    // Offset of the first packet whose sync byte repeats twice more at the packet stride
+    bool FindTransportSync(const uint8_t *p, size_t length, size_t stride, size_t *first)
+    {
+        const size_t sync = stride - kTsPacketBytes; // M2TS: 4-byte arrival timestamp before each packet
+        for (size_t o = 0; o < stride && o + sync + 2 * stride < length; o++)
+        {
+            if (p[o + sync] == 0x47 && p[o + sync + stride] == 0x47 && p[o + sync + 2 * stride] == 0x47)
+            {
+                *first = o;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    inline uint64_t ReadPts(const uint8_t *p)
+    {
+        return (uint64_t((p[0] >> 1) & 7) << 30) | (uint64_t(p[1]) << 22) | (uint64_t(p[2] >> 1) << 15) | (uint64_t(p[3]) << 7) |
+               (p[4] >> 1);
+    }
+
+    // Calls onPcr(pid, base) and onPts(pid, pts) for each packet of the buffer in file order
+    template <typename OnPcr, typename OnPts>
+    void ScanTransportPackets(const uint8_t *p, size_t length, size_t stride, OnPcr &&onPcr, OnPts &&onPts)
+    {
+        size_t pos;
+        if (!FindTransportSync(p, length, stride, &pos)) return;
+        for (pos += stride - kTsPacketBytes; pos + kTsPacketBytes <= length; pos += stride)
+        {
+            const uint8_t *packet = p + pos;
+            if (packet[0] != 0x47) continue;
+            const uint16_t pid = static_cast<uint16_t>(((packet[1] & 0x1F) << 8) | packet[2]);
+            const bool unitStart = packet[1] & 0x40;
+            const uint8_t adaptation = (packet[3] >> 4) & 3;
+            size_t payload = 4;
+            if (adaptation & 2)
+            {
+                const size_t adaptationLength = packet[4];
+                if (adaptationLength >= 7 && (packet[5] & 0x10))
+                {
+                    onPcr(pid, (uint64_t(packet[6]) << 25) | (uint64_t(packet[7]) << 17) | (uint64_t(packet[8]) << 9) |
+                                   (uint64_t(packet[9]) << 1) | (packet[10] >> 7));
+                }
+                payload += 1 + adaptationLength;
+            }
+            if (!(adaptation & 1) || !unitStart || payload + 14 > kTsPacketBytes) continue;
+
+            // PES header with a PTS; program stream maps, padding and private_stream_2 carry none
+            const uint8_t *pes = packet + payload;
+            const uint8_t streamId = pes[3];
+            if (pes[0] != 0 || pes[1] != 0 || pes[2] != 1 || streamId == 0xBC || streamId == 0xBE || streamId == 0xBF) continue;
+            if ((pes[7] & 0x80) && (pes[9] & 0x21) == 0x21) onPts(pid, ReadPts(pes + 9));
+        }
+    }
+}
+
+double FragmentClock::EndMs() const
+{
+    double endMs = 0.0;
+    for (int i = 0; i < trackCount; i++)
+        if (tracks[i].timescale != 0) endMs = std::max(endMs, static_cast<double>(tracks[i].end) * 1000.0 / tracks[i].timescale);
+    return endMs;
+}
+
+ProbeStep DurationProbe::Start(uint64_t fileSize)
+{
+    fileSize_ = fileSize;
+    readLimit_ = kMaxReads;
+    state_ = State::Head;
+    if (fileSize == 0) return ProbeStep::Fail();
+    return ProbeStep::ReadAt(0, std::min<uint64_t>(kHeadBytes, fileSize));
+}
+
+ProbeStep DurationProbe::ReadNext(uint64_t offset, uint64_t length, uint64_t limit)
+{
+    if (reads_ >= readLimit_ || offset >= fileSize_) return ProbeStep::Fail();
+    length = std::min<uint64_t>({length, limit, fileSize_ - offset});
+    return ProbeStep::ReadAt(offset, std::max<uint64_t>(length, 1));
+}
+
+ProbeStep DurationProbe::FinishWith(double durationMs, DurationMethod method)
+{
+    if (!(durationMs > 0.0)) return ProbeStep::Fail();
+    durationMs_ = durationMs;
+    method_ = method;
+    return ProbeStep::Finish();
+}
+
+ProbeStep DurationProbe::OnData(uint64_t offset, const uint8_t *data, size_t length)
+{
+    reads_++;
+    bytesRead_ += length;
+    if (length == 0) return ProbeStep::Fail();
+
+    switch (state_)
+    {
+    case State::Head:
+    {
+        container_ = SniffBuffer(data, length, nullptr, 0);
+        if (container_ == ContainerKind::IsoBmff || container_ == ContainerKind::QuickTime)
+        {
+            state_ = State::Mp4Boxes;
+            cursor_ = 0;
+            return ScanBoxes(offset, data, length);
+        }
+        switch (container_)
+        {
+        case ContainerKind::Matroska:
+        case ContainerKind::WebM:
+            break;
+        case ContainerKind::Avi:
+        {
+            double durationMs;
+            return ParseAviHeaders(data, length, &durationMs) ? FinishWith(durationMs) : ProbeStep::Fail();
+        }
+        case ContainerKind::Asf:
+            if (length < kAsfHeaderObjectBytes) return ProbeStep::Fail();
+            state_ = State::AsfHeader;
+            regionEnd_ = ReadLe64(data + 16);
+            cursor_ = kAsfHeaderObjectBytes;
+            return ScanAsf(offset, data, length);
+        case ContainerKind::Flv:
+            return StartFlv(data, length);
+        case ContainerKind::Ogg:
+            return StartOgg(data, length);
+        case ContainerKind::MpegTs:
+        case ContainerKind::M2ts:
+            state_ = State::TransportHead;
+            transport_.packetSize = container_ == ContainerKind::M2ts ? 192 : kTsPacketBytes;
+            return ScanTransport(offset, data, length);
+        default:
+            return ProbeStep::Fail();
+        }
+
+        // EBML header, then the Segment header; both sit in the first few dozen bytes
+        size_t pos = 0;
+        uint64_t id, size;
+        if (!ReadVint(data, length, &pos, true, &id) || id != kEbmlHeader || !ReadVint(data, length, &pos, false, &size))
+            return ProbeStep::Fail();
+        if (size > length - pos) return ProbeStep::Fail();
+        pos += static_cast<size_t>(size);
+        if (!ReadVint(data, length, &pos, true, &id) || id != kSegment || !ReadVint(data, length, &pos, false, &size))
+            return ProbeStep::Fail();
+
+        state_ = State::MatroskaSegment;
+        segmentStart_ = cursor_ = offset + pos;
+        return ScanSegment(offset, data, length);
+    }
+    case State::Mp4Boxes:
+        return ScanBoxes(offset, data, length);
+    case State::Mp4Fragments:
+    case State::Mp4FragmentWalk:
+        return ScanFragments(offset, data, length);
+    case State::Mp4RandomAccess:
+    case State::Mp4RandomAccessTable:
+        return OnRandomAccess(offset, data, length);
+    case State::MatroskaSegment:
+        return ScanSegment(offset, data, length);
+    case State::AsfHeader:
+        return ScanAsf(offset, data, length);
+    case State::FlvTail:
+    case State::FlvLastTag:
+        return OnFlvTail(offset, data, length);
+    case State::OggTail:
+        return OnOggTail(data, length);
+    case State::TransportHead:
+    case State::TransportTail:
+        return ScanTransport(offset, data, length);
+    }
+    return ProbeStep::Fail();
+}
+
+ProbeStep DurationProbe::ScanBoxes(uint64_t offset, const uint8_t *data, size_t length)
+{
+    const uint64_t end = offset + length;
+    while (cursor_ >= offset && cursor_ + 8 <= end)
+    {
+        const uint8_t *box = data + (cursor_ - offset);
+        uint64_t size = ReadBe32(box);
+        uint32_t header = 8;
+        if (size == 1)
+        {
+            if (cursor_ + 16 > end) break;
+            size = ReadBe64(box + 8);
+            header = 16;
+        }
+        else if (size == 0)
+            size = fileSize_ - cursor_;
+        if (size < header) return ProbeStep::Fail();
+
+        const ElementRule *rule = Dispatch<Mp4Rules>::Find(ReadBe32(box + 4));
+        if (rule != nullptr && rule->field == ElementField::Movie)
+        {
+            // mvhd is the first child in practice, so the buffered part of moov
+            // is enough unless this read did not start at the box.
+            const uint64_t available = end - cursor_;
+            if (available < size && cursor_ != offset) return ReadNext(cursor_, size);
+            BufferReader reader{data, offset, length};
+            DurationFields fields;
+            WalkElements<Mp4Rules>(reader, cursor_, cursor_ + std::min(available, size), fields);
+            if (!fields.movieHeader) return ProbeStep::Fail();
+            if (fields.mvhdMs > 0.0) return FinishWith(fields.mvhdMs);
+
+            // Fragmented: the movie header leaves the duration to the fragments
+            if (available < size && available < kTailBytes) return ReadNext(cursor_, size, kTailBytes);
+            FragmentFields fragments(fragments_);
+            WalkElements<FragmentRules>(reader, cursor_, cursor_ + std::min(available, size), fragments);
+            if (fragments_.fragmentDuration > 0 && fragments_.movieTimescale > 0)
+                return FinishWith(static_cast<double>(fragments_.fragmentDuration) * 1000.0 / fragments_.movieTimescale,
+                                  DurationMethod::MovieExtends);
+            state_ = State::Mp4Fragments;
+            cursor_ += size;
+            return ScanFragments(offset, data, length);
+        }
+        cursor_ += size;
+    }
+    if (cursor_ >= fileSize_) return ProbeStep::Fail(); // no moov
+    return ReadNext(cursor_, kHeadBytes);
+}
+
+ProbeStep DurationProbe::ScanFragments(uint64_t offset, const uint8_t *data, size_t length)
+{
+    const uint64_t end = offset + length;
+    while (cursor_ >= offset && cursor_ + 8 <= end && cursor_ < fileSize_)
+    {
+        const uint8_t *box = data + (cursor_ - offset);
+        uint64_t size = ReadBe32(box);
+        uint32_t header = 8;
+        if (size == 1)
+        {
+            if (cursor_ + 16 > end) break;
+            size = ReadBe64(box + 8);
+            header = 16;
+        }
+        else if (size == 0)
+            size = fileSize_ - cursor_;
+        if (size < header) return ProbeStep::Fail();
+
+        const ElementRule *rule = Dispatch<FragmentRules>::Find(ReadBe32(box + 4));
+        const ElementField field = rule != nullptr ? rule->field : ElementField::None;
+        if (field == ElementField::SegmentIndex || (field == ElementField::MovieFragment && state_ == State::Mp4FragmentWalk))
+        {
+            if (cursor_ + size > end && end < fileSize_)
+            {
+                // Read the box whole; one larger than a tail read is not worth the walk
+                if (cursor_ == offset && length >= std::min<uint64_t>(size, kTailBytes)) return ProbeStep::Fail();
+                return ReadNext(cursor_, size, kTailBytes);
+            }
+            const uint64_t boxEnd = std::min(cursor_ + size, end); // a recording cut short ends mid-fragment
+            if (field == ElementField::SegmentIndex)
+            {
+                // Top-level indexes are chained segment after segment (a nested
+                // one is inside the range its parent indexes and gets skipped)
+                double durationMs;
+                uint64_t indexedEnd;
+                if (ParseSidx(box + header, static_cast<size_t>(boxEnd - cursor_ - header), &durationMs, &indexedEnd))
+                {
+                    if (fragments_.indexedMs == 0.0) firstFragment_ = cursor_ + size;
+                    fragments_.indexedMs += durationMs;
+                    cursor_ += size + indexedEnd;
+                    continue;
+                }
+            }
+            else
+            {
+                BufferReader reader{data, offset, length};
+                FragmentFields fragments(fragments_);
+                WalkElements<FragmentRules>(reader, cursor_, boxEnd, fragments);
+            }
+        }
+        else if (field == ElementField::MovieFragment)
+        {
+            // A moof no sidx covers: the random access table at the end of the
+            // file points at the last fragments, so only those need reading
+            if (fragments_.indexedMs == 0.0) firstFragment_ = cursor_;
+            fragments_.indexedMs = 0.0;
+            readLimit_ = kMaxFragmentReads;
+            if (fileSize_ < kMfroBytes) return ProbeStep::Fail();
+            state_ = State::Mp4RandomAccess;
+            return ReadNext(fileSize_ - kMfroBytes, kMfroBytes);
+        }
+        cursor_ += size;
+    }
+
+    if (cursor_ < fileSize_) return ReadNext(cursor_, kHeadBytes);
+    if (state_ != State::Mp4FragmentWalk) return FinishWith(fragments_.indexedMs, DurationMethod::SegmentIndex);
+
+    // A traf without tfdt only counts from where the previous fragment ended,
+    // which a walk that started at the last random access point never saw
+    if (jumpedToRandomAccess_ && fragments_.missingDecodeTime)
+    {
+        jumpedToRandomAccess_ = false;
+        fragments_.missingDecodeTime = false;
+        for (int i = 0; i < fragments_.trackCount; i++) fragments_.tracks[i].end = 0;
+        cursor_ = firstFragment_;
+        return ReadNext(cursor_, kHeadBytes);
+    }
+    return FinishWith(fragments_.EndMs(), jumpedToRandomAccess_ ? DurationMethod::RandomAccess : DurationMethod::FragmentWalk);
+}
+
+ProbeStep DurationProbe::OnRandomAccess(uint64_t offset, const uint8_t *data, size_t length)
+{
+    if (state_ == State::Mp4RandomAccess)
+    {
+        // mfro closes the file with the size of mfra
+        const uint32_t mfraSize = length >= kMfroBytes && std::memcmp(data + 4, "mfro", 4) == 0 ? ReadBe32(data + 12) : 0;
+        if (mfraSize >= 16 && mfraSize <= kTailBytes && mfraSize <= fileSize_ - firstFragment_)
+        {
+            state_ = State::Mp4RandomAccessTable;
+            return ReadNext(fileSize_ - mfraSize, mfraSize, kTailBytes);
+        }
+    }
+    else if (length >= 8 && std::memcmp(data + 4, "mfra", 4) == 0)
+    {
+        BufferReader reader{data, offset, length};
+        FragmentFields fragments(fragments_);
+        WalkElements<FragmentRules>(reader, offset, offset + length, fragments);
+    }
+
+    state_ = State::Mp4FragmentWalk;
+    cursor_ = firstFragment_;
+    if (fragments_.lastRandomAccess > firstFragment_ && fragments_.lastRandomAccess < fileSize_)
+    {
+        jumpedToRandomAccess_ = true;
+        cursor_ = fragments_.lastRandomAccess;
+    }
+    return ReadNext(cursor_, kHeadBytes);
+}
+
+ProbeStep DurationProbe::ScanSegment(uint64_t offset, const uint8_t *data, size_t length)
+{
+    const uint64_t end = offset + length;
+    bool blocked = false; // reached a cluster or an unknown-size element
+    while (cursor_ >= offset && cursor_ < end)
+    {
+        size_t pos = static_cast<size_t>(cursor_ - offset);
+        uint64_t id, size;
+        bool unknownSize = false;
+        if (!ReadVint(data, length, &pos, true, &id) || !ReadVint(data, length, &pos, false, &size, &unknownSize)) break;
+        const uint64_t payload = offset + pos;
+        const ElementRule *rule = Dispatch<MkvRules>::Find(id);
+        const bool buffered = !unknownSize && payload + size <= end;
+
+        if (rule != nullptr && rule->field == ElementField::SegmentInfo)
+        {
+            if (!buffered)
+            {
+                if (cursor_ == offset || unknownSize) return ProbeStep::Fail(); // larger than a head read: not a real Info
+                return ReadNext(cursor_, payload - cursor_ + size);
+            }
+            BufferReader reader{data, offset, length};
+            DurationFields fields;
+            WalkElements<MkvRules>(reader, cursor_, payload + size, fields);
+            if (!fields.InfoDurationMs(&durationMs_)) return ProbeStep::Fail();
+            method_ = DurationMethod::Header;
+            return ProbeStep::Finish();
+        }
+        if (rule != nullptr && rule->policy == ElementPolicy::Descend && buffered && infoPosition_ == 0)
+        {
+            // SeekHead
+            BufferReader reader{data, offset, length};
+            DurationFields fields;
+            fields.segmentStart = segmentStart_;
+            WalkElements<MkvRules>(reader, cursor_, payload + size, fields);
+            infoPosition_ = fields.infoPosition;
+        }
+        if ((rule != nullptr && rule->policy == ElementPolicy::Stop) || unknownSize)
+        {
+            blocked = true;
+            break;
+        }
+        cursor_ = payload + size;
+    }
+
+    // Info was indexed by the SeekHead: go straight there rather than hopping
+    if (infoPosition_ != 0 && !jumpedToInfo_)
+    {
+        jumpedToInfo_ = true;
+        cursor_ = infoPosition_;
+        return ReadNext(cursor_, kHeadBytes);
+    }
+    if (blocked || cursor_ >= fileSize_) return ProbeStep::Fail();
+    return ReadNext(cursor_, kHeadBytes);
+}
+
+ProbeStep DurationProbe::ScanAsf(uint64_t offset, const uint8_t *data, size_t length)
+{
+    // Header Object children: File Properties is usually the first, but large
+    // metadata or embedded pictures may come before it.
+    const uint64_t end = offset + length;
+    while (cursor_ >= offset && cursor_ + kAsfObjectHeaderBytes <= end && cursor_ < regionEnd_)
+    {
+        const uint8_t *object = data + (cursor_ - offset);
+        const uint64_t size = ReadLe64(object + 16);
+        if (size < kAsfObjectHeaderBytes) return ProbeStep::Fail();
+        if (std::memcmp(object, kAsfFileProperties, sizeof(kAsfFileProperties)) == 0)
+        {
+            if (size < kAsfFilePropertiesBytes) return ProbeStep::Fail();
+            if (cursor_ + kAsfFilePropertiesBytes > end) return ReadNext(cursor_, kAsfFilePropertiesBytes);
+            double durationMs;
+            return ParseAsfFileProperties(object, &durationMs) ? FinishWith(durationMs) : ProbeStep::Fail();
+        }
+        cursor_ += size;
+    }
+    if (cursor_ >= regionEnd_) return ProbeStep::Fail();
+    return ReadNext(cursor_, kHeadBytes);
+}
+
+ProbeStep DurationProbe::StartFlv(const uint8_t *data, size_t length)
+{
+    // Header (its size is at byte 5), PreviousTagSize0, then the first tag: onMetaData in practice
+    if (length < 9) return ProbeStep::Fail();
+    const size_t tag = static_cast<size_t>(ReadBe32(data + 5)) + 4;
+    if (tag + kFlvTagHeaderBytes <= length && (data[tag] & 0x1F) == kFlvScriptTag)
+    {
+        const size_t body = tag + kFlvTagHeaderBytes;
+        const size_t bodyLength = std::min<size_t>(ReadBe24(data + tag + 1), length - body);
+        double seconds;
+        if (FindAmfDuration(data + body, bodyLength, &seconds) && seconds > 0.0) return FinishWith(seconds * 1000.0);
+    }
+
+    // Live captures often write no duration: take the last tag's timestamp, found through the trailing PreviousTagSize
+    if (fileSize_ < 9 + 4 + kFlvTagHeaderBytes) return ProbeStep::Fail();
+    state_ = State::FlvTail;
+    return ReadNext(fileSize_ - 4, 4);
+}
+
+ProbeStep DurationProbe::OnFlvTail(uint64_t offset, const uint8_t *data, size_t length)
+{
+    if (state_ == State::FlvTail)
+    {
+        if (length < 4) return ProbeStep::Fail();
+        const uint64_t tagSize = ReadBe32(data);
+        if (tagSize < kFlvTagHeaderBytes || tagSize + 4 > offset) return ProbeStep::Fail();
+        state_ = State::FlvLastTag;
+        return ReadNext(offset - tagSize, kFlvTagHeaderBytes);
+    }
+    if (length < kFlvTagHeaderBytes) return ProbeStep::Fail();
+    return FinishWith(FlvTagTimestamp(data));
+}
+
+ProbeStep DurationProbe::StartOgg(const uint8_t *data, size_t length)
+{
+    uint64_t granule;
+    size_t header, page;
+    if (!ReadOggPage(data, length, &granule, &ogg_.serial, &header, &page) || page > length) return ProbeStep::Fail();
+
+    // The first page holds the identification header of the first stream alone
+    const uint8_t *packet = data + header;
+    const size_t packetLength = page - header;
+    if (packetLength >= 16 && std::memcmp(packet, "\x01vorbis", 7) == 0)
+        ogg_.granuleRate = ReadLe32(packet + 12);
+    else if (packetLength >= 19 && std::memcmp(packet, "OpusHead", 8) == 0)
+    {
+        ogg_.granuleRate = 48000.0; // Opus granules always count 48 kHz samples
+        ogg_.granuleOffset = ReadLe16(packet + 10);
+    }
+    else if (packetLength >= 30 && std::memcmp(packet, "\x7F" "FLAC", 5) == 0)
+        ogg_.granuleRate = (uint32_t(packet[27]) << 12) | (uint32_t(packet[28]) << 4) | (packet[29] >> 4);
+    else if (packetLength >= 42 && std::memcmp(packet, "\x80theora", 7) == 0)
+    {
+        const uint32_t numerator = ReadBe32(packet + 22), denominator = ReadBe32(packet + 26);
+        if (denominator != 0) ogg_.granuleRate = static_cast<double>(numerator) / denominator;
+        ogg_.granuleShift = static_cast<uint8_t>(((packet[40] & 0x03) << 3) | (packet[41] >> 5));
+    }
+    else if (packetLength >= 40 && std::memcmp(packet, "Speex   ", 8) == 0)
+        ogg_.granuleRate = ReadLe32(packet + 36);
+    if (ogg_.granuleRate <= 0.0) return ProbeStep::Fail();
+
+    state_ = State::OggTail;
+    const uint64_t tail = fileSize_ > kTailBytes ? fileSize_ - kTailBytes : 0;
+    return ReadNext(tail, kTailBytes, kTailBytes);
+}
+
+ProbeStep DurationProbe::OnOggTail(const uint8_t *data, size_t length)
+{
+    // Pages are found by their capture pattern; a page too long for the tail still has its header in it
+    uint64_t last = UINT64_MAX;
+    for (size_t pos = 0; pos + kOggPageHeaderBytes <= length;)
+    {
+        uint64_t granule;
+        uint32_t serial;
+        size_t header, page;
+        if (!ReadOggPage(data + pos, length - pos, &granule, &serial, &header, &page))
+        {
+            pos++;
+            continue;
+        }
+        if (serial == ogg_.serial && granule != UINT64_MAX) last = granule;
+        pos += page;
+    }
+    if (last == UINT64_MAX) return ProbeStep::Fail();
+
+    double granules = static_cast<double>(last);
+    if (ogg_.granuleShift != 0)
+    {
+        // Theora: frames up to the last keyframe, plus frames since it
+        const uint64_t mask = (uint64_t(1) << ogg_.granuleShift) - 1;
+        granules = static_cast<double>((last >> ogg_.granuleShift) + (last & mask));
+    }
+    granules -= static_cast<double>(std::min<uint64_t>(ogg_.granuleOffset, last));
+    return FinishWith(granules * 1000.0 / ogg_.granuleRate);
+}
+
+ProbeStep DurationProbe::ScanTransport(uint64_t offset, const uint8_t *data, size_t length)
+{
+    TransportClock &clock = transport_;
+    if (state_ == State::TransportHead)
+    {
+        ScanTransportPackets(
+            data, length, clock.packetSize,
+            [&](uint16_t pid, uint64_t pcr) {
+                if (clock.pcrPid >= 0) return;
+                clock.pcrPid = pid;
+                clock.firstPcr = pcr;
+            },
+            [&](uint16_t pid, uint64_t pts) {
+                for (int i = 0; i < clock.ptsCount; i++)
+                    if (clock.ptsPids[i] == pid) return;
+                if (clock.ptsCount == TransportClock::kMaxPids) return;
+                clock.ptsPids[clock.ptsCount] = pid;
+                clock.firstPts[clock.ptsCount++] = pts;
+            });
+        clock.scanned = offset + length;
+
+        // Keep reading the head until a PCR turns up, within the bound
+        if (clock.pcrPid < 0 && clock.scanned < kTailBytes && clock.scanned < fileSize_)
+            return ReadNext(clock.scanned, kTailBytes - clock.scanned, kTailBytes);
+        if (clock.pcrPid < 0 && clock.ptsCount == 0) return ProbeStep::Fail();
+
+        state_ = State::TransportTail;
+        const uint64_t tail = fileSize_ > kTailBytes ? fileSize_ - kTailBytes : 0;
+        return ReadNext(tail, kTailBytes, kTailBytes);
+    }
+
+    // Distances from the head's timestamps, modulo the 33-bit wrap. PCR only
+    // moves forward, so its last value counts; PTS is reordered around B-frames,
+    // so the largest distance counts.
+    ScanTransportPackets(
+        data, length, clock.packetSize,
+        [&](uint16_t pid, uint64_t pcr) {
+            if (static_cast<int32_t>(pid) != clock.pcrPid) return;
+            clock.pcrSpan = (pcr - clock.firstPcr) & kTimestampMask;
+            clock.hasPcrSpan = true;
+        },
+        [&](uint16_t pid, uint64_t pts) {
+            for (int i = 0; i < clock.ptsCount; i++)
+            {
+                const uint64_t span = (pts - clock.firstPts[i]) & kTimestampMask;
+                // A PTS just before the first one wraps to a huge distance; it is not the end of the file
+                if (clock.ptsPids[i] == pid && span < (kTimestampMask >> 1)) clock.ptsSpan[i] = std::max(clock.ptsSpan[i], span);
+            }
+        });
+
+    uint64_t ticks = clock.hasPcrSpan ? clock.pcrSpan : 0;
+    if (ticks == 0)
+        for (int i = 0; i < clock.ptsCount; i++) ticks = std::max(ticks, clock.ptsSpan[i]);
+    return FinishWith(static_cast<double>(ticks) / 90.0);
+}
+
+ProbeStep RunProbe(HeaderProbe &probe, ByteSource &source)
+{
+    const uint64_t size = source.Size();
+    PooledBuffer buffer;
+    ProbeStep step = probe.Start(size);
+    while (step.kind == ProbeStep::Read)
+    {
+        const uint64_t offset = step.range.offset;
+        const size_t length = offset < size ? static_cast<size_t>(std::min<uint64_t>(step.range.length, size - offset)) : 0;
+        if (const uint8_t *view = source.View(offset, length))
+        {
+            step = probe.OnData(offset, view, length);
+            continue;
+        }
+        if (buffer.size() < length) buffer = BufferPool::Reads().Acquire(length);
+        const size_t read = source.ReadAt(offset, buffer.data(), length);
+        step = probe.OnData(offset, buffer.data(), read);
+    }
+    return step;
+}
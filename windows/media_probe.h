@@ -0,0 +1,202 @@
+#ifndef MEDIA_PROBE_H
+#define MEDIA_PROBE_H
+
+#include "byte_source.h"
+#include "content_sniffer.h"
+#include <cstddef>
+#include <cstdint>
+
+struct ReadRange
+{
+    uint64_t offset;
+    uint32_t length;
+};
+
+// What a probe wants next: more bytes, or nothing because it has finished.
+struct ProbeStep
+{
+    enum Kind : uint8_t
+    {
+        Read,
+        Done,
+        Failed,
+    } kind;
+    ReadRange range;
+
+    static ProbeStep ReadAt(uint64_t offset, uint64_t length) { return {Read, {offset, static_cast<uint32_t>(length)}}; }
+    static ProbeStep Finish() { return {Done, {0, 0}}; }
+    static ProbeStep Fail() { return {Failed, {0, 0}}; }
+};
+
+/**
+ * @brief A container parser that never performs I/O itself.
+ *
+ * The probe asks for one byte range at a time and is resumed with the bytes,
+ * so the same parser runs on a blocking reader, a thread pool or an io_uring
+ * completion queue. Every follow-up read (the moov box after mdat, the Info
+ * element a SeekHead points at) is just the next step.
+ */
+class HeaderProbe
+{
+public:
+    virtual ~HeaderProbe() = default;
+
+    // Called once the file size is known; returns the first range to read.
+    virtual ProbeStep Start(uint64_t fileSize) = 0;
+
+    // Resumes with the bytes of the last requested range (short at end of file).
+    virtual ProbeStep OnData(uint64_t offset, const uint8_t *data, size_t length) = 0;
+};
+
+// Where a probe's duration came from; fragmented MP4 tries these in order after the movie header
+enum class DurationMethod : uint8_t
+{
+    None,
+    Header,       // mvhd, Matroska Info, avih, ASF File Properties, ...
+    MovieExtends, // mehd
+    SegmentIndex, // sidx
+    RandomAccess, // mfra/tfra, then the fragments from the last random access point
+    FragmentWalk, // every moof from the first
+};
+
+// Fragmented MP4: timescales and defaults from moov, and where each track's fragments end
+struct FragmentClock
+{
+    static constexpr int kMaxTracks = 8;
+    struct Track
+    {
+        uint32_t id = 0;
+        uint32_t timescale = 0;
+        uint32_t defaultDuration = 0; // trex
+        uint64_t end = 0;             // decode time after the last sample seen
+    };
+    uint32_t movieTimescale = 0;
+    uint64_t fragmentDuration = 0; // mehd, in movie timescale
+    double indexedMs = 0.0;        // sidx
+    uint64_t lastRandomAccess = 0; // moof offset of the latest tfra entry
+    bool missingDecodeTime = false; // a traf without tfdt: times only add up from the first fragment
+    Track tracks[kMaxTracks];
+    int trackCount = 0;
+
+    double EndMs() const;
+};
+
+/**
+ * @brief Reads the duration from container headers.
+ *
+ * - MP4/MOV: mvhd. Fragmented MP4 whose mvhd is zero: mehd, else the sidx
+ *   subsegment durations, else the last fragments located through mfra/tfra,
+ *   else a walk over every moof (traf/tfdt/trun), stepping over mdat by size.
+ * - Matroska/WebM: Segment Info, found through the SeekHead.
+ * - AVI: avih frame count x frame period (OpenDML dmlh for files past 1 GB).
+ * - ASF/WMV: File Properties play duration minus preroll.
+ * - FLV: onMetaData duration, else the timestamp of the last tag.
+ * - Ogg: granule position of the last page of the first stream, from a bounded tail read.
+ * - MPEG-TS/M2TS: first and last PCR (or PTS) from bounded head and tail reads.
+ *
+ * The first read is the file head, which is also sniffed, so files of any other
+ * kind fail after a single small read.
+ */
+class DurationProbe : public HeaderProbe
+{
+public:
+    ProbeStep Start(uint64_t fileSize) override;
+    ProbeStep OnData(uint64_t offset, const uint8_t *data, size_t length) override;
+
+    ContainerKind Container() const { return container_; }
+    double DurationMs() const { return durationMs_; }
+    DurationMethod Method() const { return method_; }
+    uint32_t Reads() const { return reads_; }
+    uint64_t BytesRead() const { return bytesRead_; }
+
+    // Size of the first read, and of each hop past a box or element too large to buffer.
+    static constexpr uint32_t kHeadBytes = 16 * 1024;
+    // Bound on the Ogg tail read and on each end of a transport stream.
+    static constexpr uint32_t kTailBytes = 64 * 1024;
+
+private:
+    ProbeStep ScanBoxes(uint64_t offset, const uint8_t *data, size_t length);
+    ProbeStep ScanSegment(uint64_t offset, const uint8_t *data, size_t length);
+    ProbeStep ScanFragments(uint64_t offset, const uint8_t *data, size_t length);
+    ProbeStep OnRandomAccess(uint64_t offset, const uint8_t *data, size_t length);
+    ProbeStep ScanAsf(uint64_t offset, const uint8_t *data, size_t length);
+    ProbeStep StartFlv(const uint8_t *data, size_t length);
+    ProbeStep OnFlvTail(uint64_t offset, const uint8_t *data, size_t length);
+    ProbeStep StartOgg(const uint8_t *data, size_t length);
+    ProbeStep OnOggTail(const uint8_t *data, size_t length);
+    ProbeStep ScanTransport(uint64_t offset, const uint8_t *data, size_t length);
+    ProbeStep ReadNext(uint64_t offset, uint64_t length, uint64_t limit = kHeadBytes);
+    ProbeStep FinishWith(double durationMs, DurationMethod method = DurationMethod::Header);
+
+    enum class State : uint8_t
+    {
+        Head,
+        Mp4Boxes,
+        Mp4Fragments,         // after moov, before the first moof: sidx?
+        Mp4RandomAccess,      // mfro at the end of the file
+        Mp4RandomAccessTable, // mfra
+        Mp4FragmentWalk,
+        MatroskaSegment,
+        AsfHeader,
+        FlvTail,
+        FlvLastTag,
+        OggTail,
+        TransportHead,
+        TransportTail,
+    } state_ = State::Head;
+
+    // Ogg: how the first stream's granule positions map to time
+    struct OggClock
+    {
+        uint32_t serial = 0;
+        double granuleRate = 0.0;   // granules per second
+        uint64_t granuleOffset = 0; // Opus pre-skip
+        uint8_t granuleShift = 0;   // Theora: keyframe number above this bit
+    };
+
+    // MPEG-TS: timestamps from the head, and their furthest distance seen in the tail (90 kHz ticks)
+    struct TransportClock
+    {
+        static constexpr int kMaxPids = 8;
+        uint32_t packetSize = 188;
+        int32_t pcrPid = -1;
+        uint64_t firstPcr = 0;
+        uint64_t pcrSpan = 0;
+        bool hasPcrSpan = false;
+        uint16_t ptsPids[kMaxPids] = {};
+        uint64_t firstPts[kMaxPids] = {};
+        uint64_t ptsSpan[kMaxPids] = {};
+        int ptsCount = 0;
+        uint64_t scanned = 0; // head bytes looked at
+    };
+
+    ContainerKind container_ = ContainerKind::Unknown;
+    uint64_t fileSize_ = 0;
+    uint64_t cursor_ = 0;          // next top-level box / element
+    uint64_t segmentStart_ = 0;    // Matroska Segment payload; SeekHead positions are relative to it
+    uint64_t infoPosition_ = 0;    // Info element offset learned from SeekHead, 0 if unknown
+    bool jumpedToInfo_ = false;
+    uint64_t regionEnd_ = 0; // ASF: end of the Header Object
+    uint64_t firstFragment_ = 0;
+    bool jumpedToRandomAccess_ = false;
+    FragmentClock fragments_;
+    OggClock ogg_;
+    TransportClock transport_;
+    double durationMs_ = 0.0;
+    DurationMethod method_ = DurationMethod::None;
+    uint32_t readLimit_ = 0;
+    uint32_t reads_ = 0;
+    uint64_t bytesRead_ = 0;
+};
+
+/**
+ * @brief Runs a probe to completion against a ByteSource.
+ *
+ * Ranges are handed over without a copy when the source can view them
+ * (memory map, memory buffer).
+ *
+ * @return The final step: Done or Failed
+ */
+ProbeStep RunProbe(HeaderProbe &probe, ByteSource &source);
+
+#endif // MEDIA_PROBE_H
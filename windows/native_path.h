@@ -0,0 +1,25 @@
+#ifndef NATIVE_PATH_H
+#define NATIVE_PATH_H
+
+#include <string>
+#include <string_view>
+
+// Paths are handed to the OS in its own encoding: UTF-16 (wchar_t) on Windows,
+// UTF-8 bytes everywhere else. Using wchar_t on Linux would mean 32-bit code units.
+// PATH_CERR logs them; a wide write to stderr off Windows would silence every later narrow one.
+#ifdef _WIN32
+typedef wchar_t PathChar;
+#define PATH_LITERAL(x) L##x
+#define PATH_CERR std::wcerr
+constexpr PathChar kPathSeparator = L'\\';
+#else
+typedef char PathChar;
+#define PATH_LITERAL(x) x
+#define PATH_CERR std::cerr
+constexpr PathChar kPathSeparator = '/';
+#endif
+
+typedef std::basic_string<PathChar> NativePath;
+typedef std::basic_string_view<PathChar> NativePathView;
+
+#endif // NATIVE_PATH_H
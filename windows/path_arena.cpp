@@ -0,0 +1,135 @@
+#include "path_arena.h"
+#include "utf_transcode.h"
+#include <algorithm>
+#include <cstring>
+#include <mutex>
+
+PathArena &PathArena::Instance()
+{
+    static PathArena arena;
+    return arena;
+}
+
+void PathArena::Normalize(NativePath &path)
+{
+#ifdef _WIN32
+    // Quotes are illegal in Windows paths but show up when users paste from Explorer
+    path.erase(std::remove(path.begin(), path.end(), L'"'), path.end());
+    std::replace(path.begin(), path.end(), L'/', L'\\');
+    // Keep the leading "\\" of UNC and "\\?\" paths
+    const size_t keep = (path.size() >= 2 && path[0] == L'\\' && path[1] == L'\\') ? 2 : 0;
+#else
+    const size_t keep = 0;
+#endif
+
+    // Collapse repeated separators
+    size_t out = keep;
+    for (size_t i = keep; i < path.size(); i++)
+    {
+        if (path[i] == kPathSeparator && out > keep && path[out - 1] == kPathSeparator) continue;
+        path[out++] = path[i];
+    }
+    path.resize(out);
+
+    // Drop a trailing separator unless it is the root ("/", "C:\")
+    if (path.size() > 1 && path.back() == kPathSeparator)
+    {
+#ifdef _WIN32
+        const bool isDriveRoot = path.size() == 3 && path[1] == L':';
+#else
+        const bool isDriveRoot = false;
+#endif
+        if (!isDriveRoot) path.pop_back();
+    }
+
+#ifdef _WIN32
+    // Same rule as the Dart PathUtils: paths past MAX_PATH need the extended-length prefix
+    if (path.size() > 260 && path.compare(0, 4, L"\\\\?\\") != 0)
+    {
+        if (path.size() > 2 && path[1] == L':')
+            path.insert(0, L"\\\\?\\");
+        else if (keep == 2)
+            path.replace(0, 2, L"\\\\?\\UNC\\");
+    }
+#endif
+}
+
+uint32_t PathArena::InternUtf8(const char *utf8, size_t length)
+{
+    if (utf8 == nullptr) return kInvalidPathId;
+    NativePath path = Utf8ToNativePath(utf8, length);
+    Normalize(path);
+    return InternNormalized(path);
+}
+
+uint32_t PathArena::Intern(NativePathView view)
+{
+    NativePath path(view);
+    Normalize(path);
+    return InternNormalized(path);
+}
+
+uint32_t PathArena::InternNormalized(NativePathView path)
+{
+    if (path.empty() || path.size() >= UINT32_MAX) return kInvalidPathId;
+
+    {
+        std::shared_lock<std::shared_mutex> lock(mutex_);
+        auto it = index_.find(path);
+        if (it != index_.end()) return it->second;
+    }
+
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    // Another thread may have interned it between the two locks
+    auto it = index_.find(path);
+    if (it != index_.end()) return it->second;
+    if (entries_.size() >= kInvalidPathId) return kInvalidPathId;
+
+    const size_t needed = path.size() + 1;
+    if (chunks_.empty() || chunkCapacity_ - chunkUsed_ < needed)
+    {
+        // Oversized paths get a chunk of their own so they never waste a shared one
+        chunkCapacity_ = std::max(kChunkChars, needed);
+        chunks_.emplace_back(new PathChar[chunkCapacity_]);
+        chunkUsed_ = 0;
+        reservedChars_ += chunkCapacity_;
+    }
+
+    PathChar *dst = chunks_.back().get() + chunkUsed_;
+    std::memcpy(dst, path.data(), path.size() * sizeof(PathChar));
+    dst[path.size()] = 0;
+    chunkUsed_ += needed;
+
+    const uint32_t id = static_cast<uint32_t>(entries_.size());
+    entries_.push_back({dst, static_cast<uint32_t>(path.size())});
+    index_.emplace(NativePathView(dst, path.size()), id);
+    return id;
+}
+
+bool PathArena::Get(uint32_t id, NativePathView *path) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (id >= entries_.size()) return false;
+    const Entry &entry = entries_[id];
+    *path = NativePathView(entry.data, entry.length);
+    return true;
+}
+
+NativePath PathArena::Path(uint32_t id) const
+{
+    NativePathView view;
+    if (!Get(id, &view)) return NativePath();
+    return NativePath(view);
+}
+
+size_t PathArena::Count() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return entries_.size();
+}
+
+size_t PathArena::ReservedBytes() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return reservedChars_ * sizeof(PathChar);
+}
@@ -0,0 +1,69 @@
+#ifndef PATH_ARENA_H
+#define PATH_ARENA_H
+
+#include "native_path.h"
+#include <cstdint>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+constexpr uint32_t kInvalidPathId = 0xFFFFFFFFu;
+
+/**
+ * @brief Process-wide store of interned, normalized paths.
+ *
+ * Paths are appended to large NUL-terminated chunks and never move, so the
+ * pointer returned for an ID stays valid for the lifetime of the process and can
+ * be passed straight to OS calls or read from Dart. Interning the same path
+ * twice returns the same ID.
+ */
+class PathArena
+{
+public:
+    static PathArena &Instance();
+
+    // Normalizes and interns a UTF-8 path coming over FFI.
+    uint32_t InternUtf8(const char *utf8, size_t length);
+
+    // Normalizes and interns a path already in the native encoding.
+    uint32_t Intern(NativePathView path);
+
+    // Returns false for unknown IDs. The view is NUL-terminated.
+    bool Get(uint32_t id, NativePathView *path) const;
+
+    // Convenience copy of Get(); empty for unknown IDs.
+    NativePath Path(uint32_t id) const;
+
+    size_t Count() const;
+
+    // Bytes held by the chunks, including unused tail space.
+    size_t ReservedBytes() const;
+
+    // Applies the same normalization Intern() uses.
+    static void Normalize(NativePath &path);
+
+private:
+    PathArena() = default;
+
+    uint32_t InternNormalized(NativePathView path);
+
+    struct Entry
+    {
+        const PathChar *data;
+        uint32_t length;
+    };
+
+    static constexpr size_t kChunkChars = 64 * 1024;
+
+    mutable std::shared_mutex mutex_;
+    std::vector<std::unique_ptr<PathChar[]>> chunks_;
+    size_t chunkUsed_ = 0;
+    size_t chunkCapacity_ = 0;
+    size_t reservedChars_ = 0;
+    std::vector<Entry> entries_;
+    std::unordered_map<NativePathView, uint32_t> index_;
+};
+
+#endif // PATH_ARENA_H
@@ -0,0 +1,140 @@
+#include "perceptual_hash.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+#define VDU_HAVE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace
+{
+    constexpr uint32_t kDctSize = 32;
+    constexpr uint32_t kLowFrequencies = 8;
+
+    // DCT-II basis rows of the frequencies the hash keeps; the scale factors cancel out in the median test
+    struct DctBasis
+    {
+        alignas(16) float rows[kLowFrequencies][kDctSize];
+
+        DctBasis()
+        {
+            const double pi = std::acos(-1.0);
+            for (uint32_t k = 0; k < kLowFrequencies; k++)
+                for (uint32_t n = 0; n < kDctSize; n++)
+                    rows[k][n] = static_cast<float>(std::cos(pi * (2 * n + 1) * k / (2.0 * kDctSize)));
+        }
+    };
+
+    const DctBasis &Basis()
+    {
+        static const DctBasis basis;
+        return basis;
+    }
+
+    // Both operands are 16-byte aligned rows of kDctSize floats
+    float Dot32(const float *a, const float *b)
+    {
+#ifdef VDU_HAVE_SSE
+        __m128 s0 = _mm_setzero_ps(), s1 = _mm_setzero_ps(), s2 = _mm_setzero_ps(), s3 = _mm_setzero_ps();
+        for (uint32_t i = 0; i < kDctSize; i += 16)
+        {
+            s0 = _mm_add_ps(s0, _mm_mul_ps(_mm_load_ps(a + i), _mm_load_ps(b + i)));
+            s1 = _mm_add_ps(s1, _mm_mul_ps(_mm_load_ps(a + i + 4), _mm_load_ps(b + i + 4)));
+            s2 = _mm_add_ps(s2, _mm_mul_ps(_mm_load_ps(a + i + 8), _mm_load_ps(b + i + 8)));
+            s3 = _mm_add_ps(s3, _mm_mul_ps(_mm_load_ps(a + i + 12), _mm_load_ps(b + i + 12)));
+        }
+        alignas(16) float lanes[4];
+        _mm_store_ps(lanes, _mm_add_ps(_mm_add_ps(s0, s1), _mm_add_ps(s2, s3)));
+        return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#else
+        float sum = 0.0f;
+        for (uint32_t i = 0; i < kDctSize; i++) sum += a[i] * b[i];
+        return sum;
+#endif
+    }
+
+    // Mean BT.601 luma of each cell of an outWidth x outHeight grid laid over the image.
+    // Cells never get empty, so images smaller than the grid are stretched.
+    void ReduceLuma(const uint8_t *bgra, uint32_t width, uint32_t height, uint32_t stride, uint32_t outWidth, uint32_t outHeight,
+                    float *out)
+    {
+        ScratchArena &scratch = ScratchArena::ForThread();
+        uint32_t *columnStart = static_cast<uint32_t *>(scratch.Allocate(sizeof(uint32_t) * (outWidth + 1)));
+        for (uint32_t x = 0; x <= outWidth; x++) columnStart[x] = static_cast<uint32_t>(uint64_t(x) * width / outWidth);
+
+        uint64_t *sums = static_cast<uint64_t *>(scratch.Allocate(sizeof(uint64_t) * outWidth));
+        for (uint32_t y = 0; y < outHeight; y++)
+        {
+            const uint32_t y0 = static_cast<uint32_t>(uint64_t(y) * height / outHeight);
+            const uint32_t y1 = std::max(y0 + 1, static_cast<uint32_t>(uint64_t(y + 1) * height / outHeight));
+            std::fill(sums, sums + outWidth, 0);
+            for (uint32_t row = y0; row < y1; row++)
+            {
+                const uint8_t *line = bgra + static_cast<size_t>(row) * stride;
+                for (uint32_t x = 0; x < outWidth; x++)
+                {
+                    const uint32_t x1 = std::max(columnStart[x] + 1, columnStart[x + 1]);
+                    uint64_t sum = 0;
+                    for (const uint8_t *p = line + columnStart[x] * 4, *end = line + x1 * 4; p < end; p += 4)
+                        sum += 29u * p[0] + 150u * p[1] + 77u * p[2];
+                    sums[x] += sum;
+                }
+            }
+            for (uint32_t x = 0; x < outWidth; x++)
+            {
+                const uint32_t x1 = std::max(columnStart[x] + 1, columnStart[x + 1]);
+                const uint64_t pixels = uint64_t(x1 - columnStart[x]) * (y1 - y0);
+                out[y * outWidth + x] = static_cast<float>(sums[x]) / (256.0f * static_cast<float>(pixels));
+            }
+        }
+    }
+
+    uint64_t DifferenceHash(const uint8_t *bgra, uint32_t width, uint32_t height, uint32_t stride)
+    {
+        float cells[8][9];
+        ReduceLuma(bgra, width, height, stride, 9, 8, &cells[0][0]);
+        uint64_t hash = 0;
+        for (uint32_t y = 0; y < 8; y++)
+            for (uint32_t x = 0; x < 8; x++)
+                if (cells[y][x] < cells[y][x + 1]) hash |= 1ull << (y * 8 + x);
+        return hash;
+    }
+
+    uint64_t DctHash(const uint8_t *bgra, uint32_t width, uint32_t height, uint32_t stride)
+    {
+        alignas(16) float pixels[kDctSize][kDctSize];
+        ReduceLuma(bgra, width, height, stride, kDctSize, kDctSize, &pixels[0][0]);
+
+        // Separable DCT: transform the rows, keeping them transposed so the column
+        // pass is again a dot product of contiguous rows
+        const DctBasis &basis = Basis();
+        alignas(16) float rowPass[kLowFrequencies][kDctSize];
+        for (uint32_t k = 0; k < kLowFrequencies; k++)
+            for (uint32_t y = 0; y < kDctSize; y++) rowPass[k][y] = Dot32(basis.rows[k], pixels[y]);
+
+        float coefficients[kLowFrequencies * kLowFrequencies];
+        for (uint32_t v = 0; v < kLowFrequencies; v++)
+            for (uint32_t u = 0; u < kLowFrequencies; u++) coefficients[v * kLowFrequencies + u] = Dot32(basis.rows[v], rowPass[u]);
+
+        float sorted[kLowFrequencies * kLowFrequencies];
+        std::copy(std::begin(coefficients), std::end(coefficients), sorted);
+        std::sort(std::begin(sorted), std::end(sorted));
+        const float median = (sorted[31] + sorted[32]) * 0.5f;
+
+        uint64_t hash = 0;
+        for (uint32_t i = 0; i < 64; i++)
+            if (coefficients[i] > median) hash |= 1ull << i;
+        return hash;
+    }
+}
+
+bool ComputeImageHashes(const uint8_t *bgra, uint32_t width, uint32_t height, uint32_t stride, uint64_t *dhash, uint64_t *phash)
+{
+    if (bgra == nullptr || width == 0 || height == 0 || stride < uint64_t(width) * 4) return false;
+    ScratchArena::Scope scratch;
+    if (dhash != nullptr) *dhash = DifferenceHash(bgra, width, height, stride);
+    if (phash != nullptr) *phash = DctHash(bgra, width, height, stride);
+    return true;
+}
@@ -0,0 +1,40 @@
+#ifndef PERCEPTUAL_HASH_H
+#define PERCEPTUAL_HASH_H
+
+#include <cstdint>
+
+#if defined(_MSC_VER) && defined(_M_X64)
+#include <intrin.h>
+#elif !defined(__GNUC__)
+#include <bitset>
+#endif
+
+/**
+ * @brief 64-bit perceptual hashes of a BGRA image.
+ *
+ * Both hashes work on a grayscale, area-averaged reduction of the image, so a
+ * re-encode, a rescale or a small brightness change of the same frame lands
+ * within a few bits while unrelated frames differ in about half of them.
+ *
+ * - dHash: 9x8 reduction; one bit per horizontal neighbour pair (left < right).
+ *   Cheap, sensitive to crops.
+ * - pHash: 32x32 reduction, 2-D DCT-II, 8x8 lowest frequencies compared with
+ *   their median. Tolerates recompression and gamma changes better.
+ *
+ * @param stride bytes per row, at least width * 4
+ * @return false for an empty image or null arguments
+ */
+bool ComputeImageHashes(const uint8_t *bgra, uint32_t width, uint32_t height, uint32_t stride, uint64_t *dhash, uint64_t *phash);
+
+inline uint32_t HammingDistance(uint64_t a, uint64_t b)
+{
+#if defined(_MSC_VER) && defined(_M_X64)
+    return static_cast<uint32_t>(__popcnt64(a ^ b));
+#elif defined(__GNUC__)
+    return static_cast<uint32_t>(__builtin_popcountll(a ^ b));
+#else
+    return static_cast<uint32_t>(std::bitset<64>(a ^ b).count());
+#endif
+}
+
+#endif // PERCEPTUAL_HASH_H
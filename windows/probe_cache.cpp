@@ -0,0 +1,100 @@
+#include "probe_cache.h"
+#include "file_identity.h"
+#include "path_arena.h"
+
+bool PathIsUnder(NativePathView path, NativePathView directory)
+{
+    if (directory.empty() || path.size() < directory.size()) return false;
+    if (path.compare(0, directory.size(), directory) != 0) return false;
+    return path.size() == directory.size() || directory.back() == kPathSeparator || path[directory.size()] == kPathSeparator;
+}
+
+ProbeCache &ProbeCache::Instance()
+{
+    static ProbeCache cache;
+    return cache;
+}
+
+std::shared_ptr<ProbeEntry> ProbeCache::FindLocked(uint32_t pathId)
+{
+    auto it = entries_.find(pathId);
+    if (it != entries_.end()) return it->second;
+    for (const uint32_t sibling : FileIdentityIndex::Instance().Siblings(pathId))
+    {
+        auto shared = entries_.find(sibling);
+        if (shared == entries_.end()) continue;
+        entries_.emplace(pathId, shared->second);
+        FileIdentityIndex::Instance().NoteShared(SharedWork::Entry, static_cast<uint64_t>(shared->second->metadata.file_size_bytes));
+        return shared->second;
+    }
+    return nullptr;
+}
+
+bool ProbeCache::Lookup(uint32_t pathId, ProbeEntry *entry)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    const std::shared_ptr<ProbeEntry> found = FindLocked(pathId);
+    if (!found) return false;
+    *entry = *found;
+    return true;
+}
+
+void ProbeCache::Store(uint32_t pathId, const ProbeEntry &entry)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[pathId] = std::make_shared<ProbeEntry>(entry);
+}
+
+void ProbeCache::Update(uint32_t pathId, const FileMetadata &current, const std::function<void(ProbeEntry &)> &update)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::shared_ptr<ProbeEntry> entry = FindLocked(pathId);
+    if (!entry || !ProbeEntryMatches(*entry, current))
+    {
+        // A mismatch on a shared entry may mean this path was replaced rather than the file
+        // changed, so the other paths keep theirs and revalidate it themselves
+        entry = std::make_shared<ProbeEntry>();
+        entry->metadata = current;
+        entries_[pathId] = entry;
+    }
+    update(*entry);
+}
+
+bool ProbeCache::Invalidate(uint32_t pathId)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.erase(pathId) > 0;
+}
+
+size_t ProbeCache::InvalidateUnder(NativePathView directory)
+{
+    PathArena &arena = PathArena::Instance();
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t removed = 0;
+    for (auto it = entries_.begin(); it != entries_.end();)
+    {
+        NativePathView path;
+        if (arena.Get(it->first, &path) && PathIsUnder(path, directory))
+        {
+            it = entries_.erase(it);
+            removed++;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+size_t ProbeCache::Size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+void ProbeCache::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+}
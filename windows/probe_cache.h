@@ -0,0 +1,80 @@
+#ifndef PROBE_CACHE_H
+#define PROBE_CACHE_H
+
+#include "bitrate_timeline.h"
+#include "content_sniffer.h"
+#include "keyframe_index.h"
+#include "native_path.h"
+#include "shell_link.h"
+#include "video_data_exporter_api.h"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+/**
+ * @brief Probe results for one file, keyed by path ID.
+ *
+ * The size and modification time the result was computed against travel with
+ * it, so a lookup can be validated against a fresh stat. Paths that
+ * FileIdentityIndex knows as one file share a single entry.
+ */
+struct ProbeEntry
+{
+    FileMetadata metadata = {};
+    double duration_ms = 0.0;
+    bool has_duration = false;
+    ContainerKind container = ContainerKind::Unknown; // from the duration probe
+    std::shared_ptr<const KeyframeIndex> keyframes; // built on first request; may be empty
+    std::shared_ptr<const BitrateTimeline> bitrate; // the last one requested, at its bucket width
+    uint64_t thumbnail_dhash = 0;
+    uint64_t thumbnail_phash = 0;
+    bool has_thumbnail_hashes = false;
+    std::shared_ptr<const ShellLinkTargets> shortcut; // parsed .lnk; targets are empty if it could not be read
+};
+
+// True if @p entry was computed against the file state in @p current.
+inline bool ProbeEntryMatches(const ProbeEntry &entry, const FileMetadata &current)
+{
+    return entry.metadata.file_size_bytes == current.file_size_bytes &&
+           entry.metadata.modified_time_ms == current.modified_time_ms;
+}
+
+class ProbeCache
+{
+public:
+    static ProbeCache &Instance();
+
+    // A path without an entry takes over the entry of another path of the same file.
+    bool Lookup(uint32_t pathId, ProbeEntry *entry);
+    void Store(uint32_t pathId, const ProbeEntry &entry);
+
+    // Applies @p update to the entry for @p current, starting from an empty one if
+    // the cached entry was computed against another state of the file, so results
+    // probed separately accumulate without mixing versions. An entry shared with
+    // other paths of the file is left to them when it does not match.
+    void Update(uint32_t pathId, const FileMetadata &current, const std::function<void(ProbeEntry &)> &update);
+
+    bool Invalidate(uint32_t pathId);
+
+    // Drops every entry at or below @p directory. Returns the number removed.
+    size_t InvalidateUnder(NativePathView directory);
+
+    size_t Size() const;
+    void Clear();
+
+private:
+    ProbeCache() = default;
+
+    // The entry of @p pathId, or of another path of its file, which it then shares; null if neither has one.
+    std::shared_ptr<ProbeEntry> FindLocked(uint32_t pathId);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint32_t, std::shared_ptr<ProbeEntry>> entries_;
+};
+
+// True if @p path equals @p directory or lies beneath it.
+bool PathIsUnder(NativePathView path, NativePathView directory);
+
+#endif // PROBE_CACHE_H
@@ -0,0 +1,1020 @@
+#include "probe_daemon.h"
+#include "byte_source.h"
+#include "path_arena.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#ifdef _WIN32
+#include <windows.h>
+#include "thumbnail_exporter.h"
+#else
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    thread_local bool localOnly = false;
+
+    // After a failed connect, calls run locally without trying again for this long
+    constexpr std::chrono::seconds kRetryInterval{2};
+
+    // Longest a call waits for its answer before the daemon is taken for stalled. Rendering a
+    // thumbnail may go through a slow shell extension; reading a header should not take long.
+    std::chrono::milliseconds CallTimeout(DaemonOp op)
+    {
+        switch (op)
+        {
+        case DaemonOp::Hello:
+            return std::chrono::seconds(2);
+        case DaemonOp::Thumbnail:
+        case DaemonOp::ThumbnailPixels:
+            return std::chrono::seconds(30);
+        default:
+            return std::chrono::seconds(10);
+        }
+    }
+
+    uint32_t CurrentPid()
+    {
+#ifdef _WIN32
+        return GetCurrentProcessId();
+#else
+        return static_cast<uint32_t>(getpid());
+#endif
+    }
+
+    void Append(std::vector<uint8_t> *out, const void *data, size_t bytes)
+    {
+        const uint8_t *begin = static_cast<const uint8_t *>(data);
+        out->insert(out->end(), begin, begin + bytes);
+    }
+
+    void AppendPath(std::vector<uint8_t> *out, const NativePath &path) { Append(out, path.data(), path.size() * sizeof(PathChar)); }
+
+    // The daemon has its own working directory, so relative paths are resolved against the caller's
+    NativePath AbsolutePath(const PathChar *path)
+    {
+        std::error_code error;
+        const std::filesystem::path absolute = std::filesystem::absolute(path, error);
+        return error ? NativePath(path) : absolute.native();
+    }
+
+    // A path payload must be whole code units; the result is NUL-terminated for the exports
+    bool ReadPath(const uint8_t *data, size_t bytes, NativePath *path)
+    {
+        if (bytes == 0 || bytes % sizeof(PathChar) != 0) return false;
+        path->assign(bytes / sizeof(PathChar), 0);
+        std::memcpy(&(*path)[0], data, bytes);
+        return path->find(PathChar(0)) == NativePath::npos;
+    }
+
+    bool ReadU32(const std::vector<uint8_t> &payload, size_t offset, uint32_t *value)
+    {
+        if (payload.size() < offset + sizeof(uint32_t)) return false;
+        std::memcpy(value, payload.data() + offset, sizeof(uint32_t));
+        return true;
+    }
+}
+
+// === Channels ===
+
+/**
+ * @brief One connected stream between a client and the daemon.
+ *
+ * Reads happen on one thread; writes come from many and are serialized here so
+ * frames never interleave. Shutdown makes a blocked read return false.
+ */
+class DaemonChannel
+{
+public:
+#ifdef _WIN32
+    explicit DaemonChannel(HANDLE pipe) : pipe_(pipe), closed_(CreateEventW(nullptr, TRUE, FALSE, nullptr)) {}
+    ~DaemonChannel()
+    {
+        CloseHandle(pipe_);
+        CloseHandle(closed_);
+    }
+#else
+    explicit DaemonChannel(int fd) : fd_(fd) {}
+    ~DaemonChannel() { close(fd_); }
+#endif
+
+    DaemonChannel(const DaemonChannel &) = delete;
+    DaemonChannel &operator=(const DaemonChannel &) = delete;
+
+    // Receives exactly @p bytes; an fd passed along with them lands in @p passed (Linux)
+    bool ReadFull(void *data, size_t bytes, intptr_t *passed)
+    {
+        uint8_t *out = static_cast<uint8_t *>(data);
+        while (bytes > 0)
+        {
+#ifdef _WIN32
+            (void)passed;
+            const DWORD got = Transfer(false, out, static_cast<DWORD>(std::min<size_t>(bytes, 1 << 20)));
+            if (got == 0) return false;
+#else
+            iovec iov = {out, bytes};
+            alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))];
+            msghdr message = {};
+            message.msg_iov = &iov;
+            message.msg_iovlen = 1;
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            const ssize_t got = recvmsg(fd_, &message, MSG_CMSG_CLOEXEC);
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) return false;
+            for (cmsghdr *header = CMSG_FIRSTHDR(&message); header != nullptr; header = CMSG_NXTHDR(&message, header))
+            {
+                if (header->cmsg_level != SOL_SOCKET || header->cmsg_type != SCM_RIGHTS) continue;
+                int fd;
+                std::memcpy(&fd, CMSG_DATA(header), sizeof(fd));
+                if (passed != nullptr && *passed < 0) *passed = fd;
+                else close(fd);
+            }
+#endif
+            out += got;
+            bytes -= static_cast<size_t>(got);
+        }
+        return true;
+    }
+
+    // Sends the frame and its payload as one unit; @p passed (an fd, Linux) rides along with the header
+    bool WriteFrame(const DaemonFrame &frame, const uint8_t *payload, intptr_t passed = -1)
+    {
+        std::lock_guard<std::mutex> lock(writeMutex_);
+#ifdef _WIN32
+        (void)passed;
+        // One buffer, so small frames go out in one pipe write
+        std::vector<uint8_t> buffer(sizeof(frame) + frame.payload_bytes);
+        std::memcpy(buffer.data(), &frame, sizeof(frame));
+        if (frame.payload_bytes > 0) std::memcpy(buffer.data() + sizeof(frame), payload, frame.payload_bytes);
+        for (size_t sent = 0; sent < buffer.size();)
+        {
+            const DWORD wrote = Transfer(true, buffer.data() + sent, static_cast<DWORD>(buffer.size() - sent));
+            if (wrote == 0) return false;
+            sent += wrote;
+        }
+        return true;
+#else
+        iovec iov[2] = {{const_cast<DaemonFrame *>(&frame), sizeof(frame)}, {const_cast<uint8_t *>(payload), frame.payload_bytes}};
+        alignas(cmsghdr) char control[CMSG_SPACE(sizeof(int))] = {};
+        msghdr message = {};
+        message.msg_iov = iov;
+        message.msg_iovlen = frame.payload_bytes > 0 ? 2 : 1;
+        if (passed >= 0)
+        {
+            message.msg_control = control;
+            message.msg_controllen = sizeof(control);
+            cmsghdr *header = CMSG_FIRSTHDR(&message);
+            header->cmsg_level = SOL_SOCKET;
+            header->cmsg_type = SCM_RIGHTS;
+            header->cmsg_len = CMSG_LEN(sizeof(int));
+            const int fd = static_cast<int>(passed);
+            std::memcpy(CMSG_DATA(header), &fd, sizeof(fd));
+        }
+        while (message.msg_iovlen > 0)
+        {
+            const ssize_t sent = sendmsg(fd_, &message, MSG_NOSIGNAL);
+            if (sent < 0 && errno == EINTR) continue;
+            if (sent <= 0) return false;
+            // The fd went with the first bytes; the rest is plain data
+            message.msg_control = nullptr;
+            message.msg_controllen = 0;
+            size_t left = static_cast<size_t>(sent);
+            while (message.msg_iovlen > 0 && left >= message.msg_iov->iov_len)
+            {
+                left -= message.msg_iov->iov_len;
+                message.msg_iov++;
+                message.msg_iovlen--;
+            }
+            if (message.msg_iovlen > 0)
+            {
+                message.msg_iov->iov_base = static_cast<uint8_t *>(message.msg_iov->iov_base) + left;
+                message.msg_iov->iov_len -= left;
+            }
+        }
+        return true;
+#endif
+    }
+
+    void Shutdown()
+    {
+        closed = true;
+#ifdef _WIN32
+        SetEvent(closed_);
+#else
+        shutdown(fd_, SHUT_RDWR);
+#endif
+    }
+
+#ifdef _WIN32
+    // The client's process, to duplicate shared memory handles into
+    uint32_t PeerPid() const
+    {
+        ULONG pid = 0;
+        GetNamedPipeClientProcessId(pipe_, &pid);
+        return pid;
+    }
+#endif
+
+    std::atomic<bool> closed{false};
+    std::atomic<bool> stalled{false}; // dropped because an answer did not come in time
+
+private:
+#ifdef _WIN32
+    // Overlapped, so the reader and the writers can each have one operation pending on the pipe
+    DWORD Transfer(bool write, void *data, DWORD bytes)
+    {
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        DWORD done = 0;
+        BOOL ok = write ? WriteFile(pipe_, data, bytes, nullptr, &overlapped) : ReadFile(pipe_, data, bytes, nullptr, &overlapped);
+        if (ok || GetLastError() == ERROR_IO_PENDING)
+        {
+            HANDLE events[2] = {overlapped.hEvent, closed_};
+            if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0) CancelIoEx(pipe_, &overlapped);
+            ok = GetOverlappedResult(pipe_, &overlapped, &done, TRUE);
+        }
+        CloseHandle(overlapped.hEvent);
+        return ok ? done : 0;
+    }
+
+    HANDLE pipe_;
+    HANDLE closed_;
+#else
+    int fd_;
+#endif
+    std::mutex writeMutex_;
+};
+
+namespace
+{
+#ifndef _WIN32
+    // Whoever created the socket file first answers on it; in /tmp that may be another user
+    bool OwnPeer(int fd)
+    {
+#ifdef __linux__
+        ucred peer = {};
+        socklen_t length = sizeof(peer);
+        return getsockopt(fd, SOL_SOCKET, SO_PEERCRED, &peer, &length) == 0 && peer.uid == geteuid();
+#else
+        uid_t uid;
+        gid_t gid;
+        return getpeereid(fd, &uid, &gid) == 0 && uid == geteuid();
+#endif
+    }
+#endif
+
+    std::shared_ptr<DaemonChannel> ConnectChannel(const NativePath &endpoint)
+    {
+#ifdef _WIN32
+        for (int attempt = 0; attempt < 2; attempt++)
+        {
+            HANDLE pipe = CreateFileW(endpoint.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, FILE_FLAG_OVERLAPPED, nullptr);
+            if (pipe != INVALID_HANDLE_VALUE) return std::make_shared<DaemonChannel>(pipe);
+            // Every instance busy: the daemon is about to create the next one
+            if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeW(endpoint.c_str(), 100)) return nullptr;
+        }
+        return nullptr;
+#else
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (endpoint.empty() || endpoint.size() >= sizeof(address.sun_path)) return nullptr;
+        std::memcpy(address.sun_path, endpoint.data(), endpoint.size());
+        const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0) return nullptr;
+        if (connect(fd, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0 || !OwnPeer(fd))
+        {
+            close(fd);
+            return nullptr;
+        }
+        return std::make_shared<DaemonChannel>(fd);
+#endif
+    }
+}
+
+/**
+ * @brief Accepts connections on the daemon's endpoint.
+ *
+ * A Unix socket file on Linux, removed again on close; on Windows a named pipe
+ * with one instance waiting for the next client at any time.
+ */
+class DaemonListener
+{
+public:
+    explicit DaemonListener(NativePath endpoint) : endpoint_(std::move(endpoint)) {}
+    ~DaemonListener() { Close(); }
+
+    bool Bind()
+    {
+#ifdef _WIN32
+        stop_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        // The first instance claims the name; a second daemon fails here
+        next_ = CreateInstance(true);
+        return next_ != INVALID_HANDLE_VALUE;
+#else
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (endpoint_.empty() || endpoint_.size() >= sizeof(address.sun_path)) return false;
+        std::memcpy(address.sun_path, endpoint_.data(), endpoint_.size());
+        fd_ = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd_ < 0) return false;
+        if (bind(fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            // A socket file nobody answers on is left over from a daemon that died
+            if (errno != EADDRINUSE || ConnectChannel(endpoint_) != nullptr || unlink(endpoint_.c_str()) != 0 ||
+                bind(fd_, reinterpret_cast<sockaddr *>(&address), sizeof(address)) != 0)
+            {
+                close(fd_);
+                fd_ = -1;
+                return false;
+            }
+        }
+        bound_ = true;
+        chmod(endpoint_.c_str(), 0600); // this user's processes only
+        return listen(fd_, 64) == 0;
+#endif
+    }
+
+    // Blocks until a client connects; null once closed
+    std::shared_ptr<DaemonChannel> Accept()
+    {
+#ifdef _WIN32
+        while (next_ != INVALID_HANDLE_VALUE)
+        {
+            OVERLAPPED overlapped = {};
+            overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+            BOOL connected = ConnectNamedPipe(next_, &overlapped);
+            DWORD error = connected ? ERROR_SUCCESS : GetLastError();
+            if (error == ERROR_IO_PENDING)
+            {
+                HANDLE events[2] = {overlapped.hEvent, stop_};
+                DWORD unused;
+                if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0) CancelIoEx(next_, &overlapped);
+                error = GetOverlappedResult(next_, &overlapped, &unused, TRUE) ? ERROR_SUCCESS : GetLastError();
+            }
+            CloseHandle(overlapped.hEvent);
+            if (WaitForSingleObject(stop_, 0) == WAIT_OBJECT_0) return nullptr;
+            if (error != ERROR_SUCCESS && error != ERROR_PIPE_CONNECTED) continue;
+
+            HANDLE pipe = next_;
+            next_ = CreateInstance(false);
+            return std::make_shared<DaemonChannel>(pipe);
+        }
+        return nullptr;
+#else
+        for (;;)
+        {
+            const int fd = accept4(fd_, nullptr, nullptr, SOCK_CLOEXEC);
+            if (fd >= 0) return std::make_shared<DaemonChannel>(fd);
+            if (errno != EINTR && errno != ECONNABORTED) return nullptr;
+        }
+#endif
+    }
+
+    // Wakes Accept and releases the endpoint
+    void Close()
+    {
+#ifdef _WIN32
+        if (stop_ != nullptr) SetEvent(stop_);
+#else
+        if (fd_ >= 0) shutdown(fd_, SHUT_RDWR);
+#endif
+    }
+
+    void Release()
+    {
+#ifdef _WIN32
+        if (next_ != INVALID_HANDLE_VALUE) CloseHandle(next_);
+        next_ = INVALID_HANDLE_VALUE;
+        if (stop_ != nullptr) CloseHandle(stop_);
+        stop_ = nullptr;
+#else
+        if (fd_ >= 0) close(fd_);
+        fd_ = -1;
+        if (bound_) unlink(endpoint_.c_str());
+        bound_ = false;
+#endif
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE CreateInstance(bool first)
+    {
+        return CreateNamedPipeW(endpoint_.c_str(), PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0),
+                                PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS, PIPE_UNLIMITED_INSTANCES,
+                                64 * 1024, 64 * 1024, 0, nullptr);
+    }
+
+    HANDLE next_ = INVALID_HANDLE_VALUE;
+    HANDLE stop_ = nullptr;
+#else
+    int fd_ = -1;
+    bool bound_ = false;
+#endif
+    NativePath endpoint_;
+};
+
+NativePath DefaultDaemonEndpoint()
+{
+#ifdef _WIN32
+    wchar_t user[256];
+    DWORD length = 256;
+    if (!GetUserNameW(user, &length)) return L"\\\\.\\pipe\\vdu-probed";
+    return L"\\\\.\\pipe\\vdu-probed-" + std::wstring(user);
+#else
+    const char *runtime = std::getenv("XDG_RUNTIME_DIR");
+    if (runtime != nullptr && runtime[0] != 0) return NativePath(runtime) + "/vdu-probed.sock";
+    return "/tmp/vdu-probed-" + std::to_string(getuid()) + ".sock";
+#endif
+}
+
+// === Shared pixels ===
+
+std::unique_ptr<SharedPixels> SharedPixels::Create(size_t bytes)
+{
+    if (bytes == 0) return nullptr;
+#ifdef _WIN32
+    HANDLE section = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE, static_cast<DWORD>(uint64_t(bytes) >> 32),
+                                        static_cast<DWORD>(bytes), nullptr);
+    if (section == nullptr) return nullptr;
+    void *view = MapViewOfFile(section, FILE_MAP_WRITE, 0, 0, bytes);
+    if (view == nullptr)
+    {
+        CloseHandle(section);
+        return nullptr;
+    }
+    return std::unique_ptr<SharedPixels>(new SharedPixels(reinterpret_cast<intptr_t>(section), static_cast<uint8_t *>(view), bytes));
+#else
+    const int fd = memfd_create("vdu-thumbnail", MFD_CLOEXEC);
+    if (fd < 0) return nullptr;
+    void *view = MAP_FAILED;
+    if (ftruncate(fd, static_cast<off_t>(bytes)) == 0) view = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED)
+    {
+        close(fd);
+        return nullptr;
+    }
+    return std::unique_ptr<SharedPixels>(new SharedPixels(fd, static_cast<uint8_t *>(view), bytes));
+#endif
+}
+
+std::unique_ptr<SharedPixels> SharedPixels::Adopt(intptr_t handle, size_t bytes)
+{
+#ifdef _WIN32
+    HANDLE section = reinterpret_cast<HANDLE>(handle);
+    void *view = bytes > 0 ? MapViewOfFile(section, FILE_MAP_READ, 0, 0, bytes) : nullptr;
+    if (view == nullptr)
+    {
+        CloseHandle(section);
+        return nullptr;
+    }
+#else
+    const int fd = static_cast<int>(handle);
+    struct stat st;
+    void *view = MAP_FAILED;
+    // A short file would fault on the last rows rather than fail here
+    if (bytes > 0 && fstat(fd, &st) == 0 && static_cast<uint64_t>(st.st_size) >= bytes)
+        view = mmap(nullptr, bytes, PROT_READ, MAP_SHARED, fd, 0);
+    if (view == MAP_FAILED)
+    {
+        close(fd);
+        return nullptr;
+    }
+#endif
+    return std::unique_ptr<SharedPixels>(new SharedPixels(handle, static_cast<uint8_t *>(view), bytes));
+}
+
+SharedPixels::~SharedPixels()
+{
+#ifdef _WIN32
+    UnmapViewOfFile(data_);
+    CloseHandle(reinterpret_cast<HANDLE>(handle_));
+#else
+    munmap(data_, size_);
+    close(static_cast<int>(handle_));
+#endif
+}
+
+ThumbnailRenderer DefaultThumbnailRenderer()
+{
+#ifdef _WIN32
+    return [](const PathChar *path, uint32_t size, PooledBuffer *bgra, uint32_t *width, uint32_t *height) {
+        UINT w = 0, h = 0;
+        if (!GetExplorerThumbnailPixels(path, size, bgra, &w, &h)) return false;
+        *width = w;
+        *height = h;
+        return true;
+    };
+#else
+    return nullptr;
+#endif
+}
+
+// === Server ===
+
+struct DaemonServer::Connection
+{
+    std::shared_ptr<DaemonChannel> channel;
+    std::thread reader;
+};
+
+DaemonServer::DaemonServer(DaemonServerOptions options) : options_(std::move(options))
+{
+    if (options_.endpoint.empty()) options_.endpoint = DefaultDaemonEndpoint();
+    if (!options_.renderer) options_.renderer = DefaultThumbnailRenderer();
+}
+
+DaemonServer::~DaemonServer() { Stop(); }
+
+bool DaemonServer::Start()
+{
+    if (listener_) return false;
+    auto listener = std::make_unique<DaemonListener>(options_.endpoint);
+    if (!listener->Bind())
+    {
+        listener->Release();
+        return false;
+    }
+    listener_ = std::move(listener);
+    stopping_ = false;
+    acceptor_ = std::thread(&DaemonServer::Accept, this);
+    return true;
+}
+
+void DaemonServer::Stop()
+{
+    if (!listener_) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    listener_->Close();
+    acceptor_.join();
+
+    std::vector<std::shared_ptr<Connection>> connections;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        connections.swap(connections_);
+    }
+    for (const auto &connection : connections)
+    {
+        connection->channel->Shutdown();
+        connection->reader.join();
+    }
+    // Requests already on the pool finish; their answers go nowhere
+    std::unique_lock<std::mutex> lock(mutex_);
+    drained_.wait(lock, [this] { return inFlight_ == 0; });
+    lock.unlock();
+
+    listener_->Release();
+    listener_.reset();
+}
+
+DaemonServerStats DaemonServer::Stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
+
+void DaemonServer::Accept()
+{
+    for (;;)
+    {
+        std::shared_ptr<DaemonChannel> channel = listener_->Accept();
+        if (!channel) return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_)
+        {
+            channel->Shutdown();
+            return;
+        }
+        // Clients that hung up are joined here rather than piling up over a long-running daemon
+        for (auto it = connections_.begin(); it != connections_.end();)
+        {
+            if (!(*it)->channel->closed)
+            {
+                ++it;
+                continue;
+            }
+            (*it)->reader.join();
+            it = connections_.erase(it);
+        }
+        auto connection = std::make_shared<Connection>();
+        connection->channel = std::move(channel);
+        connection->reader = std::thread(&DaemonServer::Serve, this, connection);
+        connections_.push_back(connection);
+        stats_.connections++;
+    }
+}
+
+void DaemonServer::Serve(std::shared_ptr<Connection> connection)
+{
+    DaemonChannel &channel = *connection->channel;
+    for (;;)
+    {
+        DaemonFrame request;
+        if (!channel.ReadFull(&request, sizeof(request), nullptr) || request.payload_bytes > kDaemonMaxPayload) break;
+        std::vector<uint8_t> payload(request.payload_bytes);
+        if (!payload.empty() && !channel.ReadFull(payload.data(), payload.size(), nullptr)) break;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            inFlight_++;
+            stats_.requests++;
+        }
+        // The next request is read while this one runs: that is what lets a client pipeline
+        WorkerPool::Instance().Submit([this, connection, request, payload = std::move(payload)]() mutable {
+            Handle(connection, request, std::move(payload));
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                inFlight_--;
+            }
+            drained_.notify_all();
+        });
+    }
+    channel.Shutdown();
+}
+
+void DaemonServer::Handle(const std::shared_ptr<Connection> &connection, DaemonFrame request, std::vector<uint8_t> payload)
+{
+    DaemonClient::LocalScope local;
+    DaemonStatus status = DaemonStatus::BadRequest;
+    std::vector<uint8_t> reply;
+    std::unique_ptr<SharedPixels> pixels;
+    NativePath path;
+    uint32_t value = 0;
+
+    switch (static_cast<DaemonOp>(request.op))
+    {
+    case DaemonOp::Hello:
+    {
+        const DaemonHello hello = {kDaemonProtocolVersion, CurrentPid()};
+        Append(&reply, &hello, sizeof(hello));
+        status = DaemonStatus::Ok;
+        break;
+    }
+    case DaemonOp::Duration:
+    {
+        if (!ReadPath(payload.data(), payload.size(), &path)) break;
+        // Interned here so the daemon's probe cache serves every client
+        const uint32_t pathId = PathArena::Instance().Intern(path);
+        const double duration = pathId == kInvalidPathId ? 0.0 : get_video_duration_by_id(pathId);
+        // No duration may mean no media; a file the daemon cannot open is the client's to try
+        status = duration > 0.0 || OpenFileSource(path.c_str(), AccessPattern::Random) ? DaemonStatus::Ok : DaemonStatus::Failed;
+        Append(&reply, &duration, sizeof(duration));
+        break;
+    }
+    case DaemonOp::Probe:
+    {
+        if (!ReadU32(payload, 0, &value) || !ReadPath(payload.data() + 4, payload.size() - 4, &path)) break;
+        FileProbeResult result = {};
+        const uint32_t pathId = PathArena::Instance().Intern(path);
+        status = pathId != kInvalidPathId && probe_file_by_id(pathId, value, &result) ? DaemonStatus::Ok : DaemonStatus::Failed;
+        Append(&reply, &result, sizeof(result));
+        break;
+    }
+    case DaemonOp::Thumbnail:
+    {
+        uint32_t videoUnits = 0;
+        NativePath output;
+        if (!ReadU32(payload, 0, &value) || !ReadU32(payload, 4, &videoUnits) || payload.size() < 8 + size_t(videoUnits) * sizeof(PathChar) ||
+            !ReadPath(payload.data() + 8, videoUnits * sizeof(PathChar), &path) ||
+            !ReadPath(payload.data() + 8 + videoUnits * sizeof(PathChar), payload.size() - 8 - videoUnits * sizeof(PathChar), &output))
+            break;
+        const uint32_t videoId = PathArena::Instance().Intern(path);
+        const uint32_t outputId = PathArena::Instance().Intern(output);
+        const bool ok = videoId != kInvalidPathId && outputId != kInvalidPathId && get_thumbnail_by_id(videoId, outputId, value);
+        status = ok ? DaemonStatus::Ok : DaemonStatus::Failed;
+        break;
+    }
+    case DaemonOp::ThumbnailPixels:
+    {
+        if (!ReadU32(payload, 0, &value) || !ReadPath(payload.data() + 4, payload.size() - 4, &path)) break;
+        status = DaemonStatus::Failed;
+        if (!options_.renderer) break;
+
+        MemoryBudget::Lease lease = MemoryBudget::Thumbnails().Acquire(uint64_t(value) * value * 4);
+        PooledBuffer bgra;
+        DaemonPixels header = {};
+        if (!options_.renderer(path.c_str(), value, &bgra, &header.width, &header.height)) break;
+        const size_t bytes = size_t(header.width) * header.height * 4;
+        if (bytes == 0 || bgra.size() < bytes || !(pixels = SharedPixels::Create(bytes))) break;
+        std::memcpy(pixels->data(), bgra.data(), bytes);
+#ifdef _WIN32
+        // The client cannot open an unnamed section; the handle is made valid in its process instead
+        HANDLE client = OpenProcess(PROCESS_DUP_HANDLE, FALSE, connection->channel->PeerPid());
+        HANDLE duplicated = nullptr;
+        const bool shared = client != nullptr && DuplicateHandle(GetCurrentProcess(), reinterpret_cast<HANDLE>(pixels->Handle()), client,
+                                                                 &duplicated, FILE_MAP_READ, FALSE, 0);
+        if (client != nullptr) CloseHandle(client);
+        if (!shared) break;
+        header.handle = reinterpret_cast<uintptr_t>(duplicated);
+#endif
+        Append(&reply, &header, sizeof(header));
+        status = DaemonStatus::Ok;
+        break;
+    }
+    }
+
+    if (status != DaemonStatus::Ok)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.failed++;
+    }
+    const DaemonFrame response = {static_cast<uint32_t>(reply.size()), request.request_id, request.op, static_cast<uint16_t>(status)};
+#ifdef _WIN32
+    connection->channel->WriteFrame(response, reply.data());
+#else
+    // The fd is duplicated into the client by the send; ours closes with pixels
+    connection->channel->WriteFrame(response, reply.data(), status == DaemonStatus::Ok && pixels ? pixels->Handle() : -1);
+#endif
+}
+
+// === Client ===
+
+DaemonClient::LocalScope::LocalScope() : previous_(localOnly) { localOnly = true; }
+
+DaemonClient::LocalScope::~LocalScope() { localOnly = previous_; }
+
+DaemonClient &DaemonClient::Instance()
+{
+    static DaemonClient client([] {
+#ifdef _WIN32
+        const wchar_t *configured = _wgetenv(L"VDU_PROBED_ENDPOINT");
+        if (configured != nullptr && std::wcscmp(configured, L"off") == 0) return NativePath();
+#else
+        const char *configured = std::getenv("VDU_PROBED_ENDPOINT");
+        if (configured != nullptr && std::strcmp(configured, "off") == 0) return NativePath();
+#endif
+        return configured != nullptr && configured[0] != 0 ? NativePath(configured) : DefaultDaemonEndpoint();
+    }());
+    return client;
+}
+
+DaemonClient::DaemonClient(NativePath endpoint) : endpoint_(std::move(endpoint)) {}
+
+DaemonClient::~DaemonClient() { SetEndpoint(NativePath()); }
+
+void DaemonClient::SetEndpoint(NativePath endpoint)
+{
+    std::lock_guard<std::mutex> lock(connectMutex_);
+    endpoint_ = std::move(endpoint);
+    retryAfter_ = {};
+    if (channel_) Disconnect(channel_);
+    if (reader_.joinable()) reader_.join();
+    channel_.reset();
+}
+
+std::shared_ptr<DaemonChannel> DaemonClient::Connect()
+{
+    if (localOnly) return nullptr;
+    std::lock_guard<std::mutex> lock(connectMutex_);
+    if (channel_ && !channel_->closed) return channel_;
+    const auto now = std::chrono::steady_clock::now();
+    // A daemon that stopped answering is given the same rest as one that refused the connect
+    if (channel_ && channel_->stalled.exchange(false)) retryAfter_ = now + kRetryInterval;
+    if (endpoint_.empty() || now < retryAfter_) return nullptr;
+
+    if (reader_.joinable()) reader_.join();
+    channel_ = ConnectChannel(endpoint_);
+    if (channel_)
+    {
+        reader_ = std::thread(&DaemonClient::Read, this, channel_);
+        // The handshake rules out a stray socket and a daemon speaking another version
+        std::shared_ptr<Call> call;
+        DaemonHello hello = {};
+        if (Send(channel_, DaemonOp::Hello, {}, &call) != 0 && Wait(channel_, call) && call->status == DaemonStatus::Ok &&
+            call->payload.size() == sizeof(hello))
+            std::memcpy(&hello, call->payload.data(), sizeof(hello));
+        if (hello.version == kDaemonProtocolVersion)
+        {
+            std::lock_guard<std::mutex> statsLock(mutex_);
+            stats_.reconnects++;
+            stats_.daemon_pid = hello.pid;
+            return channel_;
+        }
+        Disconnect(channel_);
+        reader_.join();
+        channel_.reset();
+    }
+    retryAfter_ = std::chrono::steady_clock::now() + kRetryInterval; // from now: a handshake that timed out took a while
+    return nullptr;
+}
+
+uint32_t DaemonClient::Send(const std::shared_ptr<DaemonChannel> &channel, DaemonOp op, const std::vector<uint8_t> &payload,
+                            std::shared_ptr<Call> *call)
+{
+    *call = std::make_shared<Call>();
+    (*call)->timeout = CallTimeout(op);
+    uint32_t id;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        id = nextRequestId_++;
+        if (nextRequestId_ == 0) nextRequestId_ = 1;
+        calls_[id] = *call;
+    }
+    const DaemonFrame frame = {static_cast<uint32_t>(payload.size()), id, static_cast<uint16_t>(op), 0};
+    if (channel->WriteFrame(frame, payload.data())) return id;
+    Disconnect(channel);
+    return 0;
+}
+
+bool DaemonClient::Wait(const std::shared_ptr<DaemonChannel> &channel, const std::shared_ptr<Call> &call)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!answered_.wait_for(lock, call->timeout, [&] { return call->done; }))
+    {
+        // Every call on the connection is lost with it and runs locally
+        lock.unlock();
+        channel->stalled = true;
+        Disconnect(channel);
+        return false;
+    }
+    if (call->lost) return false;
+    stats_.requests++;
+    return true;
+}
+
+void DaemonClient::Read(std::shared_ptr<DaemonChannel> channel)
+{
+    for (;;)
+    {
+        DaemonFrame response;
+        intptr_t handle = -1;
+        if (!channel->ReadFull(&response, sizeof(response), &handle) || response.payload_bytes > kDaemonMaxPayload)
+        {
+#ifndef _WIN32
+            if (handle >= 0) close(static_cast<int>(handle));
+#endif
+            break;
+        }
+        std::vector<uint8_t> payload(response.payload_bytes);
+        if (!payload.empty() && !channel->ReadFull(payload.data(), payload.size(), &handle))
+        {
+#ifndef _WIN32
+            if (handle >= 0) close(static_cast<int>(handle));
+#endif
+            break;
+        }
+
+        std::shared_ptr<Call> call;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = calls_.find(response.request_id);
+            if (it != calls_.end())
+            {
+                call = std::move(it->second);
+                calls_.erase(it);
+                call->status = static_cast<DaemonStatus>(response.status);
+                call->payload = std::move(payload);
+                call->handle = handle;
+                call->done = true;
+            }
+        }
+        if (call) answered_.notify_all();
+#ifndef _WIN32
+        else if (handle >= 0) close(static_cast<int>(handle));
+#endif
+    }
+    Disconnect(channel);
+}
+
+void DaemonClient::Disconnect(const std::shared_ptr<DaemonChannel> &channel)
+{
+    channel->Shutdown();
+    {
+        // Every call still waiting was on this connection; they go local
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto &entry : calls_)
+        {
+            entry.second->lost = true;
+            entry.second->done = true;
+        }
+        calls_.clear();
+        stats_.daemon_pid = 0;
+    }
+    answered_.notify_all();
+}
+
+DaemonReply DaemonClient::Unavailable()
+{
+    if (localOnly) return DaemonReply::Unavailable;
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.fallbacks++;
+    return DaemonReply::Unavailable;
+}
+
+DaemonReply DaemonClient::Duration(const PathChar *path, double *durationMs)
+{
+    std::shared_ptr<DaemonChannel> channel = Connect();
+    if (!channel || path == nullptr) return Unavailable();
+    std::vector<uint8_t> payload;
+    AppendPath(&payload, AbsolutePath(path));
+    std::shared_ptr<Call> call;
+    if (Send(channel, DaemonOp::Duration, payload, &call) == 0 || !Wait(channel, call)) return Unavailable();
+    if (call->status != DaemonStatus::Ok || call->payload.size() != sizeof(double)) return DaemonReply::Failed;
+    std::memcpy(durationMs, call->payload.data(), sizeof(double));
+    return DaemonReply::Ok;
+}
+
+DaemonReply DaemonClient::DurationBatch(const std::vector<const PathChar *> &paths, std::vector<double> *durationsMs,
+                                        std::vector<uint8_t> *answered)
+{
+    std::shared_ptr<DaemonChannel> channel = Connect();
+    if (!channel) return Unavailable();
+    std::vector<std::shared_ptr<Call>> calls(paths.size());
+    std::vector<uint8_t> payload;
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        if (paths[i] == nullptr) continue;
+        payload.clear();
+        AppendPath(&payload, AbsolutePath(paths[i]));
+        if (Send(channel, DaemonOp::Duration, payload, &calls[i]) == 0) return Unavailable();
+    }
+    durationsMs->assign(paths.size(), 0.0);
+    answered->assign(paths.size(), 0);
+    for (size_t i = 0; i < paths.size(); i++)
+    {
+        if (!calls[i]) continue;
+        if (!Wait(channel, calls[i])) return Unavailable();
+        if (calls[i]->status != DaemonStatus::Ok || calls[i]->payload.size() != sizeof(double)) continue;
+        std::memcpy(&(*durationsMs)[i], calls[i]->payload.data(), sizeof(double));
+        (*answered)[i] = 1;
+    }
+    return DaemonReply::Ok;
+}
+
+DaemonReply DaemonClient::Probe(const PathChar *path, uint32_t fields, FileProbeResult *result)
+{
+    std::shared_ptr<DaemonChannel> channel = Connect();
+    if (!channel || path == nullptr) return Unavailable();
+    std::vector<uint8_t> payload;
+    Append(&payload, &fields, sizeof(fields));
+    AppendPath(&payload, AbsolutePath(path));
+    std::shared_ptr<Call> call;
+    if (Send(channel, DaemonOp::Probe, payload, &call) == 0 || !Wait(channel, call)) return Unavailable();
+    if (call->payload.size() == sizeof(*result)) std::memcpy(result, call->payload.data(), sizeof(*result));
+    return call->status == DaemonStatus::Ok ? DaemonReply::Ok : DaemonReply::Failed;
+}
+
+DaemonReply DaemonClient::Thumbnail(const PathChar *video, const PathChar *output, uint32_t size)
+{
+    std::shared_ptr<DaemonChannel> channel = Connect();
+    if (!channel || video == nullptr || output == nullptr) return Unavailable();
+    const NativePath videoPath = AbsolutePath(video);
+    const uint32_t videoUnits = static_cast<uint32_t>(videoPath.size());
+    std::vector<uint8_t> payload;
+    Append(&payload, &size, sizeof(size));
+    Append(&payload, &videoUnits, sizeof(videoUnits));
+    AppendPath(&payload, videoPath);
+    AppendPath(&payload, AbsolutePath(output));
+    std::shared_ptr<Call> call;
+    if (Send(channel, DaemonOp::Thumbnail, payload, &call) == 0 || !Wait(channel, call)) return Unavailable();
+    return call->status == DaemonStatus::Ok ? DaemonReply::Ok : DaemonReply::Failed;
+}
+
+DaemonReply DaemonClient::ThumbnailPixels(const PathChar *path, uint32_t size, std::unique_ptr<SharedPixels> *pixels, uint32_t *width,
+                                          uint32_t *height)
+{
+    std::shared_ptr<DaemonChannel> channel = Connect();
+    if (!channel || path == nullptr) return Unavailable();
+    std::vector<uint8_t> payload;
+    Append(&payload, &size, sizeof(size));
+    AppendPath(&payload, AbsolutePath(path));
+    std::shared_ptr<Call> call;
+    if (Send(channel, DaemonOp::ThumbnailPixels, payload, &call) == 0 || !Wait(channel, call)) return Unavailable();
+
+    DaemonPixels header = {};
+    if (call->status == DaemonStatus::Ok && call->payload.size() == sizeof(header))
+    {
+        std::memcpy(&header, call->payload.data(), sizeof(header));
+#ifdef _WIN32
+        call->handle = static_cast<intptr_t>(header.handle);
+#endif
+        if (call->handle != -1) *pixels = SharedPixels::Adopt(call->handle, size_t(header.width) * header.height * 4);
+        call->handle = -1;
+    }
+#ifndef _WIN32
+    if (call->handle >= 0) close(static_cast<int>(call->handle));
+#endif
+    if (!*pixels) return DaemonReply::Failed;
+    *width = header.width;
+    *height = header.height;
+    return DaemonReply::Ok;
+}
+
+DaemonClientStats DaemonClient::Stats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return stats_;
+}
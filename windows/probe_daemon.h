@@ -0,0 +1,268 @@
+#ifndef PROBE_DAEMON_H
+#define PROBE_DAEMON_H
+
+#include "buffer_pool.h"
+#include "native_path.h"
+#include "video_data_exporter_api.h"
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// === Wire protocol ===
+// Every message is a DaemonFrame followed by payload_bytes of payload. Client and
+// daemon share a machine, so everything is in host byte order. Paths are sent in
+// the native encoding, absolute, and not NUL-terminated.
+
+constexpr uint32_t kDaemonProtocolVersion = 1;
+constexpr uint32_t kDaemonMaxPayload = 1 << 20;
+
+enum class DaemonOp : uint16_t
+{
+    Hello = 1,           // -> DaemonHello
+    Duration = 2,        // path -> double
+    Probe = 3,           // uint32 fields, path -> FileProbeResult
+    Thumbnail = 4,       // uint32 size, uint32 video path units, video path, output path -> nothing
+    ThumbnailPixels = 5, // uint32 size, path -> DaemonPixels, pixels in shared memory
+};
+
+enum class DaemonStatus : uint16_t
+{
+    Ok = 0,
+    Failed = 1,     // the request was understood and did not succeed, e.g. a missing file
+    BadRequest = 2, // unknown op or malformed payload
+};
+
+struct DaemonFrame
+{
+    uint32_t payload_bytes;
+    uint32_t request_id; // echoed by the response; responses come back in completion order
+    uint16_t op;
+    uint16_t status; // responses only
+};
+
+struct DaemonHello
+{
+    uint32_t version;
+    uint32_t pid;
+};
+
+struct DaemonPixels
+{
+    uint32_t width;
+    uint32_t height; // rows of width BGRA pixels, stride width * 4
+    // The mapping: a HANDLE already duplicated into the client on Windows. On Linux
+    // the memfd travels as SCM_RIGHTS ancillary data and this is 0.
+    uint64_t handle;
+};
+
+// Where daemon and clients meet unless VDU_PROBED_ENDPOINT names another place:
+// $XDG_RUNTIME_DIR/vdu-probed.sock (else /tmp/vdu-probed-<uid>.sock), or the
+// named pipe \\.\pipe\vdu-probed-<user> on Windows.
+NativePath DefaultDaemonEndpoint();
+
+/**
+ * @brief Thumbnail pixels in memory that another process can map.
+ *
+ * A memfd on Linux and a pagefile-backed section on Windows. The daemon renders
+ * into one and hands the client a handle, so the pixels cross the process
+ * boundary without being copied through the socket.
+ */
+class SharedPixels
+{
+public:
+    static std::unique_ptr<SharedPixels> Create(size_t bytes);
+    // Takes ownership of @p handle (an fd or a HANDLE) and maps it read-only.
+    static std::unique_ptr<SharedPixels> Adopt(intptr_t handle, size_t bytes);
+    ~SharedPixels();
+
+    SharedPixels(const SharedPixels &) = delete;
+    SharedPixels &operator=(const SharedPixels &) = delete;
+
+    uint8_t *data() { return data_; }
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+    intptr_t Handle() const { return handle_; }
+
+private:
+    SharedPixels(intptr_t handle, uint8_t *data, size_t size) : handle_(handle), data_(data), size_(size) {}
+
+    intptr_t handle_;
+    uint8_t *data_;
+    size_t size_;
+};
+
+// Renders a thumbnail as top-down BGRA rows of width * 4 bytes.
+typedef std::function<bool(const PathChar *path, uint32_t size, PooledBuffer *bgra, uint32_t *width, uint32_t *height)> ThumbnailRenderer;
+
+// The shell thumbnail provider on Windows; none elsewhere.
+ThumbnailRenderer DefaultThumbnailRenderer();
+
+class DaemonChannel;
+class DaemonListener;
+
+struct DaemonServerOptions
+{
+    NativePath endpoint; // empty: DefaultDaemonEndpoint()
+    ThumbnailRenderer renderer; // empty: DefaultThumbnailRenderer()
+};
+
+struct DaemonServerStats
+{
+    uint64_t connections = 0; // accepted so far
+    uint64_t requests = 0;
+    uint64_t failed = 0; // answered with a status other than Ok
+};
+
+/**
+ * @brief The vdu-probed side: one worker pool, probe cache and thumbnail store for every client.
+ *
+ * Each connection has a reader thread that hands requests to the worker pool as
+ * they arrive; a client may send many before reading any answer, and answers go
+ * back tagged with the request ID in the order they complete. Requests run the
+ * same exports a client would have run in-process, marked as served so they do
+ * not bounce back to a daemon.
+ */
+class DaemonServer
+{
+public:
+    explicit DaemonServer(DaemonServerOptions options);
+    ~DaemonServer();
+
+    DaemonServer(const DaemonServer &) = delete;
+    DaemonServer &operator=(const DaemonServer &) = delete;
+
+    // Binds the endpoint and starts accepting. False if it is taken by a daemon that answers.
+    bool Start();
+    // Stops accepting, closes every connection and waits for their threads.
+    void Stop();
+
+    DaemonServerStats Stats() const;
+    const NativePath &Endpoint() const { return options_.endpoint; }
+
+private:
+    struct Connection;
+
+    void Accept();
+    void Serve(std::shared_ptr<Connection> connection);
+    void Handle(const std::shared_ptr<Connection> &connection, DaemonFrame request, std::vector<uint8_t> payload);
+
+    DaemonServerOptions options_;
+    std::unique_ptr<DaemonListener> listener_;
+    std::thread acceptor_;
+
+    mutable std::mutex mutex_;
+    std::vector<std::shared_ptr<Connection>> connections_;
+    std::condition_variable drained_;
+    size_t inFlight_ = 0; // requests on the worker pool
+    bool stopping_ = false;
+    DaemonServerStats stats_;
+};
+
+// How a client call went. Unavailable means no daemon took it and Failed that the daemon could not
+// do it, e.g. open a file this process may be able to; either way the caller does the work itself.
+enum class DaemonReply
+{
+    Unavailable,
+    Ok,
+    Failed,
+};
+
+struct DaemonClientStats
+{
+    uint64_t requests = 0;     // answered by the daemon
+    uint64_t fallbacks = 0;    // calls that found no daemon
+    uint64_t reconnects = 0;   // connections made, the first included
+    uint32_t daemon_pid = 0;   // 0 while disconnected
+};
+
+/**
+ * @brief The library side of vdu-probed.
+ *
+ * Connects lazily and, after a failed attempt, not again for a couple of
+ * seconds, so a library used without a daemon pays one failed connect now and
+ * then. Calls from many threads share the connection: each registers its
+ * request ID, writes its frame and waits, while one reader thread routes the
+ * answers. A batch writes all of its frames before waiting for the first
+ * answer. If the connection drops, or an answer takes longer than its
+ * request's timeout, waiting calls return Unavailable and run locally.
+ */
+class DaemonClient
+{
+public:
+    // Endpoint from VDU_PROBED_ENDPOINT, else DefaultDaemonEndpoint(); "off" disables it
+    static DaemonClient &Instance();
+
+    explicit DaemonClient(NativePath endpoint);
+    ~DaemonClient();
+
+    DaemonClient(const DaemonClient &) = delete;
+    DaemonClient &operator=(const DaemonClient &) = delete;
+
+    // Drops the connection and uses @p endpoint from the next call on; empty disables the client.
+    void SetEndpoint(NativePath endpoint);
+
+    DaemonReply Duration(const PathChar *path, double *durationMs);
+    // Pipelined: every request is on the wire before the first answer is read. Paths the
+    // daemon failed on are 0 in @p answered and are the caller's to probe.
+    DaemonReply DurationBatch(const std::vector<const PathChar *> &paths, std::vector<double> *durationsMs,
+                              std::vector<uint8_t> *answered);
+    DaemonReply Probe(const PathChar *path, uint32_t fields, FileProbeResult *result);
+    DaemonReply Thumbnail(const PathChar *video, const PathChar *output, uint32_t size);
+    DaemonReply ThumbnailPixels(const PathChar *path, uint32_t size, std::unique_ptr<SharedPixels> *pixels, uint32_t *width,
+                                uint32_t *height);
+
+    DaemonClientStats Stats();
+
+    // While alive on a thread, calls from it skip the daemon. Set around requests the daemon serves.
+    class LocalScope
+    {
+    public:
+        LocalScope();
+        ~LocalScope();
+
+    private:
+        bool previous_;
+    };
+
+private:
+    struct Call
+    {
+        bool done = false;
+        bool lost = false; // the connection dropped before the answer came
+        DaemonStatus status = DaemonStatus::Failed;
+        std::vector<uint8_t> payload;
+        intptr_t handle = -1; // passed fd, Linux only
+        std::chrono::milliseconds timeout{0};
+    };
+
+    std::shared_ptr<DaemonChannel> Connect();
+    // Returns the request ID, or 0 if the request could not be sent.
+    uint32_t Send(const std::shared_ptr<DaemonChannel> &channel, DaemonOp op, const std::vector<uint8_t> &payload, std::shared_ptr<Call> *call);
+    // False if the connection dropped, or the answer did not come within the call's timeout;
+    // a timeout drops the connection so a stalled daemon does not hold up every caller.
+    bool Wait(const std::shared_ptr<DaemonChannel> &channel, const std::shared_ptr<Call> &call);
+    void Read(std::shared_ptr<DaemonChannel> channel);
+    void Disconnect(const std::shared_ptr<DaemonChannel> &channel);
+    DaemonReply Unavailable();
+
+    std::mutex connectMutex_;
+    NativePath endpoint_;
+    std::shared_ptr<DaemonChannel> channel_;
+    std::thread reader_;
+    std::chrono::steady_clock::time_point retryAfter_{};
+
+    std::mutex mutex_;
+    std::condition_variable answered_;
+    std::map<uint32_t, std::shared_ptr<Call>> calls_;
+    uint32_t nextRequestId_ = 1;
+    DaemonClientStats stats_;
+};
+
+#endif // PROBE_DAEMON_H
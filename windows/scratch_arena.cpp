@@ -0,0 +1,77 @@
+#include "scratch_arena.h"
+#include <algorithm>
+#include <cstring>
+
+ScratchArena &ScratchArena::ForThread()
+{
+    static thread_local ScratchArena arena;
+    return arena;
+}
+
+ScratchArena::Scope::Scope(ScratchArena &arena) : arena_(arena), block_(arena.current_), used_(arena.used_)
+{
+    arena_.depth_++;
+}
+
+ScratchArena::Scope::~Scope()
+{
+    arena_.depth_--;
+    arena_.Rewind(block_, used_);
+}
+
+void *ScratchArena::Allocate(size_t bytes, size_t alignment)
+{
+    bytes = std::max<size_t>(bytes, 1);
+    for (; current_ < blocks_.size(); current_++, used_ = 0)
+    {
+        // Blocks too small for this request are skipped; they serve again after the next rewind
+        Block &block = blocks_[current_];
+        const uintptr_t base = reinterpret_cast<uintptr_t>(block.data.get());
+        const size_t offset = static_cast<size_t>(((base + used_ + alignment - 1) & ~(uintptr_t(alignment) - 1)) - base);
+        if (offset <= block.size && bytes <= block.size - offset)
+        {
+            used_ = offset + bytes;
+            return block.data.get() + offset;
+        }
+    }
+
+    const size_t size = std::max(kBlockBytes, bytes + alignment);
+    blocks_.push_back({std::unique_ptr<uint8_t[]>(new uint8_t[size]), size});
+    blockAllocations_++;
+    current_ = blocks_.size() - 1;
+    used_ = 0;
+    return Allocate(bytes, alignment);
+}
+
+void ScratchArena::Rewind(size_t block, size_t used)
+{
+    current_ = block;
+    used_ = used;
+    if (depth_ > 0 || Capacity() <= kRetainedBytes) return;
+
+    // Keep the first blocks up to the retained size and free the rest
+    size_t kept = 0, retained = 0;
+    while (kept < blocks_.size() && retained + blocks_[kept].size <= kRetainedBytes) retained += blocks_[kept++].size;
+    blocks_.resize(kept);
+    current_ = 0;
+    used_ = 0;
+}
+
+size_t ScratchArena::Capacity() const
+{
+    size_t total = 0;
+    for (const Block &block : blocks_) total += block.size;
+    return total;
+}
+
+void ScratchBytes::resize(size_t n)
+{
+    if (n > capacity_)
+    {
+        uint8_t *grown = static_cast<uint8_t *>(ScratchArena::ForThread().Allocate(n));
+        if (size_ > 0) std::memcpy(grown, data_, size_);
+        data_ = grown;
+        capacity_ = n;
+    }
+    size_ = n;
+}
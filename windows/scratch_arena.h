@@ -0,0 +1,87 @@
+#ifndef SCRATCH_ARENA_H
+#define SCRATCH_ARENA_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+/**
+ * @brief Per-thread bump allocator for parser scratch data.
+ *
+ * Container parsers read whole boxes and elements (moov, Cues, SeekHead, a
+ * .lnk file) into temporary buffers that die when the parse returns. Taking
+ * them from a thread's arena costs a pointer bump, and the blocks are reused
+ * by the next job on the same worker instead of going back to the heap.
+ *
+ * Allocations live until the innermost enclosing Scope ends; every parser
+ * entry point opens one. Blocks beyond kRetainedBytes are freed when the
+ * outermost scope ends, so one huge moov does not pin memory for good.
+ */
+class ScratchArena
+{
+public:
+    static ScratchArena &ForThread();
+
+    // Rewinds the arena to where it was when the scope was opened.
+    class Scope
+    {
+    public:
+        explicit Scope(ScratchArena &arena = ScratchArena::ForThread());
+        ~Scope();
+
+        Scope(const Scope &) = delete;
+        Scope &operator=(const Scope &) = delete;
+
+    private:
+        ScratchArena &arena_;
+        size_t block_;
+        size_t used_;
+    };
+
+    void *Allocate(size_t bytes, size_t alignment = 16);
+
+    // Bytes held in blocks, and how many blocks were ever taken from the heap.
+    size_t Capacity() const;
+    uint64_t BlockAllocations() const { return blockAllocations_; }
+
+    static constexpr size_t kBlockBytes = 64 * 1024;
+    static constexpr size_t kRetainedBytes = 4 * 1024 * 1024;
+
+private:
+    struct Block
+    {
+        std::unique_ptr<uint8_t[]> data;
+        size_t size;
+    };
+
+    void Rewind(size_t block, size_t used);
+
+    std::vector<Block> blocks_;
+    size_t current_ = 0; // block being bumped
+    size_t used_ = 0;    // bytes used in it
+    uint32_t depth_ = 0;
+    uint64_t blockAllocations_ = 0;
+};
+
+// A growable byte buffer in the thread's scratch arena, with the subset of std::vector the parsers use.
+class ScratchBytes
+{
+public:
+    ScratchBytes() = default;
+
+    uint8_t *data() { return data_; }
+    const uint8_t *data() const { return data_; }
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+
+    // Growing copies into a new allocation; the old one is only reclaimed with the scope.
+    void resize(size_t n);
+
+private:
+    uint8_t *data_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+};
+
+#endif // SCRATCH_ARENA_H
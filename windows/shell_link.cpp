@@ -0,0 +1,353 @@
+#include "shell_link.h"
+#include "container_parse.h"
+#include "file_metadata.h"
+#include "path_arena.h"
+#include "scratch_arena.h"
+#include "utf_transcode.h"
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace
+{
+    constexpr uint32_t kHeaderSize = 0x4C;
+    // Shortcuts are a few KB; anything this large is not one
+    constexpr uint64_t kMaxLinkBytes = 1 << 20;
+
+    const uint8_t kShellLinkClsid[16] = {0x01, 0x14, 0x02, 0x00, 0x00, 0x00, 0x00, 0x00, 0xC0, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x46};
+
+    // LinkFlags
+    constexpr uint32_t kHasLinkTargetIdList = 0x1;
+    constexpr uint32_t kHasLinkInfo = 0x2;
+    constexpr uint32_t kHasName = 0x4;
+    constexpr uint32_t kHasRelativePath = 0x8;
+    constexpr uint32_t kIsUnicode = 0x80;
+    constexpr uint32_t kForceNoLinkInfo = 0x100;
+
+    // LinkInfoFlags
+    constexpr uint32_t kVolumeIdAndLocalBasePath = 0x1;
+    constexpr uint32_t kCommonNetworkRelativeLinkAndPathSuffix = 0x2;
+
+    // Extension block of file entry shell items holding the long name
+    constexpr uint32_t kFileEntryExtension = 0xBEEF0004;
+
+    NativePath FromUtf16(const std::u16string &text)
+    {
+#ifdef _WIN32
+        return NativePath(text.begin(), text.end());
+#else
+        std::string utf8(text.size() * 3, '\0');
+        utf8.resize(Utf16ToUtf8(text.data(), text.size(), &utf8[0]));
+        return utf8;
+#endif
+    }
+
+    NativePath FromAnsi(const uint8_t *text, size_t length)
+    {
+#ifdef _WIN32
+        const int chars = MultiByteToWideChar(CP_ACP, 0, reinterpret_cast<const char *>(text), static_cast<int>(length), nullptr, 0);
+        NativePath wide(static_cast<size_t>(chars), L'\0');
+        if (chars > 0) MultiByteToWideChar(CP_ACP, 0, reinterpret_cast<const char *>(text), static_cast<int>(length), &wide[0], chars);
+        return wide;
+#else
+        // No code page to go by: bytes past ASCII are read as Latin-1
+        return FromUtf16(std::u16string(text, text + length));
+#endif
+    }
+
+    // NUL-terminated strings at offset within [0, end); empty if the offset is out of range
+    NativePath AnsiStringAt(const uint8_t *base, size_t offset, size_t end)
+    {
+        if (offset == 0 || offset >= end) return {};
+        const uint8_t *text = base + offset;
+        const void *nul = std::memchr(text, 0, end - offset);
+        return FromAnsi(text, nul != nullptr ? static_cast<const uint8_t *>(nul) - text : end - offset);
+    }
+
+    std::u16string ReadUtf16(const uint8_t *text, size_t maxChars)
+    {
+        std::u16string out;
+        for (size_t i = 0; i < maxChars; i++)
+        {
+            const char16_t unit = ReadLe16(text + i * 2);
+            if (unit == 0) break;
+            out.push_back(unit);
+        }
+        return out;
+    }
+
+    NativePath Utf16StringAt(const uint8_t *base, size_t offset, size_t end)
+    {
+        if (offset == 0 || offset >= end) return {};
+        return FromUtf16(ReadUtf16(base + offset, (end - offset) / 2));
+    }
+
+    NativePath JoinSuffix(NativePath base, const NativePath &suffix)
+    {
+        if (suffix.empty()) return base;
+        if (!base.empty() && base.back() != PATH_LITERAL('\\')) base.push_back(PATH_LITERAL('\\'));
+        return base + suffix;
+    }
+
+    NativePath LinkInfoPath(const uint8_t *info, size_t size)
+    {
+        if (size < 0x1C) return {};
+        const uint32_t headerSize = ReadLe32(info + 4);
+        const uint32_t flags = ReadLe32(info + 8);
+        const bool unicode = headerSize >= 0x24 && size >= 0x24;
+        const NativePath suffix = unicode ? Utf16StringAt(info, ReadLe32(info + 0x20), size) : AnsiStringAt(info, ReadLe32(info + 0x18), size);
+
+        if (flags & kVolumeIdAndLocalBasePath)
+        {
+            NativePath base = unicode ? Utf16StringAt(info, ReadLe32(info + 0x1C), size) : NativePath();
+            if (base.empty()) base = AnsiStringAt(info, ReadLe32(info + 0x10), size);
+            if (!base.empty()) return base + suffix; // the suffix is empty for local targets in practice
+        }
+
+        const uint32_t network = ReadLe32(info + 0x14);
+        if ((flags & kCommonNetworkRelativeLinkAndPathSuffix) && network != 0 && network <= size - 0x14)
+        {
+            const uint8_t *link = info + network;
+            const size_t linkSize = std::min<size_t>(ReadLe32(link), size - network);
+            const uint32_t netNameOffset = ReadLe32(link + 8);
+            NativePath share = netNameOffset > 0x14 && linkSize >= 0x1C ? Utf16StringAt(link, ReadLe32(link + 0x14), linkSize) : NativePath();
+            if (share.empty()) share = AnsiStringAt(link, netNameOffset, linkSize);
+            if (!share.empty()) return JoinSuffix(share, suffix);
+        }
+        return {};
+    }
+
+    // Long name of a file entry item from its 0xBEEF0004 extension block, else the primary name
+    NativePath FileEntryName(const uint8_t *item, size_t size, uint8_t type)
+    {
+        if (size < 16) return {};
+        const uint16_t extension = ReadLe16(item + size - 2);
+        if (extension >= 14 && extension + 8u <= size - 2)
+        {
+            const uint8_t *block = item + extension;
+            const size_t blockSize = std::min<size_t>(ReadLe16(block), size - 2 - extension);
+            const uint16_t version = ReadLe16(block + 2);
+            if (ReadLe32(block + 4) == kFileEntryExtension && version >= 3)
+            {
+                // Fields before the name grew with each Windows version
+                size_t nameOffset = 18;
+                if (version >= 7) nameOffset += 18;
+                nameOffset += 2;
+                if (version >= 9) nameOffset += 4;
+                if (version >= 8) nameOffset += 4;
+                NativePath name = Utf16StringAt(block, nameOffset, blockSize);
+                if (!name.empty()) return name;
+            }
+        }
+        return (type & 0x04) ? Utf16StringAt(item, 14, size) : AnsiStringAt(item, 14, size);
+    }
+
+    // File system path spelled by the shell items, or empty for virtual folders (libraries, control panel)
+    NativePath IdListPath(const uint8_t *items, size_t size)
+    {
+        NativePath path;
+        bool rooted = false;
+        size_t pos = 0;
+        while (pos + 2 <= size)
+        {
+            const size_t itemSize = ReadLe16(items + pos);
+            if (itemSize == 0) break; // TerminalID
+            if (itemSize < 3 || itemSize > size - pos) return {};
+            const uint8_t *item = items + pos;
+            const uint8_t type = item[2];
+
+            if (type == 0x1F)
+            {
+                // Root folder (This PC, Network); the next item names the volume or share
+            }
+            else if ((type & 0x70) == 0x20)
+            {
+                path = AnsiStringAt(item, 3, itemSize); // "C:\"
+                rooted = !path.empty();
+            }
+            else if ((type & 0x70) == 0x40)
+            {
+                path = AnsiStringAt(item, 5, itemSize); // "\\server\share"
+                rooted = !path.empty();
+            }
+            else if ((type & 0x70) == 0x30 && rooted)
+            {
+                const NativePath name = FileEntryName(item, itemSize, type);
+                if (name.empty()) return {};
+                path = JoinSuffix(path, name);
+            }
+            else
+            {
+                return {};
+            }
+            pos += itemSize;
+        }
+        return rooted ? path : NativePath();
+    }
+
+    bool IsSeparator(PathChar c)
+    {
+#ifdef _WIN32
+        return c == L'\\' || c == L'/';
+#else
+        return c == '/';
+#endif
+    }
+
+    // Length of the part ".." must not climb out of: "/", "C:\", "\\server\share\"
+    size_t RootLength(const NativePath &path)
+    {
+#ifdef _WIN32
+        if (path.size() >= 2 && path[1] == L':') return path.size() >= 3 && IsSeparator(path[2]) ? 3 : 2;
+        if (path.size() >= 2 && IsSeparator(path[0]) && IsSeparator(path[1]))
+        {
+            // Past the server, then past the share
+            size_t end = path.find_first_of(L"\\/", 2);
+            if (end != NativePath::npos) end = path.find_first_of(L"\\/", end + 1);
+            return end == NativePath::npos ? path.size() : end + 1;
+        }
+#endif
+        return !path.empty() && IsSeparator(path[0]) ? 1 : 0;
+    }
+
+    NativePath CollapseDotSegments(const NativePath &path)
+    {
+        const size_t root = RootLength(path);
+        std::vector<NativePath> segments;
+        size_t start = root;
+        while (start <= path.size())
+        {
+            size_t end = start;
+            while (end < path.size() && !IsSeparator(path[end])) end++;
+            const NativePath segment = path.substr(start, end - start);
+            if (segment == PATH_LITERAL(".."))
+            {
+                if (!segments.empty() && segments.back() != PATH_LITERAL("..")) segments.pop_back();
+                else if (root == 0) segments.push_back(segment);
+            }
+            else if (!segment.empty() && segment != PATH_LITERAL("."))
+            {
+                segments.push_back(segment);
+            }
+            start = end + 1;
+        }
+
+        NativePath out = path.substr(0, root);
+        for (size_t i = 0; i < segments.size(); i++)
+        {
+            if (i > 0) out.push_back(kPathSeparator);
+            out += segments[i];
+        }
+        return out;
+    }
+
+    NativePath ResolveRelative(NativePathView linkPath, NativePath relative)
+    {
+#ifndef _WIN32
+        // Written by Windows, so the separators are backslashes
+        for (PathChar &c : relative)
+            if (c == '\\') c = '/';
+#endif
+        if (relative.empty() || RootLength(relative) > 0) return relative;
+
+        size_t folder = linkPath.size();
+        while (folder > 0 && !IsSeparator(linkPath[folder - 1])) folder--;
+        NativePath combined(linkPath.substr(0, folder));
+        combined += relative;
+        return CollapseDotSegments(combined);
+    }
+}
+
+bool ParseShellLink(ByteSource &source, NativePathView linkPath, ShellLinkTargets *targets)
+{
+    *targets = ShellLinkTargets();
+    const uint64_t fileSize = source.Size();
+    if (fileSize < kHeaderSize || fileSize > kMaxLinkBytes) return false;
+
+    ScratchArena::Scope scratch;
+    ScratchBytes data;
+    data.resize(static_cast<size_t>(fileSize));
+    if (source.ReadAt(0, data.data(), data.size()) != data.size()) return false;
+    const uint8_t *p = data.data();
+    const size_t end = data.size();
+    if (ReadLe32(p) != kHeaderSize || std::memcmp(p + 4, kShellLinkClsid, sizeof(kShellLinkClsid)) != 0) return false;
+
+    const uint32_t flags = ReadLe32(p + 0x14);
+    size_t pos = kHeaderSize;
+    if (flags & kHasLinkTargetIdList)
+    {
+        if (pos + 2 > end) return false;
+        const size_t listSize = ReadLe16(p + pos);
+        pos += 2;
+        if (listSize > end - pos) return false;
+        targets->id_list = IdListPath(p + pos, listSize);
+        pos += listSize;
+    }
+    if (flags & kHasLinkInfo)
+    {
+        if (pos + 4 > end) return false;
+        const size_t infoSize = ReadLe32(p + pos);
+        if (infoSize < 4 || infoSize > end - pos) return false;
+        if (!(flags & kForceNoLinkInfo)) targets->link_info = LinkInfoPath(p + pos, infoSize);
+        pos += infoSize;
+    }
+
+    // StringData starts with NAME_STRING, then RELATIVE_PATH; the rest is not needed
+    const bool unicode = (flags & kIsUnicode) != 0;
+    const size_t unit = unicode ? 2 : 1;
+    for (uint32_t flag : {kHasName, kHasRelativePath})
+    {
+        if (!(flags & flag)) continue;
+        if (pos + 2 > end) break;
+        const size_t chars = ReadLe16(p + pos);
+        pos += 2;
+        if (chars * unit > end - pos) break;
+        if (flag == kHasRelativePath)
+        {
+            NativePath relative = unicode ? FromUtf16(ReadUtf16(p + pos, chars)) : FromAnsi(p + pos, chars);
+            targets->relative_path = ResolveRelative(linkPath, std::move(relative));
+        }
+        pos += chars * unit;
+    }
+
+    return !targets->link_info.empty() || !targets->relative_path.empty() || !targets->id_list.empty();
+}
+
+ShortcutSource SelectShortcutTarget(const ShellLinkTargets &targets, NativePath *target, bool *exists)
+{
+    const std::pair<const NativePath *, ShortcutSource> candidates[] = {
+        {&targets.link_info, ShortcutSource::LinkInfo},
+        {&targets.relative_path, ShortcutSource::RelativePath},
+        {&targets.id_list, ShortcutSource::IdList},
+    };
+
+    ShortcutSource fallback = ShortcutSource::None;
+    NativePath fallbackPath;
+    for (const auto &candidate : candidates)
+    {
+        if (candidate.first->empty()) continue;
+        NativePath path = *candidate.first;
+        PathArena::Normalize(path); // adds the extended-length prefix long targets need
+        FileMetadata metadata;
+        if (ReadFileMetadata(path.c_str(), &metadata))
+        {
+            *target = std::move(path);
+            *exists = true;
+            return candidate.second;
+        }
+        if (fallback == ShortcutSource::None)
+        {
+            fallback = candidate.second;
+            fallbackPath = std::move(path);
+        }
+    }
+    *target = std::move(fallbackPath);
+    *exists = false;
+    return fallback;
+}
@@ -0,0 +1,47 @@
+#ifndef SHELL_LINK_H
+#define SHELL_LINK_H
+
+#include "byte_source.h"
+#include "native_path.h"
+#include <cstdint>
+
+// Where a resolved shortcut target came from. Values are shared with the C API (ShortcutTarget).
+enum class ShortcutSource : uint8_t
+{
+    None = 0,
+    LinkInfo = 1,     // LocalBasePath or network share + CommonPathSuffix
+    RelativePath = 2, // StringData RELATIVE_PATH, resolved against the shortcut's folder
+    IdList = 3,       // LinkTargetIDList shell items (drive/share, then long file names)
+    Shell = 4,        // IShellLink::Resolve, which can track targets that moved (Windows only)
+};
+
+// The target locations a .lnk file records; any of them may be empty.
+struct ShellLinkTargets
+{
+    NativePath link_info;
+    NativePath relative_path;
+    NativePath id_list;
+};
+
+/**
+ * @brief Reads the target locations of an MS-SHLLINK (.lnk) file.
+ *
+ * Parses the file itself, without COM, so shortcuts can be resolved on any
+ * thread and on any platform. Unicode strings are preferred over their ANSI
+ * copies. Strings have no length limit beyond the file's own.
+ *
+ * @param linkPath the shortcut's own path, used to resolve its relative path
+ * @return false if the file is not a shell link or records no target
+ */
+bool ParseShellLink(ByteSource &source, NativePathView linkPath, ShellLinkTargets *targets);
+
+/**
+ * @brief Picks the target to report for a parsed link.
+ *
+ * The first candidate that exists wins, in the order LinkInfo, relative path,
+ * ID list (the order the shell itself trusts them). If none exists, the first
+ * non-empty one is returned with @p exists set to false.
+ */
+ShortcutSource SelectShortcutTarget(const ShellLinkTargets &targets, NativePath *target, bool *exists);
+
+#endif // SHELL_LINK_H
@@ -3,6 +3,8 @@
 #include <shobjidl.h>
 #include <shlguid.h>
 #include <strsafe.h>
+#include <shlobj.h>
+#include <wrl/client.h>
 #include <iostream>
 
 HRESULT ResolveShortcut(HWND hwnd, LPCWSTR lpszLinkFile, LPWSTR lpszPath, int iPathBufferSize)
@@ -66,3 +68,48 @@ HRESULT ResolveShortcut(HWND hwnd, LPCWSTR lpszLinkFile, LPWSTR lpszPath, int iP
 
     return hres;
 }
+
+HRESULT ResolveShortcutTarget(LPCWSTR lpszLinkFile, std::wstring *target)
+{
+    target->clear();
+
+    Microsoft::WRL::ComPtr<IShellLinkW> psl;
+    HRESULT hres = CoCreateInstance(CLSID_ShellLink, NULL, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&psl));
+    if (FAILED(hres)) return hres;
+
+    Microsoft::WRL::ComPtr<IPersistFile> ppf;
+    hres = psl.As(&ppf);
+    if (FAILED(hres)) return hres;
+
+    hres = ppf->Load(lpszLinkFile, STGM_READ);
+    if (FAILED(hres)) return hres;
+
+    hres = psl->Resolve(NULL, SLR_NO_UI | SLR_NOUPDATE);
+    if (FAILED(hres)) return hres;
+
+    PIDLIST_ABSOLUTE pidl = nullptr;
+    if (SUCCEEDED(psl->GetIDList(&pidl)) && pidl != nullptr)
+    {
+        // Extended-length paths top out at 32767 characters
+        for (DWORD capacity : {DWORD(MAX_PATH), DWORD(4096), DWORD(32768)})
+        {
+            std::wstring buffer(capacity, L'\0');
+            if (SHGetPathFromIDListEx(pidl, &buffer[0], capacity, GPFIDL_DEFAULT))
+            {
+                buffer.resize(wcslen(buffer.c_str()));
+                *target = std::move(buffer);
+                break;
+            }
+        }
+        CoTaskMemFree(pidl);
+        if (!target->empty()) return S_OK;
+    }
+
+    WIN32_FIND_DATAW wfd;
+    wchar_t path[MAX_PATH] = {0};
+    hres = psl->GetPath(path, MAX_PATH, &wfd, SLGP_UNCPRIORITY);
+    if (FAILED(hres)) return hres;
+    if (path[0] == 0) return E_FAIL;
+    *target = path;
+    return S_OK;
+}
@@ -2,6 +2,9 @@
 #define SHORTCUT_RESOLVER_H
 
 #include <windows.h>
+#ifdef __cplusplus
+#include <string>
+#endif
 
 #ifdef __cplusplus
 extern "C"
@@ -25,6 +28,17 @@ extern "C"
 
 #ifdef __cplusplus
 }
+
+/**
+ * @brief Resolves a shortcut to a target path of any length.
+ *
+ * Reads the target through the link's ID list and SHGetPathFromIDListEx with a
+ * growing buffer, so targets past MAX_PATH are returned intact. Falls back to
+ * IShellLinkW::GetPath for links without an ID list.
+ *
+ * @note CoInitialize must be called before using this function
+ */
+HRESULT ResolveShortcutTarget(LPCWSTR lpszLinkFile, std::wstring *target);
 #endif
 
 #endif // SHORTCUT_RESOLVER_H
@@ -0,0 +1,242 @@
+#include "similarity_index.h"
+#include "path_arena.h"
+#include "perceptual_hash.h"
+#include "probe_cache.h"
+#include <algorithm>
+#include <mutex>
+
+namespace
+{
+    // Chunk distances the bucket tables are probed for: C(16, 3) = 560 buckets per table at most.
+    // Wider queries cover too much of the table to beat a linear scan.
+    constexpr uint32_t kMaxChunkDistance = 3;
+
+    // Calls f with every 16-bit value exactly distance bits away from value
+    template <typename F>
+    void ForEachAtDistance(uint32_t value, uint32_t distance, F &&f)
+    {
+        if (distance == 0)
+        {
+            f(value);
+            return;
+        }
+        for (uint32_t a = 0; a < 16; a++)
+        {
+            if (distance == 1)
+            {
+                f(value ^ (1u << a));
+                continue;
+            }
+            for (uint32_t b = a + 1; b < 16; b++)
+            {
+                if (distance == 2)
+                {
+                    f(value ^ (1u << a) ^ (1u << b));
+                    continue;
+                }
+                for (uint32_t c = b + 1; c < 16; c++) f(value ^ (1u << a) ^ (1u << b) ^ (1u << c));
+            }
+        }
+    }
+
+    bool Closer(const SimilarityMatch &a, const SimilarityMatch &b)
+    {
+        return a.distance != b.distance ? a.distance < b.distance : a.path_id < b.path_id;
+    }
+}
+
+SimilarityIndex &SimilarityIndex::Instance()
+{
+    static SimilarityIndex index;
+    return index;
+}
+
+SimilarityIndex::SimilarityIndex() : buckets_(size_t(kChunks) << kChunkBits) {}
+
+void SimilarityIndex::Insert(uint32_t pathId, uint64_t hash)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = slots_.find(pathId);
+    if (it != slots_.end())
+    {
+        if (hashes_[it->second] == hash) return;
+        RemoveSlot(it->second);
+        slots_.erase(it);
+    }
+
+    uint32_t slot;
+    if (!freeSlots_.empty())
+    {
+        slot = freeSlots_.back();
+        freeSlots_.pop_back();
+        hashes_[slot] = hash;
+        pathIds_[slot] = pathId;
+    }
+    else
+    {
+        slot = static_cast<uint32_t>(hashes_.size());
+        hashes_.push_back(hash);
+        pathIds_.push_back(pathId);
+    }
+    slots_[pathId] = slot;
+    for (uint32_t chunk = 0; chunk < kChunks; chunk++) BucketOf(chunk, hash).push_back({hash, slot});
+}
+
+bool SimilarityIndex::Remove(uint32_t pathId)
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    auto it = slots_.find(pathId);
+    if (it == slots_.end()) return false;
+    RemoveSlot(it->second);
+    slots_.erase(it);
+    return true;
+}
+
+size_t SimilarityIndex::RemoveUnder(NativePathView directory)
+{
+    PathArena &arena = PathArena::Instance();
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    size_t removed = 0;
+    for (auto it = slots_.begin(); it != slots_.end();)
+    {
+        NativePathView path;
+        if (arena.Get(it->first, &path) && PathIsUnder(path, directory))
+        {
+            RemoveSlot(it->second);
+            it = slots_.erase(it);
+            removed++;
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    return removed;
+}
+
+void SimilarityIndex::RemoveSlot(uint32_t slot)
+{
+    for (uint32_t chunk = 0; chunk < kChunks; chunk++)
+    {
+        Bucket &bucket = BucketOf(chunk, hashes_[slot]);
+        auto it = std::find_if(bucket.begin(), bucket.end(), [slot](const BucketEntry &entry) { return entry.slot == slot; });
+        if (it == bucket.end()) continue;
+        *it = bucket.back();
+        bucket.pop_back();
+    }
+    pathIds_[slot] = kInvalidPathId;
+    freeSlots_.push_back(slot);
+}
+
+bool SimilarityIndex::Find(uint32_t pathId, uint64_t *hash) const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    auto it = slots_.find(pathId);
+    if (it == slots_.end()) return false;
+    if (hash != nullptr) *hash = hashes_[it->second];
+    return true;
+}
+
+template <typename Visit>
+void SimilarityIndex::VisitRing(uint64_t hash, uint32_t chunkDistance, Visit &&visit) const
+{
+    uint32_t query[kChunks];
+    for (uint32_t chunk = 0; chunk < kChunks; chunk++) query[chunk] = ChunkOf(hash, chunk);
+
+    for (uint32_t chunk = 0; chunk < kChunks; chunk++)
+    {
+        ForEachAtDistance(query[chunk], chunkDistance, [&](uint32_t value) {
+            for (const BucketEntry &entry : buckets_[(chunk << kChunkBits) | value])
+            {
+                // Visited from the first table where the entry is nearest, so each entry is seen once
+                bool first = true;
+                for (uint32_t other = 0; other < kChunks && first; other++)
+                {
+                    if (other == chunk) continue;
+                    const uint32_t distance = HammingDistance(ChunkOf(entry.hash, other), query[other]);
+                    first = other < chunk ? distance > chunkDistance : distance >= chunkDistance;
+                }
+                if (first) visit(entry);
+            }
+        });
+    }
+}
+
+void SimilarityIndex::Scan(uint64_t hash, uint32_t radius, std::vector<SimilarityMatch> *matches) const
+{
+    for (size_t slot = 0; slot < hashes_.size(); slot++)
+    {
+        const uint32_t distance = HammingDistance(hashes_[slot], hash);
+        if (distance <= radius && pathIds_[slot] != kInvalidPathId) matches->push_back({pathIds_[slot], distance});
+    }
+}
+
+void SimilarityIndex::Within(uint64_t hash, uint32_t radius, std::vector<SimilarityMatch> *matches) const
+{
+    matches->clear();
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    if (radius / kChunks > kMaxChunkDistance)
+    {
+        Scan(hash, radius, matches);
+    }
+    else
+    {
+        for (uint32_t ring = 0; ring <= radius / kChunks; ring++)
+            VisitRing(hash, ring, [&](const BucketEntry &entry) {
+                const uint32_t distance = HammingDistance(entry.hash, hash);
+                if (distance <= radius) matches->push_back({pathIds_[entry.slot], distance});
+            });
+    }
+    std::sort(matches->begin(), matches->end(), Closer);
+}
+
+void SimilarityIndex::Nearest(uint64_t hash, uint32_t k, std::vector<SimilarityMatch> *matches) const
+{
+    matches->clear();
+    if (k == 0) return;
+
+    auto keepNearest = [matches, k] {
+        const size_t kept = std::min<size_t>(k, matches->size());
+        std::partial_sort(matches->begin(), matches->begin() + kept, matches->end(), Closer);
+        matches->resize(kept);
+    };
+
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    uint32_t bound = 64;
+    if (slots_.size() > k)
+    {
+        // After ring r every entry closer than 4 * (r + 1) has been seen
+        for (uint32_t ring = 0; ring <= kMaxChunkDistance; ring++)
+        {
+            VisitRing(hash, ring, [&](const BucketEntry &entry) { matches->push_back({pathIds_[entry.slot], HammingDistance(entry.hash, hash)}); });
+            if (matches->size() < k) continue;
+            std::nth_element(matches->begin(), matches->begin() + (k - 1), matches->end(), Closer);
+            bound = (*matches)[k - 1].distance;
+            if (bound < kChunks * (ring + 1))
+            {
+                keepNearest();
+                return;
+            }
+        }
+        matches->clear();
+    }
+    // The k-th distance found so far bounds the scan, so it only collects real contenders
+    Scan(hash, bound, matches);
+    keepNearest();
+}
+
+size_t SimilarityIndex::Size() const
+{
+    std::shared_lock<std::shared_mutex> lock(mutex_);
+    return slots_.size();
+}
+
+void SimilarityIndex::Clear()
+{
+    std::unique_lock<std::shared_mutex> lock(mutex_);
+    hashes_.clear();
+    pathIds_.clear();
+    freeSlots_.clear();
+    slots_.clear();
+    for (Bucket &bucket : buckets_) bucket.clear();
+}
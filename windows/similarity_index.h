@@ -0,0 +1,78 @@
+#ifndef SIMILARITY_INDEX_H
+#define SIMILARITY_INDEX_H
+
+#include "native_path.h"
+#include "video_data_exporter_api.h"
+#include <cstddef>
+#include <cstdint>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief 64-bit hashes by path ID, searchable by Hamming distance.
+ *
+ * Multi-index hashing: each hash is split into four 16-bit chunks with one
+ * bucket table per chunk. Two hashes within distance r share at least one chunk
+ * within r / 4, so a query only visits the buckets around its own chunks.
+ * Queries too wide for that (r >= 16) scan the flat hash array instead, which
+ * is still a single popcount per entry.
+ *
+ * Reads run concurrently; writes take an exclusive lock.
+ */
+class SimilarityIndex
+{
+public:
+    static SimilarityIndex &Instance();
+
+    SimilarityIndex();
+
+    // Adds @p pathId, replacing the hash it had.
+    void Insert(uint32_t pathId, uint64_t hash);
+    bool Remove(uint32_t pathId);
+
+    // Drops every path at or below @p directory. Returns the number removed.
+    size_t RemoveUnder(NativePathView directory);
+
+    bool Find(uint32_t pathId, uint64_t *hash) const;
+
+    // All entries within @p radius, nearest first (ties by path ID).
+    void Within(uint64_t hash, uint32_t radius, std::vector<SimilarityMatch> *matches) const;
+
+    // The @p k nearest entries, nearest first (ties by path ID).
+    void Nearest(uint64_t hash, uint32_t k, std::vector<SimilarityMatch> *matches) const;
+
+    size_t Size() const;
+    void Clear();
+
+private:
+    static constexpr uint32_t kChunks = 4;
+    static constexpr uint32_t kChunkBits = 16;
+
+    // The hash is kept next to the slot so candidates are checked without touching hashes_
+    struct BucketEntry
+    {
+        uint64_t hash;
+        uint32_t slot;
+    };
+    using Bucket = std::vector<BucketEntry>;
+
+    Bucket &BucketOf(uint32_t chunk, uint64_t hash) { return buckets_[(chunk << kChunkBits) | ChunkOf(hash, chunk)]; }
+    static uint32_t ChunkOf(uint64_t hash, uint32_t chunk) { return static_cast<uint32_t>(hash >> (chunk * kChunkBits)) & 0xFFFF; }
+
+    void RemoveSlot(uint32_t slot);
+    void Scan(uint64_t hash, uint32_t radius, std::vector<SimilarityMatch> *matches) const;
+
+    // Calls visit(entry) once for every entry whose nearest chunk is exactly @p chunkDistance from the query's
+    template <typename Visit>
+    void VisitRing(uint64_t hash, uint32_t chunkDistance, Visit &&visit) const;
+
+    mutable std::shared_mutex mutex_;
+    std::vector<uint64_t> hashes_;  // by slot
+    std::vector<uint32_t> pathIds_; // by slot; kInvalidPathId for free slots
+    std::vector<uint32_t> freeSlots_;
+    std::unordered_map<uint32_t, uint32_t> slots_; // path ID -> slot
+    std::vector<Bucket> buckets_;                  // kChunks tables of 2^16 buckets
+};
+
+#endif // SIMILARITY_INDEX_H
@@ -0,0 +1,177 @@
+#include <gtest/gtest.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../adaptive_concurrency.h"
+#include "../batch_probe.h"
+#include "../byte_source.h"
+#include "../media_probe.h"
+#include "../video_data_exporter_api.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+// A device that serves `channels` reads at once, each taking `service`; further reads queue behind them
+class SimulatedDevice {
+public:
+    SimulatedDevice(size_t channels, std::chrono::microseconds service) : free_(channels), service_(service) {}
+
+    // Blocks until the read would have been served
+    void Read() {
+        std::chrono::steady_clock::time_point done;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto channel = std::min_element(free_.begin(), free_.end());
+            done = std::max(*channel, std::chrono::steady_clock::now()) + service_;
+            *channel = done;
+        }
+        std::this_thread::sleep_until(done);
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::chrono::steady_clock::time_point> free_;
+    std::chrono::microseconds service_;
+};
+
+// Memory-backed source whose reads take as long as the simulated device says
+class LatencySource : public ByteSource {
+public:
+    LatencySource(const std::string& bytes, SimulatedDevice* device)
+        : inner_(MakeMemorySource(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size())), device_(device) {}
+
+    uint64_t Size() const override { return inner_->Size(); }
+
+    size_t ReadAt(uint64_t offset, uint8_t* buffer, size_t length) override {
+        device_->Read();
+        const size_t read = inner_->ReadAt(offset, buffer, length);
+        Account(read);
+        return read;
+    }
+
+private:
+    std::unique_ptr<ByteSource> inner_;
+    SimulatedDevice* device_;
+};
+
+// Probes `files` durations from 32 threads, each probe holding a permit of `limiter`
+static void RunProbes(ConcurrencyLimiter& limiter, SimulatedDevice& device, size_t files) {
+    const std::string mkv = Mkv(60000.0, 32 * 1024);
+    std::atomic<size_t> next{0};
+    std::atomic<size_t> probed{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 32; t++) {
+        threads.emplace_back([&] {
+            while (next++ < files) {
+                ConcurrencyLimiter::Permit permit = limiter.Acquire();
+                LatencySource source(mkv, &device);
+                DurationProbe probe;
+                if (RunProbe(probe, source).kind == ProbeStep::Done && probe.DurationMs() == 60000.0) probed++;
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    EXPECT_EQ(probed.load(), files);
+}
+
+TEST(AdaptiveConcurrencyTests, ParallelDeviceGrowsTheLimit) {
+    ConcurrencyOptions options;
+    options.max_limit = 32;
+    ConcurrencyLimiter limiter(options);
+    SimulatedDevice ssd{32, std::chrono::microseconds(2000)};
+    RunProbes(limiter, ssd, 1500);
+
+    const ConcurrencyStats stats = limiter.Stats();
+    EXPECT_GE(stats.limit, 16u);
+    EXPECT_GT(stats.increases, stats.decreases);
+    EXPECT_EQ(stats.completions, 1500u);
+    EXPECT_EQ(stats.in_flight, 0u);
+    EXPECT_LE(stats.peak_in_flight, 32u);
+}
+
+TEST(AdaptiveConcurrencyTests, SerialDeviceKeepsTheLimitLow) {
+    ConcurrencyLimiter limiter;
+    SimulatedDevice disk{1, std::chrono::microseconds(1000)};
+    RunProbes(limiter, disk, 300);
+
+    // More requests in flight only lengthen the queue, so latency rising with the limit holds it back
+    const ConcurrencyStats stats = limiter.Stats();
+    EXPECT_LE(stats.limit, 8u);
+    EXPECT_LE(stats.peak_in_flight, 9u);
+    EXPECT_GT(stats.mean_latency_ms, stats.baseline_latency_ms);
+}
+
+TEST(AdaptiveConcurrencyTests, LatencyOverTargetCutsToMinimum) {
+    ConcurrencyOptions options;
+    options.initial_limit = 8;
+    options.min_limit = 2;
+    options.latency_target_ms = 10;
+    ConcurrencyLimiter limiter(options);
+    SimulatedDevice share{64, std::chrono::microseconds(8000)}; // two reads per probe: 16 ms each
+    RunProbes(limiter, share, 120);
+
+    const ConcurrencyStats stats = limiter.Stats();
+    EXPECT_EQ(stats.limit, 2u);
+    EXPECT_EQ(stats.increases, 0u);
+    EXPECT_GT(stats.mean_latency_ms, 10.0);
+}
+
+TEST(AdaptiveConcurrencyTests, Export_BatchProbesReportTheirStorageRoot) {
+    const fs::path dir = fs::temp_directory_path() / "test_vdu_concurrency";
+    fs::create_directories(dir);
+    std::vector<NativePath> natives;
+    std::vector<const PathChar*> paths;
+    for (int i = 0; i < 20; i++) {
+        natives.push_back((dir / ("clip" + std::to_string(i) + ".mkv")).native());
+        WriteFile(natives.back(), Mkv(1000.0 * (i + 1)));
+    }
+    for (const NativePath& path : natives) paths.push_back(path.c_str());
+
+    // Files in one directory share a limiter keyed by the directory's device
+    EXPECT_EQ(&StorageConcurrency::Instance().For(paths[0]), &StorageConcurrency::Instance().For(paths[1]));
+    const uint64_t before = StorageConcurrency::Instance().For(paths[0]).Stats().completions;
+
+    BatchProbeOptions options;
+    options.backend = BatchBackend::ThreadPool;
+    std::vector<BatchProbeResult> results;
+    ProbeDurationsBatch(paths, &results, options);
+    for (int i = 0; i < 20; i++) EXPECT_DOUBLE_EQ(results[i].duration_ms, 1000.0 * (i + 1));
+
+    struct stat st;
+    ASSERT_EQ(stat(dir.c_str(), &st), 0);
+    const uint32_t roots = get_io_concurrency_stats(nullptr, 0);
+    ASSERT_GE(roots, 1u);
+    std::vector<IoConcurrencyStats> stats(roots);
+    EXPECT_EQ(get_io_concurrency_stats(stats.data(), roots), roots);
+    bool found = false;
+    for (const IoConcurrencyStats& root : stats) {
+        if (root.storage_id != static_cast<uint64_t>(st.st_dev)) continue;
+        found = true;
+        EXPECT_EQ(root.completions, before + 20);
+        EXPECT_GE(root.limit, 1u);
+        EXPECT_EQ(root.in_flight, 0u);
+    }
+    EXPECT_TRUE(found);
+
+    // Limits apply to roots already seen
+    const ConcurrencyOptions defaults = StorageConcurrency::Instance().Options();
+    set_io_concurrency_limits(3, 3, 0);
+    EXPECT_EQ(StorageConcurrency::Instance().For(paths[0]).Limit(), 3u);
+    StorageConcurrency::Instance().SetOptions(defaults);
+    fs::remove_all(dir);
+}
+
+} // namespace test
+} // namespace video_data_utils
@@ -0,0 +1,287 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../batch_probe.h"
+#include "../media_probe.h"
+#include "../path_arena.h"
+#include "../video_data_exporter_api.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+// Feeds the probe from memory, exactly as the file backends would
+static ProbeStep Drive(DurationProbe& probe, const std::string& file) {
+    ProbeStep step = probe.Start(file.size());
+    while (step.kind == ProbeStep::Read) {
+        const uint64_t offset = step.range.offset;
+        const size_t length = static_cast<size_t>(std::min<uint64_t>(step.range.length, file.size() - offset));
+        step = probe.OnData(offset, reinterpret_cast<const uint8_t*>(file.data()) + offset, length);
+    }
+    return step;
+}
+
+TEST(BatchProbeTests, Mp4_MoovAfterMdatTakesOneHop) {
+    const uint64_t mdat = 5 * 1024 * 1024;
+    std::string file = Mp4MoovAtEndHead(mdat) + std::string(mdat, '\0') + Moov(5025000.0);
+
+    DurationProbe probe;
+    EXPECT_EQ(Drive(probe, file).kind, ProbeStep::Done);
+    EXPECT_EQ(probe.Container(), ContainerKind::IsoBmff);
+    EXPECT_DOUBLE_EQ(probe.DurationMs(), 5025000.0);
+    EXPECT_EQ(probe.Reads(), 2u);
+    EXPECT_LT(probe.BytesRead(), 2u * DurationProbe::kHeadBytes);
+}
+
+TEST(BatchProbeTests, Mp4_Version1MvhdAtFront) {
+    DurationProbe probe;
+    EXPECT_EQ(Drive(probe, Ftyp() + Moov(90000.0, true) + Box("mdat", "x")).kind, ProbeStep::Done);
+    EXPECT_DOUBLE_EQ(probe.DurationMs(), 90000.0);
+    EXPECT_EQ(probe.Reads(), 1u);
+}
+
+TEST(BatchProbeTests, Matroska_SeekHeadJumpsOverPadding) {
+    // Info sits 300 KB in, past several head-sized reads of padding
+    DurationProbe probe;
+    EXPECT_EQ(Drive(probe, Mkv(1234.5, 300 * 1024)).kind, ProbeStep::Done);
+    EXPECT_EQ(probe.Container(), ContainerKind::Matroska);
+    EXPECT_DOUBLE_EQ(probe.DurationMs(), 1234.5);
+    EXPECT_EQ(probe.Reads(), 2u);
+
+    DurationProbe webm;
+    EXPECT_EQ(Drive(webm, Mkv(60000.0, 0, "webm")).kind, ProbeStep::Done);
+    EXPECT_EQ(webm.Container(), ContainerKind::WebM);
+    EXPECT_EQ(webm.Reads(), 1u);
+}
+
+TEST(BatchProbeTests, NonMediaFailsAfterHeadRead) {
+    DurationProbe probe;
+    EXPECT_EQ(Drive(probe, "1\r\n00:00:01,000 --> 00:00:02,000\r\nHello\r\n").kind, ProbeStep::Failed);
+    EXPECT_EQ(probe.Reads(), 1u);
+
+    // An MP4 whose moov never arrives
+    DurationProbe truncated;
+    EXPECT_EQ(Drive(truncated, Mp4MoovAtEndHead(100)).kind, ProbeStep::Failed);
+}
+
+TEST(BatchProbeTests, Avi_AvihOrOpenDmlFrameCount) {
+    DurationProbe probe;
+    EXPECT_EQ(Drive(probe, Avi(40000, 1500)).kind, ProbeStep::Done);
+    EXPECT_EQ(probe.Container(), ContainerKind::Avi);
+    EXPECT_DOUBLE_EQ(probe.DurationMs(), 60000.0);
+    EXPECT_EQ(probe.Reads(), 1u);
+
+    // avih only counts the first RIFF of a file past 1 GB
+    DurationProbe large;
+    EXPECT_EQ(Drive(large, Avi(33367, 1000, 180000)).kind, ProbeStep::Done);
+    EXPECT_DOUBLE_EQ(large.DurationMs(), 180000 * 33.367);
+}
+
+TEST(BatchProbeTests, Asf_PlayDurationLessPreroll) {
+    DurationProbe probe;
+    EXPECT_EQ(Drive(probe, Asf(95000ull * 10000, 3000)).kind, ProbeStep::Done);
+    EXPECT_EQ(probe.Container(), ContainerKind::Asf);
+    EXPECT_DOUBLE_EQ(probe.DurationMs(), 92000.0);
+    EXPECT_EQ(probe.Reads(), 1u);
+
+    // An embedded picture pushes File Properties past the head read
+    DurationProbe hop;
+    EXPECT_EQ(Drive(hop, Asf(95000ull * 10000, 3000, 100 * 1024)).kind, ProbeStep::Done);
+    EXPECT_DOUBLE_EQ(hop.DurationMs(), 92000.0);
+    EXPECT_EQ(hop.Reads(), 2u);
+
+    DurationProbe broadcast;
+    EXPECT_EQ(Drive(broadcast, Asf(95000ull * 10000, 3000, 0, true)).kind, ProbeStep::Failed);
+}
+
+TEST(BatchProbeTests, Flv_MetadataOrLastTagTimestamp) {
+    DurationProbe probe;
+    EXPECT_EQ(Drive(probe, Flv(12.5, 12480)).kind, ProbeStep::Done);
+    EXPECT_EQ(probe.Container(), ContainerKind::Flv);
+    EXPECT_DOUBLE_EQ(probe.DurationMs(), 12500.0);
+    EXPECT_EQ(probe.Reads(), 1u);
+
+    // No duration in onMetaData: PreviousTagSize at the end leads to the last tag
+    DurationProbe live;
+    EXPECT_EQ(Drive(live, Flv(-1.0, 20040)).kind, ProbeStep::Done);
+    EXPECT_DOUBLE_EQ(live.DurationMs(), 20040.0);
+    EXPECT_EQ(live.Reads(), 3u);
+    EXPECT_LT(live.BytesRead(), DurationProbe::kHeadBytes + 64);
+}
+
+TEST(BatchProbeTests, Ogg_LastGranuleOfFirstStream) {
+    // Opus counts 48 kHz samples and starts after its pre-skip
+    DurationProbe opus;
+    EXPECT_EQ(Drive(opus, Ogg(OpusHead(312), 312 + 48000 * 61, 200)).kind, ProbeStep::Done);
+    EXPECT_EQ(opus.Container(), ContainerKind::Ogg);
+    EXPECT_DOUBLE_EQ(opus.DurationMs(), 61000.0);
+    EXPECT_EQ(opus.Reads(), 2u);
+    EXPECT_LE(opus.BytesRead(), DurationProbe::kHeadBytes + DurationProbe::kTailBytes);
+
+    // A page of another stream after the last one of the first must not count
+    DurationProbe vorbis;
+    const std::string file = Ogg(VorbisHead(44100), 44100 * 30, 50) + OggPage(4, 999999999, 7, 1, std::string(100, '\0'));
+    EXPECT_EQ(Drive(vorbis, file).kind, ProbeStep::Done);
+    EXPECT_DOUBLE_EQ(vorbis.DurationMs(), 30000.0);
+}
+
+TEST(BatchProbeTests, Ts_PcrSpanAcrossWraparound) {
+    DurationProbe probe;
+    EXPECT_EQ(Drive(probe, Ts(900000, 90 * 45000, 4000)).kind, ProbeStep::Done);
+    EXPECT_EQ(probe.Container(), ContainerKind::MpegTs);
+    EXPECT_DOUBLE_EQ(probe.DurationMs(), 45000.0);
+    EXPECT_EQ(probe.Reads(), 2u);
+
+    // The 33-bit clock wraps between head and tail
+    DurationProbe wrapped;
+    EXPECT_EQ(Drive(wrapped, Ts((uint64_t(1) << 33) - 90 * 1000, 90 * 5000, 4000, true)).kind, ProbeStep::Done);
+    EXPECT_EQ(wrapped.Container(), ContainerKind::M2ts);
+    EXPECT_DOUBLE_EQ(wrapped.DurationMs(), 5000.0);
+}
+
+TEST(BatchProbeTests, FragmentedMp4_MehdOrSidxNeedOnlyTheHead) {
+    FragmentedLayout layout;
+    layout.mehd = 10000;
+    DurationProbe mehd;
+    EXPECT_EQ(Drive(mehd, FragmentedMp4(layout)).kind, ProbeStep::Done);
+    EXPECT_DOUBLE_EQ(mehd.DurationMs(), 10000.0);
+    EXPECT_EQ(mehd.Method(), DurationMethod::MovieExtends);
+    EXPECT_EQ(mehd.Reads(), 1u);
+
+    layout.mehd = 0;
+    layout.sidx = true;
+    layout.fragments = 200;
+    DurationProbe sidx;
+    EXPECT_EQ(Drive(sidx, FragmentedMp4(layout)).kind, ProbeStep::Done);
+    EXPECT_DOUBLE_EQ(sidx.DurationMs(), 200 * 25 * 40.0);
+    EXPECT_EQ(sidx.Method(), DurationMethod::SegmentIndex);
+    EXPECT_EQ(sidx.Reads(), 1u); // the index sits in the head; the fragments it covers are jumped over
+}
+
+TEST(BatchProbeTests, FragmentedMp4_RandomAccessTableSkipsToTheLastFragment) {
+    FragmentedLayout layout;
+    layout.fragments = 200;
+    layout.mdatBytes = 64 * 1024;
+    layout.mfra = true;
+    const std::string file = FragmentedMp4(layout);
+
+    DurationProbe probe;
+    EXPECT_EQ(Drive(probe, file).kind, ProbeStep::Done);
+    EXPECT_DOUBLE_EQ(probe.DurationMs(), 200 * 25 * 40.0);
+    EXPECT_EQ(probe.Method(), DurationMethod::RandomAccess);
+    EXPECT_LE(probe.Reads(), 6u); // head, mfro, mfra, the last fragment, then a step onto mfra
+    EXPECT_LT(probe.BytesRead(), 5u * DurationProbe::kTailBytes);
+}
+
+TEST(BatchProbeTests, FragmentedMp4_WalksFragmentHeadersAsALastResort) {
+    FragmentedLayout layout;
+    layout.fragments = 50;
+    layout.mdatBytes = 256 * 1024;
+    const std::string file = FragmentedMp4(layout);
+
+    DurationProbe probe;
+    EXPECT_EQ(Drive(probe, file).kind, ProbeStep::Done);
+    EXPECT_DOUBLE_EQ(probe.DurationMs(), 50 * 25 * 40.0);
+    EXPECT_EQ(probe.Method(), DurationMethod::FragmentWalk);
+    EXPECT_LE(probe.Reads(), 52u);
+    EXPECT_LT(probe.BytesRead() * 10, file.size()); // mdat is stepped over, never read
+
+    // No tfdt and trex defaults: the random access table cannot place the last
+    // fragment in time, so every fragment is added up from the first
+    layout.tfdt = false;
+    layout.sampleTicks = 0;
+    layout.mfra = true;
+    DurationProbe untimed;
+    EXPECT_EQ(Drive(untimed, FragmentedMp4(layout)).kind, ProbeStep::Done);
+    EXPECT_DOUBLE_EQ(untimed.DurationMs(), 50 * 25 * 40.0);
+    EXPECT_EQ(untimed.Method(), DurationMethod::FragmentWalk);
+}
+
+class BatchProbeFiles : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root_ = fs::temp_directory_path() / "test_vdu_batch_probe";
+        fs::remove_all(root_);
+        fs::create_directories(root_);
+        for (int i = 0; i < 24; i++) {
+            fs::path path = root_ / ("clip" + std::to_string(i) + (i % 2 ? ".mkv" : ".mp4"));
+            if (i % 2) WriteFile(path, Mkv(1000.0 * (i + 1), i * 10000));
+            else WriteMp4(path, 1000.0 * (i + 1), 1024 * 1024);
+            Add(path, 1000.0 * (i + 1));
+        }
+        // Transport streams need a read past the head size
+        WriteFile(root_ / "recording.ts", Ts(0, 90 * 7000, 2000));
+        Add(root_ / "recording.ts", 7000.0);
+        WriteFile(root_ / "notes.nfo", "<movie></movie>");
+        Add(root_ / "notes.nfo", 0.0);
+        Add(root_ / "missing.mkv", 0.0);
+    }
+
+    void TearDown() override { fs::remove_all(root_); }
+
+    void Add(const fs::path& path, double expected) {
+        natives_.push_back(path.native());
+        expected_.push_back(expected);
+    }
+
+    std::vector<const PathChar*> Paths() const {
+        std::vector<const PathChar*> paths;
+        for (const NativePath& path : natives_) paths.push_back(path.c_str());
+        return paths;
+    }
+
+    void ExpectResults(const std::vector<BatchProbeResult>& results) {
+        ASSERT_EQ(results.size(), expected_.size());
+        for (size_t i = 0; i < results.size(); i++) {
+            EXPECT_EQ(results[i].has_duration, expected_[i] > 0.0) << i;
+            EXPECT_DOUBLE_EQ(results[i].duration_ms, expected_[i]) << i;
+            if (expected_[i] > 0.0) {
+                EXPECT_GT(results[i].metadata.file_size_bytes, 0) << i;
+            }
+        }
+        EXPECT_FALSE(results.back().opened);
+    }
+
+    fs::path root_;
+    std::vector<NativePath> natives_;
+    std::vector<double> expected_;
+};
+
+TEST_F(BatchProbeFiles, BackendsAgree) {
+    std::vector<BatchProbeResult> results;
+    BatchProbeOptions options;
+    options.max_in_flight = 5; // smaller than the batch, so slots are reused
+
+    options.backend = BatchBackend::Sequential;
+    EXPECT_EQ(ProbeDurationsBatch(Paths(), &results, options), BatchBackend::Sequential);
+    ExpectResults(results);
+
+    options.backend = BatchBackend::ThreadPool;
+    EXPECT_EQ(ProbeDurationsBatch(Paths(), &results, options), BatchBackend::ThreadPool);
+    ExpectResults(results);
+
+    if (IoUringSupported()) {
+        options.backend = BatchBackend::IoUring;
+        EXPECT_EQ(ProbeDurationsBatch(Paths(), &results, options), BatchBackend::IoUring);
+        ExpectResults(results);
+    }
+}
+
+TEST_F(BatchProbeFiles, Export_DurationBatchUsesNativeProbe) {
+    std::vector<uint32_t> ids;
+    for (const NativePath& path : natives_) ids.push_back(PathArena::Instance().Intern(path));
+    std::vector<double> durations(ids.size(), -1.0);
+
+    EXPECT_EQ(get_video_duration_batch(ids.data(), static_cast<uint32_t>(ids.size()), durations.data()), 25u);
+    for (size_t i = 0; i < ids.size(); i++) EXPECT_DOUBLE_EQ(durations[i], expected_[i]) << i;
+    EXPECT_DOUBLE_EQ(get_video_duration(natives_[3].c_str()), 4000.0);
+}
+
+} // namespace test
+} // namespace video_data_utils
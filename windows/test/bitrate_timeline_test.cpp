@@ -0,0 +1,153 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../bitrate_timeline.h"
+#include "../path_arena.h"
+#include "../probe_cache.h"
+#include "../video_data_exporter_api.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+static std::unique_ptr<ByteSource> Source(const std::string& bytes) {
+    return MakeMemorySource(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+}
+
+// Video: 100 samples at 25 fps of 1000 + i bytes. Audio: 10 samples of 100 bytes in the
+// first 214 ms. A hint track that would double the video if it were counted.
+static std::string SampleTableMp4(uint32_t videoDelta = 1000) {
+    std::string stsz = Be32(0) + Be32(100);
+    for (uint32_t i = 0; i < 100; i++) stsz += Be32(1000 + i);
+    const std::string video = Trak("vide", 25000,
+                                   FullBox("stts", Be32(1) + Be32(100) + Be32(videoDelta)) +
+                                   FullBox("stsc", Be32(1) + Be32(1) + Be32(10) + Be32(1)) + FullBox("stsz", stsz) +
+                                   FullBox("stco", Be32(1) + Be32(4096)));
+    const std::string audio = Trak("soun", 48000,
+                                   FullBox("stts", Be32(1) + Be32(10) + Be32(1024)) + FullBox("stsc", Be32(1) + Be32(1) + Be32(10) + Be32(1)) +
+                                   FullBox("stsz", Be32(100) + Be32(10)) + FullBox("stco", Be32(1) + Be32(50)));
+    const std::string hint = Trak("hint", 25000,
+                                  FullBox("stts", Be32(1) + Be32(100) + Be32(1000)) + FullBox("stsz", Be32(5000) + Be32(100)));
+    return Ftyp() + Box("mdat", std::string(64, '\0')) + Box("moov", Mvhd(1000, 4000) + audio + hint + video);
+}
+
+// Video samples i..j-1 of SampleTableMp4 in bytes
+static double VideoBytes(uint32_t from, uint32_t to) {
+    double bytes = 0;
+    for (uint32_t i = from; i < to; i++) bytes += 1000 + i;
+    return bytes;
+}
+
+TEST(BitrateTimelineTests, Mp4_SampleSizesByDecodeTime) {
+    BitrateTimeline timeline;
+    auto source = Source(SampleTableMp4());
+    ASSERT_TRUE(BuildBitrateTimeline(*source, 1000, &timeline));
+    EXPECT_EQ(timeline.source, BitrateSource::SampleTables);
+    EXPECT_TRUE(timeline.complete);
+    EXPECT_DOUBLE_EQ(timeline.durationMs, 4000.0);
+    ASSERT_EQ(timeline.kbps.size(), 4u);
+    // bytes * 8 / 1000 ms
+    EXPECT_FLOAT_EQ(timeline.kbps[0], static_cast<float>((VideoBytes(0, 25) + 1000) * 8 / 1000));
+    EXPECT_FLOAT_EQ(timeline.kbps[3], static_cast<float>(VideoBytes(75, 100) * 8 / 1000));
+    EXPECT_EQ(timeline.mediaBytes, static_cast<uint64_t>(VideoBytes(0, 100)) + 1000);
+
+    // Finer buckets: 40 ms each holds one video frame
+    ASSERT_TRUE(BuildBitrateTimeline(*source, 40, &timeline));
+    ASSERT_EQ(timeline.kbps.size(), 100u);
+    EXPECT_FLOAT_EQ(timeline.kbps[50], 1050 * 8 / 40.0f);
+}
+
+TEST(BitrateTimelineTests, Matroska_CuesWhenDenseEnough) {
+    std::vector<std::pair<uint64_t, std::string>> clusters;
+    for (uint64_t i = 0; i < 6; i++) clusters.push_back({i * 1000, SimpleBlock(2, 0, true, 1000 * (i + 1)) + SimpleBlock(1, 0, true, 200)});
+    auto source = Source(MkvWithClusters(clusters, true, nullptr, 6000.0));
+
+    BitrateTimeline timeline;
+    ASSERT_TRUE(BuildBitrateTimeline(*source, 1000, &timeline));
+    EXPECT_EQ(timeline.source, BitrateSource::Cues);
+    EXPECT_DOUBLE_EQ(timeline.durationMs, 6000.0);
+    ASSERT_EQ(timeline.kbps.size(), 6u);
+    // Each cue span is one whole cluster, spread over the second it covers
+    for (size_t i = 0; i < 6; i++)
+        EXPECT_FLOAT_EQ(timeline.kbps[i], Cluster(i * 1000, clusters[i].second).size() * 8 / 1000.0f) << i;
+}
+
+TEST(BitrateTimelineTests, Matroska_BlockScanSkipsPayloads) {
+    std::vector<std::pair<uint64_t, std::string>> clusters;
+    for (uint64_t i = 0; i < 6; i++)
+        clusters.push_back({i * 1000, SimpleBlock(1, 0, true, 200) + SimpleBlock(2, 0, true, 40000) + SimpleBlock(2, 500, false, 1000) +
+                                          BlockGroup(2, 750, true, 3000)});
+    const std::string file = MkvWithClusters(clusters, true, nullptr, 6000.0);
+
+    // Cue points are a second apart: quarter-second buckets need the blocks
+    for (bool cues : {true, false}) {
+        auto source = Source(cues ? file : MkvWithClusters(clusters, false, nullptr, 6000.0));
+        BitrateTimeline timeline;
+        ASSERT_TRUE(BuildBitrateTimeline(*source, 250, &timeline));
+        EXPECT_EQ(timeline.source, BitrateSource::Blocks);
+        EXPECT_TRUE(timeline.complete);
+        ASSERT_EQ(timeline.kbps.size(), 24u);
+        EXPECT_FLOAT_EQ(timeline.kbps[4], (204 + 40004) * 8 / 250.0f); // a block's payload includes its 4-byte header
+        EXPECT_FLOAT_EQ(timeline.kbps[5], 0.0f);
+        EXPECT_FLOAT_EQ(timeline.kbps[6], 1004 * 8 / 250.0f);
+        EXPECT_FLOAT_EQ(timeline.kbps[7], 3004 * 8 / 250.0f);
+        EXPECT_EQ(timeline.mediaBytes, 6u * (204 + 40004 + 1004 + 3004));
+        // Headers only: a fraction of the payloads the timeline accounts for
+        EXPECT_LT(source->BytesRead(), timeline.mediaBytes / 4);
+    }
+}
+
+TEST(BitrateTimelineTests, UnsupportedDamagedAndTooLong) {
+    BitrateTimeline timeline;
+    EXPECT_FALSE(BuildBitrateTimeline(*Source(SampleTableMp4()), 0, &timeline));
+    EXPECT_FALSE(BuildBitrateTimeline(*Source("plain text, not a video"), 1000, &timeline));
+    EXPECT_FALSE(BuildBitrateTimeline(*Source(Ftyp() + Moov(1000.0)), 1000, &timeline)); // no sample tables
+    std::string truncated = SampleTableMp4();
+    truncated.resize(truncated.size() - 30);
+    EXPECT_FALSE(BuildBitrateTimeline(*Source(truncated), 1000, &timeline));
+    EXPECT_FALSE(BuildBitrateTimeline(*Source(MkvWithClusters({}, false)), 1000, &timeline));
+
+    // 100 frames of 80 seconds each: 8000 s in 1 ms buckets is over the limit
+    EXPECT_FALSE(BuildBitrateTimeline(*Source(SampleTableMp4(2000000)), 1, &timeline));
+    EXPECT_TRUE(BuildBitrateTimeline(*Source(SampleTableMp4(2000000)), 1000, &timeline));
+}
+
+TEST(BitrateTimelineTests, Export_CachedPerBucketWidth) {
+    const fs::path path = fs::temp_directory_path() / "test_vdu_bitrate.mp4";
+    WriteFile(path, SampleTableMp4());
+    const std::string utf8 = path.string();
+    const uint32_t id = path_arena_intern(utf8.data(), static_cast<uint32_t>(utf8.size()));
+    ProbeCache::Instance().Invalidate(id);
+
+    BitrateTimelineInfo info;
+    EXPECT_EQ(get_bitrate_timeline_by_id(id, 1000, nullptr, 0, &info), 4u);
+    EXPECT_GT(info.bytes_read, 0u);
+    EXPECT_EQ(info.bucket_count, 4u);
+    EXPECT_EQ(info.source, 1u);
+    EXPECT_EQ(info.complete, 1u);
+    EXPECT_EQ(info.peak_bucket, 3u);
+    EXPECT_FLOAT_EQ(info.peak_kbps, static_cast<float>(VideoBytes(75, 100) * 8 / 1000));
+    EXPECT_FLOAT_EQ(info.average_kbps, static_cast<float>((VideoBytes(0, 100) + 1000) * 8 / 4000));
+
+    // Same width: from the probe cache, nothing read
+    float kbps[2] = {};
+    EXPECT_EQ(get_bitrate_timeline_by_id(id, 1000, kbps, 2, &info), 4u);
+    EXPECT_EQ(info.bytes_read, 0u);
+    EXPECT_FLOAT_EQ(kbps[1], static_cast<float>(VideoBytes(25, 50) * 8 / 1000));
+
+    EXPECT_EQ(get_bitrate_timeline_by_id(id, 500, nullptr, 0, &info), 8u);
+    EXPECT_GT(info.bytes_read, 0u);
+    EXPECT_EQ(get_bitrate_timeline_by_id(id, 0, nullptr, 0, &info), 0u);
+    fs::remove(path);
+    EXPECT_EQ(get_bitrate_timeline_by_id(id, 500, nullptr, 0, &info), 0u);
+    EXPECT_EQ(info.bucket_count, 0u);
+}
+
+} // namespace test
+} // namespace video_data_utils
@@ -0,0 +1,193 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <thread>
+#include <vector>
+
+#include "../buffer_pool.h"
+#include "../byte_source.h"
+#include "../keyframe_index.h"
+#include "../media_probe.h"
+#include "../scratch_arena.h"
+#include "../worker_pool.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+TEST(BufferPoolTests, ReleasedBuffersAreReusedBySizeClass) {
+    BufferPool pool(1 << 20);
+    const uint8_t* first;
+    {
+        PooledBuffer buffer = pool.Acquire(5000);
+        EXPECT_EQ(buffer.size(), 5000u);
+        EXPECT_EQ(buffer.capacity(), 8192u);
+        first = buffer.data();
+    }
+    EXPECT_EQ(pool.Stats().retained_bytes, 8192u);
+
+    // Any size of the same class gets the same memory back
+    PooledBuffer again = pool.Acquire(8000);
+    EXPECT_EQ(again.data(), first);
+    PooledBuffer other = pool.Acquire(100);
+    EXPECT_EQ(other.capacity(), BufferPool::kMinClassBytes);
+
+    const BufferPoolStats stats = pool.Stats();
+    EXPECT_EQ(stats.acquires, 3u);
+    EXPECT_EQ(stats.allocations, 2u);
+    EXPECT_EQ(stats.outstanding_bytes, 8192u + 4096u);
+    EXPECT_EQ(stats.retained_bytes, 0u);
+}
+
+TEST(BufferPoolTests, ResizeKeepsContentsAndRetentionIsBounded) {
+    BufferPool pool(16 * 1024);
+    PooledBuffer buffer = pool.Acquire(10);
+    std::memcpy(buffer.data(), "0123456789", 10);
+    buffer.resize(20000);
+    EXPECT_EQ(buffer.capacity(), 32768u);
+    EXPECT_EQ(std::memcmp(buffer.data(), "0123456789", 10), 0);
+
+    // The 4 KB buffer went back to the pool; the 32 KB one does not fit the limit
+    buffer = PooledBuffer();
+    EXPECT_EQ(pool.Stats().retained_bytes, 4096u);
+
+    // Larger than every class: served and freed directly
+    {
+        PooledBuffer huge = pool.Acquire(BufferPool::kMaxClassBytes + 1);
+        EXPECT_EQ(huge.capacity(), BufferPool::kMaxClassBytes + 1);
+    }
+    EXPECT_EQ(pool.Stats().retained_bytes, 4096u);
+    pool.Trim();
+    EXPECT_EQ(pool.Stats().retained_bytes, 0u);
+    EXPECT_EQ(pool.Stats().outstanding_bytes, 0u);
+}
+
+TEST(BufferPoolTests, FileSourcesRecycleReadAhead) {
+    const fs::path path = fs::temp_directory_path() / "test_vdu_pool.mkv";
+    WriteFile(path, Mkv(1000.0, 200 * 1024));
+    auto probeOnce = [&] {
+        auto source = OpenFileSource(path.c_str(), AccessPattern::Random);
+        ASSERT_TRUE(source);
+        DurationProbe probe;
+        EXPECT_EQ(RunProbe(probe, *source).kind, ProbeStep::Done);
+    };
+    probeOnce();
+    const BufferPoolStats warm = BufferPool::Reads().Stats();
+    for (int i = 0; i < 10; i++) probeOnce();
+    const BufferPoolStats after = BufferPool::Reads().Stats();
+    EXPECT_GT(after.acquires, warm.acquires);
+    EXPECT_EQ(after.allocations, warm.allocations);
+    fs::remove(path);
+}
+
+TEST(ScratchArenaTests, ScopesRewindAndReuseBlocks) {
+    ScratchArena arena;
+    void* first;
+    {
+        ScratchArena::Scope scope(arena);
+        first = arena.Allocate(100);
+        void* second = arena.Allocate(100, 64);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(second) % 64, 0u);
+        EXPECT_GE(static_cast<uint8_t*>(second), static_cast<uint8_t*>(first) + 100);
+        {
+            ScratchArena::Scope inner(arena);
+            arena.Allocate(ScratchArena::kBlockBytes * 2); // needs a block of its own
+        }
+        EXPECT_EQ(arena.BlockAllocations(), 2u);
+    }
+    {
+        ScratchArena::Scope scope(arena);
+        EXPECT_EQ(arena.Allocate(100), first);
+        arena.Allocate(ScratchArena::kBlockBytes * 2);
+    }
+    EXPECT_EQ(arena.BlockAllocations(), 2u);
+
+    // One oversized parse does not stay pinned
+    {
+        ScratchArena::Scope scope(arena);
+        arena.Allocate(ScratchArena::kRetainedBytes * 2);
+    }
+    EXPECT_LE(arena.Capacity(), ScratchArena::kRetainedBytes);
+}
+
+TEST(ScratchArenaTests, ScratchBytesGrowWithContents) {
+    ScratchArena::Scope scope;
+    ScratchBytes bytes;
+    EXPECT_TRUE(bytes.empty());
+    bytes.resize(3);
+    std::memcpy(bytes.data(), "abc", 3);
+    bytes.resize(100000);
+    EXPECT_EQ(bytes.size(), 100000u);
+    EXPECT_EQ(std::memcmp(bytes.data(), "abc", 3), 0);
+}
+
+TEST(ScratchArenaTests, KeyframeParsesStopAllocatingOnceWarm) {
+    const std::string file = MkvWithClusters({{0, SimpleBlock(1, 0, true)}, {2000, SimpleBlock(1, 0, true)}}, true);
+    auto build = [&] {
+        auto mkv = MakeMemorySource(reinterpret_cast<const uint8_t*>(file.data()), file.size());
+        KeyframeIndex index;
+        EXPECT_TRUE(BuildKeyframeIndex(*mkv, &index));
+        EXPECT_EQ(index.Count(), 2u);
+    };
+    build();
+    const uint64_t blocks = ScratchArena::ForThread().BlockAllocations();
+    for (int i = 0; i < 20; i++) build();
+    EXPECT_EQ(ScratchArena::ForThread().BlockAllocations(), blocks);
+}
+
+TEST(MemoryBudgetTests, AcquireWaitsForRoom) {
+    MemoryBudget budget(100);
+    MemoryBudget::Lease a = budget.Acquire(60);
+    MemoryBudget::Lease b;
+    EXPECT_FALSE(budget.TryAcquire(60, &b));
+    EXPECT_TRUE(budget.TryAcquire(40, &b));
+    EXPECT_EQ(budget.InFlight(), 100u);
+
+    std::atomic<bool> granted{false};
+    std::thread waiter([&] {
+        MemoryBudget::Lease c = budget.Acquire(50);
+        granted = true;
+    });
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    EXPECT_FALSE(granted);
+    a.Release();
+    waiter.join();
+    EXPECT_TRUE(granted);
+    EXPECT_EQ(budget.Waits(), 1u);
+    EXPECT_EQ(budget.HighWater(), 100u);
+
+    // Larger than the whole budget: granted once nothing else holds it
+    b.Release();
+    MemoryBudget::Lease huge = budget.Acquire(1000);
+    EXPECT_EQ(budget.InFlight(), 1000u);
+}
+
+TEST(MemoryBudgetTests, SubmitWithinBoundsWorkInFlight) {
+    WorkerPool pool(8);
+    MemoryBudget budget(3 * 1024);
+    std::atomic<int> running{0}, peak{0};
+    for (int i = 0; i < 32; i++) {
+        pool.SubmitWithin(budget, 1024, [&] {
+            const int now = ++running;
+            int seen = peak;
+            while (now > seen && !peak.compare_exchange_weak(seen, now)) {
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(2));
+            --running;
+        });
+    }
+    pool.WaitIdle();
+    EXPECT_LE(peak.load(), 3);
+    EXPECT_LE(budget.HighWater(), 3u * 1024);
+    EXPECT_EQ(budget.InFlight(), 0u);
+    EXPECT_GT(budget.Waits(), 0u);
+}
+
+} // namespace test
+} // namespace video_data_utils
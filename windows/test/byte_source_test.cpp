@@ -0,0 +1,118 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../byte_source.h"
+#include "../media_probe.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+static std::string Pattern(size_t length) {
+    std::string data(length, '\0');
+    for (size_t i = 0; i < length; i++) data[i] = static_cast<char>((i * 7) ^ (i >> 8));
+    return data;
+}
+
+static std::string ReadString(ByteSource& source, uint64_t offset, size_t length) {
+    std::string out(length, '\0');
+    out.resize(source.ReadAt(offset, reinterpret_cast<uint8_t*>(&out[0]), length));
+    return out;
+}
+
+class ByteSourceFile : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path_ = fs::temp_directory_path() / "test_vdu_byte_source.bin";
+        data_ = Pattern(100 * 1024);
+        WriteFile(path_, data_);
+    }
+
+    void TearDown() override { fs::remove(path_); }
+
+    fs::path path_;
+    std::string data_;
+};
+
+TEST(ByteSourceTests, Memory_ReadsViewsAndCounts) {
+    const std::string data = Pattern(1000);
+    auto source = MakeMemorySource(reinterpret_cast<const uint8_t*>(data.data()), data.size());
+
+    EXPECT_EQ(source->Size(), 1000u);
+    EXPECT_EQ(ReadString(*source, 10, 20), data.substr(10, 20));
+    EXPECT_EQ(ReadString(*source, 990, 100), data.substr(990)); // short at the end
+    EXPECT_EQ(ReadString(*source, 2000, 10), "");
+    ASSERT_NE(source->View(100, 900), nullptr);
+    EXPECT_EQ(source->View(100, 901), nullptr);
+    EXPECT_EQ(source->BytesRead(), 20u + 10u + 900u);
+}
+
+TEST_F(ByteSourceFile, Positional_CoalescesAdjacentReads) {
+    auto source = OpenFileSource(path_.c_str(), AccessPattern::Random, 16 * 1024);
+    ASSERT_TRUE(source);
+    EXPECT_EQ(source->Size(), data_.size());
+
+    // A parser walking box headers: all served by the first read-ahead
+    EXPECT_EQ(ReadString(*source, 0, 16), data_.substr(0, 16));
+    EXPECT_EQ(ReadString(*source, 16, 100), data_.substr(16, 100));
+    EXPECT_EQ(ReadString(*source, 4000, 200), data_.substr(4000, 200));
+    EXPECT_EQ(source->ReadCalls(), 1u);
+
+    // Crossing the end of the segment extends it with one more read
+    EXPECT_EQ(ReadString(*source, 16 * 1024 - 8, 64), data_.substr(16 * 1024 - 8, 64));
+    EXPECT_EQ(source->ReadCalls(), 2u);
+    EXPECT_EQ(ReadString(*source, 100, 20000), data_.substr(100, 20000));
+    EXPECT_EQ(source->ReadCalls(), 2u);
+
+    // Large reads bypass the cache
+    EXPECT_EQ(ReadString(*source, 50 * 1024, 40 * 1024), data_.substr(50 * 1024, 40 * 1024));
+    EXPECT_EQ(source->ReadCalls(), 3u);
+    EXPECT_EQ(source->BytesRead(), 32u * 1024 + 40 * 1024);
+
+    // Tail of the file, short read
+    EXPECT_EQ(ReadString(*source, data_.size() - 10, 100), data_.substr(data_.size() - 10));
+}
+
+TEST_F(ByteSourceFile, Mapped_MatchesFileContents) {
+    auto source = OpenMappedSource(path_.c_str(), AccessPattern::Sequential);
+    ASSERT_TRUE(source);
+    EXPECT_EQ(source->Size(), data_.size());
+    EXPECT_EQ(ReadString(*source, 12345, 5000), data_.substr(12345, 5000));
+
+    const uint8_t* view = source->View(0, data_.size());
+    ASSERT_NE(view, nullptr);
+    EXPECT_EQ(std::string(reinterpret_cast<const char*>(view), data_.size()), data_);
+    source->Hint(AccessPattern::Random);
+
+    EXPECT_FALSE(OpenMappedSource((fs::temp_directory_path() / "test_vdu_missing.bin").c_str(), AccessPattern::Random));
+}
+
+TEST(ByteSourceTests, DurationProbeReadsOnlyHeaders) {
+    const fs::path mp4 = fs::temp_directory_path() / "test_vdu_byte_source.mp4";
+    const fs::path mkv = fs::temp_directory_path() / "test_vdu_byte_source.mkv";
+    WriteMp4(mp4, 7200000.0, 1ull << 30); // moov after a 1 GiB (sparse) mdat
+    WriteFile(mkv, Mkv(7200000.0, 300 * 1024));
+
+    for (const fs::path& path : {mp4, mkv}) {
+        for (bool mapped : {false, true}) {
+            auto source = mapped ? OpenMappedSource(path.c_str(), AccessPattern::Random)
+                                 : OpenFileSource(path.c_str(), AccessPattern::Random);
+            ASSERT_TRUE(source);
+            DurationProbe probe;
+            EXPECT_EQ(RunProbe(probe, *source).kind, ProbeStep::Done) << path;
+            EXPECT_DOUBLE_EQ(probe.DurationMs(), 7200000.0);
+            EXPECT_LT(source->BytesRead(), 48u * 1024) << path << (mapped ? " mapped" : " positional");
+        }
+    }
+    fs::remove(mp4);
+    fs::remove(mkv);
+}
+
+} // namespace test
+} // namespace video_data_utils
@@ -0,0 +1,107 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../content_sniffer.h"
+#include "../video_data_exporter_api.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+static ContainerKind Sniff(const std::string& bytes) {
+    std::string head = bytes;
+    head.resize(std::max<size_t>(head.size(), kSniffHeadBytes), '\0');
+    return SniffBuffer(reinterpret_cast<const uint8_t*>(head.data()), head.size(), nullptr, 0);
+}
+
+static std::string Transport(size_t packets, size_t stride, size_t prefix) {
+    std::string data(packets * stride, '\0');
+    for (size_t i = 0; i < packets; i++) data[i * stride + prefix] = 0x47;
+    return data;
+}
+
+static fs::path WriteTemp(const std::string& name, const std::string& bytes) {
+    fs::path path = fs::temp_directory_path() / ("test_vdu_sniff_" + name);
+    std::ofstream(path, std::ios::binary) << bytes;
+    return path;
+}
+
+TEST(ContentSnifferTests, IsoBmffBrands) {
+    EXPECT_EQ(Sniff(std::string("\x00\x00\x00\x20" "ftypisom\x00\x00\x02\x00", 16)), ContainerKind::IsoBmff);
+    EXPECT_EQ(Sniff(std::string("\x00\x00\x00\x14" "ftypqt  \x00\x00\x02\x00", 16)), ContainerKind::QuickTime);
+    EXPECT_EQ(Sniff(std::string("\x00\x00\x00\x18" "ftypheic\x00\x00\x00\x00", 16)), ContainerKind::Image);
+    EXPECT_EQ(Sniff(std::string("\x00\x00\x00\x08" "wide", 8)), ContainerKind::QuickTime);
+}
+
+TEST(ContentSnifferTests, EbmlDocType) {
+    // EBML header: size 0x9F, EBMLVersion 1, then DocType
+    std::string webm("\x1A\x45\xDF\xA3\x9F\x42\x86\x81\x01\x42\x82\x84webm", 16);
+    std::string mkv("\x1A\x45\xDF\xA3\x9F\x42\x86\x81\x01\x42\x82\x88matroska", 20);
+    EXPECT_EQ(Sniff(webm), ContainerKind::WebM);
+    EXPECT_EQ(Sniff(mkv), ContainerKind::Matroska);
+}
+
+TEST(ContentSnifferTests, LegacyContainers) {
+    EXPECT_EQ(Sniff(std::string("RIFF\x10\x00\x00\x00" "AVI LIST", 16)), ContainerKind::Avi);
+    EXPECT_EQ(Sniff(std::string("RIFF\x10\x00\x00\x00" "WEBPVP8 ", 16)), ContainerKind::Image);
+    EXPECT_EQ(Sniff(std::string("RIFF\x10\x00\x00\x00" "WAVEfmt ", 16)), ContainerKind::Unknown);
+    EXPECT_EQ(Sniff(std::string("\x30\x26\xB2\x75\x8E\x66\xCF\x11\xA6\xD9\x00\xAA\x00\x62\xCE\x6C", 16)), ContainerKind::Asf);
+    EXPECT_EQ(Sniff(std::string("FLV\x01\x05", 5)), ContainerKind::Flv);
+    EXPECT_EQ(Sniff(std::string("OggS\x00\x02", 6)), ContainerKind::Ogg);
+    EXPECT_EQ(Sniff(std::string("\x00\x00\x01\xBA\x44", 5)), ContainerKind::MpegPs);
+}
+
+TEST(ContentSnifferTests, TransportStreamSync) {
+    std::string ts = Transport(4, 188, 0);
+    std::string m2ts = Transport(4, 192, 4);
+    EXPECT_EQ(SniffBuffer(reinterpret_cast<const uint8_t*>(ts.data()), ts.size(), nullptr, 0), ContainerKind::MpegTs);
+    EXPECT_EQ(SniffBuffer(reinterpret_cast<const uint8_t*>(m2ts.data()), m2ts.size(), nullptr, 0), ContainerKind::M2ts);
+
+    // A stream cut mid-packet: sync starts 100 bytes in
+    std::string cut = std::string(100, 'x') + ts;
+    EXPECT_EQ(SniffBuffer(reinterpret_cast<const uint8_t*>(cut.data()), cut.size(), nullptr, 0), ContainerKind::MpegTs);
+
+    // A single 'G' is not enough
+    EXPECT_EQ(Sniff("Generic text file"), ContainerKind::Unknown);
+}
+
+TEST(ContentSnifferTests, ShortcutsAndNonMedia) {
+    std::string lnk("\x4C\x00\x00\x00\x01\x14\x02\x00\x00\x00\x00\x00\xC0\x00\x00\x00\x00\x00\x00\x46", 20);
+    EXPECT_EQ(Sniff(lnk), ContainerKind::ShellLink);
+    EXPECT_EQ(RouteFor(ContainerKind::ShellLink), SniffRoute::Shortcut);
+
+    EXPECT_EQ(Sniff("\x89PNG\r\n\x1A\n"), ContainerKind::Image);
+    EXPECT_EQ(Sniff("\xFF\xD8\xFF\xE0"), ContainerKind::Image);
+    EXPECT_EQ(Sniff("PK\x03\x04"), ContainerKind::Archive);
+    EXPECT_EQ(Sniff("%PDF-1.7"), ContainerKind::Document);
+    EXPECT_EQ(Sniff("1\r\n00:00:01,000 --> 00:00:02,000\r\nHello"), ContainerKind::Unknown);
+    EXPECT_EQ(RouteFor(ContainerKind::Image), SniffRoute::Reject);
+    EXPECT_TRUE(IsMediaContainer(ContainerKind::Matroska));
+}
+
+TEST(ContentSnifferTests, SniffFile_UsesTailForMisalignedTransport) {
+    // Garbage head, then whole packets up to the end of the file
+    std::string data = std::string(700, '\x01') + Transport(8, 188, 0);
+    fs::path path = WriteTemp("tail.ts", data);
+    EXPECT_EQ(SniffFile(path.c_str()), ContainerKind::MpegTs);
+    fs::remove(path);
+}
+
+TEST(ContentSnifferTests, Export_RejectsNonMediaBeforeProbing) {
+    fs::path subtitle = WriteTemp("subs.srt", "1\r\n00:00:01,000 --> 00:00:02,000\r\nHello\r\n");
+    fs::path missing = fs::temp_directory_path() / "test_vdu_sniff_missing.mkv";
+
+    EXPECT_EQ(sniff_file(subtitle.c_str()), static_cast<uint8_t>(ContainerKind::Unknown));
+    EXPECT_EQ(sniff_file(missing.c_str()), static_cast<uint8_t>(ContainerKind::Unknown));
+    EXPECT_EQ(sniff_file(nullptr), static_cast<uint8_t>(ContainerKind::Unknown));
+    EXPECT_LE(get_video_duration(subtitle.c_str()), 0.0);
+
+    fs::remove(subtitle);
+}
+
+} // namespace test
+} // namespace video_data_utils
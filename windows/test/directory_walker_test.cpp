@@ -0,0 +1,199 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "../directory_walker.h"
+#include "../path_arena.h"
+#include "../video_data_exporter_api.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+class DirectoryWalkerTests : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root_ = fs::temp_directory_path() / "test_vdu_directory_walker";
+        fs::remove_all(root_);
+        // A wide level over a deep chain, so that idle threads have something to steal
+        for (int a = 0; a < 6; a++)
+            for (int b = 0; b < 4; b++) {
+                const fs::path dir = root_ / ("d" + std::to_string(a)) / ("e" + std::to_string(b));
+                fs::create_directories(dir);
+                for (int i = 0; i < 5; i++) WriteFile(dir / ("clip" + std::to_string(i) + ".mkv"), std::string(10 + i, 'v'));
+            }
+        fs::path deep = root_ / "deep";
+        for (int i = 0; i < 12; i++) deep /= "level" + std::to_string(i);
+        fs::create_directories(deep);
+        WriteFile(deep / "bottom.mkv", "v");
+        WriteFile(root_ / "top.mkv", "vv");
+    }
+    void TearDown() override { fs::remove_all(root_); }
+
+    // What std::filesystem finds, in the walk's ordered sequence: pre-order, names sorted per level
+    std::vector<NativePath> Expected() const {
+        std::vector<NativePath> out;
+        std::vector<fs::path> stack{root_};
+        while (!stack.empty()) {
+            const fs::path dir = stack.back();
+            stack.pop_back();
+            if (dir != root_) out.push_back(dir.native());
+            std::vector<fs::path> files, dirs;
+            for (const auto& entry : fs::directory_iterator(dir)) (entry.is_directory() ? dirs : files).push_back(entry.path());
+            std::sort(files.begin(), files.end());
+            std::sort(dirs.rbegin(), dirs.rend());
+            for (const fs::path& file : files) out.push_back(file.native());
+            stack.insert(stack.end(), dirs.begin(), dirs.end());
+        }
+        return out;
+    }
+
+    std::vector<NativePath> Walk(const WalkOptions& options, WalkStats* stats) const {
+        std::vector<NativePath> out;
+        EXPECT_TRUE(WalkDirectory(root_.native(), options, [&](std::vector<WalkEntry>&& entries) {
+            for (const WalkEntry& entry : entries) out.push_back(entry.path);
+            return true;
+        }, stats));
+        return out;
+    }
+
+    fs::path root_;
+};
+
+TEST_F(DirectoryWalkerTests, ReportsEveryEntryOnce) {
+    std::vector<NativePath> expected = Expected();
+    std::sort(expected.begin(), expected.end());
+    for (uint32_t threads : {1u, 4u, 16u}) {
+        WalkOptions options;
+        options.threads = threads;
+        WalkStats stats;
+        std::vector<NativePath> walked = Walk(options, &stats);
+        std::sort(walked.begin(), walked.end());
+        EXPECT_EQ(walked, expected) << threads;
+        EXPECT_EQ(stats.directories, 6u + 24u + 13u + 1u);
+        EXPECT_EQ(stats.files, 24u * 5u + 2u);
+        EXPECT_EQ(stats.errors, 0u);
+        EXPECT_EQ(stats.loops, 0u);
+    }
+}
+
+TEST_F(DirectoryWalkerTests, OrderedIsSortedPreOrderOnEveryRun) {
+    const std::vector<NativePath> expected = Expected();
+    for (int run = 0; run < 5; run++) {
+        WalkOptions options;
+        options.threads = 6;
+        options.ordered = true;
+        WalkStats stats;
+        EXPECT_EQ(Walk(options, &stats), expected) << run;
+    }
+}
+
+TEST_F(DirectoryWalkerTests, StatFilesFillsSizes) {
+    WalkOptions options;
+    options.stat_files = true;
+    bool sawTop = false;
+    ASSERT_TRUE(WalkDirectory(root_.native(), options, [&](std::vector<WalkEntry>&& entries) {
+        for (const WalkEntry& entry : entries) {
+            if (entry.is_directory) continue;
+            EXPECT_EQ(entry.size, fs::file_size(entry.path));
+            EXPECT_GT(entry.mtime_ns, 0);
+            sawTop = sawTop || fs::path(entry.path).filename() == "top.mkv";
+        }
+        return true;
+    }, nullptr));
+    EXPECT_TRUE(sawTop);
+}
+
+TEST_F(DirectoryWalkerTests, SymlinkLoopsAreCut) {
+    const size_t plain = Expected().size();
+    fs::create_directory_symlink(root_, root_ / "d0" / "e0" / "back_to_root");
+    fs::create_directory_symlink(root_ / "d1", root_ / "d2" / "to_d1");
+
+    // Not following: the links are neither walked nor reported
+    WalkStats stats;
+    std::vector<NativePath> walked = Walk(WalkOptions(), &stats);
+    EXPECT_EQ(walked.size(), plain);
+    EXPECT_EQ(stats.loops, 0u);
+
+    // Following: the link to d1 is a second copy of it, the link to the root is cut after one step
+    WalkOptions options;
+    options.follow_symlinks = true;
+    walked = Walk(options, &stats);
+    EXPECT_EQ(stats.loops, 1u);
+    EXPECT_EQ(stats.directories, 44u + 1u + 4u);
+    const std::set<NativePath> unique(walked.begin(), walked.end());
+    EXPECT_EQ(unique.size(), walked.size());
+    EXPECT_TRUE(unique.count((root_ / "d2" / "to_d1" / "e3" / "clip4.mkv").native()));
+    EXPECT_TRUE(unique.count((root_ / "d0" / "e0" / "back_to_root").native()));
+    EXPECT_FALSE(unique.count((root_ / "d0" / "e0" / "back_to_root" / "top.mkv").native()));
+}
+
+TEST_F(DirectoryWalkerTests, SmallBudgetAndEarlyStop) {
+    WalkOptions options;
+    options.threads = 8;
+    options.max_buffered_entries = 4; // below a single listing: helpers proceed one directory at a time
+    for (bool ordered : {false, true}) {
+        options.ordered = ordered;
+        WalkStats stats;
+        EXPECT_EQ(Walk(options, &stats).size(), Expected().size()) << ordered;
+
+        size_t delivered = 0;
+        EXPECT_TRUE(WalkDirectory(root_.native(), options, [&](std::vector<WalkEntry>&& entries) {
+            delivered += entries.size();
+            return delivered < 10;
+        }, &stats));
+        EXPECT_GE(delivered, 10u);
+        EXPECT_LT(delivered, Expected().size());
+    }
+
+    EXPECT_FALSE(WalkDirectory((root_ / "missing").native(), options, [](std::vector<WalkEntry>&&) { return true; }, nullptr));
+}
+
+TEST_F(DirectoryWalkerTests, Export_WalkStreamsRecords) {
+    const std::string utf8 = root_.string();
+    const uint32_t rootId = path_arena_intern(utf8.data(), static_cast<uint32_t>(utf8.size()));
+
+    const int32_t handle = walk_start(rootId, 4, 2 | 4);
+    ASSERT_GT(handle, 0);
+    std::vector<WalkRecord> records;
+    WalkRecord batch[16];
+    WalkProgress progress = {};
+    for (;;) {
+        const uint32_t n = walk_poll(handle, batch, 16, 1000);
+        records.insert(records.end(), batch, batch + n);
+        EXPECT_TRUE(walk_stats(handle, &progress));
+        if (n == 0 && progress.finished) break;
+    }
+    EXPECT_TRUE(walk_close(handle));
+    EXPECT_FALSE(walk_close(handle));
+
+    const std::vector<NativePath> expected = Expected();
+    ASSERT_EQ(records.size(), expected.size());
+    for (size_t i = 0; i < records.size(); i++) {
+        EXPECT_EQ(NativePath(path_arena_get(records[i].path_id, nullptr)), expected[i]);
+        EXPECT_EQ(records[i].is_directory != 0, fs::is_directory(expected[i]));
+        if (!records[i].is_directory) {
+            EXPECT_EQ(records[i].size_bytes, fs::file_size(expected[i]));
+        }
+    }
+    EXPECT_EQ(progress.files, 24u * 5u + 2u);
+    EXPECT_EQ(progress.errors, 0u);
+
+    // Closing a walk nobody polls stops it
+    const int32_t unpolled = walk_start(rootId, 2, 0);
+    ASSERT_GT(unpolled, 0);
+    EXPECT_TRUE(walk_close(unpolled));
+
+    const std::string missing = (root_ / "missing").string();
+    EXPECT_EQ(walk_start(path_arena_intern(missing.data(), static_cast<uint32_t>(missing.size())), 0, 0), -1);
+}
+
+} // namespace test
+} // namespace video_data_utils
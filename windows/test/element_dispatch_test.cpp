@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+#include "../container_probe.h"
+#include "../element_dispatch.h"
+#include "../media_probe.h"
+#include "media_fixtures.h"
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+using Mp4Duration = Dispatch<IsoBmffRules<ProbeKind::Duration>>;
+using MkvStreams = Dispatch<EbmlRules<ProbeKind::Streams>>;
+
+// Lookups are resolved by the compiler
+static_assert(Mp4Duration::Find(FourCC("mvhd"))->policy == ElementPolicy::Read, "mvhd is read");
+static_assert(Mp4Duration::Find(FourCC("trak")) == nullptr, "a duration probe never opens a track");
+static_assert(MkvStreams::Find(0x1F43B675)->policy == ElementPolicy::Stop, "clusters end the header walk");
+
+static std::unique_ptr<ByteSource> Source(const std::string& bytes) {
+    return MakeMemorySource(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+}
+
+static std::string Tkhd(uint16_t width, uint16_t height) {
+    return FullBox("tkhd", std::string(72, '\0') + Be32(uint32_t(width) << 16) + Be32(uint32_t(height) << 16));
+}
+
+static std::string VideoEntry(const char* format, uint16_t width, uint16_t height) {
+    return Box(format, std::string(6, '\0') + Be16(1) + std::string(16, '\0') + Be16(width) + Be16(height) + std::string(50, '\0'));
+}
+
+static std::string AudioEntry(const char* format, uint16_t channels, uint32_t sampleRate) {
+    return Box(format, std::string(6, '\0') + Be16(1) + std::string(8, '\0') + Be16(channels) + Be16(16) + std::string(4, '\0') +
+                           Be32(sampleRate << 16));
+}
+
+static std::string TrakWith(const std::string& tkhd, const char* handler, const std::string& entry) {
+    const std::string trak = Trak(handler, 1000, FullBox("stsd", Be32(1) + entry) + FullBox("stsz", Be32(0) + Be32(0)));
+    return Box("trak", tkhd + trak.substr(8));
+}
+
+template <typename Rules>
+static void ExpectEveryRuleFound() {
+    for (const ElementRule& rule : Rules::kRules) {
+        const ElementRule* found = Dispatch<Rules>::Find(rule.id);
+        ASSERT_NE(found, nullptr);
+        EXPECT_EQ(found, &rule);
+    }
+}
+
+TEST(ElementDispatchTests, PerfectHashFindsEveryRuleAndNothingElse) {
+    ExpectEveryRuleFound<IsoBmffRules<ProbeKind::Duration>>();
+    ExpectEveryRuleFound<IsoBmffRules<ProbeKind::Streams>>();
+    ExpectEveryRuleFound<IsoBmffRules<ProbeKind::CoverArt>>();
+    ExpectEveryRuleFound<EbmlRules<ProbeKind::Duration>>();
+    ExpectEveryRuleFound<EbmlRules<ProbeKind::Streams>>();
+    ExpectEveryRuleFound<EbmlRules<ProbeKind::CoverArt>>();
+
+    int found = 0;
+    for (uint64_t id = 0x80; id < 0x10000; id++) found += MkvStreams::Find(id) != nullptr;
+    EXPECT_EQ(found, 12); // the one- and two-byte IDs in the table
+    EXPECT_EQ(Mp4Duration::Find(FourCC("moof")), nullptr);
+}
+
+struct CountingVisitor : ElementVisitor {
+    std::vector<ElementField> fields;
+    int entered = 0;
+
+    bool OnEnter(const ElementRule&, uint64_t, uint64_t) {
+        entered++;
+        return true;
+    }
+    bool OnField(const ElementRule& rule, const ElementValue&) {
+        fields.push_back(rule.field);
+        return true;
+    }
+};
+
+TEST(ElementDispatchTests, DurationRulesSkipTracksUnread) {
+    const std::string moov = Box("moov", Mvhd(1000, 5000) + TrakWith(Tkhd(640, 480), "vide", VideoEntry("avc1", 640, 480)));
+    BufferReader reader{reinterpret_cast<const uint8_t*>(moov.data()), 0, moov.size()};
+
+    CountingVisitor duration;
+    EXPECT_TRUE(WalkElements<IsoBmffRules<ProbeKind::Duration>>(reader, 0, moov.size(), duration));
+    EXPECT_EQ(duration.entered, 1); // moov only
+    EXPECT_EQ(duration.fields, std::vector<ElementField>{ElementField::MovieHeader});
+
+    CountingVisitor streams;
+    WalkElements<IsoBmffRules<ProbeKind::Streams>>(reader, 0, moov.size(), streams);
+    EXPECT_EQ(streams.fields, (std::vector<ElementField>{ElementField::TrackHeader, ElementField::Handler, ElementField::SampleDescription}));
+}
+
+TEST(ElementDispatchTests, TruncatedBuffersYieldWhatIsComplete) {
+    const std::string info = MkvInfo(42000.0);
+    BufferReader reader{reinterpret_cast<const uint8_t*>(info.data()), 0, info.size() - 3};
+
+    CountingVisitor visitor;
+    EXPECT_TRUE(WalkElements<EbmlRules<ProbeKind::Duration>>(reader, 0, info.size() - 3, visitor));
+    // Duration lost its last bytes, so it is no longer an 8-byte float
+    EXPECT_EQ(visitor.fields, std::vector<ElementField>{ElementField::TimestampScale});
+}
+
+TEST(ContainerProbeTests, Mp4StreamsFromTrackHeadersAndSampleEntries) {
+    const std::string video = TrakWith(Tkhd(1920, 800), "vide", VideoEntry("avc1", 1920, 816));
+    const std::string audio = TrakWith(Tkhd(0, 0), "soun", AudioEntry("mp4a", 2, 48000));
+    const std::string file = Ftyp() + Box("mdat", std::string(4096, '\0')) + Box("moov", Mvhd(1000, 5000) + video + audio);
+
+    std::vector<StreamInfo> streams;
+    ASSERT_TRUE(ProbeStreams(*Source(file), &streams));
+    ASSERT_EQ(streams.size(), 2u);
+    EXPECT_EQ(streams[0].type, StreamType::Video);
+    EXPECT_STREQ(streams[0].codec, "avc1");
+    EXPECT_EQ(streams[0].width, 1920u);
+    EXPECT_EQ(streams[0].height, 800u); // display size wins over the coded size
+    EXPECT_EQ(streams[1].type, StreamType::Audio);
+    EXPECT_STREQ(streams[1].codec, "mp4a");
+    EXPECT_EQ(streams[1].channels, 2u);
+    EXPECT_EQ(streams[1].sample_rate, 48000u);
+
+    std::vector<StreamInfo> none;
+    EXPECT_FALSE(ProbeStreams(*Source(std::string(256, 'x')), &none));
+}
+
+TEST(ContainerProbeTests, MatroskaStreamsThroughSeekHeadAfterClusters) {
+    const std::string video = Ebml(0xAE, EbmlUInt(0xD7, 1) + EbmlUInt(0x83, 1) + Ebml(0x86, "V_MPEG4/ISO/AVC") +
+                                             Ebml(0xE0, EbmlUInt(0xB0, 1280) + EbmlUInt(0xBA, 720)));
+    const std::string audio = Ebml(0xAE, EbmlUInt(0xD7, 2) + EbmlUInt(0x83, 2) + Ebml(0x86, "A_OPUS") +
+                                             Ebml(0xE1, EbmlFloat(0xB5, 48000.0) + EbmlUInt(0x9F, 6)));
+    const std::string tracks = Ebml(0x1654AE6B, video + audio);
+    const std::string cluster = Cluster(0, SimpleBlock(1, 0, true, 4096));
+    auto seekHead = [](uint64_t position) {
+        return Ebml(0x114D9B74, Ebml(0x4DBB, Ebml(0x53AB, EbmlId(0x1654AE6B)) + EbmlUInt(0x53AC, position)));
+    };
+    const std::string info = MkvInfo(1000.0);
+    const uint64_t tracksAt = seekHead(0).size() + info.size() + cluster.size();
+    const std::string file = EbmlHeader("matroska") + Ebml(0x18538067, seekHead(tracksAt) + info + cluster + tracks);
+
+    std::vector<StreamInfo> streams;
+    ASSERT_TRUE(ProbeStreams(*Source(file), &streams));
+    ASSERT_EQ(streams.size(), 2u);
+    EXPECT_EQ(streams[0].type, StreamType::Video);
+    EXPECT_STREQ(streams[0].codec, "V_MPEG4/ISO/AVC");
+    EXPECT_EQ(streams[0].width, 1280u);
+    EXPECT_EQ(streams[0].height, 720u);
+    EXPECT_EQ(streams[1].type, StreamType::Audio);
+    EXPECT_STREQ(streams[1].codec, "A_OPUS");
+    EXPECT_EQ(streams[1].sample_rate, 48000u);
+    EXPECT_EQ(streams[1].channels, 6u);
+}
+
+TEST(ContainerProbeTests, CoverArtIsLocatedNotRead) {
+    const std::string image = "\x89PNG....";
+    const std::string covr = Box("covr", Box("data", Be32(14) + Be32(0) + image));
+    const std::string meta = FullBox("meta", FullBox("hdlr", Be32(0) + "mdir" + std::string(12, '\0')) + Box("ilst", covr));
+    const std::string file = Ftyp() + Box("moov", Mvhd(1000, 5000) + Box("udta", meta));
+
+    CoverArt cover;
+    ASSERT_TRUE(FindCoverArt(*Source(file), &cover));
+    EXPECT_STREQ(cover.media_type, "image/png");
+    EXPECT_EQ(cover.size, image.size());
+    EXPECT_EQ(file.substr(static_cast<size_t>(cover.offset), image.size()), image);
+
+    // Matroska: the attachment named cover wins over an earlier image
+    auto attachment = [](const std::string& name, const char* type, const std::string& data) {
+        return Ebml(0x61A7, Ebml(0x466E, name) + Ebml(0x4660, type) + Ebml(0x465C, data));
+    };
+    const std::string attachments = Ebml(0x1941A469, attachment("font.ttf", "font/ttf", "FONT") +
+                                                         attachment("still.jpg", "image/jpeg", "STILL") +
+                                                         attachment("cover.jpg", "image/jpeg", "COVER"));
+    const std::string mkv = EbmlHeader("matroska") + Ebml(0x18538067, MkvInfo(1000.0) + attachments);
+    ASSERT_TRUE(FindCoverArt(*Source(mkv), &cover));
+    EXPECT_STREQ(cover.media_type, "image/jpeg");
+    EXPECT_EQ(mkv.substr(static_cast<size_t>(cover.offset), static_cast<size_t>(cover.size)), "COVER");
+
+    EXPECT_FALSE(FindCoverArt(*Source(Mkv(1000.0)), &cover));
+}
+
+} // namespace test
+} // namespace video_data_utils
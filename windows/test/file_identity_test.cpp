@@ -0,0 +1,162 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../directory_walker.h"
+#include "../file_identity.h"
+#include "../file_metadata.h"
+#include "../file_probe.h"
+#include "../hot_cache.h"
+#include "../probe_cache.h"
+#include "../thumbnail_cache.h"
+#include "../video_data_exporter_api.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+class FileIdentityTests : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = fs::temp_directory_path() / "test_vdu_file_identity";
+        fs::remove_all(dir_);
+        fs::create_directories(dir_ / "seeding");
+        fs::create_directories(dir_ / "library");
+        WriteFile(dir_ / "seeding" / "movie.mkv", Mkv(5000.0, 4096));
+        fs::create_hard_link(dir_ / "seeding" / "movie.mkv", dir_ / "library" / "movie.mkv");
+        fs::create_hard_link(dir_ / "seeding" / "movie.mkv", dir_ / "library" / "movie (copy).mkv");
+        WriteFile(dir_ / "library" / "other.mkv", Mkv(7000.0));
+        daemon_set_endpoint(PATH_LITERAL(""));
+        // Off, so every call reaches the probe cache behind it
+        set_hot_cache_limits(0, 0);
+        ProbeCache::Instance().Clear();
+        FileIdentityIndex::Instance().Clear();
+    }
+    void TearDown() override {
+        set_hot_cache_limits(kHotCacheDefaultBudget, kHotCacheDefaultMaxAgeMs);
+        fs::remove_all(dir_);
+    }
+
+    uint32_t Id(const fs::path& path) const {
+        const std::string utf8 = path.string();
+        return path_arena_intern(utf8.data(), static_cast<uint32_t>(utf8.size()));
+    }
+
+    FileIdentityStats Stats() const {
+        FileIdentityStats stats;
+        get_file_identity_stats(&stats);
+        return stats;
+    }
+
+    fs::path dir_;
+};
+
+TEST_F(FileIdentityTests, WalkReportsOneIdentityPerFile) {
+    std::vector<WalkEntry> files;
+    WalkOptions options;
+    options.threads = 2;
+    ASSERT_TRUE(WalkDirectory(dir_.native(), options, [&](std::vector<WalkEntry>&& entries) {
+        for (WalkEntry& entry : entries)
+            if (!entry.is_directory) files.push_back(std::move(entry));
+        return true;
+    }, nullptr));
+    ASSERT_EQ(files.size(), 4u);
+
+    FileMetadata metadata;
+    FileIdentity seeded, other;
+    ASSERT_TRUE(ReadFileMetadata((dir_ / "seeding" / "movie.mkv").c_str(), &metadata, &seeded));
+    ASSERT_TRUE(ReadFileMetadata((dir_ / "library" / "other.mkv").c_str(), &metadata, &other));
+    ASSERT_TRUE(seeded.Known());
+    EXPECT_FALSE(seeded == other);
+    for (const WalkEntry& file : files)
+        EXPECT_TRUE(file.identity == (fs::path(file.path).filename() == "other.mkv" ? other : seeded)) << fs::path(file.path);
+}
+
+TEST_F(FileIdentityTests, HardlinksReuseTheFirstProbe) {
+    const uint32_t seeded = Id(dir_ / "seeding" / "movie.mkv");
+    const uint32_t linked = Id(dir_ / "library" / "movie.mkv");
+    const uint32_t fields = static_cast<uint32_t>(ProbeField::Duration) | static_cast<uint32_t>(ProbeField::Keyframes);
+
+    FileProbeResult first;
+    ASSERT_TRUE(probe_file_by_id(seeded, fields, &first));
+    EXPECT_EQ(first.opens, 1u);
+
+    // The second path finds the first one's entry through the file identity and opens nothing
+    FileProbeResult second;
+    ASSERT_TRUE(probe_file_by_id(linked, fields, &second));
+    EXPECT_EQ(second.opens, 0u);
+    EXPECT_EQ(second.bytes_read, 0u);
+    EXPECT_DOUBLE_EQ(second.duration_ms, 5000.0);
+    EXPECT_EQ(get_video_duration_by_id(linked), 5000.0);
+
+    const FileIdentityStats stats = Stats();
+    EXPECT_EQ(stats.paths, 2u);
+    EXPECT_EQ(stats.files, 1u);
+    EXPECT_EQ(stats.shared_entries, 1u);
+    EXPECT_EQ(stats.shared_file_bytes, fs::file_size(dir_ / "seeding" / "movie.mkv"));
+}
+
+TEST_F(FileIdentityTests, BatchProbesEachWalkedFileOnce) {
+    const int32_t walk = walk_start(Id(dir_), 2, 0);
+    ASSERT_GT(walk, 0);
+    WalkRecord records[16];
+    while (walk_poll(walk, records, 16, 1000) > 0) {
+    }
+    ASSERT_TRUE(walk_close(walk));
+    EXPECT_EQ(Stats().paths, 4u);
+    EXPECT_EQ(Stats().files, 2u);
+
+    const std::vector<uint32_t> ids = {Id(dir_ / "seeding" / "movie.mkv"), Id(dir_ / "library" / "movie.mkv"),
+                                       Id(dir_ / "library" / "other.mkv"), Id(dir_ / "library" / "movie (copy).mkv")};
+    std::vector<double> durations(ids.size());
+    EXPECT_EQ(get_video_duration_batch(ids.data(), static_cast<uint32_t>(ids.size()), durations.data()), 4u);
+    EXPECT_EQ(durations, (std::vector<double>{5000.0, 5000.0, 7000.0, 5000.0}));
+    EXPECT_EQ(Stats().shared_probes, 2u);
+
+    // A later batch revalidates each path against its own stat, sharing the cached entry
+    EXPECT_EQ(get_video_duration_batch(ids.data(), static_cast<uint32_t>(ids.size()), durations.data()), 4u);
+    EXPECT_EQ(Stats().shared_probes, 2u);
+    EXPECT_EQ(Stats().shared_entries, 2u);
+}
+
+TEST_F(FileIdentityTests, ReplacedLinkStopsSharing) {
+    const uint32_t seeded = Id(dir_ / "seeding" / "movie.mkv");
+    const uint32_t linked = Id(dir_ / "library" / "movie.mkv");
+    EXPECT_EQ(get_video_duration_by_id(seeded), 5000.0);
+    EXPECT_EQ(get_video_duration_by_id(linked), 5000.0);
+
+    // Replaced by a different file, e.g. a re-encode moved over the link
+    fs::remove(dir_ / "library" / "movie.mkv");
+    WriteFile(dir_ / "library" / "movie.mkv", Mkv(9000.0));
+    EXPECT_EQ(get_video_duration_by_id(linked), 9000.0);
+    EXPECT_EQ(get_video_duration_by_id(seeded), 5000.0);
+    EXPECT_EQ(Stats().files, 2u);
+}
+
+TEST_F(FileIdentityTests, HardlinkGetsACopyOfAnExistingThumbnail) {
+    const uint32_t seeded = Id(dir_ / "seeding" / "movie.mkv");
+    const uint32_t linked = Id(dir_ / "library" / "movie.mkv");
+    get_video_duration_by_id(seeded);
+    get_video_duration_by_id(linked);
+
+    // Stands in for a thumbnail rendered earlier for the first path
+    const uint32_t rendered = Id(dir_ / "seeding.jpg");
+    WriteFile(dir_ / "seeding.jpg", std::string("thumbnail bytes"));
+    ThumbnailCache::Instance().Record(seeded, rendered, 256);
+
+    const uint32_t output = Id(dir_ / "library.jpg");
+    ASSERT_TRUE(get_thumbnail_by_id(linked, output, 256));
+    EXPECT_EQ(fs::file_size(dir_ / "library.jpg"), fs::file_size(dir_ / "seeding.jpg"));
+    EXPECT_EQ(Stats().shared_thumbnails, 1u);
+
+    ThumbnailCache::Instance().Invalidate(seeded);
+    ThumbnailCache::Instance().Invalidate(linked);
+}
+
+} // namespace test
+} // namespace video_data_utils
@@ -0,0 +1,181 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <string>
+
+#include "../content_hash.h"
+#include "../file_probe.h"
+#include "../path_arena.h"
+#include "../probe_cache.h"
+#include "../video_data_exporter_api.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+static uint64_t Hash(const std::string& bytes, uint64_t seed = 0) {
+    ContentHasher hasher(seed);
+    hasher.Update(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+    return hasher.Digest();
+}
+
+// moov with an H.264 track (two keyframes in 50 samples), an AAC track and a PNG cover; mdat of mdatBytes first
+static std::string ProbeableMp4(size_t mdatBytes) {
+    const std::string avc1 = Box("avc1", std::string(6, '\0') + Be16(1) + std::string(16, '\0') + Be16(1280) + Be16(720) + std::string(50, '\0'));
+    const std::string mp4a = Box("mp4a", std::string(6, '\0') + Be16(1) + std::string(8, '\0') + Be16(2) + Be16(16) + std::string(4, '\0') +
+                                             Be32(44100u << 16));
+    const std::string video = Trak("vide", 25000,
+                                   FullBox("stsd", Be32(1) + avc1) + FullBox("stts", Be32(1) + Be32(50) + Be32(1000)) +
+                                   FullBox("stss", Be32(2) + Be32(1) + Be32(26)) + FullBox("stsc", Be32(1) + Be32(1) + Be32(50) + Be32(1)) +
+                                   FullBox("stsz", Be32(100) + Be32(50)) + FullBox("stco", Be32(1) + Be32(40)));
+    const std::string audio = Trak("soun", 44100, FullBox("stsd", Be32(1) + mp4a));
+    const std::string covr = Box("covr", Box("data", Be32(14) + Be32(0) + "\x89PNG...."));
+    const std::string meta = FullBox("meta", FullBox("hdlr", Be32(0) + "mdir" + std::string(12, '\0')) + Box("ilst", covr));
+    return Ftyp() + Box("mdat", std::string(mdatBytes, '\x5A')) + Box("moov", Mvhd(1000, 2000) + video + audio + Box("udta", meta));
+}
+
+class FileProbeTests : public ::testing::Test {
+protected:
+    void SetUp() override {
+        path_ = fs::temp_directory_path() / "test_vdu_file_probe.mp4";
+        WriteFile(path_, ProbeableMp4(256 * 1024));
+    }
+    void TearDown() override { fs::remove(path_); }
+
+    std::string Path() const { return path_.string(); }
+
+    fs::path path_;
+};
+
+TEST(ContentHashTests, Xxh64MatchesReferenceAndIgnoresSplits) {
+    EXPECT_EQ(Hash(""), 0xEF46DB3751D8E999ull);
+    EXPECT_EQ(Hash("abc"), 0x44BC2CF5AD770999ull);
+
+    std::string bytes(1000, '\0');
+    for (size_t i = 0; i < bytes.size(); i++) bytes[i] = static_cast<char>(i * 131 + 7);
+    for (size_t split : {1u, 31u, 32u, 33u, 999u}) {
+        ContentHasher hasher(42);
+        hasher.Update(reinterpret_cast<const uint8_t*>(bytes.data()), split);
+        hasher.Update(reinterpret_cast<const uint8_t*>(bytes.data()) + split, bytes.size() - split);
+        EXPECT_EQ(hasher.Digest(), Hash(bytes, 42)) << split;
+    }
+}
+
+TEST(ContentHashTests, SampledHashSeesSizeAndSamplesOnly) {
+    std::string file(1024 * 1024, '\0');
+    for (size_t i = 0; i < file.size(); i++) file[i] = static_cast<char>(i ^ (i >> 9));
+    auto hashes = [](const std::string& bytes, uint64_t* full, uint64_t* sampled) {
+        auto source = MakeMemorySource(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+        uint64_t alone;
+        ASSERT_TRUE(SampledContentHash(*source, &alone));
+        ASSERT_TRUE(FullContentHash(*source, full, sampled));
+        EXPECT_EQ(alone, *sampled); // the streamed samples match separate reads
+    };
+    uint64_t full, sampled;
+    hashes(file, &full, &sampled);
+    EXPECT_EQ(full, Hash(file));
+
+    // Between the samples: only the full hash changes
+    std::string edited = file;
+    edited[200 * 1024] ^= 1;
+    uint64_t editedFull, editedSampled;
+    hashes(edited, &editedFull, &editedSampled);
+    EXPECT_NE(editedFull, full);
+    EXPECT_EQ(editedSampled, sampled);
+
+    // In the middle sample, or one byte longer: both change
+    edited = file;
+    edited[file.size() / 2] ^= 1;
+    hashes(edited, &editedFull, &editedSampled);
+    EXPECT_NE(editedSampled, sampled);
+    hashes(file + "x", &editedFull, &editedSampled);
+    EXPECT_NE(editedSampled, sampled);
+}
+
+TEST_F(FileProbeTests, MetadataAloneNeverOpensTheFile) {
+    FileProbeResult result;
+    ASSERT_TRUE(ProbeFile(Path().c_str(), static_cast<uint32_t>(ProbeField::Metadata), &result));
+    EXPECT_EQ(result.fields, static_cast<uint32_t>(ProbeField::Metadata));
+    EXPECT_EQ(result.metadata.file_size_bytes, static_cast<int64_t>(fs::file_size(path_)));
+    EXPECT_EQ(result.opens, 0u);
+    EXPECT_EQ(result.bytes_read, 0u);
+
+    EXPECT_FALSE(ProbeFile((Path() + ".missing").c_str(), kProbeAllFields, &result));
+}
+
+TEST_F(FileProbeTests, EveryFieldFromOneOpen) {
+    FileProbeResult result;
+    ASSERT_TRUE(ProbeFile(Path().c_str(), kProbeAllFields, &result));
+    EXPECT_EQ(result.fields, kProbeAllFields);
+    EXPECT_EQ(result.opens, 1u);
+    EXPECT_EQ(static_cast<ContainerKind>(result.container), ContainerKind::IsoBmff);
+    EXPECT_DOUBLE_EQ(result.duration_ms, 2000.0);
+    EXPECT_EQ(result.video_streams, 1u);
+    EXPECT_EQ(result.audio_streams, 1u);
+    EXPECT_STREQ(result.video_codec, "avc1");
+    EXPECT_EQ(result.width, 1280u);
+    EXPECT_STREQ(result.audio_codec, "mp4a");
+    EXPECT_EQ(result.sample_rate, 44100u);
+    EXPECT_STREQ(result.cover_media_type, "image/png");
+    EXPECT_EQ(result.cover_size, 8u);
+    EXPECT_EQ(result.keyframe_count, 2u);
+
+    const std::string file = ProbeableMp4(256 * 1024);
+    EXPECT_EQ(result.full_hash, Hash(file));
+    // The hash pass read the file once; the parsers added at most a few header reads
+    EXPECT_LT(result.bytes_read, file.size() + 4 * kDefaultReadAhead);
+
+    // Header fields only: the mdat is never read
+    FileProbeResult headers;
+    const uint32_t parsed = static_cast<uint32_t>(ProbeField::Duration) | static_cast<uint32_t>(ProbeField::Streams) |
+                            static_cast<uint32_t>(ProbeField::CoverArt) | static_cast<uint32_t>(ProbeField::Keyframes);
+    ASSERT_TRUE(ProbeFile(Path().c_str(), parsed, &headers));
+    EXPECT_EQ(headers.fields, parsed);
+    EXPECT_LT(headers.bytes_read, 4 * kDefaultReadAhead);
+    EXPECT_LE(headers.read_calls, 4u); // shared read-ahead: each parser revisits the same moov
+}
+
+TEST_F(FileProbeTests, NonMediaAnswersHashesAndLeavesParsedFieldsOut) {
+    const fs::path text = fs::temp_directory_path() / "test_vdu_file_probe.txt";
+    WriteFile(text, "just some notes\n");
+    FileProbeResult result;
+    ASSERT_TRUE(ProbeFile(text.string().c_str(), kProbeAllFields & ~static_cast<uint32_t>(ProbeField::Keyframes), &result));
+    EXPECT_EQ(result.fields, static_cast<uint32_t>(ProbeField::Metadata) | static_cast<uint32_t>(ProbeField::SampledHash) |
+                                 static_cast<uint32_t>(ProbeField::FullHash));
+    EXPECT_EQ(result.full_hash, Hash("just some notes\n"));
+    fs::remove(text);
+}
+
+TEST_F(FileProbeTests, Export_ByIdReusesCachedParses) {
+    const std::string utf8 = Path();
+    const uint32_t id = path_arena_intern(utf8.data(), static_cast<uint32_t>(utf8.size()));
+    ProbeCache::Instance().Invalidate(id);
+    const uint32_t fields = static_cast<uint32_t>(ProbeField::Metadata) | static_cast<uint32_t>(ProbeField::Duration) |
+                            static_cast<uint32_t>(ProbeField::Keyframes);
+
+    FileProbeResult first;
+    ASSERT_TRUE(probe_file_by_id(id, fields, &first));
+    EXPECT_EQ(first.fields, fields);
+    EXPECT_EQ(first.opens, 1u);
+
+    // Both parses now come from the cache: a stat and nothing else
+    FileProbeResult second;
+    ASSERT_TRUE(probe_file_by_id(id, fields, &second));
+    EXPECT_EQ(second.fields, fields);
+    EXPECT_EQ(second.opens, 0u);
+    EXPECT_DOUBLE_EQ(second.duration_ms, 2000.0);
+    EXPECT_EQ(second.keyframe_count, 2u);
+    EXPECT_EQ(get_keyframe_index_by_id(id, nullptr, nullptr, 0), 2u);
+
+    FileProbeResult direct;
+    ASSERT_TRUE(probe_file(utf8.c_str(), static_cast<uint32_t>(ProbeField::SampledHash), &direct));
+    EXPECT_EQ(direct.fields, static_cast<uint32_t>(ProbeField::SampledHash));
+    EXPECT_EQ(direct.bytes_read, 3 * kHashSampleBytes);
+    EXPECT_FALSE(probe_file(utf8.c_str(), fields, nullptr));
+}
+
+} // namespace test
+} // namespace video_data_utils
@@ -0,0 +1,192 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
+#include "../fs_watcher.h"
+#include "../path_arena.h"
+#include "../probe_cache.h"
+#include "../video_data_exporter_api.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using Clock = FsChangeCoalescer::Clock;
+using std::chrono::milliseconds;
+
+static NativePath P(const char* name) {
+    return fs::path(name).native();
+}
+
+TEST(FsWatcherTests, Coalescer_StormBecomesSingleAdd) {
+    FsChangeCoalescer coalescer(milliseconds(100), milliseconds(2000));
+    Clock::time_point t0 = Clock::now();
+
+    coalescer.Add({P("a.mkv"), FsEventKind::Created, false}, t0);
+    for (int i = 1; i <= 5000; i++) coalescer.Add({P("a.mkv"), FsEventKind::Modified, false}, t0 + milliseconds(i / 100));
+
+    std::vector<FsChange> out;
+    coalescer.Flush(t0 + milliseconds(60), &out);
+    EXPECT_TRUE(out.empty()); // still inside the quiet period
+
+    coalescer.Flush(t0 + milliseconds(200), &out);
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].kind, FsChangeKind::Added);
+    EXPECT_EQ(coalescer.PendingCount(), 0u);
+    EXPECT_EQ(coalescer.EventCount(), 5001u);
+}
+
+TEST(FsWatcherTests, Coalescer_NetEffects) {
+    FsChangeCoalescer coalescer(milliseconds(100), milliseconds(2000));
+    Clock::time_point t0 = Clock::now();
+
+    coalescer.Add({P("transient"), FsEventKind::Created, false}, t0);
+    coalescer.Add({P("transient"), FsEventKind::Removed, false}, t0);
+    coalescer.Add({P("replaced"), FsEventKind::Removed, false}, t0);
+    coalescer.Add({P("replaced"), FsEventKind::Created, false}, t0);
+    coalescer.Add({P("gone"), FsEventKind::Modified, false}, t0);
+    coalescer.Add({P("gone"), FsEventKind::Removed, false}, t0);
+    coalescer.Add({P("root"), FsEventKind::Overflow, true}, t0);
+
+    std::vector<FsChange> out;
+    coalescer.Flush(t0 + milliseconds(100), &out);
+    std::map<NativePath, FsChangeKind> kinds;
+    for (const FsChange& change : out) kinds[change.path] = change.kind;
+
+    EXPECT_EQ(kinds.size(), 3u);
+    EXPECT_EQ(kinds.count(P("transient")), 0u);
+    EXPECT_EQ(kinds[P("replaced")], FsChangeKind::Modified);
+    EXPECT_EQ(kinds[P("gone")], FsChangeKind::Removed);
+    EXPECT_EQ(kinds[P("root")], FsChangeKind::Rescan);
+}
+
+TEST(FsWatcherTests, Coalescer_ContinuousWritesFlushAtMaxDelay) {
+    FsChangeCoalescer coalescer(milliseconds(100), milliseconds(1000));
+    Clock::time_point t0 = Clock::now();
+    std::vector<FsChange> out;
+
+    // A write every 50ms never leaves a 100ms gap
+    for (int ms = 0; ms <= 1000; ms += 50) {
+        coalescer.Add({P("downloading.mkv"), FsEventKind::Modified, false}, t0 + milliseconds(ms));
+        coalescer.Flush(t0 + milliseconds(ms), &out);
+    }
+    ASSERT_EQ(out.size(), 1u);
+    EXPECT_EQ(out[0].kind, FsChangeKind::Modified);
+    EXPECT_EQ(coalescer.NextDeadline(), Clock::time_point::max());
+}
+
+#ifdef __linux__
+
+class WatchedTree : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root_ = fs::temp_directory_path() / ("test_vdu_watch_" + std::to_string(::getpid()));
+        fs::remove_all(root_);
+        fs::create_directories(root_ / "season");
+        Write("rename_me.mkv", "x");
+        Write("delete_me.mkv", "x");
+        Write("touch_me.mkv", "x");
+    }
+
+    void TearDown() override { fs::remove_all(root_); }
+
+    void Write(const fs::path& relative, const std::string& data, std::ios::openmode mode = std::ios::trunc) {
+        std::ofstream(root_ / relative, std::ios::binary | mode) << data;
+    }
+
+    // Collects batches until the watcher has been quiet for a while
+    std::map<NativePath, std::vector<FsChangeKind>> Collect(std::mutex& mutex, std::condition_variable& cv, std::vector<FsChange>& received) {
+        std::unique_lock<std::mutex> lock(mutex);
+        size_t seen = 0;
+        auto giveUp = Clock::now() + std::chrono::seconds(10);
+        while (Clock::now() < giveUp) {
+            cv.wait_for(lock, milliseconds(600));
+            if (received.size() == seen && seen > 0) break;
+            seen = received.size();
+        }
+        std::map<NativePath, std::vector<FsChangeKind>> kinds;
+        for (const FsChange& change : received) kinds[fs::relative(change.path, root_).native()].push_back(change.kind);
+        return kinds;
+    }
+
+    fs::path root_;
+};
+
+TEST_F(WatchedTree, Inotify_WriteRenameDeleteAreCoalesced) {
+    std::mutex mutex;
+    std::condition_variable cv;
+    std::vector<FsChange> received;
+    FsWatcher watcher([&](std::vector<FsChange>&& batch) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.insert(received.end(), batch.begin(), batch.end());
+        cv.notify_all();
+    }, milliseconds(150));
+    ASSERT_TRUE(watcher.AddRoot(root_.native()));
+    ASSERT_TRUE(watcher.Start());
+
+    // A torrent-like writer touching one file over and over
+    for (int i = 0; i < 2000; i++) Write("new.mkv", "chunk", std::ios::app);
+    fs::rename(root_ / "rename_me.mkv", root_ / "season" / "renamed.mkv");
+    fs::remove(root_ / "delete_me.mkv");
+    Write("transient.part", "x");
+    fs::remove(root_ / "transient.part");
+    fs::create_directories(root_ / "extras" / "bonus");
+    Write("extras/bonus/clip.mp4", "x");
+    for (int i = 0; i < 10; i++) Write("touch_me.mkv", "y", std::ios::app);
+
+    auto kinds = Collect(mutex, cv, received);
+    watcher.Stop();
+
+    using K = std::vector<FsChangeKind>;
+    EXPECT_EQ(kinds[P("new.mkv")], K{FsChangeKind::Added});
+    EXPECT_EQ(kinds[P("rename_me.mkv")], K{FsChangeKind::Removed});
+    EXPECT_EQ(kinds[P("season/renamed.mkv")], K{FsChangeKind::Added});
+    EXPECT_EQ(kinds[P("delete_me.mkv")], K{FsChangeKind::Removed});
+    EXPECT_EQ(kinds[P("touch_me.mkv")], K{FsChangeKind::Modified});
+    EXPECT_EQ(kinds[P("extras")], K{FsChangeKind::Added});
+    EXPECT_EQ(kinds[P("extras/bonus/clip.mp4")], K{FsChangeKind::Added});
+    EXPECT_EQ(kinds.count(P("transient.part")), 0u);
+}
+
+TEST_F(WatchedTree, Export_ChangesInvalidateProbeCache) {
+    std::string rootUtf8 = root_.string();
+    std::string fileUtf8 = (root_ / "touch_me.mkv").string();
+    uint32_t rootId = path_arena_intern(rootUtf8.data(), static_cast<uint32_t>(rootUtf8.size()));
+    uint32_t fileId = path_arena_intern(fileUtf8.data(), static_cast<uint32_t>(fileUtf8.size()));
+
+    ProbeEntry stale;
+    stale.duration_ms = 1234.0;
+    stale.has_duration = true;
+    ProbeCache::Instance().Store(fileId, stale);
+
+    int32_t handle = watch_start(&rootId, 1, 50, false);
+    ASSERT_GT(handle, 0);
+    Write("touch_me.mkv", "changed");
+
+    FsChangeRecord records[16];
+    uint32_t count = 0;
+    for (int attempt = 0; attempt < 20 && count == 0; attempt++) count = watch_poll(handle, records, 16, 250);
+    EXPECT_TRUE(watch_stop(handle));
+    EXPECT_FALSE(watch_stop(handle));
+
+    ASSERT_GE(count, 1u);
+    EXPECT_EQ(records[0].path_id, fileId);
+    EXPECT_EQ(records[0].kind, static_cast<uint8_t>(FsChangeKind::Modified));
+    ProbeEntry entry;
+    EXPECT_FALSE(ProbeCache::Instance().Lookup(fileId, &entry));
+}
+
+#endif
+
+} // namespace test
+} // namespace video_data_utils
@@ -0,0 +1,168 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../hot_cache.h"
+#include "../video_data_exporter_api.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+HotResult Result(int64_t size, double durationMs = 0.0) {
+    HotResult result;
+    result.metadata.file_size_bytes = size;
+    result.metadata.modified_time_ms = 1000;
+    result.has_metadata = true;
+    result.duration_ms = durationMs;
+    result.has_duration = durationMs > 0.0;
+    return result;
+}
+
+EncodedThumbnail Thumbnail(size_t bytes) {
+    return std::make_shared<const std::vector<uint8_t>>(bytes, uint8_t(7));
+}
+
+TEST(HotCacheTests, MergesResultsAndDropsThemWhenTheFileChanges) {
+    HotCache cache(1 << 20, 0, 4);
+    HotResult result;
+    EXPECT_FALSE(cache.Find(1, false, &result));
+
+    cache.Put(1, Result(100));
+    ASSERT_TRUE(cache.Find(1, false, &result));
+    EXPECT_FALSE(cache.Find(1, true, &result)); // no duration yet
+
+    cache.Put(1, Result(100, 5000.0));
+    cache.PutThumbnail(1, 128, Thumbnail(10));
+    ASSERT_TRUE(cache.Find(1, true, &result));
+    EXPECT_EQ(result.duration_ms, 5000.0);
+
+    // New size: the duration and thumbnails described the old file
+    cache.Put(1, Result(200));
+    EXPECT_FALSE(cache.Find(1, true, &result));
+    EXPECT_FALSE(cache.FindThumbnail(1, 128));
+
+    const HotCacheStats stats = cache.Stats();
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.misses, 3u);
+    EXPECT_EQ(stats.thumbnail_misses, 1u);
+    EXPECT_EQ(stats.insertions, 1u);
+}
+
+TEST(HotCacheTests, EvictsLeastRecentlyUsedWithinTheBudget) {
+    // One shard, room for three 1000-byte thumbnails with their entries
+    HotCache cache(3600, 0, 1);
+    for (uint32_t id = 1; id <= 3; id++) cache.PutThumbnail(id, 256, Thumbnail(1000));
+    EXPECT_TRUE(cache.FindThumbnail(1, 256)); // 1 is now the most recent, 2 the least
+
+    cache.PutThumbnail(4, 256, Thumbnail(1000));
+    EXPECT_FALSE(cache.FindThumbnail(2, 256));
+    EXPECT_TRUE(cache.FindThumbnail(1, 256));
+    EXPECT_TRUE(cache.FindThumbnail(3, 256));
+    EXPECT_TRUE(cache.FindThumbnail(4, 256));
+
+    HotCacheStats stats = cache.Stats();
+    EXPECT_EQ(stats.entries, 3u);
+    EXPECT_EQ(stats.evictions, 1u);
+    EXPECT_LE(stats.bytes, stats.budget_bytes);
+
+    // Larger than the whole budget: not kept, and nothing evicted for it
+    cache.PutThumbnail(5, 256, Thumbnail(4000));
+    EXPECT_FALSE(cache.FindThumbnail(5, 256));
+    EXPECT_EQ(cache.Stats().entries, 3u);
+
+    cache.SetLimits(0, 0);
+    EXPECT_EQ(cache.Stats().entries, 0u);
+    cache.PutThumbnail(1, 256, Thumbnail(10));
+    EXPECT_EQ(cache.Stats().bytes, 0u);
+}
+
+TEST(HotCacheTests, ResultsAgeOutButThumbnailsStay) {
+    HotCache cache(1 << 20, 20, 4);
+    cache.Put(9, Result(100, 1000.0));
+    cache.PutThumbnail(9, 64, Thumbnail(100));
+    HotResult result;
+    EXPECT_TRUE(cache.Find(9, true, &result));
+    std::this_thread::sleep_for(std::chrono::milliseconds(40));
+    EXPECT_FALSE(cache.Find(9, true, &result));
+    EXPECT_TRUE(cache.FindThumbnail(9, 64));
+
+    EXPECT_TRUE(cache.Invalidate(9));
+    EXPECT_FALSE(cache.FindThumbnail(9, 64));
+    EXPECT_EQ(cache.Stats().bytes, 0u);
+}
+
+TEST(HotCacheTests, ConcurrentReadersAndWritersKeepTheBooks) {
+    HotCache cache(64 * 1024, 0, 8);
+    std::atomic<uint64_t> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++)
+        threads.emplace_back([&, t] {
+            HotResult result;
+            for (uint32_t i = 0; i < 20000; i++) {
+                const uint32_t id = 1 + (i * 7 + t * 131) % 2000;
+                if (i % 4 == 0) {
+                    cache.Put(id, Result(id, id * 2.0));
+                    cache.PutThumbnail(id, 32, Thumbnail(200));
+                } else if (cache.Find(id, true, &result) && result.duration_ms != id * 2.0) {
+                    wrong++;
+                }
+            }
+        });
+    for (std::thread& thread : threads) thread.join();
+    EXPECT_EQ(wrong.load(), 0u);
+
+    const HotCacheStats stats = cache.Stats();
+    EXPECT_EQ(stats.hits + stats.misses, 8u * 15000u);
+    EXPECT_LE(stats.bytes, stats.budget_bytes);
+    EXPECT_GT(stats.evictions, 0u);
+}
+
+TEST(HotCacheTests, Export_RepeatedCallsSkipTheFilesystem) {
+    const fs::path dir = fs::temp_directory_path() / "test_vdu_hot_cache";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    WriteFile(dir / "clip.mkv", Mkv(3000.0));
+    WriteFile(dir / "clip.jpg", std::string("encoded thumbnail"));
+    daemon_set_endpoint(PATH_LITERAL(""));
+    set_hot_cache_limits(kHotCacheDefaultBudget, 0);
+    clear_hot_cache();
+
+    auto id = [](const fs::path& path) {
+        const std::string utf8 = path.string();
+        return path_arena_intern(utf8.data(), static_cast<uint32_t>(utf8.size()));
+    };
+    const uint32_t video = id(dir / "clip.mkv");
+    const uint32_t output = id(dir / "clip.jpg");
+    EXPECT_EQ(get_video_duration_by_id(video), 3000.0);
+    ASSERT_EQ(get_thumbnail_bytes_by_id(video, output, 128, nullptr, 0), 17u);
+
+    // Gone from disk, still answered: neither call touches the filesystem again
+    fs::remove_all(dir);
+    EXPECT_EQ(get_video_duration_by_id(video), 3000.0);
+    FileMetadata metadata;
+    EXPECT_TRUE(get_file_metadata_by_id(video, &metadata));
+    std::vector<uint8_t> bytes(32);
+    ASSERT_EQ(get_thumbnail_bytes_by_id(video, output, 128, bytes.data(), static_cast<uint32_t>(bytes.size())), 17u);
+    EXPECT_EQ(std::string(bytes.begin(), bytes.begin() + 17), "encoded thumbnail");
+
+    HotCacheStats stats;
+    get_hot_cache_stats(&stats);
+    EXPECT_EQ(stats.hits, 2u);
+    EXPECT_EQ(stats.thumbnail_hits, 1u);
+
+    clear_hot_cache();
+    EXPECT_EQ(get_video_duration_by_id(video), 0.0);
+    set_hot_cache_limits(kHotCacheDefaultBudget, kHotCacheDefaultMaxAgeMs);
+}
+
+} // namespace test
+} // namespace video_data_utils
@@ -0,0 +1,103 @@
+#include <gtest/gtest.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../batch_probe.h"
+#include "../io_schedule.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+class IoScheduleTests : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = fs::temp_directory_path() / "test_vdu_io_schedule";
+        fs::remove_all(dir_);
+        fs::create_directories(dir_);
+        // Names run against creation order, so the given order is not the on-disk one
+        for (int i = 0; i < 24; i++) {
+            const fs::path path = dir_ / ("clip" + std::to_string(100 - i) + ".mkv");
+            WriteFile(path, Mkv(1000.0 * (i + 1), 8 * 1024));
+            const int fd = open(path.c_str(), O_RDONLY);
+            fsync(fd); // gives the extents an address
+            close(fd);
+            natives_.push_back(path.native());
+        }
+        natives_.push_back((dir_ / "missing.mkv").native());
+        for (const NativePath& native : natives_) paths_.push_back(native.c_str());
+    }
+    void TearDown() override { fs::remove_all(dir_); }
+
+    fs::path dir_;
+    std::vector<NativePath> natives_;
+    std::vector<const PathChar*> paths_;
+};
+
+TEST_F(IoScheduleTests, LocateReportsDeviceInodeAndExtent) {
+    FileLocation location;
+    ASSERT_TRUE(LocateFile(paths_[0], &location));
+    struct stat st;
+    ASSERT_EQ(stat(paths_[0], &st), 0);
+    EXPECT_EQ(location.device, static_cast<uint64_t>(st.st_dev));
+    EXPECT_EQ(location.inode, static_cast<uint64_t>(st.st_ino));
+    if (location.has_physical) { // tmpfs and overlays have no extents to report
+        EXPECT_GT(location.physical, 0u);
+    }
+
+    EXPECT_FALSE(LocateFile(paths_.back(), &location));
+    EXPECT_FALSE(LocateFile(nullptr, &location));
+}
+
+TEST_F(IoScheduleTests, PlanIsOneSweepPerDevice) {
+    for (int round = 0; round < 2; round++) { // the second plan starts from where the first left the head
+        const std::vector<DeviceQueue> queues = PlanDeviceQueues(paths_);
+        ASSERT_EQ(queues.size(), 2u);
+        EXPECT_EQ(queues[1].device, 0u);
+        EXPECT_EQ(queues[1].order, std::vector<size_t>{paths_.size() - 1});
+
+        const DeviceQueue& queue = queues[0];
+        ASSERT_EQ(queue.order.size(), paths_.size() - 1);
+        std::vector<size_t> sorted = queue.order;
+        std::sort(sorted.begin(), sorted.end());
+        for (size_t i = 0; i < sorted.size(); i++) EXPECT_EQ(sorted[i], i);
+
+        // Keys rise to the top of the sweep and then only fall
+        std::vector<uint64_t> keys;
+        for (size_t i : queue.order) {
+            FileLocation location;
+            ASSERT_TRUE(LocateFile(paths_[i], &location));
+            EXPECT_EQ(location.device, queue.device);
+            keys.push_back(queue.physical ? location.physical : location.inode);
+        }
+        const auto top = std::max_element(keys.begin(), keys.end());
+        EXPECT_TRUE(std::is_sorted(keys.begin(), top + 1));
+        EXPECT_TRUE(std::is_sorted(top, keys.end(), std::greater<uint64_t>()));
+    }
+}
+
+TEST_F(IoScheduleTests, PhysicalOrderKeepsResultsInPlace) {
+    for (BatchBackend backend : {BatchBackend::Sequential, BatchBackend::ThreadPool, BatchBackend::Auto}) {
+        BatchProbeOptions options;
+        options.backend = backend;
+        options.order = ProbeOrder::Physical;
+        options.max_in_flight = 4;
+        std::vector<BatchProbeResult> results;
+        ProbeDurationsBatch(paths_, &results, options);
+        ASSERT_EQ(results.size(), paths_.size());
+        for (size_t i = 0; i + 1 < paths_.size(); i++) EXPECT_DOUBLE_EQ(results[i].duration_ms, 1000.0 * (i + 1)) << i;
+        EXPECT_FALSE(results.back().opened);
+    }
+}
+
+} // namespace test
+} // namespace video_data_utils
@@ -0,0 +1,166 @@
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../keyframe_index.h"
+#include "../path_arena.h"
+#include "../probe_cache.h"
+#include "../video_data_exporter_api.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+static std::unique_ptr<ByteSource> Source(const std::string& bytes) {
+    return MakeMemorySource(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+}
+
+static void Decode(const KeyframeIndex& index, std::vector<int64_t>* times, std::vector<uint64_t>* offsets) {
+    index.Decode(times, offsets);
+    ASSERT_EQ(times->size(), index.Count());
+}
+
+// 100 video samples at 25 fps in 10 chunks of 10, a keyframe every 25 samples
+static std::string SampleTableMp4(bool co64) {
+    std::string stsz = Be32(0) + Be32(100);
+    for (uint32_t i = 0; i < 100; i++) stsz += Be32(1000 + i);
+    std::string chunks = Be32(10);
+    for (uint64_t c = 0; c < 10; c++) chunks += co64 ? Be64((5ull << 32) + c * 20000) : Be32(static_cast<uint32_t>(100000 + c * 20000));
+    const std::string video = Trak("vide", 25000,
+                                   FullBox("stts", Be32(1) + Be32(100) + Be32(1000)) +
+                                   FullBox("stss", Be32(4) + Be32(1) + Be32(26) + Be32(51) + Be32(76)) +
+                                   FullBox("stsc", Be32(1) + Be32(1) + Be32(10) + Be32(1)) +
+                                   FullBox("stsz", stsz) + FullBox(co64 ? "co64" : "stco", chunks));
+    // An audio track first: it has no stss, so every sample would look like a keyframe
+    const std::string audio = Trak("soun", 48000,
+                                   FullBox("stts", Be32(1) + Be32(10) + Be32(1024)) + FullBox("stsc", Be32(1) + Be32(1) + Be32(10) + Be32(1)) +
+                                   FullBox("stsz", Be32(100) + Be32(10)) + FullBox("stco", Be32(1) + Be32(50)));
+    return Ftyp() + Box("mdat", std::string(64, '\0')) + Box("moov", Mvhd(1000, 4000) + audio + video);
+}
+
+TEST(KeyframeIndexTests, Encoding_RoundTripsAndFinds) {
+    KeyframeIndex index;
+    index.Append(0, 4096);
+    index.Append(2002, 1500000);
+    index.Append(4004, 1400000); // offsets need not be monotonic
+    index.Append(1ll << 40, 1ull << 40);
+
+    std::vector<int64_t> times;
+    std::vector<uint64_t> offsets;
+    Decode(index, &times, &offsets);
+    EXPECT_EQ(times, (std::vector<int64_t>{0, 2002, 4004, 1ll << 40}));
+    EXPECT_EQ(offsets, (std::vector<uint64_t>{4096, 1500000, 1400000, 1ull << 40}));
+    EXPECT_LT(index.EncodedBytes(), 4u * 16);
+
+    int64_t key;
+    uint64_t offset;
+    ASSERT_TRUE(index.Find(3000, &key, &offset));
+    EXPECT_EQ(key, 2002);
+    EXPECT_EQ(offset, 1500000u);
+    ASSERT_TRUE(index.Find(-5, &key, &offset));
+    EXPECT_EQ(key, 0);
+    EXPECT_FALSE(KeyframeIndex().Find(0, &key, &offset));
+}
+
+TEST(KeyframeIndexTests, Mp4_SyncSamplesOfVideoTrack) {
+    for (bool co64 : {false, true}) {
+        KeyframeIndex index;
+        auto source = Source(SampleTableMp4(co64));
+        ASSERT_TRUE(BuildKeyframeIndex(*source, &index));
+
+        std::vector<int64_t> times;
+        std::vector<uint64_t> offsets;
+        Decode(index, &times, &offsets);
+        EXPECT_EQ(times, (std::vector<int64_t>{0, 1000, 2000, 3000}));
+
+        // Sample 25 is the 6th in chunk 2: chunk offset plus the sizes of samples 20-24
+        const uint64_t base = co64 ? (5ull << 32) : 100000;
+        const uint64_t before25 = 1020 + 1021 + 1022 + 1023 + 1024;
+        EXPECT_EQ(offsets[0], base);
+        EXPECT_EQ(offsets[1], base + 2 * 20000 + before25);
+        EXPECT_EQ(offsets[2], base + 5 * 20000);
+    }
+}
+
+TEST(KeyframeIndexTests, Matroska_FromCues) {
+    std::vector<std::pair<uint64_t, std::string>> clusters;
+    for (uint64_t i = 0; i < 6; i++) clusters.push_back({i * 5000, SimpleBlock(2, 0, true, 2000) + SimpleBlock(2, 40, false, 500)});
+    std::vector<uint64_t> positions;
+    auto source = Source(MkvWithClusters(clusters, true, &positions));
+
+    KeyframeIndex index;
+    ASSERT_TRUE(BuildKeyframeIndex(*source, &index));
+    std::vector<int64_t> times;
+    std::vector<uint64_t> offsets;
+    Decode(index, &times, &offsets);
+    ASSERT_EQ(index.Count(), 6u);
+    EXPECT_EQ(times[3], 15000);
+    EXPECT_EQ(offsets[3], MkvSegmentOffset() + positions[3]);
+    // Cues are read as one element; clusters are never touched
+    EXPECT_LT(source->BytesRead(), 2 * 16 * 1024u);
+}
+
+TEST(KeyframeIndexTests, Matroska_ClusterScanWithoutCues) {
+    std::vector<std::pair<uint64_t, std::string>> clusters = {
+        {0, SimpleBlock(1, 0, true) + SimpleBlock(2, 0, true, 4000)},   // audio first, then a video keyframe
+        {1000, SimpleBlock(2, 0, false, 4000)},                          // starts mid-GOP
+        {2000, BlockGroup(2, 5, false, 4000)},                           // BlockGroup without references
+        {3000, BlockGroup(2, 0, true, 4000)},                            // references an earlier frame
+        {4000, SimpleBlock(1, 0, true) + SimpleBlock(2, -3, true, 4000)},
+    };
+    std::vector<uint64_t> positions;
+    auto source = Source(MkvWithClusters(clusters, false, &positions));
+
+    KeyframeIndex index;
+    ASSERT_TRUE(BuildKeyframeIndex(*source, &index));
+    std::vector<int64_t> times;
+    std::vector<uint64_t> offsets;
+    Decode(index, &times, &offsets);
+    EXPECT_EQ(times, (std::vector<int64_t>{0, 2005, 3997}));
+    EXPECT_EQ(offsets[1], MkvSegmentOffset() + positions[2]);
+}
+
+TEST(KeyframeIndexTests, UnsupportedAndDamaged) {
+    KeyframeIndex index;
+    EXPECT_FALSE(BuildKeyframeIndex(*Source("plain text, not a video"), &index));
+    EXPECT_FALSE(BuildKeyframeIndex(*Source(Ftyp() + Moov(1000.0)), &index)); // no video sample table
+    std::string truncated = SampleTableMp4(false);
+    truncated.resize(truncated.size() - 30);
+    EXPECT_FALSE(BuildKeyframeIndex(*Source(truncated), &index));
+    EXPECT_EQ(index.Count(), 0u);
+}
+
+TEST(KeyframeIndexTests, Export_CachedPerFileState) {
+    const fs::path path = fs::temp_directory_path() / "test_vdu_keyframes.mp4";
+    WriteFile(path, SampleTableMp4(false));
+    const std::string utf8 = path.string();
+    const uint32_t id = path_arena_intern(utf8.data(), static_cast<uint32_t>(utf8.size()));
+    ProbeCache::Instance().Invalidate(id);
+
+    EXPECT_EQ(get_keyframe_index_by_id(id, nullptr, nullptr, 0), 4u);
+    ProbeEntry entry;
+    ASSERT_TRUE(ProbeCache::Instance().Lookup(id, &entry));
+    ASSERT_TRUE(entry.keyframes);
+    const KeyframeIndex* cached = entry.keyframes.get();
+
+    // A duration probe of the same file state keeps the index
+    EXPECT_GT(get_video_duration_by_id(id), 0.0);
+    ASSERT_TRUE(ProbeCache::Instance().Lookup(id, &entry));
+    EXPECT_EQ(entry.keyframes.get(), cached);
+
+    int64_t times[2];
+    uint64_t offsets[2];
+    EXPECT_EQ(get_keyframe_index_by_id(id, times, offsets, 2), 4u);
+    EXPECT_EQ(times[1], 1000);
+    EXPECT_EQ(offsets[0], 100000u);
+    fs::remove(path);
+    EXPECT_EQ(get_keyframe_index_by_id(id, times, offsets, 2), 0u);
+}
+
+} // namespace test
+} // namespace video_data_utils
@@ -0,0 +1,186 @@
+#include <gtest/gtest.h>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "../library_snapshot.h"
+#include "../path_arena.h"
+#include "../probe_cache.h"
+#include "../video_data_exporter_api.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+static SnapshotRow Row(const std::string& path, int64_t size, double durationMs, uint64_t hash = 0) {
+    SnapshotRow row;
+    row.utf8_path = path;
+    row.metadata = {1000, 2000, 3000, size};
+    row.flags = kSnapshotHasMetadata;
+    if (durationMs > 0) {
+        row.duration_ms = durationMs;
+        row.flags |= kSnapshotHasDuration;
+    }
+    if (hash != 0) {
+        row.thumbnail_hash = hash;
+        row.flags |= kSnapshotHasHash;
+    }
+    return row;
+}
+
+template <typename T>
+static std::vector<T> Values(const LibrarySnapshot& snapshot, SnapshotColumn id) {
+    uint64_t count = 0;
+    const T* data = static_cast<const T*>(snapshot.Column(id, &count));
+    return data != nullptr ? std::vector<T>(data, data + count) : std::vector<T>();
+}
+
+class LibrarySnapshotFile : public ::testing::Test {
+protected:
+    void SetUp() override { path_ = fs::temp_directory_path() / "test_vdu_library.snapshot"; }
+    void TearDown() override { fs::remove(path_); }
+
+    fs::path path_;
+};
+
+TEST_F(LibrarySnapshotFile, RoundTripsColumnsAndPaths) {
+    std::vector<SnapshotRow> rows = {
+        Row("/videos/b.mkv", 300, 90000.0, 0xF00DULL),
+        Row("/videos/caf\xC3\xA9.mp4", 100, 45000.0),
+        Row("/videos/notes.txt", 5, 0.0),
+        SnapshotRow(), // missing file: path only
+    };
+    rows[3].utf8_path = "/videos/gone.avi";
+    rows[0].container = ContainerKind::Matroska;
+    rows[0].keyframe_count = 42;
+    ASSERT_TRUE(WriteLibrarySnapshot(path_.c_str(), rows, false));
+
+    auto snapshot = LibrarySnapshot::Open(path_.c_str());
+    ASSERT_TRUE(snapshot);
+    EXPECT_EQ(snapshot->RowCount(), 4u);
+    EXPECT_EQ(snapshot->Path(1), "/videos/caf\xC3\xA9.mp4");
+    EXPECT_EQ(snapshot->Path(3), "/videos/gone.avi");
+    EXPECT_EQ(snapshot->Path(4), "");
+
+    EXPECT_EQ(Values<int64_t>(*snapshot, SnapshotColumn::SizeBytes), (std::vector<int64_t>{300, 100, 5, 0}));
+    EXPECT_EQ(Values<int64_t>(*snapshot, SnapshotColumn::ModifiedMs)[0], 3000);
+    EXPECT_EQ(Values<double>(*snapshot, SnapshotColumn::DurationMs), (std::vector<double>{90000.0, 45000.0, 0.0, 0.0}));
+    EXPECT_EQ(Values<uint64_t>(*snapshot, SnapshotColumn::ThumbnailHash)[0], 0xF00DULL);
+    EXPECT_EQ(Values<uint8_t>(*snapshot, SnapshotColumn::Flags),
+              (std::vector<uint8_t>{kSnapshotHasMetadata | kSnapshotHasDuration | kSnapshotHasHash,
+                                    kSnapshotHasMetadata | kSnapshotHasDuration, kSnapshotHasMetadata, 0}));
+
+    // Stream columns were not requested
+    uint64_t count = 1;
+    EXPECT_EQ(snapshot->Column(SnapshotColumn::Container, &count), nullptr);
+    EXPECT_EQ(count, 0u);
+
+    // Every column is aligned for typed-array access
+    for (SnapshotColumn id : {SnapshotColumn::PathOffsets, SnapshotColumn::SizeBytes, SnapshotColumn::DurationMs, SnapshotColumn::BySize})
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(snapshot->Column(id, nullptr)) % 64, 0u);
+}
+
+TEST_F(LibrarySnapshotFile, SortedIndicesAnswerRanges) {
+    std::vector<SnapshotRow> rows;
+    for (int i = 0; i < 100; i++) rows.push_back(Row("/v/" + std::to_string(i), (i * 37) % 100, i % 3 == 0 ? 0.0 : (i * 53) % 100 * 1000.0));
+    ASSERT_TRUE(WriteLibrarySnapshot(path_.c_str(), rows, true));
+    auto snapshot = LibrarySnapshot::Open(path_.c_str());
+    ASSERT_TRUE(snapshot);
+
+    const std::vector<uint32_t> bySize = Values<uint32_t>(*snapshot, SnapshotColumn::BySize);
+    ASSERT_EQ(bySize.size(), 100u);
+    for (size_t i = 1; i < bySize.size(); i++) EXPECT_LE(rows[bySize[i - 1]].metadata.file_size_bytes, rows[bySize[i]].metadata.file_size_bytes);
+
+    // Rows without a duration are left out of the duration index
+    const std::vector<uint32_t> byDuration = Values<uint32_t>(*snapshot, SnapshotColumn::ByDuration);
+    EXPECT_EQ(byDuration.size(), 66u);
+    for (size_t i = 1; i < byDuration.size(); i++) EXPECT_LE(rows[byDuration[i - 1]].duration_ms, rows[byDuration[i]].duration_ms);
+
+    uint64_t first = 0;
+    const uint64_t count = snapshot->IndexRange(SnapshotColumn::BySize, 10, 19, &first);
+    EXPECT_EQ(count, 10u);
+    for (uint64_t i = first; i < first + count; i++) {
+        EXPECT_GE(rows[bySize[i]].metadata.file_size_bytes, 10);
+        EXPECT_LE(rows[bySize[i]].metadata.file_size_bytes, 19);
+    }
+    EXPECT_EQ(snapshot->IndexRange(SnapshotColumn::ByDuration, 1e9, 2e9, &first), 0u);
+    EXPECT_EQ(snapshot->IndexRange(SnapshotColumn::SizeBytes, 0, 100, &first), 0u); // not an index
+
+    EXPECT_EQ(Values<uint8_t>(*snapshot, SnapshotColumn::Container).size(), 100u);
+    EXPECT_EQ(Values<uint32_t>(*snapshot, SnapshotColumn::KeyframeCount).size(), 100u);
+}
+
+TEST_F(LibrarySnapshotFile, RejectsDamagedFiles) {
+    ASSERT_TRUE(WriteLibrarySnapshot(path_.c_str(), {Row("/a", 1, 1000.0), Row("/b", 2, 2000.0)}, false));
+    std::string bytes;
+    {
+        std::ifstream in(path_, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), {});
+    }
+    ASSERT_TRUE(LibrarySnapshot::Open(path_.c_str()));
+
+    WriteFile(path_, bytes.substr(0, bytes.size() / 2));
+    EXPECT_FALSE(LibrarySnapshot::Open(path_.c_str()));
+
+    WriteFile(path_, "");
+    EXPECT_FALSE(LibrarySnapshot::Open(path_.c_str()));
+
+    // A row number past the end of the size index must not be handed out
+    uint64_t bySizeOffset = 0;
+    for (size_t entry = 64; entry < 64 + 32 * 11; entry += 32) {
+        uint32_t id;
+        std::memcpy(&id, bytes.data() + entry, 4);
+        if (id == static_cast<uint32_t>(SnapshotColumn::BySize)) std::memcpy(&bySizeOffset, bytes.data() + entry + 8, 8);
+    }
+    ASSERT_NE(bySizeOffset, 0u);
+    std::string corrupt = bytes;
+    corrupt[bySizeOffset + 1] = 0x7F;
+    WriteFile(path_, corrupt);
+    EXPECT_FALSE(LibrarySnapshot::Open(path_.c_str()));
+
+    EXPECT_FALSE(LibrarySnapshot::Open((fs::temp_directory_path() / "test_vdu_missing.snapshot").c_str()));
+}
+
+TEST_F(LibrarySnapshotFile, Export_WritesProbedLibrary) {
+    const fs::path video = fs::temp_directory_path() / "test_vdu_snapshot.mp4";
+    const fs::path missing = fs::temp_directory_path() / "test_vdu_snapshot_missing.mkv";
+    WriteMp4(video, 5025000.0, 4096);
+    std::vector<uint32_t> ids;
+    for (const fs::path& path : {video, missing}) {
+        const std::string utf8 = path.string();
+        ids.push_back(path_arena_intern(utf8.data(), static_cast<uint32_t>(utf8.size())));
+        ProbeCache::Instance().Invalidate(ids.back());
+    }
+
+    ASSERT_TRUE(snapshot_write(ids.data(), static_cast<uint32_t>(ids.size()), path_.c_str(), true));
+    const int32_t handle = snapshot_open(path_.c_str());
+    ASSERT_GT(handle, 0);
+    EXPECT_EQ(snapshot_row_count(handle), 2u);
+
+    uint64_t count = 0;
+    const auto* sizes = static_cast<const int64_t*>(snapshot_column(handle, static_cast<uint32_t>(SnapshotColumn::SizeBytes), &count));
+    ASSERT_EQ(count, 2u);
+    EXPECT_EQ(sizes[0], static_cast<int64_t>(fs::file_size(video)));
+    EXPECT_EQ(sizes[1], 0);
+    const auto* durations = static_cast<const double*>(snapshot_column(handle, static_cast<uint32_t>(SnapshotColumn::DurationMs), nullptr));
+    EXPECT_DOUBLE_EQ(durations[0], 5025000.0);
+    const auto* containers = static_cast<const uint8_t*>(snapshot_column(handle, static_cast<uint32_t>(SnapshotColumn::Container), &count));
+    ASSERT_EQ(count, 2u);
+    EXPECT_EQ(containers[0], static_cast<uint8_t>(ContainerKind::IsoBmff));
+
+    uint64_t first = 0;
+    EXPECT_EQ(snapshot_index_range(handle, static_cast<uint32_t>(SnapshotColumn::ByDuration), 0, 1e12, &first), 1u);
+    EXPECT_TRUE(snapshot_close(handle));
+    EXPECT_FALSE(snapshot_close(handle));
+    EXPECT_EQ(snapshot_row_count(handle), 0u);
+    fs::remove(video);
+}
+
+} // namespace test
+} // namespace video_data_utils
@@ -0,0 +1,408 @@
+#ifndef TEST_MEDIA_FIXTURES_H
+#define TEST_MEDIA_FIXTURES_H
+
+// Builders for the smallest MP4 and Matroska files the native parsers accept,
+// and synthetic video frames. Shared by the tests and the benchmarks.
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace video_data_utils {
+namespace fixtures {
+
+inline std::string Be32(uint32_t value) {
+    return {static_cast<char>(value >> 24), static_cast<char>(value >> 16), static_cast<char>(value >> 8), static_cast<char>(value)};
+}
+
+inline std::string Be64(uint64_t value) {
+    return Be32(static_cast<uint32_t>(value >> 32)) + Be32(static_cast<uint32_t>(value));
+}
+
+inline std::string Box(const char* type, const std::string& payload) {
+    return Be32(static_cast<uint32_t>(8 + payload.size())) + std::string(type, 4) + payload;
+}
+
+// Header of a box whose payload is written separately (or left as a sparse hole)
+inline std::string BoxHeader(const char* type, uint64_t payloadSize) {
+    return Be32(static_cast<uint32_t>(8 + payloadSize)) + std::string(type, 4);
+}
+
+inline std::string Mvhd(uint32_t timescale, uint64_t duration, bool version1 = false) {
+    std::string payload = version1 ? std::string("\x01\x00\x00\x00", 4) + Be64(0) + Be64(0) + Be32(timescale) + Be64(duration)
+                                   : std::string(4, '\0') + Be32(0) + Be32(0) + Be32(timescale) + Be32(static_cast<uint32_t>(duration));
+    payload.append(80, '\0'); // rate, volume, matrix, next track ID
+    return Box("mvhd", payload);
+}
+
+inline std::string Ftyp() {
+    return Box("ftyp", std::string("isom\x00\x00\x02\x00isomiso2mp41", 20));
+}
+
+inline std::string Moov(double durationMs, bool version1 = false) {
+    return Box("moov", Mvhd(1000, static_cast<uint64_t>(durationMs), version1) + Box("trak", std::string(64, '\0')));
+}
+
+// EBML ID bytes are written as-is; sizes use 8-byte vints so payloads can be patched later
+inline std::string EbmlId(uint32_t id) {
+    std::string bytes;
+    for (int shift = 24; shift >= 0; shift -= 8)
+        if ((id >> shift) != 0 || !bytes.empty()) bytes.push_back(static_cast<char>((id >> shift) & 0xFF));
+    return bytes;
+}
+
+inline std::string EbmlSize(uint64_t size) {
+    return std::string(1, '\x01') + Be64(size).substr(1);
+}
+
+inline std::string Ebml(uint32_t id, const std::string& payload) {
+    return EbmlId(id) + EbmlSize(payload.size()) + payload;
+}
+
+inline std::string EbmlUInt(uint32_t id, uint64_t value) {
+    return Ebml(id, Be64(value));
+}
+
+inline std::string EbmlFloat(uint32_t id, double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return Ebml(id, Be64(bits));
+}
+
+inline std::string EbmlHeader(const char* docType) {
+    return Ebml(0x1A45DFA3, EbmlUInt(0x4286, 1) + Ebml(0x4282, docType));
+}
+
+inline std::string MkvInfo(double durationMs) {
+    return Ebml(0x1549A966, EbmlUInt(0x2AD7B1, 1000000) + EbmlFloat(0x4489, durationMs));
+}
+
+// Segment payload: SeekHead pointing at Info, Void padding of voidBytes, then Info
+inline std::string MkvSegmentPayload(double durationMs, size_t voidBytes) {
+    auto seekHead = [](uint64_t infoPosition) {
+        return Ebml(0x114D9B74, Ebml(0x4DBB, Ebml(0x53AB, EbmlId(0x1549A966)) + EbmlUInt(0x53AC, infoPosition)));
+    };
+    const std::string voidElement = Ebml(0xEC, std::string(voidBytes, '\0'));
+    const uint64_t infoPosition = seekHead(0).size() + voidElement.size();
+    return seekHead(infoPosition) + voidElement + MkvInfo(durationMs);
+}
+
+inline std::string Mkv(double durationMs, size_t voidBytes = 0, const char* docType = "matroska") {
+    return EbmlHeader(docType) + Ebml(0x18538067, MkvSegmentPayload(durationMs, voidBytes));
+}
+
+inline std::string FullBox(const char* type, const std::string& payload) {
+    return Box(type, std::string(4, '\0') + payload);
+}
+
+// trak with the handler ("vide", "soun"), media timescale and sample table boxes given
+inline std::string Trak(const char* handler, uint32_t timescale, const std::string& stblChildren) {
+    const std::string mdhd = FullBox("mdhd", Be32(0) + Be32(0) + Be32(timescale) + Be32(0) + std::string(4, '\0'));
+    const std::string hdlr = FullBox("hdlr", Be32(0) + std::string(handler, 4) + std::string(13, '\0'));
+    return Box("trak", Box("mdia", mdhd + hdlr + Box("minf", Box("stbl", stblChildren))));
+}
+
+inline std::string Be16(uint16_t value) {
+    return {static_cast<char>(value >> 8), static_cast<char>(value)};
+}
+
+// SimpleBlock for track numbers below 127, followed by dataBytes of payload
+inline std::string SimpleBlock(uint8_t track, int16_t relative, bool keyframe, size_t dataBytes = 16) {
+    return Ebml(0xA3, std::string(1, static_cast<char>(0x80 | track)) + Be16(static_cast<uint16_t>(relative)) +
+                          std::string(1, keyframe ? '\x80' : '\x00') + std::string(dataBytes, '\0'));
+}
+
+inline std::string BlockGroup(uint8_t track, int16_t relative, bool referencesOther, size_t dataBytes = 16) {
+    std::string block = Ebml(0xA1, std::string(1, static_cast<char>(0x80 | track)) + Be16(static_cast<uint16_t>(relative)) +
+                                       std::string(1, '\0') + std::string(dataBytes, '\0'));
+    return Ebml(0xA0, block + (referencesOther ? EbmlUInt(0xFB, 40) : std::string()));
+}
+
+inline std::string Cluster(uint64_t timestamp, const std::string& blocks) {
+    return Ebml(0x1F43B675, EbmlUInt(0xE7, timestamp) + blocks);
+}
+
+// Track 1 is audio, track 2 video
+inline std::string MkvTracks() {
+    return Ebml(0x1654AE6B, Ebml(0xAE, EbmlUInt(0xD7, 1) + EbmlUInt(0x83, 2)) + Ebml(0xAE, EbmlUInt(0xD7, 2) + EbmlUInt(0x83, 1)));
+}
+
+// Bytes before the Segment payload, which Matroska positions are relative to
+inline size_t MkvSegmentOffset(const char* docType = "matroska") {
+    return EbmlHeader(docType).size() + 4 + 8;
+}
+
+/**
+ * Segment: SeekHead, Info, Tracks, the clusters, then Cues pointing at each
+ * cluster (time = cluster timestamp, video track) when withCues is set.
+ * Info gives a TimestampScale of 1 ms and durationMs. clusterPositions
+ * receives each cluster's offset relative to the Segment payload.
+ */
+inline std::string MkvWithClusters(const std::vector<std::pair<uint64_t, std::string>>& clusters, bool withCues,
+                                   std::vector<uint64_t>* clusterPositions = nullptr, double durationMs = 60000.0) {
+    auto seek = [](uint32_t id, uint64_t position) { return Ebml(0x4DBB, Ebml(0x53AB, EbmlId(id)) + EbmlUInt(0x53AC, position)); };
+    auto seekHead = [&](uint64_t info, uint64_t tracks, uint64_t cues) {
+        return Ebml(0x114D9B74, seek(0x1549A966, info) + seek(0x1654AE6B, tracks) + (withCues ? seek(0x1C53BB6B, cues) : ""));
+    };
+    const std::string info = MkvInfo(durationMs);
+    const std::string tracks = MkvTracks();
+    const uint64_t infoAt = seekHead(0, 0, 0).size();
+    const uint64_t tracksAt = infoAt + info.size();
+
+    std::string body;
+    std::string cuePoints;
+    uint64_t at = tracksAt + tracks.size();
+    for (const auto& cluster : clusters) {
+        const std::string element = Cluster(cluster.first, cluster.second);
+        if (clusterPositions != nullptr) clusterPositions->push_back(at);
+        cuePoints += Ebml(0xBB, EbmlUInt(0xB3, cluster.first) + Ebml(0xB7, EbmlUInt(0xF7, 2) + EbmlUInt(0xF1, at)));
+        body += element;
+        at += element.size();
+    }
+    const std::string cues = withCues ? Ebml(0x1C53BB6B, cuePoints) : "";
+    return EbmlHeader("matroska") + Ebml(0x18538067, seekHead(infoAt, tracksAt, at) + info + tracks + body + cues);
+}
+
+// MP4 with a large mdat before the moov, as written by most encoders. The mdat
+// payload is left as a hole so thousands of these are cheap to create.
+inline std::string Mp4MoovAtEndHead(uint64_t mdatBytes) {
+    return Ftyp() + BoxHeader("mdat", mdatBytes);
+}
+
+inline void WriteFile(const std::filesystem::path& path, const std::string& head, uint64_t gap = 0, const std::string& tail = "") {
+    std::ofstream file(path, std::ios::binary | std::ios::trunc);
+    file << head;
+    if (gap > 0) file.seekp(static_cast<std::streamoff>(head.size() + gap));
+    file << tail;
+}
+
+inline void WriteMp4(const std::filesystem::path& path, double durationMs, uint64_t mdatBytes) {
+    WriteFile(path, Mp4MoovAtEndHead(mdatBytes), mdatBytes, Moov(durationMs));
+}
+
+inline std::string Le16(uint16_t value) {
+    return {static_cast<char>(value), static_cast<char>(value >> 8)};
+}
+
+inline std::string Le32(uint32_t value) {
+    return Le16(static_cast<uint16_t>(value)) + Le16(static_cast<uint16_t>(value >> 16));
+}
+
+inline std::string Le64(uint64_t value) {
+    return Le32(static_cast<uint32_t>(value)) + Le32(static_cast<uint32_t>(value >> 32));
+}
+
+inline std::string Be24(uint32_t value) {
+    return Be32(value).substr(1);
+}
+
+inline std::string RiffChunk(const char* id, const std::string& payload) {
+    return std::string(id, 4) + Le32(static_cast<uint32_t>(payload.size())) + payload + (payload.size() % 2 ? std::string(1, '\0') : "");
+}
+
+inline std::string RiffList(const char* type, const std::string& children) {
+    return RiffChunk("LIST", std::string(type, 4) + children);
+}
+
+// AVI whose avih holds the frame period and count; odmlFrames adds an OpenDML dmlh with the total
+inline std::string Avi(uint32_t microsPerFrame, uint32_t frames, uint32_t odmlFrames = 0) {
+    const std::string avih = RiffChunk("avih", Le32(microsPerFrame) + std::string(12, '\0') + Le32(frames) + std::string(36, '\0'));
+    const std::string strl = RiffList("strl", RiffChunk("strh", std::string(56, '\0')) + RiffChunk("strf", std::string(40, '\0')));
+    const std::string odml = odmlFrames != 0 ? RiffList("odml", RiffChunk("dmlh", Le32(odmlFrames) + std::string(244, '\0'))) : "";
+    const std::string body = "AVI " + RiffList("hdrl", avih + strl + odml) + RiffList("movi", RiffChunk("00dc", std::string(100, '\0')));
+    return "RIFF" + Le32(static_cast<uint32_t>(body.size())) + body;
+}
+
+// ASF Header Object: an unrelated object of leadingBytes, then File Properties
+inline std::string Asf(uint64_t playDuration100ns, uint64_t prerollMs, size_t leadingBytes = 0, bool broadcast = false) {
+    const std::string filler = std::string(16, '\x11') + Le64(24 + leadingBytes) + std::string(leadingBytes, '\0');
+    const std::string properties = std::string("\xA1\xDC\xAB\x8C\x47\xA9\xCF\x11\x8E\xE4\x00\xC0\x0C\x20\x53\x65", 16) + Le64(104) +
+                                   std::string(16, '\0') + Le64(0) + Le64(0) + Le64(0) + Le64(playDuration100ns) + Le64(0) +
+                                   Le64(prerollMs) + Le32(broadcast ? 1 : 2) + Le32(0) + Le32(0) + Le32(0);
+    const std::string children = filler + properties;
+    return std::string("\x30\x26\xB2\x75\x8E\x66\xCF\x11\xA6\xD9\x00\xAA\x00\x62\xCE\x6C", 16) + Le64(30 + children.size()) +
+           Le32(2) + "\x01\x02" + children;
+}
+
+inline std::string FlvTag(uint8_t type, uint32_t timestamp, const std::string& body) {
+    return std::string(1, static_cast<char>(type)) + Be24(static_cast<uint32_t>(body.size())) + Be24(timestamp & 0xFFFFFF) +
+           std::string(1, static_cast<char>(timestamp >> 24)) + std::string(3, '\0') + body + Be32(static_cast<uint32_t>(11 + body.size()));
+}
+
+inline std::string AmfNumber(double value) {
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return std::string(1, '\0') + Be64(bits);
+}
+
+// FLV with an onMetaData tag (duration left out when durationSeconds < 0) and video tags 40 ms apart up to lastTimestamp
+inline std::string Flv(double durationSeconds, uint32_t lastTimestamp, size_t tagBytes = 512) {
+    std::string properties = Be16(5) + "width" + AmfNumber(1280.0);
+    properties += Be16(6) + "stereo" + std::string("\x01\x01", 2);
+    properties += Be16(7) + "encoder" + std::string(1, '\x02') + Be16(3) + "vdu";
+    if (durationSeconds >= 0.0) properties += Be16(8) + "duration" + AmfNumber(durationSeconds);
+    const std::string script = std::string(1, '\x02') + Be16(10) + "onMetaData" + std::string(1, '\x08') + Be32(4) + properties +
+                               Be16(0) + std::string(1, '\x09');
+    std::string file = std::string("FLV\x01\x05", 5) + Be32(9) + Be32(0) + FlvTag(18, 0, script);
+    for (uint32_t t = 0; t < lastTimestamp; t += 40) file += FlvTag(9, t, std::string(tagBytes, '\0'));
+    return file + FlvTag(9, lastTimestamp, std::string(tagBytes, '\0'));
+}
+
+inline std::string OggPage(uint8_t type, uint64_t granule, uint32_t serial, uint32_t sequence, const std::string& body) {
+    std::string lacing(body.size() / 255, '\xFF');
+    lacing.push_back(static_cast<char>(body.size() % 255));
+    return std::string("OggS\0", 5) + std::string(1, static_cast<char>(type)) + Le64(granule) + Le32(serial) + Le32(sequence) + Le32(0) +
+           std::string(1, static_cast<char>(lacing.size())) + lacing + body;
+}
+
+inline std::string OpusHead(uint16_t preSkip) {
+    return "OpusHead" + std::string("\x01\x02", 2) + Le16(preSkip) + Le32(48000) + Le16(0) + std::string(1, '\0');
+}
+
+inline std::string VorbisHead(uint32_t sampleRate) {
+    return std::string("\x01vorbis", 7) + Le32(0) + std::string(1, '\x02') + Le32(sampleRate) + std::string(13, '\0') + "\x01";
+}
+
+// Ogg stream 1 (identification header given), pageCount pages of pageBytes up to lastGranule
+inline std::string Ogg(const std::string& head, uint64_t lastGranule, size_t pageCount, size_t pageBytes = 4000) {
+    std::string file = OggPage(2, 0, 1, 0, head);
+    for (size_t i = 1; i <= pageCount; i++)
+        file += OggPage(i == pageCount ? 4 : 0, lastGranule * i / pageCount, 1, static_cast<uint32_t>(i), std::string(pageBytes, '\0'));
+    return file;
+}
+
+// Transport packet on pid; a PCR base goes in the adaptation field and a PTS in a PES header when not negative
+inline std::string TsPacket(uint16_t pid, int64_t pcr, int64_t pts, bool m2ts = false) {
+    std::string packet(188, '\xFF');
+    packet[0] = 0x47;
+    packet[1] = static_cast<char>((pts >= 0 ? 0x40 : 0) | ((pid >> 8) & 0x1F));
+    packet[2] = static_cast<char>(pid);
+    packet[3] = static_cast<char>(pcr >= 0 ? 0x30 : 0x10);
+    size_t pos = 4;
+    if (pcr >= 0) {
+        const uint64_t base = static_cast<uint64_t>(pcr);
+        const char adaptation[] = {7, 0x10, static_cast<char>(base >> 25), static_cast<char>(base >> 17), static_cast<char>(base >> 9),
+                                   static_cast<char>(base >> 1), static_cast<char>(((base & 1) << 7) | 0x7E), 0};
+        packet.replace(pos, sizeof(adaptation), adaptation, sizeof(adaptation));
+        pos += sizeof(adaptation);
+    }
+    if (pts >= 0) {
+        const uint64_t t = static_cast<uint64_t>(pts);
+        const char pes[] = {0, 0, 1, static_cast<char>(0xE0), 0, 0, static_cast<char>(0x80), static_cast<char>(0x80), 5,
+                            static_cast<char>(0x21 | ((t >> 29) & 0x0E)), static_cast<char>(t >> 22), static_cast<char>(((t >> 14) & 0xFE) | 1),
+                            static_cast<char>(t >> 7), static_cast<char>(((t << 1) & 0xFE) | 1)};
+        packet.replace(pos, sizeof(pes), pes, sizeof(pes));
+    }
+    return (m2ts ? std::string(4, '\0') : std::string()) + packet;
+}
+
+// PCR on pid 0x100 and PTS on 0x101 at both ends, fillerPackets of null packets between. Ticks are 90 kHz.
+inline std::string Ts(uint64_t firstTicks, uint64_t durationTicks, size_t fillerPackets, bool m2ts = false) {
+    const uint64_t mask = (uint64_t(1) << 33) - 1;
+    const uint64_t last = (firstTicks + durationTicks) & mask;
+    std::string file = TsPacket(0x100, static_cast<int64_t>(firstTicks), -1, m2ts) + TsPacket(0x101, -1, static_cast<int64_t>(firstTicks), m2ts);
+    for (size_t i = 0; i < fillerPackets; i++) file += TsPacket(0x1FFF, -1, -1, m2ts);
+    return file + TsPacket(0x101, -1, static_cast<int64_t>(last), m2ts) + TsPacket(0x100, static_cast<int64_t>(last), -1, m2ts);
+}
+
+// Fragmented MP4 layout: every fragment is one moof/mdat pair on track 1, in a media timescale of 1000
+struct FragmentedLayout {
+    size_t fragments = 10;
+    uint32_t samples = 25;     // per fragment
+    uint32_t sampleTicks = 40; // listed in trun; 0 leaves it to the trex default of 40
+    size_t mdatBytes = 4096;
+    uint64_t mehd = 0;         // mvex/mehd fragment_duration, 0 for none
+    bool sidx = false;         // one sidx indexing every fragment, ahead of the first
+    bool tfdt = true;
+    bool mfra = false;         // random access table naming every moof, closed by mfro
+};
+
+inline std::string FragmentedMp4(const FragmentedLayout& layout) {
+    const std::string tkhd = FullBox("tkhd", Be32(0) + Be32(0) + Be32(1) + std::string(72, '\0'));
+    const std::string trak = Box("trak", tkhd + Trak("vide", 1000, "").substr(8));
+    const std::string mehd = layout.mehd != 0 ? FullBox("mehd", Be32(static_cast<uint32_t>(layout.mehd))) : "";
+    const std::string mvex = Box("mvex", mehd + FullBox("trex", Be32(1) + Be32(1) + Be32(40) + Be32(0) + Be32(0)));
+    const std::string head = Ftyp() + Box("moov", Mvhd(1000, 0) + trak + mvex);
+
+    std::vector<std::string> fragments;
+    uint64_t decodeTime = 0;
+    for (size_t i = 0; i < layout.fragments; i++) {
+        std::string trun = Be32(layout.sampleTicks != 0 ? 0x000301 : 0x000201) + Be32(layout.samples) + Be32(0);
+        for (uint32_t s = 0; s < layout.samples; s++)
+            trun += (layout.sampleTicks != 0 ? Be32(layout.sampleTicks) : "") + Be32(static_cast<uint32_t>(layout.mdatBytes / layout.samples));
+        const std::string tfdt = layout.tfdt ? Box("tfdt", std::string("\x01\0\0\0", 4) + Be64(decodeTime)) : "";
+        const std::string traf = Box("traf", FullBox("tfhd", Be32(1)) + tfdt + Box("trun", trun));
+        fragments.push_back(Box("moof", FullBox("mfhd", Be32(static_cast<uint32_t>(i + 1))) + traf) + Box("mdat", std::string(layout.mdatBytes, '\0')));
+        decodeTime += uint64_t(layout.samples) * (layout.sampleTicks != 0 ? layout.sampleTicks : 40);
+    }
+
+    std::string sidx;
+    if (layout.sidx) {
+        std::string entries;
+        for (const std::string& fragment : fragments)
+            entries += Be32(static_cast<uint32_t>(fragment.size())) + Be32(layout.samples * (layout.sampleTicks != 0 ? layout.sampleTicks : 40)) + Be32(0x90000000);
+        sidx = FullBox("sidx", Be32(1) + Be32(1000) + Be32(0) + Be32(0) + Be16(0) + Be16(static_cast<uint16_t>(fragments.size())) + entries);
+    }
+
+    std::string file = head + sidx;
+    std::string tfra;
+    for (const std::string& fragment : fragments) {
+        tfra += Be32(0) + Be32(static_cast<uint32_t>(file.size())) + std::string("\x01\x01\x01", 3);
+        file += fragment;
+    }
+    if (layout.mfra) {
+        const std::string table = FullBox("tfra", Be32(1) + Be32(0) + Be32(static_cast<uint32_t>(fragments.size())) + tfra);
+        file += Box("mfra", table + FullBox("mfro", Be32(static_cast<uint32_t>(8 + table.size() + 16))));
+    }
+    return file;
+}
+
+// BGRA frame with soft shapes placed by seed: distinct seeds give unrelated pictures
+inline std::vector<uint8_t> SyntheticFrame(uint32_t width, uint32_t height, uint32_t seed) {
+    uint32_t state = seed * 2654435761u + 1;
+    auto next = [&state] {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) / double(1 << 24);
+    };
+    double blobs[6][4];
+    for (auto& blob : blobs)
+        for (double& value : blob) value = next();
+
+    std::vector<uint8_t> pixels(size_t(width) * height * 4);
+    for (uint32_t y = 0; y < height; y++)
+        for (uint32_t x = 0; x < width; x++) {
+            const double u = (x + 0.5) / width, v = (y + 0.5) / height;
+            double level = 0.25 + 0.2 * std::sin(6.0 * u * (1 + blobs[0][0]) + 4.0 * v * blobs[0][1]);
+            for (int i = 1; i < 6; i++) {
+                const double dx = u - blobs[i][0], dy = v - blobs[i][1];
+                level += (blobs[i][3] - 0.5) * std::exp(-(dx * dx + dy * dy) / (0.01 + 0.03 * blobs[i][2]));
+            }
+            const uint8_t gray = static_cast<uint8_t>(std::fmin(255.0, std::fmax(0.0, level * 255.0)));
+            uint8_t* p = &pixels[(size_t(y) * width + x) * 4];
+            p[0] = gray;
+            p[1] = static_cast<uint8_t>(gray * 0.9);
+            p[2] = static_cast<uint8_t>(255 - gray / 2);
+            p[3] = 255;
+        }
+    return pixels;
+}
+
+// Nearest-neighbour rescale of a BGRA frame
+inline std::vector<uint8_t> ResizeFrame(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, uint32_t newWidth,
+                                        uint32_t newHeight) {
+    std::vector<uint8_t> resized(size_t(newWidth) * newHeight * 4);
+    for (uint32_t y = 0; y < newHeight; y++)
+        for (uint32_t x = 0; x < newWidth; x++)
+            std::memcpy(&resized[(size_t(y) * newWidth + x) * 4], &pixels[(size_t(y * height / newHeight) * width + x * width / newWidth) * 4], 4);
+    return resized;
+}
+
+} // namespace fixtures
+} // namespace video_data_utils
+
+#endif // TEST_MEDIA_FIXTURES_H
@@ -0,0 +1,141 @@
+#include <gtest/gtest.h>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../path_arena.h"
+#include "../utf_transcode.h"
+#include "../video_data_exporter_api.h"
+
+namespace video_data_utils {
+namespace test {
+
+static std::u16string ToUtf16(const std::string& utf8) {
+    std::u16string out(utf8.size(), u'\0');
+    out.resize(Utf8ToUtf16(utf8.data(), utf8.size(), &out[0]));
+    return out;
+}
+
+static std::string ToUtf8(const std::u16string& utf16) {
+    std::string out(utf16.size() * 3, '\0');
+    out.resize(Utf16ToUtf8(utf16.data(), utf16.size(), &out[0]));
+    return out;
+}
+
+TEST(PathArenaTests, Transcode_AsciiRoundTrip) {
+    // Long enough to exercise the vector loop plus a scalar tail
+    std::string ascii = "C:\\Videos\\Series\\Season 01\\Episode 01 - Pilot.mkv";
+    std::u16string wide = ToUtf16(ascii);
+    ASSERT_EQ(wide.size(), ascii.size());
+    for (size_t i = 0; i < ascii.size(); i++) EXPECT_EQ(wide[i], static_cast<char16_t>(ascii[i]));
+    EXPECT_EQ(ToUtf8(wide), ascii);
+}
+
+TEST(PathArenaTests, Transcode_MultiByteRoundTrip) {
+    std::string mixed = "/media/Vid\xC3\xA9os/\xE6\x97\xA5\xE6\x9C\xAC\xE8\xAA\x9E/clip_\xF0\x9F\x8E\xAC_0123456789abcdef.mp4";
+    std::u16string wide = ToUtf16(mixed);
+    EXPECT_EQ(wide[10], u'\u00E9');
+    // U+1F3AC is encoded as a surrogate pair
+    EXPECT_NE(wide.find(u"\xD83C\xDFAC"), std::u16string::npos);
+    EXPECT_EQ(ToUtf8(wide), mixed);
+}
+
+TEST(PathArenaTests, Transcode_MalformedInputBecomesReplacement) {
+    std::string bad = "a\xFF" "b\xE6\x97" "c\xED\xA0\x80";
+    std::u16string wide = ToUtf16(bad);
+    EXPECT_EQ(wide, std::u16string(u"a\uFFFDb\uFFFDc\uFFFD\uFFFD\uFFFD"));
+
+    std::u16string lone = u"x";
+    lone.push_back(static_cast<char16_t>(0xD800));
+    EXPECT_EQ(ToUtf8(lone), "x\xEF\xBF\xBD");
+}
+
+TEST(PathArenaTests, Intern_SamePathSameId) {
+    PathArena& arena = PathArena::Instance();
+    uint32_t a = arena.InternUtf8("/tmp/vdu/arena/a.mp4", 20);
+    uint32_t b = arena.InternUtf8("/tmp/vdu/arena/b.mp4", 20);
+    EXPECT_NE(a, kInvalidPathId);
+    EXPECT_NE(a, b);
+    EXPECT_EQ(arena.InternUtf8("/tmp/vdu/arena/a.mp4", 20), a);
+    EXPECT_EQ(arena.InternUtf8("", 0), kInvalidPathId);
+}
+
+TEST(PathArenaTests, Intern_Normalizes) {
+    NativePath messy = PATH_LITERAL("/tmp//vdu///normalize/");
+    NativePath clean = PATH_LITERAL("/tmp/vdu/normalize");
+#ifdef _WIN32
+    messy = L"\"C:/tmp//vdu\\\\normalize\\\"";
+    clean = L"C:\\tmp\\vdu\\normalize";
+#endif
+    PathArena& arena = PathArena::Instance();
+    EXPECT_EQ(arena.Intern(messy), arena.Intern(clean));
+    EXPECT_EQ(arena.Path(arena.Intern(messy)), clean);
+}
+
+TEST(PathArenaTests, Intern_PointersStayStableAcrossChunks) {
+    PathArena& arena = PathArena::Instance();
+    uint32_t first = arena.InternUtf8("/tmp/vdu/stable/first", 21);
+    const PathChar* before = path_arena_get(first, nullptr);
+
+    // Push well past one chunk
+    for (int i = 0; i < 5000; i++) {
+        std::string path = "/tmp/vdu/stable/filler_" + std::to_string(i) + ".mkv";
+        arena.InternUtf8(path.data(), path.size());
+    }
+    uint32_t length = 0;
+    EXPECT_EQ(path_arena_get(first, &length), before);
+    EXPECT_EQ(length, 21u);
+}
+
+TEST(PathArenaTests, Export_BatchIntern) {
+    std::string blob = "/tmp/vdu/batch/one.mkv/tmp/vdu/batch/two.mkv";
+    std::vector<uint32_t> offsets = {0, 22, 44};
+    uint32_t ids[2];
+    EXPECT_EQ(path_arena_intern_batch(blob.data(), offsets.data(), 2, ids), 2u);
+    EXPECT_EQ(ids[0], path_arena_intern("/tmp/vdu/batch/one.mkv", 22));
+
+    uint32_t length = 0;
+    const PathChar* two = path_arena_get(ids[1], &length);
+    ASSERT_NE(two, nullptr);
+    EXPECT_EQ(NativePathToUtf8(NativePathView(two, length)), "/tmp/vdu/batch/two.mkv");
+    EXPECT_EQ(path_arena_get(kInvalidPathId, &length), nullptr);
+    EXPECT_EQ(length, 0u);
+}
+
+TEST(PathArenaTests, Export_LongPathsAreNotTruncated) {
+    std::string longPath = "/tmp/vdu";
+    while (longPath.size() < 1000) longPath += "/a_directory_name_that_is_long";
+    uint32_t id = path_arena_intern(longPath.data(), static_cast<uint32_t>(longPath.size()));
+    uint32_t length = 0;
+    const PathChar* stored = path_arena_get(id, &length);
+    ASSERT_NE(stored, nullptr);
+    EXPECT_GE(length, longPath.size());
+}
+
+TEST(PathArenaTests, Export_MetadataBatchById) {
+    std::filesystem::path file = std::filesystem::temp_directory_path() / "test_vdu_arena_meta.txt";
+    FILE* handle = std::fopen(file.string().c_str(), "w");
+    ASSERT_NE(handle, nullptr);
+    std::fputs("Sample test data to have non-zero file size.", handle);
+    std::fclose(handle);
+
+    std::string utf8 = file.u8string();
+    uint32_t ids[2] = {
+        path_arena_intern(utf8.data(), static_cast<uint32_t>(utf8.size())),
+        path_arena_intern("/definitely/missing/vdu.bin", 27),
+    };
+    FileMetadata meta[2];
+    bool ok[2];
+    EXPECT_EQ(get_file_metadata_batch(ids, 2, meta, ok), 1u);
+    EXPECT_TRUE(ok[0]);
+    EXPECT_FALSE(ok[1]);
+    EXPECT_EQ(meta[0].file_size_bytes, 44);
+    EXPECT_GT(meta[0].modified_time_ms, 0);
+    EXPECT_EQ(meta[1].file_size_bytes, 0);
+
+    std::filesystem::remove(file);
+}
+
+} // namespace test
+} // namespace video_data_utils
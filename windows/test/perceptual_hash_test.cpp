@@ -0,0 +1,210 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../perceptual_hash.h"
+#include "../similarity_index.h"
+#include "media_fixtures.h"
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+static void Hash(const std::vector<uint8_t>& pixels, uint32_t width, uint32_t height, uint64_t* dhash, uint64_t* phash) {
+    ASSERT_TRUE(ComputeImageHashes(pixels.data(), width, height, width * 4, dhash, phash));
+}
+
+static std::vector<SimilarityMatch> BruteForce(const std::vector<uint64_t>& hashes, uint64_t query, uint32_t radius) {
+    std::vector<SimilarityMatch> matches;
+    for (uint32_t id = 0; id < hashes.size(); id++) {
+        const uint32_t distance = HammingDistance(hashes[id], query);
+        if (distance <= radius) matches.push_back({id, distance});
+    }
+    std::sort(matches.begin(), matches.end(), [](const SimilarityMatch& a, const SimilarityMatch& b) {
+        return a.distance != b.distance ? a.distance < b.distance : a.path_id < b.path_id;
+    });
+    return matches;
+}
+
+// Groups of near-duplicates (a few bits flipped) among unrelated hashes
+static std::vector<uint64_t> ClusteredHashes(size_t count, uint32_t seed) {
+    std::mt19937_64 random(seed);
+    std::vector<uint64_t> hashes;
+    while (hashes.size() < count) {
+        const uint64_t base = random();
+        hashes.push_back(base);
+        for (int copy = 0; copy < 3 && hashes.size() < count; copy++) {
+            uint64_t variant = base;
+            for (uint64_t flips = random() % 12; flips > 0; flips--) variant ^= 1ull << (random() % 64);
+            hashes.push_back(variant);
+        }
+    }
+    return hashes;
+}
+
+static bool SameMatches(const std::vector<SimilarityMatch>& a, const std::vector<SimilarityMatch>& b) {
+    return std::equal(a.begin(), a.end(), b.begin(), b.end(), [](const SimilarityMatch& x, const SimilarityMatch& y) {
+        return x.path_id == y.path_id && x.distance == y.distance;
+    });
+}
+
+TEST(PerceptualHashTests, Hashes_StableAcrossRescaleAndNoise) {
+    const uint32_t width = 320, height = 180;
+    const std::vector<uint8_t> original = SyntheticFrame(width, height, 7);
+    uint64_t dhash, phash;
+    Hash(original, width, height, &dhash, &phash);
+
+    // Same frame at another size, as a lower-quality encode would be thumbnailed
+    uint64_t smallD, smallP;
+    Hash(ResizeFrame(original, width, height, 200, 112), 200, 112, &smallD, &smallP);
+    EXPECT_LE(HammingDistance(phash, smallP), 6u);
+    EXPECT_LE(HammingDistance(dhash, smallD), 8u);
+
+    // Brighter, with compression-like noise
+    std::vector<uint8_t> noisy = original;
+    std::mt19937 random(3);
+    for (size_t i = 0; i < noisy.size(); i++)
+        if (i % 4 != 3) noisy[i] = static_cast<uint8_t>(std::min(255, noisy[i] + 12 + static_cast<int>(random() % 9) - 4));
+    uint64_t noisyD, noisyP;
+    Hash(noisy, width, height, &noisyD, &noisyP);
+    EXPECT_LE(HammingDistance(phash, noisyP), 6u);
+    EXPECT_LE(HammingDistance(dhash, noisyD), 8u);
+
+    // Unrelated frames land about half the bits apart
+    uint32_t total = 0;
+    for (uint32_t seed = 100; seed < 120; seed++) {
+        uint64_t otherD, otherP;
+        Hash(SyntheticFrame(width, height, seed), width, height, &otherD, &otherP);
+        total += HammingDistance(phash, otherP);
+    }
+    EXPECT_GT(total / 20, 20u);
+}
+
+TEST(PerceptualHashTests, Hashes_RespectStrideAndRejectBadInput) {
+    const std::vector<uint8_t> frame = SyntheticFrame(64, 48, 11);
+    uint64_t dhash, phash;
+    Hash(frame, 64, 48, &dhash, &phash);
+
+    // Rows padded to 80 pixels hash the same
+    std::vector<uint8_t> padded(80 * 4 * 48, 0xEE);
+    for (uint32_t y = 0; y < 48; y++) std::copy_n(&frame[y * 64 * 4], 64 * 4, &padded[y * 80 * 4]);
+    uint64_t paddedD, paddedP;
+    ASSERT_TRUE(ComputeImageHashes(padded.data(), 64, 48, 80 * 4, &paddedD, &paddedP));
+    EXPECT_EQ(paddedD, dhash);
+    EXPECT_EQ(paddedP, phash);
+
+    // Images smaller than the 32x32 reduction are stretched rather than rejected
+    EXPECT_TRUE(ComputeImageHashes(frame.data(), 5, 3, 64 * 4, &dhash, &phash));
+    EXPECT_FALSE(ComputeImageHashes(nullptr, 64, 48, 64 * 4, &dhash, &phash));
+    EXPECT_FALSE(ComputeImageHashes(frame.data(), 0, 48, 64 * 4, &dhash, &phash));
+    EXPECT_FALSE(ComputeImageHashes(frame.data(), 64, 48, 63 * 4, &dhash, &phash));
+}
+
+TEST(SimilarityIndexTests, Within_MatchesLinearScan) {
+    const std::vector<uint64_t> hashes = ClusteredHashes(20000, 1);
+    SimilarityIndex index;
+    for (uint32_t id = 0; id < hashes.size(); id++) index.Insert(id, hashes[id]);
+    ASSERT_EQ(index.Size(), hashes.size());
+
+    std::vector<SimilarityMatch> matches;
+    for (uint32_t radius : {0u, 3u, 4u, 7u, 11u, 15u, 16u, 24u}) {
+        for (uint32_t q = 0; q < hashes.size(); q += 997) {
+            const uint64_t query = hashes[q] ^ (1ull << (q % 64));
+            index.Within(query, radius, &matches);
+            EXPECT_TRUE(SameMatches(matches, BruteForce(hashes, query, radius))) << "radius " << radius << " query " << q;
+        }
+    }
+}
+
+TEST(SimilarityIndexTests, Nearest_MatchesLinearScan) {
+    const std::vector<uint64_t> hashes = ClusteredHashes(20000, 2);
+    SimilarityIndex index;
+    for (uint32_t id = 0; id < hashes.size(); id++) index.Insert(id, hashes[id]);
+
+    std::mt19937_64 random(9);
+    std::vector<SimilarityMatch> matches;
+    for (uint32_t k : {1u, 4u, 10u}) {
+        for (int q = 0; q < 40; q++) {
+            // Half the queries sit next to stored hashes, half are random and fall back to a scan
+            const uint64_t query = q % 2 ? hashes[random() % hashes.size()] ^ (random() & random() & random()) : random();
+            index.Nearest(query, k, &matches);
+            std::vector<SimilarityMatch> expected = BruteForce(hashes, query, 64);
+            expected.resize(k);
+            ASSERT_EQ(matches.size(), k);
+            EXPECT_TRUE(SameMatches(matches, expected)) << "k " << k << " query " << q;
+        }
+    }
+}
+
+TEST(SimilarityIndexTests, InsertReplacesAndRemoves) {
+    SimilarityIndex index;
+    index.Insert(1, 0x00FF00FF00FF00FFull);
+    index.Insert(2, 0x00FF00FF00FF00FEull);
+    index.Insert(3, ~0ull);
+
+    std::vector<SimilarityMatch> matches;
+    index.Within(0x00FF00FF00FF00FFull, 2, &matches);
+    ASSERT_EQ(matches.size(), 2u);
+    EXPECT_EQ(matches[0].path_id, 1u);
+    EXPECT_EQ(matches[1].distance, 1u);
+
+    // A new thumbnail hash for path 2 moves it out of range; the freed slot is reused
+    index.Insert(2, 0ull);
+    index.Within(0x00FF00FF00FF00FFull, 2, &matches);
+    EXPECT_EQ(matches.size(), 1u);
+    EXPECT_TRUE(index.Remove(1));
+    EXPECT_FALSE(index.Remove(1));
+    index.Insert(4, 0x00FF00FF00FF00FFull);
+    index.Within(0x00FF00FF00FF00FFull, 0, &matches);
+    ASSERT_EQ(matches.size(), 1u);
+    EXPECT_EQ(matches[0].path_id, 4u);
+
+    uint64_t hash;
+    ASSERT_TRUE(index.Find(2, &hash));
+    EXPECT_EQ(hash, 0u);
+    EXPECT_EQ(index.Size(), 3u);
+    index.Nearest(~0ull, 10, &matches);
+    ASSERT_EQ(matches.size(), 3u);
+    EXPECT_EQ(matches[0].path_id, 3u);
+    index.Clear();
+    EXPECT_EQ(index.Size(), 0u);
+}
+
+TEST(SimilarityIndexTests, Export_AddAndQuery) {
+    SimilarityIndex::Instance().Clear();
+    const std::vector<uint8_t> frame = SyntheticFrame(160, 90, 21);
+    uint64_t dhash, phash;
+    ASSERT_TRUE(compute_image_hashes(frame.data(), 160, 90, 160 * 4, &dhash, &phash));
+
+    uint64_t rescaledD, rescaledP;
+    const std::vector<uint8_t> rescaled = ResizeFrame(frame, 160, 90, 120, 68);
+    ASSERT_TRUE(compute_image_hashes(rescaled.data(), 120, 68, 120 * 4, &rescaledD, &rescaledP));
+    similarity_index_add(10, phash);
+    similarity_index_add(11, rescaledP);
+    for (uint32_t seed = 0; seed < 8; seed++) {
+        const std::vector<uint8_t> other = SyntheticFrame(160, 90, 500 + seed);
+        uint64_t otherP;
+        ASSERT_TRUE(compute_image_hashes(other.data(), 160, 90, 160 * 4, nullptr, &otherP));
+        similarity_index_add(20 + seed, otherP);
+    }
+    EXPECT_EQ(similarity_index_size(), 10u);
+
+    SimilarityMatch matches[4];
+    const uint32_t found = similarity_find_within(phash, 8, matches, 4);
+    ASSERT_EQ(found, 2u);
+    EXPECT_EQ(matches[0].path_id, 10u);
+    EXPECT_EQ(matches[1].path_id, 11u);
+    EXPECT_EQ(similarity_find_within(phash, 8, nullptr, 0), 2u);
+
+    ASSERT_EQ(similarity_find_nearest(rescaledP, 2, matches), 2u);
+    EXPECT_EQ(matches[0].path_id, 11u);
+    EXPECT_EQ(matches[1].path_id, 10u);
+    EXPECT_TRUE(similarity_index_remove(11));
+    EXPECT_EQ(similarity_find_within(phash, 8, matches, 4), 1u);
+    SimilarityIndex::Instance().Clear();
+}
+
+} // namespace test
+} // namespace video_data_utils
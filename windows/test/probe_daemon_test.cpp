@@ -0,0 +1,259 @@
+#include <gtest/gtest.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../file_probe.h"
+#include "../hot_cache.h"
+#include "../path_arena.h"
+#include "../probe_daemon.h"
+#include "../video_data_exporter_api.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+// A gradient whose pixels name their position, so a misplaced row shows
+bool RenderGradient(const PathChar*, uint32_t size, PooledBuffer* bgra, uint32_t* width, uint32_t* height) {
+    *width = size;
+    *height = size / 2;
+    bgra->resize(size_t(*width) * *height * 4);
+    for (uint32_t y = 0; y < *height; y++)
+        for (uint32_t x = 0; x < *width; x++) {
+            uint8_t* pixel = bgra->data() + (size_t(y) * *width + x) * 4;
+            pixel[0] = static_cast<uint8_t>(x);
+            pixel[1] = static_cast<uint8_t>(y);
+            pixel[2] = static_cast<uint8_t>(x ^ y);
+            pixel[3] = 255;
+        }
+    return true;
+}
+
+class ProbeDaemonTests : public ::testing::Test {
+protected:
+    void SetUp() override {
+        dir_ = fs::temp_directory_path() / "test_vdu_probe_daemon";
+        fs::remove_all(dir_);
+        fs::create_directories(dir_);
+        endpoint_ = (dir_ / "probed.sock").native();
+        for (int i = 0; i < 24; i++) {
+            const fs::path path = dir_ / ("clip" + std::to_string(i) + ".mkv");
+            WriteFile(path, Mkv(1000.0 * (i + 1)));
+            natives_.push_back(path.native());
+        }
+    }
+    void TearDown() override { fs::remove_all(dir_); }
+
+    DaemonServerOptions Options() const {
+        DaemonServerOptions options;
+        options.endpoint = endpoint_;
+        options.renderer = RenderGradient;
+        return options;
+    }
+
+    fs::path dir_;
+    NativePath endpoint_;
+    std::vector<NativePath> natives_;
+};
+
+TEST_F(ProbeDaemonTests, AnswersPipelinedRequestsFromManyThreads) {
+    DaemonServer server(Options());
+    ASSERT_TRUE(server.Start());
+    DaemonClient client(endpoint_);
+
+    double duration = 0.0;
+    ASSERT_EQ(client.Duration(natives_[0].c_str(), &duration), DaemonReply::Ok);
+    EXPECT_DOUBLE_EQ(duration, 1000.0);
+    EXPECT_EQ(client.Stats().daemon_pid, static_cast<uint32_t>(getpid()));
+
+    std::vector<const PathChar*> paths;
+    for (const NativePath& native : natives_) paths.push_back(native.c_str());
+    const NativePath missing = (dir_ / "missing.mkv").native();
+    paths.push_back(missing.c_str());
+
+    // Four threads with a batch each share one connection; answers return out of order
+    std::atomic<int> wrong{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; t++)
+        threads.emplace_back([&] {
+            std::vector<double> durations;
+            std::vector<uint8_t> answered;
+            if (client.DurationBatch(paths, &durations, &answered) != DaemonReply::Ok) wrong++;
+            for (size_t i = 0; i < natives_.size(); i++)
+                if (durations[i] != 1000.0 * (i + 1) || !answered[i]) wrong++;
+            if (answered.back() != 0) wrong++;
+        });
+    for (std::thread& thread : threads) thread.join();
+    EXPECT_EQ(wrong.load(), 0);
+
+    FileProbeResult result;
+    ASSERT_EQ(client.Probe(natives_[3].c_str(), kProbeAllFields, &result), DaemonReply::Ok);
+    EXPECT_DOUBLE_EQ(result.duration_ms, 4000.0);
+    EXPECT_EQ(result.metadata.file_size_bytes, static_cast<int64_t>(fs::file_size(natives_[3])));
+    EXPECT_EQ(client.Probe(missing.c_str(), kProbeAllFields, &result), DaemonReply::Failed);
+
+    const DaemonServerStats stats = server.Stats();
+    EXPECT_EQ(stats.connections, 1u);
+    EXPECT_EQ(stats.requests, 1u + 1u + 4u * paths.size() + 2u); // the handshake first
+    EXPECT_EQ(stats.failed, 4u + 1u); // the missing file in every batch, and its probe
+}
+
+TEST_F(ProbeDaemonTests, MissingFilesFailAndRelativePathsResolveForTheCaller) {
+    DaemonServer server(Options());
+    ASSERT_TRUE(server.Start());
+    DaemonClient client(endpoint_);
+
+    double duration = -1.0;
+    EXPECT_EQ(client.Duration((dir_ / "missing.mkv").c_str(), &duration), DaemonReply::Failed);
+    // A file that opens without a duration is an answer, not a failure
+    WriteFile(dir_ / "notes.txt", "not a video");
+    EXPECT_EQ(client.Duration((dir_ / "notes.txt").c_str(), &duration), DaemonReply::Ok);
+    EXPECT_DOUBLE_EQ(duration, 0.0);
+
+    const fs::path previous = fs::current_path();
+    fs::current_path(dir_);
+    EXPECT_EQ(client.Duration(PATH_LITERAL("clip3.mkv"), &duration), DaemonReply::Ok);
+    fs::current_path(previous);
+    EXPECT_DOUBLE_EQ(duration, 4000.0);
+}
+
+TEST_F(ProbeDaemonTests, ThumbnailPixelsArriveInSharedMemory) {
+    DaemonServer server(Options());
+    ASSERT_TRUE(server.Start());
+    DaemonClient client(endpoint_);
+
+    std::unique_ptr<SharedPixels> pixels;
+    uint32_t width = 0, height = 0;
+    ASSERT_EQ(client.ThumbnailPixels(natives_[0].c_str(), 160, &pixels, &width, &height), DaemonReply::Ok);
+    ASSERT_TRUE(pixels);
+    EXPECT_EQ(width, 160u);
+    EXPECT_EQ(height, 80u);
+    ASSERT_EQ(pixels->size(), size_t(width) * height * 4);
+    for (uint32_t y = 0; y < height; y += 7)
+        for (uint32_t x = 0; x < width; x += 11) {
+            const uint8_t* pixel = pixels->data() + (size_t(y) * width + x) * 4;
+            ASSERT_EQ(pixel[0], static_cast<uint8_t>(x));
+            ASSERT_EQ(pixel[1], static_cast<uint8_t>(y));
+            ASSERT_EQ(pixel[2], static_cast<uint8_t>(x ^ y));
+        }
+}
+
+TEST_F(ProbeDaemonTests, ClientFallsBackAndReconnects) {
+    DaemonClient client(endpoint_);
+    double duration = 0.0;
+    EXPECT_EQ(client.Duration(natives_[0].c_str(), &duration), DaemonReply::Unavailable);
+    EXPECT_EQ(client.Stats().fallbacks, 1u);
+
+    {
+        DaemonServer server(Options());
+        ASSERT_TRUE(server.Start());
+        // A second daemon cannot take the endpoint of a live one
+        DaemonServer second(Options());
+        EXPECT_FALSE(second.Start());
+
+        // The failed attempt holds off retries; pointing the client again clears that
+        EXPECT_EQ(client.Duration(natives_[0].c_str(), &duration), DaemonReply::Unavailable);
+        client.SetEndpoint(endpoint_);
+        EXPECT_EQ(client.Duration(natives_[1].c_str(), &duration), DaemonReply::Ok);
+        EXPECT_DOUBLE_EQ(duration, 2000.0);
+    }
+
+    // The daemon went away: the next call finds the connection dropped and runs locally
+    EXPECT_EQ(client.Duration(natives_[0].c_str(), &duration), DaemonReply::Unavailable);
+    EXPECT_EQ(client.Stats().daemon_pid, 0u);
+
+    // A restarted daemon binds over the socket file the old one left, and the client comes back
+    DaemonServer restarted(Options());
+    ASSERT_TRUE(restarted.Start());
+    client.SetEndpoint(endpoint_);
+    EXPECT_EQ(client.Duration(natives_[2].c_str(), &duration), DaemonReply::Ok);
+    EXPECT_EQ(client.Stats().reconnects, 2u);
+}
+
+TEST_F(ProbeDaemonTests, ClientGivesUpOnADaemonThatDoesNotAnswer) {
+    // Accepts and reads nothing, like a daemon wedged on a hung mount
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    ASSERT_GE(listener, 0);
+    sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    std::strncpy(address.sun_path, endpoint_.c_str(), sizeof(address.sun_path) - 1);
+    ASSERT_EQ(bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)), 0);
+    ASSERT_EQ(listen(listener, 4), 0);
+    std::atomic<int> accepted{0};
+    std::thread acceptor([&] {
+        const int connection = accept(listener, nullptr, nullptr);
+        if (connection >= 0) accepted++;
+        char byte;
+        while (connection >= 0 && read(connection, &byte, 1) > 0) {}
+        if (connection >= 0) close(connection);
+    });
+
+    DaemonClient client(endpoint_);
+    double duration = 0.0;
+    const auto start = std::chrono::steady_clock::now();
+    EXPECT_EQ(client.Duration(natives_[0].c_str(), &duration), DaemonReply::Unavailable);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::seconds(5));
+    EXPECT_EQ(accepted.load(), 1);
+
+    // Held off like a failed connect, rather than paying the timeout again
+    EXPECT_EQ(client.Duration(natives_[1].c_str(), &duration), DaemonReply::Unavailable);
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(3500));
+    EXPECT_EQ(client.Stats().fallbacks, 2u);
+    EXPECT_EQ(client.Stats().reconnects, 0u);
+
+    shutdown(listener, SHUT_RDWR);
+    close(listener);
+    acceptor.join();
+}
+
+TEST_F(ProbeDaemonTests, Export_CallsGoThroughTheDaemon) {
+    DaemonServer server(Options());
+    ASSERT_TRUE(server.Start());
+    daemon_set_endpoint(endpoint_.c_str());
+    // The daemon runs in this process, and its answers would land in the hot cache the client reads first
+    set_hot_cache_limits(0, 0);
+
+    const std::string utf8 = fs::path(natives_[5]).string();
+    const uint32_t id = path_arena_intern(utf8.data(), static_cast<uint32_t>(utf8.size()));
+    EXPECT_DOUBLE_EQ(get_video_duration_by_id(id), 6000.0);
+    double duration = 0.0;
+    ASSERT_EQ(get_video_duration_batch(&id, 1, &duration), 1u);
+    EXPECT_DOUBLE_EQ(duration, 6000.0);
+
+    uint32_t width = 0, height = 0;
+    const uint8_t* pixels = thumbnail_pixels_acquire(id, 64, &width, &height);
+    ASSERT_NE(pixels, nullptr);
+    EXPECT_EQ(width, 64u);
+    EXPECT_EQ(pixels[(size_t(3) * width + 9) * 4], 9);
+    EXPECT_TRUE(thumbnail_pixels_release(pixels));
+    EXPECT_FALSE(thumbnail_pixels_release(pixels));
+
+    DaemonClientStatus status;
+    daemon_get_status(&status);
+    EXPECT_EQ(status.connected, 1u);
+    EXPECT_GE(status.requests, 4u);
+    EXPECT_GE(server.Stats().requests, 4u);
+
+    // Off: everything runs in-process again, without a renderer on this platform
+    daemon_set_endpoint(PATH_LITERAL(""));
+    const uint64_t served = server.Stats().requests;
+    EXPECT_DOUBLE_EQ(get_video_duration_by_id(id), 6000.0);
+    EXPECT_EQ(server.Stats().requests, served);
+    daemon_get_status(&status);
+    EXPECT_EQ(status.connected, 0u);
+    set_hot_cache_limits(kHotCacheDefaultBudget, kHotCacheDefaultMaxAgeMs);
+}
+
+} // namespace test
+} // namespace video_data_utils
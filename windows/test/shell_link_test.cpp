@@ -0,0 +1,212 @@
+#include <gtest/gtest.h>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../path_arena.h"
+#include "../probe_cache.h"
+#include "../shell_link.h"
+#include "../video_data_exporter_api.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+// Builders for MS-SHLLINK files; only the fields the parser reads are filled in
+static std::string Le16(uint16_t value) {
+    return {static_cast<char>(value), static_cast<char>(value >> 8)};
+}
+
+static std::string Le32(uint32_t value) {
+    return Le16(static_cast<uint16_t>(value)) + Le16(static_cast<uint16_t>(value >> 16));
+}
+
+static std::string Utf16z(const std::u16string& text) {
+    std::string bytes;
+    for (char16_t c : text) bytes += Le16(c);
+    return bytes + Le16(0);
+}
+
+static std::string LinkHeader(uint32_t flags) {
+    std::string header = Le32(0x4C) + std::string("\x01\x14\x02\x00\x00\x00\x00\x00\xC0\x00\x00\x00\x00\x00\x00\x46", 16) + Le32(flags);
+    header.resize(0x4C, '\0');
+    return header;
+}
+
+// LinkTargetIDList: This PC, the volume, then one file entry item per name (with a v9 long-name extension)
+static std::string IdList(const std::string& volume, const std::vector<std::u16string>& names) {
+    std::string items = Le16(0x14) + "\x1F\x50" + std::string(16, '\x01');
+    std::string volumeItem = "\x2F" + volume + '\0';
+    volumeItem.resize(23, '\0');
+    items += Le16(static_cast<uint16_t>(2 + volumeItem.size())) + volumeItem;
+    for (size_t i = 0; i < names.size(); i++) {
+        std::string item = std::string(1, i + 1 < names.size() ? '\x31' : '\x32') + '\0' + Le32(0) + Le32(0) + Le16(0) + "SHORT~1" + '\0';
+        const uint16_t extensionOffset = static_cast<uint16_t>(2 + item.size());
+        std::string extension = Le16(0) + Le16(9) + Le32(0xBEEF0004) + Le32(0) + Le32(0) + Le16(0x2E) + std::string(2 + 8 + 8, '\0') +
+                                Le16(0) + Le32(0) + Le32(0) + Utf16z(names[i]) + Le16(extensionOffset);
+        extension.replace(0, 2, Le16(static_cast<uint16_t>(extension.size())));
+        item += extension;
+        items += Le16(static_cast<uint16_t>(2 + item.size())) + item;
+    }
+    items += Le16(0);
+    return Le16(static_cast<uint16_t>(items.size())) + items;
+}
+
+// LinkInfo with a LocalBasePath, in ANSI and, when unicode is set, UTF-16 too
+static std::string LocalLinkInfo(const std::string& base, bool unicode, const std::u16string& unicodeBase = u"") {
+    const uint32_t headerSize = unicode ? 0x24 : 0x1C;
+    const std::string volumeId = Le32(0x11) + Le32(3) + Le32(0) + Le32(0x10) + '\0';
+    const uint32_t volumeAt = headerSize;
+    const uint32_t baseAt = volumeAt + static_cast<uint32_t>(volumeId.size());
+    const uint32_t suffixAt = baseAt + static_cast<uint32_t>(base.size()) + 1;
+    std::string body = volumeId + base + '\0' + '\0';
+    std::string tail = Le32(volumeAt) + Le32(baseAt) + Le32(0) + Le32(suffixAt);
+    if (unicode) {
+        const uint32_t unicodeBaseAt = suffixAt + 1;
+        const std::string wide = Utf16z(unicodeBase);
+        tail += Le32(unicodeBaseAt) + Le32(unicodeBaseAt + static_cast<uint32_t>(wide.size()));
+        body += wide + Le16(0);
+    }
+    const std::string info = Le32(headerSize) + Le32(1) + tail + body;
+    return Le32(static_cast<uint32_t>(4 + info.size())) + info;
+}
+
+static std::string NetworkLinkInfo(const std::string& share, const std::string& suffix) {
+    const std::string network = Le32(0x14 + static_cast<uint32_t>(share.size()) + 1) + Le32(0) + Le32(0x14) + Le32(0) + Le32(0) + share + '\0';
+    const uint32_t networkAt = 0x1C;
+    const uint32_t suffixAt = networkAt + static_cast<uint32_t>(network.size());
+    const std::string info = Le32(0x1C) + Le32(2) + Le32(0) + Le32(0) + Le32(networkAt) + Le32(suffixAt) + network + suffix + '\0';
+    return Le32(static_cast<uint32_t>(4 + info.size())) + info;
+}
+
+static std::string RelativePathString(const std::u16string& relative) {
+    std::string bytes = Le16(static_cast<uint16_t>(relative.size()));
+    for (char16_t c : relative) bytes += Le16(c);
+    return bytes;
+}
+
+static ShellLinkTargets Parse(const std::string& bytes, const NativePath& linkPath = PATH_LITERAL("/links/a.lnk")) {
+    auto source = MakeMemorySource(reinterpret_cast<const uint8_t*>(bytes.data()), bytes.size());
+    ShellLinkTargets targets;
+    EXPECT_TRUE(ParseShellLink(*source, linkPath, &targets));
+    return targets;
+}
+
+TEST(ShellLinkTests, Parse_IdListUsesLongNames) {
+    const ShellLinkTargets targets = Parse(LinkHeader(0x1) + IdList("C:\\", {u"Videos", u"A Rather Long Folder Name", u"clip \u00E9.mp4"}));
+#ifdef _WIN32
+    EXPECT_EQ(targets.id_list, L"C:\\Videos\\A Rather Long Folder Name\\clip \u00E9.mp4");
+#else
+    EXPECT_EQ(targets.id_list, "C:\\Videos\\A Rather Long Folder Name\\clip \xC3\xA9.mp4");
+#endif
+    EXPECT_TRUE(targets.link_info.empty());
+    EXPECT_TRUE(targets.relative_path.empty());
+}
+
+TEST(ShellLinkTests, Parse_LinkInfoPrefersUnicode) {
+    EXPECT_EQ(Parse(LinkHeader(0x2) + LocalLinkInfo("C:\\Videos\\a.mp4", false)).link_info, PATH_LITERAL("C:\\Videos\\a.mp4"));
+    const ShellLinkTargets unicode = Parse(LinkHeader(0x2) + LocalLinkInfo("C:\\Videos\\?.mp4", true, u"C:\\Videos\\\u65E5.mp4"));
+#ifdef _WIN32
+    EXPECT_EQ(unicode.link_info, L"C:\\Videos\\\u65E5.mp4");
+#else
+    EXPECT_EQ(unicode.link_info, "C:\\Videos\\\xE6\x97\xA5.mp4");
+#endif
+    EXPECT_EQ(Parse(LinkHeader(0x2) + NetworkLinkInfo("\\\\server\\share", "Videos\\b.mkv")).link_info, PATH_LITERAL("\\\\server\\share\\Videos\\b.mkv"));
+}
+
+TEST(ShellLinkTests, Parse_RelativePathAgainstLinkFolder) {
+    // IsUnicode | HasName | HasRelativePath, with every optional block before StringData
+    const std::string bytes = LinkHeader(0x1 | 0x2 | 0x4 | 0x8 | 0x80) + IdList("D:\\", {u"x.mp4"}) + LocalLinkInfo("D:\\x.mp4", false) +
+                              RelativePathString(u"display name") + RelativePathString(u".\\..\\media\\.\\clip.mp4");
+#ifdef _WIN32
+    EXPECT_EQ(Parse(bytes, L"C:\\library\\links\\a.lnk").relative_path, L"C:\\library\\media\\clip.mp4");
+#else
+    EXPECT_EQ(Parse(bytes, "/library/links/a.lnk").relative_path, "/library/media/clip.mp4");
+#endif
+}
+
+TEST(ShellLinkTests, Parse_RejectsOtherFiles) {
+    ShellLinkTargets targets;
+    const std::string notLink = Ftyp() + Moov(1000.0);
+    EXPECT_FALSE(ParseShellLink(*MakeMemorySource(reinterpret_cast<const uint8_t*>(notLink.data()), notLink.size()), PATH_LITERAL("a.lnk"), &targets));
+
+    std::string truncated = LinkHeader(0x1) + IdList("C:\\", {u"Videos"});
+    truncated.resize(truncated.size() - 20);
+    EXPECT_FALSE(ParseShellLink(*MakeMemorySource(reinterpret_cast<const uint8_t*>(truncated.data()), truncated.size()), PATH_LITERAL("a.lnk"), &targets));
+
+    // A link to a virtual folder has nothing to resolve
+    const std::string virtualOnly = LinkHeader(0x1) + Le16(0x16) + Le16(0x14) + "\x1F\x50" + std::string(16, '\x02') + Le16(0);
+    EXPECT_FALSE(ParseShellLink(*MakeMemorySource(reinterpret_cast<const uint8_t*>(virtualOnly.data()), virtualOnly.size()), PATH_LITERAL("a.lnk"), &targets));
+}
+
+#ifndef _WIN32
+TEST(ShellLinkTests, Export_BatchReportsSourceExistenceAndLongTargets) {
+    const fs::path root = fs::temp_directory_path() / "test_vdu_shell_links";
+    fs::remove_all(root);
+    fs::create_directories(root / "links");
+    // A target far past MAX_PATH
+    fs::path deep = root / "media";
+    for (int i = 0; i < 6; i++) deep /= std::string(60, static_cast<char>('a' + i));
+    fs::create_directories(deep);
+    const fs::path longTarget = deep / "clip.mp4";
+    WriteFile(longTarget, "x");
+    WriteFile(root / "media" / "near.mp4", "x");
+
+    const std::vector<std::pair<std::string, std::string>> links = {
+        {"local.lnk", LinkHeader(0x2) + LocalLinkInfo(longTarget.string(), false)},
+        // LinkInfo points at a drive that is gone; the relative path still works
+        {"moved.lnk", LinkHeader(0x2 | 0x8 | 0x80) + LocalLinkInfo("E:\\old\\near.mp4", false) + RelativePathString(u"..\\media\\near.mp4")},
+        {"dangling.lnk", LinkHeader(0x1) + IdList("C:\\", {u"gone.mp4"})},
+        {"not_a_link.lnk", "plain text"},
+    };
+    std::vector<uint32_t> ids;
+    for (const auto& link : links) {
+        WriteFile(root / "links" / link.first, link.second);
+        const std::string utf8 = (root / "links" / link.first).string();
+        ids.push_back(path_arena_intern(utf8.data(), static_cast<uint32_t>(utf8.size())));
+        ProbeCache::Instance().Invalidate(ids.back());
+    }
+    ids.push_back(kInvalidPathId);
+
+    std::vector<ShortcutTarget> out(ids.size());
+    EXPECT_EQ(resolve_shortcuts_batch(ids.data(), static_cast<uint32_t>(ids.size()), out.data()), 3u);
+    EXPECT_EQ(out[0].source, 1);
+    EXPECT_EQ(out[0].target_exists, 1);
+    EXPECT_EQ(std::string(path_arena_get(out[0].target_id, nullptr)), longTarget.string());
+    EXPECT_EQ(out[1].source, 2);
+    EXPECT_EQ(out[1].target_exists, 1);
+    EXPECT_EQ(std::string(path_arena_get(out[1].target_id, nullptr)), (root / "media" / "near.mp4").string());
+    EXPECT_EQ(out[2].source, 3);
+    EXPECT_EQ(out[2].target_exists, 0);
+    EXPECT_EQ(out[3].target_id, kInvalidPathId);
+    EXPECT_EQ(out[3].source, 0);
+    EXPECT_EQ(out[4].target_id, kInvalidPathId);
+
+    // The parse is cached per link state, existence is not
+    ProbeEntry entry;
+    ASSERT_TRUE(ProbeCache::Instance().Lookup(ids[0], &entry));
+    const ShellLinkTargets* cached = entry.shortcut.get();
+    fs::remove(longTarget);
+    EXPECT_EQ(resolve_shortcuts_batch(ids.data(), 1, out.data()), 1u);
+    EXPECT_EQ(out[0].target_exists, 0);
+    ASSERT_TRUE(ProbeCache::Instance().Lookup(ids[0], &entry));
+    EXPECT_EQ(entry.shortcut.get(), cached);
+
+    // Rewriting the link is picked up through its mtime
+    const fs::path local = root / "links" / "local.lnk";
+    WriteFile(local, LinkHeader(0x2) + LocalLinkInfo((root / "media" / "near.mp4").string(), false));
+    fs::last_write_time(local, fs::last_write_time(local) + std::chrono::seconds(5));
+    uint32_t target = kInvalidPathId;
+    ASSERT_TRUE(resolve_shortcut_by_id(ids[0], &target));
+    EXPECT_EQ(target, out[1].target_id);
+    fs::remove_all(root);
+}
+#endif
+
+} // namespace test
+} // namespace video_data_utils
@@ -0,0 +1,216 @@
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "../path_arena.h"
+#include "../thumbnail_atlas.h"
+#include "../video_data_exporter_api.h"
+
+namespace video_data_utils {
+namespace test {
+
+// Renders width x height pixels of (x, y, render count of the path, 255); "fail" paths fail
+class CountingRenderer {
+public:
+    CountingRenderer(uint32_t width, uint32_t height) : width_(width), height_(height) {}
+
+    ThumbnailRenderer Render() {
+        return [this](const PathChar* path, uint32_t, PooledBuffer* bgra, uint32_t* width, uint32_t* height) {
+            const NativePath name(path);
+            if (name.find(PATH_LITERAL("fail")) != NativePath::npos) return false;
+            uint8_t seed;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                seed = static_cast<uint8_t>(++renders_[name]);
+            }
+            total_++;
+            *width = width_;
+            *height = height_;
+            bgra->resize(size_t(width_) * height_ * 4);
+            for (uint32_t y = 0; y < height_; y++)
+                for (uint32_t x = 0; x < width_; x++) {
+                    uint8_t* pixel = bgra->data() + (size_t(y) * width_ + x) * 4;
+                    pixel[0] = static_cast<uint8_t>(x);
+                    pixel[1] = static_cast<uint8_t>(y);
+                    pixel[2] = seed;
+                    pixel[3] = 255;
+                }
+            return true;
+        };
+    }
+
+    std::atomic<int> total_{0};
+
+private:
+    const uint32_t width_, height_;
+    std::mutex mutex_;
+    std::map<NativePath, int> renders_;
+};
+
+std::vector<uint32_t> Videos(const std::string& prefix, int count) {
+    std::vector<uint32_t> ids;
+    for (int i = 0; i < count; i++) {
+        const std::string path = "/atlas/" + prefix + std::to_string(i) + ".mkv";
+        ids.push_back(PathArena::Instance().InternUtf8(path.data(), static_cast<uint32_t>(path.size())));
+    }
+    return ids;
+}
+
+const uint8_t* PixelAt(const ThumbnailAtlas& atlas, uint32_t x, uint32_t y) {
+    return atlas.Pixels() + (size_t(y) * atlas.Width() + x) * 4;
+}
+
+TEST(ThumbnailAtlasTests, CellsRunRowByRowWithThumbnailsCentered) {
+    WorkerPool pool(2);
+    CountingRenderer renderer(64, 32);
+    ThumbnailAtlasStore store(pool, renderer.Render(), kThumbnailAtlasDefaultBudget);
+    std::vector<uint32_t> videos = Videos("grid", 4);
+    videos.push_back(Videos("fail", 1)[0]);
+
+    const int32_t handle = store.Build(videos.data(), 5, 64, 3);
+    ASSERT_GT(handle, 0);
+    const std::shared_ptr<ThumbnailAtlas> atlas = store.Find(handle);
+    EXPECT_EQ(atlas->Width(), 192u);
+    EXPECT_EQ(atlas->Height(), 128u);
+
+    const std::vector<ThumbnailAtlasCell> cells = atlas->Cells();
+    ASSERT_EQ(cells.size(), 5u);
+    // Item 4 (second row, first column): 64x32 centered vertically in its 64 px cell
+    EXPECT_EQ(cells[3].x, 0u);
+    EXPECT_EQ(cells[3].y, 64u + 16u);
+    EXPECT_EQ(cells[3].width, 64u);
+    EXPECT_EQ(cells[3].height, 32u);
+    EXPECT_TRUE(cells[3].ok);
+    EXPECT_EQ(PixelAt(*atlas, 5, 80 + 7)[0], 5);
+    EXPECT_EQ(PixelAt(*atlas, 5, 80 + 7)[1], 7);
+    EXPECT_EQ(PixelAt(*atlas, 5, 64 + 3)[3], 0); // letterbox
+    EXPECT_FALSE(cells[4].ok);
+    EXPECT_EQ(cells[4].width, 0u);
+    EXPECT_EQ(PixelAt(*atlas, 64 + 10, 64 + 30)[3], 0);
+    EXPECT_EQ(PixelAt(*atlas, 128 + 10, 64 + 30)[3], 0); // no item there
+
+    const ThumbnailAtlasStats stats = store.Stats();
+    EXPECT_EQ(stats.cells_rendered, 4u);
+    EXPECT_EQ(stats.cells_failed, 1u);
+    EXPECT_EQ(stats.bytes, 192u * 128u * 4u);
+}
+
+TEST(ThumbnailAtlasTests, LargerThumbnailsAreAveragedDownToFit) {
+    WorkerPool pool(1);
+    CountingRenderer renderer(128, 64);
+    ThumbnailAtlasStore store(pool, renderer.Render(), kThumbnailAtlasDefaultBudget);
+    const std::vector<uint32_t> videos = Videos("large", 1);
+
+    const std::shared_ptr<ThumbnailAtlas> atlas = store.Find(store.Build(videos.data(), 1, 32, 4));
+    ASSERT_TRUE(atlas);
+    const ThumbnailAtlasCell cell = atlas->Cells()[0];
+    EXPECT_EQ(cell.width, 32u);
+    EXPECT_EQ(cell.height, 16u);
+    EXPECT_EQ(cell.y, 8u);
+    // Output pixel (1, 1) averages source x 4..7 and y 4..7
+    EXPECT_EQ(PixelAt(*atlas, 1, 9)[0], 6);
+    EXPECT_EQ(PixelAt(*atlas, 1, 9)[1], 6);
+    EXPECT_EQ(PixelAt(*atlas, 1, 9)[3], 255);
+}
+
+TEST(ThumbnailAtlasTests, PagesAreCachedAndOverlapsCopied) {
+    WorkerPool pool(2);
+    CountingRenderer renderer(48, 48);
+    ThumbnailAtlasStore store(pool, renderer.Render(), 48 * 48 * 4 * 8);
+    const std::vector<uint32_t> videos = Videos("page", 12);
+
+    const int32_t first = store.Build(videos.data(), 8, 48, 4);
+    EXPECT_EQ(renderer.total_.load(), 8);
+    // The same page again: nothing rendered, the same pixels
+    const int32_t again = store.Build(videos.data(), 8, 48, 4);
+    EXPECT_EQ(renderer.total_.load(), 8);
+    EXPECT_EQ(store.Find(first), store.Find(again));
+
+    // Scrolled by four: four cells copied from the first page, four rendered
+    const int32_t next = store.Build(videos.data() + 4, 8, 48, 4);
+    EXPECT_EQ(renderer.total_.load(), 12);
+    EXPECT_EQ(std::memcmp(PixelAt(*store.Find(next), 0, 0), PixelAt(*store.Find(first), 0, 48), 48 * 4), 0);
+
+    ThumbnailAtlasStats stats = store.Stats();
+    EXPECT_EQ(stats.builds, 3u);
+    EXPECT_EQ(stats.reused, 1u);
+    EXPECT_EQ(stats.cells_copied, 4u);
+    EXPECT_EQ(stats.atlases, 2u);
+
+    // Closed pages stay within the budget, which holds one of them
+    EXPECT_TRUE(store.Close(first));
+    EXPECT_TRUE(store.Close(again));
+    EXPECT_FALSE(store.Close(again));
+    EXPECT_EQ(store.Stats().atlases, 2u);
+    const int32_t reopened = store.Build(videos.data(), 8, 48, 4);
+    EXPECT_EQ(renderer.total_.load(), 12);
+    EXPECT_TRUE(store.Close(reopened));
+    EXPECT_TRUE(store.Close(next));
+    EXPECT_EQ(store.Stats().atlases, 1u);
+    EXPECT_EQ(store.Stats().open_handles, 0u);
+    store.SetBudget(0);
+    EXPECT_EQ(store.Stats().atlases, 0u);
+}
+
+TEST(ThumbnailAtlasTests, RefreshRedrawsOnlyChangedCells) {
+    WorkerPool pool(2);
+    CountingRenderer renderer(32, 32);
+    ThumbnailAtlasStore store(pool, renderer.Render(), kThumbnailAtlasDefaultBudget);
+    const std::vector<uint32_t> videos = Videos("refresh", 6);
+
+    const int32_t handle = store.Build(videos.data(), 6, 32, 3);
+    const std::shared_ptr<ThumbnailAtlas> atlas = store.Find(handle);
+    const uint32_t version = atlas->Version();
+    EXPECT_EQ(store.Refresh(handle), 0u);
+
+    store.Invalidate(videos[4]);
+    EXPECT_TRUE(atlas->Cells()[4].dirty);
+    EXPECT_EQ(store.Refresh(handle), 1u);
+    EXPECT_EQ(renderer.total_.load(), 7);
+    EXPECT_EQ(atlas->Version(), version + 1);
+    EXPECT_FALSE(atlas->Cells()[4].dirty);
+    EXPECT_EQ(PixelAt(*atlas, 32 + 3, 32 + 3)[2], 2); // second render of item 5
+    EXPECT_EQ(PixelAt(*atlas, 3, 32 + 3)[2], 1);
+
+    // A page that includes a changed video renders it instead of copying the stale cell
+    store.Invalidate(videos[0]);
+    const int32_t other = store.Build(videos.data(), 2, 32, 2);
+    EXPECT_EQ(renderer.total_.load(), 8);
+    EXPECT_EQ(store.Stats().cells_copied, 1u);
+    EXPECT_EQ(store.Stats().cells_refreshed, 1u);
+    store.Close(other);
+    store.Close(handle);
+}
+
+TEST(ThumbnailAtlasTests, Export_RejectsBadArguments) {
+    const uint32_t video = Videos("export", 1)[0];
+    EXPECT_EQ(thumbnail_atlas_build(nullptr, 1, 64, 4), -1);
+    EXPECT_EQ(thumbnail_atlas_build(&video, 0, 64, 4), -1);
+    EXPECT_EQ(thumbnail_atlas_build(&video, 1, 0, 4), -1);
+    EXPECT_EQ(thumbnail_atlas_build(&video, 1, 64, 0), -1);
+    EXPECT_EQ(thumbnail_atlas_build(&video, 1, 1 << 20, 1), -1);
+    EXPECT_EQ(thumbnail_atlas_pixels(12345, nullptr, nullptr, nullptr), nullptr);
+    EXPECT_FALSE(thumbnail_atlas_close(12345));
+
+    // No renderer on this platform without a daemon: a transparent atlas of failed cells
+    daemon_set_endpoint(PATH_LITERAL(""));
+    const int32_t handle = thumbnail_atlas_build(&video, 1, 16, 4);
+    ASSERT_GT(handle, 0);
+    uint32_t width = 0, height = 0, version = 0;
+    ASSERT_NE(thumbnail_atlas_pixels(handle, &width, &height, &version), nullptr);
+    EXPECT_EQ(width, 16u);
+    EXPECT_EQ(height, 16u);
+    EXPECT_EQ(version, 1u);
+    ThumbnailAtlasCell cell;
+    EXPECT_EQ(thumbnail_atlas_cells(handle, &cell, 1), 1u);
+    EXPECT_EQ(cell.video_id, video);
+    EXPECT_EQ(thumbnail_atlas_refresh(handle), 0u);
+    EXPECT_TRUE(thumbnail_atlas_close(handle));
+}
+
+} // namespace test
+} // namespace video_data_utils
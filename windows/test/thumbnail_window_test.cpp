@@ -0,0 +1,251 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <mutex>
+#include <numeric>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../hot_cache.h"
+#include "../thumbnail_window.h"
+#include "../video_data_exporter_api.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+// Renders that record their order and can be held until the test lets them finish
+class FakeRenderer {
+public:
+    ThumbnailWindow::Render Render() {
+        return [this](uint32_t videoId, uint32_t, unsigned int) {
+            std::unique_lock<std::mutex> lock(mutex_);
+            started_.push_back(videoId);
+            running_++;
+            maxRunning_ = std::max(maxRunning_, running_);
+            changed_.notify_all();
+            changed_.wait(lock, [&] { return open_ || std::find(released_.begin(), released_.end(), videoId) != released_.end(); });
+            lock.unlock();
+            if (delay_.count() > 0) std::this_thread::sleep_for(delay_);
+            lock.lock();
+            running_--;
+            return true;
+        };
+    }
+
+    void Hold() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = false;
+    }
+    void Open() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        open_ = true;
+        changed_.notify_all();
+    }
+    void Release(uint32_t videoId) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        released_.push_back(videoId);
+        changed_.notify_all();
+    }
+    // Waits until @p count renders have started
+    void AwaitStarted(size_t count) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        changed_.wait(lock, [&] { return started_.size() >= count; });
+    }
+    std::vector<uint32_t> Started() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return started_;
+    }
+    int MaxRunning() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return maxRunning_;
+    }
+
+    std::chrono::milliseconds delay_{0};
+
+private:
+    std::mutex mutex_;
+    std::condition_variable changed_;
+    std::vector<uint32_t> started_;
+    std::vector<uint32_t> released_;
+    bool open_ = true;
+    int running_ = 0;
+    int maxRunning_ = 0;
+};
+
+// Items 1..count, with outputs 1001..
+struct Items {
+    explicit Items(uint32_t count) : videos(count), outputs(count) {
+        std::iota(videos.begin(), videos.end(), 1u);
+        std::iota(outputs.begin(), outputs.end(), 1001u);
+    }
+    std::vector<uint32_t> videos;
+    std::vector<uint32_t> outputs;
+};
+
+TEST(ThumbnailWindowTests, VisibleTilesFirstThenNearestPrefetchInScrollDirection) {
+    WorkerPool pool(1);
+    FakeRenderer renderer;
+    ThumbnailWindow window(pool, renderer.Render());
+    Items items(20);
+
+    // Items 6..8 on screen, 3..11 in the window
+    window.Set(items.videos.data(), items.outputs.data(), 20, 5, 3, 3, 128);
+    window.WaitIdle();
+    EXPECT_EQ(renderer.Started(), (std::vector<uint32_t>{6, 7, 8, 9, 5, 10, 4, 11, 3}));
+
+    const ThumbnailWindowStats stats = window.Stats();
+    EXPECT_EQ(stats.rendered, 9u);
+    EXPECT_EQ(stats.prefetched, 6u);
+    EXPECT_EQ(stats.visible_tiles, 3u);
+    EXPECT_EQ(stats.visible_blank, 3u);
+}
+
+TEST(ThumbnailWindowTests, MovingTheWindowPromotesAndCancels) {
+    WorkerPool pool(1);
+    FakeRenderer renderer;
+    ThumbnailWindow window(pool, renderer.Render());
+    Items items(100);
+
+    renderer.Hold();
+    window.Set(items.videos.data(), items.outputs.data(), 100, 0, 4, 4, 128);
+    renderer.AwaitStarted(1); // item 1, held
+
+    // Scrolled down: 7 and 8 were queued as prefetches and are now visible, 2 fell out
+    window.Set(items.videos.data(), items.outputs.data(), 100, 6, 4, 4, 128);
+    renderer.Open();
+    window.WaitIdle();
+
+    const std::vector<uint32_t> started = renderer.Started();
+    ASSERT_GE(started.size(), 5u);
+    EXPECT_EQ(std::vector<uint32_t>(started.begin(), started.begin() + 5), (std::vector<uint32_t>{1, 7, 8, 9, 10}));
+    EXPECT_EQ(std::count(started.begin(), started.end(), 2u), 0);
+
+    const ThumbnailWindowStats stats = window.Stats();
+    EXPECT_EQ(stats.windows, 2u);
+    EXPECT_EQ(stats.promoted, 2u);
+    EXPECT_EQ(stats.canceled, 1u);
+
+    // The held render of item 1 finished after it left the window, and is still reported
+    ThumbnailTileRecord records[32];
+    const uint32_t polled = window.Poll(records, 32, 0);
+    ASSERT_GT(polled, 0u);
+    EXPECT_EQ(records[0].video_id, 1u);
+    EXPECT_EQ(records[0].output_id, 1001u);
+    EXPECT_TRUE(records[0].ok);
+    EXPECT_FALSE(records[0].visible);
+}
+
+TEST(ThumbnailWindowTests, PrefetchesLeaveWorkersForVisibleTiles) {
+    WorkerPool pool(4);
+    FakeRenderer renderer;
+    ThumbnailWindow window(pool, renderer.Render());
+    Items items(100);
+
+    renderer.Hold();
+    // Nothing on screen yet: only prefetches, which may take two of the four workers
+    window.Set(items.videos.data(), items.outputs.data(), 100, 50, 0, 10, 128);
+    renderer.AwaitStarted(2);
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    EXPECT_EQ(renderer.Started().size(), 2u);
+
+    // A tile far from the prefetches appears and starts while they are still held
+    window.Set(items.videos.data(), items.outputs.data(), 100, 80, 1, 0, 128);
+    renderer.Release(81);
+    renderer.AwaitStarted(3);
+    EXPECT_EQ(renderer.Started()[2], 81u);
+
+    renderer.Open();
+    window.WaitIdle();
+    EXPECT_LE(renderer.MaxRunning(), 3);
+    EXPECT_GE(window.Stats().canceled, 1u);
+}
+
+TEST(ThumbnailWindowTests, ReportsTimeToVisible) {
+    WorkerPool pool(1);
+    FakeRenderer renderer;
+    renderer.delay_ = std::chrono::milliseconds(10);
+    ThumbnailWindow window(pool, renderer.Render());
+    Items items(40);
+
+    window.Set(items.videos.data(), items.outputs.data(), 40, 0, 2, 4, 128);
+    window.WaitIdle();
+    // Scrolled onto prefetched items 3..6: shown at once
+    window.Set(items.videos.data(), items.outputs.data(), 40, 2, 4, 4, 128);
+    window.WaitIdle();
+
+    ThumbnailTileRecord records[32];
+    uint32_t polled = window.Poll(records, 32, 0);
+    ASSERT_EQ(polled, 10u);
+    EXPECT_TRUE(records[0].visible);
+    EXPECT_GE(records[0].wait_ms, 10.0f);
+    EXPECT_GE(records[1].wait_ms, 20.0f);
+    EXPECT_FALSE(records[2].visible);
+    EXPECT_EQ(records[2].wait_ms, 0.0f);
+
+    const ThumbnailWindowStats stats = window.Stats();
+    EXPECT_EQ(stats.visible_tiles, 6u); // 1, 2, then 3..6 already rendered
+    EXPECT_EQ(stats.visible_blank, 2u);
+    EXPECT_EQ(stats.time_to_visible_p50_ms, 0.0f);
+    EXPECT_GE(stats.time_to_visible_max_ms, 20.0f);
+
+    window.ResetStats();
+    EXPECT_EQ(window.Stats().visible_tiles, 0u);
+}
+
+TEST(ThumbnailWindowTests, Export_ExistingThumbnailsAreReadyAndCached) {
+    const fs::path dir = fs::temp_directory_path() / "test_vdu_thumbnail_window";
+    fs::remove_all(dir);
+    fs::create_directories(dir);
+    daemon_set_endpoint(PATH_LITERAL(""));
+    clear_hot_cache();
+
+    std::vector<uint32_t> videos, outputs;
+    for (int i = 0; i < 6; i++) {
+        const fs::path video = dir / ("clip" + std::to_string(i) + ".mkv");
+        const fs::path output = dir / ("clip" + std::to_string(i) + ".png");
+        WriteFile(video, Mkv(1000.0));
+        // Rendered earlier for the even ones; this platform has no renderer for the others
+        if (i % 2 == 0) WriteFile(output, std::string("png ") + std::to_string(i));
+        videos.push_back(path_arena_intern(video.string().data(), static_cast<uint32_t>(video.string().size())));
+        outputs.push_back(path_arena_intern(output.string().data(), static_cast<uint32_t>(output.string().size())));
+    }
+    reset_thumbnail_window_stats();
+    ASSERT_TRUE(set_thumbnail_window(videos.data(), outputs.data(), 6, 0, 2, 4, 96));
+
+    std::vector<ThumbnailTileRecord> records;
+    ThumbnailTileRecord batch[8];
+    while (records.size() < 6) {
+        const uint32_t polled = thumbnail_window_poll(batch, 8, 2000);
+        ASSERT_GT(polled, 0u);
+        records.insert(records.end(), batch, batch + polled);
+    }
+    for (const ThumbnailTileRecord& record : records) {
+        const size_t i = std::find(videos.begin(), videos.end(), record.video_id) - videos.begin();
+        ASSERT_LT(i, videos.size());
+        EXPECT_EQ(record.output_id, outputs[i]);
+        EXPECT_EQ(record.ok, i % 2 == 0) << i;
+    }
+
+    // The bytes were loaded on the way
+    fs::remove_all(dir);
+    EXPECT_EQ(get_thumbnail_bytes_by_id(videos[2], outputs[2], 96, nullptr, 0), 5u);
+
+    ThumbnailWindowStats stats;
+    get_thumbnail_window_stats(&stats);
+    EXPECT_EQ(stats.rendered, 3u);
+    EXPECT_EQ(stats.failed, 3u);
+    EXPECT_TRUE(set_thumbnail_window(nullptr, nullptr, 0, 0, 0, 0, 96));
+    EXPECT_FALSE(set_thumbnail_window(nullptr, nullptr, 4, 0, 2, 0, 96));
+    clear_hot_cache();
+}
+
+} // namespace test
+} // namespace video_data_utils
@@ -0,0 +1,183 @@
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+#include "../path_arena.h"
+#include "../tree_summary.h"
+#include "../video_data_exporter_api.h"
+#include "media_fixtures.h"
+
+namespace fs = std::filesystem;
+
+namespace video_data_utils {
+namespace test {
+
+using namespace fixtures;
+
+class TreeSummaryTests : public ::testing::Test {
+protected:
+    void SetUp() override {
+        root_ = fs::temp_directory_path() / "test_vdu_tree_summary";
+        fs::remove_all(root_);
+        // 3 x 3 directories two levels deep, four files in each
+        for (const char* a : {"a", "b", "c"})
+            for (const char* b : {"x", "y", "z"}) {
+                const fs::path dir = root_ / a / b;
+                fs::create_directories(dir);
+                for (int i = 0; i < 4; i++) WriteFile(dir / ("clip" + std::to_string(i) + ".mkv"), std::string(100 + i, 'v'));
+            }
+        Age();
+    }
+    void TearDown() override { fs::remove_all(root_); }
+
+    // Directory mtimes an hour back, as in a library that was not touched since the last scan
+    void Age() {
+        const auto past = fs::file_time_type::clock::now() - std::chrono::hours(1);
+        fs::last_write_time(root_, past);
+        for (const auto& entry : fs::recursive_directory_iterator(root_))
+            if (entry.is_directory()) fs::last_write_time(entry.path(), past);
+    }
+
+    TreeSummary Scan(const TreeSummary* previous, TreeScanStats* stats, bool trust = true) {
+        TreeSummary summary;
+        EXPECT_TRUE(ScanTree(root_.native(), previous, trust, &summary, stats));
+        return summary;
+    }
+
+    std::vector<std::pair<FsChangeKind, std::string>> Diff(const TreeSummary& before, const TreeSummary& after) {
+        std::vector<std::pair<FsChangeKind, std::string>> changes;
+        DiffTrees(before, after, [&](FsChange&& change) {
+            changes.emplace_back(change.kind, fs::relative(fs::path(change.path), root_).generic_string());
+        });
+        std::sort(changes.begin(), changes.end());
+        return changes;
+    }
+
+    fs::path root_;
+};
+
+TEST_F(TreeSummaryTests, FirstScanAddsEverythingAndSummaryRoundTrips) {
+    TreeScanStats stats;
+    const TreeSummary first = Scan(nullptr, &stats);
+    EXPECT_EQ(stats.directories, 13u);
+    EXPECT_EQ(stats.directories_listed, 13u);
+    EXPECT_EQ(stats.files, 36u);
+
+    TreeSummary empty;
+    empty.root = root_.native();
+    EXPECT_EQ(Diff(empty, first).size(), 36u + 12u); // files and the directories below the root
+
+    const NativePath file = (root_.parent_path() / "test_vdu_tree_summary.state").native();
+    ASSERT_TRUE(SaveTreeSummary(file, first));
+    TreeSummary loaded;
+    ASSERT_TRUE(LoadTreeSummary(file, &loaded));
+    EXPECT_EQ(loaded.root, first.root);
+    EXPECT_EQ(loaded.scanned_at_ns, first.scanned_at_ns);
+    EXPECT_EQ(loaded.tree.hash, first.tree.hash);
+    EXPECT_TRUE(Diff(first, loaded).empty());
+
+    // Truncated or foreign files are rejected whole
+    fs::resize_file(file, fs::file_size(file) - 5);
+    EXPECT_FALSE(LoadTreeSummary(file, &loaded));
+    WriteFile(file, "not a summary");
+    EXPECT_FALSE(LoadTreeSummary(file, &loaded));
+    fs::remove(file);
+}
+
+TEST_F(TreeSummaryTests, UntouchedDirectoriesAreNotListed) {
+    TreeScanStats stats;
+    const TreeSummary first = Scan(nullptr, &stats);
+    const TreeSummary second = Scan(&first, &stats);
+    EXPECT_EQ(stats.directories, 13u);
+    EXPECT_EQ(stats.directories_listed, 0u);
+    EXPECT_EQ(stats.file_stats, 0u);
+    EXPECT_EQ(stats.files, 36u);
+    EXPECT_EQ(second.tree.hash, first.tree.hash);
+    EXPECT_TRUE(Diff(first, second).empty());
+}
+
+TEST_F(TreeSummaryTests, SparseChangesListOnlyTheirDirectories) {
+    TreeScanStats stats;
+    const TreeSummary first = Scan(nullptr, &stats);
+
+    WriteFile(root_ / "a" / "x" / "new.mkv", "new");
+    fs::remove(root_ / "b" / "y" / "clip0.mkv");
+    fs::remove_all(root_ / "c" / "z");
+    fs::create_directories(root_ / "c" / "w");
+    WriteFile(root_ / "c" / "w" / "moved.mkv", "moved");
+    WriteFile(root_ / "b" / "x" / "clip1.mkv", "rewritten in place"); // leaves b/x's mtime alone
+
+    const TreeSummary second = Scan(&first, &stats);
+    EXPECT_EQ(stats.directories_listed, 4u); // a/x, b/y, c and the new c/w
+    EXPECT_NE(second.tree.hash, first.tree.hash);
+    const std::vector<std::pair<FsChangeKind, std::string>> expected = {
+        {FsChangeKind::Added, "a/x/new.mkv"},  {FsChangeKind::Added, "c/w"},   {FsChangeKind::Added, "c/w/moved.mkv"},
+        {FsChangeKind::Removed, "b/y/clip0.mkv"}, {FsChangeKind::Removed, "c/z"},
+    };
+    EXPECT_EQ(Diff(first, second), expected);
+
+    // Statting every file catches the write that moved no directory mtime
+    const TreeSummary verified = Scan(&first, &stats, false);
+    EXPECT_EQ(stats.directories_listed, 13u);
+    const auto changes = Diff(first, verified);
+    EXPECT_NE(std::find(changes.begin(), changes.end(), std::make_pair(FsChangeKind::Modified, std::string("b/x/clip1.mkv"))),
+              changes.end());
+    EXPECT_EQ(changes.size(), expected.size() + 1);
+}
+
+TEST_F(TreeSummaryTests, CancelledScanIsNotUsable) {
+    const std::atomic<bool> cancel{true};
+    TreeSummary summary;
+    TreeScanStats stats;
+    EXPECT_FALSE(ScanTree(root_.native(), nullptr, true, &summary, &stats, &cancel));
+    EXPECT_EQ(stats.directories, 1u); // the root, and nothing below it
+}
+
+TEST_F(TreeSummaryTests, Export_RescanStreamsChangesAndSavesSummary) {
+    const std::string utf8 = root_.string();
+    const uint32_t rootId = path_arena_intern(utf8.data(), static_cast<uint32_t>(utf8.size()));
+    const fs::path state = root_.parent_path() / "test_vdu_tree_summary.rescan";
+    fs::remove(state);
+
+    auto run = [&](std::vector<FsChangeRecord>* records) {
+        const int32_t handle = rescan_start(rootId, state.c_str(), false);
+        EXPECT_GT(handle, 0);
+        FsChangeRecord batch[16];
+        RescanStats stats = {};
+        for (;;) {
+            const uint32_t n = rescan_poll(handle, batch, 16, 1000);
+            records->insert(records->end(), batch, batch + n);
+            EXPECT_TRUE(rescan_stats(handle, &stats));
+            if (n == 0 && stats.finished) break;
+        }
+        EXPECT_TRUE(rescan_close(handle));
+        EXPECT_FALSE(rescan_close(handle));
+        return stats;
+    };
+
+    std::vector<FsChangeRecord> records;
+    RescanStats stats = run(&records);
+    EXPECT_EQ(stats.from_summary, 0u);
+    EXPECT_EQ(stats.summary_saved, 1u);
+    EXPECT_EQ(stats.added, 48u);
+    EXPECT_EQ(records.size(), 48u);
+
+    WriteFile(root_ / "a" / "y" / "late.mkv", "late");
+    records.clear();
+    stats = run(&records);
+    EXPECT_EQ(stats.from_summary, 1u);
+    EXPECT_EQ(stats.directories_listed, 1u);
+    ASSERT_EQ(records.size(), 1u);
+    EXPECT_EQ(records[0].kind, static_cast<uint8_t>(FsChangeKind::Added));
+    EXPECT_EQ(fs::path(path_arena_get(records[0].path_id, nullptr)), root_ / "a" / "y" / "late.mkv");
+
+    EXPECT_EQ(rescan_start(rootId, nullptr, false), -1);
+    fs::remove(state);
+}
+
+} // namespace test
+} // namespace video_data_utils
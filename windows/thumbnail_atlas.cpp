@@ -0,0 +1,442 @@
+#include "thumbnail_atlas.h"
+#include "path_arena.h"
+#include "probe_cache.h"
+#include "scratch_arena.h"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <iostream>
+
+namespace
+{
+    // Larger atlases are refused rather than allocated; a grid page is a few tens of MiB at most
+    constexpr uint64_t kMaxAtlasBytes = 512ull << 20;
+
+    // Box filter: each output pixel averages the source pixels it covers. The rows of a band are
+    // summed column by column first, in order, so the source is read once and sequentially.
+    void Downscale(const uint8_t *src, uint32_t srcWidth, uint32_t srcHeight, uint32_t srcStride, uint8_t *dst, uint32_t dstWidth,
+                   uint32_t dstHeight, uint32_t dstStride)
+    {
+        ScratchArena::Scope scope;
+        const size_t columnCount = size_t(srcWidth) * 4;
+        uint32_t *columns = static_cast<uint32_t *>(ScratchArena::ForThread().Allocate(columnCount * sizeof(uint32_t)));
+        uint32_t *spans = static_cast<uint32_t *>(ScratchArena::ForThread().Allocate((dstWidth + 1) * sizeof(uint32_t)));
+        for (uint32_t x = 0; x <= dstWidth; x++) spans[x] = static_cast<uint32_t>(uint64_t(x) * srcWidth / dstWidth);
+        for (uint32_t y = 0; y < dstHeight; y++)
+        {
+            const uint32_t y0 = static_cast<uint32_t>(uint64_t(y) * srcHeight / dstHeight);
+            const uint32_t y1 = std::max<uint32_t>(y0 + 1, static_cast<uint32_t>(uint64_t(y + 1) * srcHeight / dstHeight));
+            std::fill(columns, columns + columnCount, 0u);
+            for (uint32_t sy = y0; sy < y1; sy++)
+            {
+                const uint8_t *row = src + size_t(sy) * srcStride;
+                for (size_t i = 0; i < columnCount; i++) columns[i] += row[i];
+            }
+
+            uint8_t *out = dst + size_t(y) * dstStride;
+            for (uint32_t x = 0; x < dstWidth; x++)
+            {
+                const uint32_t x0 = spans[x];
+                const uint32_t x1 = std::max(x0 + 1, spans[x + 1]);
+                uint32_t sum[4] = {0, 0, 0, 0};
+                for (uint32_t sx = x0; sx < x1; sx++)
+                    for (int c = 0; c < 4; c++) sum[c] += columns[size_t(sx) * 4 + c];
+                const uint32_t count = (y1 - y0) * (x1 - x0);
+                for (int c = 0; c < 4; c++) out[size_t(x) * 4 + c] = static_cast<uint8_t>((sum[c] + count / 2) / count);
+            }
+        }
+    }
+
+    // The daemon's renderer when one is running, this process's otherwise
+    bool RenderThumbnail(const PathChar *path, uint32_t size, PooledBuffer *bgra, uint32_t *width, uint32_t *height)
+    {
+        std::unique_ptr<SharedPixels> shared;
+        const DaemonReply remote = DaemonClient::Instance().ThumbnailPixels(path, size, &shared, width, height);
+        if (remote == DaemonReply::Ok)
+        {
+            bgra->resize(size_t(*width) * *height * 4);
+            std::memcpy(bgra->data(), shared->data(), bgra->size());
+            return true;
+        }
+        if (remote == DaemonReply::Failed) return false;
+        static const ThumbnailRenderer local = DefaultThumbnailRenderer();
+        return local && local(path, size, bgra, width, height);
+    }
+}
+
+// === ThumbnailAtlas ===
+
+ThumbnailAtlas::ThumbnailAtlas(std::vector<uint32_t> videoIds, uint32_t cellSize, uint32_t columns)
+    : videoIds_(std::move(videoIds)), cellSize_(cellSize), columns_(columns),
+      width_(static_cast<uint32_t>(std::min<size_t>(columns, videoIds_.size())) * cellSize),
+      height_(static_cast<uint32_t>((videoIds_.size() + columns - 1) / columns) * cellSize),
+      pixels_(BufferPool::Pixels().Acquire(size_t(width_) * height_ * 4)), cells_(videoIds_.size())
+{
+    // Pooled memory is recycled; the empty cells of the last row must still be transparent
+    std::memset(pixels_.data(), 0, pixels_.size());
+    for (size_t i = 0; i < cells_.size(); i++)
+    {
+        cells_[i].video_id = videoIds_[i];
+        cells_[i].x = static_cast<uint32_t>(i % columns_) * cellSize_;
+        cells_[i].y = static_cast<uint32_t>(i / columns_) * cellSize_;
+    }
+}
+
+uint32_t ThumbnailAtlas::Version() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return version_;
+}
+
+std::vector<ThumbnailAtlasCell> ThumbnailAtlas::Cells() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return cells_;
+}
+
+uint8_t *ThumbnailAtlas::CellOrigin(size_t index)
+{
+    return pixels_.data() + (size_t(index / columns_) * cellSize_ * width_ + size_t(index % columns_) * cellSize_) * 4;
+}
+
+void ThumbnailAtlas::ClearCell(size_t index)
+{
+    uint8_t *origin = CellOrigin(index);
+    for (uint32_t y = 0; y < cellSize_; y++) std::memset(origin + size_t(y) * width_ * 4, 0, size_t(cellSize_) * 4);
+}
+
+void ThumbnailAtlas::Draw(size_t index, const uint8_t *bgra, uint32_t width, uint32_t height, uint32_t stride)
+{
+    if (index >= cells_.size() || width == 0 || height == 0)
+    {
+        Fail(index);
+        return;
+    }
+    // Fitted to the cell, keeping the aspect ratio
+    uint32_t fitWidth = width, fitHeight = height;
+    if (width > cellSize_ || height > cellSize_)
+    {
+        const uint32_t longest = std::max(width, height);
+        fitWidth = std::max<uint32_t>(1, static_cast<uint32_t>(uint64_t(width) * cellSize_ / longest));
+        fitHeight = std::max<uint32_t>(1, static_cast<uint32_t>(uint64_t(height) * cellSize_ / longest));
+    }
+    const uint32_t left = (cellSize_ - fitWidth) / 2;
+    const uint32_t top = (cellSize_ - fitHeight) / 2;
+
+    // Filtered into a scratch tile first, so only the copy into the page holds the lock
+    ScratchArena::Scope scope;
+    const uint8_t *tile = bgra;
+    uint32_t tileStride = stride;
+    if (fitWidth != width || fitHeight != height)
+    {
+        tileStride = fitWidth * 4;
+        uint8_t *scaled = static_cast<uint8_t *>(ScratchArena::ForThread().Allocate(size_t(tileStride) * fitHeight));
+        Downscale(bgra, width, height, stride, scaled, fitWidth, fitHeight, tileStride);
+        tile = scaled;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    ClearCell(index);
+    uint8_t *origin = CellOrigin(index) + (size_t(top) * width_ + left) * 4;
+    for (uint32_t y = 0; y < fitHeight; y++)
+        std::memcpy(origin + size_t(y) * width_ * 4, tile + size_t(y) * tileStride, size_t(fitWidth) * 4);
+    ThumbnailAtlasCell &cell = cells_[index];
+    cell.x = static_cast<uint32_t>(index % columns_) * cellSize_ + left;
+    cell.y = static_cast<uint32_t>(index / columns_) * cellSize_ + top;
+    cell.width = static_cast<uint16_t>(fitWidth);
+    cell.height = static_cast<uint16_t>(fitHeight);
+    cell.ok = 1;
+}
+
+void ThumbnailAtlas::Fail(size_t index)
+{
+    if (index >= cells_.size()) return;
+    std::lock_guard<std::mutex> lock(mutex_);
+    ClearCell(index);
+    ThumbnailAtlasCell &cell = cells_[index];
+    cell.x = static_cast<uint32_t>(index % columns_) * cellSize_;
+    cell.y = static_cast<uint32_t>(index / columns_) * cellSize_;
+    cell.width = cell.height = 0;
+    cell.ok = 0;
+}
+
+void ThumbnailAtlas::Copy(size_t index, const ThumbnailAtlas &source, size_t from)
+{
+    std::scoped_lock lock(mutex_, source.mutex_);
+    const uint8_t *in = source.pixels_.data() +
+                        (size_t(from / source.columns_) * cellSize_ * source.width_ + size_t(from % source.columns_) * cellSize_) * 4;
+    uint8_t *out = CellOrigin(index);
+    for (uint32_t y = 0; y < cellSize_; y++)
+        std::memcpy(out + size_t(y) * width_ * 4, in + size_t(y) * source.width_ * 4, size_t(cellSize_) * 4);
+
+    const ThumbnailAtlasCell &donor = source.cells_[from];
+    ThumbnailAtlasCell &cell = cells_[index];
+    cell.x = static_cast<uint32_t>(index % columns_) * cellSize_ + (donor.x - static_cast<uint32_t>(from % source.columns_) * cellSize_);
+    cell.y = static_cast<uint32_t>(index / columns_) * cellSize_ + (donor.y - static_cast<uint32_t>(from / source.columns_) * cellSize_);
+    cell.width = donor.width;
+    cell.height = donor.height;
+    cell.ok = donor.ok;
+}
+
+bool ThumbnailAtlas::MarkDirty(uint32_t videoId)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    bool marked = false;
+    for (ThumbnailAtlasCell &cell : cells_)
+    {
+        if (cell.video_id != videoId) continue;
+        cell.dirty = 1;
+        marked = true;
+    }
+    return marked;
+}
+
+std::vector<size_t> ThumbnailAtlas::TakeDirty()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<size_t> dirty;
+    for (size_t i = 0; i < cells_.size(); i++)
+    {
+        if (!cells_[i].dirty) continue;
+        cells_[i].dirty = 0;
+        dirty.push_back(i);
+    }
+    return dirty;
+}
+
+void ThumbnailAtlas::BumpVersion()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    version_++;
+}
+
+// === ThumbnailAtlasStore ===
+
+ThumbnailAtlasStore &ThumbnailAtlasStore::Instance()
+{
+    static ThumbnailAtlasStore &store = []() -> ThumbnailAtlasStore & {
+        // Constructed first, so cached atlases give their pixels back before the pool and budget are destroyed
+        BufferPool::Pixels();
+        MemoryBudget::Thumbnails();
+        static ThumbnailAtlasStore instance(WorkerPool::Instance(), RenderThumbnail, kThumbnailAtlasDefaultBudget);
+        return instance;
+    }();
+    return store;
+}
+
+ThumbnailAtlasStore::ThumbnailAtlasStore(WorkerPool &pool, ThumbnailRenderer render, uint64_t budgetBytes)
+    : pool_(pool), render_(std::move(render)), budget_(budgetBytes)
+{
+}
+
+size_t ThumbnailAtlasStore::KeyHash::operator()(const Key &key) const
+{
+    uint64_t h = (uint64_t(key.cellSize) << 32 | key.columns) * 0x9E3779B97F4A7C15ULL;
+    for (const uint32_t id : key.videoIds) h = (h ^ id) * 0x100000001B3ULL;
+    return static_cast<size_t>(h ^ (h >> 29));
+}
+
+ThumbnailAtlasStore::Key ThumbnailAtlasStore::KeyOf(const ThumbnailAtlas &atlas)
+{
+    return Key{atlas.CellSize(), atlas.Columns(), atlas.VideoIds()};
+}
+
+void ThumbnailAtlasStore::DrawCells(ThumbnailAtlas &atlas, const std::vector<size_t> &cells, bool refresh)
+{
+    // Clean cells of the same videos at the same cell size; a refresh is for changed videos, so it renders
+    std::unordered_map<uint32_t, Donor> donors;
+    if (!refresh)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto &cached : atlases_)
+        {
+            const std::shared_ptr<ThumbnailAtlas> &source = cached.second.atlas;
+            if (source->CellSize() != atlas.CellSize()) continue;
+            const std::vector<ThumbnailAtlasCell> sourceCells = source->Cells();
+            for (size_t i = 0; i < sourceCells.size(); i++)
+                if (sourceCells[i].ok && !sourceCells[i].dirty) donors.emplace(sourceCells[i].video_id, Donor{source, i});
+        }
+    }
+
+    std::atomic<uint64_t> rendered{0}, copied{0}, failed{0};
+    pool_.ParallelFor(cells.size(), [&](size_t i) {
+        const size_t cell = cells[i];
+        const uint32_t videoId = atlas.VideoIds()[cell];
+        auto donor = donors.find(videoId);
+        if (donor != donors.end())
+        {
+            atlas.Copy(cell, *donor->second.atlas, donor->second.cell);
+            copied++;
+            return;
+        }
+
+        const PathChar *path = path_arena_get(videoId, nullptr);
+        PooledBuffer bgra = BufferPool::Pixels().Acquire(0);
+        uint32_t width = 0, height = 0;
+        bool ok = false;
+        if (path != nullptr && render_)
+        {
+            try
+            {
+                MemoryBudget::Lease lease = MemoryBudget::Thumbnails().Acquire(uint64_t(atlas.CellSize()) * atlas.CellSize() * 4);
+                ok = render_(path, atlas.CellSize(), &bgra, &width, &height);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "video_data_exporter | Failed to render atlas cell: " << e.what() << std::endl;
+            }
+        }
+        if (ok && bgra.size() >= size_t(width) * height * 4)
+        {
+            atlas.Draw(cell, bgra.data(), width, height, width * 4);
+            rendered++;
+        }
+        else
+        {
+            atlas.Fail(cell);
+            failed++;
+        }
+    });
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.cells_rendered += rendered;
+    stats_.cells_copied += copied;
+    stats_.cells_failed += failed;
+    if (refresh) stats_.cells_refreshed += cells.size();
+}
+
+int32_t ThumbnailAtlasStore::Build(const uint32_t *videoIds, uint32_t count, uint32_t cellSize, uint32_t columns)
+{
+    if (videoIds == nullptr || count == 0 || cellSize == 0 || cellSize > UINT16_MAX || columns == 0) return -1;
+    const uint64_t rows = (uint64_t(count) + columns - 1) / columns;
+    if (uint64_t(std::min(columns, count)) * cellSize * rows * cellSize * 4 > kMaxAtlasBytes) return -1;
+
+    Key key{cellSize, columns, std::vector<uint32_t>(videoIds, videoIds + count)};
+    std::shared_ptr<ThumbnailAtlas> atlas;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats_.builds++;
+        auto it = atlases_.find(key);
+        if (it != atlases_.end())
+        {
+            stats_.reused++;
+            atlas = it->second.atlas;
+        }
+    }
+
+    if (atlas)
+    {
+        // Cached, but videos may have changed since it was drawn
+        const std::vector<size_t> dirty = atlas->TakeDirty();
+        if (!dirty.empty())
+        {
+            DrawCells(*atlas, dirty, true);
+            atlas->BumpVersion();
+        }
+    }
+    else
+    {
+        // Drawn outside the lock; a concurrent build of the same page may draw it too, and the first one stored wins
+        auto built = std::make_shared<ThumbnailAtlas>(key.videoIds, cellSize, columns);
+        std::vector<size_t> cells(count);
+        for (size_t i = 0; i < cells.size(); i++) cells[i] = i;
+        DrawCells(*built, cells, false);
+        atlas = std::move(built);
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    Cached &cached = atlases_.try_emplace(std::move(key)).first->second;
+    if (!cached.atlas) cached.atlas = atlas;
+    cached.opens++;
+    cached.lastUsed = ++clock_;
+    const int32_t handle = nextHandle_++;
+    handles_.emplace(handle, cached.atlas);
+    return handle;
+}
+
+std::shared_ptr<ThumbnailAtlas> ThumbnailAtlasStore::Find(int32_t handle) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = handles_.find(handle);
+    return it != handles_.end() ? it->second : nullptr;
+}
+
+uint32_t ThumbnailAtlasStore::Refresh(int32_t handle)
+{
+    std::shared_ptr<ThumbnailAtlas> atlas = Find(handle);
+    if (!atlas) return 0;
+    const std::vector<size_t> dirty = atlas->TakeDirty();
+    if (dirty.empty()) return 0;
+    DrawCells(*atlas, dirty, true);
+    atlas->BumpVersion();
+    return static_cast<uint32_t>(dirty.size());
+}
+
+bool ThumbnailAtlasStore::Close(int32_t handle)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = handles_.find(handle);
+    if (it == handles_.end()) return false;
+    auto cached = atlases_.find(KeyOf(*it->second));
+    handles_.erase(it);
+    if (cached != atlases_.end() && cached->second.opens > 0)
+    {
+        cached->second.opens--;
+        cached->second.lastUsed = ++clock_;
+    }
+    TrimLocked();
+    return true;
+}
+
+void ThumbnailAtlasStore::TrimLocked()
+{
+    uint64_t closedBytes = 0;
+    for (const auto &cached : atlases_)
+        if (cached.second.opens == 0) closedBytes += cached.second.atlas->Bytes();
+    while (closedBytes > budget_)
+    {
+        auto oldest = atlases_.end();
+        for (auto it = atlases_.begin(); it != atlases_.end(); ++it)
+            if (it->second.opens == 0 && (oldest == atlases_.end() || it->second.lastUsed < oldest->second.lastUsed)) oldest = it;
+        closedBytes -= oldest->second.atlas->Bytes();
+        atlases_.erase(oldest);
+    }
+}
+
+void ThumbnailAtlasStore::Invalidate(uint32_t videoId)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &cached : atlases_) cached.second.atlas->MarkDirty(videoId);
+}
+
+void ThumbnailAtlasStore::InvalidateUnder(NativePathView directory)
+{
+    PathArena &arena = PathArena::Instance();
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto &cached : atlases_)
+    {
+        for (const uint32_t videoId : cached.second.atlas->VideoIds())
+        {
+            NativePathView path;
+            if (arena.Get(videoId, &path) && PathIsUnder(path, directory)) cached.second.atlas->MarkDirty(videoId);
+        }
+    }
+}
+
+void ThumbnailAtlasStore::SetBudget(uint64_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    budget_ = bytes;
+    TrimLocked();
+}
+
+ThumbnailAtlasStats ThumbnailAtlasStore::Stats() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    ThumbnailAtlasStats stats = stats_;
+    stats.atlases = atlases_.size();
+    stats.open_handles = handles_.size();
+    stats.budget_bytes = budget_;
+    for (const auto &cached : atlases_) stats.bytes += cached.second.atlas->Bytes();
+    return stats;
+}
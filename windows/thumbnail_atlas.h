@@ -0,0 +1,154 @@
+#ifndef THUMBNAIL_ATLAS_H
+#define THUMBNAIL_ATLAS_H
+
+#include "buffer_pool.h"
+#include "native_path.h"
+#include "probe_daemon.h"
+#include "video_data_exporter_api.h"
+#include "worker_pool.h"
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+constexpr uint64_t kThumbnailAtlasDefaultBudget = 64ull << 20;
+
+/**
+ * @brief Thumbnails drawn into the square cells of one BGRA image.
+ *
+ * Cells run row by row in item order. A thumbnail larger than its cell is
+ * area-averaged down to fit; each is centered in its cell over transparent
+ * pixels. Cells are drawn from several threads at once: each is filtered
+ * outside the atlas lock and only copied into its rectangle under it.
+ */
+class ThumbnailAtlas
+{
+public:
+    ThumbnailAtlas(std::vector<uint32_t> videoIds, uint32_t cellSize, uint32_t columns);
+
+    ThumbnailAtlas(const ThumbnailAtlas &) = delete;
+    ThumbnailAtlas &operator=(const ThumbnailAtlas &) = delete;
+
+    const std::vector<uint32_t> &VideoIds() const { return videoIds_; }
+    uint32_t CellSize() const { return cellSize_; }
+    uint32_t Columns() const { return columns_; }
+    uint32_t Width() const { return width_; }
+    uint32_t Height() const { return height_; }
+    uint64_t Bytes() const { return pixels_.size(); }
+    const uint8_t *Pixels() const { return pixels_.data(); }
+    uint32_t Version() const;
+    std::vector<ThumbnailAtlasCell> Cells() const;
+
+    // Draws top-down BGRA rows of @p width pixels into cell @p index.
+    void Draw(size_t index, const uint8_t *bgra, uint32_t width, uint32_t height, uint32_t stride);
+    // Clears cell @p index and marks it failed.
+    void Fail(size_t index);
+    // Copies cell @p from of @p source, another atlas with the same cell size, into cell @p index.
+    void Copy(size_t index, const ThumbnailAtlas &source, size_t from);
+
+    // Marks the cells of @p videoId dirty. Returns whether there were any.
+    bool MarkDirty(uint32_t videoId);
+    // The dirty cells, which are clean again from here on.
+    std::vector<size_t> TakeDirty();
+    void BumpVersion();
+
+private:
+    uint8_t *CellOrigin(size_t index);
+    void ClearCell(size_t index);
+
+    const std::vector<uint32_t> videoIds_;
+    const uint32_t cellSize_;
+    const uint32_t columns_;
+    const uint32_t width_;
+    const uint32_t height_;
+    PooledBuffer pixels_;
+
+    mutable std::mutex mutex_;
+    std::vector<ThumbnailAtlasCell> cells_;
+    uint32_t version_ = 1;
+};
+
+/**
+ * @brief The atlases behind the thumbnail_atlas_* handles, cached by cell size, columns and items.
+ *
+ * An atlas stays in memory while a handle is open, and after the last close
+ * until the closed ones exceed the byte budget, least recently used first.
+ * A build draws each cell from a clean cell of the same video in any cached
+ * atlas of the same cell size when there is one, and renders it otherwise.
+ */
+class ThumbnailAtlasStore
+{
+public:
+    static ThumbnailAtlasStore &Instance();
+
+    ThumbnailAtlasStore(WorkerPool &pool, ThumbnailRenderer render, uint64_t budgetBytes);
+
+    ThumbnailAtlasStore(const ThumbnailAtlasStore &) = delete;
+    ThumbnailAtlasStore &operator=(const ThumbnailAtlasStore &) = delete;
+
+    // Returns a handle > 0, or -1 for an empty or oversized atlas.
+    int32_t Build(const uint32_t *videoIds, uint32_t count, uint32_t cellSize, uint32_t columns);
+    std::shared_ptr<ThumbnailAtlas> Find(int32_t handle) const;
+    // Redraws the dirty cells of the atlas. Returns how many.
+    uint32_t Refresh(int32_t handle);
+    bool Close(int32_t handle);
+
+    void Invalidate(uint32_t videoId);
+    void InvalidateUnder(NativePathView directory);
+
+    void SetBudget(uint64_t bytes);
+    ThumbnailAtlasStats Stats() const;
+
+private:
+    struct Key
+    {
+        uint32_t cellSize;
+        uint32_t columns;
+        std::vector<uint32_t> videoIds;
+
+        bool operator==(const Key &other) const
+        {
+            return cellSize == other.cellSize && columns == other.columns && videoIds == other.videoIds;
+        }
+    };
+
+    struct KeyHash
+    {
+        size_t operator()(const Key &key) const;
+    };
+
+    struct Cached
+    {
+        std::shared_ptr<ThumbnailAtlas> atlas;
+        uint32_t opens = 0;
+        uint64_t lastUsed = 0;
+    };
+
+    // Where a cell can be copied from instead of rendered
+    struct Donor
+    {
+        std::shared_ptr<ThumbnailAtlas> atlas;
+        size_t cell;
+    };
+
+    static Key KeyOf(const ThumbnailAtlas &atlas);
+    // Copies or renders @p cells of @p atlas on the pool. Donors are looked up for a new atlas only.
+    void DrawCells(ThumbnailAtlas &atlas, const std::vector<size_t> &cells, bool refresh);
+    // Drops closed atlases, least recently used first, until they fit the budget. mutex_ is held.
+    void TrimLocked();
+
+    WorkerPool &pool_;
+    ThumbnailRenderer render_;
+
+    mutable std::mutex mutex_;
+    uint64_t budget_;
+    std::unordered_map<Key, Cached, KeyHash> atlases_;
+    std::map<int32_t, std::shared_ptr<ThumbnailAtlas>> handles_;
+    int32_t nextHandle_ = 1;
+    uint64_t clock_ = 0;
+    ThumbnailAtlasStats stats_ = {};
+};
+
+#endif // THUMBNAIL_ATLAS_H
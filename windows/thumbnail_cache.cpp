@@ -0,0 +1,100 @@
+#include "thumbnail_cache.h"
+#include "path_arena.h"
+#include "probe_cache.h"
+#include <filesystem>
+#include <system_error>
+
+ThumbnailCache &ThumbnailCache::Instance()
+{
+    static ThumbnailCache cache;
+    return cache;
+}
+
+void ThumbnailCache::Record(uint32_t videoId, uint32_t outputId, unsigned int size)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<Output> &outputs = outputs_[videoId];
+    for (Output &output : outputs)
+    {
+        if (output.outputId == outputId)
+        {
+            output.size = size;
+            return;
+        }
+    }
+    outputs.push_back({outputId, size});
+}
+
+bool ThumbnailCache::Find(uint32_t videoId, unsigned int size, uint32_t *outputId) const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = outputs_.find(videoId);
+    if (it == outputs_.end()) return false;
+    for (const Output &output : it->second)
+    {
+        if (output.size == size)
+        {
+            *outputId = output.outputId;
+            return true;
+        }
+    }
+    return false;
+}
+
+void ThumbnailCache::DeleteOutputs(const std::vector<Output> &outputs)
+{
+    for (const Output &output : outputs)
+    {
+        NativePathView path;
+        if (!PathArena::Instance().Get(output.outputId, &path)) continue;
+        std::error_code ec;
+        std::filesystem::remove(std::filesystem::path(NativePath(path)), ec);
+    }
+}
+
+size_t ThumbnailCache::Invalidate(uint32_t videoId)
+{
+    std::vector<Output> removed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = outputs_.find(videoId);
+        if (it == outputs_.end()) return 0;
+        removed = std::move(it->second);
+        outputs_.erase(it);
+    }
+    // File deletion happens outside the lock
+    DeleteOutputs(removed);
+    return removed.size();
+}
+
+size_t ThumbnailCache::InvalidateUnder(NativePathView directory)
+{
+    PathArena &arena = PathArena::Instance();
+    std::vector<Output> removed;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto it = outputs_.begin(); it != outputs_.end();)
+        {
+            NativePathView path;
+            if (arena.Get(it->first, &path) && PathIsUnder(path, directory))
+            {
+                removed.insert(removed.end(), it->second.begin(), it->second.end());
+                it = outputs_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    DeleteOutputs(removed);
+    return removed.size();
+}
+
+size_t ThumbnailCache::Size() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    size_t count = 0;
+    for (const auto &entry : outputs_) count += entry.second.size();
+    return count;
+}
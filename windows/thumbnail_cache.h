@@ -0,0 +1,50 @@
+#ifndef THUMBNAIL_CACHE_H
+#define THUMBNAIL_CACHE_H
+
+#include "native_path.h"
+#include <cstdint>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Remembers which thumbnail files were written for which video.
+ *
+ * The Dart side treats an existing output file as a cache hit, so invalidating
+ * a video deletes the thumbnails recorded for it and the next request
+ * regenerates them.
+ */
+class ThumbnailCache
+{
+public:
+    static ThumbnailCache &Instance();
+
+    void Record(uint32_t videoId, uint32_t outputId, unsigned int size);
+
+    // Returns the output recorded for @p videoId at @p size, if any.
+    bool Find(uint32_t videoId, unsigned int size, uint32_t *outputId) const;
+
+    // Deletes recorded thumbnails for @p videoId. Returns the number removed.
+    size_t Invalidate(uint32_t videoId);
+
+    // Deletes recorded thumbnails of every video at or below @p directory.
+    size_t InvalidateUnder(NativePathView directory);
+
+    size_t Size() const;
+
+private:
+    ThumbnailCache() = default;
+
+    struct Output
+    {
+        uint32_t outputId;
+        unsigned int size;
+    };
+
+    static void DeleteOutputs(const std::vector<Output> &outputs);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<uint32_t, std::vector<Output>> outputs_;
+};
+
+#endif // THUMBNAIL_CACHE_H
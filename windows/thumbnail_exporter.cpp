@@ -5,28 +5,27 @@
 #include <wrl/client.h>
 #include <gdiplus.h>
 #include <vector>
+#include <cstdlib>
 #include <thumbcache.h>
 #include <iostream>
 #include <shlguid.h>
+#include <utility>
 
 #pragma comment(lib, "Shlwapi.lib")
 #pragma comment(lib, "Shell32.lib")
 #pragma comment(lib, "Gdiplus.lib")
 
-bool GetExplorerThumbnail(
-    const std::wstring &videoPath,
-    const std::wstring &outputPng,
-    UINT requestedSize)
+namespace
 {
-    try
+    // Asks the shell's thumbnail handler for a bitmap; the caller deletes it
+    HBITMAP RequestThumbnail(const std::wstring &videoPath, UINT requestedSize)
     {
-        // Initialize GDI+
         Microsoft::WRL::ComPtr<IShellItem> shellItem;
         HRESULT hr = SHCreateItemFromParsingName(videoPath.c_str(), nullptr, IID_PPV_ARGS(&shellItem));
         if (FAILED(hr))
         {
             std::wcerr << L"thumbnail_exporter | Failed to create shell item for paths " << videoPath << L": " << std::hex << hr << std::endl;
-            return false;
+            return nullptr;
         }
         
         // Create a thumbnail provider for the shell item
@@ -35,7 +34,7 @@ bool GetExplorerThumbnail(
         if (FAILED(hr))
         {
             std::wcerr << L"thumbnail_exporter | Failed to bind to thumbnail handler: " << std::hex << hr << std::endl;
-            return false;
+            return nullptr;
         }
 
         // Request a thumbnail of the specified size
@@ -45,47 +44,112 @@ bool GetExplorerThumbnail(
         if (FAILED(hr))
         {
             std::wcerr << L"thumbnail_exporter | Failed to get thumbnail: " << std::hex << hr << std::endl;
+            return nullptr;
+        }
+        return hBitmap;
+    }
+
+    // The encoder table only changes with the installed codecs, so it is looked up once
+    const CLSID *PngEncoder()
+    {
+        static const std::pair<bool, CLSID> png = []() {
+            UINT num = 0, size = 0;
+            Gdiplus::GetImageEncodersSize(&num, &size);
+            if (size == 0) return std::make_pair(false, CLSID{});
+
+            std::vector<BYTE> buffer(size);
+            auto pEncoders = reinterpret_cast<Gdiplus::ImageCodecInfo *>(buffer.data());
+            Gdiplus::GetImageEncoders(num, size, pEncoders);
+            for (UINT i = 0; i < num; i++)
+                if (wcscmp(pEncoders[i].MimeType, L"image/png") == 0) return std::make_pair(true, pEncoders[i].Clsid);
+            return std::make_pair(false, CLSID{});
+        }();
+        return png.first ? &png.second : nullptr;
+    }
+}
+
+bool GetExplorerThumbnail(
+    const std::wstring &videoPath,
+    const std::wstring &outputPng,
+    UINT requestedSize)
+{
+    try
+    {
+        const CLSID *pngClsid = PngEncoder();
+        if (pngClsid == nullptr)
+        {
+            std::cerr << "thumbnail_exporter | No PNG encoder found." << std::endl;
             return false;
         }
-        
-        // Check if the bitmap was created successfully
-        Gdiplus::Bitmap bmp(hBitmap, nullptr);
-        CLSID pngClsid;
-        UINT num = 0, size = 0;
-        Gdiplus::GetImageEncodersSize(&num, &size);
-        if (size == 0)
+
+        PooledBuffer pixels;
+        UINT width = 0, height = 0;
+        if (!GetExplorerThumbnailPixels(videoPath, requestedSize, &pixels, &width, &height)) return false;
+
+        // Wraps the pooled rows without a copy; 32bppRGB ignores alpha just like a Bitmap built from the HBITMAP
+        Gdiplus::Bitmap bmp(static_cast<INT>(width), static_cast<INT>(height), static_cast<INT>(width * 4), PixelFormat32bppRGB,
+                            pixels.data());
+        Gdiplus::Status status = bmp.Save(outputPng.c_str(), pngClsid, nullptr);
+        if (status != Gdiplus::Ok)
         {
-            std::cerr << "thumbnail_exporter | No image encoders found." << std::endl;
-            DeleteObject(hBitmap);
+            std::cerr << "thumbnail_exporter | Failed to save thumbnail: " << status << std::endl;
             return false;
         }
-        
-        // Allocate a buffer to hold the image encoders
-        std::vector<BYTE> buffer(size);
-        auto pEncoders = reinterpret_cast<Gdiplus::ImageCodecInfo *>(buffer.data());
-        Gdiplus::GetImageEncoders(num, size, pEncoders);
-        for (UINT i = 0; i < num; i++)
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "thumbnail_exporter | Error extracting thumbnail: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+bool GetExplorerThumbnailPixels(
+    const std::wstring &videoPath,
+    UINT requestedSize,
+    PooledBuffer *bgra,
+    UINT *width,
+    UINT *height)
+{
+    try
+    {
+        HBITMAP hBitmap = RequestThumbnail(videoPath, requestedSize);
+        if (hBitmap == nullptr) return false;
+
+        BITMAP bitmap = {};
+        if (GetObject(hBitmap, sizeof(bitmap), &bitmap) == 0 || bitmap.bmWidth <= 0 || bitmap.bmHeight == 0)
         {
-            if (wcscmp(pEncoders[i].MimeType, L"image/png") == 0)
-            {
-                // Found the PNG encoder
-                pngClsid = pEncoders[i].Clsid;
-                break;
-            }
+            DeleteObject(hBitmap);
+            return false;
         }
 
-        Gdiplus::Status status = bmp.Save(outputPng.c_str(), &pngClsid, nullptr);
+        // A negative height asks GetDIBits for top-down rows
+        BITMAPINFO info = {};
+        info.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+        info.bmiHeader.biWidth = bitmap.bmWidth;
+        info.bmiHeader.biHeight = -std::abs(bitmap.bmHeight);
+        info.bmiHeader.biPlanes = 1;
+        info.bmiHeader.biBitCount = 32;
+        info.bmiHeader.biCompression = BI_RGB;
+
+        const UINT rows = static_cast<UINT>(std::abs(bitmap.bmHeight));
+        *bgra = BufferPool::Pixels().Acquire(static_cast<size_t>(bitmap.bmWidth) * rows * 4);
+        HDC screen = GetDC(nullptr);
+        const int copied = GetDIBits(screen, hBitmap, 0, rows, bgra->data(), &info, DIB_RGB_COLORS);
+        ReleaseDC(nullptr, screen);
         DeleteObject(hBitmap);
-        if (status != Gdiplus::Ok)
+        if (copied != static_cast<int>(rows))
         {
-            std::cerr << "thumbnail_exporter | Failed to save thumbnail: " << status << std::endl;
+            std::cerr << "thumbnail_exporter | Failed to read thumbnail pixels" << std::endl;
             return false;
         }
+        *width = static_cast<UINT>(bitmap.bmWidth);
+        *height = rows;
         return true;
     }
     catch (const std::exception &e)
     {
-        std::cerr << "thumbnail_exporter | Error extracting thumbnail: " << e.what() << std::endl;
+        std::cerr << "thumbnail_exporter | Error extracting thumbnail pixels: " << e.what() << std::endl;
         return false;
     }
-}
\ No newline at end of file
+}
@@ -1,6 +1,8 @@
 #ifndef THUMBNAIL_EXPORTER_H_
 #define THUMBNAIL_EXPORTER_H_
 
+#include "buffer_pool.h"
+#include <cstdint>
 #include <string>
 #include <wtypes.h>
 
@@ -9,4 +11,13 @@ bool GetExplorerThumbnail(
     const std::wstring &outputPng,
     UINT requestedSize);
 
+// Same shell thumbnail, returned as top-down 32-bit BGRA rows (stride = width * 4) instead of a PNG.
+// The rows live in a buffer from BufferPool::Pixels().
+bool GetExplorerThumbnailPixels(
+    const std::wstring &videoPath,
+    UINT requestedSize,
+    PooledBuffer *bgra,
+    UINT *width,
+    UINT *height);
+
 #endif // THUMBNAIL_EXPORTER_H_
\ No newline at end of file
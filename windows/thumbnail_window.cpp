@@ -0,0 +1,271 @@
+#include "thumbnail_window.h"
+#include "path_arena.h"
+#include <algorithm>
+#include <iostream>
+
+namespace
+{
+    // Records not polled beyond this are dropped, oldest first; a view that never polls still gets its files
+    constexpr size_t kMaxRecords = 4096;
+    constexpr size_t kMaxSamples = 4096;
+    // Prefetch keys start above every visible key
+    constexpr uint64_t kPrefetchKey = uint64_t(1) << 32;
+
+    float Percentile(const std::vector<float> &sorted, double fraction)
+    {
+        if (sorted.empty()) return 0.0f;
+        return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * sorted.size()))];
+    }
+}
+
+ThumbnailWindow &ThumbnailWindow::Instance()
+{
+    // Renders through the hot cache, so the bytes are in memory when the tile asks for them
+    static ThumbnailWindow window(WorkerPool::Instance(), [](uint32_t videoId, uint32_t outputId, unsigned int size) {
+        return get_thumbnail_bytes_by_id(videoId, outputId, size, nullptr, 0) != 0;
+    });
+    return window;
+}
+
+ThumbnailWindow::ThumbnailWindow(WorkerPool &pool, Render render)
+    : pool_(pool), render_(std::move(render)), maxInFlight_(std::max<size_t>(pool.ThreadCount(), 1)),
+      prefetchSlots_(std::max<size_t>(pool.ThreadCount() / 2, 1))
+{
+}
+
+ThumbnailWindow::~ThumbnailWindow()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    tiles_.clear();
+    idle_.wait(lock, [this] { return inFlight_ == 0; });
+}
+
+void ThumbnailWindow::Set(const uint32_t *videoIds, const uint32_t *outputIds, uint32_t count, uint32_t firstVisible,
+                          uint32_t visibleCount, uint32_t lookahead, unsigned int size)
+{
+    const Clock::time_point now = Clock::now();
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_.windows++;
+    if (firstVisible != firstVisible_) direction_ = firstVisible > firstVisible_ ? 1 : -1;
+    firstVisible_ = std::min(firstVisible, count);
+    visibleEnd_ = static_cast<uint32_t>(std::min<uint64_t>(uint64_t(firstVisible_) + visibleCount, count));
+    const uint32_t begin = firstVisible_ - std::min(firstVisible_, lookahead);
+    const uint32_t end = static_cast<uint32_t>(std::min<uint64_t>(uint64_t(visibleEnd_) + lookahead, count));
+
+    for (auto &tile : tiles_) tile.second.inWindow = false;
+    for (uint32_t i = begin; i < end; i++)
+    {
+        if (videoIds[i] == kInvalidPathId || outputIds[i] == kInvalidPathId) continue;
+        auto inserted = tiles_.try_emplace(videoIds[i]);
+        Tile &tile = inserted.first->second;
+        if (inserted.second || tile.outputId != outputIds[i] || tile.size != size)
+        {
+            // New, or asked for at another size or place: whatever ran before does not count
+            tile = Tile();
+            tile.outputId = outputIds[i];
+            tile.size = size;
+            tile.job = ++nextJob_;
+        }
+        tile.index = i;
+        tile.inWindow = true;
+
+        const bool visible = i >= firstVisible_ && i < visibleEnd_;
+        if (visible && !tile.visible)
+        {
+            tile.visibleSince = now;
+            if (tile.state == TileState::Ready) Sample(0.0f);
+            if (tile.state == TileState::Queued && tile.queuedOutside) stats_.promoted++;
+            tile.queuedOutside = false;
+        }
+        else if (!visible && tile.state == TileState::Queued)
+        {
+            tile.queuedOutside = true;
+        }
+        tile.visible = visible;
+    }
+
+    for (auto it = tiles_.begin(); it != tiles_.end();)
+    {
+        Tile &tile = it->second;
+        if (tile.inWindow || tile.state == TileState::Running)
+        {
+            if (!tile.inWindow) tile.visible = false;
+            ++it;
+            continue;
+        }
+        if (tile.state == TileState::Queued) stats_.canceled++;
+        it = tiles_.erase(it);
+    }
+    Pump();
+}
+
+ThumbnailWindow::TileIt ThumbnailWindow::Next()
+{
+    TileIt best = tiles_.end();
+    uint64_t bestKey = UINT64_MAX;
+    const bool prefetchFree = prefetchRunning_ < prefetchSlots_;
+    for (auto it = tiles_.begin(); it != tiles_.end(); ++it)
+    {
+        const Tile &tile = it->second;
+        if (tile.state != TileState::Queued) continue;
+        uint64_t key;
+        if (tile.visible)
+        {
+            key = tile.index - firstVisible_;
+        }
+        else if (!prefetchFree)
+        {
+            continue;
+        }
+        else
+        {
+            // Nearest first; at equal distance the side the view is scrolling towards wins
+            const bool below = tile.index >= visibleEnd_;
+            const uint64_t distance = below ? tile.index - visibleEnd_ + 1 : firstVisible_ - tile.index;
+            key = kPrefetchKey + distance * 2 + ((direction_ > 0) == below ? 0 : 1);
+        }
+        if (key < bestKey)
+        {
+            bestKey = key;
+            best = it;
+        }
+    }
+    return best;
+}
+
+void ThumbnailWindow::Pump()
+{
+    size_t queued = 0;
+    for (const auto &tile : tiles_) queued += tile.second.state == TileState::Queued;
+    // Pickers that find nothing they may take return at once, so a few too many are harmless
+    while (inFlight_ < maxInFlight_ && inFlight_ - rendering_ < queued)
+    {
+        inFlight_++;
+        pool_.Submit([this] { Drain(); });
+    }
+}
+
+void ThumbnailWindow::Drain()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (TileIt it = Next(); it != tiles_.end(); it = Next())
+    {
+        Tile &tile = it->second;
+        tile.state = TileState::Running;
+        rendering_++;
+        const bool prefetch = !tile.visible;
+        if (prefetch) prefetchRunning_++;
+        const uint32_t videoId = it->first;
+        const uint32_t outputId = tile.outputId;
+        const unsigned int size = tile.size;
+        const uint64_t job = tile.job;
+        lock.unlock();
+
+        bool ok = false;
+        try
+        {
+            ok = render_(videoId, outputId, size);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "video_data_exporter | Thumbnail prefetch failed: " << e.what() << std::endl;
+        }
+
+        lock.lock();
+        rendering_--;
+        if (prefetch) prefetchRunning_--;
+        Finish(videoId, job, ok);
+    }
+    inFlight_--;
+    idle_.notify_all();
+}
+
+void ThumbnailWindow::Finish(uint32_t videoId, uint64_t job, bool ok)
+{
+    auto it = tiles_.find(videoId);
+    // Superseded by a later window that wants the tile at another size or output
+    if (it == tiles_.end() || it->second.job != job) return;
+    Tile &tile = it->second;
+    tile.state = ok ? TileState::Ready : TileState::Failed;
+
+    ThumbnailTileRecord record = {};
+    record.video_id = videoId;
+    record.output_id = tile.outputId;
+    record.ok = ok;
+    record.visible = tile.visible;
+    if (!ok)
+    {
+        stats_.failed++;
+    }
+    else
+    {
+        stats_.rendered++;
+        if (tile.visible)
+        {
+            record.wait_ms = std::chrono::duration<float, std::milli>(Clock::now() - tile.visibleSince).count();
+            Sample(record.wait_ms);
+            stats_.visible_blank++;
+        }
+        else
+        {
+            stats_.prefetched++;
+        }
+    }
+    if (!tile.inWindow) tiles_.erase(it);
+
+    if (records_.size() == kMaxRecords) records_.pop_front();
+    records_.push_back(record);
+    ready_.notify_all();
+}
+
+void ThumbnailWindow::Sample(float waitMs)
+{
+    stats_.visible_tiles++;
+    if (samples_.size() < kMaxSamples) samples_.push_back(waitMs);
+    else samples_[nextSample_] = waitMs;
+    nextSample_ = (nextSample_ + 1) % kMaxSamples;
+}
+
+uint32_t ThumbnailWindow::Poll(ThumbnailTileRecord *out, uint32_t capacity, uint32_t timeoutMs)
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    ready_.wait_for(lock, std::chrono::milliseconds(timeoutMs), [this] { return !records_.empty(); });
+    uint32_t written = 0;
+    while (written < capacity && !records_.empty())
+    {
+        out[written++] = records_.front();
+        records_.pop_front();
+    }
+    return written;
+}
+
+ThumbnailWindowStats ThumbnailWindow::Stats() const
+{
+    std::vector<float> sorted;
+    ThumbnailWindowStats stats;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stats = stats_;
+        sorted = samples_;
+    }
+    std::sort(sorted.begin(), sorted.end());
+    stats.time_to_visible_p50_ms = Percentile(sorted, 0.50);
+    stats.time_to_visible_p90_ms = Percentile(sorted, 0.90);
+    stats.time_to_visible_p99_ms = Percentile(sorted, 0.99);
+    stats.time_to_visible_max_ms = sorted.empty() ? 0.0f : sorted.back();
+    return stats;
+}
+
+void ThumbnailWindow::ResetStats()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    stats_ = {};
+    samples_.clear();
+    nextSample_ = 0;
+}
+
+void ThumbnailWindow::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return inFlight_ == 0; });
+}
@@ -0,0 +1,115 @@
+#ifndef THUMBNAIL_WINDOW_H
+#define THUMBNAIL_WINDOW_H
+
+#include "video_data_exporter_api.h"
+#include "worker_pool.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @brief Renders the thumbnails of a scrolling grid around what is on screen.
+ *
+ * The caller describes the window: its items in display order, the visible
+ * range and how far to look ahead. Queued items are not ordered when queued
+ * but picked on the pool each time a worker frees up, from the window as it
+ * is at that moment: visible tiles top to bottom, then the nearest prefetch,
+ * those in the scroll direction first. That is what makes promotion and
+ * cancellation free: a queued item that scrolls into view is simply picked
+ * sooner, and one that scrolls out is removed from the map.
+ *
+ * Prefetches may occupy at most half of the workers, so a tile that becomes
+ * visible finds one free. Renders cannot be interrupted; one that is running
+ * when its item leaves the window finishes and is kept.
+ */
+class ThumbnailWindow
+{
+public:
+    // Makes the thumbnail of @p videoId at @p size ready in @p outputId; true on success.
+    typedef std::function<bool(uint32_t videoId, uint32_t outputId, unsigned int size)> Render;
+
+    static ThumbnailWindow &Instance();
+
+    ThumbnailWindow(WorkerPool &pool, Render render);
+    // Cancels queued items and waits for running renders.
+    ~ThumbnailWindow();
+
+    ThumbnailWindow(const ThumbnailWindow &) = delete;
+    ThumbnailWindow &operator=(const ThumbnailWindow &) = delete;
+
+    // See set_thumbnail_window.
+    void Set(const uint32_t *videoIds, const uint32_t *outputIds, uint32_t count, uint32_t firstVisible, uint32_t visibleCount,
+             uint32_t lookahead, unsigned int size);
+    uint32_t Poll(ThumbnailTileRecord *out, uint32_t capacity, uint32_t timeoutMs);
+
+    ThumbnailWindowStats Stats() const;
+    void ResetStats();
+
+    // Blocks until nothing is queued or running.
+    void WaitIdle();
+
+private:
+    typedef std::chrono::steady_clock Clock;
+
+    enum class TileState : uint8_t
+    {
+        Queued,
+        Running,
+        Ready,
+        Failed,
+    };
+
+    struct Tile
+    {
+        uint32_t outputId = 0;
+        unsigned int size = 0;
+        uint32_t index = 0; // in the caller's order
+        uint64_t job = 0;   // tells a running render whether its result still belongs to this tile
+        TileState state = TileState::Queued;
+        bool inWindow = false;
+        bool visible = false;
+        bool queuedOutside = false; // queued while outside the visible range, not yet promoted
+        Clock::time_point visibleSince;
+    };
+
+    typedef std::unordered_map<uint32_t, Tile>::iterator TileIt;
+
+    // The next queued tile to render, or end(). mutex_ is held.
+    TileIt Next();
+    // Submits pickers for the queued tiles, up to one per worker. mutex_ is held.
+    void Pump();
+    // Runs on the pool: renders picked tiles until none is left for it.
+    void Drain();
+    void Finish(uint32_t videoId, uint64_t job, bool ok);
+    void Sample(float waitMs);
+
+    WorkerPool &pool_;
+    Render render_;
+    const size_t maxInFlight_;
+    const size_t prefetchSlots_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable ready_;
+    std::condition_variable idle_;
+    // By video ID: the window's items, and running renders of items that left it
+    std::unordered_map<uint32_t, Tile> tiles_;
+    uint32_t firstVisible_ = 0;
+    uint32_t visibleEnd_ = 0;
+    int direction_ = 1; // of the last scroll: 1 down, -1 up
+    uint64_t nextJob_ = 0;
+    size_t inFlight_ = 0;  // pickers submitted and not yet returned
+    size_t rendering_ = 0; // of those, the ones inside a render
+    size_t prefetchRunning_ = 0;
+
+    std::deque<ThumbnailTileRecord> records_;
+    ThumbnailWindowStats stats_ = {};
+    std::vector<float> samples_; // the most recent time-to-visible samples, a ring
+    size_t nextSample_ = 0;
+};
+
+#endif // THUMBNAIL_WINDOW_H
@@ -0,0 +1,561 @@
+// vdu-probe: probes directory trees from the command line and streams the results.
+//
+//   vdu-probe [options] <root>...
+//     --fields LIST    comma-separated: metadata, duration, streams, cover, keyframes,
+//                      sampled-hash, full-hash, or all (default: metadata,duration)
+//     --format FORMAT  ndjson (default): one object per file as it completes
+//                      snapshot: the columnar snapshot format, written once the tree is done
+//     --threads N      files probed at once (default: hardware threads); the walk uses as many
+//     --cache MODE     on (default): path IDs and the probe cache; off: every probe from disk;
+//                      daemon: ask a running vdu-probed first (VDU_PROBED_ENDPOINT applies)
+//     --passes N       probe the trees N times, e.g. to compare a cold and a warm cache;
+//                      results are written for the last pass only
+//     --ordered        results in walk order (sorted pre-order) instead of completion order
+//     --follow-symlinks
+//
+// Each pass ends with a summary on stderr: files, throughput, bytes read, and the
+// latency distribution of single probes.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../directory_walker.h"
+#include "../file_probe.h"
+#include "../library_snapshot.h"
+#include "../path_arena.h"
+#include "../utf_transcode.h"
+#include "../video_data_exporter_api.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#include <fcntl.h>
+#include <io.h>
+#include <shellapi.h>
+#endif
+
+namespace
+{
+    typedef std::chrono::steady_clock Clock;
+
+    enum class OutputFormat
+    {
+        Ndjson,
+        Snapshot,
+    };
+
+    enum class CacheMode
+    {
+        On,
+        Off,
+        Daemon,
+    };
+
+    struct Options
+    {
+        std::vector<NativePath> roots;
+        uint32_t fields = static_cast<uint32_t>(ProbeField::Metadata) | static_cast<uint32_t>(ProbeField::Duration);
+        OutputFormat format = OutputFormat::Ndjson;
+        uint32_t threads = std::max(1u, std::thread::hardware_concurrency());
+        CacheMode cache = CacheMode::On;
+        uint32_t passes = 1;
+        bool ordered = false;
+        bool followSymlinks = false;
+    };
+
+    struct ProbedFile
+    {
+        uint64_t sequence = 0; // walk order
+        NativePath path;
+        FileProbeResult result = {};
+        bool ok = false;
+        uint64_t latencyNs = 0;
+    };
+
+    int Usage(const char *problem)
+    {
+        if (problem != nullptr) std::cerr << "vdu-probe: " << problem << std::endl;
+        std::cerr << "usage: vdu-probe [--fields LIST] [--format ndjson|snapshot] [--threads N] [--cache on|off|daemon]\n"
+                     "                 [--passes N] [--ordered] [--follow-symlinks] <root>..."
+                  << std::endl;
+        return 2;
+    }
+
+    bool ParseFields(const std::string &list, uint32_t *fields)
+    {
+        static const std::pair<const char *, ProbeField> kNames[] = {
+            {"metadata", ProbeField::Metadata},   {"duration", ProbeField::Duration},        {"streams", ProbeField::Streams},
+            {"cover", ProbeField::CoverArt},      {"keyframes", ProbeField::Keyframes},      {"sampled-hash", ProbeField::SampledHash},
+            {"full-hash", ProbeField::FullHash},
+        };
+        *fields = 0;
+        std::stringstream stream(list);
+        std::string name;
+        while (std::getline(stream, name, ','))
+        {
+            if (name == "all")
+            {
+                *fields = kProbeAllFields;
+                continue;
+            }
+            auto it = std::find_if(std::begin(kNames), std::end(kNames), [&](const auto &entry) { return name == entry.first; });
+            if (it == std::end(kNames)) return false;
+            *fields |= static_cast<uint32_t>(it->second);
+        }
+        return *fields != 0;
+    }
+
+    bool ParseCount(const char *text, uint32_t *value)
+    {
+        char *end = nullptr;
+        const unsigned long parsed = std::strtoul(text, &end, 10);
+        if (end == text || *end != 0 || parsed == 0 || parsed > 4096) return false;
+        *value = static_cast<uint32_t>(parsed);
+        return true;
+    }
+
+    // The command line in the native path encoding; narrow argv on Windows is in the ANSI code page
+    std::vector<NativePath> Arguments(int argc, char **argv)
+    {
+        std::vector<NativePath> args;
+#ifdef _WIN32
+        (void)argc;
+        (void)argv;
+        int count = 0;
+        wchar_t **wide = CommandLineToArgvW(GetCommandLineW(), &count);
+        if (wide == nullptr) return args;
+        args.assign(wide, wide + count);
+        LocalFree(wide);
+#else
+        args.assign(argv, argv + argc);
+#endif
+        return args;
+    }
+
+    int ParseOptions(const std::vector<NativePath> &args, Options *options)
+    {
+        // Option names and values are ASCII; roots are kept as given
+        std::vector<std::string> utf8;
+        for (const NativePath &arg : args) utf8.push_back(NativePathToUtf8(arg));
+        for (size_t i = 1; i < args.size(); i++)
+        {
+            const std::string &arg = utf8[i];
+            const char *value = i + 1 < args.size() ? utf8[i + 1].c_str() : nullptr;
+            if (arg == "--fields" && value != nullptr)
+            {
+                if (!ParseFields(value, &options->fields)) return Usage("unknown field in --fields");
+                i++;
+            }
+            else if (arg == "--format" && value != nullptr)
+            {
+                if (std::strcmp(value, "ndjson") == 0) options->format = OutputFormat::Ndjson;
+                else if (std::strcmp(value, "snapshot") == 0) options->format = OutputFormat::Snapshot;
+                else return Usage("--format is ndjson or snapshot");
+                i++;
+            }
+            else if (arg == "--threads" && value != nullptr)
+            {
+                if (!ParseCount(value, &options->threads)) return Usage("--threads takes a count");
+                i++;
+            }
+            else if (arg == "--cache" && value != nullptr)
+            {
+                if (std::strcmp(value, "on") == 0) options->cache = CacheMode::On;
+                else if (std::strcmp(value, "off") == 0) options->cache = CacheMode::Off;
+                else if (std::strcmp(value, "daemon") == 0) options->cache = CacheMode::Daemon;
+                else return Usage("--cache is on, off or daemon");
+                i++;
+            }
+            else if (arg == "--passes" && value != nullptr)
+            {
+                if (!ParseCount(value, &options->passes)) return Usage("--passes takes a count");
+                i++;
+            }
+            else if (arg == "--ordered") options->ordered = true;
+            else if (arg == "--follow-symlinks") options->followSymlinks = true;
+            else if (!arg.empty() && arg[0] == '-') return Usage(("unknown option " + arg).c_str());
+            else options->roots.push_back(args[i]);
+        }
+        if (options->roots.empty()) return Usage("no root given");
+        // Paths go to the daemon as they are walked, and it resolves them against the caller's directory only if absolute
+        if (options->cache == CacheMode::Daemon)
+        {
+            for (NativePath &root : options->roots)
+            {
+                std::error_code error;
+                const std::filesystem::path absolute = std::filesystem::absolute(root, error);
+                if (!error) root = absolute.native();
+            }
+        }
+        return 0;
+    }
+
+    // === NDJSON ===
+
+    // JSON is UTF-8, and Linux file names are any bytes: each malformed sequence becomes U+FFFD
+    std::string ValidUtf8(std::string_view text)
+    {
+        std::u16string wide(text.size(), u'\0');
+        wide.resize(Utf8ToUtf16(text.data(), text.size(), &wide[0]));
+        std::string valid(wide.size() * 3, '\0');
+        valid.resize(Utf16ToUtf8(wide.data(), wide.size(), &valid[0]));
+        return valid;
+    }
+
+    void AppendJsonString(std::string *out, std::string_view text)
+    {
+        std::string valid;
+        if (std::any_of(text.begin(), text.end(), [](char c) { return static_cast<unsigned char>(c) >= 0x80; }))
+        {
+            valid = ValidUtf8(text);
+            text = valid;
+        }
+        out->push_back('"');
+        for (const char c : text)
+        {
+            switch (c)
+            {
+            case '"': *out += "\\\""; break;
+            case '\\': *out += "\\\\"; break;
+            case '\n': *out += "\\n"; break;
+            case '\r': *out += "\\r"; break;
+            case '\t': *out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20)
+                {
+                    char escaped[8];
+                    std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    *out += escaped;
+                }
+                else
+                {
+                    out->push_back(c);
+                }
+            }
+        }
+        out->push_back('"');
+    }
+
+    // Fixed-size C strings of FileProbeResult, which are NUL-padded
+    std::string_view Field(const char *text, size_t capacity) { return std::string_view(text, strnlen(text, capacity)); }
+
+    void AppendHex(std::string *out, uint64_t value)
+    {
+        char hex[24];
+        std::snprintf(hex, sizeof(hex), "\"%016llx\"", static_cast<unsigned long long>(value));
+        *out += hex;
+    }
+
+    std::string FormatJson(const ProbedFile &file)
+    {
+        const FileProbeResult &r = file.result;
+        std::string line = "{\"path\":";
+        AppendJsonString(&line, NativePathToUtf8(file.path));
+        line += ",\"ok\":";
+        line += file.ok ? "true" : "false";
+        if (HasField(r.fields, ProbeField::Metadata))
+        {
+            line += ",\"size\":" + std::to_string(r.metadata.file_size_bytes);
+            line += ",\"modified_ms\":" + std::to_string(r.metadata.modified_time_ms);
+        }
+        if (HasField(r.fields, ProbeField::Duration))
+        {
+            char duration[32];
+            std::snprintf(duration, sizeof(duration), "%.3f", r.duration_ms);
+            line += ",\"container\":" + std::to_string(r.container);
+            line += ",\"duration_ms\":";
+            line += duration;
+        }
+        if (HasField(r.fields, ProbeField::Streams))
+        {
+            line += ",\"video_streams\":" + std::to_string(r.video_streams);
+            line += ",\"audio_streams\":" + std::to_string(r.audio_streams);
+            line += ",\"video_codec\":";
+            AppendJsonString(&line, Field(r.video_codec, sizeof(r.video_codec)));
+            line += ",\"width\":" + std::to_string(r.width);
+            line += ",\"height\":" + std::to_string(r.height);
+            line += ",\"audio_codec\":";
+            AppendJsonString(&line, Field(r.audio_codec, sizeof(r.audio_codec)));
+            line += ",\"sample_rate\":" + std::to_string(r.sample_rate);
+            line += ",\"channels\":" + std::to_string(r.channels);
+        }
+        if (HasField(r.fields, ProbeField::CoverArt))
+        {
+            line += ",\"cover_offset\":" + std::to_string(r.cover_offset);
+            line += ",\"cover_size\":" + std::to_string(r.cover_size);
+            line += ",\"cover_media_type\":";
+            AppendJsonString(&line, Field(r.cover_media_type, sizeof(r.cover_media_type)));
+        }
+        if (HasField(r.fields, ProbeField::Keyframes)) line += ",\"keyframes\":" + std::to_string(r.keyframe_count);
+        if (HasField(r.fields, ProbeField::SampledHash))
+        {
+            line += ",\"sampled_hash\":";
+            AppendHex(&line, r.sampled_hash);
+        }
+        if (HasField(r.fields, ProbeField::FullHash))
+        {
+            line += ",\"full_hash\":";
+            AppendHex(&line, r.full_hash);
+        }
+        line += ",\"bytes_read\":" + std::to_string(r.bytes_read);
+        line += ",\"latency_us\":" + std::to_string(file.latencyNs / 1000);
+        line += "}\n";
+        return line;
+    }
+
+    SnapshotRow ToSnapshotRow(const ProbedFile &file)
+    {
+        const FileProbeResult &r = file.result;
+        SnapshotRow row;
+        row.utf8_path = NativePathToUtf8(file.path);
+        if (HasField(r.fields, ProbeField::Metadata))
+        {
+            row.metadata = r.metadata;
+            row.flags |= kSnapshotHasMetadata;
+        }
+        if (HasField(r.fields, ProbeField::Duration) && r.duration_ms > 0.0)
+        {
+            row.duration_ms = r.duration_ms;
+            row.flags |= kSnapshotHasDuration;
+        }
+        row.container = static_cast<ContainerKind>(r.container);
+        row.keyframe_count = r.keyframe_count;
+        return row;
+    }
+
+    // === Probing ===
+
+    // Walk order in, probe results out; written as they complete or, ordered, as the next in line completes
+    class ProbePass
+    {
+    public:
+        ProbePass(const Options &options, bool emit) : options_(options), emit_(emit) {}
+
+        void Run()
+        {
+            std::vector<std::thread> threads;
+            for (uint32_t t = 0; t < options_.threads; t++) threads.emplace_back(&ProbePass::Probe, this);
+
+            const Clock::time_point start = Clock::now();
+            WalkOptions walk;
+            walk.threads = options_.threads;
+            walk.follow_symlinks = options_.followSymlinks;
+            walk.ordered = options_.ordered;
+            for (const NativePath &root : options_.roots)
+            {
+                WalkStats stats;
+                const bool listed = WalkDirectory(root, walk, [this](std::vector<WalkEntry> &&entries) { return Enqueue(std::move(entries)); },
+                                                  &stats);
+                if (!listed) std::cerr << "vdu-probe: cannot list " << NativePathToUtf8(root) << std::endl;
+                directories_ += stats.directories;
+            }
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                walked_ = true;
+            }
+            work_.notify_all();
+            for (std::thread &thread : threads) thread.join();
+            elapsed_ = Clock::now() - start;
+        }
+
+        void Summarize(uint32_t pass) const
+        {
+            std::vector<uint64_t> latencies = latencies_;
+            std::sort(latencies.begin(), latencies.end());
+            auto percentile = [&](double p) {
+                return latencies.empty() ? 0.0 : latencies[std::min(latencies.size() - 1, size_t(p * latencies.size()))] / 1e6;
+            };
+            const double seconds = std::chrono::duration<double>(elapsed_).count();
+            char line[512];
+            std::snprintf(line, sizeof(line),
+                          "pass %u: %llu files (%llu failed) in %llu directories, %.3f s, %.0f files/s, %.1f MB read (%.1f MB/s)\n"
+                          "  latency ms: p50 %.3f  p90 %.3f  p99 %.3f  max %.3f",
+                          pass, static_cast<unsigned long long>(latencies.size()), static_cast<unsigned long long>(failed_),
+                          static_cast<unsigned long long>(directories_), seconds, seconds > 0 ? latencies.size() / seconds : 0.0,
+                          bytesRead_ / 1e6, seconds > 0 ? bytesRead_ / 1e6 / seconds : 0.0, percentile(0.5), percentile(0.9),
+                          percentile(0.99), percentile(1.0));
+            std::cerr << line << std::endl;
+        }
+
+        std::vector<ProbedFile> TakeRows()
+        {
+            std::sort(rows_.begin(), rows_.end(), [](const ProbedFile &a, const ProbedFile &b) { return a.sequence < b.sequence; });
+            return std::move(rows_);
+        }
+
+    private:
+        // The walk waits here while the probes are behind, so a huge tree is never held in memory
+        bool Enqueue(std::vector<WalkEntry> &&entries)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            space_.wait(lock, [this] { return queue_.size() < kMaxQueued; });
+            for (WalkEntry &entry : entries)
+            {
+                if (entry.is_directory) continue;
+                ProbedFile file;
+                file.sequence = nextSequence_++;
+                file.path = std::move(entry.path);
+                queue_.push_back(std::move(file));
+            }
+            lock.unlock();
+            work_.notify_all();
+            return true;
+        }
+
+        void Probe()
+        {
+            for (;;)
+            {
+                ProbedFile file;
+                {
+                    std::unique_lock<std::mutex> lock(mutex_);
+                    work_.wait(lock, [this] { return !queue_.empty() || walked_; });
+                    if (queue_.empty()) return;
+                    file = std::move(queue_.front());
+                    queue_.pop_front();
+                }
+                space_.notify_one();
+
+                const Clock::time_point start = Clock::now();
+                if (options_.cache == CacheMode::Off)
+                {
+                    file.ok = ProbeFile(file.path.c_str(), options_.fields, &file.result);
+                }
+                else
+                {
+                    const uint32_t pathId = PathArena::Instance().Intern(file.path);
+                    file.ok = pathId != kInvalidPathId && probe_file_by_id(pathId, options_.fields, &file.result);
+                }
+                file.latencyNs = std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count();
+                Complete(std::move(file));
+            }
+        }
+
+        void Complete(ProbedFile &&file)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            latencies_.push_back(file.latencyNs);
+            bytesRead_ += file.result.bytes_read;
+            failed_ += !file.ok;
+            if (!emit_) return;
+            if (options_.format == OutputFormat::Snapshot)
+            {
+                rows_.push_back(std::move(file));
+                return;
+            }
+            if (!options_.ordered)
+            {
+                const std::string line = FormatJson(file);
+                std::fwrite(line.data(), 1, line.size(), stdout);
+                return;
+            }
+            // Held until every file walked before it is written
+            reorder_.emplace(file.sequence, std::move(file));
+            for (auto it = reorder_.begin(); it != reorder_.end() && it->first == nextWritten_; it = reorder_.erase(it), nextWritten_++)
+            {
+                const std::string line = FormatJson(it->second);
+                std::fwrite(line.data(), 1, line.size(), stdout);
+            }
+        }
+
+        static constexpr size_t kMaxQueued = 4096;
+
+        const Options &options_;
+        const bool emit_;
+
+        std::mutex mutex_;
+        std::condition_variable work_;
+        std::condition_variable space_;
+        std::deque<ProbedFile> queue_;
+        uint64_t nextSequence_ = 0;
+        bool walked_ = false;
+
+        std::map<uint64_t, ProbedFile> reorder_;
+        uint64_t nextWritten_ = 0;
+        std::vector<ProbedFile> rows_;
+
+        std::vector<uint64_t> latencies_; // ns, one per file
+        uint64_t bytesRead_ = 0;
+        uint64_t failed_ = 0;
+        uint64_t directories_ = 0;
+        Clock::duration elapsed_{};
+    };
+
+    bool WriteSnapshotToStdout(const std::vector<ProbedFile> &files, uint32_t fields)
+    {
+        std::vector<SnapshotRow> rows;
+        rows.reserve(files.size());
+        for (const ProbedFile &file : files) rows.push_back(ToSnapshotRow(file));
+
+        // The writer renames into place, so it writes a file; stdout gets a copy of it
+        const std::filesystem::path temp =
+            std::filesystem::temp_directory_path() / ("vdu-probe-" + std::to_string(Clock::now().time_since_epoch().count()) + ".snapshot");
+        const bool streamColumns = HasField(fields, ProbeField::Duration) || HasField(fields, ProbeField::Keyframes);
+        if (!WriteLibrarySnapshot(temp.native().c_str(), rows, streamColumns)) return false;
+
+        FILE *in = std::fopen(temp.string().c_str(), "rb");
+        bool ok = in != nullptr;
+        std::vector<char> buffer(1 << 20);
+        while (ok)
+        {
+            const size_t read = std::fread(buffer.data(), 1, buffer.size(), in);
+            if (read == 0) break;
+            ok = std::fwrite(buffer.data(), 1, read, stdout) == read;
+        }
+        if (in != nullptr) std::fclose(in);
+        std::error_code error;
+        std::filesystem::remove(temp, error);
+        return ok;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    Options options;
+    if (const int status = ParseOptions(Arguments(argc, argv), &options)) return status;
+
+#ifdef _WIN32
+    _setmode(_fileno(stdout), _O_BINARY); // NDJSON lines end in \n and snapshots are binary
+#endif
+    static char outputBuffer[1 << 16];
+    std::setvbuf(stdout, outputBuffer, _IOFBF, sizeof(outputBuffer));
+
+    initialize_exporter();
+    // Only --cache daemon goes to vdu-probed, found where VDU_PROBED_ENDPOINT says; the other modes measure this process
+    if (options.cache != CacheMode::Daemon) daemon_set_endpoint(PATH_LITERAL(""));
+
+    bool ok = true;
+    for (uint32_t pass = 1; pass <= options.passes; pass++)
+    {
+        const bool last = pass == options.passes;
+        ProbePass probes(options, last);
+        probes.Run();
+        probes.Summarize(pass);
+        if (last && options.format == OutputFormat::Snapshot) ok = WriteSnapshotToStdout(probes.TakeRows(), options.fields);
+    }
+    FileIdentityStats identities;
+    get_file_identity_stats(&identities);
+    if (identities.shared_entries != 0)
+        std::cerr << "hardlinks: " << identities.paths - identities.files << " extra paths, " << identities.shared_entries
+                  << " probes reused" << std::endl;
+    if (options.cache == CacheMode::Daemon)
+    {
+        DaemonClientStatus status;
+        daemon_get_status(&status);
+        std::cerr << "daemon: " << status.requests << " requests answered, " << status.fallbacks << " run locally" << std::endl;
+    }
+    std::fflush(stdout);
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,84 @@
+// vdu-probed: one probe service for every app instance and indexer of a user.
+//
+//   vdu-probed [--endpoint <socket or pipe>]
+//
+// Serves until interrupted. Clients find it at the same default endpoint, or at
+// the one VDU_PROBED_ENDPOINT names.
+
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include "../probe_daemon.h"
+#include "../utf_transcode.h"
+#include "../video_data_exporter_api.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <csignal>
+#include <pthread.h>
+#endif
+
+namespace
+{
+#ifdef _WIN32
+    HANDLE stopEvent = nullptr;
+
+    BOOL WINAPI OnConsoleEvent(DWORD)
+    {
+        SetEvent(stopEvent);
+        return TRUE;
+    }
+#endif
+
+    int Usage()
+    {
+        std::cerr << "usage: vdu-probed [--endpoint <socket or pipe>]" << std::endl;
+        return 2;
+    }
+}
+
+int main(int argc, char **argv)
+{
+    DaemonServerOptions options;
+    for (int i = 1; i < argc; i++)
+    {
+        if (std::strcmp(argv[i], "--endpoint") == 0 && i + 1 < argc)
+            options.endpoint = Utf8ToNativePath(argv[i + 1], std::strlen(argv[i + 1])), i++;
+        else
+            return Usage();
+    }
+
+#ifndef _WIN32
+    // Blocked before any thread starts, so only sigwait below sees them
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+#endif
+
+    initialize_exporter();
+    DaemonServer server(options);
+    if (!server.Start())
+    {
+        std::cerr << "vdu-probed | Cannot listen on " << NativePathToUtf8(server.Endpoint()) << "; is another daemon running?" << std::endl;
+        return 1;
+    }
+    std::cerr << "vdu-probed | Listening on " << NativePathToUtf8(server.Endpoint()) << std::endl;
+
+#ifdef _WIN32
+    stopEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+    SetConsoleCtrlHandler(OnConsoleEvent, TRUE);
+    WaitForSingleObject(stopEvent, INFINITE);
+#else
+    int received = 0;
+    sigwait(&signals, &received);
+#endif
+
+    server.Stop();
+    const DaemonServerStats stats = server.Stats();
+    std::cerr << "vdu-probed | Served " << stats.requests << " requests over " << stats.connections << " connections" << std::endl;
+    return 0;
+}
@@ -0,0 +1,470 @@
+#include "tree_summary.h"
+#include "content_hash.h"
+#include "utf_transcode.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+#ifdef _WIN32
+#include <cwchar>
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Coarser than any filesystem's mtime granularity (FAT: 2 s) and the kernel's timestamp tick
+    constexpr int64_t kRacyWindowNs = 2000000000;
+
+    constexpr char kMagic[8] = {'V', 'D', 'U', 'T', 'R', 'E', 'E', '\0'};
+    constexpr uint32_t kVersion = 1;
+    constexpr uint32_t kMaxDepth = 1024;
+
+    int64_t NowNs()
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+    }
+
+    template <typename Entry>
+    bool ByName(const Entry &a, const Entry &b)
+    {
+        return a.name < b.name;
+    }
+
+    template <typename Entry>
+    const Entry *FindByName(const std::vector<Entry> &entries, const NativePath &name)
+    {
+        auto it = std::lower_bound(entries.begin(), entries.end(), name, [](const Entry &entry, const NativePath &key) { return entry.name < key; });
+        return it != entries.end() && it->name == name ? &*it : nullptr;
+    }
+
+    uint64_t SummaryHash(const TreeDirectory &directory)
+    {
+        ContentHasher hasher;
+        auto update = [&hasher](const void *data, size_t length) { hasher.Update(static_cast<const uint8_t *>(data), length); };
+        for (const TreeFile &file : directory.files)
+        {
+            update(file.name.data(), file.name.size() * sizeof(PathChar));
+            update("\0", 1); // names never hold NUL, so this ends one unambiguously
+            update(&file.size, sizeof(file.size));
+            update(&file.mtime_ns, sizeof(file.mtime_ns));
+        }
+        for (const TreeDirectory &child : directory.directories)
+        {
+            update(child.name.data(), child.name.size() * sizeof(PathChar));
+            update("/", 1);
+            update(&child.hash, sizeof(child.hash));
+        }
+        return hasher.Digest();
+    }
+
+    NativePath Join(const NativePath &directory, const NativePath &name)
+    {
+        NativePath path = directory;
+        if (!path.empty() && path.back() != kPathSeparator) path.push_back(kPathSeparator);
+        return path + name;
+    }
+
+    // === Scanning ===
+
+    struct Scanner
+    {
+        bool trustDirectoryTimes;
+        int64_t trustedBefore; // directory mtimes from before this can be trusted
+        TreeScanStats *stats;
+        const std::atomic<bool> *cancel;
+
+        bool Cancelled() const { return cancel != nullptr && cancel->load(std::memory_order_relaxed); }
+
+        bool Reusable(const TreeDirectory *previous, int64_t mtimeNs) const
+        {
+            return previous != nullptr && trustDirectoryTimes && previous->mtime_ns == mtimeNs && mtimeNs < trustedBefore;
+        }
+
+#ifdef _WIN32
+        static int64_t UnixNs(FILETIME time)
+        {
+            const int64_t ticks = (int64_t(time.dwHighDateTime) << 32) | time.dwLowDateTime;
+            return (ticks - 116444736000000000ll) * 100; // 100 ns ticks since 1601
+        }
+
+        void Scan(const NativePath &path, const TreeDirectory *previous, TreeDirectory *node, uint32_t depth)
+        {
+            WIN32_FILE_ATTRIBUTE_DATA attributes;
+            if (!GetFileAttributesExW(path.c_str(), GetFileExInfoStandard, &attributes)) return;
+            node->mtime_ns = UnixNs(attributes.ftLastWriteTime);
+            stats->directories++;
+
+            std::vector<NativePath> subdirectories;
+            if (Reusable(previous, node->mtime_ns))
+            {
+                node->files = previous->files;
+                for (const TreeDirectory &child : previous->directories) subdirectories.push_back(child.name);
+            }
+            else
+            {
+                // Listing returns sizes and times with the names: no per-file stat
+                stats->directories_listed++;
+                WIN32_FIND_DATAW data;
+                HANDLE find = FindFirstFileExW(Join(path, L"*").c_str(), FindExInfoBasic, &data, FindExSearchNameMatch, nullptr,
+                                               FIND_FIRST_EX_LARGE_FETCH);
+                if (find == INVALID_HANDLE_VALUE) return;
+                do
+                {
+                    if (std::wcscmp(data.cFileName, L".") == 0 || std::wcscmp(data.cFileName, L"..") == 0) continue;
+                    if (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)
+                    {
+                        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT)) subdirectories.push_back(data.cFileName);
+                        continue;
+                    }
+                    stats->file_stats++;
+                    node->files.push_back({data.cFileName, (uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow, UnixNs(data.ftLastWriteTime)});
+                } while (FindNextFileW(find, &data));
+                FindClose(find);
+                std::sort(node->files.begin(), node->files.end(), ByName<TreeFile>);
+                std::sort(subdirectories.begin(), subdirectories.end());
+            }
+
+            stats->files += node->files.size();
+            for (const NativePath &name : subdirectories)
+            {
+                if (depth >= kMaxDepth || Cancelled()) break;
+                TreeDirectory child;
+                child.name = name;
+                Scan(Join(path, name), previous != nullptr ? FindByName(previous->directories, name) : nullptr, &child, depth + 1);
+                if (child.mtime_ns != 0) node->directories.push_back(std::move(child));
+            }
+            node->hash = SummaryHash(*node);
+        }
+#else
+        static int64_t MtimeNs(const struct stat &st) { return int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec; }
+
+        // Takes ownership of directoryFd
+        void Scan(int directoryFd, const TreeDirectory *previous, TreeDirectory *node, uint32_t depth)
+        {
+            struct stat st;
+            if (fstat(directoryFd, &st) != 0)
+            {
+                close(directoryFd);
+                return;
+            }
+            node->mtime_ns = MtimeNs(st);
+            stats->directories++;
+
+            std::vector<NativePath> subdirectories;
+            if (Reusable(previous, node->mtime_ns))
+            {
+                node->files = previous->files;
+                for (const TreeDirectory &child : previous->directories) subdirectories.push_back(child.name);
+            }
+            else
+            {
+                stats->directories_listed++;
+                const int listFd = dup(directoryFd);
+                DIR *dir = listFd >= 0 ? fdopendir(listFd) : nullptr;
+                if (dir == nullptr)
+                {
+                    if (listFd >= 0) close(listFd);
+                    close(directoryFd);
+                    return;
+                }
+                while (const dirent *entry = readdir(dir))
+                {
+                    if (std::strcmp(entry->d_name, ".") == 0 || std::strcmp(entry->d_name, "..") == 0) continue;
+                    if (entry->d_type == DT_DIR)
+                    {
+                        subdirectories.push_back(entry->d_name);
+                        continue;
+                    }
+                    // Files behind symlinks count; directories behind them are not walked
+                    struct stat file;
+                    stats->file_stats++;
+                    if (fstatat(directoryFd, entry->d_name, &file, 0) != 0) continue;
+                    if (S_ISDIR(file.st_mode))
+                    {
+                        if (entry->d_type == DT_UNKNOWN) subdirectories.push_back(entry->d_name);
+                        continue;
+                    }
+                    if (S_ISREG(file.st_mode)) node->files.push_back({entry->d_name, static_cast<uint64_t>(file.st_size), MtimeNs(file)});
+                }
+                closedir(dir);
+                std::sort(node->files.begin(), node->files.end(), ByName<TreeFile>);
+                std::sort(subdirectories.begin(), subdirectories.end());
+            }
+
+            stats->files += node->files.size();
+            for (const NativePath &name : subdirectories)
+            {
+                if (depth >= kMaxDepth || Cancelled()) break;
+                const int childFd = openat(directoryFd, name.c_str(), O_RDONLY | O_DIRECTORY | O_NOFOLLOW | O_CLOEXEC);
+                if (childFd < 0) continue; // removed, or a symlink that d_type could not reveal
+                TreeDirectory child;
+                child.name = name;
+                Scan(childFd, previous != nullptr ? FindByName(previous->directories, name) : nullptr, &child, depth + 1);
+                if (child.mtime_ns != 0) node->directories.push_back(std::move(child));
+            }
+            close(directoryFd);
+            node->hash = SummaryHash(*node);
+        }
+#endif
+    };
+
+    // === Diffing ===
+
+    void EmitAdded(const NativePath &path, const TreeDirectory &directory, const std::function<void(FsChange &&)> &emit)
+    {
+        for (const TreeFile &file : directory.files) emit({Join(path, file.name), FsChangeKind::Added, false});
+        for (const TreeDirectory &child : directory.directories)
+        {
+            const NativePath childPath = Join(path, child.name);
+            emit({childPath, FsChangeKind::Added, true});
+            EmitAdded(childPath, child, emit);
+        }
+    }
+
+    void DiffDirectory(const NativePath &path, const TreeDirectory &before, const TreeDirectory &after,
+                       const std::function<void(FsChange &&)> &emit)
+    {
+        if (before.hash == after.hash) return;
+
+        auto b = before.files.begin();
+        auto a = after.files.begin();
+        while (b != before.files.end() || a != after.files.end())
+        {
+            if (a == after.files.end() || (b != before.files.end() && b->name < a->name))
+                emit({Join(path, (b++)->name), FsChangeKind::Removed, false});
+            else if (b == before.files.end() || a->name < b->name)
+                emit({Join(path, (a++)->name), FsChangeKind::Added, false});
+            else
+            {
+                if (b->size != a->size || b->mtime_ns != a->mtime_ns) emit({Join(path, a->name), FsChangeKind::Modified, false});
+                ++b;
+                ++a;
+            }
+        }
+
+        auto bd = before.directories.begin();
+        auto ad = after.directories.begin();
+        while (bd != before.directories.end() || ad != after.directories.end())
+        {
+            if (ad == after.directories.end() || (bd != before.directories.end() && bd->name < ad->name))
+                emit({Join(path, (bd++)->name), FsChangeKind::Removed, true});
+            else if (bd == before.directories.end() || ad->name < bd->name)
+            {
+                const NativePath childPath = Join(path, ad->name);
+                emit({childPath, FsChangeKind::Added, true});
+                EmitAdded(childPath, *ad++, emit);
+            }
+            else
+            {
+                DiffDirectory(Join(path, ad->name), *bd, *ad, emit);
+                ++bd;
+                ++ad;
+            }
+        }
+    }
+
+    // === Serialization ===
+
+    class Writer
+    {
+    public:
+        template <typename T>
+        void Put(const T &value)
+        {
+            const uint8_t *p = reinterpret_cast<const uint8_t *>(&value);
+            bytes_.insert(bytes_.end(), p, p + sizeof(T));
+        }
+
+        void PutName(const NativePath &name)
+        {
+            Put(static_cast<uint32_t>(name.size()));
+            const uint8_t *p = reinterpret_cast<const uint8_t *>(name.data());
+            bytes_.insert(bytes_.end(), p, p + name.size() * sizeof(PathChar));
+        }
+
+        void PutDirectory(const TreeDirectory &directory)
+        {
+            PutName(directory.name);
+            Put(directory.mtime_ns);
+            Put(directory.hash);
+            Put(static_cast<uint32_t>(directory.files.size()));
+            Put(static_cast<uint32_t>(directory.directories.size()));
+            for (const TreeFile &file : directory.files)
+            {
+                PutName(file.name);
+                Put(file.size);
+                Put(file.mtime_ns);
+            }
+            for (const TreeDirectory &child : directory.directories) PutDirectory(child);
+        }
+
+        const std::vector<uint8_t> &Bytes() const { return bytes_; }
+
+    private:
+        std::vector<uint8_t> bytes_;
+    };
+
+    class Reader
+    {
+    public:
+        Reader(const uint8_t *data, size_t length) : data_(data), length_(length) {}
+
+        template <typename T>
+        bool Get(T *value)
+        {
+            if (length_ - pos_ < sizeof(T)) return false;
+            std::memcpy(value, data_ + pos_, sizeof(T));
+            pos_ += sizeof(T);
+            return true;
+        }
+
+        bool GetName(NativePath *name)
+        {
+            uint32_t length;
+            if (!Get(&length) || (length_ - pos_) / sizeof(PathChar) < length) return false;
+            name->resize(length);
+            std::memcpy(&(*name)[0], data_ + pos_, length * sizeof(PathChar));
+            pos_ += length * sizeof(PathChar);
+            return true;
+        }
+
+        bool GetDirectory(TreeDirectory *directory, uint32_t depth)
+        {
+            uint32_t fileCount, directoryCount;
+            if (depth > kMaxDepth || !GetName(&directory->name) || !Get(&directory->mtime_ns) || !Get(&directory->hash) ||
+                !Get(&fileCount) || !Get(&directoryCount))
+                return false;
+            // Every entry takes at least its name length and two fields, so a damaged count fails here
+            if ((length_ - pos_) / 20 < uint64_t(fileCount) + directoryCount) return false;
+            directory->files.resize(fileCount);
+            for (TreeFile &file : directory->files)
+                if (!GetName(&file.name) || !Get(&file.size) || !Get(&file.mtime_ns)) return false;
+            directory->directories.resize(directoryCount);
+            for (TreeDirectory &child : directory->directories)
+                if (!GetDirectory(&child, depth + 1)) return false;
+            return true;
+        }
+
+        bool AtEnd() const { return pos_ == length_; }
+
+    private:
+        const uint8_t *data_;
+        size_t length_;
+        size_t pos_ = 0;
+    };
+
+    // Wide stderr on Windows only: a wide write elsewhere would orient stderr and silence every later narrow one
+    void LogPathError(const char *message, const std::filesystem::path &path, const std::string &detail = std::string())
+    {
+#ifdef _WIN32
+        std::wcerr << L"tree_summary | " << message << L" " << path.native();
+        if (!detail.empty()) std::wcerr << L": " << detail.c_str();
+        std::wcerr << std::endl;
+#else
+        std::cerr << "tree_summary | " << message << " " << NativePathToUtf8(path.native());
+        if (!detail.empty()) std::cerr << ": " << detail;
+        std::cerr << std::endl;
+#endif
+    }
+}
+
+bool ScanTree(const NativePath &root, const TreeSummary *previous, bool trustDirectoryTimes, TreeSummary *summary, TreeScanStats *stats,
+              const std::atomic<bool> *cancel)
+{
+    TreeScanStats ignored;
+    if (stats == nullptr) stats = &ignored;
+    *stats = TreeScanStats();
+    *summary = TreeSummary();
+    summary->root = root;
+    summary->scanned_at_ns = NowNs();
+
+    const TreeDirectory *reusable = previous != nullptr && previous->root == root ? &previous->tree : nullptr;
+    Scanner scanner{trustDirectoryTimes, reusable != nullptr ? previous->scanned_at_ns - kRacyWindowNs : 0, stats, cancel};
+#ifdef _WIN32
+    scanner.Scan(root, reusable, &summary->tree, 0);
+#else
+    const int rootFd = open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (rootFd < 0) return false;
+    scanner.Scan(rootFd, reusable, &summary->tree, 0);
+#endif
+    // A cancelled scan is missing subtrees; diffing or saving it would report them removed
+    return summary->tree.mtime_ns != 0 && !scanner.Cancelled();
+}
+
+void DiffTrees(const TreeSummary &previous, const TreeSummary &current, const std::function<void(FsChange &&)> &emit)
+{
+    if (previous.root != current.root)
+    {
+        EmitAdded(current.root, current.tree, emit);
+        return;
+    }
+    DiffDirectory(current.root, previous.tree, current.tree, emit);
+}
+
+bool SaveTreeSummary(const NativePath &file, const TreeSummary &summary)
+{
+    Writer writer;
+    for (char c : kMagic) writer.Put(c);
+    writer.Put(kVersion);
+    writer.Put(static_cast<uint32_t>(sizeof(PathChar)));
+    writer.PutName(summary.root);
+    writer.Put(summary.scanned_at_ns);
+    writer.PutDirectory(summary.tree);
+
+    const std::filesystem::path target(file);
+    std::filesystem::path temporary = target;
+    temporary += PATH_LITERAL(".tmp");
+    {
+        std::ofstream out(temporary, std::ios::binary | std::ios::trunc);
+        out.write(reinterpret_cast<const char *>(writer.Bytes().data()), static_cast<std::streamsize>(writer.Bytes().size()));
+        out.flush();
+        if (!out)
+        {
+            LogPathError("Failed writing", temporary);
+            out.close();
+            std::error_code ignored;
+            std::filesystem::remove(temporary, ignored);
+            return false;
+        }
+    }
+    std::error_code error;
+    std::filesystem::rename(temporary, target, error);
+    if (error)
+    {
+        LogPathError("Cannot replace", target, error.message());
+        std::filesystem::remove(temporary, error);
+        return false;
+    }
+    return true;
+}
+
+bool LoadTreeSummary(const NativePath &file, TreeSummary *summary)
+{
+    std::ifstream in(std::filesystem::path(file), std::ios::binary);
+    if (!in) return false;
+    const std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    Reader reader(bytes.data(), bytes.size());
+    char magic[sizeof(kMagic)];
+    uint32_t version, unit;
+    for (char &c : magic)
+        if (!reader.Get(&c)) return false;
+    if (std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 || !reader.Get(&version) || version != kVersion || !reader.Get(&unit) ||
+        unit != sizeof(PathChar))
+        return false;
+
+    TreeSummary loaded;
+    if (!reader.GetName(&loaded.root) || !reader.Get(&loaded.scanned_at_ns) || !reader.GetDirectory(&loaded.tree, 0) || !reader.AtEnd())
+        return false;
+    *summary = std::move(loaded);
+    return true;
+}
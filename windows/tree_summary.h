@@ -0,0 +1,76 @@
+#ifndef TREE_SUMMARY_H
+#define TREE_SUMMARY_H
+
+#include "fs_watcher.h"
+#include "native_path.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <vector>
+
+struct TreeFile
+{
+    NativePath name;
+    uint64_t size = 0;
+    int64_t mtime_ns = 0; // since the Unix epoch
+};
+
+// One directory of a scanned tree. Entries are sorted by name; hash covers every
+// name, size and mtime below, so equal hashes mean identical subtrees.
+struct TreeDirectory
+{
+    NativePath name;
+    int64_t mtime_ns = 0;
+    uint64_t hash = 0;
+    std::vector<TreeFile> files;
+    std::vector<TreeDirectory> directories;
+};
+
+struct TreeSummary
+{
+    NativePath root;
+    int64_t scanned_at_ns = 0; // wall clock when the scan started
+    TreeDirectory tree;
+};
+
+struct TreeScanStats
+{
+    uint64_t directories = 0;        // stat'ed
+    uint64_t directories_listed = 0; // whose entries were read again
+    uint64_t files = 0;              // in the new tree
+    uint64_t file_stats = 0;         // files stat'ed
+};
+
+/**
+ * @brief Scans the tree under @p root, reusing @p previous where it is still valid.
+ *
+ * A directory's mtime changes when an entry is added, removed or renamed in it,
+ * so a directory whose mtime matches its summary keeps its entries from there:
+ * it is neither listed nor are its files stat'ed, and only its subdirectories
+ * are visited. Writes into an existing file leave the directory mtime alone;
+ * they are the watcher's to report, or pass @p trustDirectoryTimes false to
+ * list and stat everything. Directories whose mtime falls within the timestamp
+ * granularity of the previous scan are always listed, since a change made in
+ * the same tick as that scan would not have moved it. Symlinked directories are
+ * not followed. Setting @p cancel stops the scan before the next directory.
+ *
+ * @return false if @p root is not a readable directory or the scan was cancelled
+ */
+bool ScanTree(const NativePath &root, const TreeSummary *previous, bool trustDirectoryTimes, TreeSummary *summary,
+              TreeScanStats *stats, const std::atomic<bool> *cancel = nullptr);
+
+/**
+ * @brief Reports what differs between two summaries of the same root.
+ *
+ * Descends only where subtree hashes differ, so the cost follows the size of
+ * the change rather than of the tree. A new directory is reported with
+ * everything under it; a removed one as the directory alone, as the watcher
+ * does.
+ */
+void DiffTrees(const TreeSummary &previous, const TreeSummary &current, const std::function<void(FsChange &&)> &emit);
+
+// Host-order binary file, replaced atomically.
+bool SaveTreeSummary(const NativePath &file, const TreeSummary &summary);
+bool LoadTreeSummary(const NativePath &file, TreeSummary *summary);
+
+#endif // TREE_SUMMARY_H
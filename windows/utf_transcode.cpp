@@ -0,0 +1,207 @@
+#include "utf_transcode.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define VDU_HAVE_SSE2 1
+#endif
+
+namespace
+{
+    constexpr char16_t kReplacementChar = 0xFFFD;
+
+    inline bool IsContinuation(uint8_t b) { return (b & 0xC0) == 0x80; }
+
+    // Decodes one code point starting at in[i]. Returns the number of bytes consumed
+    // (always >= 1) and stores the code point, or U+FFFD for a malformed sequence.
+    size_t DecodeUtf8(const uint8_t *in, size_t remaining, uint32_t *codePoint)
+    {
+        const uint8_t b0 = in[0];
+        if (b0 < 0x80)
+        {
+            *codePoint = b0;
+            return 1;
+        }
+
+        size_t needed;
+        uint8_t lo = 0x80, hi = 0xBF;
+        uint32_t cp;
+        if (b0 >= 0xC2 && b0 <= 0xDF)
+        {
+            needed = 1;
+            cp = b0 & 0x1F;
+        }
+        else if (b0 >= 0xE0 && b0 <= 0xEF)
+        {
+            needed = 2;
+            cp = b0 & 0x0F;
+            if (b0 == 0xE0) lo = 0xA0;      // overlong
+            else if (b0 == 0xED) hi = 0x9F; // surrogates
+        }
+        else if (b0 >= 0xF0 && b0 <= 0xF4)
+        {
+            needed = 3;
+            cp = b0 & 0x07;
+            if (b0 == 0xF0) lo = 0x90;      // overlong
+            else if (b0 == 0xF4) hi = 0x8F; // > U+10FFFF
+        }
+        else
+        {
+            *codePoint = kReplacementChar;
+            return 1;
+        }
+
+        // Consume the maximal valid prefix on error so one bad byte yields one U+FFFD.
+        for (size_t k = 1; k <= needed; k++)
+        {
+            if (k >= remaining)
+            {
+                *codePoint = kReplacementChar;
+                return k;
+            }
+            const uint8_t b = in[k];
+            const bool ok = (k == 1) ? (b >= lo && b <= hi) : IsContinuation(b);
+            if (!ok)
+            {
+                *codePoint = kReplacementChar;
+                return k;
+            }
+            cp = (cp << 6) | (b & 0x3F);
+        }
+        *codePoint = cp;
+        return needed + 1;
+    }
+
+    inline size_t EncodeUtf8(uint32_t cp, char *out)
+    {
+        if (cp < 0x80)
+        {
+            out[0] = static_cast<char>(cp);
+            return 1;
+        }
+        if (cp < 0x800)
+        {
+            out[0] = static_cast<char>(0xC0 | (cp >> 6));
+            out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+            return 2;
+        }
+        if (cp < 0x10000)
+        {
+            out[0] = static_cast<char>(0xE0 | (cp >> 12));
+            out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+            out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+            return 3;
+        }
+        out[0] = static_cast<char>(0xF0 | (cp >> 18));
+        out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+        out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+        out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+        return 4;
+    }
+}
+
+size_t Utf8ToUtf16(const char *in, size_t length, char16_t *out)
+{
+    const uint8_t *src = reinterpret_cast<const uint8_t *>(in);
+    size_t i = 0, o = 0;
+    while (i < length)
+    {
+#ifdef VDU_HAVE_SSE2
+        // Paths are overwhelmingly ASCII: widen 16 bytes per iteration until a
+        // byte with the high bit set shows up.
+        const __m128i zero = _mm_setzero_si128();
+        while (i + 16 <= length)
+        {
+            const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+            if (_mm_movemask_epi8(chunk) != 0) break;
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + o), _mm_unpacklo_epi8(chunk, zero));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + o + 8), _mm_unpackhi_epi8(chunk, zero));
+            i += 16;
+            o += 16;
+        }
+        if (i >= length) break;
+#endif
+        if (src[i] < 0x80)
+        {
+            out[o++] = src[i++];
+            continue;
+        }
+
+        uint32_t cp;
+        i += DecodeUtf8(src + i, length - i, &cp);
+        if (cp >= 0x10000)
+        {
+            cp -= 0x10000;
+            out[o++] = static_cast<char16_t>(0xD800 | (cp >> 10));
+            out[o++] = static_cast<char16_t>(0xDC00 | (cp & 0x3FF));
+        }
+        else
+        {
+            out[o++] = static_cast<char16_t>(cp);
+        }
+    }
+    return o;
+}
+
+size_t Utf16ToUtf8(const char16_t *in, size_t length, char *out)
+{
+    size_t i = 0, o = 0;
+    while (i < length)
+    {
+#ifdef VDU_HAVE_SSE2
+        const __m128i asciiMask = _mm_set1_epi16(static_cast<short>(0xFF80));
+        const __m128i zero = _mm_setzero_si128();
+        while (i + 8 <= length)
+        {
+            const __m128i units = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in + i));
+            const __m128i high = _mm_cmpeq_epi16(_mm_and_si128(units, asciiMask), zero);
+            if (_mm_movemask_epi8(high) != 0xFFFF) break;
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + o), _mm_packus_epi16(units, units));
+            i += 8;
+            o += 8;
+        }
+        if (i >= length) break;
+#endif
+        uint32_t cp = in[i++];
+        if (cp >= 0xD800 && cp <= 0xDBFF)
+        {
+            if (i < length && in[i] >= 0xDC00 && in[i] <= 0xDFFF)
+                cp = 0x10000 + ((cp - 0xD800) << 10) + (in[i++] - 0xDC00);
+            else
+                cp = kReplacementChar;
+        }
+        else if (cp >= 0xDC00 && cp <= 0xDFFF)
+        {
+            cp = kReplacementChar;
+        }
+        o += EncodeUtf8(cp, out + o);
+    }
+    return o;
+}
+
+NativePath Utf8ToNativePath(const char *utf8, size_t length)
+{
+#ifdef _WIN32
+    static_assert(sizeof(wchar_t) == sizeof(char16_t), "Windows paths are UTF-16");
+    NativePath result(length, L'\0');
+    const size_t written = Utf8ToUtf16(utf8, length, reinterpret_cast<char16_t *>(&result[0]));
+    result.resize(written);
+    return result;
+#else
+    // POSIX filenames are opaque bytes; Dart already hands us UTF-8.
+    return NativePath(utf8, length);
+#endif
+}
+
+std::string NativePathToUtf8(NativePathView path)
+{
+#ifdef _WIN32
+    std::string result(path.size() * 3, '\0');
+    const size_t written = Utf16ToUtf8(reinterpret_cast<const char16_t *>(path.data()), path.size(), &result[0]);
+    result.resize(written);
+    return result;
+#else
+    return std::string(path);
+#endif
+}
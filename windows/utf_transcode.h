@@ -0,0 +1,35 @@
+#ifndef UTF_TRANSCODE_H
+#define UTF_TRANSCODE_H
+
+#include "native_path.h"
+#include <cstddef>
+#include <string>
+
+/**
+ * @brief Transcodes UTF-8 to UTF-16.
+ *
+ * ASCII runs are widened 16 bytes at a time with SSE2 when available; other
+ * sequences are decoded one code point at a time. Malformed input becomes U+FFFD.
+ *
+ * @param in UTF-8 input (not necessarily NUL-terminated)
+ * @param length Number of bytes in @p in
+ * @param out Output buffer, must hold at least @p length code units
+ * @return Number of UTF-16 code units written
+ */
+size_t Utf8ToUtf16(const char *in, size_t length, char16_t *out);
+
+/**
+ * @brief Transcodes UTF-16 to UTF-8.
+ *
+ * @param out Output buffer, must hold at least 3 * @p length bytes
+ * @return Number of bytes written. Unpaired surrogates become U+FFFD.
+ */
+size_t Utf16ToUtf8(const char16_t *in, size_t length, char *out);
+
+// Converts UTF-8 from the Dart side into the platform's path encoding.
+NativePath Utf8ToNativePath(const char *utf8, size_t length);
+
+// Converts a native path back to UTF-8 for callers that cannot read UTF-16.
+std::string NativePathToUtf8(NativePathView path);
+
+#endif // UTF_TRANSCODE_H
@@ -1,11 +1,45 @@
 #include "video_data_exporter_api.h"
+#include "adaptive_concurrency.h"
+#include "batch_probe.h"
+#include "bitrate_timeline.h"
+#include "buffer_pool.h"
+#include "content_sniffer.h"
+#include "directory_walker.h"
+#include "file_identity.h"
+#include "file_metadata.h"
+#include "file_probe.h"
+#include "hot_cache.h"
+#include "keyframe_index.h"
+#include "library_snapshot.h"
+#include "path_arena.h"
+#include "perceptual_hash.h"
+#include "probe_cache.h"
+#include "probe_daemon.h"
+#include "shell_link.h"
+#include "similarity_index.h"
+#include "thumbnail_atlas.h"
+#include "thumbnail_cache.h"
+#include "thumbnail_window.h"
+#include "utf_transcode.h"
+#include "watch_service.h"
+#include "worker_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include <cstring>
+#include <iostream>
+
+#ifdef _WIN32
 #include "thumbnail_exporter.h"
 #include "video_duration.h"
 #include "shortcut_resolver.h"
-#include <memory>
 #include <gdiplus.h>
 #include <mfapi.h>
-#include <iostream>
 
 class GdiplusInit
 {
@@ -26,10 +60,18 @@ private:
 
 std::unique_ptr<GdiplusInit> gdiplus_initializer;
 
+namespace
+{
+    // Pixel memory of a 32-bit thumbnail filling a size x size box
+    uint64_t ThumbnailBytes(unsigned int size) { return uint64_t(size) * size * 4; }
+}
+#endif
+
 API_EXPORT void initialize_exporter()
 {
     try
     {
+#ifdef _WIN32
         // Initialize COM and Media Foundation
         CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED);
         MFStartup(MF_VERSION, MFSTARTUP_FULL);
@@ -38,6 +80,7 @@ API_EXPORT void initialize_exporter()
             // Initialize GDI+ only once
             gdiplus_initializer = std::make_unique<GdiplusInit>();
         }
+#endif
     }
     catch (const std::exception &e)
     {
@@ -45,94 +88,90 @@ API_EXPORT void initialize_exporter()
     }
 }
 
-API_EXPORT bool get_thumbnail(const wchar_t *video_path, const wchar_t *output_path, unsigned int size)
+API_EXPORT bool get_thumbnail(const PathChar *video_path, const PathChar *output_path, unsigned int size)
 {
     if (video_path == nullptr || output_path == nullptr) return false;
+    if (DaemonClient::Instance().Thumbnail(video_path, output_path, size) == DaemonReply::Ok) return true;
+#ifdef _WIN32
+    // Thumbnails in flight are bounded by the pixel budget; callers wait here when it is spent
+    MemoryBudget::Lease lease = MemoryBudget::Thumbnails().Acquire(ThumbnailBytes(size));
     return GetExplorerThumbnail(video_path, output_path, size);
+#else
+    (void)size;
+    return false;
+#endif
 }
 
-API_EXPORT double get_video_duration(const wchar_t *video_path)
+API_EXPORT double get_video_duration(const PathChar *video_path)
 {
     if (video_path == nullptr) return 0.0;
+    double remote = 0.0;
+    if (DaemonClient::Instance().Duration(video_path, &remote) == DaemonReply::Ok) return remote;
+
+    // MP4/MOV, Matroska/WebM, AVI, ASF, FLV, Ogg and MPEG-TS are read natively from a few header ranges
+    BatchProbeResult probe;
+    ProbeFileDuration(video_path, &probe);
+    if (probe.has_duration) return probe.duration_ms;
+
+#ifdef _WIN32
+    // Subtitles, NFOs, images and archives never reach the media parser
+    ContainerKind kind = probe.container;
+    if (kind == ContainerKind::Unknown && probe.opened) kind = SniffFile(video_path); // transport streams may need the tail
+    if (!IsMediaContainer(kind)) return 0.0;
     return GetVideoFileDuration(video_path);
+#else
+    return 0.0;
+#endif
 }
 
-API_EXPORT bool get_file_metadata(const wchar_t *file_path, struct FileMetadata *metadata)
+API_EXPORT bool get_file_metadata(const PathChar *file_path, struct FileMetadata *metadata)
 {
     try
     {
         // Ensure file path is not null or empty
-        if (file_path == nullptr || wcslen(file_path) == 0)
+        if (file_path == nullptr || file_path[0] == 0)
         {
-            std::wcerr << L"video_data_exporter | Invalid file path for file: '" << (file_path ? file_path : L"null") << L"'" << std::endl;
+            PATH_CERR << PATH_LITERAL("video_data_exporter | Invalid file path for file: '") << (file_path ? file_path : PATH_LITERAL("null")) << PATH_LITERAL("'") << std::endl;
             return false;
         }
 
         // Ensure metadata pointer is not null
         if (metadata == nullptr)
         {
-            std::wcerr << L"video_data_exporter | Metadata pointer is null for file: " << file_path << std::endl;
+            PATH_CERR << PATH_LITERAL("video_data_exporter | Metadata pointer is null for file: ") << file_path << std::endl;
             return false;
         }
 
-        // Use GetFileAttributesEx to retrieve file attributes
-        WIN32_FILE_ATTRIBUTE_DATA fileAttrData;
-        if (GetFileAttributesExW(file_path, GetFileExInfoStandard, &fileAttrData))
-        {
-            // Convert FILETIME to milliseconds since epoch
-            ULARGE_INTEGER creationTime, accessTime, modifiedTime;
-            creationTime.LowPart = fileAttrData.ftCreationTime.dwLowDateTime;
-            creationTime.HighPart = fileAttrData.ftCreationTime.dwHighDateTime;
-            accessTime.LowPart = fileAttrData.ftLastAccessTime.dwLowDateTime;
-            accessTime.HighPart = fileAttrData.ftLastAccessTime.dwHighDateTime;
-            modifiedTime.LowPart = fileAttrData.ftLastWriteTime.dwLowDateTime;
-            modifiedTime.HighPart = fileAttrData.ftLastWriteTime.dwHighDateTime;
-
-            // Calculate file size
-            ULARGE_INTEGER fileSize;
-            fileSize.HighPart = fileAttrData.nFileSizeHigh;
-            fileSize.LowPart = fileAttrData.nFileSizeLow;
-
-            // Use your exact, proven conversion logic
-            const int64_t WINDOWS_TICK = 10000000;
-            const int64_t SEC_TO_UNIX_EPOCH = 11644473600LL;
+        if (ReadFileMetadata(file_path, metadata)) return true;
 
-            // Fill the metadata structure
-            metadata->creation_time_ms = (creationTime.QuadPart / (WINDOWS_TICK / 1000)) - (SEC_TO_UNIX_EPOCH * 1000);
-            metadata->access_time_ms = (accessTime.QuadPart / (WINDOWS_TICK / 1000)) - (SEC_TO_UNIX_EPOCH * 1000);
-            metadata->modified_time_ms = (modifiedTime.QuadPart / (WINDOWS_TICK / 1000)) - (SEC_TO_UNIX_EPOCH * 1000);
-            metadata->file_size_bytes = fileSize.QuadPart;
-
-            return true;
-        }
-
-        std::wcerr << L"video_data_exporter | Failed to retrieve file attributes for: " << file_path << std::endl;
+        PATH_CERR << PATH_LITERAL("video_data_exporter | Failed to retrieve file attributes for: ") << file_path << std::endl;
         return false;
     }
     catch (const std::exception &e)
     {
-        std::wcerr << L"video_data_exporter | Exception occurred when getting file metadata for file: " << file_path << L": " << e.what() << std::endl;
+        PATH_CERR << PATH_LITERAL("video_data_exporter | Exception occurred when getting file metadata for file: ") << file_path << PATH_LITERAL(": ") << e.what() << std::endl;
         return false;
     }
 
-    std::wcerr << L"video_data_exporter | Failed to retrieve file attributes for file: " << file_path << L": Unknown error." << std::endl;
+    PATH_CERR << PATH_LITERAL("video_data_exporter | Failed to retrieve file attributes for file: ") << file_path << PATH_LITERAL(": Unknown error.") << std::endl;
     return false;
 }
 
-API_EXPORT bool resolve_shortcut(const wchar_t *shortcut_path, wchar_t *target_path, int buffer_size) {
+API_EXPORT bool resolve_shortcut(const PathChar *shortcut_path, PathChar *target_path, int buffer_size) {
     try {
         // Ensure shortcut path is not null or empty
-        if (shortcut_path == nullptr || wcslen(shortcut_path) == 0) {
-            std::wcerr << L"video_data_exporter | Invalid shortcut path" << std::endl;
+        if (shortcut_path == nullptr || shortcut_path[0] == 0) {
+            std::cerr << "video_data_exporter | Invalid shortcut path" << std::endl;
             return false;
         }
 
         // Ensure target path buffer is not null
         if (target_path == nullptr || buffer_size <= 0) {
-            std::wcerr << L"video_data_exporter | Invalid target path buffer" << std::endl;
+            std::cerr << "video_data_exporter | Invalid target path buffer" << std::endl;
             return false;
         }
 
+#ifdef _WIN32
         // Call the shortcut resolver directly using wide character strings natively
         HRESULT hres = ResolveShortcut(NULL, shortcut_path, target_path, buffer_size);
 
@@ -141,8 +180,1216 @@ API_EXPORT bool resolve_shortcut(const wchar_t *shortcut_path, wchar_t *target_p
             std::wcerr << L"video_data_exporter | Failed to resolve shortcut. HRESULT: 0x" << std::hex << hres << std::endl;
             return false;
         }
+#else
+        return false;
+#endif
     } catch (const std::exception &e) {
-        std::wcerr << L"video_data_exporter | Exception occurred when resolving shortcut: " << e.what() << std::endl;
+        std::cerr << "video_data_exporter | Exception occurred when resolving shortcut: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+// === Path arena ===
+
+API_EXPORT uint32_t path_arena_intern(const char *utf8_path, uint32_t length)
+{
+    return PathArena::Instance().InternUtf8(utf8_path, length);
+}
+
+API_EXPORT uint32_t path_arena_intern_batch(const char *utf8_paths, const uint32_t *offsets, uint32_t count, uint32_t *out_ids)
+{
+    if (utf8_paths == nullptr || offsets == nullptr || out_ids == nullptr) return 0;
+
+    PathArena &arena = PathArena::Instance();
+    uint32_t interned = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (offsets[i + 1] < offsets[i])
+        {
+            out_ids[i] = kInvalidPathId;
+            continue;
+        }
+        out_ids[i] = arena.InternUtf8(utf8_paths + offsets[i], offsets[i + 1] - offsets[i]);
+        if (out_ids[i] != kInvalidPathId) interned++;
+    }
+    return interned;
+}
+
+API_EXPORT const PathChar *path_arena_get(uint32_t path_id, uint32_t *length)
+{
+    NativePathView path;
+    if (!PathArena::Instance().Get(path_id, &path))
+    {
+        if (length != nullptr) *length = 0;
+        return nullptr;
+    }
+    if (length != nullptr) *length = static_cast<uint32_t>(path.size());
+    return path.data();
+}
+
+API_EXPORT uint32_t path_arena_count()
+{
+    return static_cast<uint32_t>(PathArena::Instance().Count());
+}
+
+namespace
+{
+    // The stat behind a by-ID call, which also tells which file the path names where the platform returns it
+    bool StatById(uint32_t pathId, const PathChar *path, FileMetadata *current)
+    {
+        FileIdentity identity;
+        if (!ReadFileMetadata(path, current, &identity)) return false;
+        FileIdentityIndex::Instance().Record(pathId, identity);
+        return true;
+    }
+
+    // A hardlink of a video thumbnailed before gets a copy of that thumbnail instead of a render
+    bool CopySiblingThumbnail(uint32_t videoId, const PathChar *output, unsigned int size)
+    {
+        for (const uint32_t sibling : FileIdentityIndex::Instance().Siblings(videoId))
+        {
+            uint32_t siblingOutput = kInvalidPathId;
+            const PathChar *source = ThumbnailCache::Instance().Find(sibling, size, &siblingOutput) ? path_arena_get(siblingOutput, nullptr) : nullptr;
+            std::error_code error;
+            if (source == nullptr || !std::filesystem::copy_file(source, output, std::filesystem::copy_options::overwrite_existing, error)) continue;
+            const uintmax_t bytes = std::filesystem::file_size(path_arena_get(videoId, nullptr), error);
+            FileIdentityIndex::Instance().NoteShared(SharedWork::Thumbnail, error ? 0 : static_cast<uint64_t>(bytes));
+            return true;
+        }
+        return false;
+    }
+}
+
+API_EXPORT bool get_thumbnail_by_id(uint32_t video_id, uint32_t output_id, unsigned int size)
+{
+    const PathChar *video = path_arena_get(video_id, nullptr);
+    const PathChar *output = path_arena_get(output_id, nullptr);
+    if (video == nullptr || output == nullptr) return false;
+    if (!CopySiblingThumbnail(video_id, output, size) && !get_thumbnail(video, output, size)) return false;
+    // Remembered so a change to the video can delete the stale thumbnail
+    ThumbnailCache::Instance().Record(video_id, output_id, size);
+    return true;
+}
+
+API_EXPORT double get_video_duration_by_id(uint32_t path_id)
+{
+    // Asked again on every rebuild of a view; a recent answer is given without a stat
+    HotResult hot;
+    if (HotCache::Instance().Find(path_id, true, &hot)) return hot.duration_ms;
+
+    const PathChar *path = path_arena_get(path_id, nullptr);
+    if (path == nullptr) return 0.0;
+    // A running daemon keeps the cache for every process
+    double remote = 0.0;
+    if (DaemonClient::Instance().Duration(path, &remote) == DaemonReply::Ok) return remote;
+    DaemonClient::LocalScope local;
+
+    // A cached duration is only reused while the file's size and mtime are unchanged
+    FileMetadata current;
+    if (!StatById(path_id, path, &current)) return 0.0;
+
+    hot.metadata = current;
+    hot.has_metadata = true;
+    hot.has_duration = true;
+    ProbeEntry entry;
+    if (ProbeCache::Instance().Lookup(path_id, &entry) && entry.has_duration && ProbeEntryMatches(entry, current))
+    {
+        hot.duration_ms = entry.duration_ms;
+        HotCache::Instance().Put(path_id, hot);
+        return entry.duration_ms;
+    }
+
+    const double duration = get_video_duration(path);
+    ProbeCache::Instance().Update(path_id, current, [duration](ProbeEntry &cached) {
+        cached.duration_ms = duration;
+        cached.has_duration = true;
+    });
+    hot.duration_ms = duration;
+    HotCache::Instance().Put(path_id, hot);
+    return duration;
+}
+
+API_EXPORT bool get_file_metadata_by_id(uint32_t path_id, struct FileMetadata *metadata)
+{
+    HotResult hot;
+    if (metadata != nullptr && HotCache::Instance().Find(path_id, false, &hot))
+    {
+        *metadata = hot.metadata;
+        return true;
+    }
+    if (!get_file_metadata(path_arena_get(path_id, nullptr), metadata)) return false;
+    hot.metadata = *metadata;
+    hot.has_metadata = true;
+    HotCache::Instance().Put(path_id, hot);
+    return true;
+}
+
+namespace
+{
+    void ResolveShortcutEntry(uint32_t shortcut_id, ShortcutTarget *out)
+    {
+        *out = {kInvalidPathId, 0, 0, 0};
+        const PathChar *path = path_arena_get(shortcut_id, nullptr);
+        FileMetadata current;
+        if (path == nullptr || !StatById(shortcut_id, path, &current)) return;
+
+        ProbeEntry entry;
+        std::shared_ptr<const ShellLinkTargets> link;
+        if (ProbeCache::Instance().Lookup(shortcut_id, &entry) && ProbeEntryMatches(entry, current)) link = entry.shortcut;
+        if (!link)
+        {
+            auto parsed = std::make_shared<ShellLinkTargets>();
+            std::unique_ptr<ByteSource> source = OpenFileSource(path, AccessPattern::Sequential);
+            if (source) ParseShellLink(*source, path, parsed.get());
+            link = parsed;
+            ProbeCache::Instance().Update(shortcut_id, current, [&link](ProbeEntry &cached) { cached.shortcut = link; });
+        }
+
+        // Existence is checked on every call; only the parse is cached
+        NativePath target;
+        bool exists = false;
+        ShortcutSource source = SelectShortcutTarget(*link, &target, &exists);
+#ifdef _WIN32
+        // The shell can track a target that moved since the link was written
+        std::wstring tracked;
+        FileMetadata trackedMetadata;
+        if (!exists && SUCCEEDED(ResolveShortcutTarget(path, &tracked)) && ReadFileMetadata(tracked.c_str(), &trackedMetadata))
+        {
+            target = std::move(tracked);
+            source = ShortcutSource::Shell;
+            exists = true;
+        }
+#endif
+        if (source == ShortcutSource::None) return;
+        out->target_id = PathArena::Instance().Intern(target);
+        if (out->target_id == kInvalidPathId) return;
+        out->source = static_cast<uint8_t>(source);
+        out->target_exists = exists ? 1 : 0;
+    }
+}
+
+API_EXPORT bool resolve_shortcut_by_id(uint32_t shortcut_id, uint32_t *target_id)
+{
+    if (target_id == nullptr) return false;
+    *target_id = kInvalidPathId;
+
+    if (path_arena_get(shortcut_id, nullptr) == nullptr)
+    {
+        std::cerr << "video_data_exporter | Unknown shortcut path id: " << shortcut_id << std::endl;
+        return false;
+    }
+
+    try
+    {
+        ShortcutTarget result;
+        ResolveShortcutEntry(shortcut_id, &result);
+        *target_id = result.target_id;
+        return *target_id != kInvalidPathId;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "video_data_exporter | Exception occurred when resolving shortcut: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+API_EXPORT uint32_t resolve_shortcuts_batch(const uint32_t *shortcut_ids, uint32_t count, struct ShortcutTarget *out_targets)
+{
+    if (shortcut_ids == nullptr || out_targets == nullptr) return 0;
+
+    // Each link is one small read plus a stat or two per candidate, so they overlap well
+    WorkerPool::Instance().ParallelFor(count, [shortcut_ids, out_targets](size_t i) {
+        out_targets[i] = {kInvalidPathId, 0, 0, 0};
+        ResolveShortcutEntry(shortcut_ids[i], &out_targets[i]);
+    });
+
+    uint32_t resolved = 0;
+    for (uint32_t i = 0; i < count; i++)
+        if (out_targets[i].target_id != kInvalidPathId) resolved++;
+    return resolved;
+}
+
+API_EXPORT uint32_t get_file_metadata_batch(const uint32_t *path_ids, uint32_t count, struct FileMetadata *out_metadata, bool *out_ok)
+{
+    if (path_ids == nullptr || out_metadata == nullptr) return 0;
+
+    uint32_t succeeded = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        HotResult hot;
+        bool ok = HotCache::Instance().Find(path_ids[i], false, &hot);
+        if (ok)
+        {
+            out_metadata[i] = hot.metadata;
+        }
+        else
+        {
+            const PathChar *path = path_arena_get(path_ids[i], nullptr);
+            ok = path != nullptr && ReadFileMetadata(path, &out_metadata[i]);
+            hot.metadata = out_metadata[i];
+            hot.has_metadata = true;
+            if (ok) HotCache::Instance().Put(path_ids[i], hot);
+        }
+        if (!ok) std::memset(&out_metadata[i], 0, sizeof(FileMetadata));
+        if (out_ok != nullptr) out_ok[i] = ok;
+        if (ok) succeeded++;
+    }
+    return succeeded;
+}
+
+namespace
+{
+    // ProbeOrder of the batches below; see set_batch_probe_order
+    std::atomic<uint8_t> batchProbeOrder{static_cast<uint8_t>(ProbeOrder::AsGiven)};
+
+    // Up-to-date probe entries for many files: cached entries are revalidated one by one,
+    // everything else is probed as one batch and cached, each file once however many of
+    // its hardlinks the batch names. found[i] is 0 for missing files.
+    void ProbeEntriesBatch(const uint32_t *path_ids, uint32_t count, std::vector<ProbeEntry> *entries, std::vector<uint8_t> *found)
+    {
+        entries->assign(count, ProbeEntry());
+        found->assign(count, 0);
+
+        std::vector<uint32_t> pending;
+        std::vector<const PathChar *> paths;
+        std::unordered_map<FileIdentity, size_t, FileIdentityHash> pendingFiles; // -> index into pending
+        std::vector<std::pair<uint32_t, size_t>> duplicates;                     // entries answered by a pending one
+        for (uint32_t i = 0; i < count; i++)
+        {
+            const PathChar *path = path_arena_get(path_ids[i], nullptr);
+            if (path == nullptr) continue;
+
+            ProbeEntry entry;
+            FileMetadata current;
+            if (ProbeCache::Instance().Lookup(path_ids[i], &entry) && entry.has_duration && StatById(path_ids[i], path, &current) &&
+                ProbeEntryMatches(entry, current))
+            {
+                entry.metadata = current; // the cached access time may be stale
+                (*entries)[i] = std::move(entry);
+                (*found)[i] = 1;
+                continue;
+            }
+            FileIdentity identity;
+            if (FileIdentityIndex::Instance().Find(path_ids[i], &identity))
+            {
+                auto first = pendingFiles.emplace(identity, pending.size());
+                if (!first.second)
+                {
+                    duplicates.emplace_back(i, first.first->second);
+                    continue;
+                }
+            }
+            pending.push_back(i);
+            paths.push_back(path);
+        }
+
+        std::vector<BatchProbeResult> results;
+        BatchProbeOptions options;
+        options.order = static_cast<ProbeOrder>(batchProbeOrder.load());
+        ProbeDurationsBatch(paths, &results, options);
+
+        for (size_t j = 0; j < pending.size(); j++)
+        {
+            const uint32_t i = pending[j];
+            const BatchProbeResult &result = results[j];
+            if (result.metadata.file_size_bytes == 0 && !result.opened) continue; // missing or unreadable
+
+            double duration = result.duration_ms;
+#ifdef _WIN32
+            // Containers without a native parser still go through Media Foundation
+            if (!result.has_duration && IsMediaContainer(result.container)) duration = GetVideoFileDuration(paths[j]);
+#endif
+            const ContainerKind container = result.container;
+            ProbeCache::Instance().Update(path_ids[i], result.metadata, [duration, container](ProbeEntry &cached) {
+                cached.duration_ms = duration;
+                cached.has_duration = true;
+                cached.container = container;
+            });
+            // Keeps what other probes cached for this file state (hashes, keyframes)
+            ProbeEntry &entry = (*entries)[i];
+            ProbeCache::Instance().Lookup(path_ids[i], &entry);
+            entry.metadata = result.metadata;
+            entry.duration_ms = duration;
+            entry.has_duration = true;
+            entry.container = container;
+            (*found)[i] = 1;
+        }
+
+        for (const auto &duplicate : duplicates)
+        {
+            const uint32_t first = pending[duplicate.second];
+            if (!(*found)[first]) continue;
+            (*entries)[duplicate.first] = (*entries)[first];
+            (*found)[duplicate.first] = 1;
+            FileIdentityIndex::Instance().NoteShared(SharedWork::Probe, static_cast<uint64_t>((*entries)[first].metadata.file_size_bytes));
+        }
+    }
+}
+
+API_EXPORT uint32_t get_video_duration_batch(const uint32_t *path_ids, uint32_t count, double *out_durations)
+{
+    if (path_ids == nullptr || out_durations == nullptr) return 0;
+
+    // Recent answers come from the hot cache; the rest go on as one batch
+    std::vector<uint32_t> missing; // positions in path_ids
+    std::vector<uint32_t> missingIds;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        HotResult hot;
+        if (HotCache::Instance().Find(path_ids[i], true, &hot))
+        {
+            out_durations[i] = hot.duration_ms;
+            continue;
+        }
+        missing.push_back(i);
+        missingIds.push_back(path_ids[i]);
+    }
+    const uint32_t pending = static_cast<uint32_t>(missing.size());
+
+    std::vector<const PathChar *> paths(pending);
+    for (uint32_t j = 0; j < pending; j++) paths[j] = path_arena_get(missingIds[j], nullptr);
+    std::vector<double> remote;
+    std::vector<uint8_t> answered;
+    if (pending != 0 && DaemonClient::Instance().DurationBatch(paths, &remote, &answered) == DaemonReply::Ok)
+    {
+        // What the daemon could not open is probed here
+        size_t kept = 0;
+        for (uint32_t j = 0; j < pending; j++)
+        {
+            if (answered[j])
+            {
+                out_durations[missing[j]] = remote[j];
+                continue;
+            }
+            missing[kept] = missing[j];
+            missingIds[kept++] = missingIds[j];
+        }
+        missing.resize(kept);
+        missingIds.resize(kept);
+    }
+    if (!missing.empty())
+    {
+        const uint32_t local = static_cast<uint32_t>(missing.size());
+        std::vector<ProbeEntry> entries;
+        std::vector<uint8_t> found;
+        ProbeEntriesBatch(missingIds.data(), local, &entries, &found);
+        for (uint32_t j = 0; j < local; j++)
+        {
+            out_durations[missing[j]] = found[j] ? entries[j].duration_ms : 0.0;
+            if (!found[j]) continue;
+            HotResult hot;
+            hot.metadata = entries[j].metadata;
+            hot.duration_ms = entries[j].duration_ms;
+            hot.has_metadata = true;
+            hot.has_duration = true;
+            HotCache::Instance().Put(missingIds[j], hot);
+        }
+    }
+    return static_cast<uint32_t>(std::count_if(out_durations, out_durations + count, [](double d) { return d > 0.0; }));
+}
+
+API_EXPORT void set_batch_probe_order(uint8_t order)
+{
+    if (order <= static_cast<uint8_t>(ProbeOrder::Physical)) batchProbeOrder = order;
+}
+
+// === Content sniffing ===
+
+API_EXPORT uint8_t sniff_file(const PathChar *path)
+{
+    return static_cast<uint8_t>(SniffFile(path));
+}
+
+API_EXPORT uint8_t sniff_file_by_id(uint32_t path_id)
+{
+    return sniff_file(path_arena_get(path_id, nullptr));
+}
+
+API_EXPORT uint32_t sniff_files_batch(const uint32_t *path_ids, uint32_t count, uint8_t *out_kinds)
+{
+    if (path_ids == nullptr || out_kinds == nullptr) return 0;
+
+    uint32_t media = 0;
+    for (uint32_t i = 0; i < count; i++)
+    {
+        out_kinds[i] = sniff_file_by_id(path_ids[i]);
+        if (IsMediaContainer(static_cast<ContainerKind>(out_kinds[i]))) media++;
+    }
+    return media;
+}
+
+// === Library watching ===
+
+API_EXPORT int32_t watch_start(const uint32_t *root_ids, uint32_t count, uint32_t debounce_ms, bool reprobe)
+{
+    if (root_ids == nullptr || count == 0) return -1;
+
+    try
+    {
+        std::vector<NativePath> roots;
+        for (uint32_t i = 0; i < count; i++)
+        {
+            NativePathView root;
+            if (PathArena::Instance().Get(root_ids[i], &root)) roots.emplace_back(root);
+        }
+
+        const int32_t handle = WatchService::Start(roots, debounce_ms, reprobe);
+        if (handle < 0) std::cerr << "video_data_exporter | Failed to watch any of the " << count << " library roots" << std::endl;
+        return handle;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "video_data_exporter | Exception occurred when starting watch: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+API_EXPORT uint32_t watch_poll(int32_t handle, struct FsChangeRecord *out_changes, uint32_t capacity, uint32_t timeout_ms)
+{
+    return WatchService::Poll(handle, out_changes, capacity, timeout_ms);
+}
+
+API_EXPORT bool watch_stop(int32_t handle)
+{
+    return WatchService::Stop(handle);
+}
+
+// === Incremental rescan ===
+
+API_EXPORT int32_t rescan_start(uint32_t root_id, const PathChar *state_path, bool stat_every_file)
+{
+    NativePathView root;
+    if (state_path == nullptr || !PathArena::Instance().Get(root_id, &root)) return -1;
+    try
+    {
+        return WatchService::StartRescan(NativePath(root), state_path, stat_every_file);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "video_data_exporter | Failed to start rescan: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+API_EXPORT uint32_t rescan_poll(int32_t handle, struct FsChangeRecord *out_changes, uint32_t capacity, uint32_t timeout_ms)
+{
+    return WatchService::PollRescan(handle, out_changes, capacity, timeout_ms);
+}
+
+API_EXPORT bool rescan_stats(int32_t handle, struct RescanStats *stats)
+{
+    return WatchService::RescanProgress(handle, stats);
+}
+
+API_EXPORT bool rescan_close(int32_t handle)
+{
+    return WatchService::CloseRescan(handle);
+}
+
+// === Directory walking ===
+
+API_EXPORT int32_t walk_start(uint32_t root_id, uint32_t threads, uint32_t flags)
+{
+    NativePathView root;
+    if (!PathArena::Instance().Get(root_id, &root)) return -1;
+    WalkOptions options;
+    if (threads != 0) options.threads = threads;
+    options.follow_symlinks = (flags & 1) != 0;
+    options.stat_files = (flags & 2) != 0;
+    options.ordered = (flags & 4) != 0;
+    try
+    {
+        return WalkSessions::Start(NativePath(root), options);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "video_data_exporter | Failed to start walk: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+API_EXPORT uint32_t walk_poll(int32_t handle, struct WalkRecord *out_entries, uint32_t capacity, uint32_t timeout_ms)
+{
+    return WalkSessions::Poll(handle, out_entries, capacity, timeout_ms);
+}
+
+API_EXPORT bool walk_stats(int32_t handle, struct WalkProgress *progress)
+{
+    return WalkSessions::Progress(handle, progress);
+}
+
+API_EXPORT bool walk_close(int32_t handle)
+{
+    return WalkSessions::Close(handle);
+}
+
+// === Keyframe index ===
+
+API_EXPORT uint32_t get_keyframe_index_by_id(uint32_t path_id, int64_t *out_times_ms, uint64_t *out_offsets, uint32_t capacity)
+{
+    const PathChar *path = path_arena_get(path_id, nullptr);
+    FileMetadata current;
+    if (path == nullptr || !StatById(path_id, path, &current)) return 0;
+
+    try
+    {
+        ProbeEntry entry;
+        std::shared_ptr<const KeyframeIndex> index;
+        if (ProbeCache::Instance().Lookup(path_id, &entry) && ProbeEntryMatches(entry, current)) index = entry.keyframes;
+        if (!index)
+        {
+            // Small read-ahead: without Cues every cluster costs one header read
+            std::unique_ptr<ByteSource> source = OpenFileSource(path, AccessPattern::Random, 4096);
+            if (!source) return 0;
+            auto built = std::make_shared<KeyframeIndex>();
+            BuildKeyframeIndex(*source, built.get()); // an empty index is cached too, so failures are not retried
+            index = built;
+            ProbeCache::Instance().Update(path_id, current, [&index](ProbeEntry &cached) { cached.keyframes = index; });
+        }
+
+        if (out_times_ms != nullptr && out_offsets != nullptr && capacity > 0)
+        {
+            std::vector<int64_t> times;
+            std::vector<uint64_t> offsets;
+            index->Decode(&times, &offsets);
+            const size_t n = std::min<size_t>(capacity, times.size());
+            std::memcpy(out_times_ms, times.data(), n * sizeof(int64_t));
+            std::memcpy(out_offsets, offsets.data(), n * sizeof(uint64_t));
+        }
+        return static_cast<uint32_t>(index->Count());
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "video_data_exporter | Failed to build keyframe index: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+// === Bitrate timeline ===
+
+API_EXPORT uint32_t get_bitrate_timeline_by_id(uint32_t path_id, uint32_t bucket_ms, float *out_kbps, uint32_t capacity,
+                                               struct BitrateTimelineInfo *info)
+{
+    if (info != nullptr) *info = {};
+    const PathChar *path = path_arena_get(path_id, nullptr);
+    FileMetadata current;
+    if (bucket_ms == 0 || path == nullptr || !StatById(path_id, path, &current)) return 0;
+
+    try
+    {
+        ProbeEntry entry;
+        std::shared_ptr<const BitrateTimeline> timeline;
+        uint64_t bytesRead = 0;
+        if (ProbeCache::Instance().Lookup(path_id, &entry) && ProbeEntryMatches(entry, current) && entry.bitrate &&
+            entry.bitrate->bucketMs == bucket_ms)
+            timeline = entry.bitrate;
+        if (!timeline)
+        {
+            // Small read-ahead: a block scan reads a few bytes of every block and should not pull its payload
+            std::unique_ptr<ByteSource> source = OpenFileSource(path, AccessPattern::Random, 512);
+            if (!source) return 0;
+            auto built = std::make_shared<BitrateTimeline>();
+            if (!BuildBitrateTimeline(*source, bucket_ms, built.get())) built->kbps.clear(); // cached too, so failures are not retried
+            bytesRead = source->BytesRead();
+            timeline = built;
+            ProbeCache::Instance().Update(path_id, current, [&timeline](ProbeEntry &cached) { cached.bitrate = timeline; });
+        }
+
+        const std::vector<float> &kbps = timeline->kbps;
+        if (out_kbps != nullptr && capacity > 0)
+            std::memcpy(out_kbps, kbps.data(), std::min<size_t>(capacity, kbps.size()) * sizeof(float));
+        if (info != nullptr)
+        {
+            info->bytes_read = bytesRead;
+            if (!kbps.empty())
+            {
+                const auto peak = std::max_element(kbps.begin(), kbps.end());
+                info->duration_ms = timeline->durationMs;
+                info->bucket_ms = timeline->bucketMs;
+                info->bucket_count = static_cast<uint32_t>(kbps.size());
+                info->media_bytes = timeline->mediaBytes;
+                info->average_kbps = timeline->durationMs > 0.0 ? static_cast<float>(timeline->mediaBytes * 8.0 / timeline->durationMs) : 0.0f;
+                info->peak_kbps = *peak;
+                info->peak_bucket = static_cast<uint32_t>(peak - kbps.begin());
+                info->source = static_cast<uint8_t>(timeline->source);
+                info->complete = timeline->complete ? 1 : 0;
+            }
+        }
+        return static_cast<uint32_t>(kbps.size());
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "video_data_exporter | Failed to build bitrate timeline: " << e.what() << std::endl;
+        return 0;
+    }
+}
+
+// === Perceptual hashes ===
+
+API_EXPORT bool compute_image_hashes(const uint8_t *bgra, uint32_t width, uint32_t height, uint32_t stride, uint64_t *out_dhash, uint64_t *out_phash)
+{
+    return ComputeImageHashes(bgra, width, height, stride, out_dhash, out_phash);
+}
+
+API_EXPORT bool get_thumbnail_hashes_by_id(uint32_t video_id, uint64_t *out_dhash, uint64_t *out_phash)
+{
+    const PathChar *path = path_arena_get(video_id, nullptr);
+    FileMetadata current;
+    if (path == nullptr || !StatById(video_id, path, &current)) return false;
+
+    ProbeEntry entry;
+    if (ProbeCache::Instance().Lookup(video_id, &entry) && entry.has_thumbnail_hashes && ProbeEntryMatches(entry, current))
+    {
+        if (out_dhash != nullptr) *out_dhash = entry.thumbnail_dhash;
+        if (out_phash != nullptr) *out_phash = entry.thumbnail_phash;
+        return true;
+    }
+
+#ifdef _WIN32
+    try
+    {
+        // The shell keeps 256 px thumbnails cached; the hashes reduce to 32x32 anyway
+        MemoryBudget::Lease lease = MemoryBudget::Thumbnails().Acquire(ThumbnailBytes(256));
+        PooledBuffer pixels;
+        UINT width = 0, height = 0;
+        if (!GetExplorerThumbnailPixels(path, 256, &pixels, &width, &height)) return false;
+
+        uint64_t dhash, phash;
+        if (!ComputeImageHashes(pixels.data(), width, height, width * 4, &dhash, &phash)) return false;
+        ProbeCache::Instance().Update(video_id, current, [dhash, phash](ProbeEntry &cached) {
+            cached.thumbnail_dhash = dhash;
+            cached.thumbnail_phash = phash;
+            cached.has_thumbnail_hashes = true;
+        });
+        SimilarityIndex::Instance().Insert(video_id, phash);
+
+        if (out_dhash != nullptr) *out_dhash = dhash;
+        if (out_phash != nullptr) *out_phash = phash;
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "video_data_exporter | Failed to hash thumbnail: " << e.what() << std::endl;
+        return false;
+    }
+#else
+    return false;
+#endif
+}
+
+API_EXPORT void similarity_index_add(uint32_t path_id, uint64_t hash)
+{
+    if (path_id == kInvalidPathId) return;
+    SimilarityIndex::Instance().Insert(path_id, hash);
+}
+
+API_EXPORT bool similarity_index_remove(uint32_t path_id)
+{
+    return SimilarityIndex::Instance().Remove(path_id);
+}
+
+API_EXPORT uint32_t similarity_index_size()
+{
+    return static_cast<uint32_t>(SimilarityIndex::Instance().Size());
+}
+
+API_EXPORT uint32_t similarity_find_within(uint64_t hash, uint32_t radius, struct SimilarityMatch *out_matches, uint32_t capacity)
+{
+    std::vector<SimilarityMatch> matches;
+    SimilarityIndex::Instance().Within(hash, radius, &matches);
+    if (out_matches != nullptr)
+        std::copy_n(matches.begin(), std::min<size_t>(capacity, matches.size()), out_matches);
+    return static_cast<uint32_t>(matches.size());
+}
+
+API_EXPORT uint32_t similarity_find_nearest(uint64_t hash, uint32_t k, struct SimilarityMatch *out_matches)
+{
+    if (out_matches == nullptr) return 0;
+    std::vector<SimilarityMatch> matches;
+    SimilarityIndex::Instance().Nearest(hash, k, &matches);
+    std::copy(matches.begin(), matches.end(), out_matches);
+    return static_cast<uint32_t>(matches.size());
+}
+
+// === Memory ===
+
+API_EXPORT void get_memory_stats(struct MemoryStats *stats)
+{
+    if (stats == nullptr) return;
+    const BufferPoolStats reads = BufferPool::Reads().Stats();
+    const BufferPoolStats pixels = BufferPool::Pixels().Stats();
+    MemoryBudget &budget = MemoryBudget::Thumbnails();
+    stats->read_buffer_acquires = reads.acquires;
+    stats->read_buffer_allocations = reads.allocations;
+    stats->pixel_buffer_acquires = pixels.acquires;
+    stats->pixel_buffer_allocations = pixels.allocations;
+    stats->retained_bytes = reads.retained_bytes + pixels.retained_bytes;
+    stats->thumbnail_budget_bytes = budget.Limit();
+    stats->thumbnail_bytes_in_flight = budget.InFlight();
+    stats->thumbnail_high_water_bytes = budget.HighWater();
+    stats->thumbnail_budget_waits = budget.Waits();
+}
+
+API_EXPORT void set_thumbnail_memory_budget(uint64_t bytes)
+{
+    MemoryBudget::Thumbnails().SetLimit(bytes);
+}
+
+API_EXPORT void trim_buffer_pools()
+{
+    BufferPool::Reads().Trim();
+    BufferPool::Pixels().Trim();
+}
+
+// === Hot cache ===
+
+namespace
+{
+    EncodedThumbnail ReadEncodedThumbnail(const PathChar *path)
+    {
+        std::unique_ptr<ByteSource> source = OpenFileSource(path, AccessPattern::Sequential);
+        if (!source || source->Size() == 0 || source->Size() > UINT32_MAX) return nullptr;
+        auto bytes = std::make_shared<std::vector<uint8_t>>(static_cast<size_t>(source->Size()));
+        if (source->ReadAt(0, bytes->data(), bytes->size()) != bytes->size()) return nullptr;
+        return bytes;
+    }
+}
+
+API_EXPORT uint32_t get_thumbnail_bytes_by_id(uint32_t video_id, uint32_t output_id, unsigned int size, uint8_t *out_bytes, uint32_t capacity)
+{
+    EncodedThumbnail bytes = HotCache::Instance().FindThumbnail(video_id, size);
+    if (!bytes)
+    {
+        const PathChar *output = path_arena_get(output_id, nullptr);
+        if (output == nullptr) return 0;
+        FileMetadata existing;
+        if (!ReadFileMetadata(output, &existing) && !get_thumbnail_by_id(video_id, output_id, size)) return 0;
+        bytes = ReadEncodedThumbnail(output);
+        if (!bytes) return 0;
+        HotCache::Instance().PutThumbnail(video_id, size, bytes);
+    }
+    if (out_bytes != nullptr && capacity >= bytes->size()) std::memcpy(out_bytes, bytes->data(), bytes->size());
+    return static_cast<uint32_t>(bytes->size());
+}
+
+API_EXPORT void get_hot_cache_stats(struct HotCacheStats *stats)
+{
+    if (stats != nullptr) *stats = HotCache::Instance().Stats();
+}
+
+API_EXPORT void set_hot_cache_limits(uint64_t budget_bytes, uint32_t max_age_ms)
+{
+    HotCache::Instance().SetLimits(budget_bytes, max_age_ms);
+}
+
+API_EXPORT void clear_hot_cache()
+{
+    HotCache::Instance().Clear();
+}
+
+// === I/O concurrency ===
+
+API_EXPORT uint32_t get_io_concurrency_stats(struct IoConcurrencyStats *out_stats, uint32_t capacity)
+{
+    std::vector<std::pair<uint64_t, ConcurrencyStats>> roots;
+    StorageConcurrency::Instance().Snapshot(&roots);
+    if (out_stats != nullptr)
+    {
+        for (size_t i = 0; i < std::min<size_t>(capacity, roots.size()); i++)
+        {
+            const ConcurrencyStats &stats = roots[i].second;
+            IoConcurrencyStats &out = out_stats[i];
+            out = IoConcurrencyStats();
+            out.storage_id = roots[i].first;
+            out.limit = stats.limit;
+            out.in_flight = stats.in_flight;
+            out.peak_in_flight = stats.peak_in_flight;
+            out.completions = stats.completions;
+            out.increases = stats.increases;
+            out.decreases = stats.decreases;
+            out.mean_latency_ms = stats.mean_latency_ms;
+            out.baseline_latency_ms = stats.baseline_latency_ms;
+            out.throughput_per_s = stats.throughput;
+        }
+    }
+    return static_cast<uint32_t>(roots.size());
+}
+
+API_EXPORT void set_io_concurrency_limits(uint32_t min_limit, uint32_t max_limit, uint32_t latency_target_ms)
+{
+    StorageConcurrency &storage = StorageConcurrency::Instance();
+    ConcurrencyOptions options = storage.Options();
+    if (min_limit != 0) options.min_limit = min_limit;
+    if (max_limit != 0) options.max_limit = max_limit;
+    if (latency_target_ms != 0) options.latency_target_ms = latency_target_ms;
+    storage.SetOptions(options);
+}
+
+// === Unified probe ===
+
+API_EXPORT bool probe_file(const PathChar *path, uint32_t fields_mask, struct FileProbeResult *out)
+{
+    if (out == nullptr) return false;
+    if (DaemonClient::Instance().Probe(path, fields_mask, out) == DaemonReply::Ok) return true;
+    *out = FileProbeResult();
+    try
+    {
+        return ProbeFile(path, fields_mask, out);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "video_data_exporter | Failed to probe file: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+API_EXPORT bool probe_file_by_id(uint32_t path_id, uint32_t fields_mask, struct FileProbeResult *out)
+{
+    if (out == nullptr) return false;
+    *out = FileProbeResult();
+    const PathChar *path = path_arena_get(path_id, nullptr);
+    if (path == nullptr) return false;
+    if (DaemonClient::Instance().Probe(path, fields_mask, out) == DaemonReply::Ok) return true;
+    *out = FileProbeResult();
+    FileMetadata current;
+    if (!StatById(path_id, path, &current)) return false;
+
+    try
+    {
+        // The stat that validates the cache answers metadata; cached parses drop out of the plan
+        ProbeEntry entry;
+        const bool cached = ProbeCache::Instance().Lookup(path_id, &entry) && ProbeEntryMatches(entry, current);
+        uint32_t pending = fields_mask & ~static_cast<uint32_t>(ProbeField::Metadata);
+        if (cached && entry.has_duration) pending &= ~static_cast<uint32_t>(ProbeField::Duration);
+        if (cached && entry.keyframes) pending &= ~static_cast<uint32_t>(ProbeField::Keyframes);
+
+        std::shared_ptr<const KeyframeIndex> keyframes;
+        if (!ProbeFile(path, pending, out, &keyframes)) return false;
+
+        if (HasField(fields_mask, ProbeField::Metadata))
+        {
+            out->metadata = current;
+            out->fields |= static_cast<uint32_t>(ProbeField::Metadata);
+        }
+        if (HasField(fields_mask, ProbeField::Duration) && !HasField(pending, ProbeField::Duration))
+        {
+            out->container = static_cast<uint8_t>(entry.container);
+            out->duration_ms = entry.duration_ms;
+            if (entry.duration_ms > 0.0) out->fields |= static_cast<uint32_t>(ProbeField::Duration);
+        }
+        if (HasField(fields_mask, ProbeField::Keyframes) && !HasField(pending, ProbeField::Keyframes))
+        {
+            out->keyframe_count = static_cast<uint32_t>(entry.keyframes->Count());
+            out->fields |= static_cast<uint32_t>(ProbeField::Keyframes);
+        }
+
+        const bool probedDuration = HasField(pending, ProbeField::Duration);
+        if (probedDuration || keyframes)
+        {
+            const FileProbeResult probed = *out;
+            ProbeCache::Instance().Update(path_id, current, [&](ProbeEntry &cached) {
+                if (probedDuration)
+                {
+                    cached.duration_ms = probed.duration_ms;
+                    cached.has_duration = true;
+                    cached.container = static_cast<ContainerKind>(probed.container);
+                }
+                if (keyframes) cached.keyframes = keyframes;
+            });
+        }
+        return true;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "video_data_exporter | Failed to probe file: " << e.what() << std::endl;
         return false;
     }
-}
\ No newline at end of file
+}
+
+// === Library snapshots ===
+
+namespace
+{
+    std::mutex snapshotsMutex;
+    std::unordered_map<int32_t, std::unique_ptr<LibrarySnapshot>> snapshots;
+    int32_t nextSnapshotHandle = 1;
+
+    const LibrarySnapshot *FindSnapshot(int32_t handle)
+    {
+        auto it = snapshots.find(handle);
+        return it != snapshots.end() ? it->second.get() : nullptr;
+    }
+}
+
+API_EXPORT bool snapshot_write(const uint32_t *path_ids, uint32_t count, const PathChar *output_path, bool stream_columns)
+{
+    if (path_ids == nullptr || output_path == nullptr) return false;
+
+    try
+    {
+        std::vector<ProbeEntry> entries;
+        std::vector<uint8_t> found;
+        ProbeEntriesBatch(path_ids, count, &entries, &found);
+
+        std::vector<SnapshotRow> rows(count);
+        for (uint32_t i = 0; i < count; i++)
+        {
+            NativePathView path;
+            if (PathArena::Instance().Get(path_ids[i], &path)) rows[i].utf8_path = NativePathToUtf8(path);
+            if (!found[i]) continue;
+
+            const ProbeEntry &entry = entries[i];
+            SnapshotRow &row = rows[i];
+            row.metadata = entry.metadata;
+            row.flags = kSnapshotHasMetadata;
+            if (entry.has_duration && entry.duration_ms > 0.0)
+            {
+                row.duration_ms = entry.duration_ms;
+                row.flags |= kSnapshotHasDuration;
+            }
+            if (entry.has_thumbnail_hashes)
+            {
+                row.thumbnail_hash = entry.thumbnail_phash;
+                row.flags |= kSnapshotHasHash;
+            }
+            row.container = entry.container;
+            row.keyframe_count = entry.keyframes != nullptr ? static_cast<uint32_t>(entry.keyframes->Count()) : 0;
+        }
+        return WriteLibrarySnapshot(output_path, rows, stream_columns);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "video_data_exporter | Exception occurred when writing snapshot: " << e.what() << std::endl;
+        return false;
+    }
+}
+
+API_EXPORT int32_t snapshot_open(const PathChar *path)
+{
+    if (path == nullptr) return -1;
+    try
+    {
+        std::unique_ptr<LibrarySnapshot> snapshot = LibrarySnapshot::Open(path);
+        if (snapshot == nullptr) return -1;
+        std::lock_guard<std::mutex> lock(snapshotsMutex);
+        const int32_t handle = nextSnapshotHandle++;
+        snapshots[handle] = std::move(snapshot);
+        return handle;
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "video_data_exporter | Exception occurred when opening snapshot: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+API_EXPORT uint64_t snapshot_row_count(int32_t handle)
+{
+    std::lock_guard<std::mutex> lock(snapshotsMutex);
+    const LibrarySnapshot *snapshot = FindSnapshot(handle);
+    return snapshot != nullptr ? snapshot->RowCount() : 0;
+}
+
+API_EXPORT const void *snapshot_column(int32_t handle, uint32_t column_id, uint64_t *out_count)
+{
+    std::lock_guard<std::mutex> lock(snapshotsMutex);
+    const LibrarySnapshot *snapshot = FindSnapshot(handle);
+    if (snapshot == nullptr)
+    {
+        if (out_count != nullptr) *out_count = 0;
+        return nullptr;
+    }
+    return snapshot->Column(static_cast<SnapshotColumn>(column_id), out_count);
+}
+
+API_EXPORT uint64_t snapshot_index_range(int32_t handle, uint32_t index_column, double min_value, double max_value, uint64_t *out_first)
+{
+    std::lock_guard<std::mutex> lock(snapshotsMutex);
+    const LibrarySnapshot *snapshot = FindSnapshot(handle);
+    if (snapshot == nullptr)
+    {
+        if (out_first != nullptr) *out_first = 0;
+        return 0;
+    }
+    return snapshot->IndexRange(static_cast<SnapshotColumn>(index_column), min_value, max_value, out_first);
+}
+
+API_EXPORT bool snapshot_close(int32_t handle)
+{
+    std::lock_guard<std::mutex> lock(snapshotsMutex);
+    return snapshots.erase(handle) > 0;
+}
+
+// === Probe daemon ===
+
+namespace
+{
+    // Pixels handed out by thumbnail_pixels_acquire: a daemon's shared memory or a local buffer
+    struct AcquiredPixels
+    {
+        std::unique_ptr<SharedPixels> shared;
+        PooledBuffer local;
+    };
+
+    // Pixels the caller never released are freed at exit, while the pool they return to still exists
+    struct AcquiredRegistry
+    {
+        std::mutex mutex;
+        std::unordered_map<const uint8_t *, AcquiredPixels> pixels;
+
+        AcquiredRegistry()
+        {
+            // Constructed first, so destroyed after this registry hands its buffers back
+            BufferPool::Pixels();
+        }
+    };
+
+    AcquiredRegistry &Acquired()
+    {
+        static AcquiredRegistry registry;
+        return registry;
+    }
+}
+
+API_EXPORT const uint8_t *thumbnail_pixels_acquire(uint32_t video_id, uint32_t size, uint32_t *out_width, uint32_t *out_height)
+{
+    const PathChar *path = path_arena_get(video_id, nullptr);
+    if (path == nullptr || out_width == nullptr || out_height == nullptr || size == 0) return nullptr;
+
+    AcquiredPixels pixels;
+    uint32_t width = 0, height = 0;
+    if (DaemonClient::Instance().ThumbnailPixels(path, size, &pixels.shared, &width, &height) != DaemonReply::Ok)
+    {
+        ThumbnailRenderer render = DefaultThumbnailRenderer();
+        if (!render) return nullptr;
+        try
+        {
+            MemoryBudget::Lease lease = MemoryBudget::Thumbnails().Acquire(uint64_t(size) * size * 4);
+            if (!render(path, size, &pixels.local, &width, &height)) return nullptr;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "video_data_exporter | Failed to render thumbnail: " << e.what() << std::endl;
+            return nullptr;
+        }
+    }
+
+    const uint8_t *data = pixels.shared ? pixels.shared->data() : pixels.local.data();
+    *out_width = width;
+    *out_height = height;
+    AcquiredRegistry &registry = Acquired();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.pixels.emplace(data, std::move(pixels));
+    return data;
+}
+
+API_EXPORT bool thumbnail_pixels_release(const uint8_t *pixels)
+{
+    AcquiredRegistry &registry = Acquired();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    return registry.pixels.erase(pixels) > 0;
+}
+
+API_EXPORT void daemon_set_endpoint(const PathChar *endpoint)
+{
+    DaemonClient::Instance().SetEndpoint(endpoint != nullptr ? NativePath(endpoint) : DefaultDaemonEndpoint());
+}
+
+API_EXPORT void daemon_get_status(struct DaemonClientStatus *status)
+{
+    if (status == nullptr) return;
+    const DaemonClientStats stats = DaemonClient::Instance().Stats();
+    *status = DaemonClientStatus();
+    status->connected = stats.daemon_pid != 0;
+    status->daemon_pid = stats.daemon_pid;
+    status->requests = stats.requests;
+    status->fallbacks = stats.fallbacks;
+    status->reconnects = stats.reconnects;
+}
+
+// === File identity ===
+
+API_EXPORT void get_file_identity_stats(struct FileIdentityStats *stats)
+{
+    if (stats != nullptr) *stats = FileIdentityIndex::Instance().Stats();
+}
+
+// === Thumbnail window ===
+
+API_EXPORT bool set_thumbnail_window(const uint32_t *video_ids, const uint32_t *output_ids, uint32_t count, uint32_t first_visible,
+                                     uint32_t visible_count, uint32_t lookahead, unsigned int size)
+{
+    if (count != 0 && (video_ids == nullptr || output_ids == nullptr)) return false;
+    ThumbnailWindow::Instance().Set(video_ids, output_ids, count, first_visible, visible_count, lookahead, size);
+    return true;
+}
+
+API_EXPORT uint32_t thumbnail_window_poll(struct ThumbnailTileRecord *out_tiles, uint32_t capacity, uint32_t timeout_ms)
+{
+    if (out_tiles == nullptr || capacity == 0) return 0;
+    return ThumbnailWindow::Instance().Poll(out_tiles, capacity, timeout_ms);
+}
+
+API_EXPORT void get_thumbnail_window_stats(struct ThumbnailWindowStats *stats)
+{
+    if (stats != nullptr) *stats = ThumbnailWindow::Instance().Stats();
+}
+
+API_EXPORT void reset_thumbnail_window_stats()
+{
+    ThumbnailWindow::Instance().ResetStats();
+}
+
+// === Thumbnail atlas ===
+
+API_EXPORT int32_t thumbnail_atlas_build(const uint32_t *video_ids, uint32_t count, uint32_t cell_size, uint32_t columns)
+{
+    try
+    {
+        return ThumbnailAtlasStore::Instance().Build(video_ids, count, cell_size, columns);
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "video_data_exporter | Failed to build thumbnail atlas: " << e.what() << std::endl;
+        return -1;
+    }
+}
+
+API_EXPORT const uint8_t *thumbnail_atlas_pixels(int32_t handle, uint32_t *out_width, uint32_t *out_height, uint32_t *out_version)
+{
+    const std::shared_ptr<ThumbnailAtlas> atlas = ThumbnailAtlasStore::Instance().Find(handle);
+    if (!atlas) return nullptr;
+    if (out_width != nullptr) *out_width = atlas->Width();
+    if (out_height != nullptr) *out_height = atlas->Height();
+    if (out_version != nullptr) *out_version = atlas->Version();
+    return atlas->Pixels();
+}
+
+API_EXPORT uint32_t thumbnail_atlas_cells(int32_t handle, struct ThumbnailAtlasCell *out_cells, uint32_t capacity)
+{
+    const std::shared_ptr<ThumbnailAtlas> atlas = ThumbnailAtlasStore::Instance().Find(handle);
+    if (!atlas) return 0;
+    const std::vector<ThumbnailAtlasCell> cells = atlas->Cells();
+    if (out_cells != nullptr) std::copy_n(cells.begin(), std::min<size_t>(capacity, cells.size()), out_cells);
+    return static_cast<uint32_t>(cells.size());
+}
+
+API_EXPORT uint32_t thumbnail_atlas_refresh(int32_t handle)
+{
+    return ThumbnailAtlasStore::Instance().Refresh(handle);
+}
+
+API_EXPORT bool thumbnail_atlas_close(int32_t handle)
+{
+    return ThumbnailAtlasStore::Instance().Close(handle);
+}
+
+API_EXPORT void get_thumbnail_atlas_stats(struct ThumbnailAtlasStats *stats)
+{
+    if (stats != nullptr) *stats = ThumbnailAtlasStore::Instance().Stats();
+}
+
+API_EXPORT void set_thumbnail_atlas_budget(uint64_t bytes)
+{
+    ThumbnailAtlasStore::Instance().SetBudget(bytes);
+}
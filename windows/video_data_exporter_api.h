@@ -1,8 +1,11 @@
 #ifndef VIDEO_DATA_EXPORTER_API_H
 #define VIDEO_DATA_EXPORTER_API_H
 
+#ifdef _WIN32
 #include <windows.h>
+#endif
 #include <cstdint>
+#include "native_path.h"
 
 struct FileMetadata
 {
@@ -12,21 +15,503 @@ struct FileMetadata
     int64_t file_size_bytes;
 };
 
+// One coalesced filesystem change; kind is 1 = added, 2 = modified, 3 = removed, 4 = rescan needed.
+struct FsChangeRecord
+{
+    uint32_t path_id;
+    uint8_t kind;
+    uint8_t is_directory;
+    uint16_t reserved;
+};
+
+// Progress of a rescan. Counters fill in as the scan runs; the directory and file counts at the end.
+struct RescanStats
+{
+    uint64_t directories;        // stat'ed
+    uint64_t directories_listed; // read again; the others kept their entries from the summary
+    uint64_t files;
+    uint64_t file_stats;
+    uint64_t added;
+    uint64_t modified;
+    uint64_t removed;
+    uint8_t from_summary; // 0 on the first rescan of a root, which reports everything as added
+    uint8_t summary_saved;
+    uint8_t finished;
+    uint8_t reserved[5];
+};
+
+// One entry found by a directory walk. size_bytes and modified_time_ms are 0 unless the walk
+// stats files (always filled on Windows, where the listing carries them).
+struct WalkRecord
+{
+    uint32_t path_id;
+    uint8_t is_directory;
+    uint8_t reserved[3];
+    uint64_t size_bytes;
+    int64_t modified_time_ms;
+};
+
+// Progress of a directory walk; counters fill in as it runs.
+struct WalkProgress
+{
+    uint64_t directories; // listed
+    uint64_t files;
+    uint64_t loops;  // symlinked or junctioned directories skipped as their own ancestor
+    uint64_t errors; // directories that could not be opened
+    uint64_t steals; // directories one walker thread took from another's queue
+    uint8_t finished;
+    uint8_t reserved[7];
+};
+
+// The library's link to a vdu-probed daemon.
+struct DaemonClientStatus
+{
+    uint8_t connected;
+    uint8_t reserved[3];
+    uint32_t daemon_pid;
+    uint64_t requests;   // answered by the daemon
+    uint64_t fallbacks;  // calls that ran in-process because no daemon was reachable
+    uint64_t reconnects; // connections made, the first included
+};
+
+// Paths grouped by the file they name, and the work hardlinks did not repeat.
+struct FileIdentityStats
+{
+    uint64_t paths;             // path IDs whose file is known
+    uint64_t files;             // distinct files among them
+    uint64_t shared_entries;    // paths that took over the cached results of another path of their file
+    uint64_t shared_probes;     // batch entries answered by another entry of the batch naming the same file
+    uint64_t shared_thumbnails; // thumbnails copied from another path's instead of rendered
+    uint64_t shared_file_bytes; // combined size of the files behind the three counters above
+};
+
+// A thumbnail of the window that became ready, or failed. wait_ms is how long its tile had been
+// visible without it (0 if it was ready first, i.e. the prefetch was in time).
+struct ThumbnailTileRecord
+{
+    uint32_t video_id;
+    uint32_t output_id;
+    uint8_t ok;
+    uint8_t visible; // in the visible range when it became ready
+    uint16_t reserved;
+    float wait_ms;
+};
+
+// Work of the thumbnail window since the last reset. Time to visible is measured once each time a
+// tile enters the visible range: 0 when its thumbnail was ready, else until it became ready.
+struct ThumbnailWindowStats
+{
+    uint64_t windows;    // set_thumbnail_window calls
+    uint64_t rendered;   // thumbnails made ready, by a render or from an existing file
+    uint64_t prefetched; // of those, made ready while outside the visible range
+    uint64_t promoted;   // queued as prefetches, then made visible before they ran
+    uint64_t canceled;   // queued, then dropped because the window moved past them
+    uint64_t failed;
+    uint64_t visible_tiles; // time-to-visible samples
+    uint64_t visible_blank; // of those, tiles shown before their thumbnail was ready
+    float time_to_visible_p50_ms;
+    float time_to_visible_p90_ms;
+    float time_to_visible_p99_ms;
+    float time_to_visible_max_ms;
+};
+
+// One item of a thumbnail atlas. x, y, width and height are the thumbnail's pixels in the atlas:
+// scaled to fit its cell and centered in it, so a tile can sample exactly that rectangle.
+struct ThumbnailAtlasCell
+{
+    uint32_t video_id;
+    uint32_t x;
+    uint32_t y;
+    uint16_t width; // 0 while the cell is empty
+    uint16_t height;
+    uint8_t ok;    // rendered; failed cells are transparent
+    uint8_t dirty; // the video changed since; thumbnail_atlas_refresh redraws it
+    uint16_t reserved;
+};
+
+struct ThumbnailAtlasStats
+{
+    uint64_t atlases;      // in memory, open or cached
+    uint64_t open_handles;
+    uint64_t bytes;        // their pixels
+    uint64_t budget_bytes; // for closed atlases kept for reuse
+    uint64_t builds;
+    uint64_t reused;         // builds answered by an atlas in memory
+    uint64_t cells_rendered;
+    uint64_t cells_copied;   // taken from another atlas at the same cell size instead of rendered
+    uint64_t cells_failed;
+    uint64_t cells_refreshed; // redrawn after their video changed
+};
+
+// One resolved shortcut. source is 0 = unresolved, 1 = LinkInfo, 2 = relative path, 3 = ID list,
+// 4 = shell link tracking (Windows, for targets that moved). target_id is an arena ID.
+struct ShortcutTarget
+{
+    uint32_t target_id;
+    uint8_t source;
+    uint8_t target_exists;
+    uint16_t reserved;
+};
+
+// One entry of a similarity query; distance is the Hamming distance between the 64-bit hashes.
+struct SimilarityMatch
+{
+    uint32_t path_id;
+    uint32_t distance;
+};
+
+// Recycled buffers and the thumbnail pixel budget. Counters are cumulative; byte counts are current
+// except the high-water mark. An acquire that is not an allocation reused a pooled buffer.
+struct MemoryStats
+{
+    uint64_t read_buffer_acquires;
+    uint64_t read_buffer_allocations;
+    uint64_t pixel_buffer_acquires;
+    uint64_t pixel_buffer_allocations;
+    uint64_t retained_bytes;
+    uint64_t thumbnail_budget_bytes;
+    uint64_t thumbnail_bytes_in_flight;
+    uint64_t thumbnail_high_water_bytes;
+    uint64_t thumbnail_budget_waits;
+};
+
+// The hot result cache; hit rates are hits / (hits + misses).
+struct HotCacheStats
+{
+    uint64_t hits;   // metadata and durations served from memory
+    uint64_t misses; // not cached, or older than the max age
+    uint64_t thumbnail_hits;
+    uint64_t thumbnail_misses;
+    uint64_t insertions;
+    uint64_t evictions; // entries dropped to stay within the budget
+    uint64_t entries;
+    uint64_t bytes; // charged against the budget, encoded thumbnails included
+    uint64_t budget_bytes;
+};
+
+// Adaptive probe concurrency of one storage root (st_dev, or the volume serial number on Windows).
+// Latencies and throughput describe the limiter's last decision window.
+struct IoConcurrencyStats
+{
+    uint64_t storage_id;
+    uint32_t limit;
+    uint32_t in_flight;
+    uint32_t peak_in_flight;
+    uint32_t reserved;
+    uint64_t completions;
+    uint64_t increases;
+    uint64_t decreases;
+    double mean_latency_ms;
+    double baseline_latency_ms;
+    double throughput_per_s;
+};
+
+// Result of probe_file: fields has a bit set (see ProbeField in file_probe.h) for every group
+// that was filled; the rest stay zero. Text fields are NUL-terminated and truncated to fit.
+struct FileProbeResult
+{
+    uint32_t fields;
+    uint8_t container;       // ContainerKind
+    uint8_t duration_method; // DurationMethod
+    uint8_t video_streams;
+    uint8_t audio_streams;
+    struct FileMetadata metadata;
+    double duration_ms;
+    char video_codec[24]; // first video stream
+    uint32_t width;
+    uint32_t height;
+    char audio_codec[24]; // first audio stream
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint64_t cover_offset; // embedded image bytes, left in the file
+    uint64_t cover_size;
+    char cover_media_type[32];
+    uint32_t keyframe_count;
+    uint32_t opens; // 0 when the request needed no more than a stat
+    uint64_t sampled_hash;
+    uint64_t full_hash;
+    uint64_t bytes_read; // pulled from storage through the one handle, read-ahead included
+    uint64_t read_calls;
+};
+
+// Bitrate timeline of one file. source is 1 = MP4 sample tables, 2 = Matroska Cues,
+// 3 = Matroska block headers.
+struct BitrateTimelineInfo
+{
+    double duration_ms; // covered by the buckets
+    uint32_t bucket_ms;
+    uint32_t bucket_count;
+    uint64_t media_bytes; // sample or block bytes counted, every track included
+    float average_kbps;
+    float peak_kbps;
+    uint32_t peak_bucket;
+    uint8_t source;   // BitrateSource
+    uint8_t complete; // 0 when the block scan stopped at its bound; the buckets end where it did
+    uint16_t reserved;
+    uint64_t bytes_read; // pulled from storage by this call; 0 when answered from the probe cache
+};
+
 #if defined(__cplusplus)
 extern "C"
 {
 #endif
 
+#ifdef _WIN32
 #define API_EXPORT __declspec(dllexport)
+#else
+#define API_EXPORT __attribute__((visibility("default")))
+#endif
 
+    // Path arguments are PathChar: UTF-16 on Windows, UTF-8 elsewhere.
     API_EXPORT void initialize_exporter();
-    API_EXPORT bool get_thumbnail(const wchar_t *video_path, const wchar_t *output_path, unsigned int size);
-    API_EXPORT double get_video_duration(const wchar_t *video_path);
-    API_EXPORT bool get_file_metadata(const wchar_t *file_path, struct FileMetadata *metadata);
-    API_EXPORT bool resolve_shortcut(const wchar_t *shortcut_path, wchar_t *target_path, int buffer_size);
+    API_EXPORT bool get_thumbnail(const PathChar *video_path, const PathChar *output_path, unsigned int size);
+    API_EXPORT double get_video_duration(const PathChar *video_path);
+    API_EXPORT bool get_file_metadata(const PathChar *file_path, struct FileMetadata *metadata);
+    API_EXPORT bool resolve_shortcut(const PathChar *shortcut_path, PathChar *target_path, int buffer_size);
+
+    // === Path arena ===
+    // Paths are interned once from UTF-8 and referred to by stable 32-bit IDs afterwards.
+
+    API_EXPORT uint32_t path_arena_intern(const char *utf8_path, uint32_t length);
+    // offsets holds count + 1 entries; path i spans [offsets[i], offsets[i + 1]). Returns the number of valid IDs.
+    API_EXPORT uint32_t path_arena_intern_batch(const char *utf8_paths, const uint32_t *offsets, uint32_t count, uint32_t *out_ids);
+    // Returns a NUL-terminated native string owned by the arena, or null for unknown IDs.
+    API_EXPORT const PathChar *path_arena_get(uint32_t path_id, uint32_t *length);
+    API_EXPORT uint32_t path_arena_count();
+
+    API_EXPORT bool get_thumbnail_by_id(uint32_t video_id, uint32_t output_id, unsigned int size);
+    API_EXPORT double get_video_duration_by_id(uint32_t path_id);
+    API_EXPORT bool get_file_metadata_by_id(uint32_t path_id, struct FileMetadata *metadata);
+    // The target is interned into the arena, so it has no length limit.
+    API_EXPORT bool resolve_shortcut_by_id(uint32_t shortcut_id, uint32_t *target_id);
+    // Parses the .lnk files in parallel; parsed links are cached per shortcut size and mtime.
+    // Returns the number of shortcuts with a target. Unresolved entries get kInvalidPathId and source 0.
+    API_EXPORT uint32_t resolve_shortcuts_batch(const uint32_t *shortcut_ids, uint32_t count, struct ShortcutTarget *out_targets);
+
+    // Batch variants return the number of successful entries. Failed entries are zeroed.
+    API_EXPORT uint32_t get_file_metadata_batch(const uint32_t *path_ids, uint32_t count, struct FileMetadata *out_metadata, bool *out_ok);
+    API_EXPORT uint32_t get_video_duration_batch(const uint32_t *path_ids, uint32_t count, double *out_durations);
+    // Order in which batches open the files they have to probe: 0 = as given, 1 = one queue per
+    // device, each swept in on-disk order (see ProbeOrder in batch_probe.h). 1 saves seeks on
+    // spinning disks; on SSDs and in the page cache it only adds a locating pass.
+    API_EXPORT void set_batch_probe_order(uint8_t order);
+
+    // === Content sniffing ===
+    // Classifies a file from its first bytes (see ContainerKind in content_sniffer.h):
+    // 0 = unknown, 1-11 = media containers, 12 = shortcut, 13+ = known non-media.
+
+    API_EXPORT uint8_t sniff_file(const PathChar *path);
+    API_EXPORT uint8_t sniff_file_by_id(uint32_t path_id);
+    // Returns the number of files that should go on to a media probe.
+    API_EXPORT uint32_t sniff_files_batch(const uint32_t *path_ids, uint32_t count, uint8_t *out_kinds);
+
+    // === Library watching ===
+    // Watches root directories recursively. Changes are debounced, invalidate the probe and
+    // thumbnail caches, are optionally re-probed on the worker pool, then queued for watch_poll.
+
+    // Returns a handle, or -1 if none of the roots could be watched.
+    API_EXPORT int32_t watch_start(const uint32_t *root_ids, uint32_t count, uint32_t debounce_ms, bool reprobe);
+    // Waits up to timeout_ms for changes; returns the number of records written.
+    API_EXPORT uint32_t watch_poll(int32_t handle, struct FsChangeRecord *out_changes, uint32_t capacity, uint32_t timeout_ms);
+    API_EXPORT bool watch_stop(int32_t handle);
+
+    // === Incremental rescan ===
+    // Compares a root against the per-directory summary (mtime, plus a hash over child names,
+    // sizes and mtimes rolled up into the parents) saved at state_path by the previous rescan.
+    // Directories whose mtime is unchanged are not listed again and their files not stat'ed;
+    // writes into existing files are left to the watcher unless stat_every_file is set.
+    // Changes arrive as FsChangeRecords, invalidating caches like watch batches.
+
+    // Returns a handle, or -1 if the root is not a directory.
+    API_EXPORT int32_t rescan_start(uint32_t root_id, const PathChar *state_path, bool stat_every_file);
+    // Waits up to timeout_ms for changes; returns 0 once the scan has finished and every change was polled.
+    API_EXPORT uint32_t rescan_poll(int32_t handle, struct FsChangeRecord *out_changes, uint32_t capacity, uint32_t timeout_ms);
+    API_EXPORT bool rescan_stats(int32_t handle, struct RescanStats *stats);
+    // Cancels the scan if it is still running, waits for it and releases the handle.
+    API_EXPORT bool rescan_close(int32_t handle);
+
+    // === Directory walking ===
+    // Lists a tree with several threads, each working through its own queue of directories and
+    // taking from the others' when it runs dry. Directories that are their own ancestor by
+    // (device, inode) are skipped, so following symlinks and junctions cannot loop. Entries
+    // are interned and queued for walk_poll; a walk that is not polled waits for the poller.
+    // Flags: 1 = follow symlinks and junctions, 2 = stat files for size and mtime,
+    // 4 = ordered (pre-order, names sorted at every level, identical on every run).
+
+    // Returns a handle, or -1 if the root is not a directory. threads 0 picks the default.
+    API_EXPORT int32_t walk_start(uint32_t root_id, uint32_t threads, uint32_t flags);
+    // Waits up to timeout_ms for entries; returns 0 once the walk has finished and every entry was polled.
+    API_EXPORT uint32_t walk_poll(int32_t handle, struct WalkRecord *out_entries, uint32_t capacity, uint32_t timeout_ms);
+    API_EXPORT bool walk_stats(int32_t handle, struct WalkProgress *progress);
+    // Stops the walk if it is still running and releases the handle.
+    API_EXPORT bool walk_close(int32_t handle);
+
+    // === Keyframe index ===
+    // Keyframe timestamps (ms) and byte offsets of the first video track, from MP4 sample
+    // tables or Matroska Cues. Built once per file state and kept in the probe cache.
+
+    // Returns the number of keyframes and copies up to capacity of them; pass capacity 0 to query the count.
+    API_EXPORT uint32_t get_keyframe_index_by_id(uint32_t path_id, int64_t *out_times_ms, uint64_t *out_offsets, uint32_t capacity);
+
+    // === Bitrate timeline ===
+    // Container bitrate (kbit/s) in buckets of bucket_ms, from index data only: MP4 sample
+    // sizes and times, or Matroska Cues and block headers, without reading any payload.
+    // The last timeline built for a file state is kept in the probe cache.
+
+    // Returns the number of buckets and copies up to capacity of them; pass capacity 0 to query
+    // the count. Returns 0 if the file has no usable index data. info may be null.
+    API_EXPORT uint32_t get_bitrate_timeline_by_id(uint32_t path_id, uint32_t bucket_ms, float *out_kbps, uint32_t capacity,
+                                                   struct BitrateTimelineInfo *info);
+
+    // === Perceptual hashes ===
+    // 64-bit dHash and pHash of a thumbnail, for finding re-encodes and near-duplicates.
+    // Hashes of video thumbnails are cached per file state and their pHash is added to
+    // the similarity index, which answers Hamming-distance queries by path ID.
+
+    // bgra holds height rows of width 32-bit pixels, stride bytes apart.
+    API_EXPORT bool compute_image_hashes(const uint8_t *bgra, uint32_t width, uint32_t height, uint32_t stride, uint64_t *out_dhash, uint64_t *out_phash);
+    // Hashes the shell thumbnail of a video; false where no thumbnail provider exists.
+    API_EXPORT bool get_thumbnail_hashes_by_id(uint32_t video_id, uint64_t *out_dhash, uint64_t *out_phash);
+    API_EXPORT void similarity_index_add(uint32_t path_id, uint64_t hash);
+    API_EXPORT bool similarity_index_remove(uint32_t path_id);
+    API_EXPORT uint32_t similarity_index_size();
+    // Matches are ordered nearest first. Returns the number of matches and copies up to capacity of them.
+    API_EXPORT uint32_t similarity_find_within(uint64_t hash, uint32_t radius, struct SimilarityMatch *out_matches, uint32_t capacity);
+    // Writes the k nearest entries to out_matches (room for k). Returns the number written.
+    API_EXPORT uint32_t similarity_find_nearest(uint64_t hash, uint32_t k, struct SimilarityMatch *out_matches);
+
+    // === Memory ===
+    // Read-ahead, probe and pixel buffers come from size-classed pools, and parsers take their
+    // scratch space from per-thread arenas. Thumbnail requests lease their pixel memory from a
+    // budget and wait while it is spent, which throttles whoever issues them.
+
+    API_EXPORT void get_memory_stats(struct MemoryStats *stats);
+    API_EXPORT void set_thumbnail_memory_budget(uint64_t bytes);
+    // Frees the buffers the pools hold for reuse, e.g. when the app is backgrounded.
+    API_EXPORT void trim_buffer_pools();
+
+    // === Hot cache ===
+    // Metadata, durations and encoded thumbnails asked for again and again, e.g. by a view that
+    // rebuilds, are answered from memory: a sharded LRU keyed by path ID under a byte budget
+    // (32 MiB by default). Metadata and durations are served without a stat for up to the max
+    // age (2 s by default; 0 keeps them until invalidated), and watch and rescan changes drop
+    // entries at once, so apps that watch their library can raise it.
+
+    // Encoded bytes of the thumbnail get_thumbnail_by_id writes to output_id, rendered first if
+    // that file does not exist. Returns the byte count, 0 on failure, and copies the bytes only
+    // when capacity holds them all: call with capacity 0 to learn the size.
+    API_EXPORT uint32_t get_thumbnail_bytes_by_id(uint32_t video_id, uint32_t output_id, unsigned int size, uint8_t *out_bytes, uint32_t capacity);
+    API_EXPORT void get_hot_cache_stats(struct HotCacheStats *stats);
+    // A budget of 0 turns the cache off.
+    API_EXPORT void set_hot_cache_limits(uint64_t budget_bytes, uint32_t max_age_ms);
+    API_EXPORT void clear_hot_cache();
+
+    // === I/O concurrency ===
+    // Batch probes on the thread pool run as many files at once per storage root as its limiter
+    // allows. The limit grows by one while windows keep it busy under the latency target, drops
+    // by a quarter above the target, and takes back an increase that only added latency.
+
+    // Returns the number of storage roots seen so far; fills at most capacity of them.
+    API_EXPORT uint32_t get_io_concurrency_stats(struct IoConcurrencyStats *out_stats, uint32_t capacity);
+    // Zero leaves a setting unchanged.
+    API_EXPORT void set_io_concurrency_limits(uint32_t min_limit, uint32_t max_limit, uint32_t latency_target_ms);
+
+    // === Unified probe ===
+    // Everything a caller asks for in fields_mask, from one stat and at most one open: the
+    // header parsers share a read-ahead cache, and a full hash yields the sampled one from the
+    // same pass. Bits: 1 = metadata, 2 = duration, 4 = streams, 8 = cover art, 16 = keyframe
+    // count, 32 = sampled hash (size plus head, middle and tail), 64 = full hash (XXH64).
+
+    API_EXPORT bool probe_file(const PathChar *path, uint32_t fields_mask, struct FileProbeResult *out);
+    // Also answers duration and keyframes from the probe cache and stores what it parses there.
+    API_EXPORT bool probe_file_by_id(uint32_t path_id, uint32_t fields_mask, struct FileProbeResult *out);
+
+    // === Library snapshots ===
+    // A scan result written as one file of 64-byte aligned columns (see SnapshotColumn in
+    // library_snapshot.h for IDs and element types), memory-mapped on open so each column
+    // can be read in place as a typed array. Paths are UTF-8 behind a table of offsets.
+
+    // Probes (or reuses cached results for) every file and replaces output_path atomically.
+    // stream_columns adds the container kind and keyframe count columns.
+    API_EXPORT bool snapshot_write(const uint32_t *path_ids, uint32_t count, const PathChar *output_path, bool stream_columns);
+    // Maps and validates a snapshot. Returns a handle > 0, or -1 if the file is missing or malformed.
+    API_EXPORT int32_t snapshot_open(const PathChar *path);
+    API_EXPORT uint64_t snapshot_row_count(int32_t handle);
+    // Start of a column inside the mapping and its element count; null if the snapshot lacks it.
+    // The pointer is valid until snapshot_close.
+    API_EXPORT const void *snapshot_column(int32_t handle, uint32_t column_id, uint64_t *out_count);
+    // For a sorted index column (BySize, ByDuration): the positions [first, first + count) whose
+    // value lies in [min_value, max_value]. Returns count.
+    API_EXPORT uint64_t snapshot_index_range(int32_t handle, uint32_t index_column, double min_value, double max_value, uint64_t *out_first);
+    API_EXPORT bool snapshot_close(int32_t handle);
+
+    // === Probe daemon ===
+    // When a vdu-probed daemon listens on the endpoint, duration, probe_file and thumbnail
+    // calls are answered by it, so app instances and indexers share its worker pool, probe
+    // cache and thumbnail store instead of each warming their own. Without one they run
+    // in-process as before; a failed connect is retried every two seconds at most. The
+    // endpoint is VDU_PROBED_ENDPOINT ("off" disables the daemon) or a per-user default.
+
+    // Decoded thumbnail as rows of width BGRA pixels (stride width * 4), valid until released.
+    // From a daemon the rows are mapped from shared memory rather than copied.
+    API_EXPORT const uint8_t *thumbnail_pixels_acquire(uint32_t video_id, uint32_t size, uint32_t *out_width, uint32_t *out_height);
+    API_EXPORT bool thumbnail_pixels_release(const uint8_t *pixels);
+    // null restores the default endpoint; an empty string keeps every call in-process.
+    API_EXPORT void daemon_set_endpoint(const PathChar *endpoint);
+    API_EXPORT void daemon_get_status(struct DaemonClientStatus *status);
+
+    // === File identity ===
+    // Hardlinks are probed, hashed and thumbnailed once: paths are grouped by (device, inode),
+    // or by volume serial and 128-bit file ID on Windows, and a path reuses the cached results
+    // of another path of the same file. Identities come from walks, and on Linux also from
+    // the stat behind every by-ID call; on Windows, paths that were never walked stay apart.
+
+    API_EXPORT void get_file_identity_stats(struct FileIdentityStats *stats);
+
+    // === Thumbnail window ===
+    // A grid tells which part of its ordered items is on screen, and thumbnails are rendered
+    // ahead of the scroll instead of when tiles appear: the visible tiles first, top to bottom,
+    // then lookahead items on each side of them, nearest first and those in the scroll
+    // direction before the others. Prefetches take at most half of the worker threads, so a
+    // newly visible tile never waits behind a full queue of them. Moving the window promotes
+    // queued items that came into view and cancels those that left it; renders already
+    // running finish. Thumbnails go to the output files get_thumbnail_by_id writes (existing
+    // files count as ready) and into the hot cache, so get_thumbnail_bytes_by_id answers them.
+
+    // video_ids and output_ids hold count items in display order; items first_visible
+    // .. first_visible + visible_count - 1 are on screen. A count of 0 cancels the window.
+    API_EXPORT bool set_thumbnail_window(const uint32_t *video_ids, const uint32_t *output_ids, uint32_t count, uint32_t first_visible,
+                                         uint32_t visible_count, uint32_t lookahead, unsigned int size);
+    // Waits up to timeout_ms for thumbnails of the window to become ready; returns the number of records written.
+    API_EXPORT uint32_t thumbnail_window_poll(struct ThumbnailTileRecord *out_tiles, uint32_t capacity, uint32_t timeout_ms);
+    API_EXPORT void get_thumbnail_window_stats(struct ThumbnailWindowStats *stats);
+    API_EXPORT void reset_thumbnail_window_stats();
+
+    // === Thumbnail atlas ===
+    // A page of a grid as one texture: the thumbnails of count items drawn into a single BGRA
+    // image of columns x rows square cells, row by row in the order given, so a view uploads
+    // and samples one image instead of decoding a PNG per tile. Atlases are cached by cell
+    // size, columns and items: building the same page again, open or recently closed, renders
+    // nothing, and items already drawn at the same cell size in another atlas are copied from
+    // it. A change to a video seen by watch or rescan marks its cells dirty; refreshing redraws
+    // those cells only. Closed atlases are kept up to a byte budget (64 MiB by default).
+
+    // Renders the atlas, or finds it cached. Returns a handle > 0, or -1 for invalid arguments.
+    API_EXPORT int32_t thumbnail_atlas_build(const uint32_t *video_ids, uint32_t count, uint32_t cell_size, uint32_t columns);
+    // Top-down rows of width BGRA pixels (stride width * 4), valid until the handle is closed.
+    // They change only during thumbnail_atlas_refresh; version counts those changes.
+    API_EXPORT const uint8_t *thumbnail_atlas_pixels(int32_t handle, uint32_t *out_width, uint32_t *out_height, uint32_t *out_version);
+    // Copies at most capacity cells, in item order; returns the item count.
+    API_EXPORT uint32_t thumbnail_atlas_cells(int32_t handle, struct ThumbnailAtlasCell *out_cells, uint32_t capacity);
+    // Redraws the dirty cells; returns how many were redrawn.
+    API_EXPORT uint32_t thumbnail_atlas_refresh(int32_t handle);
+    API_EXPORT bool thumbnail_atlas_close(int32_t handle);
+    API_EXPORT void get_thumbnail_atlas_stats(struct ThumbnailAtlasStats *stats);
+    // Byte budget for closed atlases; 0 frees them as they close.
+    API_EXPORT void set_thumbnail_atlas_budget(uint64_t bytes);
 
 #if defined(__cplusplus)
 }
 #endif
 
-#endif // VIDEO_DATA_EXPORTER_API_H
\ No newline at end of file
+#endif // VIDEO_DATA_EXPORTER_API_H
@@ -0,0 +1,319 @@
+#include "watch_service.h"
+#include "file_identity.h"
+#include "fs_watcher.h"
+#include "hot_cache.h"
+#include "path_arena.h"
+#include "probe_cache.h"
+#include "similarity_index.h"
+#include "thumbnail_atlas.h"
+#include "thumbnail_cache.h"
+#include "tree_summary.h"
+#include "worker_pool.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <system_error>
+#include <thread>
+
+namespace
+{
+    struct WatchSession
+    {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<FsChangeRecord> queue;
+        std::unique_ptr<FsWatcher> watcher;
+    };
+
+    struct RescanSession
+    {
+        std::mutex mutex;
+        std::condition_variable ready;
+        std::deque<FsChangeRecord> queue;
+        RescanStats stats = {};
+        std::atomic<bool> cancel{false}; // checked between directories and changes
+        std::thread worker;
+    };
+
+    void StopRescan(RescanSession &session)
+    {
+        session.cancel = true;
+        session.worker.join();
+    }
+
+    // Watches and rescans share one handle space. Rescans still running when the process
+    // exits or the library unloads are cancelled and joined here, since destroying a
+    // joinable worker would terminate the process; watchers stop in their destructor.
+    struct SessionRegistry
+    {
+        std::mutex mutex;
+        std::map<int32_t, std::shared_ptr<WatchSession>> watches;
+        std::map<int32_t, std::shared_ptr<RescanSession>> rescans;
+        int32_t nextHandle = 1;
+
+        SessionRegistry()
+        {
+            // Constructed first, so destroyed after the workers that write into them are joined
+            PathArena::Instance();
+            ProbeCache::Instance();
+            HotCache::Instance();
+            ThumbnailCache::Instance();
+            ThumbnailAtlasStore::Instance();
+            SimilarityIndex::Instance();
+            FileIdentityIndex::Instance();
+        }
+
+        ~SessionRegistry()
+        {
+            for (auto &entry : rescans) entry.second->cancel = true;
+            for (auto &entry : rescans) entry.second->worker.join();
+        }
+    };
+
+    SessionRegistry &Sessions()
+    {
+        static SessionRegistry registry;
+        return registry;
+    }
+
+    void ApplyChange(const FsChange &change, uint32_t pathId, bool reprobe)
+    {
+        if (change.is_directory || change.kind == FsChangeKind::Rescan)
+        {
+            ProbeCache::Instance().InvalidateUnder(change.path);
+            HotCache::Instance().InvalidateUnder(change.path);
+            ThumbnailCache::Instance().InvalidateUnder(change.path);
+            ThumbnailAtlasStore::Instance().InvalidateUnder(change.path);
+            SimilarityIndex::Instance().RemoveUnder(change.path);
+            FileIdentityIndex::Instance().ForgetUnder(change.path);
+            return;
+        }
+
+        ProbeCache::Instance().Invalidate(pathId);
+        HotCache::Instance().Invalidate(pathId);
+        ThumbnailCache::Instance().Invalidate(pathId);
+        ThumbnailAtlasStore::Instance().Invalidate(pathId);
+        SimilarityIndex::Instance().Remove(pathId);
+        // The path may name another file now; the next stat or walk records which
+        FileIdentityIndex::Instance().Forget(pathId);
+
+        // Refill the cache now so the caller's next request for this file is a hit
+        if (reprobe && change.kind != FsChangeKind::Removed)
+            WorkerPool::Instance().Submit([pathId] { get_video_duration_by_id(pathId); });
+    }
+
+    std::shared_ptr<WatchSession> FindSession(int32_t handle)
+    {
+        SessionRegistry &registry = Sessions();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.watches.find(handle);
+        return it == registry.watches.end() ? nullptr : it->second;
+    }
+
+    std::shared_ptr<RescanSession> FindRescan(int32_t handle)
+    {
+        SessionRegistry &registry = Sessions();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.rescans.find(handle);
+        return it == registry.rescans.end() ? nullptr : it->second;
+    }
+
+    void Rescan(RescanSession *session, const NativePath &root, const NativePath &statePath, bool statEveryFile)
+    {
+        TreeSummary previous;
+        const bool fromSummary = LoadTreeSummary(statePath, &previous);
+        if (!fromSummary) previous.root = root; // empty: everything is reported as added
+
+        TreeSummary current;
+        TreeScanStats scan;
+        const bool scanned = ScanTree(root, fromSummary ? &previous : nullptr, !statEveryFile, &current, &scan, &session->cancel);
+
+        // Handed to pollers in batches so a first scan of a large library does not take the lock per file
+        std::vector<FsChangeRecord> batch;
+        uint64_t counts[4] = {};
+        auto flush = [&] {
+            {
+                std::lock_guard<std::mutex> lock(session->mutex);
+                session->queue.insert(session->queue.end(), batch.begin(), batch.end());
+                session->stats.added = counts[static_cast<int>(FsChangeKind::Added)];
+                session->stats.modified = counts[static_cast<int>(FsChangeKind::Modified)];
+                session->stats.removed = counts[static_cast<int>(FsChangeKind::Removed)];
+            }
+            session->ready.notify_all();
+            batch.clear();
+        };
+        if (scanned)
+        {
+            DiffTrees(previous, current, [&](FsChange &&change) {
+                if (session->cancel.load(std::memory_order_relaxed)) return;
+                const uint32_t pathId = PathArena::Instance().Intern(change.path);
+                if (pathId == kInvalidPathId) return;
+                // An added directory's files follow one by one, so its subtree needs no sweep of every cache
+                if (!(change.is_directory && change.kind == FsChangeKind::Added)) ApplyChange(change, pathId, false);
+                counts[static_cast<int>(change.kind)]++;
+                batch.push_back({pathId, static_cast<uint8_t>(change.kind), static_cast<uint8_t>(change.is_directory), 0});
+                if (batch.size() >= 256) flush();
+            });
+        }
+        // Changes dropped by a cancel would be lost if the summary recorded them as seen
+        const bool saved = scanned && !session->cancel && SaveTreeSummary(statePath, current);
+        flush();
+
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            session->stats.directories = scan.directories;
+            session->stats.directories_listed = scan.directories_listed;
+            session->stats.files = scan.files;
+            session->stats.file_stats = scan.file_stats;
+            session->stats.from_summary = fromSummary;
+            session->stats.summary_saved = saved;
+        }
+    }
+
+    // Runs on its own thread, where an escaping exception would terminate the process
+    void RunRescan(RescanSession *session, const NativePath &root, const NativePath &statePath, bool statEveryFile)
+    {
+        try
+        {
+            Rescan(session, root, statePath, statEveryFile);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "watch_service | Exception occurred during rescan: " << e.what() << std::endl;
+        }
+        {
+            std::lock_guard<std::mutex> lock(session->mutex);
+            session->stats.finished = 1;
+        }
+        session->ready.notify_all();
+    }
+}
+
+int32_t WatchService::Start(const std::vector<NativePath> &roots, uint32_t debounceMs, bool reprobe)
+{
+    auto session = std::make_shared<WatchSession>();
+    WatchSession *raw = session.get();
+
+    auto onBatch = [raw, reprobe](std::vector<FsChange> &&batch)
+    {
+        std::vector<FsChangeRecord> records;
+        records.reserve(batch.size());
+        for (const FsChange &change : batch)
+        {
+            const uint32_t pathId = PathArena::Instance().Intern(change.path);
+            if (pathId == kInvalidPathId) continue;
+            ApplyChange(change, pathId, reprobe);
+            records.push_back({pathId, static_cast<uint8_t>(change.kind), static_cast<uint8_t>(change.is_directory), 0});
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(raw->mutex);
+            raw->queue.insert(raw->queue.end(), records.begin(), records.end());
+        }
+        raw->ready.notify_all();
+    };
+
+    session->watcher = std::make_unique<FsWatcher>(onBatch, std::chrono::milliseconds(debounceMs == 0 ? 250 : debounceMs));
+    for (const NativePath &root : roots) session->watcher->AddRoot(root);
+    if (!session->watcher->Start()) return -1;
+
+    SessionRegistry &registry = Sessions();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    const int32_t handle = registry.nextHandle++;
+    registry.watches[handle] = std::move(session);
+    return handle;
+}
+
+uint32_t WatchService::Poll(int32_t handle, FsChangeRecord *out, uint32_t capacity, uint32_t timeoutMs)
+{
+    std::shared_ptr<WatchSession> session = FindSession(handle);
+    if (!session || out == nullptr || capacity == 0) return 0;
+
+    std::unique_lock<std::mutex> lock(session->mutex);
+    session->ready.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] { return !session->queue.empty(); });
+
+    uint32_t count = 0;
+    while (count < capacity && !session->queue.empty())
+    {
+        out[count++] = session->queue.front();
+        session->queue.pop_front();
+    }
+    return count;
+}
+
+bool WatchService::Stop(int32_t handle)
+{
+    std::shared_ptr<WatchSession> session;
+    {
+        SessionRegistry &registry = Sessions();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.watches.find(handle);
+        if (it == registry.watches.end()) return false;
+        session = std::move(it->second);
+        registry.watches.erase(it);
+    }
+    // Joins the watcher thread; pending pollers wake up empty-handed on their timeout
+    session->watcher->Stop();
+    return true;
+}
+
+int32_t WatchService::StartRescan(const NativePath &root, const NativePath &statePath, bool statEveryFile)
+{
+    std::error_code error;
+    if (!std::filesystem::is_directory(root, error) || statePath.empty()) return -1;
+
+    auto session = std::make_shared<RescanSession>();
+    session->worker = std::thread(RunRescan, session.get(), root, statePath, statEveryFile);
+
+    SessionRegistry &registry = Sessions();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    const int32_t handle = registry.nextHandle++;
+    registry.rescans[handle] = std::move(session);
+    return handle;
+}
+
+uint32_t WatchService::PollRescan(int32_t handle, FsChangeRecord *out, uint32_t capacity, uint32_t timeoutMs)
+{
+    std::shared_ptr<RescanSession> session = FindRescan(handle);
+    if (!session || out == nullptr || capacity == 0) return 0;
+
+    std::unique_lock<std::mutex> lock(session->mutex);
+    session->ready.wait_for(lock, std::chrono::milliseconds(timeoutMs), [&] { return !session->queue.empty() || session->stats.finished; });
+
+    uint32_t count = 0;
+    while (count < capacity && !session->queue.empty())
+    {
+        out[count++] = session->queue.front();
+        session->queue.pop_front();
+    }
+    return count;
+}
+
+bool WatchService::RescanProgress(int32_t handle, RescanStats *stats)
+{
+    std::shared_ptr<RescanSession> session = FindRescan(handle);
+    if (!session || stats == nullptr) return false;
+    std::lock_guard<std::mutex> lock(session->mutex);
+    *stats = session->stats;
+    return true;
+}
+
+bool WatchService::CloseRescan(int32_t handle)
+{
+    std::shared_ptr<RescanSession> session;
+    {
+        SessionRegistry &registry = Sessions();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        auto it = registry.rescans.find(handle);
+        if (it == registry.rescans.end()) return false;
+        session = std::move(it->second);
+        registry.rescans.erase(it);
+    }
+    StopRescan(*session);
+    return true;
+}
@@ -0,0 +1,37 @@
+#ifndef WATCH_SERVICE_H
+#define WATCH_SERVICE_H
+
+#include "native_path.h"
+#include "video_data_exporter_api.h"
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief Owns the active library watches behind the watch_* exports.
+ *
+ * Each change batch invalidates the probe and thumbnail cache entries it
+ * touches, optionally re-probes changed files on the worker pool, and is then
+ * queued until the caller polls for it.
+ */
+namespace WatchService
+{
+    // Returns a handle > 0, or -1 if none of the roots could be watched.
+    int32_t Start(const std::vector<NativePath> &roots, uint32_t debounceMs, bool reprobe);
+
+    // Waits up to timeoutMs for changes and copies at most capacity of them.
+    uint32_t Poll(int32_t handle, FsChangeRecord *out, uint32_t capacity, uint32_t timeoutMs);
+
+    bool Stop(int32_t handle);
+
+    // Rescans root on a background thread against the tree summary at statePath (see
+    // ScanTree), streams the differences through the same cache invalidation as watch
+    // batches, then saves the new summary. Returns a handle > 0, or -1 if root is not a directory.
+    int32_t StartRescan(const NativePath &root, const NativePath &statePath, bool statEveryFile);
+    uint32_t PollRescan(int32_t handle, FsChangeRecord *out, uint32_t capacity, uint32_t timeoutMs);
+    bool RescanProgress(int32_t handle, RescanStats *stats);
+    // Cancels a scan still running and waits for it; changes not polled are dropped and
+    // a cancelled scan leaves the saved summary as it was.
+    bool CloseRescan(int32_t handle);
+}
+
+#endif // WATCH_SERVICE_H
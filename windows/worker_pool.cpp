@@ -0,0 +1,143 @@
+#include "worker_pool.h"
+#include <algorithm>
+#include <atomic>
+#include <iostream>
+#include <memory>
+
+#ifdef _WIN32
+#include <objbase.h>
+#endif
+
+WorkerPool &WorkerPool::Instance()
+{
+    static WorkerPool pool(std::clamp<size_t>(std::thread::hardware_concurrency(), 2, 8));
+    return pool;
+}
+
+WorkerPool::WorkerPool(size_t threadCount)
+{
+    threadCount = std::max<size_t>(threadCount, 1);
+    threads_.reserve(threadCount);
+    for (size_t i = 0; i < threadCount; i++) threads_.emplace_back(&WorkerPool::Run, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for (std::thread &thread : threads_) thread.join();
+}
+
+void WorkerPool::Submit(std::function<void()> task)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queue_.push_back(std::move(task));
+    }
+    wake_.notify_one();
+}
+
+void WorkerPool::SubmitWithin(MemoryBudget &budget, uint64_t bytes, std::function<void()> task)
+{
+    // The lease is taken before queuing, so a spent budget stalls the submitter rather than the workers
+    auto lease = std::make_shared<MemoryBudget::Lease>(budget.Acquire(bytes));
+    Submit([lease, task = std::move(task)] {
+        task();
+        lease->Release();
+    });
+}
+
+void WorkerPool::WaitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex_);
+    idle_.wait(lock, [this] { return queue_.empty() && running_ == 0; });
+}
+
+void WorkerPool::ParallelFor(size_t count, const std::function<void(size_t)> &body)
+{
+    if (count == 0) return;
+
+    struct Progress
+    {
+        std::atomic<size_t> next{0};
+        size_t finished = 0;
+        std::mutex mutex;
+        std::condition_variable done;
+    };
+    auto progress = std::make_shared<Progress>();
+    const std::function<void(size_t)> *work = &body;
+
+    // Helpers that only get a thread after every index is claimed return without touching body
+    auto drain = [progress, work, count] {
+        size_t ran = 0;
+        for (size_t i = progress->next++; i < count; i = progress->next++)
+        {
+            try
+            {
+                (*work)(i);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "worker_pool | Task failed: " << e.what() << std::endl;
+            }
+            ran++;
+        }
+        if (ran == 0) return;
+        std::lock_guard<std::mutex> lock(progress->mutex);
+        progress->finished += ran;
+        if (progress->finished == count) progress->done.notify_all();
+    };
+
+    const size_t helpers = std::min(threads_.size(), count - 1);
+    for (size_t i = 0; i < helpers; i++) Submit(drain);
+    drain();
+
+    std::unique_lock<std::mutex> lock(progress->mutex);
+    progress->done.wait(lock, [&] { return progress->finished == count; });
+}
+
+size_t WorkerPool::Pending() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queue_.size() + running_;
+}
+
+void WorkerPool::Run()
+{
+#ifdef _WIN32
+    CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+#endif
+    for (;;)
+    {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+            if (queue_.empty()) break;
+            task = std::move(queue_.front());
+            queue_.pop_front();
+            running_++;
+        }
+
+        try
+        {
+            task();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "worker_pool | Task failed: " << e.what() << std::endl;
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            running_--;
+            if (queue_.empty() && running_ == 0) idle_.notify_all();
+        }
+    }
+#ifdef _WIN32
+    CoUninitialize();
+#endif
+}
@@ -0,0 +1,57 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include "buffer_pool.h"
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @brief Fixed-size pool of threads running probe work.
+ *
+ * On Windows every worker joins the multithreaded COM apartment so Media
+ * Foundation and Shell calls can run on it directly.
+ */
+class WorkerPool
+{
+public:
+    // Shared pool sized from the hardware concurrency
+    static WorkerPool &Instance();
+
+    explicit WorkerPool(size_t threadCount);
+    ~WorkerPool();
+
+    WorkerPool(const WorkerPool &) = delete;
+    WorkerPool &operator=(const WorkerPool &) = delete;
+
+    void Submit(std::function<void()> task);
+
+    // Blocks until @p budget can grant @p bytes, then queues the task holding them until it finishes.
+    void SubmitWithin(MemoryBudget &budget, uint64_t bytes, std::function<void()> task);
+
+    // Blocks until the queue is empty and no task is running.
+    void WaitIdle();
+
+    // Runs body(0) .. body(count - 1) on the pool and the calling thread, and returns
+    // when all of them have finished. Unrelated queued work does not delay the return.
+    void ParallelFor(size_t count, const std::function<void(size_t)> &body);
+
+    size_t ThreadCount() const { return threads_.size(); }
+    size_t Pending() const;
+
+private:
+    void Run();
+
+    mutable std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable idle_;
+    std::deque<std::function<void()>> queue_;
+    std::vector<std::thread> threads_;
+    size_t running_ = 0;
+    bool stopping_ = false;
+};
+
+#endif // WORKER_POOL_H